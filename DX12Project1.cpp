@@ -1,7 +1,8 @@
 ﻿
 #include "./Source/App.h"
 
-const int gNumFrameResources = 3;
+// Dirty data is queued for every frame resource the pacer may use.
+const int gNumFrameResources = LampFramePacer::MaxFramesInFlight;
 const bool mFrameLimit = true;
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
@@ -0,0 +1,23 @@
+// Clears a box of texels of one voxel clipmap level before it is voxelized again.
+#define PASS_REGISTER b1
+#include "ConstantLayout.hlsli"
+
+RWTexture3D<float4> gVoxelColor        : register(u0);
+RWTexture3D<float4> gVoxelNormal       : register(u1);
+RWTexture3D<float4> gVoxelMat          : register(u2);
+
+cbuffer cbVoxelClear : register(b0)
+{
+    VOXEL_CLEAR_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+};
+
+[numthreads(4, 4, 4)]
+void CS(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id >= gClearSize))
+        return;
+    uint3 texel = gClearMin + id;
+    gVoxelColor[texel] = 0;
+    gVoxelNormal[texel] = 0;
+    gVoxelMat[texel] = 0;
+}
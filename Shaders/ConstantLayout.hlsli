@@ -0,0 +1,198 @@
+// Constant buffer layouts, written once as field lists and expanded into the C++
+// structs (FrameResource.h) and the shader cbuffers.
+//
+// The pass constants are split into blocks by how often they change, so a frame
+// resource only rewrites the blocks that differ from what it already holds
+// (LampConstantBlocks). The blocks keep the order of the old cbPass, so its layout,
+// and every shader compiled against it, is unchanged.
+#ifndef CONSTANT_LAYOUT_HLSLI
+#define CONSTANT_LAYOUT_HLSLI
+
+// F(type, name) declares a field, A(type, name, count) an array.
+
+// Levels of the voxel clipmap (LampVoxelClipmap).
+#define VOXEL_LEVELS 3
+// MaxLights, for shaders that do not include LightingUtil.hlsli.
+#define PASS_MAX_LIGHTS 16
+
+// Camera or light: changes whenever the view moves.
+#define PASS_VIEW_FIELDS(F, A) \
+    F(float4x4, View) \
+    F(float4x4, InvView) \
+    F(float4x4, Proj) \
+    F(float4x4, InvProj) \
+    F(float4x4, ViewProj) \
+    F(float4x4, InvViewProj) \
+    F(float4x4, ViewProjTex) \
+    F(float4x4, ShadowTransform) \
+    F(float3, EyePosW) \
+    F(float, ViewPad0)
+
+// Render target and depth range: changes on resize.
+#define PASS_TARGET_FIELDS(F, A) \
+    F(float2, RenderTargetSize) \
+    F(float2, InvRenderTargetSize) \
+    F(float, NearZ) \
+    F(float, FarZ)
+
+// Changes every frame.
+#define PASS_FRAME_FIELDS(F, A) \
+    F(float, TotalTime) \
+    F(float, DeltaTime)
+
+// Changes when a light does.
+// Indices [0, NUM_DIR_LIGHTS) are directional lights;
+// indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
+// indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
+// are spot lights for a maximum of MaxLights per object.
+#define PASS_LIGHT_FIELDS(F, A) \
+    F(float4, AmbientLight) \
+    A(Light, Lights, MaxLights)
+
+// Changes when the camera moves the voxel clipmap a snap step.
+// VoxelClip[l] is level l's window: xyz its min corner in world space, w its voxel size.
+#define PASS_VOXEL_FIELDS(F, A) \
+    A(float4, VoxelClip, VOXEL_LEVELS)
+
+// Set once at startup: the size of the voxel clipmap.
+#define PASS_STATIC_FIELDS(F, A) \
+    F(float3, VoxelDims) \
+    F(uint, VoxelLevels)
+
+// What TAA needs beyond cbPass, which it binds as well.
+#define TAA_FIELDS(F, A) \
+    F(float4x4, LastViewProj) \
+    A(float4, Offsets, 9) \
+    F(float, Influence) \
+    F(float3, TaaPad0)
+
+// Root constants of a voxelize draw: the slab of a clipmap level it fills, in voxels of
+// SlabVoxelSize, and the level's window.
+#define VOXEL_SLAB_FIELDS(F, A) \
+    F(int3, SlabMin) \
+    F(float, SlabVoxelSize) \
+    F(int3, SlabMax) \
+    F(uint, SlabLevel) \
+    F(int3, SlabWindowMin) \
+    F(float, SlabPad0)
+
+// Root constants of a voxel clear: a box of texels.
+#define VOXEL_CLEAR_FIELDS(F, A) \
+    F(uint3, ClearMin) \
+    F(uint, ClearPad0) \
+    F(uint3, ClearSize) \
+    F(uint, ClearPad1)
+
+// Root constants of a static voxel injection: StaticVoxels [InjectFirst, InjectFirst +
+// InjectCount) of one clipmap level, whose window starts at InjectWindowMin.
+#define VOXEL_INJECT_FIELDS(F, A) \
+    F(int3, InjectWindowMin) \
+    F(uint, InjectFirst) \
+    F(float, InjectVoxelSize) \
+    F(uint, InjectCount) \
+    F(uint2, InjectPad0)
+
+// One baked static voxel (LampVoxelBake) as uploaded: its texel packed 10 bits per
+// axis, and the attributes as RGBA8 UNORM.
+#define STATIC_VOXEL_FIELDS(F, A) \
+    F(uint, Texel) \
+    F(uint, Albedo) \
+    F(uint, Normal) \
+    F(uint, Mat)
+
+#ifdef __cplusplus
+
+namespace ConstantLayout
+{
+    typedef DirectX::XMFLOAT4X4 float4x4;
+    typedef DirectX::XMFLOAT4 float4;
+    typedef DirectX::XMFLOAT3 float3;
+    typedef DirectX::XMFLOAT2 float2;
+    typedef DirectX::XMINT3 int3;
+    typedef DirectX::XMUINT3 uint3;
+    typedef DirectX::XMUINT2 uint2;
+    typedef UINT uint;
+
+    // Matrices start as Identity, everything else as zero.
+    template <typename T> inline T Initial() { return T{}; }
+    template <> inline float4x4 Initial<float4x4>()
+    {
+        return float4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+#define CPP_FIELD(type, name) type name = Initial<type>();
+#define CPP_ARRAY(type, name, count) type name[count] = {};
+
+    struct PassConstants
+    {
+        PASS_VIEW_FIELDS(CPP_FIELD, CPP_ARRAY)
+        PASS_TARGET_FIELDS(CPP_FIELD, CPP_ARRAY)
+        PASS_FRAME_FIELDS(CPP_FIELD, CPP_ARRAY)
+        PASS_LIGHT_FIELDS(CPP_FIELD, CPP_ARRAY)
+        PASS_VOXEL_FIELDS(CPP_FIELD, CPP_ARRAY)
+        PASS_STATIC_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    struct TaaConstants
+    {
+        TAA_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    struct VoxelSlabConstants
+    {
+        VOXEL_SLAB_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    struct VoxelClearConstants
+    {
+        VOXEL_CLEAR_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    struct VoxelInjectConstants
+    {
+        VOXEL_INJECT_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    struct StaticVoxel
+    {
+        STATIC_VOXEL_FIELDS(CPP_FIELD, CPP_ARRAY)
+    };
+
+    // Shaders without Light pad its place in cbPass as float4s.
+    static_assert(sizeof(Light) == 3 * sizeof(float4) && MaxLights == PASS_MAX_LIGHTS, "Light array padding is stale");
+
+#undef CPP_FIELD
+#undef CPP_ARRAY
+}
+
+#else
+
+#define HLSL_FIELD(type, name) type g##name;
+#define HLSL_ARRAY(type, name, count) type g##name[count];
+
+// Shaders that include neither LightingUtil.hlsli nor Disney_BRDF.hlsli do not know
+// Light and never read gLights; the buffer bound is the same either way, and the
+// fields behind the lights stay where they are.
+#ifdef MaxLights
+#define PASS_LIGHT_ARRAY HLSL_ARRAY
+#else
+#define PASS_LIGHT_ARRAY(type, name, count) float4 g##name##Unused[3 * PASS_MAX_LIGHTS];
+#endif
+
+#ifndef PASS_REGISTER
+#define PASS_REGISTER b0
+#endif
+
+cbuffer cbPass : register(PASS_REGISTER)
+{
+    PASS_VIEW_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+    PASS_TARGET_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+    PASS_FRAME_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+    PASS_LIGHT_FIELDS(HLSL_FIELD, PASS_LIGHT_ARRAY)
+    PASS_VOXEL_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+    PASS_STATIC_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+};
+
+#endif
+
+#endif
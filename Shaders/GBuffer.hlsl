@@ -48,30 +48,25 @@ cbuffer cbPerObject : register(b0)
 	uint gObjPad2;
 };
 
-// Constant data that varies per material.
-cbuffer cbPass : register(b1)
+#ifdef INSTANCING
+// Per-instance data, offset to the batch's first instance on the CPU.
+struct InstanceData
 {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gInvViewProj;
-    float4x4 gViewProjTex;
-    float4x4 gShadowTransform;
-    float3 gEyePosW;
-    float cbPerObjectPad1;
-    float2 gRenderTargetSize;
-    float2 gInvRenderTargetSize;
-    float gNearZ;
-    float gFarZ;
-    float gTotalTime;
-    float gDeltaTime;
-    float4 gAmbientLight;
-
-    Light gLights[MaxLights];
+    float4x4 World;
+    float4x4 TexTransform;
+    uint     MaterialIndex;
+    uint     InstPad0;
+    uint     InstPad1;
+    uint     InstPad2;
 };
 
+StructuredBuffer<InstanceData> gInstanceData : register(t1, space1);
+#endif
+
+// Constant data that varies per material.
+#define PASS_REGISTER b1
+#include "ConstantLayout.hlsli"
+
 // Transforms a normal map sample to world space.
 float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, float3 tangentW)
 {
@@ -105,8 +100,17 @@ struct VertexOut
     float3 NormalW  : NORMAL;
     float2 TexC     : TEXCOORD;
     float3 TangentW : TANGENT;
+#ifdef INSTANCING
+    nointerpolation uint MatIndex : MATINDEX;
+#endif
 };
 
+#ifdef INSTANCING
+    #define MATERIAL_INDEX pin.MatIndex
+#else
+    #define MATERIAL_INDEX gMaterialIndex
+#endif
+
 struct PixelOutput
 {
     float4 BaseColor                    : SV_TARGET0;
@@ -115,27 +119,43 @@ struct PixelOutput
     // float2 Velocity		            : SV_TARGET3;
 };
 
+#ifdef INSTANCING
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
+#else
 VertexOut VS(VertexIn vin)
+#endif
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+#ifdef INSTANCING
+    InstanceData instData = gInstanceData[instanceID];
+    float4x4 world = instData.World;
+    float4x4 texTransform = instData.TexTransform;
+    uint matIndex = instData.MaterialIndex;
+    vout.MatIndex = matIndex;
+#else
+    float4x4 world = gWorld;
+    float4x4 texTransform = gTexTransform;
+    uint matIndex = gMaterialIndex;
+#endif
+
 	// Fetch the material data.
-	MaterialData matData = gMaterialData[gMaterialIndex];
+	MaterialData matData = gMaterialData[matIndex];
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
     // vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(vin.NormalL, (float3x3)world);
 	
-	vout.TangentW = mul(normalize(vin.TangentU), (float3x3)gWorld);
+	vout.TangentW = mul(normalize(vin.TangentU), (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
 	vout.TexC = mul(texC, matData.MatTransform).xy;
 	
     return vout;
@@ -145,7 +165,7 @@ PixelOutput PS(VertexOut pin)
 {
     PixelOutput Out;
 
-	MaterialData matData = gMaterialData[gMaterialIndex];
+	MaterialData matData = gMaterialData[MATERIAL_INDEX];
 
     uint Width = 0, Height = 0;
     
@@ -0,0 +1,100 @@
+// Anisotropic mips of the voxel color volume (LampAnisoVoxels). Face f of a texel
+// composites its 2^3 children front to back along the direction f looks (+X, -X, +Y, -Y,
+// +Z, -Z), column by column, and averages the four columns. Anisotropic mip m stands for
+// level m + 1 of the color volume. A dispatch writes three mips from gSrcLevel: the color
+// volume's mip 0 when it is 0, else anisotropic mip gSrcLevel - 1 of each face.
+
+Texture3D<float4> gVoxelColor          : register(t0);
+Texture3D<float4> gVoxelAniso[6]       : register(t1);
+
+RWTexture3D<float4> gOutMip[18]        : register(u0); // face * 3 + mip of the dispatch
+
+cbuffer cbAnisoMip : register(b0)
+{
+    uint gSrcLevel;
+};
+
+groupshared float4 gsFaces[6][64];
+
+// Children in x + 2y + 4z order; front is the one a cone travelling along the face's
+// direction enters first.
+float4 Integrate(float4 c[8], uint face)
+{
+    uint bit = 1u << (face / 2);
+    bool positive = face % 2 == 0;
+    float4 sum = 0;
+    [unroll]
+    for (uint i = 0; i < 8; ++i)
+    {
+        if (i & bit)
+            continue;
+        float4 front = c[positive ? i : i | bit];
+        float4 back = c[positive ? i | bit : i];
+        sum += front + (1.0 - front.a) * back;
+    }
+    return saturate(sum * 0.25);
+}
+
+float4 LoadSource(uint face, int3 texel)
+{
+    if (gSrcLevel == 0)
+        return gVoxelColor.Load(int4(texel, 0));
+    return gVoxelAniso[face].Load(int4(texel, gSrcLevel - 1));
+}
+
+float4 IntegrateShared(uint face, uint groupIndex, uint step)
+{
+    float4 c[8];
+    [unroll]
+    for (uint i = 0; i < 8; ++i)
+        c[i] = gsFaces[face][groupIndex + step * ((i & 1) + ((i >> 1) & 1) * 4 + (i >> 2) * 16)];
+    return Integrate(c, face);
+}
+
+[numthreads(4, 4, 4)]
+void CS(uint GroupIndex : SV_GroupIndex, uint3 DTid : SV_DispatchThreadID)
+{
+    [unroll]
+    for (uint face = 0; face < 6; ++face)
+    {
+        float4 c[8];
+        [unroll]
+        for (uint i = 0; i < 8; ++i)
+            c[i] = LoadSource(face, int3(DTid * 2 + uint3(i & 1, (i >> 1) & 1, i >> 2)));
+        float4 texel = Integrate(c, face);
+        gOutMip[face * 3][DTid] = texel;
+        gsFaces[face][GroupIndex] = texel;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // This bit mask (binary: 010101) checks that x, y and z are even.
+    float4 second[6];
+    if ((GroupIndex & 21) == 0)
+    {
+        [unroll]
+        for (uint face = 0; face < 6; ++face)
+        {
+            second[face] = IntegrateShared(face, GroupIndex, 1);
+            gOutMip[face * 3 + 1][DTid / 2] = second[face];
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if ((GroupIndex & 21) == 0)
+    {
+        [unroll]
+        for (uint face = 0; face < 6; ++face)
+            gsFaces[face][GroupIndex] = second[face];
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GroupIndex == 0)
+    {
+        [unroll]
+        for (uint face = 0; face < 6; ++face)
+            gOutMip[face * 3 + 2][DTid / 4] = IntegrateShared(face, GroupIndex, 2);
+    }
+}
@@ -0,0 +1,79 @@
+// Writes baked static voxels (LampVoxelBake) into the texels of one clipmap level that
+// were just cleared, lit as Voxelize.hlsl lights the surfaces it rasterizes.
+// Include structures and functions for lighting.
+#include "LightingUtil.hlsli"
+#define PASS_REGISTER b1
+#include "ConstantLayout.hlsli"
+
+#define STRUCT_FIELD(type, name) type name;
+
+struct StaticVoxel
+{
+    STATIC_VOXEL_FIELDS(STRUCT_FIELD, STRUCT_FIELD)
+};
+
+Texture2D gShadowMap                   : register(t0);
+StructuredBuffer<StaticVoxel> gVoxels  : register(t1);
+
+RWTexture3D<float4> gVoxelColor        : register(u0);
+RWTexture3D<float4> gVoxelNormal       : register(u1);
+RWTexture3D<float4> gVoxelMat          : register(u2);
+
+SamplerComparisonState gsamShadow      : register(s6);
+
+cbuffer cbVoxelInject : register(b0)
+{
+    VOXEL_INJECT_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+};
+
+float CalcShadowFactor(float4 shadowPosH)
+{
+    shadowPosH.xyz /= shadowPosH.w;
+    float depth = shadowPosH.z;
+
+    uint width, height, numMips;
+    gShadowMap.GetDimensions(0, width, height, numMips);
+    float dx = 1.0f / (float)width;
+
+    float percentLit = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; ++y)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; ++x)
+            percentLit += gShadowMap.SampleCmpLevelZero(gsamShadow, shadowPosH.xy + float2(x, y) * dx, depth).r;
+    }
+    return percentLit / 9.0f;
+}
+
+// RGBA8 UNORM with R in the low byte, as LampVoxelizer::PackUnorm() packs it.
+float4 UnpackUnorm(uint packed)
+{
+    return float4(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff, packed >> 24) / 255.0f;
+}
+
+[numthreads(64, 1, 1)]
+void CS(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gInjectCount)
+        return;
+    StaticVoxel voxel = gVoxels[gInjectFirst + id.x];
+    uint3 texel = uint3(voxel.Texel & 0x3ff, (voxel.Texel >> 10) & 0x3ff, voxel.Texel >> 20);
+
+    // The voxel of the window the texel holds.
+    int3 dims = (int3)gVoxelDims;
+    int3 offset = ((int3)texel - gInjectWindowMin % dims + dims) % dims;
+    float3 posW = (gInjectWindowMin + offset + 0.5f) * gInjectVoxelSize;
+
+    float4 albedo = UnpackUnorm(voxel.Albedo);
+    float4 normal = UnpackUnorm(voxel.Normal);
+    float4 mat = UnpackUnorm(voxel.Mat);
+    float3 normalW = normalize(normal.xyz * 2 - 1);
+    float shadow = CalcShadowFactor(mul(float4(posW, 1.0f), gShadowTransform));
+    float radiance = max(dot(normalize(-gLights[0].Direction), normalW), 0) * shadow;
+    float metallic = mat.r;
+
+    gVoxelColor[texel] = float4(albedo.rgb * (radiance * 0.32) * (1 - metallic * 0.5), 1);
+    gVoxelNormal[texel] = normal;
+    gVoxelMat[texel] = mat;
+}
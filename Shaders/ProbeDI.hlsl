@@ -12,9 +12,17 @@ Texture3D gProbeSH2     : register(t5);
 
 Texture2D gCurProbe     : register(t6);
 
+#define VOXEL_TRACE
+#include "VoxelClipmap.hlsli"
+
+// The region of the probe grid.
 static const float3 _MaxDis = float3(12.5, 12.3046875, 12.5);
 static const float3 _MinDis = float3(-12.5, -0.1953124, -12.5);
 
+float3 ProbeToWorld(float3 uvw) {
+    return _MinDis + uvw / float3(32, 16, 32) * (_MaxDis - _MinDis);
+}
+
 float3 positionToUVW(float3 position) {
     float3 uvw = position - _MinDis;
     uvw += 0.00001;
@@ -53,7 +61,8 @@ float3 GetSH(uint3 uvw, float3 normal)
 }
 bool isLegal(float3 uvw, float3 uvwf, float3 normal)
 {
-    bool a = gVoxelColor.SampleLevel(gsamLinearClamp, uvw*float3(0.03125, 0.0625, 0.03125), 3).a>0;
+    float4 voxel;
+    bool a = SampleVoxelColor(ProbeToWorld(uvw), 3, voxel) && voxel.a>0;
     bool b = dot(uvw+0.5 - uvwf, normal)>-0.8;
     return a&&b;
 }
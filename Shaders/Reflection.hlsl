@@ -17,6 +17,10 @@ Texture2D gHiz                  : register(t9);
 
 Texture2D gDiffuse              : register(t10);
 
+#define VOXEL_TRACE
+#include "VoxelClipmap.hlsli"
+
+// The region of the probe grid.
 static const float3 _MaxDis = float3(12.5, 12.3046875, 12.5);
 static const float3 _MinDis = float3(-12.5, -0.1953124, -12.5);
 
@@ -75,11 +79,6 @@ float3 positionToUVWf(float3 position) {
     uvw.z /= max(_MaxDis.z - _MinDis.z, 0.01);
     return uvw;
 }
-float4 sample3DColorLod(float3 position, int lod) {
-    float3 uvw = positionToUVWf(position);
-    lod = min(lod, 6);
-    return gVoxelColor.SampleLevel(gsamLinearClamp, uvw, lod);
-}
 
 float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
 {
@@ -98,15 +97,14 @@ float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
     {
         travelled += pow2(lod);
         current += offset * pow2(lod);
-        if (abs(current.x)>_MaxDis.x || current.y>_MaxDis.y || current.y<_MinDis.y || abs(current.z)>_MaxDis.z) 
+        float4 temp;
+        if (!SampleVoxelColor(current, lod, temp))
         {    
             // result = gCubeMap.SampleLevel(gsamLinearClamp, sampleDir, 0);
             // result *= result *0.7;
             result = 0.15;
             break;
         }
-        
-        float4 temp = sample3DColorLod(current, lod);
         if(temp.a>0)
         {
             if(lod<1)
@@ -216,7 +214,8 @@ float4 PS(VertexOut pin) : SV_Target
 
 	float4 SceneColor = float4(0,0,0,0);
 
-    if (abs(posWS.x)>_MaxDis.x || posWS.y>_MaxDis.y || posWS.y<_MinDis.y || abs(posWS.z)>_MaxDis.z)
+    // Outside the voxel clipmap.
+    if (!VoxelInLevel(posWS, gVoxelLevels - 1, 1))
         return SceneColor;
 
 	float3 normalVS = gNormalMap.SampleLevel(gsamLinearWrap, pin.TexC, 0.0f).rgb;
@@ -56,28 +56,8 @@ cbuffer cbPerObject : register(b0)
 	uint gObjPad2;
 };
 // Constant data that varies per material.
-cbuffer cbPass : register(b1)
-{
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gInvViewProj;
-    float4x4 gViewProjTex;
-    float4x4 gShadowTransform;
-    float3 gEyePosW;
-    float cbPerObjectPad1;
-    float2 gRenderTargetSize;
-    float2 gInvRenderTargetSize;
-    float gNearZ;
-    float gFarZ;
-    float gTotalTime;
-    float gDeltaTime;
-    float4 gAmbientLight;
-
-    Light gLights[MaxLights];
-};
+#define PASS_REGISTER b1
+#include "ConstantLayout.hlsli"
 
 struct VertexIn
 {
@@ -8,17 +8,10 @@ SamplerState gsamPointClamp       : register(s1);
 SamplerState gsamLinearWrap       : register(s2);
 SamplerState gsamLinearClamp      : register(s3);
 
-cbuffer cbPass : register(b0) {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gLastViewProj;
-    float2 _Offsets[9];
-    float2 gInvRenderTargetSize;
-    float gInflunce;
-    float gTotalTime;
+#include "ConstantLayout.hlsli"
+
+cbuffer cbTaa : register(b1) {
+    TAA_FIELDS(HLSL_FIELD, HLSL_ARRAY)
 };
 
 static const float2 gTexCoords[6] =
@@ -75,7 +68,7 @@ void GetColorRange(float2 uv, inout float3 minColor, inout float3 maxColor)
     [unroll]
     for(int i=0; i<9; i++)
     {
-        float3 color = RGBToYCoCg(gOffScreenMap.SampleLevel(gsamPointClamp, uv + _Offsets[i] * 2, 0).rgb);
+        float3 color = RGBToYCoCg(gOffScreenMap.SampleLevel(gsamPointClamp, uv + gOffsets[i].xy * 2, 0).rgb);
         minColor = (minColor.r > color.r * 0.98)? color * 0.98 : minColor;
         maxColor = (maxColor.r < color.r * 1.02)? color * 1.02 : maxColor;
     }
@@ -110,11 +103,11 @@ float2 AdjustBestDepthOffset(float2 uv)
 
     [unroll]
     for (int k = 0; k < 9; k++) {
-        float depth = gDepthMap.SampleLevel(gsamPointClamp, uv + _Offsets[k] * 3, 0).r;
+        float depth = gDepthMap.SampleLevel(gsamPointClamp, uv + gOffsets[k].xy * 3, 0).r;
 
         if (depth > bestDepth) {
             bestDepth = depth;
-            uvOffset = _Offsets[k] * 3;
+            uvOffset = gOffsets[k].xy * 3;
         }
     }
     return uvOffset;
@@ -11,6 +11,10 @@ Texture3D gProbeSH0     : register(t5);
 Texture3D gProbeSH1     : register(t6);
 Texture3D gProbeSH2     : register(t7);
 
+#define VOXEL_TRACE
+#include "VoxelClipmap.hlsli"
+
+// The region of the probe grid.
 static const float3 _MaxDis = float3(12.5, 12.3046875, 12.5);
 static const float3 _MinDis = float3(-12.5, -0.1953124, -12.5);
 
@@ -53,6 +57,9 @@ float3 positionToUVWf(float3 position) {
     uvw.z /= max(_MaxDis.z - _MinDis.z, 0.01);
     return uvw;
 }
+float3 ProbeToWorld(float3 uvw) {
+    return _MinDis + uvw / float3(32, 16, 32) * (_MaxDis - _MinDis);
+}
 float3 uvToVector3(float2 uv)
 {
     float3 N = float3( uv, 1 - abs(uv.x)-abs(uv.y) );
@@ -78,12 +85,7 @@ float3 GetSH(uint3 uvw, float3 normal)
         float3(sh0.w, sh1.w, sh2.w) * shc01.w;
     return res;
 }
-float4 sample3DColorLod(float3 position, int lod) {
-    float3 uvw = positionToUVWf(position);
-    lod = min(lod, 6);
-    return gVoxelColor.SampleLevel(gsamLinearClamp, uvw, lod);
-}
-float3 trace(uint3 start, float3 sampleDir)
+float3 trace(float3 start, float3 sampleDir)
 {
     float axis = max(abs(sampleDir.z), max(abs(sampleDir.x), abs(sampleDir.y))); 
     float3 offset = sampleDir / axis;
@@ -100,14 +102,13 @@ float3 trace(uint3 start, float3 sampleDir)
     {
         travelled += pow2(lod);
         current += offset * pow2(lod);
-        if (abs(current.x)>_MaxDis.x || current.y>_MaxDis.y || current.y<_MinDis.y || abs(current.z)>_MaxDis.z) 
+        float4 temp;
+        if (!SampleVoxelColor(current, lod, temp))
         {
             // result = gCubeMap.SampleLevel(gsamLinearClamp, sampleDir, 0);
             // result *= result;
             break;
         }
-        
-        float4 temp = sample3DColorLod(current, lod);
         if(temp.a>0)
         {
             if(lod<1)
@@ -117,7 +118,8 @@ float3 trace(uint3 start, float3 sampleDir)
                 result += float4(temp.rgb/temp.a, 1);
                 float3 uvw = positionToUVWf(current)*float3(32, 16, 32);
                 
-                float3 normal = gVoxelNormal[uint3(current)].rgb*2-1;
+                // Only level 0 keeps normals.
+                float3 normal = VoxelInLevel(current, 0, 0) ? gVoxelNormal[VoxelTexel(current, 0)].rgb*2-1 : -sampleDir;
                 result.rgb += saturate(GetSH(uvw, sampleDir));
                 result *= (dot(-sampleDir, normal) > 0.05 ? 1 : 0);
                 lod = max(lod-1, 0);
@@ -141,7 +143,8 @@ float4 PS(VertexOut i) : SV_Target
 {
     int2 uvi = i.TexC * 1024;
     uint3 uvw = m2dTo3d(uvi);
-    if( !(gVoxelColor.SampleLevel(gsamLinearClamp, uvw/float3(32, 16, 32), 3).a>0 ) ) {  return 0; }
+    float4 voxel;
+    if( !(SampleVoxelColor(ProbeToWorld(uvw), 3, voxel) && voxel.a>0 ) ) {  return 0; }
     else 
     {
         float3 history = gHisWProbe[uvi].rgb;
@@ -153,7 +156,7 @@ float4 PS(VertexOut i) : SV_Target
         float3 dir = uvToVector3(uv*2-1);
         float3 rand = RandomVector(float3(i.TexC, i.TexC.x));
         dir = normalize(dir+rand*0.07);
-        float3 res = trace(uvw*8, dir);
+        float3 res = trace(ProbeToWorld(uvw), dir);
         float3 color = lerp(history, res, 0.1);
         return float4(color, 1);
     }
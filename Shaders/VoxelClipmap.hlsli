@@ -0,0 +1,117 @@
+// The camera-centered voxel clipmap (LampVoxelClipmap), read through the gVoxel*
+// fields of cbPass. Level l holds gVoxelDims voxels of gVoxelClip[l].w around the
+// camera, from gVoxelClip[l].xyz on. A voxel is stored at its world index modulo
+// gVoxelDims, so volumes are sampled at VoxelUVW() with a wrap sampler.
+//
+// With VOXEL_TRACE defined, gVoxelColor (level 0, with mips) must be declared, and the
+// colors of the other levels are bound as gVoxelCoarse in space1. With VOXEL_ANISO as
+// well, the six faces GenerateAnisoMip3D.hlsl writes above level 0's mip 0 are bound as
+// gVoxelAniso in space2, for ConeTraceVoxels().
+#ifndef VOXEL_CLIPMAP_HLSLI
+#define VOXEL_CLIPMAP_HLSLI
+
+#include "ConstantLayout.hlsli"
+
+float3 VoxelUVW(float3 posW, uint level)
+{
+    return posW / (gVoxelClip[level].w * gVoxelDims);
+}
+
+// The texel of the level that stores the voxel at posW.
+uint3 VoxelTexel(float3 posW, uint level)
+{
+    float3 voxel = floor(posW / gVoxelClip[level].w);
+    return (uint3)(voxel - floor(voxel / gVoxelDims) * gVoxelDims);
+}
+
+// Whether posW is inside the level's window with margin of its voxels to spare.
+bool VoxelInLevel(float3 posW, uint level, float margin)
+{
+    float3 voxel = (posW - gVoxelClip[level].xyz) / gVoxelClip[level].w;
+    return all(voxel >= margin) && all(voxel <= gVoxelDims - margin);
+}
+
+#ifdef VOXEL_TRACE
+
+#if VOXEL_LEVELS > 1
+Texture3D gVoxelCoarse[VOXEL_LEVELS - 1] : register(t0, space1);
+#endif
+
+// Voxel color over 2^lod voxels of level 0 at posW: from level 0's mips while its window
+// holds the footprint, else from the first coarser level that holds posW, which has no
+// mips. False outside the clipmap.
+bool SampleVoxelColor(float3 posW, int lod, out float4 color)
+{
+    color = 0;
+    if (VoxelInLevel(posW, 0, 1 << lod))
+    {
+        color = gVoxelColor.SampleLevel(gsamLinearWrap, VoxelUVW(posW, 0), lod);
+        return true;
+    }
+#if VOXEL_LEVELS > 1
+    [loop]
+    for (uint level = (uint)clamp(lod, 1, (int)gVoxelLevels - 1); level < gVoxelLevels; ++level)
+    {
+        if (VoxelInLevel(posW, level, 1))
+        {
+            color = gVoxelCoarse[NonUniformResourceIndex(level - 1)].SampleLevel(gsamLinearWrap, VoxelUVW(posW, level), 0);
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+#ifdef VOXEL_ANISO
+Texture3D gVoxelAniso[6] : register(t0, space2);
+
+// Level 0's premultiplied color over 2^lod voxels as a cone travelling along dir sees it:
+// the three faces dir looks into, weighted by its squared components. Face mip m stands
+// for lod m + 1, so below lod 1 it blends with the isotropic mip 0.
+float4 SampleVoxelAniso(float3 posW, float3 dir, float lod)
+{
+    float3 uvw = VoxelUVW(posW, 0);
+    float4 base = gVoxelColor.SampleLevel(gsamLinearWrap, uvw, 0);
+    if (lod <= 0)
+        return base;
+    float3 w = dir * dir;
+    float mip = max(lod - 1, 0);
+    float4 aniso =
+        w.x * gVoxelAniso[NonUniformResourceIndex(dir.x >= 0 ? 0 : 1)].SampleLevel(gsamLinearWrap, uvw, mip) +
+        w.y * gVoxelAniso[NonUniformResourceIndex(dir.y >= 0 ? 2 : 3)].SampleLevel(gsamLinearWrap, uvw, mip) +
+        w.z * gVoxelAniso[NonUniformResourceIndex(dir.z >= 0 ? 4 : 5)].SampleLevel(gsamLinearWrap, uvw, mip);
+    return lod < 1 ? lerp(base, aniso, lod) : aniso;
+}
+
+// Front-to-back cone through level 0, 2 * aperture * distance wide and never under a
+// voxel, stepping its own width. inside is false when it left the window before it
+// turned opaque; end is where it stopped. LampAnisoVoxels::ConeTrace() is the reference.
+float4 ConeTraceVoxels(float3 start, float3 dir, float aperture, uint steps, out bool inside, out float3 end)
+{
+    float voxel = gVoxelClip[0].w;
+    float distance = voxel;
+    float4 result = 0;
+    inside = true;
+    end = start;
+    [loop]
+    for (uint i = 0; i < steps && result.a < 0.95; ++i)
+    {
+        float diameter = max(voxel, 2 * aperture * distance);
+        float lod = min(log2(diameter / voxel), 6);
+        float3 p = start + dir * distance;
+        if (!VoxelInLevel(p, 0, diameter / voxel))
+        {
+            inside = false;
+            break;
+        }
+        result += (1 - result.a) * SampleVoxelAniso(p, dir, lod);
+        end = p;
+        distance += diameter;
+    }
+    return result;
+}
+#endif
+
+#endif
+
+#endif
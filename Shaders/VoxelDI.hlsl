@@ -14,6 +14,10 @@ Texture3D gProbeSH2             : register(t7);
 
 Texture2D gCurProbe             : register(t8);
 
+#define VOXEL_TRACE
+#include "VoxelClipmap.hlsli"
+
+// The region of the probe grid.
 static const float3 _MaxDis = float3(12.5, 12.3046875, 12.5);
 static const float3 _MinDis = float3(-12.5, -0.1953124, -12.5);
 
@@ -72,12 +76,29 @@ float3 positionToUVWf(float3 position) {
     uvw.z /= max(_MaxDis.z - _MinDis.z, 0.01);
     return uvw;
 }
-float4 sample3DColorLod(float3 position, int lod) {
-    float3 uvw = positionToUVWf(position);
-    lod = min(lod, 6);
-    return gVoxelColor.SampleLevel(gsamLinearClamp, uvw, lod);
-}
 
+#ifdef VOXEL_ANISO
+// A cone through the anisotropic mips. LampAnisoVoxels::Benchmark() has this aperture
+// reach the window's edge in about 8 samples, with less error than the isotropic mips.
+static const float ConeAperture = 0.3;
+static const uint ConeSteps = 12;
+
+float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
+{
+    bool inside;
+    float3 end;
+    float4 result = ConeTraceVoxels(start, sampleDir, ConeAperture, ConeSteps, inside, end);
+    hit = result.a > 0.9;
+    if (!inside)
+        result.rgb += 0.6 * (1 - result.a);
+    if (result.a > 0)
+    {
+        float3 uvw = positionToUVWf(end)*float3(32, 16, 32);
+        result.rgb += saturate(GetSH(uvw, sampleDir)*3) * result.a;
+    }
+    return result.rgb;
+}
+#else
 float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
 {
     float axis = max(abs(sampleDir.z), max(abs(sampleDir.x), abs(sampleDir.y))); 
@@ -95,15 +116,14 @@ float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
     {
         travelled += pow2(lod);
         current += offset * pow2(lod);
-        if (abs(current.x)>_MaxDis.x || current.y>_MaxDis.y || current.y<_MinDis.y || abs(current.z)>_MaxDis.z) 
+        float4 temp;
+        if (!SampleVoxelColor(current, lod, temp))
         {    
             // result = gCubeMap.SampleLevel(gsamLinearClamp, sampleDir, 0);
             // result *= result;
             result = 0.6;
             break;
         }
-        
-        float4 temp = sample3DColorLod(current, lod);
         if(temp.a>0)
         {
             if(lod<1)
@@ -129,6 +149,7 @@ float3 TraceVoxelColor(float3 start, float3 sampleDir, out bool hit)
     if(result.a>0.9) hit = true;
     return result.rgb;
 }
+#endif
 
 float4 PS(VertexOut pin) : SV_Target
 {
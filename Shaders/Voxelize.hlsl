@@ -13,6 +13,11 @@ RWTexture3D<float4> gVoxelColor        : register(u0);
 RWTexture3D<float4> gVoxelNormal       : register(u1);
 RWTexture3D<float4> gVoxelMat          : register(u2);
 
+cbuffer cbVoxelSlab : register(b2)
+{
+    VOXEL_SLAB_FIELDS(HLSL_FIELD, HLSL_ARRAY)
+};
+
 struct VertexIn
 {
     float3 PosL    : POSITION;
@@ -25,6 +30,7 @@ struct VertexOut
 {
     float4 PosH     : SV_POSITION;
     float4 ShadowPosH : POSITION;
+    float3 VoxelPos : POSITION1;
     float3 NormalW  : NORMAL;
     float2 TexC     : TEXCOORD;
     float3 TangentW : TANGENT;
@@ -34,7 +40,9 @@ struct GeoOut
 {
     float4 PosH : SV_POSITION;
     float4 ShadowPosH : POSITION0;
-    float4 PosCS : POSITION1;
+    float3 VoxelPos : POSITION1;
+    // One viewport per projection axis, each with the scissor of the slab.
+    uint Viewport : SV_ViewportArrayIndex;
     float3 NormalW : NORMAL;
     float2 TexC : TEXCOORD0;
     float3 TangentW : TANGENT;
@@ -80,7 +88,9 @@ VertexOut VS(VertexIn vin)
     float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
 	vout.TangentW = mul(vin.TangentU, (float3x3)gWorld);
-    vout.PosH = float4(posW.xyz*0.08, 1.0f);
+    // The level's window maps to [-1, 1] on every axis.
+    vout.VoxelPos = posW.xyz / gSlabVoxelSize;
+    vout.PosH = float4((vout.VoxelPos - gSlabWindowMin) / gVoxelDims * 2 - 1, 1.0f);
     vout.ShadowPosH = mul(posW, gShadowTransform);
 	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
 	vout.TexC = mul(texC, matData.MatTransform).xy;
@@ -114,7 +124,7 @@ float3 RestoreAxis(float3 position, uint axis)
 [maxvertexcount(3)]
 void GS(triangle VertexOut vert[3], inout TriangleStream<GeoOut> triStream)
 {
-    float3 normal = normalize(abs(cross(vert[1].PosH.xyz - vert[0].PosH.xyz, vert[2].PosH.xyz - vert[0].PosH.xyz)));
+    float3 normal = normalize(abs(cross(vert[1].VoxelPos - vert[0].VoxelPos, vert[2].VoxelPos - vert[0].VoxelPos)));
 
     // Choose an axis with the largest projection area
     bool towardsX = normal.x > normal.y && normal.x > normal.z;
@@ -126,7 +136,8 @@ void GS(triangle VertexOut vert[3], inout TriangleStream<GeoOut> triStream)
         GeoOut o;
 
         o.PosH = float4(SwizzleAxis(vert[j].PosH.xyz, axis), 1.0f);
-        o.PosCS = vert[j].PosH;
+        o.VoxelPos = vert[j].VoxelPos;
+        o.Viewport = axis;
         o.ShadowPosH = vert[j].ShadowPosH;
         o.NormalW = vert[j].NormalW;
         o.TangentW = vert[j].TangentW;
@@ -164,6 +175,11 @@ float4 DecodeRGBAuint(uint value)
 
 float4 PS(GeoOut pin) : SV_Target
 {
+    // Voxels outside the slab keep what they hold.
+    int3 voxel = (int3)floor(pin.VoxelPos);
+    if (any(voxel < gSlabMin) || any(voxel >= gSlabMax))
+        discard;
+
 	MaterialData matData = gMaterialData[gMaterialIndex];
 
     float4 BaseColor = matData.DiffuseAlbedo * gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, pin.TexC);
@@ -183,7 +199,10 @@ float4 PS(GeoOut pin) : SV_Target
     // float4 OcclusionRoughnessMetallic = float4(Metallic, Roughness);
     // pin.PosH.xyz = RestoreAxis(pin.PosH.xyz, pin.axis);
     // pin.PosH = pin.PosCS;
-    uint3 coord = uint3(uint(pin.PosCS.x*128 + 128), uint(pin.PosCS.y*128 + 2), uint(((pin.PosCS.z*128 + 128))) );
+    // The texel of the voxel, wrapped as the window scrolls.
+    uint3 dims = (uint3)gVoxelDims;
+    uint3 wrap = (uint3)((gSlabWindowMin % (int3)dims + (int3)dims) % (int3)dims);
+    uint3 coord = ((uint3)(voxel - gSlabWindowMin) + wrap) % dims;
     // while (gVoxel[coord] != color)
     //float4 color = BaseColor;
     float4 color = float4(BaseColor.rgb * (radiance * 0.32 + 0.0f) * (1-Metallic*0.5), 1);
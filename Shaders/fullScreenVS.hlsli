@@ -1,25 +1,6 @@
 #include "./LightingUtil.hlsli"
 
-cbuffer cbPass : register(b0) {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gInvViewProj;
-    float4x4 gViewProjTex;
-    float4x4 gShadowTransform;
-    float3 gEyePosW;
-    float cbPerObjectPad1;
-    float2 gRenderTargetSize;
-    float2 gInvRenderTargetSize;
-    float gNearZ;
-    float gFarZ;
-    float gTotalTime;
-    float gDeltaTime;
-    float4 gAmbientLight;
-    Light gLights[MaxLights];
-};
+#include "ConstantLayout.hlsli"
 
 SamplerState gsamPointWrap      : register(s0);
 SamplerState gsamPointClamp     : register(s1);
@@ -5,6 +5,7 @@
 #include "Pass/VXGI.h"
 #include "Pass/TAA.h"
 #include "Pass/Mipmap3D.h"
+#include "Pass/AnisoMipmap3D.h"
 #include "Pass/WorldProbe.h"
 #include "Pass/WorldProbeDebug.h"
 #include "Pass/ProbeGI.h"
@@ -20,6 +21,12 @@
 #include "Pass/LampDI/ScreenProbeSH.h"
 #include "Pass/LampDI/Reflection.h"
 #include  "Pass//LampDI/CompositionDI.h"
+#include <chrono>
+
+namespace
+{
+    const char* VoxelBakePath = "Shaders\\cache\\voxels.bin";
+}
 
 LampApp::LampApp(HINSTANCE hInstance)
     : D3DApp(hInstance)
@@ -41,9 +48,13 @@ LampApp::LampApp(HINSTANCE hInstance)
 
 LampApp::~LampApp()
 {
+    // A rebake in flight writes mRebake.
+    LampThreadPool::Default().WaitBackground();
     if (md3dDevice != nullptr)
         FlushCommandQueue();
     mFrameResources.clear();
+    if (mFenceEvent != nullptr)
+        CloseHandle(mFenceEvent);
 }
 
 bool LampApp::Initialize()
@@ -54,6 +65,10 @@ bool LampApp::Initialize()
     if (!D3DApp::InitDirect3D())
         return false;
 
+    mFenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+    if (mFenceEvent == nullptr)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
     // Do the initial resize code.
     OnResize();
 
@@ -73,8 +88,12 @@ void LampApp::InitialGraphics()
 
     mPasses.push_back(std::make_unique<Shadow>(md3dDevice, mHeaps, mPSO, mScene));
     mPasses.push_back(std::make_unique<GBuffer>(md3dDevice, mHeaps, mPSO, mScene));
-    mPasses.push_back(std::make_unique<DeferLighting>(md3dDevice, mHeaps, mPSO));
-    mPasses.push_back(std::make_unique<Voxel>(md3dDevice, mHeaps, mPSO, mScene));
+    mPasses.push_back(std::make_unique<DeferLighting>(md3dDevice, mHeaps, mPSO, SceneLightCounts()));
+    // 256 x 128 x 256 voxels per level; level 0 spans the 25 m the scene used to fill.
+    const UINT voxelDims[3] = { 256, 128, 256 };
+    mVoxelClipmap = std::make_shared<LampVoxelClipmap>(VOXEL_LEVELS, voxelDims, 25.0f / 256.0f, 8, 8);
+    mVoxelBake = std::make_shared<LampVoxelBake>(VOXEL_LEVELS, 25.0f / 256.0f);
+    mPasses.push_back(std::make_unique<Voxel>(md3dDevice, mHeaps, mPSO, mScene, mVoxelClipmap, mVoxelBake));
     mPasses.push_back(std::make_unique<TAA>(md3dDevice, mHeaps, mPSO));
     mPasses.push_back(std::make_unique<Mipmap3D>(md3dDevice, mHeaps, mPSO, L"VoxelizedColor"));
     mPasses.push_back(std::make_unique<HierachyZBuffer>(md3dDevice, mHeaps, mPSO));
@@ -88,9 +107,28 @@ void LampApp::InitialGraphics()
     mPasses.push_back(std::make_unique<ScreenProbeSH>(md3dDevice, mHeaps, mPSO));
     mPasses.push_back(std::make_unique<LampReflection>(md3dDevice, mHeaps, mPSO));
     mPasses.push_back(std::make_unique<CompositionDI>(md3dDevice, mHeaps, mPSO));
+    mPasses.push_back(std::make_unique<AnisoMipmap3D>(md3dDevice, mHeaps, mPSO, L"VoxelizedColor"));
+    for (auto& pass : mPasses)
+        pass->FindPipelines();
+    for (UINT i = 0; i < (UINT)mPasses.size(); ++i)
+    {
+        auto scenePass = dynamic_cast<SceneRenderPass*>(mPasses[i].get());
+        if (scenePass != nullptr)
+            scenePass->SetPassIndex(i);
+    }
+    mDebugPso = mPSO->FindPSO(L"debug");
+    mDebugRootSig = mPSO->FindRootSignature(L"debug");
+    BuildRenderGraph();
+    BuildTransientLifetimes();
 
 
     mScene->LoadScene(mCommandList.Get());
+    // Settle the loaded transforms, so items that move later show up as changed.
+    mScene->Transforms().Update();
+    mVoxelBake->LoadOrBake(VoxelBakePath, mScene->RenderItems(RenderLayer::Opaque), mScene->CpuTextures());
+    OutputDebugString(mVoxelBake->Report().c_str());
+    mOcclusion = std::make_unique<LampOcclusion>(256, 128);
+    mOcclusion->AddOccluders(mScene->RenderItems(RenderLayer::Wall));
     mHeaps->BuildSRV(mScene, mDepthStencilBuffer);
     mPasses[0]->OnResize(2048, 2048); // Shadow
     mPasses[1]->OnResize(mClientWidth, mClientHeight); // GBuffer
@@ -108,8 +146,12 @@ void LampApp::InitialGraphics()
     mPasses[13]->OnResize(1, 1); // ProbeSH
     mPasses[14]->OnResize(mClientWidth, mClientHeight); // Reflection
     mPasses[15]->OnResize(mClientWidth, mClientHeight); // Composite
+    mPasses[16]->OnResize(128, 32, 128); // Anisotropic Mipmap3D
+    mHeaps->BuildTransients();
+    mHeaps->InitializePlaced(mCommandList.Get());
     
     BuildFrameResources();
+    BuildFrameRecorder();
 
     // Execute the initialization commands.
     ThrowIfFailed(mCommandList->Close());
@@ -129,25 +171,22 @@ void LampApp::OnResize()
 
 void LampApp::Update(const GameTimer& gt)
 {
-    OnKeyboardInput(gt);
-
-    // Cycle through the circular frame resource array.
-    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+    // Waits until the GPU is done with the next frame resource and few enough frames
+    // are queued. Input is read after the wait, so it is as fresh as it can be.
+    mCurrFrameResourceIndex = (int)mPacer.BeginFrame(*this);
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
     mHeaps->SwapTarget();
 
-    // Has the GPU finished processing the commands of the current frame resource?
-    // If not, wait until the GPU has completed commands up to this fence point.
-    if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-        if (eventHandle != NULL)
-        {
-            WaitForSingleObject(eventHandle, INFINITE);
-            CloseHandle(eventHandle);
-        }
-    }
+    // Nothing records now: pipelines of edited shaders are swapped for the frames recorded from here.
+    mPSO->ApplyShaderReloads();
+
+    OnKeyboardInput(gt);
+
+    // The GPU is done with this frame resource: recycle its transient uploads
+    // and make room for items added since it was last used.
+    mCurrFrameResource->Upload->Reset();
+    mHeaps->BeginFrame(mCurrentFence + 1, mFence->GetCompletedValue());
+    mCurrFrameResource->Reserve(md3dDevice.Get(), mScene->ObjectCBCount(), mScene->MaterialCBCount());
 
     //
     // Animate the lights (and hence shadows).
@@ -163,14 +202,110 @@ void LampApp::Update(const GameTimer& gt)
         XMStoreFloat3(&mRotatedLightDirections[i], lightDir);
     }
 
+    mPassBlocks->BeginFrame();
+    mTaaBlocks->BeginFrame();
     AnimateMaterials(gt);
+    // World matrices and bounds must be final before the object CBs and culling read them.
+    mScene->Transforms().Update();
+    bool rebake = false;
+    for (auto ri : mScene->Transforms().ChangedItems())
+    {
+        mScene->MarkDirty(ri);
+        // A static item that moves leaves the bake and is voxelized every frame from now on.
+        if (ri->Static)
+        {
+            ri->Static = false;
+            rebake = true;
+        }
+    }
+    if (rebake)
+        mRebakeWanted = true;
+    UpdateVoxelBake();
+    mScene->UpdateOctree();
     UpdateObjectCBs(gt);
     UpdateMaterialBuffer(gt);
     UpdateShadowTransform(gt);
+    UpdateVoxels(gt);
     UpdateMainPassCB(gt);
     UpdateShadowPassCB(gt);
     UpdateSsaoCB(gt);
     UpdateTaaCB(gt);
+    UpdateOcclusion(gt);
+    UpdateSceneDraws(gt);
+    UpdateInstanceBuffer(gt);
+}
+
+void LampApp::UpdateVoxels(const GameTimer& gt)
+{
+    mDynamicBounds.clear();
+    for (auto ri : mScene->RenderItems(RenderLayer::Opaque))
+    {
+        if (!ri->Static)
+            mDynamicBounds.push_back(ri->Bounds);
+    }
+    mVoxelClipmap->Update(mCamera.GetPosition3f(), mDynamicBounds);
+
+    // The baked voxels of this frame's slabs, for Voxelize to inject.
+    mCurrFrameResource->StaticVoxelAddress = 0;
+    if (!mVoxelBake->Ready())
+        return;
+    mVoxelBake->Gather(*mVoxelClipmap);
+    const std::vector<StaticVoxel>& voxels = mVoxelBake->Gathered();
+    if (!voxels.empty())
+        mCurrFrameResource->StaticVoxelAddress = mCurrFrameResource->Upload->Upload(voxels.data(), (UINT)voxels.size(), 16).GPU;
+}
+
+void LampApp::UpdateVoxelBake()
+{
+    if (mRebake != nullptr && mRebakeDone)
+    {
+        mVoxelBake->Swap(*mRebake);
+        mRebake.reset();
+        // The volumes still hold the old static voxels of the moved items.
+        mVoxelClipmap->Invalidate();
+        OutputDebugString(mVoxelBake->Report().c_str());
+    }
+    // Items that move while a rebake runs wait for the next one.
+    if (!mRebakeWanted || mRebake != nullptr)
+        return;
+
+    mRebakeWanted = false;
+    mRebakeDone = false;
+    mRebake = std::make_unique<LampVoxelBake>(mVoxelBake->Levels(), mVoxelBake->VoxelSize());
+    std::shared_ptr<LampVoxelBake::StaticItems> items = LampVoxelBake::CopyStatic(mScene->RenderItems(RenderLayer::Opaque));
+    std::vector<const LampCpuTexture*> textures = mScene->CpuTextures();
+    LampVoxelBake* bake = mRebake.get();
+    LampThreadPool::Default().Submit([this, bake, items, textures]
+    {
+        bake->Bake(items->Items, textures);
+        if (!bake->Save(VoxelBakePath))
+            OutputDebugString(L"Voxel bake: could not write the bake file\n");
+        mRebakeDone = true;
+    });
+}
+
+void LampApp::UpdateOcclusion(const GameTimer& gt)
+{
+    auto& ritems = mScene->RenderItems(RenderLayer::Opaque);
+    if (!mOcclusionCulling)
+    {
+        for (auto ri : ritems)
+            ri->Visible = true;
+        return;
+    }
+
+    XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+    mOcclusion->Render(viewProj);
+    mOcclusion->Cull(ritems);
+}
+
+void LampApp::UpdateSceneDraws(const GameTimer& gt)
+{
+    // Shadow sorts its draws from the light, GBuffer and Voxelize from the camera.
+    XMMATRIX view = mCamera.GetView();
+    static_cast<SceneRenderPass*>(mPasses[0].get())->BeginFrame(XMLoadFloat4x4(&mLightView));
+    static_cast<SceneRenderPass*>(mPasses[1].get())->BeginFrame(view);
+    static_cast<SceneRenderPass*>(mPasses[3].get())->BeginFrame(view);
 }
 
 void LampApp::CreateRtvAndDsvDescriptorHeaps()
@@ -187,21 +322,110 @@ void LampApp::CreateRtvAndDsvDescriptorHeaps()
 
 void LampApp::BuildFrameResources()
 {
-    for (int i = 0; i < gNumFrameResources; ++i)
+    // As many as the pacer may keep in flight; it uses the first FramesInFlight().
+    for (UINT i = 0; i < LampFramePacer::MaxFramesInFlight; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            2, (UINT)mScene->mAllRitems.size(), (UINT)mScene->mMaterials.size()));
+            PassCBCount, mScene->ObjectCBCount(), mScene->MaterialCBCount(), FrameStageCount));
+    }
+    BuildConstantBlocks();
+}
+
+void LampApp::BuildFrameRecorder()
+{
+    for (UINT i = 0; i < FrameStageCount; ++i)
+    {
+        ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+            mFrameResources[0]->ListAllocs[i].Get(), nullptr, IID_PPV_ARGS(mStageLists[i].GetAddressOf())));
+        ThrowIfFailed(mStageLists[i]->Close());
+        ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+            mFrameResources[0]->CmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mPatchLists[i].GetAddressOf())));
+        ThrowIfFailed(mPatchLists[i]->Close());
+    }
+
+    // Added in FrameStage order, which is the submission order.
+    mRecorder.Add(L"PrePass", [this](UINT) { DrawPrePass(mStageLists[(UINT)FrameStage::PrePass].Get()); });
+    mRecorder.Add(L"Voxelize", [this](UINT) { Voxelize(mStageLists[(UINT)FrameStage::Voxelize].Get()); });
+    mRecorder.Add(L"Screen", [this](UINT) { DrawScreenPass(mStageLists[(UINT)FrameStage::Screen].Get()); });
+    mRecorder.Add(L"Blit", [this](UINT) { BlitToScreenPass(mStageLists[(UINT)FrameStage::Blit].Get()); });
+}
+
+void LampApp::Open(UINT list)
+{
+    auto& cmdAlloc = mCurrFrameResource->ListAllocs[list];
+    auto& cmdList = mStageLists[list];
+    ThrowIfFailed(cmdAlloc->Reset());
+    ThrowIfFailed(cmdList->Reset(cmdAlloc.Get(), nullptr));
+
+    ID3D12DescriptorHeap* descriptorHeaps[] = { mHeaps->CustomSRVHeap() };
+    cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+    // Passes reach the tracker through mHeaps->States().
+    DescriptorHeap::RecordStates(&mStageStates[list]);
+}
+
+void LampApp::Close(UINT list)
+{
+    DescriptorHeap::RecordStates(nullptr);
+    ThrowIfFailed(mStageLists[list]->Close());
+}
+
+void LampApp::Submit(const std::vector<UINT>& lists)
+{
+    // Lists were recorded from the states they started with last frame; whatever
+    // the lists before them changed since goes into a patch list ahead of them.
+    auto& registry = mHeaps->StateRegistry();
+    std::vector<ID3D12CommandList*> cmdsLists;
+    for (UINT list : lists)
+    {
+        std::vector<D3D12_RESOURCE_BARRIER> patch;
+        registry.Join(mStageStates[list], patch);
+        if (!patch.empty())
+        {
+            auto& patchList = mPatchLists[list];
+            ThrowIfFailed(patchList->Reset(mCurrFrameResource->CmdListAlloc.Get(), nullptr));
+            patchList->ResourceBarrier((UINT)patch.size(), patch.data());
+            ThrowIfFailed(patchList->Close());
+            cmdsLists.push_back(patchList.Get());
+        }
+        cmdsLists.push_back(mStageLists[list].Get());
     }
+    mCommandQueue->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
+}
+
+UINT64 LampApp::CompletedFence()
+{
+    return mFence->GetCompletedValue();
+}
+
+void LampApp::WaitForFence(UINT64 fence)
+{
+    // Auto-reset, so it is ready for the next wait as soon as this one returns.
+    ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
+    WaitForSingleObject(mFenceEvent, INFINITE);
+}
+
+double LampApp::NowMs()
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void LampApp::Draw(const GameTimer& gt)
 {
-    auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
+    // Recompiled when a pass was enabled, disabled or redeclared since the last frame.
+    UpdateRenderGraph();
 
+    // Only patch lists are recorded from this one.
+    auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
     ThrowIfFailed(cmdListAlloc->Reset());
-    DrawPrePass(cmdListAlloc);
 
-    Voxelize(cmdListAlloc);
+    // PrePass, Voxelize, Screen and Blit record side by side and go out in one submission.
+    for (auto& states : mStageStates)
+        states.Begin(mHeaps->StateRegistry());
+    mRecorder.SetParallel(mParallelRecording == TRUE);
+    mRecorder.Record(*this);
+    mHeaps->StateRegistry().EndFrame();
     /*
     ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
 
@@ -249,10 +473,6 @@ void LampApp::Draw(const GameTimer& gt)
         mHeaps->GetResource(L"WorldProbeDebug")->Unmap(0, nullptr);
     }*/
 
-    DrawScreenPass(cmdListAlloc);
-
-    BlitToScreenPass(cmdListAlloc);
-
     isStart = false;
     mLastView = mCamera.GetView();
     mLastProj = mCamera.GetProj();
@@ -268,75 +488,187 @@ void LampApp::Draw(const GameTimer& gt)
     // Add an instruction to the command queue to set a new fence point. 
     // Because we are on the GPU timeline, the new fence point won't be set until the GPU finishes processing all the commands prior to this Signal().
     mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+    mPacer.EndFrame(mCurrentFence);
 }
 
-void LampApp::DrawPrePass(ComPtr<ID3D12CommandAllocator> cmdAlloc)
+void LampApp::BuildRenderGraph()
 {
-    ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), mPSO->GetPSO(L"opaque")));
+    mGraph.Clear();
+    mGraphPasses.clear();
+    mGraphResources.clear();
+    mGraphVersion = PassGraphVersion();
+
+    // Passes drawn each frame, in recording order. The blit pass is never drawn.
+    const std::vector<std::pair<std::wstring, FrameStage>> frame = {
+        { L"shadow_opaque", FrameStage::PrePass },
+        { L"GBuffer", FrameStage::PrePass },
+        { L"hiz", FrameStage::PrePass },
+        { L"ProbeND", FrameStage::PrePass },
+        { L"Voxelize", FrameStage::Voxelize },
+        { L"mipmap3D", FrameStage::Voxelize },
+        { L"anisoMipmap3D", FrameStage::Voxelize },
+        { L"WorldProbe", FrameStage::Voxelize },
+        { L"LampSDI", FrameStage::Screen },
+        { L"LampVDI", FrameStage::Screen },
+        { L"LampPDi", FrameStage::Screen },
+        { L"LampSH", FrameStage::Screen },
+        { L"deferLighting", FrameStage::Screen },
+        { L"LampRef", FrameStage::Screen },
+        { L"LampCDi", FrameStage::Screen },
+        { L"taa", FrameStage::Blit },
+    };
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mHeaps->CustomSRVHeap() };
-    mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    for (auto& entry : frame)
+    {
+        UINT index = FindPass(entry.first);
+        if (index == (UINT)mPasses.size())
+        {
+            std::wstring msg = L"Render graph: no pass named " + entry.first + L"\n";
+            OutputDebugString(msg.c_str());
+            continue;
+        }
 
-    // ForwardRenderPass();
-    // DrawSceneToShadowMap();
-    mPasses[0]->Draw(mCommandList.Get(), mCurrFrameResource); // MainLightShadow
-    mPasses[1]->Draw(mCommandList.Get(), mCurrFrameResource); // GBuffer
-    mPasses[6]->Draw(mCommandList.Get(), mCurrFrameResource); // Hiz
+        auto& pass = mPasses[index];
+        if (!pass->Enabled())
+            continue;
+        UINT id = mGraph.AddPass(entry.first, (UINT)entry.second, pass->GraphBarriers(), pass->Cullable());
+        for (auto& input : pass->Inputs())
+            mGraph.Read(id, input.Name, input.State);
+        for (auto& output : pass->Outputs())
+            mGraph.Write(id, output.Name, output.State);
+        mGraphPasses.push_back(index);
+    }
 
-    mPasses[9]->Draw(mCommandList.Get(), mCurrFrameResource); // Probe Normal Depth
-    // DrawSceneToRSM();
-    // Normal/depth pass.
-    // DrawNormalsAndDepth();
-    // DrawGBuffer();
-    // Add the command list to the queue for execution.
-    // 
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
+    if (!mGraph.Compile())
+        OutputDebugString(L"Render graph: dependencies contradict the command list order\n");
+    for (UINT r = 0; r < mGraph.ResourceCount(); ++r)
+        mGraphResources.push_back(mHeaps->FindResource(mGraph.ResourceName(r)));
+    OutputDebugString(mGraph.Dump().c_str());
+}
 
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+UINT LampApp::PassGraphVersion()const
+{
+    // Versions only grow, so the sum moves whenever any of them does.
+    UINT version = 0;
+    for (auto& pass : mPasses)
+        version += pass->GraphVersion();
+    return version;
 }
 
-void LampApp::Voxelize(ComPtr<ID3D12CommandAllocator> cmdAlloc)
+UINT LampApp::FindPass(const std::wstring& name)const
 {
-    ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), nullptr));
+    UINT index = 0;
+    while (index < (UINT)mPasses.size() && mPasses[index]->Name() != name)
+        index++;
+    return index;
+}
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mHeaps->CustomSRVHeap() };
-    mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+void LampApp::UpdateRenderGraph()
+{
+    if (PassGraphVersion() == mGraphVersion)
+        return;
 
-    mPasses[3]->Draw(mCommandList.Get(), mCurrFrameResource); // Voxelize
-    mPasses[5]->Draw(mCommandList.Get(), mCurrFrameResource); // Mipmap3D
-    mPasses[8]->Draw(mCommandList.Get(), mCurrFrameResource); // WorldProbe
+    // Transients are placed by schedule position, so nothing in flight may use them while they move.
+    FlushCommandQueue();
+    BuildRenderGraph();
+    BuildTransientLifetimes();
+    mHeaps->BuildTransients();
+}
 
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
+void LampApp::BuildTransientLifetimes()
+{
+    for (auto& pass : mPasses)
+    {
+        if (!pass->Enabled())
+            continue;
+        for (auto& name : pass->TransientOutputs())
+        {
+            // First and last schedule position that touches the resource.
+            UINT first = 0;
+            UINT last = 0;
+            if (!mGraph.Lifetime(name, first, last))
+            {
+                std::wstring msg = L"Transient " + name + L" is not written first in the frame, kept persistent\n";
+                OutputDebugString(msg.c_str());
+                continue;
+            }
+            mHeaps->SetTransientLifetime(name, first, last);
+        }
+    }
+}
 
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+void LampApp::DrawStage(FrameStage stage, ID3D12GraphicsCommandList* cmdList)
+{
+    // The tracker knows what the passes before left pending, so only the target state is passed on.
+    auto& states = mHeaps->States();
+    auto require = [&](const GraphBarrier& b)
+    {
+        ID3D12Resource* resource = mHeaps->Resource(mGraphResources[b.Resource]);
+        if (b.Uav)
+            states.Uav(resource);
+        else
+            states.Require(resource, b.After);
+    };
+
+    auto& schedule = mGraph.Schedule();
+    for (UINT pos = 0; pos < (UINT)schedule.size(); ++pos)
+    {
+        const GraphStep& step = schedule[pos];
+        if (mGraph.PassStage(step.Pass) != (UINT)stage)
+            continue;
+
+        // A transient starting here takes over memory an earlier one used this frame.
+        for (auto& b : mHeaps->TransientBarriers(pos))
+            states.Aliasing(b.Aliasing.pResourceBefore, b.Aliasing.pResourceAfter);
+        for (auto& b : step.Barriers)
+            require(b);
+
+        // Managed passes record no barriers of their own; the others flush
+        // together with their own transitions.
+        auto& pass = mPasses[mGraphPasses[step.Pass]];
+        if (pass->GraphBarriers())
+            states.Flush(cmdList);
+        pass->Draw(cmdList, mCurrFrameResource);
+
+        // Leave everything resting for the next frame.
+        if (pos + 1 == (UINT)schedule.size())
+        {
+            for (auto& b : mGraph.FinalBarriers())
+                require(b);
+        }
+    }
+
+    // Split barriers do not cross command lists.
+    states.FlushAll(cmdList);
 }
 
-void LampApp::DrawScreenPass(ComPtr<ID3D12CommandAllocator> cmdAlloc)
+void LampApp::DrawPrePass(ID3D12GraphicsCommandList* cmdList)
 {
-    ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), nullptr));
+    // ForwardRenderPass();
+    // DrawSceneToShadowMap();
+    DrawStage(FrameStage::PrePass, cmdList); // MainLightShadow, GBuffer, Hiz, Probe Normal Depth
+    // DrawSceneToRSM();
+    // Normal/depth pass.
+    // DrawNormalsAndDepth();
+    // DrawGBuffer();
+}
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mHeaps->CustomSRVHeap() };
-    mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+void LampApp::Voxelize(ID3D12GraphicsCommandList* cmdList)
+{
+    DrawStage(FrameStage::Voxelize, cmdList); // Voxelize, Mipmap3D, WorldProbe
+}
 
+void LampApp::DrawScreenPass(ID3D12GraphicsCommandList* cmdList)
+{
     // Compute SSAO.
     // SetRootSignature(L"ssao");
     // mSsao->ComputeSsao(mCommandList.Get(), mCurrFrameResource, 2);
 
     // Main rendering pass.
-    mPasses[10]->Draw(mCommandList.Get(), mCurrFrameResource); // ssdi
-    mPasses[11]->Draw(mCommandList.Get(), mCurrFrameResource); // vxdi
-    mPasses[12]->Draw(mCommandList.Get(), mCurrFrameResource); // probedi
-    mPasses[13]->Draw(mCommandList.Get(), mCurrFrameResource); // probe 2 SH
+    // ssdi, vxdi, probedi, probe 2 SH, DeferLighting, reflection, composite
+    DrawStage(FrameStage::Screen, cmdList);
     // mPasses[9]->Draw(mCommandList.Get(), mCurrFrameResource); // Probe gi
     // mPasses[4]->Draw(mCommandList.Get(), mCurrFrameResource); // vxgi
-    mPasses[2]->Draw(mCommandList.Get(), mCurrFrameResource); // DeferLighting
-
-    mPasses[14]->Draw(mCommandList.Get(), mCurrFrameResource); // reflection
-    mPasses[15]->Draw(mCommandList.Get(), mCurrFrameResource); // composite
     //DrawSky();
 
     // Indicate a state transition on the resource usage.
@@ -364,13 +696,6 @@ void LampApp::DrawScreenPass(ComPtr<ID3D12CommandAllocator> cmdAlloc)
         //Transition(mHistory.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
         //Transition(CurrentBackBuffer(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET);
     }
-
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
-
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 }
 
 void LampApp::ForwardRenderPass()
@@ -392,8 +717,8 @@ void LampApp::ForwardRenderPass()
     // Bind all the textures used in this scene.
     mCommandList->SetGraphicsRootDescriptorTable(4, mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(1, passCB);
 
     auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
     mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
@@ -408,60 +733,50 @@ void LampApp::ForwardRenderPass()
         D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 }
 
-void LampApp::BlitToScreenPass(ComPtr<ID3D12CommandAllocator> cmdAlloc)
+void LampApp::BlitToScreenPass(ID3D12GraphicsCommandList* cmdList)
 {
-    ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), nullptr));
-
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mHeaps->CustomSRVHeap() };
-    mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
     D3D12_RESOURCE_STATES GRstate = D3D12_RESOURCE_STATE_GENERIC_READ;
     D3D12_RESOURCE_STATES PRstate = D3D12_RESOURCE_STATE_PRESENT;
     D3D12_RESOURCE_STATES RTstate = D3D12_RESOURCE_STATE_RENDER_TARGET;
     D3D12_RESOURCE_STATES CDstate = D3D12_RESOURCE_STATE_COPY_DEST;
     D3D12_RESOURCE_STATES CSstate = D3D12_RESOURCE_STATE_COPY_SOURCE;
 
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), PRstate, RTstate));
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), PRstate, RTstate));
     float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    mCommandList->ClearRenderTargetView(CurrentBackBufferView(), clearColor, 0, nullptr);
-    mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), false, nullptr);
+    cmdList->ClearRenderTargetView(CurrentBackBufferView(), clearColor, 0, nullptr);
+    cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), false, nullptr);
 
-    mPasses[4]->Draw(mCommandList.Get(), mCurrFrameResource); // TAA
+    DrawStage(FrameStage::Blit, cmdList); // TAA
 
     std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
         CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), RTstate, CSstate),
         CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Current(), GRstate, CDstate)
     };
 
-    mCommandList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
-    mCommandList->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(mHeaps->Current(), 0),
+    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    cmdList->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(mHeaps->Current(), 0),
         0, 0, 0, &CD3DX12_TEXTURE_COPY_LOCATION(CurrentBackBuffer(), 0), nullptr);
 
     resourceBarriers = {
         CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), CSstate, RTstate),
         CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Current(), CDstate, GRstate)
     };
-    mCommandList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
 
     // Debug Layer
     if (showDebugView)
     {
-        SetRootSignature(L"debug");
+        cmdList->SetGraphicsRootSignature(mPSO->GetRootSignature(mDebugRootSig));
         CD3DX12_GPU_DESCRIPTOR_HANDLE DebugDescriptor(mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
         DebugDescriptor.Offset(2, mCbvSrvUavDescriptorSize);
-        auto passCB = mCurrFrameResource->PassCB->Resource();
-        mCommandList->SetGraphicsRootDescriptorTable(2, mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
-        mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+        auto passCB = mCurrFrameResource->PassCBAddress[0];
+        cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
+        cmdList->SetGraphicsRootConstantBufferView(1, passCB);
 
-        SetPSO(L"debug");
-        DrawRenderItems(mCommandList.Get(), mScene->RenderItems(RenderLayer::Debug));
+        cmdList->SetPipelineState(mPSO->GetPSO(mDebugPso));
+        DrawRenderItems(cmdList, mScene->RenderItems(RenderLayer::Debug));
     }
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), RTstate, PRstate));
-
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), RTstate, PRstate));
 }
 
 void LampApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -507,10 +822,7 @@ void LampApp::DrawSceneToRSM()
     mCommandList->OMSetRenderTargets(2, &mShadowMap->ColorRtv(), true, nullptr);
 
     // Bind the pass constant buffer for the shadow map pass.
-    UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1 * passCBByteSize;
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+    mCommandList->SetGraphicsRootConstantBufferView(1, mCurrFrameResource->PassCBAddress[1]);
 
     SetPSO(L"RSM");
 
@@ -536,8 +848,8 @@ void LampApp::DrawNormalsAndDepth()
 
     mCommandList->OMSetRenderTargets(1, &mSsao->NormalMapRtv(), true, &DepthStencilView());
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(1, passCB);
 
     SetPSO(L"drawNormals");
 
@@ -556,8 +868,8 @@ void LampApp::DrawSky()
 
     mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(1, passCB);
 
     // Bind the sky cube map. 
     mCommandList->SetGraphicsRootDescriptorTable(3, mHeaps->SkySrv());
@@ -613,8 +925,8 @@ void LampApp::Voxelize(ComPtr<ID3D12CommandAllocator> cmdAlloc)
     auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
     mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(1, passCB);
 
     mCommandList->SetGraphicsRootDescriptorTable(4, mHeaps->SkySrv());
     mCommandList->SetGraphicsRootDescriptorTable(3, mVoxel->VoxelGpuUav());
@@ -639,8 +951,8 @@ void LampApp::DrawCloud()
 
     SetPSO(L"cloud");
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(0, passCB);
     mCommandList->SetGraphicsRootDescriptorTable(1, mHeaps->OffscreenSrv());
     mCommandList->SetGraphicsRootDescriptorTable(2, mSsao->NormalMapSrv());
     mCommandList->SetGraphicsRootDescriptorTable(3, mVoxel->VoxelSrv());
@@ -657,8 +969,8 @@ void LampApp::DrawVXGI()
     mCommandList->OMSetRenderTargets(1, &mHeaps->Temp1Rtv(), true, nullptr);
     SetPSO(L"vxgi");
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(0, passCB);
     mCommandList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
     mCommandList->SetGraphicsRootDescriptorTable(2, mSsao->NormalMapSrv());
     mCommandList->SetGraphicsRootDescriptorTable(3, mVoxel->VoxelSrv());
@@ -669,7 +981,7 @@ void LampApp::DrawVXGI()
     SetRootSignature(L"composeVXGI");
     mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, nullptr);
     SetPSO(L"compositeVXGI");
-    mCommandList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    mCommandList->SetGraphicsRootConstantBufferView(0, passCB);
     mCommandList->SetGraphicsRootDescriptorTable(1, mHeaps->Temp1Srv());
     mCommandList->SetGraphicsRootDescriptorTable(2, mHeaps->OffscreenSrv());
     mCommandList->SetGraphicsRootDescriptorTable(3, mSsao->NormalMapSrv());
@@ -697,8 +1009,8 @@ void LampApp::DrawSSR()
 
     SetPSO(L"ssgi");
 
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = mCurrFrameResource->PassCBAddress[0];
+    mCommandList->SetGraphicsRootConstantBufferView(0, passCB);
     mCommandList->SetGraphicsRootDescriptorTable(1, mHeaps->OffscreenSrv());
     mCommandList->SetGraphicsRootDescriptorTable(2, mSsao->AmbientMapSrv());
     mCommandList->SetGraphicsRootDescriptorTable(3, mSsao->NormalMapSrv());
@@ -726,8 +1038,8 @@ void LampApp::DrawTAA()
 
     SetPSO(L"taa");
 
-    auto taaCB = mCurrFrameResource->TaaCB->Resource();
-    mCommandList->SetGraphicsRootConstantBufferView(0, taaCB->GetGPUVirtualAddress());
+    auto taaCB = mCurrFrameResource->TaaCBAddress;
+    mCommandList->SetGraphicsRootConstantBufferView(0, taaCB);
     mCommandList->SetGraphicsRootDescriptorTable(1, mHeaps->HistorySrv());
     mCommandList->SetGraphicsRootDescriptorTable(2, mSsao->DepthSrv());
 
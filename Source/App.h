@@ -3,12 +3,35 @@
 #include "./D3D/d3dApp.h"
 #include "./envir/Camera.h"
 #include "./main/geometry.h"
+#include "./main/OcclusionCulling.h"
+#include "./main/RenderGraph.h"
+#include "./main/FrameRecorder.h"
+#include "./main/FramePacer.h"
+#include "./main/ConstantBlocks.h"
+#include "./main/VoxelClipmap.h"
+#include "./main/VoxelBake.h"
+#include "./main/BrickMap.h"
+#include "./main/AnisoVoxels.h"
 #include "Pass/ShadowMap.h"
 
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
-class LampApp : public D3DApp
+// Command lists of a frame, in submission order.
+enum class FrameStage : UINT
+{
+    PrePass = 0,
+    Voxelize,
+    Screen,
+    Blit
+};
+
+constexpr UINT FrameStageCount = (UINT)FrameStage::Blit + 1;
+
+// Pass constant buffers per frame resource: the camera, then the shadow light.
+constexpr UINT PassCBCount = 2;
+
+class LampApp : public D3DApp, public LampCommandRecorder, public LampFrameTimeline
 {
 public:
     LampApp(HINSTANCE hInstance);
@@ -37,15 +60,41 @@ private:
     void UpdateShadowPassCB(const GameTimer& gt);
     void UpdateSsaoCB(const GameTimer& gt);
     void UpdateTaaCB(const GameTimer& gt);
+    void UpdateVoxels(const GameTimer& gt);
+    void UpdateVoxelBake();
+    void UpdateOcclusion(const GameTimer& gt);
+    void UpdateSceneDraws(const GameTimer& gt);
+    void UpdateInstanceBuffer(const GameTimer& gt);
 
     void InitialGraphics();
+    // The lit ones of mLightStrengths; the lighting passes specialize their shaders on them.
+    LampLightCounts SceneLightCounts()const;
+    void BuildRenderGraph();
+    void UpdateRenderGraph();
+    UINT PassGraphVersion()const;
+    // mPasses index of the pass named name, mPasses.size() when there is none.
+    UINT FindPass(const std::wstring& name)const;
+    void BuildTransientLifetimes();
     void BuildFrameResources();
-
-    void DrawPrePass( Microsoft::WRL::ComPtr<ID3D12CommandAllocator> cmdAlloc);
-    void Voxelize(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> cmdAlloc);
-    void DrawScreenPass( Microsoft::WRL::ComPtr<ID3D12CommandAllocator> cmdAlloc);
-    void BlitToScreenPass(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> cmdAlloc);
+    void BuildConstantBlocks();
+    void BuildFrameRecorder();
+
+    // Command list i records FrameStage i, each on its own thread and allocator.
+    virtual void Open(UINT list)override;
+    virtual void Close(UINT list)override;
+    virtual void Submit(const std::vector<UINT>& lists)override;
+
+    // The frame fence, waited on with one event made at startup.
+    virtual UINT64 CompletedFence()override;
+    virtual void WaitForFence(UINT64 fence)override;
+    virtual double NowMs()override;
+
+    void DrawPrePass(ID3D12GraphicsCommandList* cmdList);
+    void Voxelize(ID3D12GraphicsCommandList* cmdList);
+    void DrawScreenPass(ID3D12GraphicsCommandList* cmdList);
+    void BlitToScreenPass(ID3D12GraphicsCommandList* cmdList);
     void ForwardRenderPass();
+    void DrawStage(FrameStage stage, ID3D12GraphicsCommandList* cmdList);
 
     void DrawFullscreenQuad(ID3D12GraphicsCommandList* cmdList);
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
@@ -63,11 +112,31 @@ private:
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
+    // Picks mCurrFrameResourceIndex; F cycles its frames in flight.
+    LampFramePacer mPacer;
+    HANDLE mFenceEvent = nullptr;
 
     BOOL showDebugView = false;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
     std::vector<std::unique_ptr<RenderPass>> mPasses;
+    // Compiled once the passes exist and again when they change; transient
+    // lifetimes are measured over its schedule.
+    LampRenderGraph mGraph;
+    // PassGraphVersion() mGraph was compiled at.
+    UINT mGraphVersion = 0;
+    // mPasses index of each graph pass.
+    std::vector<UINT> mGraphPasses;
+    // Handle of each graph resource, so barriers resolve without a name lookup.
+    std::vector<ResourceHandle> mGraphResources;
+
+    LampFrameRecorder mRecorder;
+    std::array<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>, FrameStageCount> mStageLists;
+    // Each list tracks states on its own; the registry joins them at submission.
+    std::array<D3DStateTracker, FrameStageCount> mStageStates;
+    // Transitions a stage assumed wrongly, run just before it.
+    std::array<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>, FrameStageCount> mPatchLists;
+    BOOL mParallelRecording = true;
 
     UINT mOffScreenRTIndex = 0;
     UINT mSkyTexHeapIndex = 0;
@@ -85,14 +154,34 @@ private:
 
     PassConstants mMainPassCB;  // index 0 of pass cbuffer.
     PassConstants mShadowPassCB;// index 1 of pass cbuffer.
+    // Write only the blocks a frame resource's copy is missing.
+    // Pass copies are indexed frame resource * PassCBCount + pass, TAA copies by frame resource.
+    std::unique_ptr<LampConstantBlocks> mPassBlocks;
+    std::unique_ptr<LampConstantBlocks> mTaaBlocks;
 
     Camera mCamera;
 
     std::shared_ptr<DescriptorHeap> mHeaps;
 
     std::shared_ptr<LampPSO> mPSO;
+    PsoId mDebugPso;
+    RootSignatureId mDebugRootSig;
     std::shared_ptr<LampGeo> mScene;
 
+    std::unique_ptr<LampOcclusion> mOcclusion;
+    // Voxelize revoxelizes only the slabs its windows moved onto.
+    std::shared_ptr<LampVoxelClipmap> mVoxelClipmap;
+    // Static items are baked once; Voxelize injects them and rasterizes the dynamic ones.
+    std::shared_ptr<LampVoxelBake> mVoxelBake;
+    // A rebake runs as a background job of the thread pool while mVoxelBake stays in use;
+    // mRebakeDone is set by the job once mRebake is baked and saved.
+    std::unique_ptr<LampVoxelBake> mRebake;
+    std::atomic<bool> mRebakeDone{ false };
+    // Static items moved since the rebake in flight started.
+    bool mRebakeWanted = false;
+    std::vector<DirectX::BoundingBox> mDynamicBounds;
+    BOOL mOcclusionCulling = true;
+
     DirectX::BoundingSphere mSceneBounds;
 
     float mLightNearZ = 0.0f;
@@ -118,6 +207,12 @@ private:
         XMFLOAT3(0.0f, -0.707f, -0.707f)
     };
     XMFLOAT3 mRotatedLightDirections[3];
+    // A directional light of zero strength is left out of the lighting shaders.
+    XMFLOAT3 mLightStrengths[3] = {
+        XMFLOAT3(1.2f, 1.2f, 1.2f),
+        XMFLOAT3(0.0f, 0.0f, 0.0f),
+        XMFLOAT3(0.0f, 0.0f, 0.0f)
+    };
 
     POINT mLastMousePos;
 
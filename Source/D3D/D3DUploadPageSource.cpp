@@ -0,0 +1,31 @@
+#include "D3DUploadPageSource.h"
+
+static_assert(LinearUploadAllocator::DefaultAlignment == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT,
+    "Upload alignment differs from D3D12.");
+
+UploadPage D3DUploadPageSource::CreatePage(std::uint64_t size)
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(size),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&resource)));
+
+    UploadPage page;
+    ThrowIfFailed(resource->Map(0, nullptr, reinterpret_cast<void**>(&page.CPU)));
+    page.GPU = resource->GetGPUVirtualAddress();
+    page.Size = size;
+    page.Handle = resource.Detach();
+    return page;
+}
+
+void D3DUploadPageSource::DestroyPage(const UploadPage& page)
+{
+    auto resource = static_cast<ID3D12Resource*>(page.Handle);
+    resource->Unmap(0, nullptr);
+    resource->Release();
+}
+
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "UploadAllocator.h"
+
+// Committed upload-heap buffers, mapped for their whole lifetime.
+class D3DUploadPageSource : public UploadPageSource
+{
+public:
+    D3DUploadPageSource(ID3D12Device* device) : mDevice(device) {}
+
+    UploadPage CreatePage(std::uint64_t size) override;
+    void DestroyPage(const UploadPage& page) override;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+};
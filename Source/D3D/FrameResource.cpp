@@ -1,16 +1,35 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT listCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    SsaoCB = std::make_unique<UploadBuffer<SsaoConstants>>(device, 1, true);
-    TaaCB = std::make_unique<UploadBuffer<TaaConstants>>(device, 1, true);
+    ListAllocs.resize(listCount);
+    for (auto& alloc : ListAllocs)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(alloc.GetAddressOf())));
+    }
+
 	MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, false);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+
+    Upload = std::make_unique<LinearUploadAllocator>(std::make_shared<D3DUploadPageSource>(device));
+
+    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
+    TaaCB = std::make_unique<UploadBuffer<TaaConstants>>(device, 1, true);
+    for (UINT i = 0; i < passCount; ++i)
+        PassCBAddress.push_back(PassCB->Address(i));
+    TaaCBAddress = TaaCB->Address(0);
+}
+
+void FrameResource::Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount)
+{
+    ObjectCB->Resize(device, objectCount);
+    MaterialBuffer->Resize(device, materialCount);
 }
 
 FrameResource::~FrameResource()
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "UploadBuffer.h"
+#include "D3DUploadPageSource.h"
+#include "../../Shaders/ConstantLayout.hlsli"
 
 struct ObjectConstants
 {
@@ -12,34 +14,25 @@ struct ObjectConstants
     UINT     ObjPad2 = 0;
 };
 
-struct PassConstants
+// Per-instance data read through SV_InstanceID by instanced draws.
+struct InstanceData
 {
-    DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvView = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvViewProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 ViewProjTex = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 ShadowTransform = MathHelper::Identity4x4();
-    DirectX::XMFLOAT3 EyePosW = { 0.0f, 0.0f, 0.0f };
-    float cbPerObjectPad1 = 0.0f;
-    DirectX::XMFLOAT2 RenderTargetSize = { 0.0f, 0.0f };
-    DirectX::XMFLOAT2 InvRenderTargetSize = { 0.0f, 0.0f };
-    float NearZ = 0.0f;
-    float FarZ = 0.0f;
-    float TotalTime = 0.0f;
-    float DeltaTime = 0.0f;
-
-    DirectX::XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
-    Light Lights[MaxLights];
+    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+    UINT     MaterialIndex = 0;
+    UINT     InstPad0 = 0;
+    UINT     InstPad1 = 0;
+    UINT     InstPad2 = 0;
 };
 
+// Generated from the field lists the shaders use as well.
+using ConstantLayout::PassConstants;
+using ConstantLayout::TaaConstants;
+using ConstantLayout::VoxelSlabConstants;
+using ConstantLayout::VoxelClearConstants;
+using ConstantLayout::VoxelInjectConstants;
+using ConstantLayout::StaticVoxel;
+
 struct SsaoConstants
 {
     // DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -76,22 +69,6 @@ struct MaterialData
     UINT MaterialPad2 = 0;
 };
 
-struct TaaConstants
-{
-    DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvView = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 lastViewProj = MathHelper::Identity4x4();
-
-    DirectX::XMFLOAT2 offsets[9] = { DirectX::XMFLOAT2(0.0f, 0.0f) };
-
-    DirectX::XMFLOAT2 InvRenderTargetSize = { 0.0f, 0.0f };
-    float Influnce = 0.1f;
-    float TotalTime = 0.0f;
-};
-
 struct Vertex
 {
     DirectX::XMFLOAT3 position;
@@ -106,7 +83,7 @@ struct FrameResource
 {
 public:
 
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT listCount = 0);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -114,16 +91,32 @@ public:
     // We cannot reset the allocator until the GPU is done processing the commands.
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+    // One more per command list recorded on another thread; an allocator is not free-threaded.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> ListAllocs;
+
+    // Grows the per-object and per-material buffers; call after the frame fence has passed.
+    void Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount);
 
     // We cannot update a cbuffer until the GPU is done processing the commands
     // that reference it.  So each frame needs their own cbuffers.
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
+    // Object and material data persist across frames and are updated through dirty flags.
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-    std::unique_ptr<UploadBuffer<SsaoConstants>> SsaoCB = nullptr;
-    std::unique_ptr<UploadBuffer<TaaConstants>> TaaCB = nullptr;
-
     std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
 
+    // Everything rewritten each frame is sub-allocated here and reset on the frame fence.
+    std::unique_ptr<LinearUploadAllocator> Upload = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS SsaoCBAddress = 0;
+    // Pass and TAA constants persist, so only the blocks that changed are written.
+    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
+    std::unique_ptr<UploadBuffer<TaaConstants>> TaaCB = nullptr;
+    // Addresses of the PassCB elements and of TaaCB; fixed for the frame resource's lifetime.
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> PassCBAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS TaaCBAddress = 0;
+    // Rebuilt every frame from the visible items.
+    D3D12_GPU_VIRTUAL_ADDRESS InstanceBufferAddress = 0;
+    // Baked static voxels the Voxel pass injects this frame (LampVoxelBake::Gathered()).
+    D3D12_GPU_VIRTUAL_ADDRESS StaticVoxelAddress = 0;
+
     float time = 0;
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
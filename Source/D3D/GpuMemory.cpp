@@ -0,0 +1,197 @@
+#include "GpuMemory.h"
+
+GpuHeapAllocator::GpuHeapAllocator(ID3D12Device* device, UINT64 heapSize) :
+    mDevice(device),
+    mHeapSize(heapSize)
+{
+}
+
+GpuMemoryCategory GpuHeapAllocator::Categorize(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        return GpuMemoryCategory::Buffer;
+    if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+        return GpuMemoryCategory::RenderTarget;
+    return GpuMemoryCategory::Texture;
+}
+
+UINT GpuHeapAllocator::CreateHeap(D3D12_HEAP_TYPE heapType, GpuMemoryCategory category)
+{
+    D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    if (category == GpuMemoryCategory::Texture)
+        flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+    else if (category == GpuMemoryCategory::RenderTarget)
+        flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+    CD3DX12_HEAP_DESC heapDesc(mHeapSize, heapType,
+        D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, flags);
+
+    HeapPool pool;
+    ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&pool.Heap)));
+    pool.Type = heapType;
+    pool.Category = category;
+    pool.Allocator = std::make_unique<TlsfAllocator>(mHeapSize, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT);
+    mHeaps.push_back(std::move(pool));
+
+    std::wstring msg = L"GpuMemory: new " + std::to_wstring(mHeapSize >> 20) + L" MB heap, category "
+        + std::to_wstring((int)category) + L"\n";
+    OutputDebugString(msg.c_str());
+    return (UINT)mHeaps.size() - 1;
+}
+
+GpuAllocation GpuHeapAllocator::CreateResource(const D3D12_RESOURCE_DESC& desc,
+    D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state,
+    const D3D12_CLEAR_VALUE* optClear,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& resource)
+{
+    GpuAllocation alloc;
+    alloc.Category = Categorize(desc);
+
+    // Ask for the small alignment first; the device refuses it for larger textures.
+    D3D12_RESOURCE_DESC placedDesc = desc;
+    D3D12_RESOURCE_ALLOCATION_INFO info;
+    if (alloc.Category == GpuMemoryCategory::Texture && desc.SampleDesc.Count <= 1)
+    {
+        placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+        {
+            placedDesc.Alignment = 0;
+            info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        }
+    }
+    else
+    {
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+    }
+    alloc.Size = info.SizeInBytes;
+
+    // MSAA targets and oversized resources keep their own allocation.
+    if (info.SizeInBytes > mHeapSize || info.Alignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+        return CreateCommittedResource(desc, heapType, state, optClear, resource);
+
+    for (UINT i = 0; i < (UINT)mHeaps.size() && alloc.Committed(); ++i)
+    {
+        if (mHeaps[i].Type != heapType || mHeaps[i].Category != alloc.Category)
+            continue;
+        UINT block = mHeaps[i].Allocator->Allocate(info.SizeInBytes, info.Alignment);
+        if (block != TlsfAllocator::InvalidBlock)
+        {
+            alloc.Heap = i;
+            alloc.Block = block;
+        }
+    }
+    if (alloc.Committed())
+    {
+        alloc.Heap = CreateHeap(heapType, alloc.Category);
+        alloc.Block = mHeaps[alloc.Heap].Allocator->Allocate(info.SizeInBytes, info.Alignment);
+    }
+    alloc.Offset = mHeaps[alloc.Heap].Allocator->Offset(alloc.Block);
+
+    ThrowIfFailed(mDevice->CreatePlacedResource(
+        mHeaps[alloc.Heap].Heap.Get(),
+        alloc.Offset,
+        &placedDesc,
+        state,
+        optClear,
+        IID_PPV_ARGS(&resource)));
+    return alloc;
+}
+
+GpuAllocation GpuHeapAllocator::CreateCommittedResource(const D3D12_RESOURCE_DESC& desc,
+    D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state,
+    const D3D12_CLEAR_VALUE* optClear,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& resource)
+{
+    GpuAllocation alloc;
+    alloc.Category = Categorize(desc);
+    alloc.Size = mDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(heapType),
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        state,
+        optClear,
+        IID_PPV_ARGS(&resource)));
+    mCommittedCount[(int)alloc.Category]++;
+    mCommittedBytes[(int)alloc.Category] += alloc.Size;
+    return alloc;
+}
+
+void GpuHeapAllocator::Free(const GpuAllocation& alloc)
+{
+    if (alloc.Committed())
+    {
+        mCommittedCount[(int)alloc.Category]--;
+        mCommittedBytes[(int)alloc.Category] -= alloc.Size;
+        return;
+    }
+    mHeaps[alloc.Heap].Allocator->Free(alloc.Block);
+}
+
+ID3D12Heap* GpuHeapAllocator::Heap(const GpuAllocation& alloc)const
+{
+    return alloc.Committed() ? nullptr : mHeaps[alloc.Heap].Heap.Get();
+}
+
+UINT GpuHeapAllocator::Defragment(UINT maxMoves,
+    const std::function<bool(const GpuAllocation& from, const GpuAllocation& to)>& move)
+{
+    UINT moves = 0;
+    for (UINT i = 0; i < (UINT)mHeaps.size() && moves < maxMoves; ++i)
+    {
+        moves += mHeaps[i].Allocator->Defragment(maxMoves - moves, [&](const TlsfMove& m)
+        {
+            GpuAllocation from;
+            from.Heap = i;
+            from.Block = m.OldBlock;
+            from.Offset = m.OldOffset;
+            from.Size = m.Size;
+            from.Category = mHeaps[i].Category;
+
+            GpuAllocation to = from;
+            to.Block = m.NewBlock;
+            to.Offset = m.NewOffset;
+            return move(from, to);
+        });
+    }
+    return moves;
+}
+
+GpuMemoryStats GpuHeapAllocator::Stats(GpuMemoryCategory category)const
+{
+    GpuMemoryStats stats;
+    for (auto& heap : mHeaps)
+    {
+        if (heap.Category != category)
+            continue;
+        TlsfStats heapStats = heap.Allocator->Stats();
+        stats.Heaps++;
+        stats.HeapBytes += heapStats.TotalBytes;
+        stats.UsedBytes += heapStats.UsedBytes;
+        stats.PlacedResources += heapStats.Allocations;
+        stats.LargestFreeBlock = std::max<UINT64>(stats.LargestFreeBlock, heapStats.LargestFreeBlock);
+    }
+    stats.CommittedResources = mCommittedCount[(int)category];
+    stats.CommittedBytes = mCommittedBytes[(int)category];
+    return stats;
+}
+
+std::wstring GpuHeapAllocator::Report()const
+{
+    const wchar_t* names[] = { L"buffers", L"textures", L"render targets" };
+
+    std::wstring msg;
+    for (int c = 0; c < (int)GpuMemoryCategory::Count; ++c)
+    {
+        GpuMemoryStats stats = Stats((GpuMemoryCategory)c);
+        msg += L"GpuMemory " + std::wstring(names[c]) + L": "
+            + std::to_wstring(stats.PlacedResources) + L" placed, "
+            + std::to_wstring(stats.UsedBytes >> 10) + L"/" + std::to_wstring(stats.HeapBytes >> 10)
+            + L" KB in " + std::to_wstring(stats.Heaps) + L" heaps, fragmentation "
+            + std::to_wstring(stats.Fragmentation()) + L", committed "
+            + std::to_wstring(stats.CommittedResources) + L" (" + std::to_wstring(stats.CommittedBytes >> 10) + L" KB)\n";
+    }
+    return msg;
+}
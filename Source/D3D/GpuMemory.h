@@ -0,0 +1,104 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "TlsfAllocator.h"
+
+// Resource heap tier 1 cannot mix these in one heap, so each gets its own pool.
+enum class GpuMemoryCategory : int
+{
+    Buffer = 0,
+    Texture,
+    RenderTarget,
+    Count
+};
+
+struct GpuAllocation
+{
+    static const UINT CommittedHeap = 0xffffffff;
+
+    UINT Heap = CommittedHeap;
+    UINT Block = TlsfAllocator::InvalidBlock;
+    UINT64 Offset = 0;
+    UINT64 Size = 0;
+    GpuMemoryCategory Category = GpuMemoryCategory::Buffer;
+
+    bool Committed()const { return Heap == CommittedHeap; }
+};
+
+struct GpuMemoryStats
+{
+    UINT Heaps = 0;
+    UINT64 HeapBytes = 0;
+    UINT64 UsedBytes = 0;
+    UINT64 LargestFreeBlock = 0;
+    UINT PlacedResources = 0;
+    // Resources too large or too strictly aligned for a pool heap.
+    UINT CommittedResources = 0;
+    UINT64 CommittedBytes = 0;
+
+    float Fragmentation()const
+    {
+        UINT64 freeBytes = HeapBytes - UsedBytes;
+        return freeBytes == 0 ? 0.0f : 1.0f - (float)LargestFreeBlock / (float)freeBytes;
+    }
+};
+
+// Places GPU resources in large ID3D12Heaps, one TLSF allocator per heap,
+// instead of giving every resource its own committed allocation.
+// Heaps are pooled by heap type and category. Small textures take the 4KB
+// placement alignment when the device allows it, everything else 64KB.
+// Only the named resources of DescriptorHeap come through here; DDS and glTF
+// textures, d3dUtil default buffers and UploadBuffers stay committed.
+class GpuHeapAllocator
+{
+public:
+    GpuHeapAllocator(ID3D12Device* device, UINT64 heapSize = 64ull * 1024 * 1024);
+    GpuHeapAllocator(const GpuHeapAllocator& rhs) = delete;
+    GpuHeapAllocator& operator=(const GpuHeapAllocator& rhs) = delete;
+    ~GpuHeapAllocator() = default;
+
+    GpuAllocation CreateResource(const D3D12_RESOURCE_DESC& desc,
+        D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state,
+        const D3D12_CLEAR_VALUE* optClear,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& resource);
+
+    // Its own zero-filled allocation, counted with the other committed resources.
+    GpuAllocation CreateCommittedResource(const D3D12_RESOURCE_DESC& desc,
+        D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state,
+        const D3D12_CLEAR_VALUE* optClear,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& resource);
+
+    // The resource must already be released and no longer in use by the GPU.
+    void Free(const GpuAllocation& alloc);
+
+    ID3D12Heap* Heap(const GpuAllocation& alloc)const;
+
+    // Offers placed allocations lower slots in their heap. move() places a new
+    // resource at 'to' and copies the contents; true releases 'from', false
+    // keeps it. The caller owns the GPU work and the GpuAllocation bookkeeping.
+    UINT Defragment(UINT maxMoves,
+        const std::function<bool(const GpuAllocation& from, const GpuAllocation& to)>& move);
+
+    GpuMemoryStats Stats(GpuMemoryCategory category)const;
+    std::wstring Report()const;
+
+    static GpuMemoryCategory Categorize(const D3D12_RESOURCE_DESC& desc);
+
+private:
+    struct HeapPool
+    {
+        Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+        D3D12_HEAP_TYPE Type;
+        GpuMemoryCategory Category;
+        std::unique_ptr<TlsfAllocator> Allocator;
+    };
+
+    UINT CreateHeap(D3D12_HEAP_TYPE heapType, GpuMemoryCategory category);
+
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    UINT64 mHeapSize;
+
+    std::vector<HeapPool> mHeaps;
+    UINT mCommittedCount[(int)GpuMemoryCategory::Count] = {};
+    UINT64 mCommittedBytes[(int)GpuMemoryCategory::Count] = {};
+};
@@ -0,0 +1,354 @@
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <cassert>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static std::uint32_t HighestBit(std::uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (std::uint32_t)index;
+#else
+    return 63 - (std::uint32_t)__builtin_clzll(v);
+#endif
+}
+
+static std::uint32_t LowestBit(std::uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (std::uint32_t)index;
+#else
+    return (std::uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+static std::uint64_t AlignUp(std::uint64_t v, std::uint64_t alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+TlsfAllocator::TlsfAllocator(std::uint64_t size, std::uint64_t granularity)
+{
+    assert(granularity > 0 && (granularity & (granularity - 1)) == 0);
+    mGranularity = granularity;
+    mGranularityLog2 = HighestBit(granularity);
+    mSize = size & ~(granularity - 1);
+
+    for (std::uint32_t fl = 0; fl < FLCount; ++fl)
+        for (std::uint32_t sl = 0; sl < SLCount; ++sl)
+            mFreeHeads[fl][sl] = InvalidBlock;
+
+    // Block 0 always starts the physical list: splits keep the front part.
+    std::uint32_t block = NewBlock();
+    mBlocks[block].Offset = 0;
+    mBlocks[block].Size = mSize;
+    if (mSize > 0)
+        InsertFree(block);
+}
+
+void TlsfAllocator::Mapping(std::uint64_t units, std::uint32_t& fl, std::uint32_t& sl)const
+{
+    if (units < SLCount)
+    {
+        fl = 0;
+        sl = (std::uint32_t)units;
+        return;
+    }
+    std::uint32_t f = HighestBit(units);
+    sl = (std::uint32_t)(units >> (f - SLBits)) & (SLCount - 1);
+    fl = f - SLBits + 1;
+}
+
+std::uint32_t TlsfAllocator::FindFree(std::uint64_t size, std::uint64_t alignment)const
+{
+    std::uint64_t units = size >> mGranularityLog2;
+    // Worst case padding to reach the alignment inside a granular block.
+    if (alignment > mGranularity)
+        units += (alignment >> mGranularityLog2) - 1;
+
+    // Round up to the next bucket so every block found is large enough.
+    if (units >= SLCount)
+        units += (1ull << (HighestBit(units) - SLBits)) - 1;
+
+    std::uint32_t fl, sl;
+    Mapping(units, fl, sl);
+    if (fl >= FLCount)
+        return InvalidBlock;
+
+    std::uint32_t slMap = mSLBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        std::uint64_t flMap = fl + 1 < FLCount ? mFLBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0)
+            return InvalidBlock;
+        fl = LowestBit(flMap);
+        slMap = mSLBitmap[fl];
+    }
+    sl = LowestBit(slMap);
+    return mFreeHeads[fl][sl];
+}
+
+void TlsfAllocator::InsertFree(std::uint32_t block)
+{
+    std::uint32_t fl, sl;
+    Mapping(mBlocks[block].Size >> mGranularityLog2, fl, sl);
+
+    Block& b = mBlocks[block];
+    std::uint32_t head = mFreeHeads[fl][sl];
+    b.Free = true;
+    b.PrevFree = InvalidBlock;
+    b.NextFree = head;
+    if (head != InvalidBlock)
+        mBlocks[head].PrevFree = block;
+    mFreeHeads[fl][sl] = block;
+
+    mSLBitmap[fl] |= 1u << sl;
+    mFLBitmap |= 1ull << fl;
+}
+
+void TlsfAllocator::RemoveFree(std::uint32_t block)
+{
+    std::uint32_t fl, sl;
+    Mapping(mBlocks[block].Size >> mGranularityLog2, fl, sl);
+
+    Block& b = mBlocks[block];
+    if (b.PrevFree != InvalidBlock)
+        mBlocks[b.PrevFree].NextFree = b.NextFree;
+    if (b.NextFree != InvalidBlock)
+        mBlocks[b.NextFree].PrevFree = b.PrevFree;
+
+    if (mFreeHeads[fl][sl] == block)
+    {
+        mFreeHeads[fl][sl] = b.NextFree;
+        if (b.NextFree == InvalidBlock)
+        {
+            mSLBitmap[fl] &= ~(1u << sl);
+            if (mSLBitmap[fl] == 0)
+                mFLBitmap &= ~(1ull << fl);
+        }
+    }
+    b.PrevFree = InvalidBlock;
+    b.NextFree = InvalidBlock;
+    b.Free = false;
+}
+
+std::uint32_t TlsfAllocator::NewBlock()
+{
+    if (!mUnusedBlocks.empty())
+    {
+        std::uint32_t block = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+        mBlocks[block] = Block();
+        return block;
+    }
+    mBlocks.emplace_back();
+    return (std::uint32_t)mBlocks.size() - 1;
+}
+
+void TlsfAllocator::ReleaseBlock(std::uint32_t block)
+{
+    mUnusedBlocks.push_back(block);
+}
+
+std::uint32_t TlsfAllocator::Split(std::uint32_t block, std::uint64_t size)
+{
+    std::uint32_t tail = NewBlock();
+    Block& b = mBlocks[block];
+    Block& t = mBlocks[tail];
+
+    t.Offset = b.Offset + size;
+    t.Size = b.Size - size;
+    t.PrevPhys = block;
+    t.NextPhys = b.NextPhys;
+    if (b.NextPhys != InvalidBlock)
+        mBlocks[b.NextPhys].PrevPhys = tail;
+    b.NextPhys = tail;
+    b.Size = size;
+    return tail;
+}
+
+std::uint32_t TlsfAllocator::Place(std::uint32_t block, std::uint64_t size, std::uint64_t alignment)
+{
+    RemoveFree(block);
+
+    std::uint64_t offset = mBlocks[block].Offset;
+    std::uint64_t aligned = AlignUp(offset, std::max<std::uint64_t>(alignment, mGranularity));
+    if (aligned > offset)
+    {
+        // The padding in front stays free; its previous neighbour is in use.
+        std::uint32_t tail = Split(block, aligned - offset);
+        InsertFree(block);
+        block = tail;
+    }
+    if (mBlocks[block].Size > size)
+    {
+        std::uint32_t tail = Split(block, size);
+        InsertFree(tail);
+    }
+
+    mBlocks[block].Free = false;
+    mBlocks[block].Alignment = alignment;
+    mUsedBytes += size;
+    mAllocations++;
+    return block;
+}
+
+std::uint32_t TlsfAllocator::Allocate(std::uint64_t size, std::uint64_t alignment)
+{
+    assert(alignment == 0 || (alignment & (alignment - 1)) == 0);
+    size = AlignUp(std::max<std::uint64_t>(size, 1), mGranularity);
+
+    std::uint32_t block = FindFree(size, alignment);
+    if (block == InvalidBlock)
+        return InvalidBlock;
+    return Place(block, size, alignment);
+}
+
+void TlsfAllocator::Free(std::uint32_t block)
+{
+    assert(!mBlocks[block].Free);
+    mUsedBytes -= mBlocks[block].Size;
+    mAllocations--;
+
+    // Coalesce with free physical neighbours.
+    std::uint32_t prev = mBlocks[block].PrevPhys;
+    if (prev != InvalidBlock && mBlocks[prev].Free)
+    {
+        RemoveFree(prev);
+        mBlocks[prev].Size += mBlocks[block].Size;
+        mBlocks[prev].NextPhys = mBlocks[block].NextPhys;
+        if (mBlocks[block].NextPhys != InvalidBlock)
+            mBlocks[mBlocks[block].NextPhys].PrevPhys = prev;
+        ReleaseBlock(block);
+        block = prev;
+    }
+
+    std::uint32_t next = mBlocks[block].NextPhys;
+    if (next != InvalidBlock && mBlocks[next].Free)
+    {
+        RemoveFree(next);
+        mBlocks[block].Size += mBlocks[next].Size;
+        mBlocks[block].NextPhys = mBlocks[next].NextPhys;
+        if (mBlocks[next].NextPhys != InvalidBlock)
+            mBlocks[mBlocks[next].NextPhys].PrevPhys = block;
+        ReleaseBlock(next);
+    }
+
+    InsertFree(block);
+}
+
+TlsfStats TlsfAllocator::Stats()const
+{
+    TlsfStats stats;
+    stats.TotalBytes = mSize;
+    stats.UsedBytes = mUsedBytes;
+    stats.Allocations = mAllocations;
+
+    for (std::uint32_t fl = 0; fl < FLCount; ++fl)
+    {
+        for (std::uint32_t sl = 0; sl < SLCount; ++sl)
+        {
+            for (std::uint32_t b = mFreeHeads[fl][sl]; b != InvalidBlock; b = mBlocks[b].NextFree)
+            {
+                stats.FreeBlocks++;
+                stats.LargestFreeBlock = std::max<std::uint64_t>(stats.LargestFreeBlock, mBlocks[b].Size);
+            }
+        }
+    }
+    return stats;
+}
+
+std::uint32_t TlsfAllocator::Defragment(std::uint32_t maxMoves, const std::function<bool(const TlsfMove&)>& move)
+{
+    std::vector<std::uint32_t> used;
+    for (std::uint32_t b = 0; b != InvalidBlock; b = mBlocks[b].NextPhys)
+    {
+        if (!mBlocks[b].Free && mBlocks[b].Size > 0)
+            used.push_back(b);
+    }
+
+    std::uint32_t moves = 0;
+    for (auto it = used.rbegin(); it != used.rend() && moves < maxMoves; ++it)
+    {
+        std::uint32_t block = *it;
+        std::uint64_t offset = mBlocks[block].Offset;
+        std::uint64_t size = mBlocks[block].Size;
+        std::uint64_t alignment = mBlocks[block].Alignment;
+
+        std::uint32_t candidate = FindFree(size, alignment);
+        if (candidate == InvalidBlock || mBlocks[candidate].Offset > offset)
+            continue;
+
+        std::uint32_t newBlock = Place(candidate, size, alignment);
+        TlsfMove m = { block, newBlock, offset, mBlocks[newBlock].Offset, size };
+        if (move(m))
+        {
+            Free(block);
+            moves++;
+        }
+        else
+        {
+            Free(newBlock);
+        }
+    }
+    return moves;
+}
+
+bool TlsfAllocator::Validate()const
+{
+    std::uint64_t offset = 0;
+    std::uint64_t used = 0;
+    std::uint32_t allocations = 0;
+    std::uint32_t freeBlocks = 0;
+    bool prevFree = false;
+    std::uint32_t prev = InvalidBlock;
+    for (std::uint32_t b = 0; b != InvalidBlock; b = mBlocks[b].NextPhys)
+    {
+        const Block& block = mBlocks[b];
+        if (block.Offset != offset || block.PrevPhys != prev)
+            return false;
+        if (block.Free && prevFree)
+            return false;
+        if (block.Free)
+        {
+            freeBlocks++;
+            std::uint32_t fl, sl;
+            Mapping(block.Size >> mGranularityLog2, fl, sl);
+            if ((mSLBitmap[fl] & (1u << sl)) == 0 || (mFLBitmap & (1ull << fl)) == 0)
+                return false;
+        }
+        else if (block.Size > 0)
+        {
+            used += block.Size;
+            allocations++;
+        }
+        offset += block.Size;
+        prevFree = block.Free;
+        prev = b;
+    }
+    if (offset != mSize || used != mUsedBytes || allocations != mAllocations)
+        return false;
+
+    std::uint32_t listed = 0;
+    for (std::uint32_t fl = 0; fl < FLCount; ++fl)
+    {
+        for (std::uint32_t sl = 0; sl < SLCount; ++sl)
+        {
+            bool bit = (mSLBitmap[fl] & (1u << sl)) != 0;
+            if (bit != (mFreeHeads[fl][sl] != InvalidBlock))
+                return false;
+            for (std::uint32_t b = mFreeHeads[fl][sl]; b != InvalidBlock; b = mBlocks[b].NextFree)
+            {
+                if (!mBlocks[b].Free)
+                    return false;
+                listed++;
+            }
+        }
+    }
+    return listed == freeBlocks;
+}
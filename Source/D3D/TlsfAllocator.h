@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct TlsfStats
+{
+    std::uint64_t TotalBytes = 0;
+    std::uint64_t UsedBytes = 0;
+    std::uint64_t LargestFreeBlock = 0;
+    std::uint32_t Allocations = 0;
+    std::uint32_t FreeBlocks = 0;
+
+    // 0 when all free space is one block, towards 1 as it splinters.
+    float Fragmentation()const
+    {
+        std::uint64_t freeBytes = TotalBytes - UsedBytes;
+        return freeBytes == 0 ? 0.0f : 1.0f - (float)LargestFreeBlock / (float)freeBytes;
+    }
+};
+
+// A relocation proposed by TlsfAllocator::Defragment.
+struct TlsfMove
+{
+    std::uint32_t OldBlock;
+    std::uint32_t NewBlock;
+    std::uint64_t OldOffset;
+    std::uint64_t NewOffset;
+    std::uint64_t Size;
+};
+
+// Two-level segregated fit allocator over an abstract [0, size) range.
+// It only hands out offsets, so the same core places resources in the
+// ID3D12Heaps of GpuMemory.h and runs without a device. Allocation and free
+// are O(1): a first-level bucket per power of two, split linearly into 16
+// second-level buckets, with bitmaps to find the first non-empty one.
+class TlsfAllocator
+{
+public:
+    static const std::uint32_t InvalidBlock = 0xffffffff;
+
+    // Every offset and size is a multiple of granularity (a power of two).
+    TlsfAllocator(std::uint64_t size, std::uint64_t granularity = 256);
+    TlsfAllocator(const TlsfAllocator& rhs) = delete;
+    TlsfAllocator& operator=(const TlsfAllocator& rhs) = delete;
+    ~TlsfAllocator() = default;
+
+    // Returns InvalidBlock when no free range can hold the request.
+    std::uint32_t Allocate(std::uint64_t size, std::uint64_t alignment = 0);
+    void Free(std::uint32_t block);
+
+    std::uint64_t Offset(std::uint32_t block)const { return mBlocks[block].Offset; }
+    std::uint64_t Size(std::uint32_t block)const { return mBlocks[block].Size; }
+    bool Empty()const { return mAllocations == 0; }
+
+    TlsfStats Stats()const;
+
+    // Defragmentation hook: walks allocations from the top of the range down and
+    // offers each one a lower free slot. move() copies the data and returns true to
+    // accept, after which OldBlock is released; false keeps the old placement.
+    std::uint32_t Defragment(std::uint32_t maxMoves, const std::function<bool(const TlsfMove&)>& move);
+
+    // Checks the physical list, free lists and bitmaps against each other.
+    bool Validate()const;
+
+private:
+    static const std::uint32_t SLBits = 4;
+    static const std::uint32_t SLCount = 1 << SLBits;
+    static const std::uint32_t FLCount = 64;
+
+    struct Block
+    {
+        std::uint64_t Offset = 0;
+        std::uint64_t Size = 0;
+        std::uint64_t Alignment = 0;
+        std::uint32_t PrevPhys = InvalidBlock;
+        std::uint32_t NextPhys = InvalidBlock;
+        std::uint32_t PrevFree = InvalidBlock;
+        std::uint32_t NextFree = InvalidBlock;
+        bool Free = false;
+    };
+
+    void Mapping(std::uint64_t units, std::uint32_t& fl, std::uint32_t& sl)const;
+    std::uint32_t FindFree(std::uint64_t size, std::uint64_t alignment)const;
+    void InsertFree(std::uint32_t block);
+    void RemoveFree(std::uint32_t block);
+    std::uint32_t NewBlock();
+    void ReleaseBlock(std::uint32_t block);
+    // Splits size bytes off the front of block; the tail becomes a new block.
+    std::uint32_t Split(std::uint32_t block, std::uint64_t size);
+    std::uint32_t Place(std::uint32_t block, std::uint64_t size, std::uint64_t alignment);
+
+    std::uint64_t mSize;
+    std::uint64_t mGranularity;
+    std::uint32_t mGranularityLog2;
+
+    std::vector<Block> mBlocks;
+    std::vector<std::uint32_t> mUnusedBlocks;
+
+    std::uint64_t mFLBitmap = 0;
+    std::uint32_t mSLBitmap[FLCount] = {};
+    std::uint32_t mFreeHeads[FLCount][SLCount];
+
+    std::uint64_t mUsedBytes = 0;
+    std::uint32_t mAllocations = 0;
+};
@@ -0,0 +1,73 @@
+#include "UploadAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+constexpr std::uint64_t LinearUploadAllocator::DefaultAlignment;
+
+LinearUploadAllocator::LinearUploadAllocator(std::shared_ptr<UploadPageSource> source, std::uint64_t pageSize) :
+    mSource(source),
+    mPageSize(pageSize)
+{
+    mPages.push_back(mSource->CreatePage(mPageSize));
+}
+
+LinearUploadAllocator::~LinearUploadAllocator()
+{
+    for (auto& page : mPages)
+        mSource->DestroyPage(page);
+}
+
+UploadAllocation LinearUploadAllocator::Allocate(std::uint64_t size, std::uint64_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    std::uint64_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+    while (offset + size > mPages[mCurrent].Size)
+    {
+        // Move on to a retained page, or grow by one big enough for this request.
+        mUsedBytes += mPages[mCurrent].Size - mOffset;
+        mCurrent++;
+        mOffset = 0;
+        offset = 0;
+        if (mCurrent == mPages.size())
+            mPages.push_back(mSource->CreatePage(std::max<std::uint64_t>(mPageSize, size)));
+    }
+
+    UploadAllocation alloc;
+    alloc.CPU = mPages[mCurrent].CPU + offset;
+    alloc.GPU = mPages[mCurrent].GPU + offset;
+    alloc.Size = size;
+
+    mUsedBytes += offset + size - mOffset;
+    mOffset = offset + size;
+    return alloc;
+}
+
+void LinearUploadAllocator::Reset()
+{
+    if (mCurrent > 0)
+    {
+        // Replace the spilled pages with one page that would have held the whole frame.
+        std::uint64_t size = mPageSize;
+        while (size < mUsedBytes)
+            size *= 2;
+
+        for (auto& page : mPages)
+            mSource->DestroyPage(page);
+        mPages.clear();
+        mPages.push_back(mSource->CreatePage(size));
+        mPageSize = size;
+    }
+
+    mCurrent = 0;
+    mOffset = 0;
+    mUsedBytes = 0;
+}
+
+std::uint64_t LinearUploadAllocator::CapacityBytes()const
+{
+    std::uint64_t capacity = 0;
+    for (auto& page : mPages)
+        capacity += page.Size;
+    return capacity;
+}
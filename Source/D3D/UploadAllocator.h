@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// A sub-allocation inside a mapped upload page.
+struct UploadAllocation
+{
+    std::uint8_t* CPU = nullptr;
+    // D3D12_GPU_VIRTUAL_ADDRESS in the app.
+    std::uint64_t GPU = 0;
+    std::uint64_t Size = 0;
+};
+
+// One persistently mapped block of upload memory.
+struct UploadPage
+{
+    std::uint8_t* CPU = nullptr;
+    std::uint64_t GPU = 0;
+    std::uint64_t Size = 0;
+    void* Handle = nullptr;
+};
+
+// Backing store of LinearUploadAllocator. Kept abstract so the allocator
+// itself never touches the device: D3DUploadPageSource.h maps upload heaps.
+class UploadPageSource
+{
+public:
+    virtual ~UploadPageSource() = default;
+    virtual UploadPage CreatePage(std::uint64_t size) = 0;
+    virtual void DestroyPage(const UploadPage& page) = 0;
+};
+
+// Per-frame bump allocator over upload pages.
+// Allocations live until Reset(), which the owner calls once the GPU fence of
+// the frame has passed. A frame that spills into extra pages makes Reset()
+// fold them into one larger page, so the steady state is a single block.
+class LinearUploadAllocator
+{
+public:
+    // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, what constant buffers need.
+    static constexpr std::uint64_t DefaultAlignment = 256;
+
+    LinearUploadAllocator(std::shared_ptr<UploadPageSource> source, std::uint64_t pageSize = 64 * 1024);
+    LinearUploadAllocator(const LinearUploadAllocator& rhs) = delete;
+    LinearUploadAllocator& operator=(const LinearUploadAllocator& rhs) = delete;
+    ~LinearUploadAllocator();
+
+    // Alignment must be a power of two.
+    UploadAllocation Allocate(std::uint64_t size, std::uint64_t alignment = DefaultAlignment);
+
+    template<typename T>
+    UploadAllocation Upload(const T& data, std::uint64_t alignment = DefaultAlignment)
+    {
+        UploadAllocation alloc = Allocate(sizeof(T), alignment);
+        std::memcpy(alloc.CPU, &data, sizeof(T));
+        return alloc;
+    }
+
+    template<typename T>
+    UploadAllocation Upload(const T* data, std::uint32_t count, std::uint64_t alignment = DefaultAlignment)
+    {
+        UploadAllocation alloc = Allocate((std::uint64_t)sizeof(T) * count, alignment);
+        if (count > 0)
+            std::memcpy(alloc.CPU, data, sizeof(T) * count);
+        return alloc;
+    }
+
+    void Reset();
+
+    // Bytes handed out since the last Reset(), alignment padding included.
+    std::uint64_t UsedBytes()const { return mUsedBytes; }
+    std::uint64_t CapacityBytes()const;
+    std::uint32_t PageCount()const { return (std::uint32_t)mPages.size(); }
+
+private:
+    std::shared_ptr<UploadPageSource> mSource;
+    std::uint64_t mPageSize;
+
+    std::vector<UploadPage> mPages;
+    std::uint32_t mCurrent = 0;
+    std::uint64_t mOffset = 0;
+    std::uint64_t mUsedBytes = 0;
+};
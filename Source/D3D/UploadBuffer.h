@@ -21,18 +21,7 @@ public:
         if(isConstantBuffer)
             mElementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
 
-        ThrowIfFailed(device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer((UINT64)mElementByteSize*elementCount),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&mUploadBuffer)));
-
-        ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
-
-        // We do not need to unmap until we are done with the resource.  However, we must not write to
-        // the resource while it is in use by the GPU (so we must use synchronization techniques).
+        Create(device, elementCount);
     }
 
     UploadBuffer(const UploadBuffer& rhs) = delete;
@@ -50,15 +39,66 @@ public:
         return mUploadBuffer.Get();
     }
 
+    UINT ElementCount()const
+    {
+        return mElementCount;
+    }
+
     void CopyData(int elementIndex, const T& data)
     {
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // For writing part of an element. Write-combined memory: never read it back.
+    BYTE* MappedData(int elementIndex)const
+    {
+        return &mMappedData[elementIndex*mElementByteSize];
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS Address(int elementIndex)const
+    {
+        return mUploadBuffer->GetGPUVirtualAddress() + (UINT64)elementIndex*mElementByteSize;
+    }
+
+    // Grows the buffer and keeps the current contents.  The old resource is released
+    // right away, so the GPU must be done with it (i.e. its frame fence has passed).
+    void Resize(ID3D12Device* device, UINT elementCount)
+    {
+        if(elementCount <= mElementCount)
+            return;
+
+        Microsoft::WRL::ComPtr<ID3D12Resource> oldBuffer = mUploadBuffer;
+        BYTE* oldData = mMappedData;
+        UINT oldCount = mElementCount;
+
+        Create(device, elementCount);
+        memcpy(mMappedData, oldData, (size_t)mElementByteSize*oldCount);
+        oldBuffer->Unmap(0, nullptr);
+    }
+
 private:
+    void Create(ID3D12Device* device, UINT elementCount)
+    {
+        mElementCount = elementCount;
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer((UINT64)mElementByteSize*std::max<UINT>(elementCount, 1)),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(mUploadBuffer.ReleaseAndGetAddressOf())));
+
+        ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+
+        // We do not need to unmap until we are done with the resource.  However, we must not write to
+        // the resource while it is in use by the GPU (so we must use synchronization techniques).
+    }
+
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
+    UINT mElementCount = 0;
     bool mIsConstantBuffer = false;
 };
\ No newline at end of file
@@ -998,46 +998,65 @@ namespace Scenes
     }
 
     /**
-     * Traverse the scene graph and update the instance transforms.
+     * Get the node's local transform.
      */
-    void Traverse(size_t nodeIndex, XMMATRIX transform, Scene& scene)
+    XMMATRIX LocalTransform(const SceneNode& node)
     {
-        // Get the node
-        SceneNode node = scene.nodes[nodeIndex];
-
-        // Get the node's local transform
-        XMMATRIX nodeTransform;
         if (node.hasMatrix)
         {
-            nodeTransform = node.matrix;
-        }
-        else
-        {
-            // Compose the node's local transform, M = T * R * S
-            XMMATRIX t = XMMatrixTranslation(node.translation.x, node.translation.y, node.translation.z);
-            XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&node.rotation));
-            XMMATRIX s = XMMatrixScaling(node.scale.x, node.scale.y, node.scale.z);    // Note: do not use negative scale factors! This will flip the object inside and cause incorrect normals.
-            nodeTransform = XMMatrixMultiply(XMMatrixMultiply(s, r), t);
+            return node.matrix;
         }
 
-        // Compose the global transform
-        transform = XMMatrixMultiply(nodeTransform, transform);
+        // Compose the node's local transform, M = T * R * S
+        XMMATRIX t = XMMatrixTranslation(node.translation.x, node.translation.y, node.translation.z);
+        XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&node.rotation));
+        XMMATRIX s = XMMatrixScaling(node.scale.x, node.scale.y, node.scale.z);    // Note: do not use negative scale factors! This will flip the object inside and cause incorrect normals.
+        return XMMatrixMultiply(XMMatrixMultiply(s, r), t);
+    }
 
-        // When at a leaf node with a mesh, update the mesh instance's transform
-        // Not currently supporting nested transforms for camera nodes
-        if (node.children.size() == 0 && node.instance > -1)
+    /**
+     * Traverse the scene graph and update the instance transforms.
+     * Walks an explicit stack, so deep graphs do not overflow the call stack.
+     */
+    void Traverse(size_t nodeIndex, FXMMATRIX transform, Scene& scene)
+    {
+        struct Pending
         {
-            // Update the instance's transform data
-            MeshInstance* instance = &scene.instances[node.instance];
-            XMMATRIX transpose = XMMatrixTranspose(transform);
-            memcpy(instance->transform, &transpose, sizeof(XMFLOAT4) * 3);
-            return;
-        }
-
-        // Recursively traverse the scene graph
-        for (size_t i = 0; i < node.children.size(); i++)
+            size_t nodeIndex;
+            XMFLOAT4X4 parentTransform;
+        };
+        std::vector<Pending> stack(1);
+        stack[0].nodeIndex = nodeIndex;
+        XMStoreFloat4x4(&stack[0].parentTransform, transform);
+
+        while (!stack.empty())
         {
-            Traverse(node.children[i], transform, scene);
+            Pending pending = stack.back();
+            stack.pop_back();
+            const SceneNode& node = scene.nodes[pending.nodeIndex];
+
+            // Compose the global transform
+            XMMATRIX global = XMMatrixMultiply(LocalTransform(node), XMLoadFloat4x4(&pending.parentTransform));
+
+            // When at a leaf node with a mesh, update the mesh instance's transform
+            // Not currently supporting nested transforms for camera nodes
+            if (node.children.size() == 0 && node.instance > -1)
+            {
+                // Update the instance's transform data
+                MeshInstance* instance = &scene.instances[node.instance];
+                XMMATRIX transpose = XMMatrixTranspose(global);
+                memcpy(instance->transform, &transpose, sizeof(XMFLOAT4) * 3);
+                continue;
+            }
+
+            // Visit the children in order
+            Pending child;
+            XMStoreFloat4x4(&child.parentTransform, global);
+            for (size_t i = node.children.size(); i-- > 0;)
+            {
+                child.nodeIndex = node.children[i];
+                stack.push_back(child);
+            }
         }
     }
 
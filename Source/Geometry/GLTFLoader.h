@@ -135,7 +135,8 @@ namespace Scenes
     };
 
     HRESULT Initialize(const Config& config, Scene& scene);
-    void Traverse(size_t nodeIndex, DirectX::XMMATRIX transform, Scene& scene);
+    DirectX::XMMATRIX LocalTransform(const SceneNode& node);
+    void Traverse(size_t nodeIndex, DirectX::FXMMATRIX transform, Scene& scene);
     void UpdateCamera(Camera& camera);
     void Cleanup(Scene& scene);
     HRESULT CreateAndUploadTexture(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, 
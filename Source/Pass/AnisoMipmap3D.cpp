@@ -0,0 +1,160 @@
+#include "./AnisoMipmap3D.h"
+
+constexpr UINT AnisoMipmap3D::MipCount;
+constexpr UINT AnisoMipmap3D::MipsPerDispatch;
+
+namespace
+{
+	std::wstring AnisoUav(const std::wstring& target, UINT face, UINT mip)
+	{
+		return LampAnisoVoxels::VolumeName(target, face) + L"UAV" + std::to_wstring(mip);
+	}
+}
+
+AnisoMipmap3D::AnisoMipmap3D(ComPtr<ID3D12Device> device,
+	std::shared_ptr<DescriptorHeap> heaps,
+	std::shared_ptr<LampPSO> PSOs,
+	std::wstring target)
+	: ScreenRenderPass(device, heaps, PSOs, L"anisoMipmap3D", 0)
+{
+	mTarget = target;
+	pso1 = name;
+	rootSig1 = L"anisoMipmap3D";
+	// Declared for ordering only; Draw() writes its own barriers per mip.
+	Reads(mTarget);
+	mTargetRes = mHeaps->FindResource(mTarget);
+	mSources.push_back(mHeaps->FindSrv(mTarget));
+	for (UINT face = 0; face < LampAnisoVoxels::Faces; ++face)
+	{
+		const std::wstring volume = LampAnisoVoxels::VolumeName(mTarget, face);
+		Writes(volume, UAstate);
+		mFaceRes[face] = mHeaps->FindResource(volume);
+		mSources.push_back(mHeaps->FindSrv(volume));
+	}
+	for (UINT i = 0; i < mDispatchUavs.size(); ++i)
+		mDispatchUavs[i] = mHeaps->FindUav(AnisoUav(mTarget, 0, i * MipsPerDispatch));
+	BuildRootSignatureAndPSO();
+}
+
+void AnisoMipmap3D::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
+{
+	auto& states = mHeaps->States();
+	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig1));
+	cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
+	cmdList->SetComputeRootDescriptorTable(1, mHeaps->Table(mSources));
+	for (UINT srcLevel = 0; srcLevel < MipCount; srcLevel += MipsPerDispatch)
+	{
+		// The source is the color volume, or the last mip the dispatch before wrote.
+		states.Require(mHeaps->Resource(mTargetRes), GRstate);
+		for (auto& face : mFaceRes)
+		{
+			if (srcLevel > 0)
+				states.Require(mHeaps->Resource(face), GRstate, srcLevel - 1);
+			for (UINT mip = srcLevel; mip < srcLevel + MipsPerDispatch; ++mip)
+				states.Require(mHeaps->Resource(face), UAstate, mip);
+		}
+		states.Flush(cmdList);
+		GenerateAnisoMips(cmdList, srcLevel);
+	}
+	// Cone traces sample every mip.
+	for (auto& face : mFaceRes)
+		states.Require(mHeaps->Resource(face), GRstate);
+	states.Flush(cmdList);
+}
+
+void AnisoMipmap3D::BuildDescriptors()
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MostDetailedMip = 0;
+	srvDesc.Texture3D.MipLevels = MipCount;
+	srvDesc.Format = mFormat;
+	for (UINT face = 0; face < LampAnisoVoxels::Faces; ++face)
+		mHeaps->CreateSRV(LampAnisoVoxels::VolumeName(mTarget, face), &srvDesc);
+
+	// Each dispatch's views are created together so they form one table, face * 3 + mip.
+	for (UINT srcLevel = 0; srcLevel < MipCount; srcLevel += MipsPerDispatch)
+	{
+		for (UINT face = 0; face < LampAnisoVoxels::Faces; ++face)
+		{
+			for (UINT mip = srcLevel; mip < srcLevel + MipsPerDispatch; ++mip)
+			{
+				D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+				uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
+				uavDesc.Texture3D.MipSlice = mip;
+				uavDesc.Texture3D.FirstWSlice = 0;
+				uavDesc.Texture3D.WSize = -1;
+				uavDesc.Format = mFormat;
+				mHeaps->CreateUAV(AnisoUav(mTarget, face, mip),
+					mHeaps->GetResource(LampAnisoVoxels::VolumeName(mTarget, face)), &uavDesc);
+			}
+		}
+	}
+}
+
+BOOL AnisoMipmap3D::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
+{
+	if (RenderPass::OnResize(newWidth, newHeight, newDepth))
+	{
+		BuildResources();
+		BuildDescriptors();
+		return true;
+	}
+	return false;
+}
+
+void AnisoMipmap3D::BuildResources()
+{
+	// Mip 0 of the faces is level 1 of the color volume.
+	auto texDesc = mHeaps->GetResource(mTarget)->GetDesc();
+	mFormat = texDesc.Format;
+	for (UINT face = 0; face < LampAnisoVoxels::Faces; ++face)
+	{
+		mHeaps->CreateCommitResource3D(LampAnisoVoxels::VolumeName(mTarget, face),
+			(UINT)texDesc.Width / 2, texDesc.Height / 2, texDesc.DepthOrArraySize / 2, mFormat,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, nullptr, MipCount);
+	}
+}
+
+void AnisoMipmap3D::BuildRootSignatureAndPSO()
+{
+	CD3DX12_DESCRIPTOR_RANGE srvTable0;
+	srvTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 + LampAnisoVoxels::Faces, 0);
+
+	CD3DX12_DESCRIPTOR_RANGE uavTable0;
+	uavTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, LampAnisoVoxels::Faces * MipsPerDispatch, 0);
+
+	// Root parameter can be a table, root descriptor or root constants.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+
+	slotRootParameter[0].InitAsConstants(1, 0);
+	slotRootParameter[1].InitAsDescriptorTable(1, &srvTable0);
+	slotRootParameter[2].InitAsDescriptorTable(1, &uavTable0);
+
+	// Texels are loaded, so no samplers.
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter,
+		0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	mPSOs->CreateRootSignature(rootSigDesc, rootSig1);
+	mPSOs->BuildComputePSO(name, rootSig1, "anisoMipmap3DCS");
+}
+
+void AnisoMipmap3D::GenerateAnisoMips(ID3D12GraphicsCommandList* cmdList, UINT srcLevel)
+{
+	// One thread per texel of the first mip written.
+	auto desc = mHeaps->Resource(mFaceRes[0])->GetDesc();
+	UINT width = std::max<UINT>((UINT)desc.Width >> srcLevel, 1u);
+	UINT height = std::max<UINT>(desc.Height >> srcLevel, 1u);
+	UINT depth = std::max<UINT>(desc.DepthOrArraySize >> srcLevel, 1u);
+
+	cmdList->SetComputeRoot32BitConstants(0, 1, &srcLevel, 0);
+	cmdList->SetComputeRootDescriptorTable(2, mHeaps->GpuUav(mDispatchUavs[srcLevel / MipsPerDispatch]));
+
+	UINT numGroupsX = (UINT)ceilf(width / 4.0f);
+	UINT numGroupsY = (UINT)ceilf(height / 4.0f);
+	UINT numGroupsZ = (UINT)ceilf(depth / 4.0f);
+
+	cmdList->Dispatch(numGroupsX, numGroupsY, numGroupsZ);
+}
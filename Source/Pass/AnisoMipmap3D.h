@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ScreenRenderPass.h"
+#include "../main/AnisoVoxels.h"
+
+// Six anisotropic volumes above the voxel color volume's mip 0, one per direction a
+// cone travels, written by GenerateAnisoMip3D.hlsl; LampAnisoVoxels is the CPU reference.
+class AnisoMipmap3D : public ScreenRenderPass
+{
+public:
+	AnisoMipmap3D(ComPtr<ID3D12Device> device,
+		std::shared_ptr<DescriptorHeap> heaps,
+		std::shared_ptr<LampPSO> PSOs,
+		std::wstring target);
+	AnisoMipmap3D(const AnisoMipmap3D& rhs) = delete;
+	AnisoMipmap3D& operator=(const AnisoMipmap3D& rhs) = delete;
+	~AnisoMipmap3D() = default;
+
+	virtual void Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)override;
+	BOOL OnResize(UINT newWidth, UINT newHeight, UINT newDepth = 1)override;
+
+protected:
+
+	void BuildRootSignatureAndPSO();
+	void BuildResources()override;
+	void BuildDescriptors()override;
+	// Writes mips srcLevel to srcLevel + 2 of every face.
+	void GenerateAnisoMips(ID3D12GraphicsCommandList* cmdList, UINT srcLevel);
+
+private:
+
+	// Level 1 to 6 of the color volume; each dispatch writes three.
+	static constexpr UINT MipCount = 6;
+	static constexpr UINT MipsPerDispatch = 3;
+
+	std::wstring mTarget;
+	DXGI_FORMAT mFormat;
+	ResourceHandle mTargetRes;
+	std::array<ResourceHandle, LampAnisoVoxels::Faces> mFaceRes;
+	// The color volume, then the faces: t0 to t6.
+	std::vector<SrvHandle> mSources;
+	// First of the Faces * MipsPerDispatch views each dispatch writes.
+	std::array<UavHandle, MipCount / MipsPerDispatch> mDispatchUavs;
+};
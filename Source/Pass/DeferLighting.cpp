@@ -2,11 +2,21 @@
 
 DeferLighting::DeferLighting(ComPtr<ID3D12Device> device,
     std::shared_ptr<DescriptorHeap> heaps,
-    std::shared_ptr<LampPSO> PSOs)
-    : ScreenRenderPass(device, heaps, PSOs, L"deferLighting", 0)
+    std::shared_ptr<LampPSO> PSOs,
+    const LampLightCounts& lights)
+    : ScreenRenderPass(device, heaps, PSOs, L"deferLighting", 0), mLights(lights)
 {
     pso1 = name;
     rootSig1 = L"deferLighting";
+    Reads(L"BaseColor");
+    Reads(L"ProbeNormalDepth");
+    Reads(L"ScreenProbeSH0");
+    WritesTransient(L"Temp2");
+    mGraphBarriers = true;
+    mCullable = true;
+    mProbeNormalDepth = mHeaps->FindSrv(L"ProbeNormalDepth");
+    mBaseColor = mHeaps->FindSrv(L"BaseColor");
+    mScreenProbeSH = mHeaps->FindSrv(L"ScreenProbeSH0");
     BuildRootSignatureAndPSO();
 }
 
@@ -14,10 +24,7 @@ void DeferLighting::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* curr
 {
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
-    // Change to RENDER_TARGET.
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Temp2(),
-        GRstate, RTstate));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
     cmdList->ClearRenderTargetView(mHeaps->Temp2Rtv(), clearValue, 0, nullptr);
@@ -25,19 +32,16 @@ void DeferLighting::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* curr
     // Specify the buffers we are going to render to.
     cmdList->OMSetRenderTargets(1, &mHeaps->Temp2Rtv(), false, nullptr);
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
-    cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->GetSrv(L"ProbeNormalDepth"));
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
+    cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->Srv(mProbeNormalDepth));
     cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->SkySrv());
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"BaseColor"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"ScreenProbeSH0"));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mBaseColor));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mScreenProbeSH));
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
     // Draw fullscreen quad.
     DrawFullScreen(cmdList);
-
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Temp2(),
-        RTstate, GRstate));
 }
 
 void DeferLighting::BuildDescriptors()
@@ -94,6 +98,6 @@ void DeferLighting::BuildRootSignatureAndPSO()
 
     mPSOs->CreateRootSignature(rootSigDesc, rootSig1);
     // PSO for drawing DeferLighting.
-    mPSOs->BuildGraphicsPSO(pso1, rootSig1, "DeferLightingPS");
+    mPSOs->BuildGraphicsPSO(pso1, rootSig1, mPSOs->AddLightPermutation("DeferLightingPS", "DeferLighting_PS", mLights));
 
 }
\ No newline at end of file
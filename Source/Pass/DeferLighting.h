@@ -7,7 +7,8 @@ class DeferLighting : public ScreenRenderPass
 public:
     DeferLighting(ComPtr<ID3D12Device> device,
         std::shared_ptr<DescriptorHeap> heaps,
-        std::shared_ptr<LampPSO> PSOs);
+        std::shared_ptr<LampPSO> PSOs,
+        const LampLightCounts& lights);
     DeferLighting(const DeferLighting& rhs) = delete;
     DeferLighting& operator=(const DeferLighting& rhs) = delete;
     ~DeferLighting() = default;
@@ -22,5 +23,9 @@ protected:
     void BuildDescriptors()override;
 
 private:
-
+    SrvHandle mProbeNormalDepth;
+    SrvHandle mBaseColor;
+    SrvHandle mScreenProbeSH;
+    // The pixel shader loops over these lights only.
+    LampLightCounts mLights;
 };
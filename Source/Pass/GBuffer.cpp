@@ -10,7 +10,10 @@ GBuffer::GBuffer(ComPtr<ID3D12Device> device,
     : SceneRenderPass(device, heaps, PSOs, Scene, L"GBuffer", 5)
 {
     pso1 = name;
+    pso2 = L"GBufferInstanced";
     rootSig1 = L"GBuffer";
+    mTargets = { mHeaps->FindRtv(mBaseColor), mHeaps->FindRtv(mMetalicRoughness), mHeaps->FindRtv(mNormal) };
+    mTargetRes = { mHeaps->FindResource(mBaseColor), mHeaps->FindResource(mMetalicRoughness), mHeaps->FindResource(mNormal) };
     BuildRootSignatureAndPSO();
 }
 
@@ -19,7 +22,7 @@ void GBuffer::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
 
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
     // Bind all the materials used in this scene.  For structured buffers, 
     // we can bypass the heap and set as a root descriptor.
@@ -30,37 +33,35 @@ void GBuffer::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
 
     // Change to RENDER_TARGET.
-    std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mBaseColor), GRstate, RTstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mNormal), GRstate, RTstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mMetalicRoughness), GRstate, RTstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    auto& states = mHeaps->States();
+    for (auto res : mTargetRes)
+        states.Require(mHeaps->Resource(res), RTstate);
+    states.Flush(cmdList);
 
     // Clear the screen normal map and depth buffer.
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mBaseColor), clearValue, 0, nullptr);
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mNormal), clearValue, 0, nullptr);
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mMetalicRoughness), clearValue, 0, nullptr);
+    D3D12_CPU_DESCRIPTOR_HANDLE targets[3];
+    for (UINT i = 0; i < 3; ++i)
+    {
+        targets[i] = mHeaps->Rtv(mTargets[i]);
+        cmdList->ClearRenderTargetView(targets[i], clearValue, 0, nullptr);
+    }
     cmdList->ClearDepthStencilView(mHeaps->DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-    cmdList->OMSetRenderTargets(3, &mHeaps->GetRtv(mBaseColor), true, &mHeaps->DepthStencilView());
+    cmdList->OMSetRenderTargets(3, targets, false, &mHeaps->DepthStencilView());
 
     // Bind the constant buffer for this pass.
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(1, passCB);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    // Visible opaque items are batched by mesh and material.
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso2));
+    DrawInstanceBatches(cmdList, RenderLayer::Opaque, currFrame, 4);
 
-    DrawRenderItems(cmdList, RenderLayer::Opaque, currFrame);
-    DrawRenderItems(cmdList, RenderLayer::Wall, currFrame);
+    DrawRenderItems(cmdList, RenderLayer::Wall, currFrame, mPso1);
 
-    resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mBaseColor), RTstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mNormal), RTstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mMetalicRoughness), RTstate, GRstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    for (auto res : mTargetRes)
+        states.Release(mHeaps->Resource(res), GRstate);
 }
 
 void GBuffer::BuildDescriptors()
@@ -118,16 +119,17 @@ void GBuffer::BuildRootSignatureAndPSO()
     CD3DX12_DESCRIPTOR_RANGE texTable0;
     texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 0, 0);
 
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
     slotRootParameter[0].InitAsConstantBufferView(0);
     slotRootParameter[1].InitAsConstantBufferView(1);
     slotRootParameter[2].InitAsShaderResourceView(0, 1);
     slotRootParameter[3].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[4].InitAsShaderResourceView(1, 1, D3D12_SHADER_VISIBILITY_VERTEX);
 
     auto staticSamplers = mPSOs->GetStaticSamplers();
 
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -135,4 +137,5 @@ void GBuffer::BuildRootSignatureAndPSO()
 
     std::vector<DXGI_FORMAT> rtvFormats = { LDRFormat, LDRFormat, HDRFormat };
     mPSOs->BuildGraphicsPSO(pso1, rootSig1, "drawGBufferVS", "drawGBufferPS", rtvFormats);
+    mPSOs->BuildGraphicsPSO(pso2, rootSig1, "drawGBufferInstancedVS", "drawGBufferInstancedPS", rtvFormats);
 }
\ No newline at end of file
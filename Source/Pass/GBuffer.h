@@ -34,6 +34,10 @@ private:
     const std::wstring mBaseColor = L"BaseColor";
     const std::wstring mNormal = L"Normal";
     const std::wstring mMetalicRoughness = L"MetalicRoughness";
+
+    // SV_Target0..2: BaseColor, MetalicRoughness, Normal.
+    std::array<RtvHandle, 3> mTargets;
+    std::array<ResourceHandle, 3> mTargetRes;
 };
 
 #endif // GBuffer_H
\ No newline at end of file
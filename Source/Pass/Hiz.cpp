@@ -7,6 +7,15 @@ HierachyZBuffer::HierachyZBuffer(ComPtr<ID3D12Device> device,
 {
 	pso1 = name;
 	rootSig1 = L"hiz";
+	// The first level is drawn with the blit pass's pipeline.
+	pso2 = L"blit";
+	rootSig2 = L"blit";
+	mHizSrv = mHeaps->FindSrv(mHiz);
+	mHizRtv = mHeaps->FindRtv(mHiz);
+	mHizRes = mHeaps->FindResource(mHiz);
+	for (UINT i = 0; i < MipCount; ++i)
+		mHizMips[i] = mHeaps->FindUav(mHiz + std::to_wstring(i));
+	mDepth = mHeaps->FindSrv(L"Depth");
 	BuildRootSignatureAndPSO();
 }
 
@@ -18,8 +27,8 @@ void HierachyZBuffer::GenerateHiz(ID3D12GraphicsCommandList* cmdList, UINT srcLe
 	float data[] = { (float)srcLevel, 4, 1.0f / width, 1.0f / height };
 
 	cmdList->SetComputeRoot32BitConstants(0, 4, data, 0);
-	cmdList->SetComputeRootDescriptorTable(1, mHeaps->GetSrv(mHiz));
-	cmdList->SetComputeRootDescriptorTable(2, mHeaps->GetGPUUav(mHiz + std::to_wstring(srcLevel)));
+	cmdList->SetComputeRootDescriptorTable(1, mHeaps->Srv(mHizSrv));
+	cmdList->SetComputeRootDescriptorTable(2, mHeaps->GpuUav(mHizMips[srcLevel]));
 
 	UINT numGroupsX = (UINT)ceilf(width / 8.0f);
 	UINT numGroupsY = (UINT)ceilf(height / 8.0f);
@@ -32,40 +41,37 @@ void HierachyZBuffer::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* cu
 {
 	cmdList->RSSetViewports(1, &mViewport);
 	cmdList->RSSetScissorRects(1, &mScissorRect);
-	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(L"blit"));
+	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig2));
 
-	std::vector<D3D12_RESOURCE_BARRIER> resourceBarrier =
-	{
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mHiz), GRstate, RTstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Offscreen(), GRstate, RTstate)
-	};
-	cmdList->ResourceBarrier(2, resourceBarrier.data());
+	auto& states = mHeaps->States();
+	states.Require(mHeaps->Resource(mHizRes), RTstate);
+	states.Require(mHeaps->Offscreen(), RTstate);
+	states.Flush(cmdList);
 
+	D3D12_CPU_DESCRIPTOR_HANDLE targets[] = { mHeaps->OffscreenRtv(), mHeaps->Rtv(mHizRtv) };
 	float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	cmdList->ClearRenderTargetView(mHeaps->OffscreenRtv(), clearValue, 0, nullptr);
-	cmdList->ClearRenderTargetView(mHeaps->GetRtv(mHiz), clearValue, 0, nullptr);
+	cmdList->ClearRenderTargetView(targets[0], clearValue, 0, nullptr);
+	cmdList->ClearRenderTargetView(targets[1], clearValue, 0, nullptr);
 
 	// Specify the buffers we are going to render to.
-	cmdList->OMSetRenderTargets(2, &mHeaps->OffscreenRtv(), true, nullptr);
+	cmdList->OMSetRenderTargets(2, targets, false, nullptr);
 
-	cmdList->SetPipelineState(mPSOs->GetPSO(L"blit"));
+	cmdList->SetPipelineState(mPSOs->GetPSO(mPso2));
 
-	auto passCB = currFrame->PassCB->Resource();
-	cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+	auto passCB = currFrame->PassCBAddress[0];
+	cmdList->SetGraphicsRootConstantBufferView(0, passCB);
 	cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->HistorySrv());
-	cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(L"Depth"));
+	cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Srv(mDepth));
 
 	DrawFullScreen(cmdList);
 
-	resourceBarrier =
-	{
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mHiz), RTstate, GRstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Offscreen(), RTstate, GRstate)
-	};
-	cmdList->ResourceBarrier(2, resourceBarrier.data());
+	// The mip chain is built in place from the first level.
+	states.Require(mHeaps->Resource(mHizRes), GRstate);
+	states.Release(mHeaps->Offscreen(), GRstate);
+	states.Flush(cmdList);
 
-	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(rootSig1));
-	cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig1));
+	cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 	int srcLevel = 0;
 	GenerateHiz(cmdList, srcLevel);
 	GenerateHiz(cmdList, 3);
@@ -77,10 +83,10 @@ void HierachyZBuffer::BuildDescriptors()
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = 7;
+	srvDesc.Texture2D.MipLevels = MipCount;
 	srvDesc.Format = DepthFormat;
 	mHeaps->CreateSRV(mHiz, &srvDesc);
-	for (int i = 0; i < 7; i++)
+	for (UINT i = 0; i < MipCount; i++)
 	{
 		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
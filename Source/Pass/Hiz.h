@@ -25,6 +25,13 @@ protected:
 private:
 
 	const std::wstring mHiz = L"Hiz";
+	static constexpr UINT MipCount = 7;
+
+	SrvHandle mHizSrv;
+	RtvHandle mHizRtv;
+	ResourceHandle mHizRes;
+	std::array<UavHandle, MipCount> mHizMips;
+	SrvHandle mDepth;
 };
 
  
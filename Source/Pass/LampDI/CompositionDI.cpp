@@ -7,6 +7,10 @@ CompositionDI::CompositionDI(ComPtr<ID3D12Device> device,
 {
     pso1 = name;
     rootSig1 = L"LampCDi";
+    Reads(L"BaseColor");
+    Reads(L"Temp1");
+    Reads(L"Temp2");
+    mBaseColor = mHeaps->FindSrv(L"BaseColor");
     BuildRootSignatureAndPSO();
 }
 
@@ -14,10 +18,10 @@ void CompositionDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* curr
 {
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Current(),
-        GRstate, RTstate));
+    mHeaps->States().Require(mHeaps->Current(), RTstate);
+    mHeaps->States().Flush(cmdList);
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
     cmdList->ClearRenderTargetView(mHeaps->CurrentRtv(), clearValue, 0, nullptr);
@@ -25,18 +29,17 @@ void CompositionDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* curr
     // Specify the buffers we are going to render to.
     cmdList->OMSetRenderTargets(1, &mHeaps->CurrentRtv(), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->Temp2Srv());
     cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Temp1Srv());
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"BaseColor"));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mBaseColor));
 
     DrawFullScreen(cmdList);
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Current(),
-        RTstate, GRstate));
+    mHeaps->States().Release(mHeaps->Current(), GRstate);
 }
 
 void CompositionDI::BuildDescriptors()
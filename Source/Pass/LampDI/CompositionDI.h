@@ -22,4 +22,5 @@ protected:
     void BuildDescriptors()override;
 
 private:
+    SrvHandle mBaseColor;
 };
@@ -6,13 +6,25 @@ LampDI::LampDI(ComPtr<ID3D12Device> device,
     std::wstring name)
     : ScreenRenderPass(device, heaps, PSOs, name, 0)
 {
+    mCurViews = FindTarget(mCurDI);
+    mHisViews = FindTarget(mHisDI);
+    mTempViews = FindTarget(mTempDI);
+    mNormalDepthViews = FindTarget(mNormalDepth);
+}
+
+LampDI::TargetViews LampDI::FindTarget(const std::wstring& target)
+{
+    TargetViews views;
+    views.Srv = mHeaps->FindSrv(target);
+    views.Rtv = mHeaps->FindRtv(target);
+    views.Res = mHeaps->FindResource(target);
+    return views;
 }
 
 void LampDI::Swap()
 {
-    std::wstring temp = mHisDI;
-    mHisDI = mCurDI;
-    mCurDI = temp;
+    std::swap(mHisDI, mCurDI);
+    std::swap(mHisViews, mCurViews);
 }
 
 void LampDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
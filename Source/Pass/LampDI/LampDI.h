@@ -30,5 +30,20 @@ protected:
     std::wstring ScreenProbeSH0 = L"ScreenProbeSH0";
     std::wstring ScreenProbeSH1 = L"ScreenProbeSH1";
     std::wstring ScreenProbeSH2 = L"ScreenProbeSH2";
+
+    // The views of a named target, resolved once.
+    struct TargetViews
+    {
+        SrvHandle Srv;
+        RtvHandle Rtv;
+        ResourceHandle Res;
+    };
+    TargetViews FindTarget(const std::wstring& target);
+
+    // Swap() exchanges these along with mCurDI and mHisDI.
+    TargetViews mCurViews;
+    TargetViews mHisViews;
+    TargetViews mTempViews;
+    TargetViews mNormalDepthViews;
 private:
 };
\ No newline at end of file
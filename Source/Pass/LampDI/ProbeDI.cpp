@@ -7,6 +7,13 @@ ProbeDI::ProbeDI(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampPDI";
     rootSig1 = L"LampPDi";
+    Reads(mNormalDepth);
+    Reads(L"ProbeSH0");
+    Reads(L"VoxelizedColor");
+    ReadsVoxelCoarse();
+    Reads(mTempDI);
+    mVoxelColor = mHeaps->FindSrv(L"VoxelizedColor");
+    mProbeSH = mHeaps->FindSrv(L"ProbeSH0");
     BuildRootSignatureAndPSO();
 }
 
@@ -15,31 +22,31 @@ void ProbeDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     Swap();
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mCurDI),
-        GRstate, RTstate));
+    mHeaps->States().Require(mHeaps->Resource(mCurViews.Res), RTstate);
+    mHeaps->States().Flush(cmdList);
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mCurDI), clearValue, 0, nullptr);
+    cmdList->ClearRenderTargetView(mHeaps->Rtv(mCurViews.Rtv), clearValue, 0, nullptr);
 
     // Specify the buffers we are going to render to.
-    cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mCurDI), false, nullptr);
+    cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mCurViews.Rtv), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
-    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(mNormalDepth));
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"VoxelizedColor"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"ProbeSH0"));
-    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->GetSrv(mTempDI));
+    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Srv(mNormalDepthViews.Srv));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mVoxelColor));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mProbeSH));
+    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->Srv(mTempViews.Srv));
+    cmdList->SetGraphicsRootDescriptorTable(6, VoxelCoarseTable());
 
     DrawFullScreen(cmdList);
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mCurDI),
-        RTstate, GRstate));
+    mHeaps->States().Release(mHeaps->Resource(mCurViews.Res), GRstate);
 }
 
 BOOL ProbeDI::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
@@ -72,7 +79,9 @@ void ProbeDI::BuildRootSignatureAndPSO()
     srvTable4.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 6); // Temp
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
+    CD3DX12_DESCRIPTOR_RANGE coarseTable = VoxelCoarseRange(); // Coarse voxel levels
+
+    CD3DX12_ROOT_PARAMETER slotRootParameter[7];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsConstantBufferView(0);
@@ -81,11 +90,12 @@ void ProbeDI::BuildRootSignatureAndPSO()
     slotRootParameter[3].InitAsDescriptorTable(1, &srvTable2);
     slotRootParameter[4].InitAsDescriptorTable(1, &srvTable3);
     slotRootParameter[5].InitAsDescriptorTable(1, &srvTable4);
+    slotRootParameter[6].InitAsDescriptorTable(1, &coarseTable);
 
     auto staticSamplers = mPSOs->GetStaticSamplers1();
 
     // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
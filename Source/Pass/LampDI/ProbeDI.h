@@ -22,4 +22,6 @@ protected:
     void BuildDescriptors()override;
 
 private:
+    SrvHandle mVoxelColor;
+    SrvHandle mProbeSH;
 };
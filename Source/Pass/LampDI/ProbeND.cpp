@@ -7,14 +7,13 @@ ProbeND::ProbeND(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampNDDI";
     rootSig1 = L"LampNDDI";
+    mNormal = mHeaps->FindSrv(L"Normal");
     BuildRootSignatureAndPSO();
 }
 
 void ProbeND::Swap()
 {
-    std::wstring temp = mHisDI;
-    mHisDI = mCurDI;
-    mCurDI = temp;
+    std::swap(mHisDI, mCurDI);
 }
 
 void ProbeND::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
@@ -22,25 +21,24 @@ void ProbeND::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     Swap();
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mNormalDepth),
-        GRstate, RTstate));
+    mHeaps->States().Require(mHeaps->Resource(mNormalDepthViews.Res), RTstate);
+    mHeaps->States().Flush(cmdList);
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mNormalDepth), clearValue, 0, nullptr);
-    cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mNormalDepth), false, nullptr);
+    cmdList->ClearRenderTargetView(mHeaps->Rtv(mNormalDepthViews.Rtv), clearValue, 0, nullptr);
+    cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mNormalDepthViews.Rtv), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
-    cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->GetSrv(L"Normal"));
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
+    cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->Srv(mNormal));
 
     DrawFullScreen(cmdList);
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mNormalDepth),
-        RTstate, GRstate));
+    mHeaps->States().Release(mHeaps->Resource(mNormalDepthViews.Res), GRstate);
 }
 
 void ProbeND::BuildDescriptors()
@@ -92,6 +90,9 @@ BOOL ProbeND::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
 
 void ProbeND::BuildResources()
 {
+    // Swap() turns either one into the history, read before it is written.
+    mHeaps->KeepCommitted(mCurDI);
+    mHeaps->KeepCommitted(mHisDI);
     mHeaps->CreateCommitResource2D(mCurDI, 1280, 720, HDRFormat,
         D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
     mHeaps->CreateCommitResource2D(mHisDI, 1280, 720, HDRFormat,
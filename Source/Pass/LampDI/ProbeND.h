@@ -30,4 +30,5 @@ protected:
     std::wstring ScreenProbeSH1 = L"ScreenProbeSH1";
     std::wstring ScreenProbeSH2 = L"ScreenProbeSH2";
 private:
+    SrvHandle mNormal;
 };
\ No newline at end of file
@@ -7,6 +7,19 @@ LampReflection::LampReflection(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampRef";
     rootSig1 = L"LampRef";
+    Reads(L"Normal");
+    Reads(L"Hiz");
+    Reads(L"ProbeSH0");
+    Reads(L"VoxelizedColor");
+    ReadsVoxelCoarse();
+    Reads(L"Temp2");
+    WritesTransient(L"Temp1");
+    mGraphBarriers = true;
+    mCullable = true;
+    mNormal = mHeaps->FindSrv(L"Normal");
+    mVoxelColor = mHeaps->FindSrv(L"VoxelizedColor");
+    mProbeSH = mHeaps->FindSrv(L"ProbeSH0");
+    mHiz = mHeaps->FindSrv(L"Hiz");
     BuildRootSignatureAndPSO();
 }
 
@@ -14,10 +27,7 @@ void LampReflection::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
 {
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
-
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Temp1(),
-        GRstate, RTstate));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
     cmdList->ClearRenderTargetView(mHeaps->Temp1Rtv(), clearValue, 0, nullptr);
@@ -25,21 +35,19 @@ void LampReflection::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
     // Specify the buffers we are going to render to.
     cmdList->OMSetRenderTargets(1, &mHeaps->Temp1Rtv(), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
-    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(L"Normal"));
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"VoxelizedColor"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"ProbeSH0"));
-    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->GetSrv(L"Hiz"));
+    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Srv(mNormal));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mVoxelColor));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mProbeSH));
+    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->Srv(mHiz));
     cmdList->SetGraphicsRootDescriptorTable(6, mHeaps->Temp2Srv());
+    cmdList->SetGraphicsRootDescriptorTable(7, VoxelCoarseTable());
 
     DrawFullScreen(cmdList);
-
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->Temp1(),
-        RTstate, GRstate));
 }
 
 void LampReflection::BuildDescriptors()
@@ -78,7 +86,9 @@ void LampReflection::BuildRootSignatureAndPSO()
     srvTable5.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 10); // Temp
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[7];
+    CD3DX12_DESCRIPTOR_RANGE coarseTable = VoxelCoarseRange(); // Coarse voxel levels
+
+    CD3DX12_ROOT_PARAMETER slotRootParameter[8];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsConstantBufferView(0);
@@ -88,11 +98,12 @@ void LampReflection::BuildRootSignatureAndPSO()
     slotRootParameter[4].InitAsDescriptorTable(1, &srvTable3);
     slotRootParameter[5].InitAsDescriptorTable(1, &srvTable4);
     slotRootParameter[6].InitAsDescriptorTable(1, &srvTable5);
+    slotRootParameter[7].InitAsDescriptorTable(1, &coarseTable);
 
     auto staticSamplers = mPSOs->GetStaticSamplers1();
 
     // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(8, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
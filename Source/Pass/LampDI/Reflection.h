@@ -22,4 +22,8 @@ protected:
     void BuildDescriptors()override;
 
 private:
+    SrvHandle mNormal;
+    SrvHandle mVoxelColor;
+    SrvHandle mProbeSH;
+    SrvHandle mHiz;
 };
\ No newline at end of file
@@ -7,6 +7,8 @@ ScreenDI::ScreenDI(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampSDI";
     rootSig1 = L"LampSDI";
+    mNormal = mHeaps->FindSrv(L"Normal");
+    mHiz = mHeaps->FindSrv(L"Hiz");
     BuildRootSignatureAndPSO();
 }
 
@@ -15,31 +17,30 @@ void ScreenDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame
     Swap();
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mCurDI),
-        GRstate, RTstate));
+    mHeaps->States().Require(mHeaps->Resource(mCurViews.Res), RTstate);
+    mHeaps->States().Flush(cmdList);
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mCurDI), clearValue, 0, nullptr);
+    cmdList->ClearRenderTargetView(mHeaps->Rtv(mCurViews.Rtv), clearValue, 0, nullptr);
 
     // Specify the buffers we are going to render to.
-    cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mCurDI), false, nullptr);
+    cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mCurViews.Rtv), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
     cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->HistorySrv());
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"Normal"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"Hiz"));
-    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->GetSrv(mNormalDepth));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mNormal));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mHiz));
+    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->Srv(mNormalDepthViews.Srv));
 
     DrawFullScreen(cmdList);
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mCurDI),
-        RTstate, GRstate));
+    mHeaps->States().Release(mHeaps->Resource(mCurViews.Res), GRstate);
 }
 
 void ScreenDI::BuildDescriptors()
@@ -22,4 +22,6 @@ protected:
     void BuildDescriptors()override;
 
 private:
+    SrvHandle mNormal;
+    SrvHandle mHiz;
 };
\ No newline at end of file
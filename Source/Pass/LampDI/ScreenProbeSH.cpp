@@ -7,34 +7,30 @@ ScreenProbeSH::ScreenProbeSH(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampSH";
     rootSig1 = L"LampSH";
+    mSHUav = mHeaps->FindUav(ScreenProbeSH0);
+    mSHRes = { mHeaps->FindResource(ScreenProbeSH0), mHeaps->FindResource(ScreenProbeSH1), mHeaps->FindResource(ScreenProbeSH2) };
     BuildRootSignatureAndPSO();
 }
 
 void ScreenProbeSH::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 {
     Swap();
-    std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH0), GRstate, UAstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH1), GRstate, UAstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH2), GRstate, UAstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    auto& states = mHeaps->States();
+    for (auto sh : mSHRes)
+        states.Require(mHeaps->Resource(sh), UAstate);
+    states.Flush(cmdList);
 
-    cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(rootSig1));
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    cmdList->SetComputeRootDescriptorTable(0, mHeaps->GetSrv(mCurDI));
-    cmdList->SetComputeRootDescriptorTable(1, mHeaps->GetSrv(mNormalDepth));
-    cmdList->SetComputeRootDescriptorTable(2, mHeaps->GetGPUUav(ScreenProbeSH0));
+    cmdList->SetComputeRootDescriptorTable(0, mHeaps->Srv(mCurViews.Srv));
+    cmdList->SetComputeRootDescriptorTable(1, mHeaps->Srv(mNormalDepthViews.Srv));
+    cmdList->SetComputeRootDescriptorTable(2, mHeaps->GpuUav(mSHUav));
 
     cmdList->Dispatch(160, 90, 1);
 
-    resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH0), UAstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH1), UAstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(ScreenProbeSH2), UAstate, GRstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    for (auto sh : mSHRes)
+        states.Release(mHeaps->Resource(sh), GRstate);
 }
 
 BOOL ScreenProbeSH::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
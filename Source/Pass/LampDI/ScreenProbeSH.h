@@ -22,4 +22,6 @@ protected:
     void BuildDescriptors()override;
 
 private:
+    UavHandle mSHUav;
+    std::array<ResourceHandle, 3> mSHRes;
 };
@@ -7,6 +7,16 @@ VoxelDI::VoxelDI(ComPtr<ID3D12Device> device,
 {
     pso1 = L"LampVDI";
     rootSig1 = L"LampVDI";
+    Reads(mNormalDepth);
+    Reads(L"ProbeSH0");
+    Reads(L"VoxelizedColor");
+    ReadsVoxelCoarse();
+    ReadsVoxelAniso();
+    WritesTransient(mTempDI);
+    mGraphBarriers = true;
+    mCullable = true;
+    mVoxelColor = mHeaps->FindSrv(L"VoxelizedColor");
+    mProbeSH = mHeaps->FindSrv(L"ProbeSH0");
     BuildRootSignatureAndPSO();
 }
 
@@ -15,31 +25,27 @@ void VoxelDI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     Swap();
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
-
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTempDI),
-        GRstate, RTstate));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(mTempDI), clearValue, 0, nullptr);
+    cmdList->ClearRenderTargetView(mHeaps->Rtv(mTempViews.Rtv), clearValue, 0, nullptr);
 
     // Specify the buffers we are going to render to.
-    cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mTempDI), false, nullptr);
+    cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mTempViews.Rtv), false, nullptr);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
-    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(mNormalDepth));
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"VoxelizedColor"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"ProbeSH0"));
-    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->GetSrv(mCurDI));
+    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Srv(mNormalDepthViews.Srv));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mVoxelColor));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mProbeSH));
+    cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->Srv(mCurViews.Srv));
+    cmdList->SetGraphicsRootDescriptorTable(6, VoxelCoarseTable());
+    cmdList->SetGraphicsRootDescriptorTable(7, VoxelAnisoTable());
 
     DrawFullScreen(cmdList);
-
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTempDI),
-        RTstate, GRstate));
 }
 
 void VoxelDI::BuildDescriptors()
@@ -72,7 +78,10 @@ void VoxelDI::BuildRootSignatureAndPSO()
     srvTable4.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 8); // Temp
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
+    CD3DX12_DESCRIPTOR_RANGE coarseTable = VoxelCoarseRange(); // Coarse voxel levels
+    CD3DX12_DESCRIPTOR_RANGE anisoTable = VoxelAnisoRange(); // Anisotropic voxel mips
+
+    CD3DX12_ROOT_PARAMETER slotRootParameter[8];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsConstantBufferView(0);
@@ -81,11 +90,13 @@ void VoxelDI::BuildRootSignatureAndPSO()
     slotRootParameter[3].InitAsDescriptorTable(1, &srvTable2);
     slotRootParameter[4].InitAsDescriptorTable(1, &srvTable3);
     slotRootParameter[5].InitAsDescriptorTable(1, &srvTable4);
+    slotRootParameter[6].InitAsDescriptorTable(1, &coarseTable);
+    slotRootParameter[7].InitAsDescriptorTable(1, &anisoTable);
 
     auto staticSamplers = mPSOs->GetStaticSamplers1();
 
     // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(8, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -10,29 +10,32 @@ Mipmap3D::Mipmap3D(ComPtr<ID3D12Device> device,
 	pso1 = name;
 	rootSig1 = L"mipmap3D";
 	mInitialize = false;
+	mTargetSrv = mHeaps->FindSrv(mTarget);
+	mTargetRes = mHeaps->FindResource(mTarget);
+	mTempRes = mHeaps->FindResource(mTemp);
+	for (UINT i = 0; i < MipCount; ++i)
+		mMips[i] = mHeaps->FindUav(L"MIP3DUAV" + std::to_wstring(i));
 	BuildRootSignatureAndPSO();
 }
 
 void Mipmap3D::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 {
+	auto& states = mHeaps->States();
 	if (!mInitialize && hasTemp)
 	{
-		std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTemp), GRstate, CSstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTarget), GRstate, CDstate)
-		};
-		cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+		states.Require(mHeaps->Resource(mTempRes), CSstate);
+		states.Require(mHeaps->Resource(mTargetRes), CDstate);
+		states.Flush(cmdList);
 
-		cmdList->CopyResource(mHeaps->GetResource(mTarget), mHeaps->GetResource(mTemp));
+		cmdList->CopyResource(mHeaps->Resource(mTargetRes), mHeaps->Resource(mTempRes));
 		
-		resourceBarriers = {
-			CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTemp), CSstate, GRstate),
-			CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTarget), CDstate, GRstate)
-		};
-		cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+		// Nothing reads the copy source again this frame.
+		states.Release(mHeaps->Resource(mTempRes), GRstate, true);
 	}
-	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(rootSig1));
-	cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+	states.Require(mHeaps->Resource(mTargetRes), GRstate);
+	states.Flush(cmdList);
+	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig1));
+	cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 	int srcLevel = 0;
 	GenerateMipmap3D(cmdList, srcLevel);
 	GenerateMipmap3D(cmdList, 3);
@@ -40,7 +43,7 @@ void Mipmap3D::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame
 
 void Mipmap3D::BuildDescriptors()
 {
-	for (int i = 0; i < 7; i++)
+	for (UINT i = 0; i < MipCount; i++)
 	{
 		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
@@ -127,8 +130,8 @@ void Mipmap3D::GenerateMipmap3D(ID3D12GraphicsCommandList* cmdList, UINT srcLeve
 	float data[] = { (float)srcLevel, 1.0f / width, 1.0f / height, 1.0f / depth };
 
 	cmdList->SetComputeRoot32BitConstants(0, 4, data, 0);
-	cmdList->SetComputeRootDescriptorTable(1, mHeaps->GetSrv(mTarget));
-	cmdList->SetComputeRootDescriptorTable(2, mHeaps->GetGPUUav(L"MIP3DUAV" + std::to_wstring(srcLevel)));
+	cmdList->SetComputeRootDescriptorTable(1, mHeaps->Srv(mTargetSrv));
+	cmdList->SetComputeRootDescriptorTable(2, mHeaps->GpuUav(mMips[srcLevel]));
 
 	UINT numGroupsX = (UINT)ceilf(width / 8.0f);
 	UINT numGroupsY = (UINT)ceilf(height / 8.0f);
@@ -30,6 +30,12 @@ private:
 	BOOL hasTemp;
 	std::wstring mTemp;
 	DXGI_FORMAT mFormat;
+
+	static constexpr UINT MipCount = 7;
+	SrvHandle mTargetSrv;
+	ResourceHandle mTargetRes;
+	ResourceHandle mTempRes;
+	std::array<UavHandle, MipCount> mMips;
 };
 
  
\ No newline at end of file
@@ -27,6 +27,87 @@ UINT RenderPass::Height()const
     return mHeight;
 }
 
+const std::wstring& RenderPass::Name()const
+{
+    return name;
+}
+
+const std::vector<PassResource>& RenderPass::Inputs()const
+{
+    return mInputs;
+}
+
+const std::vector<PassResource>& RenderPass::Outputs()const
+{
+    return mOutputs;
+}
+
+const std::vector<std::wstring>& RenderPass::TransientOutputs()const
+{
+    return mTransientOutputs;
+}
+
+bool RenderPass::GraphBarriers()const
+{
+    return mGraphBarriers;
+}
+
+bool RenderPass::Cullable()const
+{
+    return mCullable;
+}
+
+void RenderPass::SetEnabled(bool enabled)
+{
+    if (mEnabled != enabled)
+        mGraphVersion++;
+    mEnabled = enabled;
+}
+
+bool RenderPass::Enabled()const
+{
+    return mEnabled;
+}
+
+UINT RenderPass::GraphVersion()const
+{
+    return mGraphVersion;
+}
+
+void RenderPass::FindPipelines()
+{
+    if (!pso1.empty())
+        mPso1 = mPSOs->FindPSO(pso1);
+    if (!pso2.empty())
+        mPso2 = mPSOs->FindPSO(pso2);
+    if (!pso3.empty())
+        mPso3 = mPSOs->FindPSO(pso3);
+    if (!rootSig1.empty())
+        mRootSig1 = mPSOs->FindRootSignature(rootSig1);
+    if (!rootSig2.empty())
+        mRootSig2 = mPSOs->FindRootSignature(rootSig2);
+    if (!rootSig3.empty())
+        mRootSig3 = mPSOs->FindRootSignature(rootSig3);
+}
+
+void RenderPass::Reads(const std::wstring& resource, D3D12_RESOURCE_STATES state)
+{
+    mInputs.push_back({ resource, state });
+    mGraphVersion++;
+}
+
+void RenderPass::Writes(const std::wstring& resource, D3D12_RESOURCE_STATES state)
+{
+    mOutputs.push_back({ resource, state });
+    mGraphVersion++;
+}
+
+void RenderPass::WritesTransient(const std::wstring& resource, D3D12_RESOURCE_STATES state)
+{
+    Writes(resource, state);
+    mTransientOutputs.push_back(resource);
+}
+
 BOOL RenderPass::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
 {
 	if((mWidth != newWidth) || (mHeight != newHeight) || (mDepth != newDepth))
@@ -4,6 +4,13 @@
 #include "../main/PSO.h"
 #include <DirectXMath.h>
  
+// A named resource a pass declares and the state it uses it in.
+struct PassResource
+{
+	std::wstring Name;
+	D3D12_RESOURCE_STATES State;
+};
+
 class RenderPass
 {
 public:
@@ -22,6 +29,26 @@ public:
 	virtual BOOL OnResize(UINT newWidth, UINT newHeight, UINT newDepth = 1);
 	virtual void Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame) = 0;
 
+	const std::wstring& Name()const;
+
+	// Named resources the pass samples and renders to, in declaration order.
+	const std::vector<PassResource>& Inputs()const;
+	const std::vector<PassResource>& Outputs()const;
+	// Outputs the pass clears before use and nothing reads in a later frame,
+	// so their memory can be shared with targets of other parts of the frame.
+	const std::vector<std::wstring>& TransientOutputs()const;
+	// The declarations are complete and Draw() leaves the transitions to the render graph.
+	bool GraphBarriers()const;
+	// Nothing outside the declared outputs depends on the pass, so it may be culled.
+	bool Cullable()const;
+	// Disabled passes are left out of the render graph and not drawn.
+	void SetEnabled(bool enabled);
+	bool Enabled()const;
+	// Changes whenever the pass's part of the render graph does.
+	UINT GraphVersion()const;
+	// Interns pso1-3 and rootSig1-3 once the pass is built; Draw() binds by id.
+	void FindPipelines();
+
 protected:
 	const std::wstring name;
 	ComPtr<ID3D12Device> md3dDevice;
@@ -33,6 +60,12 @@ protected:
 	std::wstring rootSig1;
 	std::wstring rootSig2;
 	std::wstring rootSig3;
+	PsoId mPso1;
+	PsoId mPso2;
+	PsoId mPso3;
+	RootSignatureId mRootSig1;
+	RootSignatureId mRootSig2;
+	RootSignatureId mRootSig3;
 
 	UINT mWidth = 0;
 	UINT mHeight = 0;
@@ -41,6 +74,14 @@ protected:
 	D3D12_RECT mScissorRect;
 	// std::unordered_map<std::string, DXGI_FORMAT> Formats;
 
+	std::vector<PassResource> mInputs;
+	std::vector<PassResource> mOutputs;
+	std::vector<std::wstring> mTransientOutputs;
+	bool mGraphBarriers = false;
+	bool mCullable = false;
+	bool mEnabled = true;
+	UINT mGraphVersion = 0;
+
 	static constexpr D3D12_RESOURCE_STATES DWstate = D3D12_RESOURCE_STATE_DEPTH_WRITE;
 	static constexpr D3D12_RESOURCE_STATES DRstate = D3D12_RESOURCE_STATE_DEPTH_READ;
 	static constexpr D3D12_RESOURCE_STATES GRstate = D3D12_RESOURCE_STATE_GENERIC_READ;
@@ -54,6 +95,10 @@ protected:
 	static constexpr DXGI_FORMAT HDRFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
 	static constexpr DXGI_FORMAT DepthFormat = DXGI_FORMAT_R32_FLOAT;
 
+	void Reads(const std::wstring& resource, D3D12_RESOURCE_STATES state = GRstate);
+	void Writes(const std::wstring& resource, D3D12_RESOURCE_STATES state = RTstate);
+	void WritesTransient(const std::wstring& resource, D3D12_RESOURCE_STATES state = RTstate);
+
 	virtual void BuildResources() = 0;
 	virtual void BuildDescriptors() = 0;
 	virtual void BuildRootSignatureAndPSO() = 0;
@@ -15,21 +15,75 @@ SceneRenderPass::SceneRenderPass(
     mScene = Scene;
 }
 
-void SceneRenderPass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame)
+void SceneRenderPass::BeginFrame(FXMMATRIX view)
 {
-    const std::vector<RenderItem*>& ritems = mScene->RenderItems(layer);
+    XMFLOAT4X4 v;
+    XMStoreFloat4x4(&v, view);
+    mDepthAxis = XMFLOAT4(v._13, v._23, v._33, v._43);
+    mDrawList.BeginFrame();
+}
+
+void SceneRenderPass::AddDraw(PsoId pso, const RenderItem* ri)
+{
+    const XMFLOAT3& c = ri->Bounds.Center;
+    const float depth = c.x * mDepthAxis.x + c.y * mDepthAxis.y + c.z * mDepthAxis.z + mDepthAxis.w;
+    mDrawList.Add(mPassIndex, pso.Index, ri, depth);
+}
+
+void SceneRenderPass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame, PsoId pso, bool visibleOnly)
+{
+    DrawRenderItems(cmdList, { layer }, currFrame, pso, visibleOnly);
+}
+
+void SceneRenderPass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, std::initializer_list<RenderLayer> layers, FrameResource* currFrame, PsoId pso, bool visibleOnly)
+{
+    mDrawList.Begin();
+    for (auto layer : layers)
+    {
+        for (auto ri : mScene->RenderItems(layer))
+        {
+            // Skip items the CPU occlusion culler hid from the main camera.
+            if (visibleOnly && !ri->Visible)
+                continue;
+            AddDraw(pso, ri);
+        }
+    }
+    SubmitDrawList(cmdList, currFrame);
+}
+
+void SceneRenderPass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& items, FrameResource* currFrame, PsoId pso)
+{
+    mDrawList.Begin();
+    for (auto ri : items)
+        AddDraw(pso, ri);
+    SubmitDrawList(cmdList, currFrame);
+}
+
+void SceneRenderPass::SubmitDrawList(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
+{
+    mDrawList.Sort();
+
     UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
     auto objectCB = currFrame->ObjectCB->Resource();
 
     // For each render item...
-    for (size_t i = 0; i < ritems.size(); ++i)
+    for (const auto& cmd : mDrawList.Commands())
     {
-        auto ri = ritems[i];
+        const RenderItem* ri = cmd.Item;
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+        if (cmd.Flags & DrawBindPipeline)
+        {
+            PsoId pso;
+            pso.Index = cmd.Pso;
+            cmdList->SetPipelineState(mPSOs->GetPSO(pso));
+        }
+        if (cmd.Flags & DrawBindVertexBuffer)
+            cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+        if (cmd.Flags & DrawBindIndexBuffer)
+            cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+        if (cmd.Flags & DrawBindTopology)
+            cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + (UINT64)ri->ObjCBIndex * objCBByteSize;
 
@@ -38,3 +92,35 @@ void SceneRenderPass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const
         cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
     }
 }
+
+void SceneRenderPass::DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame, UINT instanceRootParameter)
+{
+    const std::vector<InstanceBatch>& batches = mScene->Instancing(layer).Batches();
+
+    auto instanceBuffer = currFrame->InstanceBufferAddress;
+
+    // Batches come sorted by mesh, so the buffers only change between meshes.
+    const Mesh* lastGeo = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY lastTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    for (const auto& batch : batches)
+    {
+        if (batch.Geo != lastGeo)
+        {
+            cmdList->IASetVertexBuffers(0, 1, &batch.Geo->VertexBufferView());
+            cmdList->IASetIndexBuffer(&batch.Geo->IndexBufferView());
+            lastGeo = batch.Geo;
+        }
+        if (batch.PrimitiveType != lastTopology)
+        {
+            cmdList->IASetPrimitiveTopology(batch.PrimitiveType);
+            lastTopology = batch.PrimitiveType;
+        }
+
+        // SV_InstanceID restarts at 0, so offset the root SRV to the batch's first instance.
+        D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = instanceBuffer + (UINT64)batch.FirstInstance * sizeof(InstanceData);
+
+        cmdList->SetGraphicsRootShaderResourceView(instanceRootParameter, instanceAddress);
+
+        cmdList->DrawIndexedInstanced(batch.IndexCount, batch.InstanceCount, batch.StartIndexLocation, batch.BaseVertexLocation, 0);
+    }
+}
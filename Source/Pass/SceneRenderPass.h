@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RenderPass.h"
+#include "../main/DrawList.h"
 
 class SceneRenderPass : public RenderPass
 {
@@ -15,9 +16,33 @@ public:
     SceneRenderPass& operator=(const SceneRenderPass& rhs) = delete;
     ~SceneRenderPass() = default;
 
+    // Draw stats of the pass over the last whole frame.
+    const DrawListStats& DrawStats()const { return mDrawList.Stats(); }
+
+    // The pass's place in the frame, the top field of its draw keys.
+    void SetPassIndex(UINT index) { mPassIndex = index; }
+    // Once a frame, before Draw(): items sort front to back along the view's z.
+    void BeginFrame(DirectX::FXMMATRIX view);
+
 protected:
     std::shared_ptr<LampGeo> mScene;
+    LampDrawList mDrawList;
+
+    // The draws bind pso themselves.
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame, PsoId pso, bool visibleOnly = false);
+    // Sorts the items of all layers into one list so shared meshes are bound once.
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, std::initializer_list<RenderLayer> layers, FrameResource* currFrame, PsoId pso, bool visibleOnly = false);
+    // Sorts and draws the given items, picked by the caller.
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& items, FrameResource* currFrame, PsoId pso);
+    // Draws the layer's instanced batches; per-instance data is bound as a root SRV.
+    void DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame, UINT instanceRootParameter);
 
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, FrameResource* currFrame);
+private:
+    // Sorts mDrawList and submits it.
+    void SubmitDrawList(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame);
+    void AddDraw(PsoId pso, const RenderItem* ri);
 
+    UINT mPassIndex = 0;
+    // View space z of a world position: dot(p, xyz) + w.
+    DirectX::XMFLOAT4 mDepthAxis = { 0.0f, 0.0f, 1.0f, 0.0f };
 };
@@ -1,4 +1,6 @@
 #include "ScreenRenderPass.h"
+#include "../main/VoxelClipmap.h"
+#include "../main/AnisoVoxels.h"
 
 using namespace DirectX;
 using namespace DirectX::PackedVector;
@@ -22,3 +24,48 @@ void ScreenRenderPass::DrawFullScreen(ID3D12GraphicsCommandList* cmdList)
 
     cmdList->DrawInstanced(6, 1, 0, 0);
 }
+
+void ScreenRenderPass::ReadsVoxelCoarse()
+{
+    static_assert(VOXEL_LEVELS > 1, "No coarse voxel levels to read");
+    for (UINT level = 1; level < VOXEL_LEVELS; ++level)
+    {
+        const std::wstring color = LampVoxelClipmap::VolumeName(L"VoxelizedColor", level);
+        Reads(color);
+        mVoxelCoarse.push_back(mHeaps->FindSrv(color));
+    }
+}
+
+CD3DX12_DESCRIPTOR_RANGE ScreenRenderPass::VoxelCoarseRange()const
+{
+    CD3DX12_DESCRIPTOR_RANGE range;
+    range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, VOXEL_LEVELS - 1, 0, 1);
+    return range;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE ScreenRenderPass::VoxelCoarseTable()
+{
+    return mHeaps->Table(mVoxelCoarse);
+}
+
+void ScreenRenderPass::ReadsVoxelAniso()
+{
+    for (UINT face = 0; face < LampAnisoVoxels::Faces; ++face)
+    {
+        const std::wstring volume = LampAnisoVoxels::VolumeName(L"VoxelizedColor", face);
+        Reads(volume);
+        mVoxelAniso.push_back(mHeaps->FindSrv(volume));
+    }
+}
+
+CD3DX12_DESCRIPTOR_RANGE ScreenRenderPass::VoxelAnisoRange()const
+{
+    CD3DX12_DESCRIPTOR_RANGE range;
+    range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, LampAnisoVoxels::Faces, 0, 2);
+    return range;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE ScreenRenderPass::VoxelAnisoTable()
+{
+    return mHeaps->Table(mVoxelAniso);
+}
@@ -16,4 +16,19 @@ public:
 
 protected:
     void DrawFullScreen(ID3D12GraphicsCommandList* cmdList);
+
+    // Colors of the voxel clipmap levels past the first, gVoxelCoarse in VoxelClipmap.hlsli.
+    // ReadsVoxelCoarse() declares them; VoxelCoarseRange() is their table in the root
+    // signature, bound to VoxelCoarseTable() each draw.
+    void ReadsVoxelCoarse();
+    CD3DX12_DESCRIPTOR_RANGE VoxelCoarseRange()const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE VoxelCoarseTable();
+    // The six faces AnisoMipmap3D writes above level 0's mip 0, gVoxelAniso in space2.
+    void ReadsVoxelAniso();
+    CD3DX12_DESCRIPTOR_RANGE VoxelAnisoRange()const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE VoxelAnisoTable();
+
+private:
+    std::vector<SrvHandle> mVoxelCoarse;
+    std::vector<SrvHandle> mVoxelAniso;
 };
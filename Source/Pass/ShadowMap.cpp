@@ -8,17 +8,19 @@ Shadow::Shadow(ComPtr<ID3D12Device> device,
 {
 	pso1 = name;
 	rootSig1 = L"shadow";
+	mShadowDsv = mHeaps->FindDsv(mShadow);
+	mShadowRes = mHeaps->FindResource(mShadow);
 	BuildRootSignatureAndPSO();
 }
 
 void Shadow::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 {
-	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 	cmdList->RSSetViewports(1, &mViewport);
 	cmdList->RSSetScissorRects(1, &mScissorRect);
 
-	auto passCB = currFrame->PassCB->Resource();
-	cmdList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	auto passCB = currFrame->PassCBAddress[0];
+	cmdList->SetGraphicsRootConstantBufferView(1, passCB);
 
 	auto matBuffer = currFrame->MaterialBuffer->Resource();
 	cmdList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
@@ -26,27 +28,23 @@ void Shadow::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 	cmdList->SetGraphicsRootDescriptorTable(3,  mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
 
 	// Change to DEPTH_WRITE.
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mShadow), GRstate, DWstate));
+	mHeaps->States().Require(mHeaps->Resource(mShadowRes), DWstate);
+	mHeaps->States().Flush(cmdList);
 
 	// Clear the depth buffer.
-	cmdList->ClearDepthStencilView(mHeaps->GetDsv(mShadow),
+	cmdList->ClearDepthStencilView(mHeaps->Dsv(mShadowDsv),
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
 	// Specify the buffers we are going to render to.
-	cmdList->OMSetRenderTargets(0, nullptr, false, &mHeaps->GetDsv(mShadow));
+	cmdList->OMSetRenderTargets(0, nullptr, false, &mHeaps->Dsv(mShadowDsv));
 
 	// Bind the pass constant buffer for the shadow map pass.
-	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-	D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1 * passCBByteSize;
-	cmdList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+	cmdList->SetGraphicsRootConstantBufferView(1, currFrame->PassCBAddress[1]);
 
-	cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
-
-	DrawRenderItems(cmdList, RenderLayer::Opaque, currFrame);
-	DrawRenderItems(cmdList, RenderLayer::Wall, currFrame);
+	DrawRenderItems(cmdList, { RenderLayer::Opaque, RenderLayer::Wall }, currFrame, mPso1);
 
 	// Change back to GENERIC_READ so we can read the texture in a shader.
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mShadow), DWstate, GRstate));
+	mHeaps->States().Release(mHeaps->Resource(mShadowRes), GRstate);
 }
 
 BOOL Shadow::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
@@ -29,6 +29,8 @@ private:
 	const std::wstring mColorLS = L"ColorLS";
 	const std::wstring mNormalLS = L"NormalLS";
 	const std::wstring mShadow = L"MainLightShadow";
+	DsvHandle mShadowDsv;
+	ResourceHandle mShadowRes;
 
 	const UINT mRSMWidth = 512;
 	const UINT mRSMHeight = 256;
@@ -39,7 +39,7 @@ void Ssao::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
     cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mAmbient0), true, nullptr);
 
     // Bind the constant buffer for this pass.
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCBAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
     cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 
@@ -140,7 +140,7 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
 {
     cmdList->SetPipelineState(mPSOs->GetPSO(name));
 
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCBAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
  
     for(int i = 0; i < blurCount; ++i)
@@ -7,6 +7,7 @@ TAA::TAA(ComPtr<ID3D12Device> device,
 {
     pso1 = name;
     rootSig1 = L"taa";
+    mDepth = mHeaps->FindSrv(L"Depth");
     BuildRootSignatureAndPSO();
 }
 
@@ -14,15 +15,19 @@ void TAA::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 {
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
+    // Only reads resting resources, but whatever is still queued has to land first.
+    mHeaps->States().Flush(cmdList);
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
 
-    auto taaCB = currFrame->TaaCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, taaCB->GetGPUVirtualAddress());
-    cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->HistorySrv());
-    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->CurrentSrv());
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"Depth"));
+    auto passCB = currFrame->PassCBAddress[0];
+    auto taaCB = currFrame->TaaCBAddress;
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
+    cmdList->SetGraphicsRootConstantBufferView(1, taaCB);
+    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->HistorySrv());
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->CurrentSrv());
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mDepth));
 
     // Draw fullscreen quad.
     DrawFullScreen(cmdList);
@@ -59,18 +64,19 @@ void TAA::BuildRootSignatureAndPSO()
     srvTable2.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsConstantBufferView(0);
-    slotRootParameter[1].InitAsDescriptorTable(1, &srvTable0);
-    slotRootParameter[2].InitAsDescriptorTable(1, &srvTable1);
-    slotRootParameter[3].InitAsDescriptorTable(1, &srvTable2);
+    slotRootParameter[1].InitAsConstantBufferView(1);
+    slotRootParameter[2].InitAsDescriptorTable(1, &srvTable0);
+    slotRootParameter[3].InitAsDescriptorTable(1, &srvTable1);
+    slotRootParameter[4].InitAsDescriptorTable(1, &srvTable2);
 
     auto staticSamplers = mPSOs->GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
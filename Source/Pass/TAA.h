@@ -22,5 +22,5 @@ protected:
     void BuildDescriptors()override;
 
 private:
-
+    SrvHandle mDepth;
 };
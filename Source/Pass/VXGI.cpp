@@ -30,8 +30,8 @@ void VXGI::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 
     cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
     cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(L"BaseColor"));
     cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"VoxelizedColor"));
@@ -3,80 +3,153 @@
 Voxel::Voxel(ComPtr<ID3D12Device> device,
 	std::shared_ptr<DescriptorHeap> heaps,
 	std::shared_ptr<LampPSO> PSOs,
-	std::shared_ptr<LampGeo> Scene)
+	std::shared_ptr<LampGeo> Scene,
+	std::shared_ptr<LampVoxelClipmap> clipmap,
+	std::shared_ptr<LampVoxelBake> bake)
 	: SceneRenderPass(device, heaps, PSOs, Scene, L"Voxelize", 6)
 {
+	mClipmap = clipmap;
+	mBake = bake;
 	pso1 = name;
 	rootSig1 = L"Voxelize";
+	pso2 = L"ClearVoxels";
+	rootSig2 = L"ClearVoxels";
+	pso3 = L"InjectVoxels";
+	rootSig3 = L"InjectVoxels";
+	Reads(L"MainLightShadow");
+	Writes(mVoxelColor, UAstate);
+	Writes(mVoxelNormal, UAstate);
+	Writes(mVoxelMat, UAstate);
+	// Coarser levels keep color only.
+	for (UINT level = 1; level < mClipmap->Levels(); ++level)
+		Writes(LampVoxelClipmap::VolumeName(mVoxelColor, level), UAstate);
+	WritesTransient(mTempTarget);
+	mGraphBarriers = true;
+	mTempRtv = mHeaps->FindRtv(mTempTarget);
+	for (UINT level = 0; level < mClipmap->Levels(); ++level)
+		mLevelUavs.push_back(mHeaps->FindUav(LampVoxelClipmap::VolumeName(mVoxelColor, level)));
+	mShadowSrv = mHeaps->FindSrv(L"MainLightShadow");
 	BuildRootSignatureAndPSO();
 }
 
 void Voxel::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame)
 {
-	cmdList->RSSetViewports(1, &mViewport);
-	cmdList->RSSetScissorRects(1, &mScissorRect);
+	// Only what the windows moved onto, and this frame's refresh slice.
+	const std::vector<VoxelSlab>& slabs = mClipmap->Slabs();
+	if (slabs.empty())
+		return;
 
-	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+	cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig2));
+	cmdList->SetPipelineState(mPSOs->GetPSO(mPso2));
+	for (const auto& slab : slabs)
+		ClearSlab(cmdList, slab);
+	auto clearDone = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+	cmdList->ResourceBarrier(1, &clearDone);
 
-	// Change to RENDER_TARGET.
-	std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTempTarget), GRstate, RTstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelColor), GRstate, UAstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelNormal), GRstate, UAstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelMat), GRstate, UAstate)
-	};
-	cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+	// With a bake, the static items come from it and only the dynamic ones are rasterized.
+	const bool baked = mBake->Ready();
+	if (baked && currFrame->StaticVoxelAddress != 0)
+	{
+		assert(mBake->Ranges().size() == slabs.size());
+		cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig3));
+		cmdList->SetPipelineState(mPSOs->GetPSO(mPso3));
+		cmdList->SetComputeRootConstantBufferView(1, currFrame->PassCBAddress[0]);
+		cmdList->SetComputeRootShaderResourceView(2, currFrame->StaticVoxelAddress);
+		cmdList->SetComputeRootDescriptorTable(3, mHeaps->Srv(mShadowSrv));
+		for (size_t i = 0; i < slabs.size(); ++i)
+			InjectSlab(cmdList, slabs[i], mBake->Ranges()[i]);
+		auto injectDone = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+		cmdList->ResourceBarrier(1, &injectDone);
+	}
+
+	// The geometry shader picks one viewport per projection axis; each gets the slab's scissor.
+	const D3D12_VIEWPORT viewports[3] = { mViewport, mViewport, mViewport };
+	cmdList->RSSetViewports(3, viewports);
+
+	cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
 
 	float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	cmdList->ClearRenderTargetView(mHeaps->GetRtv(mTempTarget), clearValue, 0, nullptr);
-
-	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = mHeaps->CustomSRVHeap()->GetDesc();
-
-	D3D12_CPU_DESCRIPTOR_HANDLE tempCPUHandle = mHeaps->CustomSRVHeap()->GetCPUDescriptorHandleForHeapStart();
-	D3D12_CPU_DESCRIPTOR_HANDLE uavCPUHandle = mHeaps->GetCPUUav(mVoxelColor);
-
-	D3D12_GPU_DESCRIPTOR_HANDLE tempGPUHandle = mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart();
-	D3D12_GPU_DESCRIPTOR_HANDLE uavGPUHandle = mHeaps->GetGPUUav(mVoxelColor);
-	/*
-	if (uavCPUHandle.ptr >= tempCPUHandle.ptr && uavCPUHandle.ptr < tempCPUHandle.ptr + heapDesc.NumDescriptors * 144)
-		OutputDebugString(L"CPUuavHandle is on my heap.\n");
-	if (uavGPUHandle.ptr >= tempGPUHandle.ptr && uavGPUHandle.ptr < tempGPUHandle.ptr + heapDesc.NumDescriptors * 144)
-		OutputDebugString(L"GPUUavHandle is on my heap.\n");
-	if(heapDesc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
-		OutputDebugString(L"Heap flags is D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE.\n");
-
-	D3D12_RESOURCE_DESC resourceDesc = mHeaps->GetResource(mVoxelColor)->GetDesc();
-	if(resourceDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)
-		OutputDebugString(L"resource State is D3D12_RESOURCE_STATE_UNORDERED_ACCESS.\n");
-	*/
-	// cmdList->ClearUnorderedAccessViewFloat(mHeaps->GetGPUUav(mVoxelColor), mHeaps->GetCPUUav(mVoxelColor),
-	//	mHeaps->GetResource(mVoxelColor), clearValue, 0, nullptr);
+	cmdList->ClearRenderTargetView(mHeaps->Rtv(mTempRtv), clearValue, 0, nullptr);
 
 	// Specify the buffers we are going to render to.
-	cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(mTempTarget), false, nullptr);
+	cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mTempRtv), false, nullptr);
 	// textures
 	cmdList->SetGraphicsRootDescriptorTable(5, mHeaps->CustomSRVHeap()->GetGPUDescriptorHandleForHeapStart());
 
 	auto matBuffer = currFrame->MaterialBuffer->Resource();
 	cmdList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
 
-	auto passCB = currFrame->PassCB->Resource();
-	cmdList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	auto passCB = currFrame->PassCBAddress[0];
+	cmdList->SetGraphicsRootConstantBufferView(1, passCB);
+
+	cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mShadowSrv));
+
+	const std::vector<RenderItem*>& opaque = mScene->RenderItems(RenderLayer::Opaque);
+	mDynamicItems.clear();
+	for (auto ri : opaque)
+	{
+		if (!ri->Static)
+			mDynamicItems.push_back(ri);
+	}
+	const std::vector<RenderItem*>& items = baked ? mDynamicItems : opaque;
+	for (const auto& slab : slabs)
+	{
+		mClipmap->SelectItems(slab, items, mSlabItems);
+		if (mSlabItems.empty())
+			continue;
+
+		D3D12_RECT scissors[3];
+		for (UINT axis = 0; axis < 3; ++axis)
+			scissors[axis] = mClipmap->Scissor(slab, axis, mWidth);
+		cmdList->RSSetScissorRects(3, scissors);
+
+		const VoxelClipLevel& level = mClipmap->Level(slab.Level);
+		VoxelSlabConstants constants = {};
+		constants.SlabMin = DirectX::XMINT3(slab.Box.Min[0], slab.Box.Min[1], slab.Box.Min[2]);
+		constants.SlabMax = DirectX::XMINT3(slab.Box.Max[0], slab.Box.Max[1], slab.Box.Max[2]);
+		constants.SlabWindowMin = DirectX::XMINT3(level.Origin[0], level.Origin[1], level.Origin[2]);
+		constants.SlabVoxelSize = level.VoxelSize;
+		constants.SlabLevel = slab.Level;
+		cmdList->SetGraphicsRoot32BitConstants(6, sizeof(VoxelSlabConstants) / 4, &constants, 0);
+		cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GpuUav(mLevelUavs[slab.Level]));
+
+		DrawRenderItems(cmdList, mSlabItems, currFrame, mPso1);
+	}
+}
+
+void Voxel::ClearSlab(ID3D12GraphicsCommandList* cmdList, const VoxelSlab& slab)
+{
+	cmdList->SetComputeRootDescriptorTable(1, mHeaps->GpuUav(mLevelUavs[slab.Level]));
+	for (const auto& texels : slab.Texels)
+	{
+		VoxelClearConstants constants = {};
+		constants.ClearMin = DirectX::XMUINT3(texels.Min[0], texels.Min[1], texels.Min[2]);
+		constants.ClearSize = DirectX::XMUINT3(texels.Max[0] - texels.Min[0], texels.Max[1] - texels.Min[1], texels.Max[2] - texels.Min[2]);
+		cmdList->SetComputeRoot32BitConstants(0, sizeof(VoxelClearConstants) / 4, &constants, 0);
 
-	cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"MainLightShadow"));
-	cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetGPUUav(mVoxelColor));
+		UINT numGroupsX = (UINT)ceilf(constants.ClearSize.x / 4.0f);
+		UINT numGroupsY = (UINT)ceilf(constants.ClearSize.y / 4.0f);
+		UINT numGroupsZ = (UINT)ceilf(constants.ClearSize.z / 4.0f);
 
-	cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+		cmdList->Dispatch(numGroupsX, numGroupsY, numGroupsZ);
+	}
+}
 
-	DrawRenderItems(cmdList, RenderLayer::Opaque, currFrame);
+void Voxel::InjectSlab(ID3D12GraphicsCommandList* cmdList, const VoxelSlab& slab, const LampVoxelBake::Range& range)
+{
+	if (range.Count == 0)
+		return;
+	const VoxelClipLevel& level = mClipmap->Level(slab.Level);
+	VoxelInjectConstants constants = {};
+	constants.InjectWindowMin = DirectX::XMINT3(level.Origin[0], level.Origin[1], level.Origin[2]);
+	constants.InjectFirst = range.First;
+	constants.InjectVoxelSize = level.VoxelSize;
+	constants.InjectCount = range.Count;
+	cmdList->SetComputeRoot32BitConstants(0, sizeof(VoxelInjectConstants) / 4, &constants, 0);
+	cmdList->SetComputeRootDescriptorTable(4, mHeaps->GpuUav(mLevelUavs[slab.Level]));
 
-	resourceBarriers = {
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mTempTarget), RTstate, GRstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelColor), UAstate, GRstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelNormal), UAstate, GRstate),
-		CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(mVoxelMat), UAstate, GRstate)
-	};
-	cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+	UINT numGroupsX = (UINT)ceilf(range.Count / 64.0f);
+	cmdList->Dispatch(numGroupsX, 1, 1);
 }
 
 void Voxel::BuildDescriptors()
@@ -91,16 +164,27 @@ void Voxel::BuildDescriptors()
 	mHeaps->CreateSRV(mVoxelColor, &srvDesc);
 	mHeaps->CreateSRV(mVoxelMat, &srvDesc);
 	mHeaps->CreateSRV(mVoxelNormal, &srvDesc);
-	
+	srvDesc.Texture3D.MipLevels = 1;
+	for (UINT level = 1; level < mClipmap->Levels(); ++level)
+		mHeaps->CreateSRV(LampVoxelClipmap::VolumeName(mVoxelColor, level), &srvDesc);
+
 	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 	uavDesc.Format = LDRFormat;
 	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
 	uavDesc.Texture3D.MipSlice = 0;
-	uavDesc.Texture3D.WSize = 256;
+	uavDesc.Texture3D.WSize = mDepth;
 	uavDesc.Texture3D.FirstWSlice = 0;
+	// Each level's three UAVs are created together so they form one table.
 	mHeaps->CreateUAV(mVoxelColor, &uavDesc);
 	mHeaps->CreateUAV(mVoxelMat, &uavDesc);
 	mHeaps->CreateUAV(mVoxelNormal, &uavDesc);
+	for (UINT level = 1; level < mClipmap->Levels(); ++level)
+	{
+		mHeaps->CreateUAV(LampVoxelClipmap::VolumeName(mVoxelColor, level), &uavDesc);
+		// Null views: writes to them are dropped.
+		mHeaps->CreateUAV(LampVoxelClipmap::VolumeName(mVoxelMat, level), nullptr, &uavDesc);
+		mHeaps->CreateUAV(LampVoxelClipmap::VolumeName(mVoxelNormal, level), nullptr, &uavDesc);
+	}
 
 	D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
 	rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
@@ -116,6 +200,8 @@ BOOL Voxel::OnResize(UINT newWidth, UINT newHeight, UINT newDepth)
 	{
 		BuildResources();
 		BuildDescriptors();
+		// The new volumes are empty.
+		mClipmap->Invalidate();
 		return true;
 	}
 	return false;
@@ -132,6 +218,12 @@ void Voxel::BuildResources()
 	mHeaps->CreateCommitResource3D(mVoxelNormal,
 		mWidth, mHeight/2, mDepth, LDRFormat,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, nullptr, 7);
+	for (UINT level = 1; level < mClipmap->Levels(); ++level)
+	{
+		mHeaps->CreateCommitResource3D(LampVoxelClipmap::VolumeName(mVoxelColor, level),
+			mWidth, mHeight/2, mDepth, LDRFormat,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, nullptr, 1);
+	}
 
 	mHeaps->CreateCommitResource2D(mTempTarget, mWidth, mHeight,
 		LDRFormat, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
@@ -146,7 +238,7 @@ void Voxel::BuildRootSignatureAndPSO()
 	CD3DX12_DESCRIPTOR_RANGE uavTable0;
 	uavTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0);
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[6];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[7];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsConstantBufferView(0);
@@ -155,11 +247,12 @@ void Voxel::BuildRootSignatureAndPSO()
 	slotRootParameter[3].InitAsDescriptorTable(1, &uavTable0, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[4].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[5].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[6].InitAsConstants(sizeof(VoxelSlabConstants) / 4, 2);
 
 	auto staticSamplers = mPSOs->GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -175,4 +268,35 @@ void Voxel::BuildRootSignatureAndPSO()
 	DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
 	mPSOs->BuildGraphicsPSO(pso1, rootSig1, "VoxelizeVS", "VoxelizeGS", "VoxelizePS",
 		rtvFormats, DepthStencilState, RasterizerState);
-}
\ No newline at end of file
+
+	// Clears the texels of a slab before it is voxelized again.
+	CD3DX12_DESCRIPTOR_RANGE clearTable;
+	clearTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0);
+	CD3DX12_ROOT_PARAMETER clearParameter[2];
+	clearParameter[0].InitAsConstants(sizeof(VoxelClearConstants) / 4, 0);
+	clearParameter[1].InitAsDescriptorTable(1, &clearTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC clearSigDesc(2, clearParameter,
+		0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	mPSOs->CreateRootSignature(clearSigDesc, rootSig2);
+	mPSOs->BuildComputePSO(pso2, rootSig2, "clearVoxelsCS");
+
+	// Writes baked static voxels into cleared slabs, lit by the main light.
+	CD3DX12_DESCRIPTOR_RANGE injectShadowTable;
+	injectShadowTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	CD3DX12_DESCRIPTOR_RANGE injectUavTable;
+	injectUavTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0);
+	CD3DX12_ROOT_PARAMETER injectParameter[5];
+	injectParameter[0].InitAsConstants(sizeof(VoxelInjectConstants) / 4, 0);
+	injectParameter[1].InitAsConstantBufferView(1);
+	injectParameter[2].InitAsShaderResourceView(1);
+	injectParameter[3].InitAsDescriptorTable(1, &injectShadowTable);
+	injectParameter[4].InitAsDescriptorTable(1, &injectUavTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC injectSigDesc(5, injectParameter,
+		(UINT)staticSamplers.size(), staticSamplers.data(), D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	mPSOs->CreateRootSignature(injectSigDesc, rootSig3);
+	mPSOs->BuildComputePSO(pso3, rootSig3, "injectVoxelsCS");
+}
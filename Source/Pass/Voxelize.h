@@ -1,6 +1,8 @@
 #pragma once
 
 #include "SceneRenderPass.h"
+#include "../main/VoxelClipmap.h"
+#include "../main/VoxelBake.h"
 
 class Voxel final : public SceneRenderPass
 {
@@ -8,7 +10,9 @@ public:
 	Voxel(ComPtr<ID3D12Device> device,
 		std::shared_ptr<DescriptorHeap> heaps,
 		std::shared_ptr<LampPSO> PSOs,
-		std::shared_ptr<LampGeo> Scene);
+		std::shared_ptr<LampGeo> Scene,
+		std::shared_ptr<LampVoxelClipmap> clipmap,
+		std::shared_ptr<LampVoxelBake> bake);
 
 	Voxel(const Voxel& rhs) = delete;
 	Voxel& operator=(const Voxel& rhs) = delete;
@@ -26,11 +30,25 @@ protected:
 	void BuildDescriptors()override;
 
 private:
+	// Zeroes the slab's texels in all three volumes of its level.
+	void ClearSlab(ID3D12GraphicsCommandList* cmdList, const VoxelSlab& slab);
+	// Writes the slab's baked static voxels into the texels just cleared.
+	void InjectSlab(ID3D12GraphicsCommandList* cmdList, const VoxelSlab& slab, const LampVoxelBake::Range& range);
 
 	const std::wstring mTempTarget = L"VoxelizeTarget";
 	const std::wstring mVoxelColor = L"VoxelizedColor";
 	const std::wstring mVoxelNormal = L"VoxelizedNormal";
 	const std::wstring mVoxelMat = L"VoxelizedMat";
 
-};
+	std::shared_ptr<LampVoxelClipmap> mClipmap;
+	std::shared_ptr<LampVoxelBake> mBake;
+
+	RtvHandle mTempRtv;
+	// Color, mat and normal UAVs of each level, in that order.
+	std::vector<UavHandle> mLevelUavs;
+	SrvHandle mShadowSrv;
+	std::vector<RenderItem*> mSlabItems;
+	// The opaque items not in the bake, rasterized every frame.
+	std::vector<RenderItem*> mDynamicItems;
 
+};
@@ -9,6 +9,16 @@ WorldProbe::WorldProbe(ComPtr<ID3D12Device> device,
     rootSig1 = L"WorldProbe";
     pso2 = L"ProbeToSH";
     rootSig2 = L"ProbeToSH";
+    mProbeRtv = mHeaps->FindRtv(probeWS);
+    mProbeSrv = mHeaps->FindSrv(probeWS);
+    mHistorySrv = mHeaps->FindSrv(probeHis);
+    mVoxelSrv = mHeaps->FindSrv(L"VoxelizedColor");
+    ReadsVoxelCoarse();
+    mSHSrv = mHeaps->FindSrv(probeSH0);
+    mSHUav = mHeaps->FindUav(probeSH0);
+    mProbeRes = mHeaps->FindResource(probeWS);
+    mHistoryRes = mHeaps->FindResource(probeHis);
+    mSHRes = { mHeaps->FindResource(probeSH0), mHeaps->FindResource(probeSH1), mHeaps->FindResource(probeSH2) };
     BuildRootSignatureAndPSO();
 }
 
@@ -16,61 +26,56 @@ void WorldProbe::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFra
 {
     cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
-    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(rootSig1));
+    cmdList->SetGraphicsRootSignature(mPSOs->GetRootSignature(mRootSig1));
     // Change to RENDER_TARGET.
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeWS),
-        GRstate, RTstate));
+    auto& states = mHeaps->States();
+    ID3D12Resource* probe = mHeaps->Resource(mProbeRes);
+    ID3D12Resource* history = mHeaps->Resource(mHistoryRes);
+    states.Require(probe, RTstate);
+    states.Flush(cmdList);
 
     float clearValue[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    cmdList->ClearRenderTargetView(mHeaps->GetRtv(probeWS), clearValue, 0, nullptr);
+    cmdList->ClearRenderTargetView(mHeaps->Rtv(mProbeRtv), clearValue, 0, nullptr);
 
     // Specify the buffers we are going to render to.
-    cmdList->OMSetRenderTargets(1, &mHeaps->GetRtv(probeWS), false, nullptr);
+    cmdList->OMSetRenderTargets(1, &mHeaps->Rtv(mProbeRtv), false, nullptr);
 
-    auto passCB = currFrame->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
+    auto passCB = currFrame->PassCBAddress[0];
+    cmdList->SetGraphicsRootConstantBufferView(0, passCB);
     cmdList->SetGraphicsRootDescriptorTable(1, mHeaps->SkySrv());
-    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->GetSrv(probeHis));
-    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->GetSrv(L"VoxelizedColor"));
-    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->GetSrv(L"ProbeSH0"));
+    cmdList->SetGraphicsRootDescriptorTable(2, mHeaps->Srv(mHistorySrv));
+    cmdList->SetGraphicsRootDescriptorTable(3, mHeaps->Srv(mVoxelSrv));
+    cmdList->SetGraphicsRootDescriptorTable(4, mHeaps->Srv(mSHSrv));
+    cmdList->SetGraphicsRootDescriptorTable(5, VoxelCoarseTable());
 
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso1));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso1));
     // Draw fullscreen quad.
     DrawFullScreen(cmdList);
 
-    std::vector<D3D12_RESOURCE_BARRIER> resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeWS), RTstate, CSstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeHis), GRstate, CDstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    states.Require(probe, CSstate);
+    states.Require(history, CDstate);
+    states.Flush(cmdList);
 
-    cmdList->CopyResource(mHeaps->GetResource(probeHis), mHeaps->GetResource(probeWS));
+    cmdList->CopyResource(history, probe);
 
-    resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeWS), CSstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeHis), CDstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH0), GRstate, UAstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH1), GRstate, UAstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH2), GRstate, UAstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
+    // The history is only read next frame, so its transition overlaps the dispatch.
+    states.Release(history, GRstate, true);
+    states.Require(probe, GRstate);
+    for (auto sh : mSHRes)
+        states.Require(mHeaps->Resource(sh), UAstate);
+    states.Flush(cmdList);
 
-    cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(rootSig2));
-    cmdList->SetPipelineState(mPSOs->GetPSO(pso2));
+    cmdList->SetComputeRootSignature(mPSOs->GetRootSignature(mRootSig2));
+    cmdList->SetPipelineState(mPSOs->GetPSO(mPso2));
 
-    cmdList->SetComputeRootConstantBufferView(0, passCB->GetGPUVirtualAddress());
-    cmdList->SetComputeRootDescriptorTable(1, mHeaps->GetSrv(probeWS));
-    cmdList->SetComputeRootDescriptorTable(2, mHeaps->GetGPUUav(probeSH0));
+    cmdList->SetComputeRootConstantBufferView(0, passCB);
+    cmdList->SetComputeRootDescriptorTable(1, mHeaps->Srv(mProbeSrv));
+    cmdList->SetComputeRootDescriptorTable(2, mHeaps->GpuUav(mSHUav));
 
     cmdList->Dispatch(128, 128, 1);
 
-    resourceBarriers = {
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH0), UAstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH1), UAstate, GRstate),
-        CD3DX12_RESOURCE_BARRIER::Transition(mHeaps->GetResource(probeSH2), UAstate, GRstate)
-    };
-    cmdList->ResourceBarrier(resourceBarriers.size(), resourceBarriers.data());
-
+    for (auto sh : mSHRes)
+        states.Release(mHeaps->Resource(sh), GRstate);
 }
 
 void WorldProbe::BuildDescriptors()
@@ -121,6 +126,8 @@ void WorldProbe::BuildResources()
 {
     mHeaps->CreateCommitResource2D(probeWS, 1024, 1024,
         LDRFormat, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+    // Accumulated over frames, read before it is written.
+    mHeaps->KeepCommitted(probeHis);
     mHeaps->CreateCommitResource2D(probeHis, 1024, 1024,
         LDRFormat, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
 
@@ -144,7 +151,9 @@ void WorldProbe::BuildRootSignatureAndPSO()
     srvTable3.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 5);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
+    CD3DX12_DESCRIPTOR_RANGE coarseTable = VoxelCoarseRange(); // Coarse voxel levels
+
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsConstantBufferView(0);
@@ -152,11 +161,12 @@ void WorldProbe::BuildRootSignatureAndPSO()
     slotRootParameter[2].InitAsDescriptorTable(1, &srvTable1);
     slotRootParameter[3].InitAsDescriptorTable(1, &srvTable2);
     slotRootParameter[4].InitAsDescriptorTable(1, &srvTable3);
+    slotRootParameter[5].InitAsDescriptorTable(1, &coarseTable);
 
     auto staticSamplers = mPSOs->GetStaticSamplers1();
 
     // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
         (UINT)staticSamplers.size(), staticSamplers.data(),
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -27,4 +27,14 @@ private:
     const std::wstring probeSH0 = L"ProbeSH0";
     const std::wstring probeSH1 = L"ProbeSH1";
     const std::wstring probeSH2 = L"ProbeSH2";
+
+    RtvHandle mProbeRtv;
+    SrvHandle mProbeSrv;
+    SrvHandle mHistorySrv;
+    SrvHandle mVoxelSrv;
+    SrvHandle mSHSrv;
+    UavHandle mSHUav;
+    ResourceHandle mProbeRes;
+    ResourceHandle mHistoryRes;
+    std::array<ResourceHandle, 3> mSHRes;
 };
\ No newline at end of file
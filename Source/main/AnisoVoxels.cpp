@@ -0,0 +1,385 @@
+#include "AnisoVoxels.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+constexpr UINT LampAnisoVoxels::Faces;
+
+namespace
+{
+    // Children of a texel are i = x + 2y + 4z. A face's four columns run along its axis,
+    // front being the child a cone travelling that way reaches first.
+    void FaceColumns(UINT face, UINT front[4], UINT back[4])
+    {
+        const UINT bit = 1u << (face / 2);
+        const bool positive = face % 2 == 0;
+        UINT column = 0;
+        for (UINT i = 0; i < 8; ++i)
+        {
+            if (i & bit)
+                continue;
+            front[column] = positive ? i : i | bit;
+            back[column] = positive ? i | bit : i;
+            column++;
+        }
+    }
+
+    UINT Integrate(const XMFLOAT4 c[8], UINT face)
+    {
+        UINT front[4];
+        UINT back[4];
+        FaceColumns(face, front, back);
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (UINT column = 0; column < 4; ++column)
+        {
+            const float* f = &c[front[column]].x;
+            const float* b = &c[back[column]].x;
+            for (int k = 0; k < 4; ++k)
+                sum[k] = sum[k] + (f[k] + (1.0f - f[3]) * b[k]);
+        }
+        return LampVoxelizer::PackUnorm(sum[0] * 0.25f, sum[1] * 0.25f, sum[2] * 0.25f, sum[3] * 0.25f);
+    }
+
+    // Integrate() on all four channels at once; the same operations, so the same result.
+    UINT IntegrateSimd(const XMVECTOR c[8], UINT face)
+    {
+        UINT front[4];
+        UINT back[4];
+        FaceColumns(face, front, back);
+        const XMVECTOR one = XMVectorReplicate(1.0f);
+        XMVECTOR sum = XMVectorZero();
+        for (UINT column = 0; column < 4; ++column)
+        {
+            const XMVECTOR f = c[front[column]];
+            sum = XMVectorAdd(sum, XMVectorAdd(f, XMVectorMultiply(XMVectorSubtract(one, XMVectorSplatW(f)), c[back[column]])));
+        }
+        // PackUnorm(): saturate, scale and round.
+        const XMVECTOR packed = XMVectorAdd(XMVectorMultiply(XMVectorSaturate(XMVectorScale(sum, 0.25f)),
+            XMVectorReplicate(255.0f)), XMVectorReplicate(0.5f));
+        XMFLOAT4 unorm;
+        XMStoreFloat4(&unorm, packed);
+        return (UINT)unorm.x | ((UINT)unorm.y << 8) | ((UINT)unorm.z << 16) | ((UINT)unorm.w << 24);
+    }
+
+    // VoxelInLevel(): inside the window with margin voxels to spare.
+    bool InWindow(const XMFLOAT3& p, const UINT dims[3], const VoxelConeSetup& setup, float margin)
+    {
+        const float v[3] = { (p.x - setup.WindowMin.x) / setup.VoxelSize, (p.y - setup.WindowMin.y) / setup.VoxelSize,
+            (p.z - setup.WindowMin.z) / setup.VoxelSize };
+        for (int a = 0; a < 3; ++a)
+        {
+            if (!(v[a] >= margin && v[a] <= (float)dims[a] - margin))
+                return false;
+        }
+        return true;
+    }
+
+    XMFLOAT3 VoxelUVW(const XMFLOAT3& p, const UINT dims[3], float voxelSize)
+    {
+        return XMFLOAT3(p.x / (voxelSize * dims[0]), p.y / (voxelSize * dims[1]), p.z / (voxelSize * dims[2]));
+    }
+
+    XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+    {
+        return XMFLOAT4(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z), a.w + t * (b.w - a.w));
+    }
+
+    // ConeTraceVoxels(); sample(uvw, lod) is premultiplied. What leaves the window sees Miss.
+    template<typename Sample>
+    VoxelConeResult TraceCone(const UINT dims[3], UINT mips, const VoxelConeSetup& setup, const XMFLOAT3& start,
+        const XMFLOAT3& direction, Sample sample)
+    {
+        VoxelConeResult cone;
+        float result[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const float voxel = setup.VoxelSize;
+        float distance = voxel;
+        for (UINT i = 0; i < setup.Steps && result[3] < 0.95f; ++i)
+        {
+            const float diameter = std::max<float>(voxel, 2.0f * setup.Aperture * distance);
+            const float lod = std::min<float>(std::log2(diameter / voxel), (float)(mips - 1));
+            const XMFLOAT3 p(start.x + direction.x * distance, start.y + direction.y * distance, start.z + direction.z * distance);
+            if (!InWindow(p, dims, setup, diameter / voxel))
+            {
+                cone.Inside = false;
+                break;
+            }
+            const XMFLOAT4 s = sample(VoxelUVW(p, dims, voxel), lod);
+            cone.Samples++;
+            const float transmittance = 1.0f - result[3];
+            result[0] += transmittance * s.x;
+            result[1] += transmittance * s.y;
+            result[2] += transmittance * s.z;
+            result[3] += transmittance * s.w;
+            distance += diameter * setup.StepScale;
+        }
+        const float miss = cone.Inside ? 0.0f : (1.0f - result[3]) * setup.Miss;
+        cone.Radiance = XMFLOAT4(result[0] + miss, result[1] + miss, result[2] + miss, result[3]);
+        return cone;
+    }
+}
+
+LampAnisoVoxels::LampAnisoVoxels(const UINT dims[3], UINT mips, bool anisotropicBase)
+    : mAnisotropicBase(anisotropicBase)
+{
+    assert(mips > 1 && dims[0] > 0 && dims[1] > 0 && dims[2] > 0);
+    mLevels.resize(mips);
+    for (UINT m = 0; m < mips; ++m)
+    {
+        Level& level = mLevels[m];
+        for (int a = 0; a < 3; ++a)
+            level.Dims[a] = std::max<UINT>(dims[a] >> m, 1u);
+        if (m == 0 && !anisotropicBase)
+            continue;
+        for (auto& volume : level.Volumes)
+            volume.assign((size_t)level.Dims[0] * level.Dims[1] * level.Dims[2], 0);
+    }
+}
+
+UINT LampAnisoVoxels::Source(UINT face, UINT mip, UINT x, UINT y, UINT z)const
+{
+    const Level& below = mLevels[mip - 1];
+    const size_t index = ((size_t)(z % below.Dims[2]) * below.Dims[1] + y % below.Dims[1]) * below.Dims[0] + x % below.Dims[0];
+    return mip == 1 && !mAnisotropicBase ? mBase[index] : below.Volumes[face][index];
+}
+
+void LampAnisoVoxels::BuildSlabs(UINT mip, UINT zBegin, UINT zEnd)
+{
+    Level& level = mLevels[mip];
+    // Every face reads the same children from an isotropic base.
+    const bool shared = mip == 1 && !mAnisotropicBase;
+    XMVECTOR c[8];
+    for (UINT z = zBegin; z < zEnd; ++z)
+    {
+        for (UINT y = 0; y < level.Dims[1]; ++y)
+        {
+            for (UINT x = 0; x < level.Dims[0]; ++x)
+            {
+                const size_t index = ((size_t)z * level.Dims[1] + y) * level.Dims[0] + x;
+                for (UINT face = 0; face < Faces; ++face)
+                {
+                    if (face == 0 || !shared)
+                    {
+                        for (UINT i = 0; i < 8; ++i)
+                        {
+                            const XMFLOAT4 texel = LampVoxelizer::UnpackUnorm(
+                                Source(face, mip, 2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + (i >> 2)));
+                            c[i] = XMLoadFloat4(&texel);
+                        }
+                    }
+                    level.Volumes[face][index] = IntegrateSimd(c, face);
+                }
+            }
+        }
+    }
+}
+
+void LampAnisoVoxels::BuildSlabsReference(UINT mip, UINT zBegin, UINT zEnd)
+{
+    Level& level = mLevels[mip];
+    XMFLOAT4 c[8];
+    for (UINT z = zBegin; z < zEnd; ++z)
+    {
+        for (UINT y = 0; y < level.Dims[1]; ++y)
+        {
+            for (UINT x = 0; x < level.Dims[0]; ++x)
+            {
+                const size_t index = ((size_t)z * level.Dims[1] + y) * level.Dims[0] + x;
+                for (UINT face = 0; face < Faces; ++face)
+                {
+                    for (UINT i = 0; i < 8; ++i)
+                        c[i] = LampVoxelizer::UnpackUnorm(Source(face, mip, 2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + (i >> 2)));
+                    level.Volumes[face][index] = Integrate(c, face);
+                }
+            }
+        }
+    }
+}
+
+void LampAnisoVoxels::Build(const std::vector<UINT>& base, LampThreadPool& pool)
+{
+    const UINT* dims = mLevels[0].Dims;
+    assert(base.size() == (size_t)dims[0] * dims[1] * dims[2]);
+    mBase = base;
+    if (mAnisotropicBase)
+    {
+        for (auto& volume : mLevels[0].Volumes)
+            volume = base;
+    }
+    // Each mip reads the one below, so the mips go one after another and the slabs of one in parallel.
+    for (UINT mip = 1; mip < Mips(); ++mip)
+        pool.ParallelFor(mLevels[mip].Dims[2], 1, [&](UINT begin, UINT end) { BuildSlabs(mip, begin, end); });
+}
+
+void LampAnisoVoxels::BuildReference(const std::vector<UINT>& base)
+{
+    const UINT* dims = mLevels[0].Dims;
+    assert(base.size() == (size_t)dims[0] * dims[1] * dims[2]);
+    mBase = base;
+    if (mAnisotropicBase)
+    {
+        for (auto& volume : mLevels[0].Volumes)
+            volume = base;
+    }
+    for (UINT mip = 1; mip < Mips(); ++mip)
+        BuildSlabsReference(mip, 0, mLevels[mip].Dims[2]);
+}
+
+UINT LampAnisoVoxels::Fetch(UINT face, UINT mip, UINT x, UINT y, UINT z)const
+{
+    const Level& level = mLevels[mip];
+    const size_t index = ((size_t)(z % level.Dims[2]) * level.Dims[1] + y % level.Dims[1]) * level.Dims[0] + x % level.Dims[0];
+    return mip == 0 && !mAnisotropicBase ? mBase[index] : level.Volumes[face][index];
+}
+
+XMFLOAT4 LampAnisoVoxels::Sample(UINT face, const XMFLOAT3& uvw, UINT mip)const
+{
+    const std::vector<UINT>& volume = mip == 0 && !mAnisotropicBase ? mBase : mLevels[mip].Volumes[face];
+    return LampBrickMap::SampleDense(volume, mLevels[mip].Dims, uvw);
+}
+
+XMFLOAT4 LampAnisoVoxels::SampleFaces(const XMFLOAT3& direction, const XMFLOAT3& uvw, UINT mip)const
+{
+    if (mip == 0 && !mAnisotropicBase)
+        return Sample(0, uvw, 0);
+    const XMFLOAT4 x = Sample(direction.x >= 0.0f ? 0 : 1, uvw, mip);
+    const XMFLOAT4 y = Sample(direction.y >= 0.0f ? 2 : 3, uvw, mip);
+    const XMFLOAT4 z = Sample(direction.z >= 0.0f ? 4 : 5, uvw, mip);
+    const float w[3] = { direction.x * direction.x, direction.y * direction.y, direction.z * direction.z };
+    return XMFLOAT4(w[0] * x.x + w[1] * y.x + w[2] * z.x, w[0] * x.y + w[1] * y.y + w[2] * z.y,
+        w[0] * x.z + w[1] * y.z + w[2] * z.z, w[0] * x.w + w[1] * y.w + w[2] * z.w);
+}
+
+XMFLOAT4 LampAnisoVoxels::SampleCone(const XMFLOAT3& direction, const XMFLOAT3& uvw, float lod)const
+{
+    lod = std::min<float>(std::max<float>(lod, 0.0f), (float)(Mips() - 1));
+    const UINT mip = (UINT)lod;
+    const XMFLOAT4 fine = SampleFaces(direction, uvw, mip);
+    if (mip + 1 >= Mips())
+        return fine;
+    return Lerp(fine, SampleFaces(direction, uvw, mip + 1), lod - mip);
+}
+
+VoxelConeResult LampAnisoVoxels::ConeTrace(const VoxelConeSetup& setup, const XMFLOAT3& start, const XMFLOAT3& direction)const
+{
+    return TraceCone(mLevels[0].Dims, Mips(), setup, start, direction,
+        [&](const XMFLOAT3& uvw, float lod) { return SampleCone(direction, uvw, lod); });
+}
+
+UINT64 LampAnisoVoxels::Bytes()const
+{
+    UINT64 bytes = mBase.size() * sizeof(UINT);
+    for (auto& level : mLevels)
+    {
+        for (auto& volume : level.Volumes)
+            bytes += volume.size() * sizeof(UINT);
+    }
+    return bytes;
+}
+
+UINT64 LampAnisoVoxels::IsotropicBytes()const
+{
+    UINT64 bytes = 0;
+    for (auto& level : mLevels)
+        bytes += (UINT64)level.Dims[0] * level.Dims[1] * level.Dims[2] * sizeof(UINT);
+    return bytes;
+}
+
+std::wstring LampAnisoVoxels::Report()const
+{
+    const UINT* dims = mLevels[0].Dims;
+    return L"Anisotropic voxels: " + std::to_wstring(dims[0]) + L"x" + std::to_wstring(dims[1]) + L"x" + std::to_wstring(dims[2])
+        + L", " + std::to_wstring(Mips()) + L" mips, " + (mAnisotropicBase ? L"six faces from mip 0" : L"six faces above an isotropic mip 0")
+        + L": " + std::to_wstring(Bytes() / 1024) + L" KiB against " + std::to_wstring(IsotropicBytes() / 1024) + L" KiB isotropic\n";
+}
+
+const wchar_t* LampAnisoVoxels::FaceName(UINT face)
+{
+    static const wchar_t* names[Faces] = { L"PosX", L"NegX", L"PosY", L"NegY", L"PosZ", L"NegZ" };
+    assert(face < Faces);
+    return names[face];
+}
+
+std::wstring LampAnisoVoxels::VolumeName(const std::wstring& base, UINT face)
+{
+    return base + L"Aniso" + FaceName(face);
+}
+
+VoxelConeResult LampAnisoVoxels::ConeTraceIsotropic(const std::vector<std::vector<UINT>>& mips, const UINT dims[3],
+    const VoxelConeSetup& setup, const XMFLOAT3& start, const XMFLOAT3& direction)
+{
+    // GenerateMip3D leaves color straight above mip 0; it is premultiplied once filtered.
+    auto sampleMip = [&](const XMFLOAT3& uvw, UINT mip)
+    {
+        const UINT d[3] = { std::max<UINT>(dims[0] >> mip, 1u), std::max<UINT>(dims[1] >> mip, 1u), std::max<UINT>(dims[2] >> mip, 1u) };
+        XMFLOAT4 s = LampBrickMap::SampleDense(mips[mip], d, uvw);
+        if (mip > 0)
+            s = XMFLOAT4(s.x * s.w, s.y * s.w, s.z * s.w, s.w);
+        return s;
+    };
+    const UINT count = (UINT)mips.size();
+    return TraceCone(dims, count, setup, start, direction, [&](const XMFLOAT3& uvw, float lod)
+    {
+        lod = std::min<float>(std::max<float>(lod, 0.0f), (float)(count - 1));
+        const UINT mip = (UINT)lod;
+        const XMFLOAT4 fine = sampleMip(uvw, mip);
+        return mip + 1 >= count ? fine : Lerp(fine, sampleMip(uvw, mip + 1), lod - mip);
+    });
+}
+
+VoxelConeResult LampAnisoVoxels::ConeTraceRays(const std::vector<UINT>& base, const UINT dims[3],
+    const VoxelConeSetup& setup, const XMFLOAT3& start, const XMFLOAT3& direction, UINT rays)
+{
+    // Two axes across the cone.
+    const XMFLOAT3 other = std::fabs(direction.x) < 0.9f ? XMFLOAT3(1.0f, 0.0f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+    XMFLOAT3 u(direction.y * other.z - direction.z * other.y, direction.z * other.x - direction.x * other.z,
+        direction.x * other.y - direction.y * other.x);
+    const float length = std::sqrt(u.x * u.x + u.y * u.y + u.z * u.z);
+    u = XMFLOAT3(u.x / length, u.y / length, u.z / length);
+    const XMFLOAT3 v(direction.y * u.z - direction.z * u.y, direction.z * u.x - direction.x * u.z, direction.x * u.y - direction.y * u.x);
+
+    VoxelConeResult bundle;
+    float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float step = setup.VoxelSize * 0.25f;
+    for (UINT r = 0; r < rays; ++r)
+    {
+        // Spread evenly over the cone's cross section, a sunflower pattern.
+        const float radius = setup.Aperture * std::sqrt((r + 0.5f) / rays);
+        const float angle = r * 2.39996323f;
+        XMFLOAT3 d(direction.x + (u.x * std::cos(angle) + v.x * std::sin(angle)) * radius,
+            direction.y + (u.y * std::cos(angle) + v.y * std::sin(angle)) * radius,
+            direction.z + (u.z * std::cos(angle) + v.z * std::sin(angle)) * radius);
+        const float dl = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+        d = XMFLOAT3(d.x / dl, d.y / dl, d.z / dl);
+
+        float ray[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        bool inside = true;
+        for (float t = setup.VoxelSize; ray[3] < 0.999f; t += step)
+        {
+            const XMFLOAT3 p(start.x + d.x * t, start.y + d.y * t, start.z + d.z * t);
+            if (!InWindow(p, dims, setup, 1.0f))
+            {
+                inside = false;
+                break;
+            }
+            const XMFLOAT4 s = LampBrickMap::SampleDense(base, dims, VoxelUVW(p, dims, setup.VoxelSize));
+            bundle.Samples++;
+            if (s.w <= 0.0f)
+                continue;
+            // A quarter of a voxel's opacity, and the color with it.
+            const float alpha = 1.0f - std::pow(1.0f - std::min<float>(s.w, 1.0f), 0.25f);
+            const float scale = (1.0f - ray[3]) * (s.w >= 1.0f ? 1.0f : alpha / s.w);
+            ray[0] += scale * s.x;
+            ray[1] += scale * s.y;
+            ray[2] += scale * s.z;
+            ray[3] += (1.0f - ray[3]) * (s.w >= 1.0f ? 1.0f : alpha);
+        }
+        const float miss = inside ? 0.0f : (1.0f - ray[3]) * setup.Miss;
+        sum[0] += ray[0] + miss;
+        sum[1] += ray[1] + miss;
+        sum[2] += ray[2] + miss;
+        sum[3] += ray[3];
+    }
+    bundle.Radiance = XMFLOAT4(sum[0] / rays, sum[1] / rays, sum[2] / rays, sum[3] / rays);
+    return bundle;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "BrickMap.h"
+#include <array>
+
+// ConeTraceVoxels() of VoxelClipmap.hlsli over one clipmap level whose window starts at
+// WindowMin. The cone is 2 * Aperture * distance wide, never under a voxel, and steps
+// StepScale of its width at a time.
+struct VoxelConeSetup
+{
+    DirectX::XMFLOAT3 WindowMin = { 0.0f, 0.0f, 0.0f };
+    float VoxelSize = 25.0f / 256.0f;
+    float Aperture = 0.1f;
+    UINT Steps = 12;
+    float StepScale = 1.0f;
+    // Added for what is left when the cone leaves the window, as VoxelDI's miss color.
+    float Miss = 0.6f;
+};
+
+// Premultiplied color and opacity the cone gathered. Inside is false when it left the
+// window before it turned opaque.
+struct VoxelConeResult
+{
+    DirectX::XMFLOAT4 Radiance = { 0.0f, 0.0f, 0.0f, 0.0f };
+    bool Inside = true;
+    UINT Samples = 0;
+};
+
+// Mips of a voxel color volume pre-integrated along each axis, for cone tracing. Every
+// mip above the base keeps six volumes, one per direction a cone travels (+X, -X, +Y,
+// -Y, +Z, -Z). A texel composites its 2^3 children front to back in that direction,
+// column by column, and averages the four columns. A wall one voxel thick then stays
+// opaque to the cones that cross it, where GenerateMip3D's average thins it at every mip
+// and light behind it leaks through. Texels are premultiplied RGBA8. The base is the voxel
+// volume itself, taken as premultiplied as the voxelize shaders write it: opaque or empty.
+//
+// By default mip 0 stays isotropic and only the mips above it take six volumes, as
+// GenerateAnisoMip3D.hlsl writes them. With anisotropicBase mip 0 is stored six times as
+// well, for a voxelizer that writes a color per face, at six times the base's memory.
+//
+// Build() writes each mip in parallel slabs of z slices and composites the four channels
+// of a texel at once; BuildReference() does the same one channel at a time.
+class LampAnisoVoxels
+{
+public:
+    static constexpr UINT Faces = 6;
+
+    // Mip m is dims >> m texels.
+    LampAnisoVoxels(const UINT dims[3], UINT mips, bool anisotropicBase = false);
+    LampAnisoVoxels(const LampAnisoVoxels& rhs) = delete;
+    LampAnisoVoxels& operator=(const LampAnisoVoxels& rhs) = delete;
+    ~LampAnisoVoxels() = default;
+
+    // From the base volume, x fastest.
+    void Build(const std::vector<UINT>& base, LampThreadPool& pool = LampThreadPool::Default());
+    void BuildReference(const std::vector<UINT>& base);
+
+    UINT Mips()const { return (UINT)mLevels.size(); }
+    const UINT* Dims(UINT mip)const { return mLevels[mip].Dims; }
+    bool AnisotropicBase()const { return mAnisotropicBase; }
+    // Wraps like the volumes. Mip 0 is the base unless it is anisotropic.
+    UINT Fetch(UINT face, UINT mip, UINT x, UINT y, UINT z)const;
+    // SampleLevel(gsamLinearWrap, uvw, mip) of one face.
+    DirectX::XMFLOAT4 Sample(UINT face, const DirectX::XMFLOAT3& uvw, UINT mip)const;
+    // SampleVoxelAniso(): the three faces the direction looks into, weighted by its squared
+    // components, with the mips either side of a fractional lod blended.
+    DirectX::XMFLOAT4 SampleCone(const DirectX::XMFLOAT3& direction, const DirectX::XMFLOAT3& uvw, float lod)const;
+    VoxelConeResult ConeTrace(const VoxelConeSetup& setup, const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& direction)const;
+
+    // Bytes stored, the base included, and of the isotropic mips they stand in for.
+    UINT64 Bytes()const;
+    UINT64 IsotropicBytes()const;
+    std::wstring Report()const;
+
+    // Volume of a face: +X is where cones travelling +X sample.
+    static const wchar_t* FaceName(UINT face);
+    static std::wstring VolumeName(const std::wstring& base, UINT face);
+
+    // The same cone through GenerateMip3D's isotropic mips (LampBrickMap::DenseMips()).
+    static VoxelConeResult ConeTraceIsotropic(const std::vector<std::vector<UINT>>& mips, const UINT dims[3],
+        const VoxelConeSetup& setup, const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& direction);
+    // What a cone stands in for: rays spread over it, each marched through the base at
+    // quarter-voxel steps until it is opaque or leaves the window, averaged.
+    static VoxelConeResult ConeTraceRays(const std::vector<UINT>& base, const UINT dims[3],
+        const VoxelConeSetup& setup, const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& direction, UINT rays);
+
+private:
+    struct Level
+    {
+        UINT Dims[3];
+        // Empty at mip 0 unless the base is anisotropic.
+        std::array<std::vector<UINT>, LampAnisoVoxels::Faces> Volumes;
+    };
+
+    // Premultiplied source texel of a face one mip below mip.
+    UINT Source(UINT face, UINT mip, UINT x, UINT y, UINT z)const;
+    void BuildSlabs(UINT mip, UINT zBegin, UINT zEnd);
+    void BuildSlabsReference(UINT mip, UINT zBegin, UINT zEnd);
+    DirectX::XMFLOAT4 SampleFaces(const DirectX::XMFLOAT3& direction, const DirectX::XMFLOAT3& uvw, UINT mip)const;
+
+    std::vector<UINT> mBase;
+    std::vector<Level> mLevels;
+    bool mAnisotropicBase;
+};
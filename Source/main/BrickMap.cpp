@@ -0,0 +1,510 @@
+#include "BrickMap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+constexpr UINT LampBrickMap::BrickSize;
+constexpr UINT LampBrickMap::BrickTexels;
+constexpr UINT LampBrickMap::PaddedBrickTexels;
+constexpr UINT LampBrickMap::EmptyBrick;
+
+namespace
+{
+    UINT Channel(UINT texel, int c)
+    {
+        return (texel >> (8 * c)) & 0xff;
+    }
+
+    // GenerateMip3D: color weighted by alpha, alpha summed and halved into mip 1 but
+    // averaged into the mips above. c in x, then y, then z order.
+    UINT Reduce(const UINT c[8], UINT sourceMip)
+    {
+        float alpha = 0.0f;
+        float rgb[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 8; ++i)
+        {
+            const float a = Channel(c[i], 3) / 255.0f;
+            alpha += a;
+            for (int k = 0; k < 3; ++k)
+                rgb[k] += a * (Channel(c[i], k) / 255.0f);
+        }
+        if (alpha > 0.0f)
+        {
+            for (int k = 0; k < 3; ++k)
+                rgb[k] /= alpha;
+        }
+        const float scale = sourceMip < 1 ? 0.5f : 0.125f;
+        return LampVoxelizer::PackUnorm(rgb[0], rgb[1], rgb[2], std::min<float>(alpha * scale, 1.0f));
+    }
+
+    void MipDims(const UINT dims[3], UINT mip, UINT out[3])
+    {
+        for (int a = 0; a < 3; ++a)
+            out[a] = std::max<UINT>(dims[a] >> mip, 1u);
+    }
+
+    // Filtered as the linear wrap sampler filters one mip; fetch(x, y, z) takes wrapped texels.
+    template<typename Fetch>
+    XMFLOAT4 Trilinear(const UINT dims[3], const XMFLOAT3& uvw, Fetch fetch)
+    {
+        const float p[3] = { uvw.x * dims[0] - 0.5f, uvw.y * dims[1] - 0.5f, uvw.z * dims[2] - 0.5f };
+        UINT i0[3];
+        UINT i1[3];
+        float t[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            const float f = std::floor(p[a]);
+            t[a] = p[a] - f;
+            const INT64 size = dims[a];
+            i0[a] = (UINT)(((INT64)f % size + size) % size);
+            i1[a] = (i0[a] + 1) % dims[a];
+        }
+        float result[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const int dx = corner & 1;
+            const int dy = (corner >> 1) & 1;
+            const int dz = (corner >> 2) & 1;
+            const float w = (dx ? t[0] : 1.0f - t[0]) * (dy ? t[1] : 1.0f - t[1]) * (dz ? t[2] : 1.0f - t[2]);
+            const UINT texel = fetch(dx ? i1[0] : i0[0], dy ? i1[1] : i0[1], dz ? i1[2] : i0[2]);
+            for (int c = 0; c < 4; ++c)
+                result[c] += w * (float)Channel(texel, c);
+        }
+        return XMFLOAT4(result[0] / 255.0f, result[1] / 255.0f, result[2] / 255.0f, result[3] / 255.0f);
+    }
+
+    // TraceVoxelColor(); sample(uvw, lod) samples mip lod of level 0.
+    template<typename Sample>
+    VoxelTraceResult TraceVolume(const UINT dims[3], const VoxelTraceSetup& setup, const XMFLOAT3& start,
+        const XMFLOAT3& direction, float jitter, Sample sample)
+    {
+        const float d[3] = { direction.x, direction.y, direction.z };
+        const float axis = std::max<float>(std::fabs(d[2]), std::max<float>(std::fabs(d[0]), std::fabs(d[1])));
+        const float window[3] = { setup.WindowMin.x, setup.WindowMin.y, setup.WindowMin.z };
+        float offset[3];
+        float current[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            offset[a] = d[a] / axis * setup.VoxelSize;
+            current[a] = (&start.x)[a] + offset[a] * jitter;
+        }
+
+        VoxelTraceResult trace;
+        float result[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        int lod = 0;
+        for (UINT i = 0; i < setup.Steps; ++i)
+        {
+            const float step = (float)(lod > 7 ? 255 : 1 << lod);
+            for (int a = 0; a < 3; ++a)
+                current[a] += offset[a] * step;
+            trace.Samples++;
+
+            // SampleVoxelColor() on level 0: inside the window with 2^lod voxels to spare.
+            const float margin = (float)(1 << lod);
+            bool inside = true;
+            for (int a = 0; a < 3; ++a)
+            {
+                const float voxel = (current[a] - window[a]) / setup.VoxelSize;
+                inside = inside && voxel >= margin && voxel <= (float)dims[a] - margin;
+            }
+            if (!inside)
+            {
+                for (int c = 0; c < 4; ++c)
+                    result[c] = setup.Miss;
+                break;
+            }
+            const XMFLOAT3 uvw(current[0] / (setup.VoxelSize * dims[0]), current[1] / (setup.VoxelSize * dims[1]),
+                current[2] / (setup.VoxelSize * dims[2]));
+            const XMFLOAT4 temp = sample(uvw, (UINT)lod);
+            if (temp.w > 0.0f)
+            {
+                if (lod < 1)
+                {
+                    result[0] += temp.x / temp.w;
+                    result[1] += temp.y / temp.w;
+                    result[2] += temp.z / temp.w;
+                    result[3] += 1.0f;
+                    break;
+                }
+                for (int a = 0; a < 3; ++a)
+                    current[a] -= offset[a] * step;
+                lod--;
+                continue;
+            }
+            lod = std::min<int>(lod + 1, 3);
+            if (result[3] > 0.95f)
+                break;
+        }
+        trace.Color = XMFLOAT3(result[0], result[1], result[2]);
+        trace.Hit = result[3] > 0.9f;
+        return trace;
+    }
+}
+
+LampBrickMap::LampBrickMap(const UINT dims[3], UINT mips)
+{
+    assert(mips > 0 && dims[0] > 0 && dims[1] > 0 && dims[2] > 0);
+    mMips.resize(mips);
+    for (UINT m = 0; m < mips; ++m)
+    {
+        Mip& mip = mMips[m];
+        ::MipDims(dims, m, mip.Dims);
+        for (int a = 0; a < 3; ++a)
+            mip.Bricks[a] = (mip.Dims[a] + BrickSize - 1) / BrickSize;
+        mip.Table.assign((size_t)mip.Bricks[0] * mip.Bricks[1] * mip.Bricks[2], EmptyBrick);
+    }
+    mDirtyFlags.assign(mMips[0].Table.size(), false);
+}
+
+UINT LampBrickMap::TableIndex(UINT mip, UINT bx, UINT by, UINT bz)const
+{
+    const Mip& m = mMips[mip];
+    assert(bx < m.Bricks[0] && by < m.Bricks[1] && bz < m.Bricks[2]);
+    return (bz * m.Bricks[1] + by) * m.Bricks[0] + bx;
+}
+
+UINT* LampBrickMap::Allocate(UINT mip, UINT index)
+{
+    Mip& m = mMips[mip];
+    UINT& slot = m.Table[index];
+    if (slot == EmptyBrick)
+    {
+        if (!mFreeSlots.empty())
+        {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+            std::fill_n(mPool.begin() + (size_t)slot * BrickTexels, BrickTexels, 0u);
+        }
+        else
+        {
+            slot = (UINT)(mPool.size() / BrickTexels);
+            mPool.resize(mPool.size() + BrickTexels, 0u);
+        }
+        m.Count++;
+    }
+    return &mPool[(size_t)slot * BrickTexels];
+}
+
+void LampBrickMap::Free(UINT mip, UINT index)
+{
+    Mip& m = mMips[mip];
+    UINT& slot = m.Table[index];
+    if (slot == EmptyBrick)
+        return;
+    mFreeSlots.push_back(slot);
+    slot = EmptyBrick;
+    m.Count--;
+}
+
+void LampBrickMap::MarkDirty(UINT index)
+{
+    if (mDirtyFlags[index])
+        return;
+    mDirtyFlags[index] = true;
+    mDirty.push_back(index);
+}
+
+void LampBrickMap::Clear()
+{
+    for (auto& mip : mMips)
+    {
+        std::fill(mip.Table.begin(), mip.Table.end(), EmptyBrick);
+        mip.Count = 0;
+    }
+    mPool.clear();
+    mFreeSlots.clear();
+    mDirty.clear();
+    std::fill(mDirtyFlags.begin(), mDirtyFlags.end(), false);
+}
+
+void LampBrickMap::Build(const std::vector<UINT>& dense)
+{
+    const Mip& top = mMips[0];
+    assert(dense.size() == (size_t)top.Dims[0] * top.Dims[1] * top.Dims[2]);
+    Clear();
+    UINT brick[BrickTexels];
+    for (UINT bz = 0; bz < top.Bricks[2]; ++bz)
+    {
+        for (UINT by = 0; by < top.Bricks[1]; ++by)
+        {
+            for (UINT bx = 0; bx < top.Bricks[0]; ++bx)
+            {
+                bool occupied = false;
+                for (UINT z = 0; z < BrickSize; ++z)
+                {
+                    for (UINT y = 0; y < BrickSize; ++y)
+                    {
+                        for (UINT x = 0; x < BrickSize; ++x)
+                        {
+                            const UINT tx = bx * BrickSize + x;
+                            const UINT ty = by * BrickSize + y;
+                            const UINT tz = bz * BrickSize + z;
+                            UINT& texel = brick[(z * BrickSize + y) * BrickSize + x];
+                            texel = tx < top.Dims[0] && ty < top.Dims[1] && tz < top.Dims[2]
+                                ? dense[((size_t)tz * top.Dims[1] + ty) * top.Dims[0] + tx] : 0;
+                            occupied = occupied || texel != 0;
+                        }
+                    }
+                }
+                if (!occupied)
+                    continue;
+                const UINT index = TableIndex(0, bx, by, bz);
+                memcpy(Allocate(0, index), brick, sizeof(brick));
+                MarkDirty(index);
+            }
+        }
+    }
+    UpdateMips();
+}
+
+void LampBrickMap::Build(const std::vector<BakedVoxel>& voxels, const int windowMin[3], const XMFLOAT3& lightDirection)
+{
+    Clear();
+    for (auto& voxel : voxels)
+    {
+        UINT texel[3];
+        if (LampVoxelizer::WindowTexel(voxel.Key, windowMin, mMips[0].Dims, texel))
+            SetTexel(texel[0], texel[1], texel[2], LampVoxelizer::LitColor(voxel, lightDirection));
+    }
+    UpdateMips();
+}
+
+void LampBrickMap::SetTexel(UINT x, UINT y, UINT z, UINT texel)
+{
+    assert(x < mMips[0].Dims[0] && y < mMips[0].Dims[1] && z < mMips[0].Dims[2]);
+    const UINT index = TableIndex(0, x / BrickSize, y / BrickSize, z / BrickSize);
+    if (mMips[0].Table[index] == EmptyBrick && texel == 0)
+        return;
+    Allocate(0, index)[((z % BrickSize) * BrickSize + y % BrickSize) * BrickSize + x % BrickSize] = texel;
+    MarkDirty(index);
+}
+
+void LampBrickMap::SetBrick(const UINT brick[3], const UINT texels[BrickTexels])
+{
+    const Mip& top = mMips[0];
+    const UINT index = TableIndex(0, brick[0], brick[1], brick[2]);
+    UINT* out = nullptr;
+    for (UINT z = 0; z < BrickSize; ++z)
+    {
+        for (UINT y = 0; y < BrickSize; ++y)
+        {
+            for (UINT x = 0; x < BrickSize; ++x)
+            {
+                const UINT i = (z * BrickSize + y) * BrickSize + x;
+                // Texels past the volume's edge are not stored.
+                const bool inside = brick[0] * BrickSize + x < top.Dims[0] && brick[1] * BrickSize + y < top.Dims[1]
+                    && brick[2] * BrickSize + z < top.Dims[2];
+                if (out == nullptr && (!inside || texels[i] == 0))
+                    continue;
+                if (out == nullptr)
+                {
+                    out = Allocate(0, index);
+                    std::fill_n(out, BrickTexels, 0u);
+                }
+                out[i] = inside ? texels[i] : 0;
+            }
+        }
+    }
+    if (out == nullptr)
+        Free(0, index);
+    MarkDirty(index);
+}
+
+void LampBrickMap::RemoveBrick(const UINT brick[3])
+{
+    const UINT index = TableIndex(0, brick[0], brick[1], brick[2]);
+    Free(0, index);
+    MarkDirty(index);
+}
+
+void LampBrickMap::Downsample(UINT mip, UINT index)
+{
+    const Mip& m = mMips[mip];
+    const UINT bx = index % m.Bricks[0];
+    const UINT by = index / m.Bricks[0] % m.Bricks[1];
+    const UINT bz = index / (m.Bricks[0] * m.Bricks[1]);
+    UINT brick[BrickTexels];
+    bool occupied = false;
+    for (UINT z = 0; z < BrickSize; ++z)
+    {
+        for (UINT y = 0; y < BrickSize; ++y)
+        {
+            for (UINT x = 0; x < BrickSize; ++x)
+            {
+                const UINT p[3] = { bx * BrickSize + x, by * BrickSize + y, bz * BrickSize + z };
+                UINT& texel = brick[(z * BrickSize + y) * BrickSize + x];
+                texel = 0;
+                if (p[0] >= m.Dims[0] || p[1] >= m.Dims[1] || p[2] >= m.Dims[2])
+                    continue;
+                UINT c[8];
+                for (int i = 0; i < 8; ++i)
+                    c[i] = Fetch(mip - 1, 2 * p[0] + (i & 1), 2 * p[1] + ((i >> 1) & 1), 2 * p[2] + ((i >> 2) & 1));
+                texel = Reduce(c, mip - 1);
+                occupied = occupied || texel != 0;
+            }
+        }
+    }
+    if (occupied)
+        memcpy(Allocate(mip, index), brick, sizeof(brick));
+    else
+        Free(mip, index);
+}
+
+void LampBrickMap::UpdateMips()
+{
+    // Edits may have left bricks of mip 0 empty.
+    for (UINT index : mDirty)
+    {
+        const UINT slot = mMips[0].Table[index];
+        if (slot == EmptyBrick)
+            continue;
+        const UINT* brick = &mPool[(size_t)slot * BrickTexels];
+        if (std::all_of(brick, brick + BrickTexels, [](UINT texel) { return texel == 0; }))
+            Free(0, index);
+    }
+
+    std::vector<UINT> dirty;
+    dirty.swap(mDirty);
+    for (UINT index : dirty)
+        mDirtyFlags[index] = false;
+    for (UINT mip = 1; mip < Mips() && !dirty.empty(); ++mip)
+    {
+        const Mip& below = mMips[mip - 1];
+        std::vector<UINT> parents;
+        parents.reserve(dirty.size());
+        for (UINT index : dirty)
+        {
+            const UINT bx = index % below.Bricks[0];
+            const UINT by = index / below.Bricks[0] % below.Bricks[1];
+            const UINT bz = index / (below.Bricks[0] * below.Bricks[1]);
+            parents.push_back(TableIndex(mip, bx / 2, by / 2, bz / 2));
+        }
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+        for (UINT index : parents)
+            Downsample(mip, index);
+        dirty.swap(parents);
+    }
+}
+
+UINT LampBrickMap::Fetch(UINT mip, UINT x, UINT y, UINT z)const
+{
+    const Mip& m = mMips[mip];
+    x %= m.Dims[0];
+    y %= m.Dims[1];
+    z %= m.Dims[2];
+    const UINT slot = m.Table[TableIndex(mip, x / BrickSize, y / BrickSize, z / BrickSize)];
+    if (slot == EmptyBrick)
+        return 0;
+    return mPool[(size_t)slot * BrickTexels + ((z % BrickSize) * BrickSize + y % BrickSize) * BrickSize + x % BrickSize];
+}
+
+XMFLOAT4 LampBrickMap::Sample(const XMFLOAT3& uvw, UINT mip)const
+{
+    return Trilinear(mMips[mip].Dims, uvw, [&](UINT x, UINT y, UINT z) { return Fetch(mip, x, y, z); });
+}
+
+VoxelTraceResult LampBrickMap::Trace(const VoxelTraceSetup& setup, const XMFLOAT3& start, const XMFLOAT3& direction, float jitter)const
+{
+    // The sampler clamps to the last mip.
+    return TraceVolume(mMips[0].Dims, setup, start, direction, jitter,
+        [&](const XMFLOAT3& uvw, UINT lod) { return Sample(uvw, std::min<UINT>(lod, Mips() - 1)); });
+}
+
+UINT LampBrickMap::BrickCount()const
+{
+    UINT count = 0;
+    for (auto& mip : mMips)
+        count += mip.Count;
+    return count;
+}
+
+UINT64 LampBrickMap::BrickBytes()const
+{
+    return (UINT64)BrickCount() * BrickTexels * sizeof(UINT);
+}
+
+UINT64 LampBrickMap::TableBytes()const
+{
+    UINT64 bytes = 0;
+    for (auto& mip : mMips)
+        bytes += mip.Table.size() * sizeof(UINT);
+    return bytes;
+}
+
+UINT64 LampBrickMap::DenseBytes()const
+{
+    UINT64 bytes = 0;
+    for (auto& mip : mMips)
+        bytes += (UINT64)mip.Dims[0] * mip.Dims[1] * mip.Dims[2] * sizeof(UINT);
+    return bytes;
+}
+
+std::wstring LampBrickMap::Report()const
+{
+    const UINT* dims = mMips[0].Dims;
+    std::wstring counts;
+    for (UINT m = 0; m < Mips(); ++m)
+        counts += (m > 0 ? L"/" : L"") + std::to_wstring(mMips[m].Count);
+    const UINT64 sparse = BrickBytes() + TableBytes();
+    std::wstring report = L"Brick map: " + std::to_wstring(dims[0]) + L"x" + std::to_wstring(dims[1]) + L"x" + std::to_wstring(dims[2])
+        + L", " + std::to_wstring(Mips()) + L" mips, " + std::to_wstring(BrickCount()) + L" bricks (" + counts + L" by mip)\n";
+    report += L"  " + std::to_wstring(BrickBytes() / 1024) + L" KiB of bricks + " + std::to_wstring(TableBytes() / 1024)
+        + L" KiB of tables against " + std::to_wstring(DenseBytes() / 1024) + L" KiB dense ("
+        + std::to_wstring(100.0 * sparse / DenseBytes()) + L"%), "
+        + std::to_wstring((UINT64)BrickCount() * PaddedBrickTexels * sizeof(UINT) / 1024) + L" KiB of bricks with borders, "
+        + std::to_wstring(PoolBytes() / 1024) + L" KiB pool\n";
+    return report;
+}
+
+std::vector<std::vector<UINT>> LampBrickMap::DenseMips(const std::vector<UINT>& dense, const UINT dims[3], UINT mips)
+{
+    std::vector<std::vector<UINT>> result(mips);
+    result[0] = dense;
+    for (UINT m = 1; m < mips; ++m)
+    {
+        UINT below[3];
+        UINT d[3];
+        ::MipDims(dims, m - 1, below);
+        ::MipDims(dims, m, d);
+        result[m].assign((size_t)d[0] * d[1] * d[2], 0);
+        const std::vector<UINT>& source = result[m - 1];
+        auto at = [&](UINT x, UINT y, UINT z)
+        {
+            return source[((size_t)(z % below[2]) * below[1] + y % below[1]) * below[0] + x % below[0]];
+        };
+        for (UINT z = 0; z < d[2]; ++z)
+        {
+            for (UINT y = 0; y < d[1]; ++y)
+            {
+                for (UINT x = 0; x < d[0]; ++x)
+                {
+                    UINT c[8];
+                    for (int i = 0; i < 8; ++i)
+                        c[i] = at(2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + ((i >> 2) & 1));
+                    result[m][((size_t)z * d[1] + y) * d[0] + x] = Reduce(c, m - 1);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+XMFLOAT4 LampBrickMap::SampleDense(const std::vector<UINT>& mip, const UINT mipDims[3], const XMFLOAT3& uvw)
+{
+    return Trilinear(mipDims, uvw, [&](UINT x, UINT y, UINT z) { return mip[((size_t)z * mipDims[1] + y) * mipDims[0] + x]; });
+}
+
+VoxelTraceResult LampBrickMap::TraceDense(const std::vector<std::vector<UINT>>& mips, const UINT dims[3], const VoxelTraceSetup& setup,
+    const XMFLOAT3& start, const XMFLOAT3& direction, float jitter)
+{
+    return TraceVolume(dims, setup, start, direction, jitter, [&](const XMFLOAT3& uvw, UINT lod)
+    {
+        const UINT mip = std::min<UINT>(lod, (UINT)mips.size() - 1);
+        UINT d[3];
+        ::MipDims(dims, mip, d);
+        return SampleDense(mips[mip], d, uvw);
+    });
+}
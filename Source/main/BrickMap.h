@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Voxelizer.h"
+
+// TraceVoxelColor() of VoxelDI.hlsl and Reflection.hlsl over one clipmap level whose
+// window starts at WindowMin (gVoxelClip[0].xyz), with voxels and steps VoxelSize wide.
+struct VoxelTraceSetup
+{
+    DirectX::XMFLOAT3 WindowMin = { 0.0f, 0.0f, 0.0f };
+    float VoxelSize = 25.0f / 256.0f;
+    // 24 and 0.6 in VoxelDI, 32 and 0.15 in Reflection.
+    UINT Steps = 24;
+    float Miss = 0.6f;
+};
+
+// The trace's color before the probe SH term is added.
+struct VoxelTraceResult
+{
+    DirectX::XMFLOAT3 Color = { 0.0f, 0.0f, 0.0f };
+    bool Hit = false;
+    UINT Samples = 0;
+};
+
+// A voxel volume and its mips stored sparsely: each mip is a table of 8^3 bricks that
+// points into a shared pool, and a brick with nothing in it takes no pool space. Texels
+// are RGBA8 in the dense volumes' wrapped layout (voxel mod dims), and the mips are built
+// as GenerateMip3D builds the dense ones, so Fetch() and Sample() return what the dense
+// volume would. A GPU pool would store each brick with a one texel border for hardware
+// filtering; Report() counts that too.
+//
+// Edits of mip 0 mark their bricks; UpdateMips() downsamples only the bricks above the
+// marked ones, frees those left empty and reuses their pool slots.
+class LampBrickMap
+{
+public:
+    static constexpr UINT BrickSize = 8;
+    static constexpr UINT BrickTexels = BrickSize * BrickSize * BrickSize;
+    static constexpr UINT PaddedBrickTexels = (BrickSize + 2) * (BrickSize + 2) * (BrickSize + 2);
+    static constexpr UINT EmptyBrick = 0xffffffff;
+
+    // Mip m is dims >> m texels.
+    LampBrickMap(const UINT dims[3], UINT mips);
+    LampBrickMap(const LampBrickMap& rhs) = delete;
+    LampBrickMap& operator=(const LampBrickMap& rhs) = delete;
+    ~LampBrickMap() = default;
+
+    // Mip 0 from a dense volume, x fastest, and every mip above it.
+    void Build(const std::vector<UINT>& dense);
+    // Mip 0 as LampVoxelizer::WriteVolumes() writes the color volume, and the mips above.
+    void Build(const std::vector<BakedVoxel>& voxels, const int windowMin[3], const DirectX::XMFLOAT3& lightDirection);
+    void Clear();
+
+    void SetTexel(UINT x, UINT y, UINT z, UINT texel);
+    // Brick b holds texels [b, b + 1) * BrickSize of mip 0; texels x fastest.
+    void SetBrick(const UINT brick[3], const UINT texels[BrickTexels]);
+    void RemoveBrick(const UINT brick[3]);
+    void UpdateMips();
+
+    UINT Mips()const { return (UINT)mMips.size(); }
+    const UINT* Dims(UINT mip)const { return mMips[mip].Dims; }
+    // Bricks per axis, the last ones partly past Dims().
+    const UINT* Bricks(UINT mip)const { return mMips[mip].Bricks; }
+    // Zero where no brick is stored; wraps like the volumes.
+    UINT Fetch(UINT mip, UINT x, UINT y, UINT z)const;
+    // SampleLevel(gsamLinearWrap, uvw, mip).
+    DirectX::XMFLOAT4 Sample(const DirectX::XMFLOAT3& uvw, UINT mip)const;
+    // jitter is the shader's Random(start) + 1.
+    VoxelTraceResult Trace(const VoxelTraceSetup& setup, const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& direction, float jitter)const;
+
+    UINT BrickCount()const;
+    UINT BrickCount(UINT mip)const { return mMips[mip].Count; }
+    // Bytes of the stored bricks, of the pool with its free slots, and of the tables.
+    UINT64 BrickBytes()const;
+    UINT64 PoolBytes()const { return mPool.size() * sizeof(UINT); }
+    UINT64 TableBytes()const;
+    // Bytes of the same volume and mips stored densely.
+    UINT64 DenseBytes()const;
+    std::wstring Report()const;
+
+    // The dense layout the map stands in for: mips of a dense volume, sampled and traced the same way.
+    static std::vector<std::vector<UINT>> DenseMips(const std::vector<UINT>& dense, const UINT dims[3], UINT mips);
+    static DirectX::XMFLOAT4 SampleDense(const std::vector<UINT>& mip, const UINT mipDims[3], const DirectX::XMFLOAT3& uvw);
+    static VoxelTraceResult TraceDense(const std::vector<std::vector<UINT>>& mips, const UINT dims[3], const VoxelTraceSetup& setup,
+        const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& direction, float jitter);
+
+private:
+    struct Mip
+    {
+        UINT Dims[3];
+        UINT Bricks[3];
+        // Pool slot of each brick, or EmptyBrick.
+        std::vector<UINT> Table;
+        UINT Count = 0;
+    };
+
+    UINT TableIndex(UINT mip, UINT bx, UINT by, UINT bz)const;
+    UINT* Allocate(UINT mip, UINT index);
+    void Free(UINT mip, UINT index);
+    void MarkDirty(UINT index);
+    // Brick index of mip from the eight bricks below it.
+    void Downsample(UINT mip, UINT index);
+
+    std::vector<Mip> mMips;
+    std::vector<UINT> mPool;
+    std::vector<UINT> mFreeSlots;
+    // Bricks of mip 0 edited since the last UpdateMips().
+    std::vector<UINT> mDirty;
+    std::vector<bool> mDirtyFlags;
+};
@@ -0,0 +1,89 @@
+#include "ConstantBlocks.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+LampConstantBlocks::LampConstantBlocks(const std::wstring& name, std::uint32_t size, const std::vector<ConstantBlock>& blocks)
+    : mName(name), mSize(size), mBlocks(blocks)
+{
+    std::uint32_t end = 0;
+    for (auto& b : mBlocks)
+    {
+        assert(b.Offset == end && b.Size > 0);
+        end = b.Offset + b.Size;
+    }
+    assert(end == mSize);
+
+    mFrame.Writes.resize(mBlocks.size(), 0);
+    mLastFrame.Writes.resize(mBlocks.size(), 0);
+}
+
+std::uint32_t LampConstantBlocks::Write(std::uint32_t copy, const void* data, std::uint8_t* dst)
+{
+    if (copy >= mHeld.size())
+        mHeld.resize(copy + 1);
+    std::vector<std::uint8_t>& held = mHeld[copy];
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+    const bool full = held.empty();
+    if (full)
+        held.resize(mSize);
+
+    std::uint32_t written = 0;
+    std::uint32_t runBegin = 0;
+    std::uint32_t runEnd = 0;
+    auto flush = [&]()
+    {
+        if (runEnd > runBegin)
+        {
+            std::memcpy(dst + runBegin, src + runBegin, runEnd - runBegin);
+            std::memcpy(held.data() + runBegin, src + runBegin, runEnd - runBegin);
+            written += runEnd - runBegin;
+        }
+    };
+
+    for (std::size_t i = 0; i < mBlocks.size(); ++i)
+    {
+        const ConstantBlock& b = mBlocks[i];
+        if (!full && std::memcmp(held.data() + b.Offset, src + b.Offset, b.Size) == 0)
+            continue;
+
+        if (b.Offset != runEnd)
+        {
+            flush();
+            runBegin = b.Offset;
+        }
+        runEnd = b.Offset + b.Size;
+        mFrame.Writes[i]++;
+    }
+    flush();
+
+    mFrame.Bytes += written;
+    mFrame.FullBytes += mSize;
+    return written;
+}
+
+void LampConstantBlocks::Invalidate(std::uint32_t copy)
+{
+    if (copy < mHeld.size())
+        mHeld[copy].clear();
+}
+
+void LampConstantBlocks::BeginFrame()
+{
+    mLastFrame = mFrame;
+    mFrame.Bytes = 0;
+    mFrame.FullBytes = 0;
+    std::fill(mFrame.Writes.begin(), mFrame.Writes.end(), 0u);
+}
+
+std::wstring LampConstantBlocks::Report()const
+{
+    std::wstring report = mName + L" constants: " + std::to_wstring(mLastFrame.Bytes) + L"/"
+        + std::to_wstring(mLastFrame.FullBytes) + L" bytes written last frame, writes per block:";
+    for (std::size_t i = 0; i < mBlocks.size(); ++i)
+    {
+        report += L" " + mBlocks[i].Name + L"(" + std::to_wstring(mBlocks[i].Size) + L" bytes) "
+            + std::to_wstring(mLastFrame.Writes[i]);
+    }
+    return report + L"\n";
+}
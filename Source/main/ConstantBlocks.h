@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A byte range of a constant buffer that changes at its own rate.
+struct ConstantBlock
+{
+    std::wstring Name;
+    std::uint32_t Offset;
+    std::uint32_t Size;
+};
+
+// Writes a constant buffer into persistently mapped upload memory block by block.
+// Each copy of the buffer (one per frame resource and view) remembers what it holds,
+// and only the blocks that differ from that are written. Adjacent changed blocks
+// go out as one memcpy, since the memory is write-combined.
+class LampConstantBlocks
+{
+public:
+    // Blocks are in layout order and cover [0, size) without gaps.
+    LampConstantBlocks(const std::wstring& name, std::uint32_t size, const std::vector<ConstantBlock>& blocks);
+    LampConstantBlocks(const LampConstantBlocks& rhs) = delete;
+    LampConstantBlocks& operator=(const LampConstantBlocks& rhs) = delete;
+    ~LampConstantBlocks() = default;
+
+    // Brings dst, the mapped memory of copy, up to date with data. Returns the bytes written.
+    std::uint32_t Write(std::uint32_t copy, const void* data, std::uint8_t* dst);
+    // The copy's memory was recreated or written elsewhere; its next Write() is a full one.
+    void Invalidate(std::uint32_t copy);
+
+    // Starts counting a new frame.
+    void BeginFrame();
+    // Bytes written in the last complete frame, and what rewriting every copy whole would have cost.
+    std::uint64_t LastFrameBytes()const { return mLastFrame.Bytes; }
+    std::uint64_t LastFrameFullBytes()const { return mLastFrame.FullBytes; }
+    std::wstring Report()const;
+
+private:
+    struct Counters
+    {
+        std::uint64_t Bytes = 0;
+        std::uint64_t FullBytes = 0;
+        // Writes per block.
+        std::vector<std::uint32_t> Writes;
+    };
+
+    std::wstring mName;
+    std::uint32_t mSize;
+    std::vector<ConstantBlock> mBlocks;
+    // What each copy holds; empty until its first Write().
+    std::vector<std::vector<std::uint8_t>> mHeld;
+
+    Counters mFrame;
+    Counters mLastFrame;
+};
@@ -7,55 +7,56 @@ void LampApp::AnimateMaterials(const GameTimer& gt)
 
 void LampApp::UpdateObjectCBs(const GameTimer& gt)
 {
+    // Only the items queued for this frame resource since it was last used.
     auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-    for (auto& e : mScene->mAllRitems)
+    mScene->ObjectDirty().Flush(mCurrFrameResourceIndex, [&](UINT index)
     {
-        // Only update the cbuffer data if the constants have changed.  
-        // This needs to be tracked per frame resource.
-        if (e->NumFramesDirty > 0)
-        {
-            XMMATRIX world = XMLoadFloat4x4(&e->World);
-            XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-            ObjectConstants objConstants;
-            XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-            XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-            objConstants.MaterialIndex = e->Mat->MatCBIndex;
-
-            currObjectCB->CopyData(e->ObjCBIndex, objConstants);
-
-            // Next FrameResource need to be updated too.
-            e->NumFramesDirty--;
-        }
-    }
+        RenderItem* e = mScene->ItemByCBIndex(index);
+
+        XMMATRIX world = XMLoadFloat4x4(&e->World);
+        XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+
+        ObjectConstants objConstants;
+        XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+        XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+        objConstants.MaterialIndex = e->Mat->MatCBIndex;
+
+        currObjectCB->CopyData(index, objConstants);
+    });
 }
 
 void LampApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
+    // Only the materials queued for this frame resource since it was last used.
     auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-    for (auto& e : mScene->mMaterials)
+    mScene->MaterialDirty().Flush(mCurrFrameResourceIndex, [&](UINT index)
     {
-        // Only update the cbuffer data if the constants have changed.  If the cbuffer
-        // data changes, it needs to be updated for each FrameResource.
-        Material* mat = e.second.get();
-        if (mat->NumFramesDirty > 0)
-        {
-            XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
-
-            MaterialData matData;
-            matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-            matData.FresnelR0 = mat->FresnelR0;
-            matData.Roughness = mat->Roughness;
-            XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-            matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-            matData.NormalMapIndex = mat->NormalSrvHeapIndex;
-
-            currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
-
-            // Next FrameResource need to be updated too.
-            mat->NumFramesDirty--;
-        }
-    }
+        Material* mat = mScene->MaterialByCBIndex(index);
+
+        XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+
+        MaterialData matData;
+        matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+        matData.FresnelR0 = mat->FresnelR0;
+        matData.Roughness = mat->Roughness;
+        XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+        matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+        matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+
+        currMaterialBuffer->CopyData(index, matData);
+    });
+}
+
+void LampApp::UpdateInstanceBuffer(const GameTimer& gt)
+{
+    // Batches depend on this frame's visibility, so they are rebuilt every frame.
+    auto& instancing = mScene->Instancing(RenderLayer::Opaque);
+    instancing.Build(mScene->RenderItems(RenderLayer::Opaque), true);
+
+    // A root SRV has no 256-byte rule, so the instances are packed tightly.
+    const auto& instances = instancing.Instances();
+    mCurrFrameResource->InstanceBufferAddress = mCurrFrameResource->Upload->Upload(
+        instances.data(), (UINT)instances.size(), 16).GPU;
 }
 
 void LampApp::UpdateShadowTransform(const GameTimer& gt)
@@ -98,6 +99,20 @@ void LampApp::UpdateShadowTransform(const GameTimer& gt)
     XMStoreFloat4x4(&mShadowTransform, S);
 }
 
+LampLightCounts LampApp::SceneLightCounts()const
+{
+    // Lights past the last lit one are dropped; the shaders take the first Directional.
+    LampLightCounts lights;
+    lights.Directional = 0;
+    for (UINT i = 0; i < 3; ++i)
+    {
+        const XMFLOAT3& s = mLightStrengths[i];
+        if (s.x != 0.0f || s.y != 0.0f || s.z != 0.0f)
+            lights.Directional = i + 1;
+    }
+    return lights;
+}
+
 void LampApp::UpdateMainPassCB(const GameTimer& gt)
 {
     XMMATRIX view = mCamera.GetView();
@@ -134,15 +149,15 @@ void LampApp::UpdateMainPassCB(const GameTimer& gt)
     mMainPassCB.TotalTime = gt.TotalTime();
     mMainPassCB.DeltaTime = gt.DeltaTime();
     mMainPassCB.AmbientLight = { 0.0002f, 0.00025f, 0.0003f, 1.0f };
-    mMainPassCB.Lights[0].Direction = mRotatedLightDirections[0];
-    mMainPassCB.Lights[0].Strength = { 1.2f, 1.2f, 1.2f };
-    mMainPassCB.Lights[1].Direction = mRotatedLightDirections[1];
-    mMainPassCB.Lights[1].Strength = { 0.0f, 0.0f, 0.0f };
-    mMainPassCB.Lights[2].Direction = mRotatedLightDirections[2];
-    mMainPassCB.Lights[2].Strength = { 0.000f, 0.000f, 0.000f };
-
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(0, mMainPassCB);
+    for (int i = 0; i < 3; ++i)
+    {
+        mMainPassCB.Lights[i].Direction = mRotatedLightDirections[i];
+        mMainPassCB.Lights[i].Strength = mLightStrengths[i];
+    }
+    for (UINT level = 0; level < VOXEL_LEVELS; ++level)
+        mMainPassCB.VoxelClip[level] = mVoxelClipmap->Window(level);
+
+    mPassBlocks->Write(mCurrFrameResourceIndex * PassCBCount + 0, &mMainPassCB, mCurrFrameResource->PassCB->MappedData(0));
 }
 
 void LampApp::UpdateShadowPassCB(const GameTimer& gt)
@@ -170,8 +185,7 @@ void LampApp::UpdateShadowPassCB(const GameTimer& gt)
     mShadowPassCB.NearZ = mLightNearZ;
     mShadowPassCB.FarZ = mLightFarZ;
 
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(1, mShadowPassCB);
+    mPassBlocks->Write(mCurrFrameResourceIndex * PassCBCount + 1, &mShadowPassCB, mCurrFrameResource->PassCB->MappedData(1));
 }
 
 void LampApp::UpdateSsaoCB(const GameTimer& gt)
@@ -208,43 +222,62 @@ void LampApp::UpdateSsaoCB(const GameTimer& gt)
     ssaoCB.OcclusionFadeEnd = 1.0f;
     ssaoCB.SurfaceEpsilon = 0.05f;
 
-    auto currSsaoCB = mCurrFrameResource->SsaoCB.get();
-    currSsaoCB->CopyData(0, ssaoCB);*/
+    mCurrFrameResource->SsaoCBAddress = mCurrFrameResource->Upload->Upload(ssaoCB).GPU;*/
 }
 
 void LampApp::UpdateTaaCB(const GameTimer& gt)
 {
+    // View, projection, target size and time are read from cbPass, bound next to it.
     TaaConstants taaCB;
 
-    XMMATRIX V = mCamera.GetView();
-    XMMATRIX P = mCamera.GetProj();
     XMMATRIX vl = mLastView;
     XMMATRIX Pl = mLastProj;
 
-    taaCB.View = mMainPassCB.View;
-    taaCB.InvView = mMainPassCB.InvView;
-    taaCB.Proj = mMainPassCB.Proj;
-    taaCB.InvProj = mMainPassCB.InvProj;
-    taaCB.ViewProj = mMainPassCB.ViewProj;
-
     XMMATRIX viewProjl = XMMatrixMultiply(vl, Pl);
-    XMStoreFloat4x4(&taaCB.lastViewProj, XMMatrixTranspose(viewProjl));
+    XMStoreFloat4x4(&taaCB.LastViewProj, XMMatrixTranspose(viewProjl));
     FLOAT x = 1.0f / mClientWidth;
     FLOAT y = 1.0f / mClientHeight;
-    taaCB.offsets[0] = XMFLOAT2(0, 0);
-    taaCB.offsets[1] = XMFLOAT2(-x, 0);
-    taaCB.offsets[2] = XMFLOAT2(0, -y);
-    taaCB.offsets[3] = XMFLOAT2(-x, y);
-    taaCB.offsets[4] = XMFLOAT2(x, -y);
-    taaCB.offsets[5] = XMFLOAT2(x, 0);
-    taaCB.offsets[6] = XMFLOAT2(0, y);
-    taaCB.offsets[7] = XMFLOAT2(x, y);
-    taaCB.offsets[8] = XMFLOAT2(-x, -y);
-    taaCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
+    taaCB.Offsets[0] = XMFLOAT4(0, 0, 0, 0);
+    taaCB.Offsets[1] = XMFLOAT4(-x, 0, 0, 0);
+    taaCB.Offsets[2] = XMFLOAT4(0, -y, 0, 0);
+    taaCB.Offsets[3] = XMFLOAT4(-x, y, 0, 0);
+    taaCB.Offsets[4] = XMFLOAT4(x, -y, 0, 0);
+    taaCB.Offsets[5] = XMFLOAT4(x, 0, 0, 0);
+    taaCB.Offsets[6] = XMFLOAT4(0, y, 0, 0);
+    taaCB.Offsets[7] = XMFLOAT4(x, y, 0, 0);
+    taaCB.Offsets[8] = XMFLOAT4(-x, -y, 0, 0);
+
+    taaCB.Influence = 0.1f;
+    mTaaBlocks->Write(mCurrFrameResourceIndex, &taaCB, mCurrFrameResource->TaaCB->MappedData(0));
+}
 
-    // Coordinates given in view space.
-    taaCB.Influnce = 0.1f;
-    taaCB.TotalTime = mMainPassCB.TotalTime;
-    auto currTaaCB = mCurrFrameResource->TaaCB.get();
-    currTaaCB->CopyData(0, taaCB);
+void LampApp::BuildConstantBlocks()
+{
+    // Split as in ConstantLayout.hlsli; each block starts at its first field.
+    const UINT target = (UINT)offsetof(PassConstants, RenderTargetSize);
+    const UINT frame = (UINT)offsetof(PassConstants, TotalTime);
+    const UINT lights = (UINT)offsetof(PassConstants, AmbientLight);
+    const UINT voxel = (UINT)offsetof(PassConstants, VoxelClip);
+    const UINT statics = (UINT)offsetof(PassConstants, VoxelDims);
+    mPassBlocks = std::make_unique<LampConstantBlocks>(L"Pass", (UINT)sizeof(PassConstants), std::vector<ConstantBlock>
+    {
+        { L"view", 0, target },
+        { L"target", target, frame - target },
+        { L"frame", frame, lights - frame },
+        { L"lights", lights, voxel - lights },
+        { L"voxel", voxel, statics - voxel },
+        { L"static", statics, (UINT)sizeof(PassConstants) - statics },
+    });
+
+    // The static block is filled here, once; every copy gets it on its first Write().
+    const UINT* voxelDims = mVoxelClipmap->Dims();
+    mMainPassCB.VoxelDims = XMFLOAT3((float)voxelDims[0], (float)voxelDims[1], (float)voxelDims[2]);
+    mMainPassCB.VoxelLevels = mVoxelClipmap->Levels();
+
+    const UINT offsets = (UINT)offsetof(TaaConstants, Offsets);
+    mTaaBlocks = std::make_unique<LampConstantBlocks>(L"TAA", (UINT)sizeof(TaaConstants), std::vector<ConstantBlock>
+    {
+        { L"reprojection", 0, offsets },
+        { L"target", offsets, (UINT)sizeof(TaaConstants) - offsets },
+    });
 }
\ No newline at end of file
@@ -54,5 +54,102 @@ void LampApp::OnKeyboardInput(const GameTimer& gt)
     if (GetAsyncKeyState('P') & 0x8000)
         showDebugView = !showDebugView;
 
+    // Hold C to draw without occlusion culling.
+    mOcclusionCulling = !(GetAsyncKeyState('C') & 0x8000);
+
+    // Hold R to record the command lists one after another on this thread.
+    mParallelRecording = !(GetAsyncKeyState('R') & 0x8000);
+
+    // L freezes the world probes: their pass leaves the render graph and the last probes stay.
+    UINT probes = (GetAsyncKeyState('L') & 0x0001) ? FindPass(L"WorldProbe") : (UINT)mPasses.size();
+    if (probes < (UINT)mPasses.size())
+    {
+        RenderPass* pass = mPasses[probes].get();
+        pass->SetEnabled(!pass->Enabled());
+        std::wstring msg = std::wstring(L"World probes ") + (pass->Enabled() ? L"updating\n" : L"frozen\n");
+        OutputDebugString(msg.c_str());
+    }
+
+    // F cycles the frames in flight, 1 to 4.
+    if (GetAsyncKeyState('F') & 0x0001)
+    {
+        mPacer.SetFramesInFlight(mPacer.FramesInFlight() % LampFramePacer::MaxFramesInFlight + 1);
+        std::wstring msg = L"Frames in flight: " + std::to_wstring(mPacer.FramesInFlight()) + L"\n";
+        OutputDebugString(msg.c_str());
+    }
+
+    // Dump the occlusion buffers once per key press.
+    if (GetAsyncKeyState('O') & 0x0001)
+    {
+        mOcclusion->DumpDepth("OcclusionDepth.pgm");
+        mOcclusion->DumpHiZ("OcclusionHiZ.pgm");
+
+        const OcclusionStats& stats = mOcclusion->Stats();
+        std::wstring msg = L"Occlusion: occluder tris " + std::to_wstring(stats.RasterizedTriangles)
+            + L"/" + std::to_wstring(stats.OccluderTriangles)
+            + L", culled " + std::to_wstring(stats.CulledItems)
+            + L"/" + std::to_wstring(stats.TestedItems)
+            + L", raster " + std::to_wstring(stats.RasterMs)
+            + L" ms, cull " + std::to_wstring(stats.CullMs) + L" ms\n";
+        OutputDebugString(msg.c_str());
+
+        auto& instancing = mScene->Instancing(RenderLayer::Opaque);
+        msg = L"Instancing: " + std::to_wstring(instancing.ItemCount()) + L" items in "
+            + std::to_wstring(instancing.Batches().size()) + L" draws\n";
+        OutputDebugString(msg.c_str());
+
+        for (auto& pass : mPasses)
+        {
+            auto scenePass = dynamic_cast<SceneRenderPass*>(pass.get());
+            if (scenePass == nullptr)
+                continue;
+            const DrawListStats& drawStats = scenePass->DrawStats();
+            msg = L"DrawList: " + std::to_wstring(drawStats.Draws) + L" draws, binds issued "
+                + std::to_wstring(drawStats.BindsIssued) + L", saved " + std::to_wstring(drawStats.BindsSaved)
+                + L", pipelines " + std::to_wstring(drawStats.PipelineBinds)
+                + L", key overflows " + std::to_wstring(drawStats.KeyOverflows) + L"\n";
+            OutputDebugString(msg.c_str());
+        }
+
+        auto& transforms = mScene->Transforms();
+        msg = L"Transforms: " + std::to_wstring(transforms.UpdatedCount()) + L"/" + std::to_wstring(transforms.NodeCount())
+            + L" nodes updated in " + std::to_wstring(transforms.UpdateMs()) + L" ms\n";
+        OutputDebugString(msg.c_str());
+
+        auto& octree = mScene->Octree();
+        std::vector<UINT> nearby;
+        octree.Query(BoundingSphere(mCamera.GetPosition3f(), 10.0f), nearby);
+        msg = L"Octree: " + std::to_wstring(octree.ObjectCount()) + L" items in " + std::to_wstring(octree.NodeCount())
+            + L" nodes, " + std::to_wstring(nearby.size()) + L" within 10 units of the camera\n";
+        OutputDebugString(msg.c_str());
+
+        msg = L"Dirty tracking: " + std::to_wstring(mScene->ObjectDirty().LastFlushedCount()) + L" objects, "
+            + std::to_wstring(mScene->MaterialDirty().LastFlushedCount()) + L" materials written last frame\n";
+        OutputDebugString(msg.c_str());
+
+        // Still the previous frame's resource, so this is what that frame uploaded.
+        if (mCurrFrameResource != nullptr)
+        {
+            auto upload = mCurrFrameResource->Upload.get();
+            msg = L"Upload: " + std::to_wstring(upload->UsedBytes()) + L"/" + std::to_wstring(upload->CapacityBytes())
+                + L" bytes in " + std::to_wstring(upload->PageCount()) + L" pages\n";
+            OutputDebugString(msg.c_str());
+        }
+        OutputDebugString(mPassBlocks->Report().c_str());
+        OutputDebugString(mTaaBlocks->Report().c_str());
+        OutputDebugString(mVoxelClipmap->Report().c_str());
+        OutputDebugString(mVoxelBake->Report().c_str());
+
+        OutputDebugString(mHeaps->GpuMemory().Report().c_str());
+        OutputDebugString(mHeaps->TransientReport().c_str());
+        OutputDebugString(mGraph.Dump().c_str());
+        OutputDebugString(mHeaps->StateRegistry().Report().c_str());
+        OutputDebugString(mRecorder.Report().c_str());
+        OutputDebugString(mHeaps->DescriptorReport().c_str());
+        OutputDebugString(mPacer.Report().c_str());
+        OutputDebugString(mPSO->ShaderReport().c_str());
+        OutputDebugString(mPSO->PipelineReport().c_str());
+    }
+
     mCamera.UpdateViewMatrix();
 }
@@ -0,0 +1,265 @@
+#include "CpuTexture.h"
+#include "PipelineCache.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const std::uint32_t DdsMagic = 0x20534444; // "DDS "
+    const std::uint32_t DdsFourCC = 0x4;
+    const std::uint32_t DdsRgb = 0x40;
+    const size_t DdsHeaderSize = 128;
+    const size_t Dx10HeaderSize = 20;
+
+    // The DXGI_FORMAT values of the DX10 header.
+    enum DxgiFormat : std::uint32_t
+    {
+        DxgiRgba8 = 28,
+        DxgiRgba8Srgb = 29,
+        DxgiBC1 = 71,
+        DxgiBC1Srgb = 72,
+        DxgiBC3 = 77,
+        DxgiBC3Srgb = 78,
+        DxgiBgra8 = 87,
+        DxgiBgra8Srgb = 91,
+    };
+
+    std::uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return (std::uint32_t)(std::uint8_t)a | ((std::uint32_t)(std::uint8_t)b << 8) | ((std::uint32_t)(std::uint8_t)c << 16) | ((std::uint32_t)(std::uint8_t)d << 24);
+    }
+
+    std::uint32_t ReadUint(const std::uint8_t* data, size_t offset)
+    {
+        std::uint32_t value;
+        memcpy(&value, data + offset, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t Rgba(std::uint32_t r, std::uint32_t g, std::uint32_t b, std::uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    // The 8 bits of a channel under mask, or 255 without one.
+    std::uint32_t Channel(std::uint32_t pixel, std::uint32_t mask)
+    {
+        if (mask == 0)
+            return 255;
+        std::uint32_t shift = 0;
+        while (((mask >> shift) & 1) == 0)
+            shift++;
+        const std::uint32_t max = mask >> shift;
+        return (std::uint32_t)(((std::uint64_t)((pixel & mask) >> shift) * 255 + max / 2) / max);
+    }
+
+    // Colors of a BC1 block; three and transparent black when c0 <= c1 and allowed.
+    void BlockColors(const std::uint8_t* block, bool threeColor, std::uint32_t colors[4])
+    {
+        const std::uint32_t c[2] = { (std::uint32_t)block[0] | ((std::uint32_t)block[1] << 8), (std::uint32_t)block[2] | ((std::uint32_t)block[3] << 8) };
+        std::uint32_t rgb[2][3];
+        for (int i = 0; i < 2; ++i)
+        {
+            rgb[i][0] = ((c[i] >> 11) & 31) * 255 / 31;
+            rgb[i][1] = ((c[i] >> 5) & 63) * 255 / 63;
+            rgb[i][2] = (c[i] & 31) * 255 / 31;
+        }
+        colors[0] = Rgba(rgb[0][0], rgb[0][1], rgb[0][2], 255);
+        colors[1] = Rgba(rgb[1][0], rgb[1][1], rgb[1][2], 255);
+        if (c[0] > c[1] || !threeColor)
+        {
+            colors[2] = Rgba((2 * rgb[0][0] + rgb[1][0]) / 3, (2 * rgb[0][1] + rgb[1][1]) / 3, (2 * rgb[0][2] + rgb[1][2]) / 3, 255);
+            colors[3] = Rgba((rgb[0][0] + 2 * rgb[1][0]) / 3, (rgb[0][1] + 2 * rgb[1][1]) / 3, (rgb[0][2] + 2 * rgb[1][2]) / 3, 255);
+        }
+        else
+        {
+            colors[2] = Rgba((rgb[0][0] + rgb[1][0]) / 2, (rgb[0][1] + rgb[1][1]) / 2, (rgb[0][2] + rgb[1][2]) / 2, 255);
+            colors[3] = 0;
+        }
+    }
+}
+
+LampCpuTexture::LampCpuTexture(std::uint32_t width, std::uint32_t height, std::vector<std::uint32_t> texels)
+    : mWidth(width), mHeight(height), mTexels(std::move(texels))
+{
+    assert(width > 0 && height > 0 && mTexels.size() == (size_t)width * height);
+}
+
+std::unique_ptr<LampCpuTexture> LampCpuTexture::LoadDDS(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return FromDDS(data.data(), data.size());
+}
+
+std::unique_ptr<LampCpuTexture> LampCpuTexture::FromDDS(const std::uint8_t* data, size_t size)
+{
+    if (data == nullptr || size < DdsHeaderSize || ReadUint(data, 0) != DdsMagic)
+        return nullptr;
+    const std::uint32_t height = ReadUint(data, 12);
+    const std::uint32_t width = ReadUint(data, 16);
+    const std::uint32_t pfFlags = ReadUint(data, 80);
+    const std::uint32_t fourCC = ReadUint(data, 84);
+    const std::uint32_t bitCount = ReadUint(data, 88);
+    const std::uint32_t masks[4] = { ReadUint(data, 92), ReadUint(data, 96), ReadUint(data, 100), ReadUint(data, 104) };
+    if (width == 0 || height == 0 || width > 16384 || height > 16384)
+        return nullptr;
+
+    // The format, from the DX10 header when there is one.
+    enum class Format { BC1, BC3, Rgba8, Bgra8, Masked } format;
+    size_t offset = DdsHeaderSize;
+    if ((pfFlags & DdsFourCC) && fourCC == FourCC('D', 'X', '1', '0'))
+    {
+        if (size < DdsHeaderSize + Dx10HeaderSize)
+            return nullptr;
+        const std::uint32_t dxgiFormat = ReadUint(data, DdsHeaderSize);
+        const std::uint32_t dimension = ReadUint(data, DdsHeaderSize + 4);
+        const std::uint32_t arraySize = ReadUint(data, DdsHeaderSize + 12);
+        // Texture2D, one slice.
+        if (dimension != 3 || arraySize > 1)
+            return nullptr;
+        offset += Dx10HeaderSize;
+        switch (dxgiFormat)
+        {
+        case DxgiBC1: case DxgiBC1Srgb: format = Format::BC1; break;
+        case DxgiBC3: case DxgiBC3Srgb: format = Format::BC3; break;
+        case DxgiRgba8: case DxgiRgba8Srgb: format = Format::Rgba8; break;
+        case DxgiBgra8: case DxgiBgra8Srgb: format = Format::Bgra8; break;
+        default: return nullptr;
+        }
+    }
+    else if (pfFlags & DdsFourCC)
+    {
+        if (fourCC == FourCC('D', 'X', 'T', '1'))
+            format = Format::BC1;
+        else if (fourCC == FourCC('D', 'X', 'T', '5'))
+            format = Format::BC3;
+        else
+            return nullptr;
+    }
+    else if ((pfFlags & DdsRgb) && bitCount == 32)
+        format = Format::Masked;
+    else
+        return nullptr;
+
+    std::vector<std::uint32_t> texels((size_t)width * height);
+    if (format == Format::BC1 || format == Format::BC3)
+    {
+        const std::uint32_t blockBytes = format == Format::BC1 ? 8 : 16;
+        const std::uint32_t blocksX = (width + 3) / 4;
+        const std::uint32_t blocksY = (height + 3) / 4;
+        if (size - offset < (size_t)blocksX * blocksY * blockBytes)
+            return nullptr;
+        std::uint32_t block[16];
+        for (std::uint32_t by = 0; by < blocksY; ++by)
+        {
+            for (std::uint32_t bx = 0; bx < blocksX; ++bx)
+            {
+                const std::uint8_t* src = data + offset + ((size_t)by * blocksX + bx) * blockBytes;
+                if (format == Format::BC1)
+                    DecodeBC1(src, block);
+                else
+                    DecodeBC3(src, block);
+                for (std::uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+                {
+                    for (std::uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                        texels[(size_t)(by * 4 + y) * width + bx * 4 + x] = block[y * 4 + x];
+                }
+            }
+        }
+    }
+    else
+    {
+        if (size - offset < texels.size() * 4)
+            return nullptr;
+        for (size_t i = 0; i < texels.size(); ++i)
+        {
+            const std::uint32_t pixel = ReadUint(data, offset + i * 4);
+            if (format == Format::Rgba8)
+                texels[i] = pixel;
+            else if (format == Format::Bgra8)
+                texels[i] = Rgba((pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff, pixel >> 24);
+            else
+                texels[i] = Rgba(Channel(pixel, masks[0]), Channel(pixel, masks[1]), Channel(pixel, masks[2]), Channel(pixel, masks[3]));
+        }
+    }
+    return std::make_unique<LampCpuTexture>(width, height, std::move(texels));
+}
+
+void LampCpuTexture::DecodeBC1(const std::uint8_t block[8], std::uint32_t texels[16])
+{
+    std::uint32_t colors[4];
+    BlockColors(block, true, colors);
+    const std::uint32_t indices = ReadUint(block, 4);
+    for (std::uint32_t i = 0; i < 16; ++i)
+        texels[i] = colors[(indices >> (2 * i)) & 3];
+}
+
+void LampCpuTexture::DecodeBC3(const std::uint8_t block[16], std::uint32_t texels[16])
+{
+    std::uint32_t alpha[8];
+    alpha[0] = block[0];
+    alpha[1] = block[1];
+    if (alpha[0] > alpha[1])
+    {
+        for (std::uint32_t i = 1; i < 7; ++i)
+            alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+    }
+    else
+    {
+        for (std::uint32_t i = 1; i < 5; ++i)
+            alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+        alpha[6] = 0;
+        alpha[7] = 255;
+    }
+    std::uint64_t alphaIndices = 0;
+    for (int i = 0; i < 6; ++i)
+        alphaIndices |= (std::uint64_t)block[2 + i] << (8 * i);
+
+    std::uint32_t colors[4];
+    BlockColors(block + 8, false, colors);
+    const std::uint32_t indices = ReadUint(block, 12);
+    for (std::uint32_t i = 0; i < 16; ++i)
+    {
+        const std::uint32_t a = alpha[(alphaIndices >> (3 * i)) & 7];
+        texels[i] = (colors[(indices >> (2 * i)) & 3] & 0x00ffffff) | (a << 24);
+    }
+}
+
+void LampCpuTexture::Sample(float u, float v, float rgba[4])const
+{
+    // Texel centers at half integers, as the GPU filters.
+    const float x = u * mWidth - 0.5f;
+    const float y = v * mHeight - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float tx = x - fx;
+    const float ty = y - fy;
+    auto wrap = [](float t, std::uint32_t size) { return (std::uint32_t)(((std::int64_t)t % (std::int64_t)size + size) % size); };
+    const std::uint32_t x0 = wrap(fx, mWidth);
+    const std::uint32_t x1 = (x0 + 1) % mWidth;
+    const std::uint32_t y0 = wrap(fy, mHeight);
+    const std::uint32_t y1 = (y0 + 1) % mHeight;
+
+    const std::uint32_t corners[4] = { mTexels[y0 * mWidth + x0], mTexels[y0 * mWidth + x1], mTexels[y1 * mWidth + x0], mTexels[y1 * mWidth + x1] };
+    const float weights[4] = { (1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty };
+    for (int c = 0; c < 4; ++c)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < 4; ++i)
+            sum += weights[i] * (float)((corners[i] >> (8 * c)) & 0xff);
+        rgba[c] = sum / 255.0f;
+    }
+}
+
+std::uint64_t LampCpuTexture::Hash()const
+{
+    LampHashStream h;
+    h.Value(mWidth);
+    h.Value(mHeight);
+    h.Bytes(mTexels.data(), mTexels.size() * sizeof(std::uint32_t));
+    return h.Hash();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The top mip of a 2D texture kept on the CPU as RGBA8 (R in the low byte), so the
+// CPU voxelizer can sample what the shaders sample.
+class LampCpuTexture
+{
+public:
+    LampCpuTexture(std::uint32_t width, std::uint32_t height, std::vector<std::uint32_t> texels);
+    LampCpuTexture(const LampCpuTexture& rhs) = delete;
+    LampCpuTexture& operator=(const LampCpuTexture& rhs) = delete;
+    ~LampCpuTexture() = default;
+
+    // BC1, BC3 and uncompressed 32-bit 2D textures; null for anything else.
+    static std::unique_ptr<LampCpuTexture> LoadDDS(const std::string& path);
+    static std::unique_ptr<LampCpuTexture> FromDDS(const std::uint8_t* data, size_t size);
+
+    // Bilinear with wrap, as the wrap samplers filter the top mip; rgba in [0, 1].
+    void Sample(float u, float v, float rgba[4])const;
+
+    std::uint32_t Width()const { return mWidth; }
+    std::uint32_t Height()const { return mHeight; }
+    const std::vector<std::uint32_t>& Texels()const { return mTexels; }
+    // Of the size and texels, for keys of what was baked from the texture.
+    std::uint64_t Hash()const;
+
+    // A 4x4 block, texels in rows.
+    static void DecodeBC1(const std::uint8_t block[8], std::uint32_t texels[16]);
+    static void DecodeBC3(const std::uint8_t block[16], std::uint32_t texels[16]);
+
+private:
+    std::uint32_t mWidth;
+    std::uint32_t mHeight;
+    std::vector<std::uint32_t> mTexels;
+};
@@ -0,0 +1,79 @@
+#include "D3DStateTracker.h"
+
+// The render graph and the tracker keep D3D12 states without the Windows headers.
+static_assert(LampStateCommon == D3D12_RESOURCE_STATE_COMMON
+    && LampStateVertexAndConstantBuffer == D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
+    && LampStateIndexBuffer == D3D12_RESOURCE_STATE_INDEX_BUFFER
+    && LampStateIndirectArgument == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
+    && LampStateGenericRead == D3D12_RESOURCE_STATE_GENERIC_READ
+    && LampStateRenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET
+    && LampStateUnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+    && LampStateDepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE
+    && LampStateDepthRead == D3D12_RESOURCE_STATE_DEPTH_READ
+    && LampStateNonPixelShaderResource == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+    && LampStatePixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+    && LampStateCopyDest == D3D12_RESOURCE_STATE_COPY_DEST
+    && LampStateCopySource == D3D12_RESOURCE_STATE_COPY_SOURCE, "Resource states differ from D3D12.");
+static_assert(LampStateTracker::AllSubresources == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+    "Subresource wildcard differs from D3D12.");
+
+UINT D3DStateTracker::SubresourceCount(const D3D12_RESOURCE_DESC& desc)
+{
+    // One plane; depth-stencil formats with stencil are tracked as a whole.
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        return 1;
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        return std::max<UINT>(desc.MipLevels, 1);
+    return std::max<UINT>(desc.MipLevels, 1) * std::max<UINT>(desc.DepthOrArraySize, 1);
+}
+
+std::uint32_t D3DStateTracker::CountSubresources(void* resource)const
+{
+    return SubresourceCount(static_cast<ID3D12Resource*>(resource)->GetDesc());
+}
+
+D3D12_RESOURCE_BARRIER D3DStateTracker::Barrier(const StateBarrier& barrier)
+{
+    auto resource = static_cast<ID3D12Resource*>(barrier.Resource);
+    if (barrier.Type == StateBarrierType::Uav)
+        return CD3DX12_RESOURCE_BARRIER::UAV(resource);
+    if (barrier.Type == StateBarrierType::Aliasing)
+        return CD3DX12_RESOURCE_BARRIER::Aliasing(resource, static_cast<ID3D12Resource*>(barrier.AliasAfter));
+
+    D3D12_RESOURCE_BARRIER_FLAGS flags = barrier.Split == StateBarrierSplit::Begin ? D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY
+        : barrier.Split == StateBarrierSplit::End ? D3D12_RESOURCE_BARRIER_FLAG_END_ONLY : D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    return CD3DX12_RESOURCE_BARRIER::Transition(resource, (D3D12_RESOURCE_STATES)barrier.Before,
+        (D3D12_RESOURCE_STATES)barrier.After, barrier.Subresource, flags);
+}
+
+void D3DStateTracker::Record(ID3D12GraphicsCommandList* cmdList, const std::vector<StateBarrier>& barriers)
+{
+    if (barriers.empty())
+        return;
+    std::vector<D3D12_RESOURCE_BARRIER> d3dBarriers;
+    for (auto& b : barriers)
+        d3dBarriers.push_back(Barrier(b));
+    cmdList->ResourceBarrier((UINT)d3dBarriers.size(), d3dBarriers.data());
+}
+
+void D3DStateTracker::Flush(ID3D12GraphicsCommandList* cmdList)
+{
+    std::vector<StateBarrier> barriers;
+    Flush(barriers);
+    Record(cmdList, barriers);
+}
+
+void D3DStateTracker::FlushAll(ID3D12GraphicsCommandList* cmdList)
+{
+    std::vector<StateBarrier> barriers;
+    FlushAll(barriers);
+    Record(cmdList, barriers);
+}
+
+void D3DStateTracker::Join(D3DStateTracker& list, std::vector<D3D12_RESOURCE_BARRIER>& patch)
+{
+    std::vector<StateBarrier> barriers;
+    LampStateTracker::Join(list, barriers);
+    for (auto& b : barriers)
+        patch.push_back(Barrier(b));
+}
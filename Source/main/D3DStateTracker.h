@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../D3D/d3dUtil.h"
+#include "ResourceStateTracker.h"
+
+// LampStateTracker over ID3D12Resource pointers, writing its barriers to command lists.
+class D3DStateTracker : public LampStateTracker
+{
+public:
+    using LampStateTracker::Flush;
+    using LampStateTracker::FlushAll;
+    using LampStateTracker::Join;
+
+    static UINT SubresourceCount(const D3D12_RESOURCE_DESC& desc);
+
+    void Flush(ID3D12GraphicsCommandList* cmdList);
+    void FlushAll(ID3D12GraphicsCommandList* cmdList);
+    void Join(D3DStateTracker& list, std::vector<D3D12_RESOURCE_BARRIER>& patch);
+
+    static D3D12_RESOURCE_BARRIER Barrier(const StateBarrier& barrier);
+
+protected:
+    // Sized from the resource itself: a later call may name any of its subresources.
+    std::uint32_t CountSubresources(void* resource)const override;
+
+private:
+    void Record(ID3D12GraphicsCommandList* cmdList, const std::vector<StateBarrier>& barriers);
+};
@@ -0,0 +1,89 @@
+#include "DescriptorAllocator.h"
+#include <algorithm>
+
+constexpr std::uint32_t LampDescriptorAllocator::InvalidSlot;
+
+LampDescriptorAllocator::LampDescriptorAllocator(std::uint32_t capacity, std::uint32_t ringCapacity)
+    : mCapacity(std::max<std::uint32_t>(1u, capacity)), mLive(mCapacity, false), mRingCapacity(ringCapacity)
+{
+    mStats.Capacity = mCapacity;
+    mStats.RingCapacity = mRingCapacity;
+}
+
+std::uint32_t LampDescriptorAllocator::Allocate()
+{
+    std::uint32_t slot;
+    if (!mFree.empty())
+    {
+        slot = mFree.back();
+        mFree.pop_back();
+    }
+    else
+    {
+        if (mNext == mCapacity)
+        {
+            mCapacity *= 2;
+            mLive.resize(mCapacity, false);
+            mStats.Capacity = mCapacity;
+            mStats.Grows++;
+        }
+        slot = mNext++;
+    }
+    mLive[slot] = true;
+    mStats.Used++;
+    return slot;
+}
+
+void LampDescriptorAllocator::Free(std::uint32_t slot)
+{
+    if (slot >= mNext || !mLive[slot])
+        return;
+    mLive[slot] = false;
+    mFree.push_back(slot);
+    mStats.Used--;
+}
+
+std::uint32_t LampDescriptorAllocator::AllocateTable(std::uint32_t count)
+{
+    if (count == 0 || count > mRingCapacity)
+    {
+        mStats.RingFailures++;
+        return InvalidSlot;
+    }
+
+    std::uint32_t start = mRingHead;
+    std::uint32_t size = count;
+    if (start + count > mRingCapacity)
+    {
+        // A table never wraps; the slots left at the end are held with it.
+        size += mRingCapacity - start;
+        start = 0;
+    }
+    // The free part of the ring starts at the head and wraps around to the oldest live table.
+    if (mStats.RingUsed + size > mRingCapacity)
+    {
+        mStats.RingFailures++;
+        return InvalidSlot;
+    }
+
+    mRingHead = (start + count) % mRingCapacity;
+    mStats.RingUsed += size;
+    mStats.RingPeak = std::max<std::uint32_t>(mStats.RingPeak, mStats.RingUsed);
+    if (mRingFrames.empty() || mRingFrames.back().Frame != mFrame)
+        mRingFrames.push_back({ mFrame, size });
+    else
+        mRingFrames.back().Size += size;
+    return mCapacity + start;
+}
+
+void LampDescriptorAllocator::BeginFrame(std::uint64_t frame, std::uint64_t completedFrame)
+{
+    while (!mRingFrames.empty() && mRingFrames.front().Frame <= completedFrame)
+    {
+        mStats.RingUsed -= mRingFrames.front().Size;
+        mRingFrames.pop_front();
+    }
+    if (mStats.RingUsed == 0)
+        mRingHead = 0;
+    mFrame = frame;
+}
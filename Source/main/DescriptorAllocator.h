@@ -0,0 +1,79 @@
+#pragma once
+
+#include "NameTable.h"
+#include <deque>
+#include <vector>
+
+// Named views and resources of DescriptorHeap. A handle is taken once, by name,
+// and stays valid when the view is recreated, so drawing never hashes a string.
+struct SrvTag {};
+struct UavTag {};
+struct RtvTag {};
+struct DsvTag {};
+struct ResourceTag {};
+
+typedef LampHandle<SrvTag> SrvHandle;
+typedef LampHandle<UavTag> UavHandle;
+typedef LampHandle<RtvTag> RtvHandle;
+typedef LampHandle<DsvTag> DsvHandle;
+typedef LampHandle<ResourceTag> ResourceHandle;
+
+struct DescriptorStats
+{
+    std::uint32_t Capacity = 0;
+    std::uint32_t Used = 0;
+    std::uint32_t Grows = 0;
+    std::uint32_t RingCapacity = 0;
+    // Ring slots still held by frames the GPU has not finished.
+    std::uint32_t RingUsed = 0;
+    std::uint32_t RingPeak = 0;
+    std::uint32_t RingFailures = 0;
+};
+
+// Slot bookkeeping for one descriptor heap, without the device.
+// Persistent slots fill [0, Capacity()); the per-frame ring follows them in
+// [Capacity(), Capacity() + RingCapacity()).
+class LampDescriptorAllocator
+{
+public:
+    static constexpr std::uint32_t InvalidSlot = UINT32_MAX;
+
+    LampDescriptorAllocator(std::uint32_t capacity, std::uint32_t ringCapacity = 0);
+    LampDescriptorAllocator(const LampDescriptorAllocator& rhs) = delete;
+    LampDescriptorAllocator& operator=(const LampDescriptorAllocator& rhs) = delete;
+    ~LampDescriptorAllocator() = default;
+
+    // Freed slots are reused first, otherwise slots go out in order, so views
+    // created back to back are adjacent. Doubles Capacity() when it runs out.
+    std::uint32_t Allocate();
+    void Free(std::uint32_t slot);
+    std::uint32_t Capacity()const { return mCapacity; }
+    std::uint32_t RingCapacity()const { return mRingCapacity; }
+
+    // count adjacent ring slots, held until the frame they were taken in has completed.
+    // InvalidSlot when the frames in flight leave no room.
+    std::uint32_t AllocateTable(std::uint32_t count);
+    // Tables taken from now on belong to frame; those of frames up to completedFrame are released.
+    void BeginFrame(std::uint64_t frame, std::uint64_t completedFrame);
+
+    const DescriptorStats& Stats()const { return mStats; }
+
+private:
+    struct RingFrame
+    {
+        std::uint64_t Frame;
+        std::uint32_t Size;
+    };
+
+    std::uint32_t mCapacity;
+    std::uint32_t mNext = 0;
+    std::vector<std::uint32_t> mFree;
+    std::vector<bool> mLive;
+
+    std::uint32_t mRingCapacity;
+    std::uint32_t mRingHead = 0;
+    std::uint64_t mFrame = 0;
+    std::deque<RingFrame> mRingFrames;
+
+    DescriptorStats mStats;
+};
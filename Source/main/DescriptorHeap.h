@@ -1,6 +1,12 @@
 #pragma once
 
 #include "./main/geometry.h"
+#include "./D3D/GpuMemory.h"
+#include "./main/TransientPlanner.h"
+#include "./main/D3DStateTracker.h"
+#include "./main/DescriptorAllocator.h"
+#include <mutex>
+#include <unordered_set>
 
 using Microsoft::WRL::ComPtr;
 
@@ -57,7 +63,56 @@ public:
         D3D12_RESOURCE_DESC resDesc, D3D12_CLEAR_VALUE* optClear, 
         D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_RESOURCE_STATES state);
 
+    // Placed resources start with undefined contents. A name kept committed gets a
+    // zero-filled allocation of its own instead, for targets read before they are
+    // written (history buffers). Call before the resource is created.
+    void KeepCommitted(std::wstring name);
+    // Discards the render targets and depth buffers placed since the last call,
+    // their required first operation. Before anything else uses them.
+    void InitializePlaced(ID3D12GraphicsCommandList* cmdList);
+
+    // Transient render targets. A resource named here is not created when a pass
+    // asks for it; BuildTransients() places all of them in one heap, where those
+    // with disjoint [firstPass, lastPass] ranges of the frame order share memory.
+    // Views of a transient are written once it exists.
+    void SetTransientLifetime(std::wstring name, UINT firstPass, UINT lastPass);
+    void BuildTransients();
+    // Aliasing barriers for the transients whose lifetime starts at framePass.
+    std::vector<D3D12_RESOURCE_BARRIER> TransientBarriers(UINT framePass)const;
+    std::wstring TransientReport()const;
+
+    // Handles by name, taken once when a pass is built. A name may be looked up
+    // before its view exists; the handle follows the view when it is recreated.
+    SrvHandle FindSrv(const std::wstring& name);
+    UavHandle FindUav(const std::wstring& name);
+    RtvHandle FindRtv(const std::wstring& name);
+    DsvHandle FindDsv(const std::wstring& name);
+    ResourceHandle FindResource(const std::wstring& name);
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE Srv(SrvHandle handle)const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GpuUav(UavHandle handle)const;
+    // In the CPU-only heap, as ClearUnorderedAccessView*() wants it.
+    CD3DX12_CPU_DESCRIPTOR_HANDLE CpuUav(UavHandle handle)const;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE Rtv(RtvHandle handle)const;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE Dsv(DsvHandle handle)const;
+    ID3D12Resource* Resource(ResourceHandle handle)const;
+
+    // Copies the views to adjacent slots of the per-frame ring and returns the table.
+    // Safe to call from recording threads; the table lives until the frame completes.
+    CD3DX12_GPU_DESCRIPTOR_HANDLE Table(std::initializer_list<SrvHandle> views);
+    CD3DX12_GPU_DESCRIPTOR_HANDLE Table(const std::vector<SrvHandle>& views);
+    // Tables taken from now on are released once fence has completed.
+    void BeginFrame(UINT64 fence, UINT64 completedFence);
+    std::wstring DescriptorReport()const;
+
     ID3D12Resource* GetResource(std::wstring name)const;
+    const GpuHeapAllocator& GpuMemory()const;
+    // Every resource created by name is registered in the state it was created in.
+    D3DStateTracker& StateRegistry();
+    // The tracker of the command list this thread records, bound by RecordStates();
+    // the registry when nothing is bound.
+    D3DStateTracker& States();
+    static void RecordStates(D3DStateTracker* states);
     CD3DX12_GPU_DESCRIPTOR_HANDLE GetSrv(std::wstring name)const;
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetCPUUav(std::wstring name)const;
     CD3DX12_GPU_DESCRIPTOR_HANDLE GetGPUUav(std::wstring name)const;
@@ -92,9 +147,6 @@ public:
 
 private:
     ComPtr<ID3D12Device> md3dDevice;
-    UINT NumTexSRVDescriptors;
-    UINT NumSRVDescriptors;
-    UINT NumRTVDescriptors;
     UINT mSwapChainCount;
     UINT mCurrentBackBuffer;
 
@@ -106,22 +158,108 @@ private:
 
     BOOL Swap;
 
-    std::unordered_map<std::wstring, CD3DX12_GPU_DESCRIPTOR_HANDLE> SrvList;
-    std::unordered_map<std::wstring, CD3DX12_CPU_DESCRIPTOR_HANDLE> CPUUavList;
-    std::unordered_map<std::wstring, CD3DX12_GPU_DESCRIPTOR_HANDLE> GPUUavList;
-    std::unordered_map<std::wstring, CD3DX12_CPU_DESCRIPTOR_HANDLE> DsvList;
-    std::unordered_map<std::wstring, CD3DX12_CPU_DESCRIPTOR_HANDLE> RtvList;
-    std::unordered_map<std::wstring, ComPtr<ID3D12Resource> > ResList;
+    // One descriptor heap type. Views are written to the CPU-only heap; for the
+    // shader-visible type they are copied on to the heap command lists bind.
+    // Growing makes both anew and keeps the old visible heap until the frames that
+    // may still bind it have completed.
+    struct RetiredHeap
+    {
+        ComPtr<ID3D12DescriptorHeap> Heap;
+        UINT64 Fence;
+    };
+
+    // A recreated placed resource and its range, kept until its last frame completes.
+    struct RetiredResource
+    {
+        ComPtr<ID3D12Resource> Resource;
+        GpuAllocation Alloc;
+        UINT64 Fence;
+    };
+
+    struct ViewHeap
+    {
+        D3D12_DESCRIPTOR_HEAP_TYPE Type;
+        bool ShaderVisible = false;
+        UINT Increment = 0;
+        LPCWSTR Name = nullptr;
+        std::unique_ptr<LampDescriptorAllocator> Slots;
+        // Persistent slots the heaps below were made for.
+        UINT Built = 0;
+        ComPtr<ID3D12DescriptorHeap> Cpu;
+        ComPtr<ID3D12DescriptorHeap> Gpu;
+        D3D12_CPU_DESCRIPTOR_HANDLE CpuStart = {};
+        D3D12_CPU_DESCRIPTOR_HANDLE VisibleStart = {};
+        D3D12_GPU_DESCRIPTOR_HANDLE GpuStart = {};
+        std::vector<RetiredHeap> Retired;
+    };
+
+    // Names to handle indices; a handle indexes Slots, InvalidSlot until the view is created.
+    struct ViewTable
+    {
+        std::unordered_map<std::wstring, UINT> Names;
+        std::vector<UINT> Slots;
+    };
 
-    ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap;
+    struct ResourceTable
+    {
+        std::unordered_map<std::wstring, UINT> Names;
+        std::vector<ComPtr<ID3D12Resource>> Resources;
+    };
+
+    ViewHeap mSrvHeap;
+    ViewHeap mRtvPool;
+    ViewHeap mDsvPool;
+    ViewTable mSrvViews;
+    ViewTable mUavViews;
+    ViewTable mRtvViews;
+    ViewTable mDsvViews;
+    ResourceTable mResources;
+    std::unordered_map<std::wstring, GpuAllocation> AllocList;
+    std::unordered_set<std::wstring> mKeepCommitted;
+    // Placed render targets and depth buffers not discarded yet.
+    std::vector<std::wstring> mUninitialized;
+    // Tables are taken while command lists record on several threads.
+    std::mutex mTableMutex;
+    // Fence of the frame being recorded, as passed to BeginFrame().
+    UINT64 mFrameFence = 0;
+
+    // Every resource created by name is placed in a pooled heap.
+    std::unique_ptr<GpuHeapAllocator> mGpuMemory;
+    std::vector<RetiredResource> mRetiredResources;
+    D3DStateTracker mStates;
+
+    struct TransientView
+    {
+        enum ViewType { SRV, RTV, UAV } Type;
+        ViewHeap* Heap;
+        UINT Slot;
+        bool HasDesc;
+        D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc;
+        D3D12_RENDER_TARGET_VIEW_DESC RtvDesc;
+        D3D12_UNORDERED_ACCESS_VIEW_DESC UavDesc;
+    };
+
+    struct Transient
+    {
+        TransientRequest Request;
+        bool Declared = false;
+        D3D12_RESOURCE_DESC Desc;
+        D3D12_RESOURCE_STATES State;
+        bool HasClear = false;
+        D3D12_CLEAR_VALUE Clear;
+        UINT64 Offset = 0;
+        ResourceHandle Handle;
+        std::vector<TransientView> Views;
+    };
+
+    std::unordered_map<std::wstring, Transient> mTransients;
+    ComPtr<ID3D12Heap> mTransientHeap;
+    UINT64 mTransientHeapSize = 0;
+
+    // Swap chain targets and the main depth buffer; named views live in the pools above.
     ComPtr<ID3D12DescriptorHeap> mRtvHeap;
     ComPtr<ID3D12DescriptorHeap> mDsvHeap;
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE currentCPUSRVHandle;
-    CD3DX12_GPU_DESCRIPTOR_HANDLE currentGPUSRVHandle;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE currentRTVHandle;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE currentDSVHandle;
-
     static constexpr LPCWSTR mOffscreen = L"Offscreen";
     static constexpr LPCWSTR mHistory1 = L"History1";
     static constexpr LPCWSTR mHistory2 = L"History2";
@@ -131,11 +269,47 @@ private:
 
     ComPtr<ID3D12Resource> mDepthStencilBuffer = nullptr;
 
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv1;
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv2;
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv3;
+    // Resolved once, read every frame. History1 and History2 take turns.
+    SrvHandle mNullSrv;
+    SrvHandle mSkySrv;
+    SrvHandle mOffscreenSrv;
+    RtvHandle mOffscreenRtv;
+    ResourceHandle mOffscreenRes;
+    std::array<SrvHandle, 2> mHistorySrv;
+    std::array<RtvHandle, 2> mHistoryRtv;
+    std::array<ResourceHandle, 2> mHistoryRes;
+    SrvHandle mTemp1Srv;
+    RtvHandle mTemp1Rtv;
+    ResourceHandle mTemp1Res;
+    SrvHandle mTemp2Srv;
+    RtvHandle mTemp2Rtv;
+    ResourceHandle mTemp2Res;
 
     void BuildDescriptorHeaps();
+    CD3DX12_GPU_DESCRIPTOR_HANDLE CopyTable(const SrvHandle* views, UINT count);
+    void BuildViewHeap(ViewHeap& heap, D3D12_DESCRIPTOR_HEAP_TYPE type,
+        UINT capacity, UINT ringCapacity, LPCWSTR name);
+    // (Re)creates the heaps at the allocator's capacity, carrying the persistent views over.
+    void CreateHeaps(ViewHeap& heap);
+    static UINT FindIndex(ViewTable& table, const std::wstring& name);
+    // The slot of the named view, allocated the first time it is created.
+    UINT BindSlot(ViewHeap& heap, ViewTable& table, const std::wstring& name);
+    static UINT BoundSlot(const ViewTable& table, UINT index);
+    D3D12_CPU_DESCRIPTOR_HANDLE CpuSlot(const ViewHeap& heap, UINT slot)const;
+    // Copies a slot written in the CPU-only heap to the shader-visible one.
+    void Publish(const ViewHeap& heap, UINT slot);
+    ComPtr<ID3D12Resource>& Res(const std::wstring& name);
+    bool DeferView(const std::wstring& resource, ViewHeap& heap, UINT slot,
+        const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+    bool DeferView(const std::wstring& resource, ViewHeap& heap, UINT slot,
+        const D3D12_RENDER_TARGET_VIEW_DESC* desc);
+    bool DeferView(const std::wstring& resource, ViewHeap& heap, UINT slot,
+        const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc);
+    bool DeferView(const std::wstring& resource, ViewHeap& heap, UINT slot, TransientView view);
+    void WriteView(const TransientView& view, ID3D12Resource* resource);
+    void CreatePlacedResource(std::wstring name, const D3D12_RESOURCE_DESC& desc,
+        D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state,
+        const D3D12_CLEAR_VALUE* optClear);
     void BuildOffScreenTex();
     void CreateRtvAndDsvDescriptorHeaps(
         ComPtr<ID3D12DescriptorHeap>& mRtvHeap,
@@ -1,5 +1,11 @@
 #include "./DescriptorHeap.h"
 
+namespace
+{
+    // Command lists are recorded on pool threads, each with its own tracker.
+    thread_local D3DStateTracker* gRecordingStates = nullptr;
+}
+
 
 DescriptorHeap::DescriptorHeap(ComPtr <ID3D12Device> d3dDevice,
     ComPtr<ID3D12DescriptorHeap>& RtvHeap,
@@ -14,11 +20,30 @@ DescriptorHeap::DescriptorHeap(ComPtr <ID3D12Device> d3dDevice,
     mCbvSrvUavDescriptorSize = SrvDescriptorSize;
     mRtvDescriptorSize = RtvDescriptorSize; 
     mDsvDescriptorSize = DsvDescriptorSize;
-    NumSRVDescriptors = 0;
-    NumRTVDescriptors = 0;
     mSwapChainCount = SwapChainCount;
+    mGpuMemory = std::make_unique<GpuHeapAllocator>(md3dDevice.Get());
 
     CreateRtvAndDsvDescriptorHeaps(RtvHeap, DsvHeap);
+
+    // Grown on demand; the ring holds the tables of the frames in flight.
+    BuildViewHeap(mSrvHeap, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 64, 256, L"WithoutTexture");
+    BuildViewHeap(mRtvPool, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 32, 0, L"NamedRTV");
+    BuildViewHeap(mDsvPool, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 4, 0, L"NamedDSV");
+
+    mNullSrv = FindSrv(L"NullCube");
+    mSkySrv = FindSrv(mSky);
+    mOffscreenSrv = FindSrv(mOffscreen);
+    mOffscreenRtv = FindRtv(mOffscreen);
+    mOffscreenRes = FindResource(mOffscreen);
+    mHistorySrv = { FindSrv(mHistory1), FindSrv(mHistory2) };
+    mHistoryRtv = { FindRtv(mHistory1), FindRtv(mHistory2) };
+    mHistoryRes = { FindResource(mHistory1), FindResource(mHistory2) };
+    mTemp1Srv = FindSrv(mTemp1);
+    mTemp1Rtv = FindRtv(mTemp1);
+    mTemp1Res = FindResource(mTemp1);
+    mTemp2Srv = FindSrv(mTemp2);
+    mTemp2Rtv = FindRtv(mTemp2);
+    mTemp2Res = FindResource(mTemp2);
 }
 
 void DescriptorHeap::SwapTarget()
@@ -35,7 +60,7 @@ void DescriptorHeap::UpdateSwapChain(UINT index)
 void DescriptorHeap::OutputAllSRV()
 {
     std::wstring msg;
-    for (const auto& pair : SrvList) {
+    for (const auto& pair : mSrvViews.Names) {
         msg += pair.first + L"\n";
     }
     OutputDebugString(msg.c_str());
@@ -61,16 +86,15 @@ void DescriptorHeap::CreateRtvAndDsvDescriptorHeaps(
     ComPtr<ID3D12DescriptorHeap>& DsvHeap)
 {
     D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
-    rtvHeapDesc.NumDescriptors = mSwapChainCount + 32;
+    rtvHeapDesc.NumDescriptors = mSwapChainCount;
     rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
     rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     rtvHeapDesc.NodeMask = 0;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &rtvHeapDesc, IID_PPV_ARGS(RtvHeap.GetAddressOf())));
 
-    // Add +1 DSV for shadow map.
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-    dsvHeapDesc.NumDescriptors = 2;
+    dsvHeapDesc.NumDescriptors = 1;
     dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
     dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     dsvHeapDesc.NodeMask = 0;
@@ -79,50 +103,266 @@ void DescriptorHeap::CreateRtvAndDsvDescriptorHeaps(
 
     mRtvHeap = RtvHeap;
     mDsvHeap = DsvHeap;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mRtvHeap->GetCPUDescriptorHandleForHeapStart());
-    NumRTVDescriptors = mSwapChainCount;
-    currentRTVHandle = hDescriptor.Offset(NumRTVDescriptors, mRtvDescriptorSize);
-    currentDSVHandle = mDsvHeap->GetCPUDescriptorHandleForHeapStart();
 }
 
-void DescriptorHeap::BuildDescriptorHeaps()
+void DescriptorHeap::BuildViewHeap(ViewHeap& heap, D3D12_DESCRIPTOR_HEAP_TYPE type,
+    UINT capacity, UINT ringCapacity, LPCWSTR name)
 {
-    // Create the SRV heap.
-    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    srvHeapDesc.NumDescriptors = 64;
-    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
-    mSrvDescriptorHeap->SetName(L"WithoutTexture");
-    
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-    CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-    // backBuffer
-    NumSRVDescriptors = 0;
-    currentCPUSRVHandle = hCpuDescriptor;
-    currentGPUSRVHandle = hGpuDescriptor;
-
-    std::vector<ComPtr<ID3D12Resource>> tex2DList =
+    heap.Type = type;
+    heap.ShaderVisible = type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heap.Increment = md3dDevice->GetDescriptorHandleIncrementSize(type);
+    heap.Name = name;
+    heap.Slots = std::make_unique<LampDescriptorAllocator>(capacity, ringCapacity);
+    CreateHeaps(heap);
+}
+
+void DescriptorHeap::CreateHeaps(ViewHeap& heap)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.Type = heap.Type;
+    desc.NumDescriptors = heap.Slots->Capacity() + heap.Slots->RingCapacity();
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    ComPtr<ID3D12DescriptorHeap> cpu;
+    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&cpu)));
+
+    ComPtr<ID3D12DescriptorHeap> gpu;
+    if (heap.ShaderVisible)
     {
-        mScene->TextureRes("bricksDiffuseMap"),
-        mScene->TextureRes("bricksNormalMap"),
-        mScene->TextureRes("tileDiffuseMap"),
-        mScene->TextureRes("tileNormalMap"),
-        mScene->TextureRes("defaultDiffuseMap"),
-        mScene->TextureRes("defaultNormalMap"),
-        mScene->TextureRes("TestMap0")
-    };
+        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&gpu)));
+        gpu->SetName(heap.Name);
+    }
+    else
+    {
+        cpu->SetName(heap.Name);
+    }
+
+    // Ring tables only live for their frame, so just the persistent views move.
+    if (heap.Cpu != nullptr && heap.Built > 0)
+    {
+        md3dDevice->CopyDescriptorsSimple(heap.Built, cpu->GetCPUDescriptorHandleForHeapStart(),
+            heap.CpuStart, heap.Type);
+        if (heap.ShaderVisible)
+        {
+            md3dDevice->CopyDescriptorsSimple(heap.Built, gpu->GetCPUDescriptorHandleForHeapStart(),
+                cpu->GetCPUDescriptorHandleForHeapStart(), heap.Type);
+        }
+    }
+    if (heap.Gpu != nullptr)
+        heap.Retired.push_back({ heap.Gpu, mFrameFence });
+
+    heap.Cpu = cpu;
+    heap.Gpu = gpu;
+    heap.Built = heap.Slots->Capacity();
+    heap.CpuStart = cpu->GetCPUDescriptorHandleForHeapStart();
+    if (heap.ShaderVisible)
+    {
+        heap.VisibleStart = gpu->GetCPUDescriptorHandleForHeapStart();
+        heap.GpuStart = gpu->GetGPUDescriptorHandleForHeapStart();
+    }
+
+    std::wstring msg = std::wstring(L"Descriptor heap ") + heap.Name + L": "
+        + std::to_wstring(heap.Built) + L" + " + std::to_wstring(heap.Slots->RingCapacity()) + L" ring\n";
+    OutputDebugString(msg.c_str());
+}
+
+UINT DescriptorHeap::FindIndex(ViewTable& table, const std::wstring& name)
+{
+    auto found = table.Names.find(name);
+    if (found != table.Names.end())
+        return found->second;
+    UINT index = (UINT)table.Slots.size();
+    table.Names[name] = index;
+    table.Slots.push_back(LampDescriptorAllocator::InvalidSlot);
+    return index;
+}
+
+UINT DescriptorHeap::BindSlot(ViewHeap& heap, ViewTable& table, const std::wstring& name)
+{
+    UINT index = FindIndex(table, name);
+    // Recreating a view rewrites its slot, so handles taken earlier stay valid.
+    if (table.Slots[index] == LampDescriptorAllocator::InvalidSlot)
+    {
+        table.Slots[index] = heap.Slots->Allocate();
+        if (heap.Slots->Capacity() != heap.Built)
+            CreateHeaps(heap);
+    }
+    return table.Slots[index];
+}
+
+UINT DescriptorHeap::BoundSlot(const ViewTable& table, UINT index)
+{
+    assert(index < table.Slots.size() && table.Slots[index] != LampDescriptorAllocator::InvalidSlot
+        && "Descriptor handle has no view.");
+    return table.Slots[index];
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CpuSlot(const ViewHeap& heap, UINT slot)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(heap.CpuStart, slot, heap.Increment);
+}
+
+void DescriptorHeap::Publish(const ViewHeap& heap, UINT slot)
+{
+    if (heap.ShaderVisible)
+    {
+        md3dDevice->CopyDescriptorsSimple(1, CD3DX12_CPU_DESCRIPTOR_HANDLE(heap.VisibleStart, slot, heap.Increment),
+            CpuSlot(heap, slot), heap.Type);
+    }
+}
+
+ComPtr<ID3D12Resource>& DescriptorHeap::Res(const std::wstring& name)
+{
+    return mResources.Resources[FindResource(name).Index];
+}
+
+SrvHandle DescriptorHeap::FindSrv(const std::wstring& name)
+{
+    SrvHandle handle;
+    handle.Index = FindIndex(mSrvViews, name);
+    return handle;
+}
+
+UavHandle DescriptorHeap::FindUav(const std::wstring& name)
+{
+    UavHandle handle;
+    handle.Index = FindIndex(mUavViews, name);
+    return handle;
+}
+
+RtvHandle DescriptorHeap::FindRtv(const std::wstring& name)
+{
+    RtvHandle handle;
+    handle.Index = FindIndex(mRtvViews, name);
+    return handle;
+}
+
+DsvHandle DescriptorHeap::FindDsv(const std::wstring& name)
+{
+    DsvHandle handle;
+    handle.Index = FindIndex(mDsvViews, name);
+    return handle;
+}
+
+ResourceHandle DescriptorHeap::FindResource(const std::wstring& name)
+{
+    ResourceHandle handle;
+    auto found = mResources.Names.find(name);
+    if (found != mResources.Names.end())
+    {
+        handle.Index = found->second;
+        return handle;
+    }
+    handle.Index = (UINT)mResources.Resources.size();
+    mResources.Names[name] = handle.Index;
+    mResources.Resources.push_back(nullptr);
+    return handle;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::Srv(SrvHandle handle)const
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap.GpuStart, BoundSlot(mSrvViews, handle.Index), mSrvHeap.Increment);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GpuUav(UavHandle handle)const
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap.GpuStart, BoundSlot(mUavViews, handle.Index), mSrvHeap.Increment);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CpuUav(UavHandle handle)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvHeap.CpuStart, BoundSlot(mUavViews, handle.Index), mSrvHeap.Increment);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::Rtv(RtvHandle handle)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvPool.CpuStart, BoundSlot(mRtvViews, handle.Index), mRtvPool.Increment);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::Dsv(DsvHandle handle)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvPool.CpuStart, BoundSlot(mDsvViews, handle.Index), mDsvPool.Increment);
+}
+
+ID3D12Resource* DescriptorHeap::Resource(ResourceHandle handle)const
+{
+    return mResources.Resources.at(handle.Index).Get();
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::Table(std::initializer_list<SrvHandle> views)
+{
+    return CopyTable(views.begin(), (UINT)views.size());
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::Table(const std::vector<SrvHandle>& views)
+{
+    return CopyTable(views.data(), (UINT)views.size());
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::CopyTable(const SrvHandle* views, UINT count)
+{
+    UINT start;
+    {
+        std::lock_guard<std::mutex> lock(mTableMutex);
+        start = mSrvHeap.Slots->AllocateTable(count);
+    }
+    assert(start != LampDescriptorAllocator::InvalidSlot && "Descriptor ring is full.");
+
+    for (UINT i = 0; i < count; ++i)
+    {
+        md3dDevice->CopyDescriptorsSimple(1, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvHeap.VisibleStart, start + i, mSrvHeap.Increment),
+            CpuSlot(mSrvHeap, BoundSlot(mSrvViews, views[i].Index)), mSrvHeap.Type);
+    }
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap.GpuStart, start, mSrvHeap.Increment);
+}
+
+void DescriptorHeap::BeginFrame(UINT64 fence, UINT64 completedFence)
+{
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mFrameFence = fence;
+    mSrvHeap.Slots->BeginFrame(fence, completedFence);
+    for (ViewHeap* heap : { &mSrvHeap, &mRtvPool, &mDsvPool })
+    {
+        auto& retired = heap->Retired;
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+            [&](const RetiredHeap& r) { return r.Fence <= completedFence; }), retired.end());
+    }
+    auto done = std::partition(mRetiredResources.begin(), mRetiredResources.end(),
+        [&](const RetiredResource& r) { return r.Fence > completedFence; });
+    for (auto it = done; it != mRetiredResources.end(); ++it)
+    {
+        it->Resource.Reset();
+        mGpuMemory->Free(it->Alloc);
+    }
+    mRetiredResources.erase(done, mRetiredResources.end());
+}
 
-    std::vector<std::wstring> nameList =
+std::wstring DescriptorHeap::DescriptorReport()const
+{
+    std::wstring report = L"Descriptors:\n";
+    auto line = [&](const ViewHeap& heap, const std::wstring& views)
     {
-        L"bricksDiffuseMap",
-        L"bricksNormalMap",
-        L"tileDiffuseMap",
-        L"tileNormalMap",
-        L"defaultDiffuseMap",
-        L"defaultNormalMap",
-        L"TestMap0"
+        const DescriptorStats& s = heap.Slots->Stats();
+        report += std::wstring(L"  ") + heap.Name + L": " + std::to_wstring(s.Used) + L"/" + std::to_wstring(s.Capacity)
+            + L" slots (" + views + L"), grown " + std::to_wstring(s.Grows) + L" times";
+        if (s.RingCapacity > 0)
+        {
+            report += L", ring " + std::to_wstring(s.RingUsed) + L"/" + std::to_wstring(s.RingCapacity)
+                + L" in flight, peak " + std::to_wstring(s.RingPeak) + L", " + std::to_wstring(s.RingFailures) + L" refused";
+        }
+        report += L"\n";
     };
+    line(mSrvHeap, std::to_wstring(mSrvViews.Names.size()) + L" SRV, " + std::to_wstring(mUavViews.Names.size()) + L" UAV names");
+    line(mRtvPool, std::to_wstring(mRtvViews.Names.size()) + L" names");
+    line(mDsvPool, std::to_wstring(mDsvViews.Names.size()) + L" names");
+    report += L"  " + std::to_wstring(mResources.Names.size()) + L" resource names\n";
+    return report;
+}
+
+void DescriptorHeap::BuildDescriptorHeaps()
+{
+    // The textures come first: passes bind the start of the heap as their texture table.
+    const std::vector<std::string>& table = LampGeo::TextureTable();
 
     auto skyCubeMap = mScene->TextureRes("skyCubeMap");
 
@@ -134,26 +374,24 @@ void DescriptorHeap::BuildDescriptorHeaps()
     srvDesc.Texture2D.PlaneSlice = 0;
     srvDesc.Texture2D.MipLevels = -1;
 
-    for (UINT i = 0; i < (UINT)tex2DList.size(); ++i)
+    for (auto& name : table)
     {
-        srvDesc.Format = tex2DList[i]->GetDesc().Format;
-        srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-        CreateSRV(nameList[i], tex2DList[i].Get(), &srvDesc);
+        ComPtr<ID3D12Resource> texture = mScene->TextureRes(name);
+        srvDesc.Format = texture->GetDesc().Format;
+        srvDesc.Texture2D.MipLevels = texture->GetDesc().MipLevels;
+        CreateSRV(std::wstring(name.begin(), name.end()), texture.Get(), &srvDesc);
     }
     // Sky Cubemap
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
     srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
     srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
     srvDesc.Format = skyCubeMap->GetDesc().Format;
-    mNullSrv1 = currentGPUSRVHandle;
     CreateSRV(L"NullCube", &srvDesc);
 
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = -1;
     srvDesc.Format = LDRFormat;
-    mNullSrv2 = currentGPUSRVHandle;
     CreateSRV(L"Null2D1", &srvDesc);
-    mNullSrv3 = currentGPUSRVHandle;
     CreateSRV(L"Null2D2", &srvDesc);
 
     // Last RT
@@ -193,6 +431,9 @@ void DescriptorHeap::BuildOffScreenTex()
 
     UINT mWidth = 1440;
     UINT mHeight = 810;
+    // TAA reads last frame's history before it writes this frame's.
+    KeepCommitted(mHistory1);
+    KeepCommitted(mHistory2);
     CreateCommitResource2D(mHistory1, mWidth, mHeight,
         LDRFormat, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
     CreateCommitResource2D(mHistory2, mWidth, mHeight,
@@ -209,12 +450,12 @@ void DescriptorHeap::CreateSRV(std::wstring name,
     std::wstring resource,
     D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
 {
-    auto cpuHandle = currentCPUSRVHandle;
-    SrvList[name] = currentGPUSRVHandle;
-    md3dDevice->CreateShaderResourceView(ResList[resource].Get(), desc, cpuHandle);
-    currentCPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    currentGPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    ++NumSRVDescriptors;
+    UINT slot = BindSlot(mSrvHeap, mSrvViews, name);
+    if (!DeferView(resource, mSrvHeap, slot, desc))
+    {
+        md3dDevice->CreateShaderResourceView(Res(resource).Get(), desc, CpuSlot(mSrvHeap, slot));
+        Publish(mSrvHeap, slot);
+    }
     std::wstring msg = L"SRV: " + name + L"\n";
     OutputDebugString(msg.c_str());
 }
@@ -222,26 +463,16 @@ void DescriptorHeap::CreateSRV(std::wstring name,
 void DescriptorHeap::CreateSRV(std::wstring name,
     D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
 {
-    auto cpuHandle = currentCPUSRVHandle;
-    SrvList[name] = currentGPUSRVHandle;
-    md3dDevice->CreateShaderResourceView(ResList[name].Get(), desc, cpuHandle);
-    currentCPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    currentGPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    ++NumSRVDescriptors;
-    std::wstring msg = L"SRV: " + name + L"\n";
-    OutputDebugString(msg.c_str());
+    CreateSRV(name, name, desc);
 }
 
 void DescriptorHeap::CreateSRV(std::wstring name,
     ID3D12Resource* resource,
     D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
 {
-    auto cpuHandle = currentCPUSRVHandle;
-    SrvList[name] = currentGPUSRVHandle;
-    md3dDevice->CreateShaderResourceView(resource, desc, cpuHandle);
-    currentCPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    currentGPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    ++NumSRVDescriptors;
+    UINT slot = BindSlot(mSrvHeap, mSrvViews, name);
+    md3dDevice->CreateShaderResourceView(resource, desc, CpuSlot(mSrvHeap, slot));
+    Publish(mSrvHeap, slot);
     std::wstring msg = L"SRV: " + name + L"\n";
     OutputDebugString(msg.c_str());
 }
@@ -250,9 +481,9 @@ void DescriptorHeap::CreateRTV(std::wstring name,
     std::wstring resource,
     D3D12_RENDER_TARGET_VIEW_DESC* desc)
 {
-    RtvList[name] = currentRTVHandle;
-    md3dDevice->CreateRenderTargetView(ResList[resource].Get(), desc, currentRTVHandle);
-    currentRTVHandle.Offset(NumRTVDescriptors, mRtvDescriptorSize);
+    UINT slot = BindSlot(mRtvPool, mRtvViews, name);
+    if (!DeferView(resource, mRtvPool, slot, desc))
+        md3dDevice->CreateRenderTargetView(Res(resource).Get(), desc, CpuSlot(mRtvPool, slot));
     std::wstring msg = L"RTV: " + name + L"\n";
     OutputDebugString(msg.c_str());
 }
@@ -260,29 +491,25 @@ void DescriptorHeap::CreateRTV(std::wstring name,
 void DescriptorHeap::CreateRTV(std::wstring name,
     D3D12_RENDER_TARGET_VIEW_DESC* desc)
 {
-    RtvList[name] = currentRTVHandle;
-    md3dDevice->CreateRenderTargetView(ResList[name].Get(), desc, currentRTVHandle);
-    currentRTVHandle.Offset(1, mRtvDescriptorSize);
-    std::wstring msg = L"RTV: " + name + L"\n";
-    OutputDebugString(msg.c_str());
+    CreateRTV(name, name, desc);
 }
 
 void DescriptorHeap::CreateDSV(std::wstring name,
     D3D12_DEPTH_STENCIL_VIEW_DESC* desc)
 {
-    DsvList[name] = currentDSVHandle.Offset(1, mDsvDescriptorSize);
-    md3dDevice->CreateDepthStencilView(ResList[name].Get(), desc, DsvList.at(name));
+    UINT slot = BindSlot(mDsvPool, mDsvViews, name);
+    md3dDevice->CreateDepthStencilView(Res(name).Get(), desc, CpuSlot(mDsvPool, slot));
 }
 
 void DescriptorHeap::CreateUAV(std::wstring name,
     D3D12_UNORDERED_ACCESS_VIEW_DESC* desc)
 {
-    CPUUavList[name] = currentCPUSRVHandle;
-    GPUUavList[name] = currentGPUSRVHandle;
-    md3dDevice->CreateUnorderedAccessView(ResList[name].Get(), nullptr, desc, CPUUavList[name]);
-    currentCPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    currentGPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    ++NumSRVDescriptors;
+    UINT slot = BindSlot(mSrvHeap, mUavViews, name);
+    if (!DeferView(name, mSrvHeap, slot, desc))
+    {
+        md3dDevice->CreateUnorderedAccessView(Res(name).Get(), nullptr, desc, CpuSlot(mSrvHeap, slot));
+        Publish(mSrvHeap, slot);
+    }
     std::wstring msg = L"UAV: " + name + L"\n";
     OutputDebugString(msg.c_str());
 }
@@ -290,12 +517,9 @@ void DescriptorHeap::CreateUAV(std::wstring name,
 void DescriptorHeap::CreateUAV(std::wstring name, ID3D12Resource* resource,
     D3D12_UNORDERED_ACCESS_VIEW_DESC* desc)
 {
-    CPUUavList[name] = currentCPUSRVHandle;
-    GPUUavList[name] = currentGPUSRVHandle;
-    md3dDevice->CreateUnorderedAccessView(resource, nullptr, desc, CPUUavList[name]);
-    currentCPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    currentGPUSRVHandle.Offset(1, mCbvSrvUavDescriptorSize);
-    ++NumSRVDescriptors;
+    UINT slot = BindSlot(mSrvHeap, mUavViews, name);
+    md3dDevice->CreateUnorderedAccessView(resource, nullptr, desc, CpuSlot(mSrvHeap, slot));
+    Publish(mSrvHeap, slot);
     std::wstring msg = L"UAV: " + name + L"\n";
     OutputDebugString(msg.c_str());
 }
@@ -328,13 +552,8 @@ void DescriptorHeap::CreateCommitResource2D(
     texDesc.Format = format;
     texDesc.Flags = flags;
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        &optClear,
-        IID_PPV_ARGS(&ResList[name])));
+    CreatePlacedResource(name, texDesc, D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_RESOURCE_STATE_GENERIC_READ, &optClear);
 }
 
 void DescriptorHeap::CreateCommitResource2D(std::wstring name,
@@ -356,26 +575,258 @@ void DescriptorHeap::CreateCommitResource2D(std::wstring name,
     texDesc.Format = format;
     texDesc.Flags = flags;
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        optClear,
-        IID_PPV_ARGS(&ResList[name])));
+    CreatePlacedResource(name, texDesc, D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_RESOURCE_STATE_GENERIC_READ, optClear);
 }
 
 void DescriptorHeap::CreateCommitResource(std::wstring name,
     D3D12_RESOURCE_DESC resDesc, D3D12_CLEAR_VALUE* optClear, 
     D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_RESOURCE_STATES state)
 {
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        pHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &resDesc,
-        state,
-        optClear,
-        IID_PPV_ARGS(&ResList[name])));
+    CreatePlacedResource(name, resDesc, pHeapProperties->Type, state, optClear);
+}
+
+void DescriptorHeap::CreatePlacedResource(std::wstring name,
+    const D3D12_RESOURCE_DESC& desc, D3D12_HEAP_TYPE heapType,
+    D3D12_RESOURCE_STATES state, const D3D12_CLEAR_VALUE* optClear)
+{
+    auto transient = mTransients.find(name);
+    if (transient != mTransients.end() && heapType == D3D12_HEAP_TYPE_DEFAULT &&
+        GpuHeapAllocator::Categorize(desc) == GpuMemoryCategory::RenderTarget)
+    {
+        // Placed together with the other transients by BuildTransients().
+        Transient& t = transient->second;
+        t.Declared = true;
+        t.Desc = desc;
+        t.State = state;
+        t.HasClear = optClear != nullptr;
+        if (optClear != nullptr)
+            t.Clear = *optClear;
+        return;
+    }
+
+    // Recreating a name retires the old resource; frames in flight may still
+    // use its range, so BeginFrame() hands it back once they have completed.
+    ComPtr<ID3D12Resource>& resource = Res(name);
+    auto old = AllocList.find(name);
+    if (old != AllocList.end())
+    {
+        mStates.Unregister(resource.Get());
+        mRetiredResources.push_back({ resource, old->second, mFrameFence });
+        resource.Reset();
+    }
+    GpuAllocation alloc = mKeepCommitted.count(name) != 0
+        ? mGpuMemory->CreateCommittedResource(desc, heapType, state, optClear, resource)
+        : mGpuMemory->CreateResource(desc, heapType, state, optClear, resource);
+    AllocList[name] = alloc;
+    mStates.Register(resource.Get(), state, D3DStateTracker::SubresourceCount(desc));
+    if (!alloc.Committed() && alloc.Category == GpuMemoryCategory::RenderTarget)
+        mUninitialized.push_back(name);
+}
+
+void DescriptorHeap::KeepCommitted(std::wstring name)
+{
+    mKeepCommitted.insert(name);
+}
+
+void DescriptorHeap::InitializePlaced(ID3D12GraphicsCommandList* cmdList)
+{
+    if (mUninitialized.empty())
+        return;
+
+    // Discard needs the target bound state.
+    D3DStateTracker& states = States();
+    for (auto& name : mUninitialized)
+    {
+        ID3D12Resource* resource = GetResource(name);
+        bool depth = (resource->GetDesc().Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) != 0;
+        states.Require(resource, depth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET);
+    }
+    states.Flush(cmdList);
+    for (auto& name : mUninitialized)
+        cmdList->DiscardResource(GetResource(name), nullptr);
+    mUninitialized.clear();
+}
+
+const GpuHeapAllocator& DescriptorHeap::GpuMemory()const
+{
+    return *mGpuMemory;
+}
+
+D3DStateTracker& DescriptorHeap::StateRegistry()
+{
+    return mStates;
+}
+
+D3DStateTracker& DescriptorHeap::States()
+{
+    return gRecordingStates != nullptr ? *gRecordingStates : mStates;
+}
+
+void DescriptorHeap::RecordStates(D3DStateTracker* states)
+{
+    gRecordingStates = states;
+}
+
+void DescriptorHeap::SetTransientLifetime(std::wstring name, UINT firstPass, UINT lastPass)
+{
+    Transient& t = mTransients[name];
+    t.Request.FirstPass = firstPass;
+    t.Request.LastPass = lastPass;
+}
+
+bool DescriptorHeap::DeferView(const std::wstring& resource,
+    ViewHeap& heap, UINT slot, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+    TransientView view = {};
+    view.Type = TransientView::SRV;
+    view.HasDesc = desc != nullptr;
+    if (desc != nullptr)
+        view.SrvDesc = *desc;
+    return DeferView(resource, heap, slot, view);
+}
+
+bool DescriptorHeap::DeferView(const std::wstring& resource,
+    ViewHeap& heap, UINT slot, const D3D12_RENDER_TARGET_VIEW_DESC* desc)
+{
+    TransientView view = {};
+    view.Type = TransientView::RTV;
+    view.HasDesc = desc != nullptr;
+    if (desc != nullptr)
+        view.RtvDesc = *desc;
+    return DeferView(resource, heap, slot, view);
+}
+
+bool DescriptorHeap::DeferView(const std::wstring& resource,
+    ViewHeap& heap, UINT slot, const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc)
+{
+    TransientView view = {};
+    view.Type = TransientView::UAV;
+    view.HasDesc = desc != nullptr;
+    if (desc != nullptr)
+        view.UavDesc = *desc;
+    return DeferView(resource, heap, slot, view);
+}
+
+bool DescriptorHeap::DeferView(const std::wstring& resource, ViewHeap& heap, UINT slot, TransientView view)
+{
+    auto transient = mTransients.find(resource);
+    if (transient == mTransients.end() || !transient->second.Declared)
+        return false;
+
+    view.Heap = &heap;
+    view.Slot = slot;
+    // A recreated view replaces the one written to the same slot before.
+    auto& views = transient->second.Views;
+    auto same = std::find_if(views.begin(), views.end(),
+        [&](const TransientView& v) { return v.Heap == &heap && v.Slot == slot; });
+    if (same != views.end())
+        *same = view;
+    else
+        views.push_back(view);
+
+    ID3D12Resource* res = Res(resource).Get();
+    if (res != nullptr)
+        WriteView(view, res);
+    return true;
+}
+
+void DescriptorHeap::WriteView(const TransientView& view, ID3D12Resource* resource)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = CpuSlot(*view.Heap, view.Slot);
+    switch (view.Type)
+    {
+    case TransientView::SRV:
+        md3dDevice->CreateShaderResourceView(resource, view.HasDesc ? &view.SrvDesc : nullptr, handle);
+        break;
+    case TransientView::RTV:
+        md3dDevice->CreateRenderTargetView(resource, view.HasDesc ? &view.RtvDesc : nullptr, handle);
+        break;
+    case TransientView::UAV:
+        md3dDevice->CreateUnorderedAccessView(resource, nullptr, view.HasDesc ? &view.UavDesc : nullptr, handle);
+        break;
+    }
+    Publish(*view.Heap, view.Slot);
+}
+
+void DescriptorHeap::BuildTransients()
+{
+    std::vector<std::wstring> names;
+    std::vector<TransientRequest> requests;
+    for (auto& pair : mTransients)
+    {
+        Transient& t = pair.second;
+        if (!t.Declared)
+            continue;
+        D3D12_RESOURCE_ALLOCATION_INFO info = md3dDevice->GetResourceAllocationInfo(0, 1, &t.Desc);
+        t.Request.Size = info.SizeInBytes;
+        t.Request.Alignment = info.Alignment;
+        t.Handle = FindResource(pair.first);
+        mStates.Unregister(Resource(t.Handle));
+        Res(pair.first).Reset();
+        names.push_back(pair.first);
+        requests.push_back(t.Request);
+    }
+    if (requests.empty())
+        return;
+
+    std::vector<UINT64> offsets;
+    mTransientHeapSize = LampTransientPlanner::Plan(requests, offsets);
+    mTransientHeapSize = (mTransientHeapSize + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1)
+        & ~(UINT64)(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1);
+
+    CD3DX12_HEAP_DESC heapDesc(mTransientHeapSize, D3D12_HEAP_TYPE_DEFAULT, 0,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+    mTransientHeap.Reset();
+    ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mTransientHeap)));
+
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        Transient& t = mTransients[names[i]];
+        t.Offset = offsets[i];
+        ComPtr<ID3D12Resource>& resource = Res(names[i]);
+        ThrowIfFailed(md3dDevice->CreatePlacedResource(
+            mTransientHeap.Get(),
+            t.Offset,
+            &t.Desc,
+            t.State,
+            t.HasClear ? &t.Clear : nullptr,
+            IID_PPV_ARGS(&resource)));
+        mStates.Register(resource.Get(), t.State, D3DStateTracker::SubresourceCount(t.Desc));
+        for (auto& view : t.Views)
+            WriteView(view, resource.Get());
+    }
+    OutputDebugString(TransientReport().c_str());
+}
+
+std::vector<D3D12_RESOURCE_BARRIER> DescriptorHeap::TransientBarriers(UINT framePass)const
+{
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (auto& pair : mTransients)
+    {
+        if (!pair.second.Declared || pair.second.Request.FirstPass != framePass || !pair.second.Handle.Valid())
+            continue;
+        ID3D12Resource* resource = Resource(pair.second.Handle);
+        if (resource != nullptr)
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+    }
+    return barriers;
+}
+
+std::wstring DescriptorHeap::TransientReport()const
+{
+    std::vector<TransientRequest> requests;
+    for (auto& pair : mTransients)
+    {
+        if (pair.second.Declared)
+            requests.push_back(pair.second.Request);
+    }
+    UINT64 requested = LampTransientPlanner::RequestedBytes(requests);
+    UINT64 saved = requested > mTransientHeapSize ? requested - mTransientHeapSize : 0;
+    return L"Transients: " + std::to_wstring(requests.size()) + L" targets, "
+        + std::to_wstring(requested >> 10) + L" KB requested, heap "
+        + std::to_wstring(mTransientHeapSize >> 10) + L" KB, saved "
+        + std::to_wstring(saved >> 10) + L" KB\n";
 }
 
 void DescriptorHeap::CreateCommitResource3D(std::wstring name,
@@ -397,106 +848,101 @@ void DescriptorHeap::CreateCommitResource3D(std::wstring name,
     texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     texDesc.Flags = flags;
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        optClear,
-        IID_PPV_ARGS(&ResList[name])));
+    CreatePlacedResource(name, texDesc, D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_RESOURCE_STATE_GENERIC_READ, optClear);
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::NullSrv()const
 {
-    return mNullSrv1;
+    return Srv(mNullSrv);
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrv(std::wstring name)const
 {
-    return SrvList.at(name);
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap.GpuStart, BoundSlot(mSrvViews, mSrvViews.Names.at(name)), mSrvHeap.Increment);
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetCPUUav(std::wstring name)const
 {
-    return CPUUavList.at(name);
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvHeap.CpuStart, BoundSlot(mUavViews, mUavViews.Names.at(name)), mSrvHeap.Increment);
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetGPUUav(std::wstring name)const
 {
-    return GPUUavList.at(name);
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap.GpuStart, BoundSlot(mUavViews, mUavViews.Names.at(name)), mSrvHeap.Increment);
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetRtv(std::wstring name)const
 {
-    return RtvList.at(name);
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvPool.CpuStart, BoundSlot(mRtvViews, mRtvViews.Names.at(name)), mRtvPool.Increment);
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetDsv(std::wstring name)const
 {
-    return DsvList.at(name);
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvPool.CpuStart, BoundSlot(mDsvViews, mDsvViews.Names.at(name)), mDsvPool.Increment);
 }
 
 ID3D12Resource* DescriptorHeap::GetResource(std::wstring name)const
 {
-    return ResList.at(name).Get();
+    return mResources.Resources[mResources.Names.at(name)].Get();
 }
 
 ID3D12DescriptorHeap* DescriptorHeap::CustomSRVHeap()const
 {
-    return mSrvDescriptorHeap.Get();
+    return mSrvHeap.Gpu.Get();
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::SkySrv()const
 {
-    return SrvList.at(mSky);
+    return Srv(mSkySrv);
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::OffscreenSrv()const
 {
-    return SrvList.at(mOffscreen);
+    return Srv(mOffscreenSrv);
 }
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::OffscreenRtv()const
 {
-    return RtvList.at(mOffscreen);
+    return Rtv(mOffscreenRtv);
 }
 ID3D12Resource* DescriptorHeap::Offscreen()const
 {
-    return ResList.at(mOffscreen).Get();
+    return Resource(mOffscreenRes);
 }
 ID3D12Resource* DescriptorHeap::Current()const
 {
-    return Swap ? ResList.at(mHistory1).Get() : ResList.at(mHistory2).Get();
+    return Resource(mHistoryRes[Swap ? 0 : 1]);
 }
 ID3D12Resource* DescriptorHeap::History()const
 {
-    return Swap ? ResList.at(mHistory2).Get() : ResList.at(mHistory1).Get();
+    return Resource(mHistoryRes[Swap ? 1 : 0]);
 }
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CurrentRtv()const
 {
-    return Swap ? RtvList.at(mHistory1) : RtvList.at(mHistory2);
+    return Rtv(mHistoryRtv[Swap ? 0 : 1]);
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::CurrentSrv()const
 {
-    return Swap ? SrvList.at(mHistory1) : SrvList.at(mHistory2);
+    return Srv(mHistorySrv[Swap ? 0 : 1]);
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::HistorySrv()const
 {
-    return Swap ? SrvList.at(mHistory2) : SrvList.at(mHistory1);
+    return Srv(mHistorySrv[Swap ? 1 : 0]);
 }
 ID3D12Resource* DescriptorHeap::Temp1()const
 {
-    return ResList.at(mTemp1).Get();
+    return Resource(mTemp1Res);
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::Temp1Srv()const
 {
-    return SrvList.at(mTemp1);
+    return Srv(mTemp1Srv);
 }
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::Temp1Rtv()const
 {
-    return RtvList.at(mTemp1);
+    return Rtv(mTemp1Rtv);
 }
 ID3D12Resource* DescriptorHeap::Temp2()const
 {
-    return ResList.at(mTemp2).Get();
+    return Resource(mTemp2Res);
 }
 ID3D12Resource* DescriptorHeap::depthStencilBuffer()const
 {
@@ -504,9 +950,9 @@ ID3D12Resource* DescriptorHeap::depthStencilBuffer()const
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::Temp2Srv()const
 {
-    return SrvList.at(mTemp2);
+    return Srv(mTemp2Srv);
 }
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::Temp2Rtv()const
 {
-    return RtvList.at(mTemp2);
+    return Rtv(mTemp2Rtv);
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "DirtyTracker.h"
+
+LampDirtyTracker::LampDirtyTracker(UINT numFrames)
+{
+    assert(numFrames > 0 && numFrames <= 8);
+    mQueues.resize(numFrames);
+    mAllFrames = (std::uint8_t)((1u << numFrames) - 1);
+}
+
+void LampDirtyTracker::MarkDirty(UINT index)
+{
+    if (index >= mQueued.size())
+        mQueued.resize(index + 1, 0);
+
+    std::uint8_t missing = mAllFrames & ~mQueued[index];
+    if (missing == 0)
+        return;
+
+    for (UINT f = 0; f < (UINT)mQueues.size(); ++f)
+    {
+        if (missing & (1u << f))
+            mQueues[f].push_back(index);
+    }
+    mQueued[index] |= missing;
+}
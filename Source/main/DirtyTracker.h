@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../D3D/d3dUtil.h"
+
+// Change tracking for per-frame-resource GPU copies.
+// MarkDirty() queues an index once on every frame resource's list, and the
+// update for a frame resource only visits what is on its own list, so a
+// static scene costs nothing per frame instead of a scan over every item.
+class LampDirtyTracker
+{
+public:
+    LampDirtyTracker(UINT numFrames = gNumFrameResources);
+    LampDirtyTracker(const LampDirtyTracker& rhs) = delete;
+    LampDirtyTracker& operator=(const LampDirtyTracker& rhs) = delete;
+    ~LampDirtyTracker() = default;
+
+    void MarkDirty(UINT index);
+
+    // Calls func(index) in ascending order for everything queued on the frame,
+    // so writes into the mapped buffer walk it front to back, then empties the queue.
+    template<typename Func>
+    void Flush(UINT frame, Func func)
+    {
+        std::vector<UINT>& queue = mQueues[frame];
+        std::sort(queue.begin(), queue.end());
+
+        const std::uint8_t bit = (std::uint8_t)(1u << frame);
+        for (UINT index : queue)
+        {
+            func(index);
+            mQueued[index] &= ~bit;
+        }
+        mLastFlushed = (UINT)queue.size();
+        queue.clear();
+    }
+
+    UINT PendingCount(UINT frame)const { return (UINT)mQueues[frame].size(); }
+    UINT LastFlushedCount()const { return mLastFlushed; }
+
+private:
+    std::vector<std::vector<UINT>> mQueues;
+    // One bit per frame resource whose queue already holds the index.
+    std::vector<std::uint8_t> mQueued;
+    std::uint8_t mAllFrames;
+    UINT mLastFlushed = 0;
+};
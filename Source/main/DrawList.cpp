@@ -0,0 +1,137 @@
+#include "DrawList.h"
+#include <algorithm>
+#include <chrono>
+
+bool LampDrawList::KeyFits(UINT pass, UINT pso, UINT mesh, UINT material)
+{
+    return pass <= MaxPass && pso <= MaxPso && mesh <= MaxMesh && material <= MaxMaterial;
+}
+
+UINT64 LampDrawList::MakeKey(UINT pass, UINT pso, UINT mesh, UINT material, float depth)
+{
+    pass = std::min<UINT>(pass, (UINT)MaxPass);
+    pso = std::min<UINT>(pso, (UINT)MaxPso);
+    mesh = std::min<UINT>(mesh, (UINT)MaxMesh);
+    material = std::min<UINT>(material, (UINT)MaxMaterial);
+
+    // Non-negative floats keep their order when compared as integers.
+    UINT depthBits = 0;
+    if (depth > 0.0f)
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    return ((UINT64)pass << 60)
+        | ((UINT64)pso << 50)
+        | ((UINT64)mesh << 38)
+        | ((UINT64)material << 24)
+        | (UINT64)(depthBits >> 8);
+}
+
+void LampDrawList::BeginFrame()
+{
+    mLastFrame = mFrame;
+    mFrame = DrawListStats();
+}
+
+void LampDrawList::Begin()
+{
+    mKeys.clear();
+    mCommands.clear();
+}
+
+void LampDrawList::Add(UINT pass, UINT pso, const RenderItem* ri, float depth)
+{
+    UINT material = ri->Mat ? (UINT)ri->Mat->MatCBIndex : 0;
+    if (!KeyFits(pass, pso, ri->Geo->ID, material))
+        mFrame.KeyOverflows++;
+    mKeys.push_back(MakeKey(pass, pso, ri->Geo->ID, material, depth));
+    DrawCommand cmd;
+    cmd.Item = ri;
+    cmd.Pso = pso;
+    mCommands.push_back(cmd);
+}
+
+void LampDrawList::Sort()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    RadixSort();
+    BuildCommands();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mFrame.SortMs += std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void LampDrawList::RadixSort()
+{
+    const size_t n = mKeys.size();
+    if (n < 2)
+        return;
+
+    // All eight digit histograms in one read of the keys.
+    std::vector<UINT> histograms(8 * 256, 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        UINT64 key = mKeys[i];
+        for (UINT d = 0; d < 8; ++d)
+            histograms[d * 256 + ((key >> (d * 8)) & 0xFF)]++;
+    }
+
+    mTempKeys.resize(n);
+    mTempCommands.resize(n);
+    for (UINT d = 0; d < 8; ++d)
+    {
+        UINT* count = &histograms[d * 256];
+        UINT shift = d * 8;
+
+        // Every key shares this digit, the pass would be a plain copy.
+        if (count[(mKeys[0] >> shift) & 0xFF] == n)
+            continue;
+
+        UINT offset = 0;
+        for (UINT b = 0; b < 256; ++b)
+        {
+            UINT c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            UINT dst = count[(mKeys[i] >> shift) & 0xFF]++;
+            mTempKeys[dst] = mKeys[i];
+            mTempCommands[dst] = mCommands[i];
+        }
+        std::swap(mKeys, mTempKeys);
+        std::swap(mCommands, mTempCommands);
+    }
+}
+
+void LampDrawList::BuildCommands()
+{
+    UINT binds = 0;
+
+    const RenderItem* prev = nullptr;
+    for (size_t i = 0; i < mCommands.size(); ++i)
+    {
+        const RenderItem* ri = mCommands[i].Item;
+        const UINT pso = mCommands[i].Pso;
+        UINT flags = DrawBindNone;
+        if (prev == nullptr || prev->Geo != ri->Geo)
+            flags |= DrawBindVertexBuffer | DrawBindIndexBuffer;
+        if (prev == nullptr || prev->PrimitiveType != ri->PrimitiveType)
+            flags |= DrawBindTopology;
+        if (prev == nullptr || pso != mCommands[i - 1].Pso)
+            flags |= DrawBindPipeline;
+
+        binds += ((flags & DrawBindVertexBuffer) != 0)
+            + ((flags & DrawBindIndexBuffer) != 0)
+            + ((flags & DrawBindTopology) != 0);
+        mFrame.PipelineBinds += (flags & DrawBindPipeline) != 0;
+
+        mCommands[i].Flags = flags;
+        prev = ri;
+    }
+    mFrame.Draws += (UINT)mCommands.size();
+    mFrame.BindsIssued += binds;
+    mFrame.BindsSaved += (UINT)mCommands.size() * 3 - binds;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "RenderItem.h"
+
+// Bits of state that change between two consecutive draws.
+enum DrawBindFlags : UINT
+{
+    DrawBindNone = 0,
+    DrawBindVertexBuffer = 1 << 0,
+    DrawBindIndexBuffer = 1 << 1,
+    DrawBindTopology = 1 << 2,
+    DrawBindPipeline = 1 << 3,
+};
+
+// What a draw binds comes from here; its key only orders it.
+struct DrawCommand
+{
+    const RenderItem* Item = nullptr;
+    UINT Pso = 0;
+    UINT Flags = DrawBindNone;
+};
+
+// Summed over every Sort() of a frame.
+struct DrawListStats
+{
+    UINT Draws = 0;
+    UINT BindsIssued = 0;
+    // Against the unsorted path, which sets VB, IB and topology for every item.
+    UINT BindsSaved = 0;
+    UINT PipelineBinds = 0;
+    // Draws with an id past its key field; they still draw right but may sort out of place.
+    UINT KeyOverflows = 0;
+    double SortMs = 0.0;
+};
+
+// Draw list with 64-bit sort keys, radix sorted and stripped of redundant binds.
+// Key layout, high to low bits:
+//   pass(4) | pso(10) | mesh(12) | material(14) | depth(24)
+// Mesh sits above material because the material only changes the per-object
+// constant buffer, while a new mesh costs vertex and index buffer binds.
+class LampDrawList
+{
+public:
+    LampDrawList() = default;
+    LampDrawList(const LampDrawList& rhs) = delete;
+    LampDrawList& operator=(const LampDrawList& rhs) = delete;
+    ~LampDrawList() = default;
+
+    static const UINT MaxPass = 0xF;
+    static const UINT MaxPso = 0x3FF;
+    static const UINT MaxMesh = 0xFFF;
+    static const UINT MaxMaterial = 0x3FFF;
+
+    // Ids past their fields are clamped to the field's max, so they never spill into the
+    // fields above. Depth is view space; draws behind the eye sort as depth 0.
+    static UINT64 MakeKey(UINT pass, UINT pso, UINT mesh, UINT material, float depth);
+    static bool KeyFits(UINT pass, UINT pso, UINT mesh, UINT material);
+
+    // Moves this frame's stats to Stats() and starts the next frame's.
+    void BeginFrame();
+    void Begin();
+    void Add(UINT pass, UINT pso, const RenderItem* ri, float depth = 0.0f);
+    // Radix sorts the keys and builds the command stream.
+    void Sort();
+
+    const std::vector<DrawCommand>& Commands()const { return mCommands; }
+    const std::vector<UINT64>& Keys()const { return mKeys; }
+    // Of the last whole frame.
+    const DrawListStats& Stats()const { return mLastFrame; }
+
+private:
+    void RadixSort();
+    void BuildCommands();
+
+    // Sorted along with the keys; BuildCommands() fills in the flags.
+    std::vector<UINT64> mKeys;
+    std::vector<DrawCommand> mCommands;
+    std::vector<UINT64> mTempKeys;
+    std::vector<DrawCommand> mTempCommands;
+
+    DrawListStats mFrame;
+    DrawListStats mLastFrame;
+};
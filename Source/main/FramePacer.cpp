@@ -0,0 +1,95 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+constexpr std::uint32_t LampFramePacer::MaxFramesInFlight;
+constexpr std::uint32_t LampFramePacer::HistoryLength;
+
+LampFramePacer::LampFramePacer(std::uint32_t framesInFlight)
+{
+    SetFramesInFlight(framesInFlight);
+}
+
+void LampFramePacer::SetFramesInFlight(std::uint32_t count)
+{
+    mFramesInFlight = std::min<std::uint32_t>(std::max<std::uint32_t>(count, 1u), MaxFramesInFlight);
+}
+
+std::uint32_t LampFramePacer::BeginFrame(LampFrameTimeline& timeline)
+{
+    const std::uint32_t count = mFramesInFlight;
+    double now = timeline.NowMs();
+    std::uint64_t completed = timeline.CompletedFence();
+    Retire(completed, now);
+
+    FramePacing pacing;
+    pacing.Frame = ++mFrame;
+    pacing.FramesInFlight = count;
+    pacing.GpuAhead = (std::uint32_t)mPending.size();
+
+    // Wait for the frame resource's last user, and for enough frames that count - 1 stay queued.
+    // The two differ only just after the count has changed.
+    mSlot = (mSlot + 1) % count;
+    std::uint64_t target = mSlotFences[mSlot];
+    if (mPending.size() >= count)
+        target = std::max<std::uint64_t>(target, mPending[mPending.size() - count].Fence);
+
+    if (target > completed)
+    {
+        timeline.WaitForFence(target);
+        double waited = timeline.NowMs();
+        pacing.CpuWaitMs = (float)(waited - now);
+        now = waited;
+        Retire(timeline.CompletedFence(), now);
+    }
+
+    mBeginMs = now;
+    mHistory.push_back(pacing);
+    if (mHistory.size() > HistoryLength)
+        mHistory.pop_front();
+    return mSlot;
+}
+
+void LampFramePacer::EndFrame(std::uint64_t fence)
+{
+    mSlotFences[mSlot] = fence;
+    mPending.push_back({ fence, mFrame, mBeginMs });
+}
+
+void LampFramePacer::Retire(std::uint64_t completed, double nowMs)
+{
+    while (!mPending.empty() && mPending.front().Fence <= completed)
+    {
+        const Pending& p = mPending.front();
+        if (!mHistory.empty() && p.Frame >= mHistory.front().Frame)
+            mHistory[(size_t)(p.Frame - mHistory.front().Frame)].LatencyMs = (float)(nowMs - p.BeginMs);
+        mPending.pop_front();
+    }
+}
+
+std::wstring LampFramePacer::Report()const
+{
+    float waitMs = 0.0f;
+    float maxWaitMs = 0.0f;
+    float ahead = 0.0f;
+    float latencyMs = 0.0f;
+    float maxLatencyMs = 0.0f;
+    std::uint32_t latencies = 0;
+    for (auto& f : mHistory)
+    {
+        waitMs += f.CpuWaitMs;
+        maxWaitMs = std::max<float>(maxWaitMs, f.CpuWaitMs);
+        ahead += (float)f.GpuAhead;
+        if (f.LatencyMs >= 0.0f)
+        {
+            latencyMs += f.LatencyMs;
+            maxLatencyMs = std::max<float>(maxLatencyMs, f.LatencyMs);
+            latencies++;
+        }
+    }
+    const float frames = (float)std::max<size_t>(mHistory.size(), 1);
+    return L"Frame pacing: " + std::to_wstring(mFramesInFlight) + L" frames in flight, last "
+        + std::to_wstring(mHistory.size()) + L" frames: CPU wait " + std::to_wstring(waitMs / frames)
+        + L" ms (max " + std::to_wstring(maxWaitMs) + L"), GPU ahead " + std::to_wstring(ahead / frames)
+        + L" frames, latency " + std::to_wstring(latencyMs / std::max<std::uint32_t>(latencies, 1u))
+        + L" ms (max " + std::to_wstring(maxLatencyMs) + L")\n";
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// The GPU timeline the pacer waits on: the frame fence in the app, a model in its tests.
+class LampFrameTimeline
+{
+public:
+    virtual ~LampFrameTimeline() = default;
+
+    virtual std::uint64_t CompletedFence() = 0;
+    // Blocks until fence has completed.
+    virtual void WaitForFence(std::uint64_t fence) = 0;
+    // Monotonic, in milliseconds.
+    virtual double NowMs() = 0;
+};
+
+struct FramePacing
+{
+    std::uint64_t Frame = 0;
+    std::uint32_t FramesInFlight = 0;
+    // How long BeginFrame() blocked on the GPU.
+    float CpuWaitMs = 0.0f;
+    // Frames submitted before this one that the GPU had not finished when it began.
+    std::uint32_t GpuAhead = 0;
+    // From the end of BeginFrame(), where input is read, until the frame's fence is seen
+    // complete by a later BeginFrame(). An upper bound on input to present; -1 until seen.
+    float LatencyMs = -1.0f;
+};
+
+// Decides which frame resource a frame records into and how long the CPU waits for
+// it, keeping at most FramesInFlight() frames queued on the GPU.
+class LampFramePacer
+{
+public:
+    static constexpr std::uint32_t MaxFramesInFlight = 4;
+
+    LampFramePacer(std::uint32_t framesInFlight = 3);
+    LampFramePacer(const LampFramePacer& rhs) = delete;
+    LampFramePacer& operator=(const LampFramePacer& rhs) = delete;
+    ~LampFramePacer() = default;
+
+    // Clamped to [1, MaxFramesInFlight]; applies from the next BeginFrame().
+    void SetFramesInFlight(std::uint32_t count);
+    std::uint32_t FramesInFlight()const { return mFramesInFlight; }
+
+    // Waits until the next frame resource is free and fewer than FramesInFlight()
+    // frames are queued. Returns the frame resource index, below MaxFramesInFlight.
+    std::uint32_t BeginFrame(LampFrameTimeline& timeline);
+    // fence is signalled after the frame's last submission.
+    void EndFrame(std::uint64_t fence);
+
+    // The most recent frames, oldest first.
+    const std::deque<FramePacing>& History()const { return mHistory; }
+    std::wstring Report()const;
+
+private:
+    struct Pending
+    {
+        std::uint64_t Fence;
+        std::uint64_t Frame;
+        double BeginMs;
+    };
+
+    std::uint32_t mFramesInFlight;
+    std::uint32_t mSlot = 0;
+    std::array<std::uint64_t, MaxFramesInFlight> mSlotFences = {};
+    std::uint64_t mFrame = 0;
+    double mBeginMs = 0.0;
+    // Submitted frames whose fence has not been seen complete, in submission order.
+    std::deque<Pending> mPending;
+
+    static constexpr std::uint32_t HistoryLength = 120;
+    std::deque<FramePacing> mHistory;
+
+    void Retire(std::uint64_t completed, double nowMs);
+};
@@ -0,0 +1,68 @@
+#include "FrameRecorder.h"
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+LampFrameRecorder::LampFrameRecorder(LampThreadPool& pool) : mPool(pool)
+{
+}
+
+std::uint32_t LampFrameRecorder::Add(const std::wstring& name, std::function<void(std::uint32_t)> record)
+{
+    mOrder.push_back((std::uint32_t)mLists.size());
+    mLists.push_back({ name, std::move(record) });
+    return (std::uint32_t)mLists.size() - 1;
+}
+
+void LampFrameRecorder::Record(LampCommandRecorder& recorder)
+{
+    const std::uint32_t count = (std::uint32_t)mLists.size();
+    mStats.resize(count);
+
+    auto start = Clock::now();
+    auto job = [&](std::uint32_t list, std::uint32_t thread)
+    {
+        auto t0 = Clock::now();
+        recorder.Open(list);
+        mLists[list].Record(thread);
+        recorder.Close(list);
+        auto t1 = Clock::now();
+
+        // Each job writes only its own entry.
+        mStats[list].Name = mLists[list].Name;
+        mStats[list].RecordMs = std::chrono::duration<float, std::milli>(t1 - t0).count();
+        mStats[list].Thread = thread;
+    };
+
+    mSteals = 0;
+    if (mParallel)
+    {
+        mSteals = mPool.RunJobs(count, job);
+    }
+    else
+    {
+        for (std::uint32_t list = 0; list < count; ++list)
+            job(list, 0);
+    }
+
+    recorder.Submit(mOrder);
+    mFrameMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+std::wstring LampFrameRecorder::Report()const
+{
+    float recordMs = 0.0f;
+    for (auto& s : mStats)
+        recordMs += s.RecordMs;
+
+    std::wstring report = L"Frame recorder: " + std::to_wstring(mStats.size()) + L" lists "
+        + (mParallel ? L"on " + std::to_wstring(mPool.NumThreads()) + L" threads" : std::wstring(L"serial"))
+        + L", " + std::to_wstring(mFrameMs) + L" ms to submit, " + std::to_wstring(recordMs) + L" ms recording, "
+        + std::to_wstring(mSteals) + L" stolen\n";
+    for (auto& s : mStats)
+    {
+        report += L"  " + s.Name + L": " + std::to_wstring(s.RecordMs) + L" ms on thread "
+            + std::to_wstring(s.Thread) + L"\n";
+    }
+    return report;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <string>
+
+// What the frame recorder drives: command lists on the device in the app, a log in its tests.
+class LampCommandRecorder
+{
+public:
+    virtual ~LampCommandRecorder() = default;
+
+    // Called on the recording thread around the list's record function.
+    virtual void Open(std::uint32_t list) = 0;
+    virtual void Close(std::uint32_t list) = 0;
+    // Called once per frame on the thread that called Record(), lists in submission order.
+    virtual void Submit(const std::vector<std::uint32_t>& lists) = 0;
+};
+
+struct RecordedList
+{
+    std::wstring Name;
+    // Open() to Close(), milliseconds.
+    float RecordMs = 0.0f;
+    std::uint32_t Thread = 0;
+};
+
+// Records the command lists of a frame as jobs on the thread pool and submits
+// them together, in the order they were added.
+class LampFrameRecorder
+{
+public:
+    LampFrameRecorder(LampThreadPool& pool = LampThreadPool::Default());
+    LampFrameRecorder(const LampFrameRecorder& rhs) = delete;
+    LampFrameRecorder& operator=(const LampFrameRecorder& rhs) = delete;
+    ~LampFrameRecorder() = default;
+
+    // record(thread) fills the list between Open() and Close(). Returns the list index.
+    std::uint32_t Add(const std::wstring& name, std::function<void(std::uint32_t)> record);
+    std::uint32_t ListCount()const { return (std::uint32_t)mLists.size(); }
+
+    // Records on the caller alone when parallel is false, for comparison.
+    void SetParallel(bool parallel) { mParallel = parallel; }
+    bool Parallel()const { return mParallel; }
+
+    // Blocks until every list is recorded and submitted.
+    void Record(LampCommandRecorder& recorder);
+
+    const std::vector<RecordedList>& LastFrame()const { return mStats; }
+    std::wstring Report()const;
+
+private:
+    struct List
+    {
+        std::wstring Name;
+        std::function<void(std::uint32_t)> Record;
+    };
+
+    LampThreadPool& mPool;
+    std::vector<List> mLists;
+    std::vector<std::uint32_t> mOrder;
+    bool mParallel = true;
+
+    std::vector<RecordedList> mStats;
+    float mFrameMs = 0.0f;
+    std::uint32_t mSteals = 0;
+};
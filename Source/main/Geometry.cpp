@@ -723,15 +723,50 @@ void LampGeo::LoadTextures(ID3D12GraphicsCommandList* mCommandList)
             mCommandList, texMap->Filename.c_str(),
             texMap->Resource, texMap->UploadHeap));
 
+        // The voxel bake samples them on the CPU.
+        auto cpuTexture = LampCpuTexture::LoadDDS(std::string(texMap->Filename.begin(), texMap->Filename.end()));
+        if (cpuTexture != nullptr)
+            mCpuTextures[texMap->Name] = std::move(cpuTexture);
         mTextures[texMap->Name] = std::move(texMap);
     }
 }
 
+const std::vector<std::string>& LampGeo::TextureTable()
+{
+    static const std::vector<std::string> names =
+    {
+        "bricksDiffuseMap",
+        "bricksNormalMap",
+        "tileDiffuseMap",
+        "tileNormalMap",
+        "defaultDiffuseMap",
+        "defaultNormalMap",
+        "TestMap0"
+    };
+    return names;
+}
+
+std::vector<const LampCpuTexture*> LampGeo::CpuTextures()const
+{
+    std::vector<const LampCpuTexture*> textures;
+    for (auto& name : TextureTable())
+    {
+        auto it = mCpuTextures.find(name);
+        textures.push_back(it != mCpuTextures.end() ? it->second.get() : nullptr);
+    }
+    return textures;
+}
+
 std::vector<RenderItem*>& LampGeo::RenderItems(RenderLayer layer)
 {
     return mRitemLayer[(int)layer];
 }
 
+LampInstancing& LampGeo::Instancing(RenderLayer layer)
+{
+    return mInstancing[(int)layer];
+}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> LampGeo::TextureRes(std::string name)
 {
     return mTextures[name]->Resource;
@@ -1160,6 +1195,18 @@ HRESULT LampGeo::LoadGLTF(ID3D12GraphicsCommandList* mCommandList)
             mGeometries[geo->Name] = std::move(geo);
         }
     }
+
+    // Keep the node graph; BuildTransforms() rebuilds it over the render items.
+    mModelNodes.assign(scene.nodes.size(), ModelNode());
+    for (size_t i = 0; i < scene.nodes.size(); i++)
+    {
+        const Scenes::SceneNode& node = scene.nodes[i];
+        XMStoreFloat4x4(&mModelNodes[i].Local, Scenes::LocalTransform(node));
+        if (node.instance > -1)
+            mModelNodes[i].MeshName = scene.meshes[scene.instances[node.instance].meshIndex].name;
+        for (int child : node.children)
+            mModelNodes[child].Parent = (int)i;
+    }
     {
         std::wstring msg = L"NumTextures: " + std::to_wstring(scene.textures.size());
         auto texMap = std::make_unique<Texture>();
@@ -1167,6 +1214,15 @@ HRESULT LampGeo::LoadGLTF(ID3D12GraphicsCommandList* mCommandList)
         texMap->Filename = L"TestMap0Path";
         Scenes::CreateAndUploadTexture(md3dDevice.Get(), mCommandList, texMap->Resource, texMap->UploadHeap, scene.textures[0]);
 
+        // RGBA8 rows start the texels; BC7 is left to the GPU.
+        const Scenes::NTexture& texture = scene.textures[0];
+        if (texture.format == Scenes::ETextureFormat::UNCOMPRESSED && texture.stride == 4)
+        {
+            std::vector<UINT> texels((size_t)texture.width * texture.height);
+            memcpy(texels.data(), texture.texels, texels.size() * sizeof(UINT));
+            mCpuTextures[texMap->Name] = std::make_unique<LampCpuTexture>(texture.width, texture.height, std::move(texels));
+        }
+
         mTextures[texMap->Name] = std::move(texMap);
         // msg += L"\n";
         // OutputDebugString(msg.c_str());
@@ -1182,6 +1238,157 @@ void LampGeo::LoadScene(ID3D12GraphicsCommandList* mCommandList)
     BuildShapeGeometry(mCommandList);
     BuildSkullGeometry(mCommandList);
     LoadGLTF(mCommandList);
+
+    UINT meshID = 0;
+    for (auto& geo : mGeometries)
+        geo.second->ID = meshID++;
+
     BuildMaterials();
     BuildRenderItems();
+    BuildBounds();
+    BuildTransforms();
+    BuildOctree();
+    BuildDirtyTracking();
+}
+
+void LampGeo::BuildBounds()
+{
+    for (auto& ri : mAllRitems)
+    {
+        // Only the vertices referenced by the item's index range count.
+        const BYTE* vb = (const BYTE*)ri->Geo->VertexBufferCPU->GetBufferPointer();
+        const BYTE* ib = (const BYTE*)ri->Geo->IndexBufferCPU->GetBufferPointer();
+        const UINT stride = ri->Geo->VertexByteStride;
+        const bool index16 = ri->Geo->IndexFormat == DXGI_FORMAT_R16_UINT;
+
+        XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+        XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+        for (UINT i = 0; i < ri->IndexCount; ++i)
+        {
+            UINT index = ri->StartIndexLocation + i;
+            UINT v = index16 ? ((const std::uint16_t*)ib)[index] : ((const std::uint32_t*)ib)[index];
+            XMVECTOR P = XMLoadFloat3((const XMFLOAT3*)(vb + (ri->BaseVertexLocation + v) * stride));
+            vMin = XMVectorMin(vMin, P);
+            vMax = XMVectorMax(vMax, P);
+        }
+
+        if (ri->IndexCount == 0)
+            vMin = vMax = XMVectorZero();
+
+        XMStoreFloat3(&ri->LocalBounds.Center, 0.5f * (vMin + vMax));
+        XMStoreFloat3(&ri->LocalBounds.Extents, 0.5f * (vMax - vMin));
+        ri->LocalBounds.Transform(ri->Bounds, XMLoadFloat4x4(&ri->World));
+    }
+}
+
+void LampGeo::BuildTransforms()
+{
+    mTransforms.Clear();
+
+    // Render items of each mesh, claimed by the model nodes that draw it.
+    std::unordered_map<const Mesh*, std::vector<UINT>> itemsByGeo;
+    for (size_t i = mAllRitems.size(); i-- > 0;)
+        itemsByGeo[mAllRitems[i]->Geo].push_back((UINT)i);
+    std::vector<bool> bound(mAllRitems.size(), false);
+
+    // The model hangs under one placement node, so moving that node moves the whole lantern.
+    // The glTF root turns the model half way around Y; the placement turns it back.
+    XMFLOAT4X4 placement;
+    XMStoreFloat4x4(&placement, XMMatrixRotationY(XM_PI) * XMMatrixTranslation(0.0f, 0.0f, 26.5f) * XMMatrixScaling(0.2f, 0.2f, 0.2f));
+    const UINT modelRoot = mTransforms.AddNode(LampTransforms::InvalidNode, placement);
+
+    // Walk down from the glTF roots, so parents get their handles before their children.
+    std::vector<std::vector<UINT>> children(mModelNodes.size());
+    std::vector<UINT> stack;
+    for (size_t i = 0; i < mModelNodes.size(); i++)
+    {
+        if (mModelNodes[i].Parent < 0)
+            stack.push_back((UINT)i);
+        else
+            children[mModelNodes[i].Parent].push_back((UINT)i);
+    }
+    std::vector<UINT> handles(mModelNodes.size(), LampTransforms::InvalidNode);
+    while (!stack.empty())
+    {
+        const UINT n = stack.back();
+        stack.pop_back();
+        const ModelNode& node = mModelNodes[n];
+
+        RenderItem* ri = nullptr;
+        auto geo = mGeometries.find(node.MeshName);
+        if (!node.MeshName.empty() && geo != mGeometries.end())
+        {
+            auto items = itemsByGeo.find(geo->second.get());
+            if (items != itemsByGeo.end() && !items->second.empty())
+            {
+                UINT item = items->second.back();
+                items->second.pop_back();
+                bound[item] = true;
+                ri = mAllRitems[item].get();
+            }
+        }
+
+        const UINT parent = node.Parent < 0 ? modelRoot : handles[node.Parent];
+        handles[n] = mTransforms.AddNode(parent, node.Local, ri);
+        stack.insert(stack.end(), children[n].begin(), children[n].end());
+    }
+
+    // Everything else is placed on its own.
+    for (size_t i = 0; i < mAllRitems.size(); ++i)
+    {
+        if (!bound[i])
+            mTransforms.AddNode(LampTransforms::InvalidNode, mAllRitems[i]->World, mAllRitems[i].get());
+    }
+}
+
+void LampGeo::BuildOctree()
+{
+    std::vector<RenderItem*> items = mRitemLayer[(int)RenderLayer::Opaque];
+    items.insert(items.end(), mRitemLayer[(int)RenderLayer::Wall].begin(), mRitemLayer[(int)RenderLayer::Wall].end());
+    if (items.empty())
+        return;
+
+    BoundingBox world = items[0]->Bounds;
+    for (auto ri : items)
+        BoundingBox::CreateMerged(world, world, ri->Bounds);
+    mOctree.Reset(world);
+
+    for (UINT i = 0; i < (UINT)mAllRitems.size(); ++i)
+    {
+        RenderItem* ri = mAllRitems[i].get();
+        if (std::find(items.begin(), items.end(), ri) != items.end())
+            ri->OctreeHandle = mOctree.Insert(ri->Bounds, i);
+    }
+}
+
+void LampGeo::UpdateOctree()
+{
+    // Move() only touches the tree when an item leaves its cell.
+    for (auto& ri : mAllRitems)
+    {
+        if (ri->OctreeHandle != (UINT)-1)
+            mOctree.Move(ri->OctreeHandle, ri->Bounds);
+    }
+}
+
+void LampGeo::BuildDirtyTracking()
+{
+    mItemByCBIndex.clear();
+    for (auto& ri : mAllRitems)
+    {
+        if (ri->ObjCBIndex >= mItemByCBIndex.size())
+            mItemByCBIndex.resize(ri->ObjCBIndex + 1, nullptr);
+        mItemByCBIndex[ri->ObjCBIndex] = ri.get();
+        MarkDirty(ri.get());
+    }
+
+    mMaterialByCBIndex.clear();
+    for (auto& e : mMaterials)
+    {
+        Material* mat = e.second.get();
+        if ((UINT)mat->MatCBIndex >= mMaterialByCBIndex.size())
+            mMaterialByCBIndex.resize(mat->MatCBIndex + 1, nullptr);
+        mMaterialByCBIndex[mat->MatCBIndex] = mat;
+        MarkDirty(mat);
+    }
 }
\ No newline at end of file
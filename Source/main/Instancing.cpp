@@ -0,0 +1,71 @@
+#include "Instancing.h"
+
+using namespace DirectX;
+
+bool LampInstancing::SameBatch(const RenderItem* a, const RenderItem* b)
+{
+    return a->Geo == b->Geo
+        && a->StartIndexLocation == b->StartIndexLocation
+        && a->BaseVertexLocation == b->BaseVertexLocation
+        && a->IndexCount == b->IndexCount
+        && a->PrimitiveType == b->PrimitiveType
+        && a->Mat == b->Mat;
+}
+
+bool LampInstancing::BatchLess(const RenderItem* a, const RenderItem* b)
+{
+    std::less<const void*> ptrLess;
+    if (a->Geo != b->Geo)
+        return ptrLess(a->Geo, b->Geo);
+    if (a->StartIndexLocation != b->StartIndexLocation)
+        return a->StartIndexLocation < b->StartIndexLocation;
+    if (a->BaseVertexLocation != b->BaseVertexLocation)
+        return a->BaseVertexLocation < b->BaseVertexLocation;
+    if (a->IndexCount != b->IndexCount)
+        return a->IndexCount < b->IndexCount;
+    if (a->PrimitiveType != b->PrimitiveType)
+        return a->PrimitiveType < b->PrimitiveType;
+    if (a->Mat != b->Mat)
+        return ptrLess(a->Mat, b->Mat);
+    // Keep the original order inside a batch so instance ids are stable.
+    return a->ObjCBIndex < b->ObjCBIndex;
+}
+
+void LampInstancing::Build(const std::vector<RenderItem*>& ritems, bool visibleOnly)
+{
+    mSorted.clear();
+    mBatches.clear();
+    mInstances.clear();
+
+    for (auto ri : ritems)
+    {
+        if (!visibleOnly || ri->Visible)
+            mSorted.push_back(ri);
+    }
+    std::sort(mSorted.begin(), mSorted.end(), BatchLess);
+
+    mInstances.resize(mSorted.size());
+    for (size_t i = 0; i < mSorted.size(); ++i)
+    {
+        const RenderItem* ri = mSorted[i];
+
+        if (i == 0 || !SameBatch(mSorted[i - 1], ri))
+        {
+            InstanceBatch batch;
+            batch.Geo = ri->Geo;
+            batch.Mat = ri->Mat;
+            batch.PrimitiveType = ri->PrimitiveType;
+            batch.IndexCount = ri->IndexCount;
+            batch.StartIndexLocation = ri->StartIndexLocation;
+            batch.BaseVertexLocation = ri->BaseVertexLocation;
+            batch.FirstInstance = (UINT)i;
+            mBatches.push_back(batch);
+        }
+        mBatches.back().InstanceCount++;
+
+        InstanceData& data = mInstances[i];
+        XMStoreFloat4x4(&data.World, XMMatrixTranspose(XMLoadFloat4x4(&ri->World)));
+        XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&ri->TexTransform)));
+        data.MaterialIndex = ri->Mat->MatCBIndex;
+    }
+}
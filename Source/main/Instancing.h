@@ -0,0 +1,47 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "../D3D/FrameResource.h"
+
+// One DrawIndexedInstanced call: a run of items sharing mesh, submesh and material.
+struct InstanceBatch
+{
+    Mesh* Geo = nullptr;
+    Material* Mat = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+    UINT IndexCount = 0;
+    UINT StartIndexLocation = 0;
+    int BaseVertexLocation = 0;
+
+    // Range in the instance buffer.
+    UINT FirstInstance = 0;
+    UINT InstanceCount = 0;
+};
+
+// Groups render items by Geo/submesh/Mat into instanced batches.
+// Pure CPU logic; the caller uploads Instances() and issues one draw per batch.
+class LampInstancing
+{
+public:
+    LampInstancing() = default;
+    LampInstancing(const LampInstancing& rhs) = delete;
+    LampInstancing& operator=(const LampInstancing& rhs) = delete;
+    ~LampInstancing() = default;
+
+    void Build(const std::vector<RenderItem*>& ritems, bool visibleOnly);
+
+    const std::vector<InstanceBatch>& Batches()const { return mBatches; }
+    const std::vector<InstanceData>& Instances()const { return mInstances; }
+
+    // Draw calls issued before batching, for comparison with Batches().size().
+    UINT ItemCount()const { return (UINT)mSorted.size(); }
+
+    static bool SameBatch(const RenderItem* a, const RenderItem* b);
+    static bool BatchLess(const RenderItem* a, const RenderItem* b);
+
+private:
+    std::vector<RenderItem*> mSorted;
+    std::vector<InstanceBatch> mBatches;
+    std::vector<InstanceData> mInstances;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Index into a dense table, taken once by name and kept by whoever draws with it.
+template<typename Tag>
+struct LampHandle
+{
+    std::uint32_t Index = UINT32_MAX;
+    bool Valid()const { return Index != UINT32_MAX; }
+};
+
+// Interns names into dense indices 0, 1, 2... in the order they are first seen.
+// Names are interned while the app is built; lookups by index never hash or allocate.
+template<typename Key, typename Tag>
+class LampNameTable
+{
+public:
+    typedef LampHandle<Tag> Id;
+
+    LampNameTable() = default;
+    LampNameTable(const LampNameTable& rhs) = delete;
+    LampNameTable& operator=(const LampNameTable& rhs) = delete;
+    ~LampNameTable() = default;
+
+    Id Intern(const Key& name)
+    {
+        auto it = mIndices.find(name);
+        if (it == mIndices.end())
+        {
+            it = mIndices.emplace(name, (std::uint32_t)mNames.size()).first;
+            mNames.push_back(name);
+        }
+        Id id;
+        id.Index = it->second;
+        return id;
+    }
+    // Invalid when the name was never interned.
+    Id Find(const Key& name)const
+    {
+        Id id;
+        auto it = mIndices.find(name);
+        if (it != mIndices.end())
+            id.Index = it->second;
+        return id;
+    }
+    const Key& Name(Id id)const { return mNames[id.Index]; }
+    std::uint32_t Size()const { return (std::uint32_t)mNames.size(); }
+
+private:
+    std::unordered_map<Key, std::uint32_t> mIndices;
+    std::vector<Key> mNames;
+};
+
+// Objects kept by the id of their name, as LampPSO keeps its pipelines and root
+// signatures. Find() interns and may come before the object is set; recording
+// threads look up by id or with Lookup(), and neither inserts or allocates.
+template<typename Key, typename Tag, typename Object>
+class LampNamedObjects
+{
+public:
+    typedef LampHandle<Tag> Id;
+
+    LampNamedObjects() = default;
+    LampNamedObjects(const LampNamedObjects& rhs) = delete;
+    LampNamedObjects& operator=(const LampNamedObjects& rhs) = delete;
+    ~LampNamedObjects() = default;
+
+    Id Find(const Key& name)
+    {
+        Id id = mNames.Intern(name);
+        if (id.Index == mObjects.size())
+            mObjects.emplace_back();
+        return id;
+    }
+    Object& operator[](Id id) { return mObjects[id.Index]; }
+    const Object& operator[](Id id)const { return mObjects[id.Index]; }
+    // Null when the name was never interned.
+    const Object* Lookup(const Key& name)const
+    {
+        Id id = mNames.Find(name);
+        return id.Valid() ? &mObjects[id.Index] : nullptr;
+    }
+    const Key& Name(Id id)const { return mNames.Name(id); }
+    std::uint32_t Size()const { return mNames.Size(); }
+
+private:
+    LampNameTable<Key, Tag> mNames;
+    std::vector<Object> mObjects;
+};
+
+struct PsoTag {};
+struct RootSignatureTag {};
+struct ShaderTag {};
+
+typedef LampHandle<PsoTag> PsoId;
+typedef LampHandle<RootSignatureTag> RootSignatureId;
+typedef LampHandle<ShaderTag> ShaderId;
@@ -0,0 +1,348 @@
+#include "OcclusionCulling.h"
+#include "ThreadPool.h"
+#include <chrono>
+
+using namespace DirectX;
+
+LampOcclusion::LampOcclusion(UINT width, UINT height, UINT numThreads)
+{
+    // Keep whole tiles so every row is a multiple of the 4-wide SIMD step.
+    mWidth = (width + TileSize - 1) / TileSize * TileSize;
+    mHeight = (height + TileSize - 1) / TileSize * TileSize;
+    mTilesX = mWidth / TileSize;
+    mTilesY = mHeight / TileSize;
+
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+    mNumThreads = std::max<UINT>(1u, std::min<UINT>(numThreads, 8u));
+
+    XMStoreFloat4x4(&mViewProj, XMMatrixIdentity());
+
+    mDepth.assign(mWidth * mHeight, 1.0f);
+    mTileMax.assign(mTilesX * mTilesY, 1.0f);
+}
+
+void LampOcclusion::AddOccluders(const std::vector<RenderItem*>& ritems)
+{
+    for (auto ri : ritems)
+    {
+        const BYTE* vb = (const BYTE*)ri->Geo->VertexBufferCPU->GetBufferPointer();
+        const BYTE* ib = (const BYTE*)ri->Geo->IndexBufferCPU->GetBufferPointer();
+        const UINT stride = ri->Geo->VertexByteStride;
+        const bool index16 = ri->Geo->IndexFormat == DXGI_FORMAT_R16_UINT;
+        XMMATRIX world = XMLoadFloat4x4(&ri->World);
+
+        // Whole triangles only.
+        const UINT indexCount = ri->IndexCount / 3 * 3;
+        for (UINT i = 0; i < indexCount; ++i)
+        {
+            UINT index = ri->StartIndexLocation + i;
+            UINT v = index16 ? ((const std::uint16_t*)ib)[index] : ((const std::uint32_t*)ib)[index];
+            XMVECTOR P = XMLoadFloat3((const XMFLOAT3*)(vb + (ri->BaseVertexLocation + v) * stride));
+
+            XMFLOAT3 posW;
+            XMStoreFloat3(&posW, XMVector3TransformCoord(P, world));
+            mOccluders.push_back(posW);
+        }
+    }
+    mStats.OccluderTriangles = (UINT)mOccluders.size() / 3;
+}
+
+void LampOcclusion::ClearOccluders()
+{
+    mOccluders.clear();
+    mStats.OccluderTriangles = 0;
+}
+
+void LampOcclusion::Render(FXMMATRIX viewProj)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    XMStoreFloat4x4(&mViewProj, viewProj);
+    SetupTriangles(viewProj);
+
+    // Each band owns whole tile rows, so the workers never touch the same memory.
+    UINT numBands = std::min<UINT>(mNumThreads, mTilesY);
+    LampThreadPool::Default().ParallelFor(numBands, 1, [&](UINT begin, UINT end)
+    {
+        for (UINT b = begin; b < end; ++b)
+            RasterizeBand(b * mTilesY / numBands, (b + 1) * mTilesY / numBands);
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mStats.RasterMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void LampOcclusion::SetupTriangles(FXMMATRIX viewProj)
+{
+    mClipVerts.resize(mOccluders.size());
+    if (!mOccluders.empty())
+    {
+        XMVector3TransformStream(mClipVerts.data(), sizeof(XMFLOAT4),
+            mOccluders.data(), sizeof(XMFLOAT3), mOccluders.size(), viewProj);
+    }
+
+    mTriangles.clear();
+    for (size_t t = 0; t < mClipVerts.size(); t += 3)
+    {
+        // Clipped against the near plane z = 0: what lies before it would land at depth 0
+        // and hide everything. A triangle keeps up to four corners, drawn as a fan.
+        XMFLOAT4 poly[4];
+        UINT count = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const XMFLOAT4& a = mClipVerts[t + k];
+            const XMFLOAT4& b = mClipVerts[t + (k + 1) % 3];
+            if (a.z >= 0.0f)
+                poly[count++] = a;
+            if ((a.z >= 0.0f) != (b.z >= 0.0f))
+            {
+                float s = a.z / (a.z - b.z);
+                XMStoreFloat4(&poly[count++], XMVectorLerp(XMLoadFloat4(&a), XMLoadFloat4(&b), s));
+            }
+        }
+        for (UINT k = 1; k + 1 < count; ++k)
+            SetupTriangle(poly[0], poly[k], poly[k + 1]);
+    }
+    mStats.RasterizedTriangles = (UINT)mTriangles.size();
+}
+
+void LampOcclusion::SetupTriangle(const XMFLOAT4& c0, const XMFLOAT4& c1, const XMFLOAT4& c2)
+{
+    const float W = (float)mWidth;
+    const float H = (float)mHeight;
+
+    const XMFLOAT4* corners[3] = { &c0, &c1, &c2 };
+    float x[3], y[3], z[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        const XMFLOAT4& c = *corners[k];
+        // Behind the camera; after near clipping only a degenerate projection gets here.
+        if (c.w < 1e-3f)
+            return;
+        float invW = 1.0f / c.w;
+        x[k] = (c.x * invW * 0.5f + 0.5f) * W;
+        y[k] = (0.5f - c.y * invW * 0.5f) * H;
+        z[k] = c.z * invW;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (fabsf(area) < 1e-6f)
+        return;
+
+    Triangle tri;
+    tri.MinX = std::max<int>(0, (int)floorf(std::min<float>({ x[0], x[1], x[2] })));
+    tri.MaxX = std::min<int>((int)mWidth - 1, (int)ceilf(std::max<float>({ x[0], x[1], x[2] })));
+    tri.MinY = std::max<int>(0, (int)floorf(std::min<float>({ y[0], y[1], y[2] })));
+    tri.MaxY = std::min<int>((int)mHeight - 1, (int)ceilf(std::max<float>({ y[0], y[1], y[2] })));
+    if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY || std::min<float>({ z[0], z[1], z[2] }) > 1.0f)
+        return;
+
+    // Edge i is opposite vertex i; flipping by the sign of the area accepts both windings.
+    float s = area > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        tri.EdgeA[i] = -(y[b] - y[a]) * s;
+        tri.EdgeB[i] = (x[b] - x[a]) * s;
+        tri.EdgeC[i] = ((y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a]) * s;
+    }
+
+    float invArea = 1.0f / fabsf(area);
+    tri.ZA = (tri.EdgeA[0] * z[0] + tri.EdgeA[1] * z[1] + tri.EdgeA[2] * z[2]) * invArea;
+    tri.ZB = (tri.EdgeB[0] * z[0] + tri.EdgeB[1] * z[1] + tri.EdgeB[2] * z[2]) * invArea;
+    tri.ZC = (tri.EdgeC[0] * z[0] + tri.EdgeC[1] * z[1] + tri.EdgeC[2] * z[2]) * invArea;
+
+    mTriangles.push_back(tri);
+}
+
+void LampOcclusion::RasterizeBand(UINT tileRowBegin, UINT tileRowEnd)
+{
+    int y0 = tileRowBegin * TileSize;
+    int y1 = tileRowEnd * TileSize;
+
+    std::fill(mDepth.begin() + y0 * mWidth, mDepth.begin() + y1 * mWidth, 1.0f);
+
+    for (const auto& tri : mTriangles)
+    {
+        if (tri.MaxY < y0 || tri.MinY >= y1)
+            continue;
+        RasterizeTriangle(tri, y0, y1);
+    }
+
+    BuildTileMax(tileRowBegin, tileRowEnd);
+}
+
+void LampOcclusion::RasterizeTriangle(const Triangle& tri, int y0, int y1)
+{
+    const XMVECTOR offsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+    const XMVECTOR zero = XMVectorZero();
+
+    XMVECTOR A0 = XMVectorReplicate(tri.EdgeA[0]);
+    XMVECTOR A1 = XMVectorReplicate(tri.EdgeA[1]);
+    XMVECTOR A2 = XMVectorReplicate(tri.EdgeA[2]);
+    XMVECTOR ZA = XMVectorReplicate(tri.ZA);
+
+    int rowBegin = std::max<int>(tri.MinY, y0);
+    int rowEnd = std::min<int>(tri.MaxY, y1 - 1);
+    int xBegin = tri.MinX & ~3;
+
+    for (int y = rowBegin; y <= rowEnd; ++y)
+    {
+        float py = y + 0.5f;
+        XMVECTOR C0 = XMVectorReplicate(tri.EdgeB[0] * py + tri.EdgeC[0]);
+        XMVECTOR C1 = XMVectorReplicate(tri.EdgeB[1] * py + tri.EdgeC[1]);
+        XMVECTOR C2 = XMVectorReplicate(tri.EdgeB[2] * py + tri.EdgeC[2]);
+        XMVECTOR ZRow = XMVectorReplicate(tri.ZB * py + tri.ZC);
+
+        float* row = &mDepth[y * mWidth];
+        for (int x = xBegin; x <= tri.MaxX; x += 4)
+        {
+            XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), offsets);
+
+            XMVECTOR inside = XMVectorAndInt(
+                XMVectorAndInt(
+                    XMVectorGreater(XMVectorMultiplyAdd(A0, px, C0), zero),
+                    XMVectorGreater(XMVectorMultiplyAdd(A1, px, C1), zero)),
+                XMVectorGreater(XMVectorMultiplyAdd(A2, px, C2), zero));
+            if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+                continue;
+
+            XMVECTOR z = XMVectorSaturate(XMVectorMultiplyAdd(ZA, px, ZRow));
+            XMVECTOR depth = XMLoadFloat4((const XMFLOAT4*)(row + x));
+            depth = XMVectorSelect(depth, XMVectorMin(depth, z), inside);
+            XMStoreFloat4((XMFLOAT4*)(row + x), depth);
+        }
+    }
+}
+
+void LampOcclusion::BuildTileMax(UINT tileRowBegin, UINT tileRowEnd)
+{
+    for (UINT ty = tileRowBegin; ty < tileRowEnd; ++ty)
+    {
+        for (UINT tx = 0; tx < mTilesX; ++tx)
+        {
+            XMVECTOR m = XMVectorZero();
+            for (UINT y = 0; y < TileSize; ++y)
+            {
+                const float* p = &mDepth[(ty * TileSize + y) * mWidth + tx * TileSize];
+                m = XMVectorMax(m, XMLoadFloat4((const XMFLOAT4*)p));
+                m = XMVectorMax(m, XMLoadFloat4((const XMFLOAT4*)(p + 4)));
+            }
+            m = XMVectorMax(m, XMVectorSwizzle<2, 3, 0, 1>(m));
+            m = XMVectorMax(m, XMVectorSwizzle<1, 0, 3, 2>(m));
+            mTileMax[ty * mTilesX + tx] = XMVectorGetX(m);
+        }
+    }
+}
+
+bool LampOcclusion::IsVisible(const BoundingBox& bounds)const
+{
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    XMFLOAT4 clip[BoundingBox::CORNER_COUNT];
+    bounds.GetCorners(corners);
+    XMVector3TransformStream(clip, sizeof(XMFLOAT4), corners, sizeof(XMFLOAT3),
+        BoundingBox::CORNER_COUNT, XMLoadFloat4x4(&mViewProj));
+
+    float minX = +MathHelper::Infinity, maxX = -MathHelper::Infinity;
+    float minY = +MathHelper::Infinity, maxY = -MathHelper::Infinity;
+    float minZ = +MathHelper::Infinity;
+    for (const auto& c : clip)
+    {
+        // The box straddles the near plane, so treat it as visible.
+        if (c.w < 1e-3f)
+            return true;
+
+        float invW = 1.0f / c.w;
+        float x = (c.x * invW * 0.5f + 0.5f) * mWidth;
+        float y = (0.5f - c.y * invW * 0.5f) * mHeight;
+        minX = std::min<float>(minX, x);
+        maxX = std::max<float>(maxX, x);
+        minY = std::min<float>(minY, y);
+        maxY = std::max<float>(maxY, y);
+        minZ = std::min<float>(minZ, c.z * invW);
+    }
+
+    // Outside the view frustum.
+    if (maxX < 0.0f || minX > (float)mWidth || maxY < 0.0f || minY > (float)mHeight || minZ > 1.0f)
+        return false;
+
+    int x0 = std::max<int>(0, (int)minX);
+    int x1 = std::min<int>((int)mWidth - 1, (int)maxX);
+    int y0 = std::max<int>(0, (int)minY);
+    int y1 = std::min<int>((int)mHeight - 1, (int)maxY);
+
+    for (int ty = y0 / (int)TileSize; ty <= y1 / (int)TileSize; ++ty)
+    {
+        for (int tx = x0 / (int)TileSize; tx <= x1 / (int)TileSize; ++tx)
+        {
+            // Every occluder in the tile is in front of the box.
+            if (mTileMax[ty * mTilesX + tx] < minZ)
+                continue;
+
+            // Refine on the covered part of the tile.
+            int py0 = std::max<int>(y0, ty * (int)TileSize), py1 = std::min<int>(y1, ty * (int)TileSize + (int)TileSize - 1);
+            int px0 = std::max<int>(x0, tx * (int)TileSize), px1 = std::min<int>(x1, tx * (int)TileSize + (int)TileSize - 1);
+            for (int y = py0; y <= py1; ++y)
+            {
+                for (int x = px0; x <= px1; ++x)
+                {
+                    if (mDepth[y * mWidth + x] >= minZ)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void LampOcclusion::Cull(const std::vector<RenderItem*>& ritems)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Items are tested on the workers in chunks; each writes only its own items.
+    std::atomic<UINT> culled{ 0 };
+    LampThreadPool::Default().ParallelFor((UINT)ritems.size(), 64, [&](UINT begin, UINT end)
+    {
+        UINT hidden = 0;
+        for (UINT i = begin; i < end; ++i)
+        {
+            RenderItem* ri = ritems[i];
+            ri->Visible = IsVisible(ri->Bounds);
+            if (!ri->Visible)
+                hidden++;
+        }
+        culled += hidden;
+    });
+    mStats.TestedItems = (UINT)ritems.size();
+    mStats.CulledItems = culled;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mStats.CullMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool LampOcclusion::DumpDepth(const std::string& fileName)const
+{
+    return WritePGM(fileName, mDepth, mWidth, mHeight);
+}
+
+bool LampOcclusion::DumpHiZ(const std::string& fileName)const
+{
+    return WritePGM(fileName, mTileMax, mTilesX, mTilesY);
+}
+
+bool LampOcclusion::WritePGM(const std::string& fileName, const std::vector<float>& data, UINT width, UINT height)const
+{
+    std::ofstream fout(fileName, std::ios::binary);
+    if (!fout)
+        return false;
+
+    fout << "P5\n" << width << " " << height << "\n255\n";
+    std::vector<std::uint8_t> pixels(data.size());
+    for (size_t i = 0; i < data.size(); ++i)
+        pixels[i] = (std::uint8_t)(MathHelper::Clamp(data[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    fout.write((const char*)pixels.data(), pixels.size());
+
+    return (bool)fout;
+}
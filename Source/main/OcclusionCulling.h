@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RenderItem.h"
+
+struct OcclusionStats
+{
+    UINT OccluderTriangles = 0;
+    UINT RasterizedTriangles = 0;
+    UINT TestedItems = 0;
+    UINT CulledItems = 0;
+    double RasterMs = 0.0;
+    double CullMs = 0.0;
+};
+
+// Software occlusion culling on the CPU.
+// Occluders (large walls) are rasterized into a low-res depth buffer, split in
+// horizontal bands that are filled on worker threads. Each 8x8 tile keeps the
+// farthest occluder depth, so an AABB is hidden when its nearest depth lies
+// behind every tile it covers. Depth is the D3D convention: 0 near, 1 far.
+// Occluders are clipped against the near plane; items are tested on worker threads.
+class LampOcclusion
+{
+public:
+    LampOcclusion(UINT width = 256, UINT height = 128, UINT numThreads = 0);
+    LampOcclusion(const LampOcclusion& rhs) = delete;
+    LampOcclusion& operator=(const LampOcclusion& rhs) = delete;
+    ~LampOcclusion() = default;
+
+    static const UINT TileSize = 8;
+
+    // Occluder triangles are captured in world space, so static walls are extracted once.
+    void AddOccluders(const std::vector<RenderItem*>& ritems);
+    void ClearOccluders();
+
+    void Render(DirectX::FXMMATRIX viewProj);
+    bool IsVisible(const DirectX::BoundingBox& bounds)const;
+    // Writes RenderItem::Visible for every item of the layer.
+    void Cull(const std::vector<RenderItem*>& ritems);
+
+    // Binary PGM dumps of the full-res depth and the tile max level.
+    bool DumpDepth(const std::string& fileName)const;
+    bool DumpHiZ(const std::string& fileName)const;
+
+    const std::vector<float>& Depth()const { return mDepth; }
+    const std::vector<float>& HiZ()const { return mTileMax; }
+    const OcclusionStats& Stats()const { return mStats; }
+
+    UINT Width()const { return mWidth; }
+    UINT Height()const { return mHeight; }
+
+private:
+    struct Triangle
+    {
+        // Edge functions e = A * x + B * y + C, positive inside for both windings.
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        // Depth plane z = ZA * x + ZB * y + ZC.
+        float ZA, ZB, ZC;
+        int MinX, MaxX, MinY, MaxY;
+    };
+
+    void SetupTriangles(DirectX::FXMMATRIX viewProj);
+    // Takes clip-space corners in front of the near plane.
+    void SetupTriangle(const DirectX::XMFLOAT4& c0, const DirectX::XMFLOAT4& c1, const DirectX::XMFLOAT4& c2);
+    void RasterizeBand(UINT tileRowBegin, UINT tileRowEnd);
+    void RasterizeTriangle(const Triangle& tri, int y0, int y1);
+    void BuildTileMax(UINT tileRowBegin, UINT tileRowEnd);
+    bool WritePGM(const std::string& fileName, const std::vector<float>& data, UINT width, UINT height)const;
+
+    UINT mWidth;
+    UINT mHeight;
+    UINT mTilesX;
+    UINT mTilesY;
+    UINT mNumThreads;
+
+    DirectX::XMFLOAT4X4 mViewProj;
+
+    std::vector<DirectX::XMFLOAT3> mOccluders; // 3 world-space positions per triangle
+    std::vector<DirectX::XMFLOAT4> mClipVerts;
+    std::vector<Triangle> mTriangles;
+    std::vector<float> mDepth;
+    std::vector<float> mTileMax;
+
+    OcclusionStats mStats;
+};
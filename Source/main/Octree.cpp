@@ -0,0 +1,292 @@
+#include "Octree.h"
+#include "ThreadPool.h"
+
+using namespace DirectX;
+
+void LampOctree::Reset(const BoundingBox& world, UINT maxDepth)
+{
+    mCenter = world.Center;
+    mHalfSize = std::max<float>(std::max<float>(world.Extents.x, world.Extents.y), world.Extents.z);
+    mHalfSize = std::max<float>(mHalfSize, 1e-3f);
+    // Cell coordinates are packed in 16 bits per axis.
+    mMaxDepth = std::min<UINT>(maxDepth, 16u);
+
+    mNodes.clear();
+    mFreeNodes.clear();
+    mObjects.clear();
+    mFreeObjects.clear();
+    mObjectCount = 0;
+
+    AllocNode(InvalidIndex, 0);
+}
+
+UINT64 LampOctree::Locate(const BoundingBox& bounds)const
+{
+    float x = bounds.Center.x - (mCenter.x - mHalfSize);
+    float y = bounds.Center.y - (mCenter.y - mHalfSize);
+    float z = bounds.Center.z - (mCenter.z - mHalfSize);
+    float size = 2.0f * mHalfSize;
+
+    // Centers outside the world cube live in the root, which queries never reject.
+    if (x < 0.0f || y < 0.0f || z < 0.0f || x >= size || y >= size || z >= size)
+        return 0;
+
+    // The loose box reaches half a cell past the tight one, so any object no larger
+    // than that margin fits wherever its center falls.
+    float radius = std::max<float>(std::max<float>(bounds.Extents.x, bounds.Extents.y), bounds.Extents.z);
+    UINT depth = 0;
+    float half = mHalfSize;
+    while (depth < mMaxDepth && radius <= 0.5f * half)
+    {
+        half *= 0.5f;
+        depth++;
+    }
+
+    UINT maxCell = (1u << depth) - 1;
+    float cellSize = 2.0f * half;
+    UINT64 ix = std::min<UINT>((UINT)(x / cellSize), maxCell);
+    UINT64 iy = std::min<UINT>((UINT)(y / cellSize), maxCell);
+    UINT64 iz = std::min<UINT>((UINT)(z / cellSize), maxCell);
+    return (UINT64)depth | (ix << 5) | (iy << 21) | (iz << 37);
+}
+
+UINT LampOctree::AllocNode(UINT parent, UINT childSlot)
+{
+    UINT index;
+    if (!mFreeNodes.empty())
+    {
+        index = mFreeNodes.back();
+        mFreeNodes.pop_back();
+    }
+    else
+    {
+        index = (UINT)mNodes.size();
+        mNodes.emplace_back();
+    }
+
+    // Object lists keep their capacity while a node sits in the pool.
+    Node& node = mNodes[index];
+    node.Parent = parent;
+    node.ChildSlot = childSlot;
+    node.SubtreeCount = 0;
+    node.Objects.clear();
+    for (UINT c = 0; c < 8; ++c)
+        node.Children[c] = InvalidIndex;
+
+    if (parent == InvalidIndex)
+    {
+        node.Center = mCenter;
+        node.HalfSize = mHalfSize;
+    }
+    else
+    {
+        Node& p = mNodes[parent];
+        float half = 0.5f * p.HalfSize;
+        node.HalfSize = half;
+        node.Center.x = p.Center.x + ((childSlot & 1) ? half : -half);
+        node.Center.y = p.Center.y + ((childSlot & 2) ? half : -half);
+        node.Center.z = p.Center.z + ((childSlot & 4) ? half : -half);
+        p.Children[childSlot] = index;
+    }
+    return index;
+}
+
+void LampOctree::FreeNode(UINT node)
+{
+    Node& n = mNodes[node];
+    mNodes[n.Parent].Children[n.ChildSlot] = InvalidIndex;
+    n.Parent = InvalidIndex;
+    mFreeNodes.push_back(node);
+}
+
+static UINT CellDepth(UINT64 cell) { return (UINT)(cell & 0x1F); }
+static UINT CellX(UINT64 cell) { return (UINT)((cell >> 5) & 0xFFFF); }
+static UINT CellY(UINT64 cell) { return (UINT)((cell >> 21) & 0xFFFF); }
+static UINT CellZ(UINT64 cell) { return (UINT)((cell >> 37) & 0xFFFF); }
+
+UINT LampOctree::SharedDepth(UINT64 a, UINT64 b)
+{
+    UINT da = CellDepth(a);
+    UINT db = CellDepth(b);
+    UINT depth = std::min<UINT>(da, db);
+    while (depth > 0)
+    {
+        if ((CellX(a) >> (da - depth)) == (CellX(b) >> (db - depth))
+            && (CellY(a) >> (da - depth)) == (CellY(b) >> (db - depth))
+            && (CellZ(a) >> (da - depth)) == (CellZ(b) >> (db - depth)))
+            break;
+        depth--;
+    }
+    return depth;
+}
+
+void LampOctree::Attach(UINT handle, UINT64 cell, UINT node, UINT nodeDepth)
+{
+    UINT depth = CellDepth(cell);
+    UINT ix = CellX(cell);
+    UINT iy = CellY(cell);
+    UINT iz = CellZ(cell);
+
+    for (UINT l = nodeDepth + 1; l <= depth; ++l)
+    {
+        UINT shift = depth - l;
+        UINT slot = ((ix >> shift) & 1) | (((iy >> shift) & 1) << 1) | (((iz >> shift) & 1) << 2);
+        UINT child = mNodes[node].Children[slot];
+        if (child == InvalidIndex)
+            child = AllocNode(node, slot);
+        node = child;
+        mNodes[node].SubtreeCount++;
+    }
+
+    Object& obj = mObjects[handle];
+    obj.Node = node;
+    obj.Slot = (UINT)mNodes[node].Objects.size();
+    obj.Cell = cell;
+    mNodes[node].Objects.push_back(handle);
+}
+
+UINT LampOctree::Detach(UINT handle, UINT keepDepth)
+{
+    Object& obj = mObjects[handle];
+    std::vector<UINT>& objects = mNodes[obj.Node].Objects;
+    UINT last = objects.back();
+    objects[obj.Slot] = last;
+    mObjects[last].Slot = obj.Slot;
+    objects.pop_back();
+
+    // Empty subtrees go back to the pool; their children were released before them.
+    UINT node = obj.Node;
+    for (UINT depth = CellDepth(obj.Cell); depth > keepDepth; --depth)
+    {
+        Node& n = mNodes[node];
+        UINT parent = n.Parent;
+        if (--n.SubtreeCount == 0)
+            FreeNode(node);
+        node = parent;
+    }
+    obj.Node = InvalidIndex;
+    return node;
+}
+
+UINT LampOctree::Insert(const BoundingBox& bounds, UINT value)
+{
+    if (mNodes.empty())
+        Reset(bounds);
+
+    UINT handle;
+    if (!mFreeObjects.empty())
+    {
+        handle = mFreeObjects.back();
+        mFreeObjects.pop_back();
+    }
+    else
+    {
+        handle = (UINT)mObjects.size();
+        mObjects.emplace_back();
+    }
+
+    mObjects[handle].Bounds = bounds;
+    mObjects[handle].Value = value;
+    mNodes[0].SubtreeCount++;
+    Attach(handle, Locate(bounds), 0, 0);
+    mObjectCount++;
+    return handle;
+}
+
+void LampOctree::Move(UINT handle, const BoundingBox& bounds)
+{
+    Object& obj = mObjects[handle];
+    obj.Bounds = bounds;
+
+    UINT64 cell = Locate(bounds);
+    if (cell == obj.Cell)
+        return;
+
+    // Only the part of the path below the last shared ancestor changes.
+    UINT shared = SharedDepth(obj.Cell, cell);
+    UINT ancestor = Detach(handle, shared);
+    Attach(handle, cell, ancestor, shared);
+}
+
+void LampOctree::Remove(UINT handle)
+{
+    Detach(handle, 0);
+    mNodes[0].SubtreeCount--;
+    mFreeObjects.push_back(handle);
+    mObjectCount--;
+}
+
+template<typename Shape>
+void LampOctree::QueryNode(UINT node, const Shape& shape, bool contained, std::vector<UINT>& values)const
+{
+    const Node& n = mNodes[node];
+    if (!contained && n.Parent != InvalidIndex)
+    {
+        float loose = 2.0f * n.HalfSize;
+        ContainmentType t = shape.Contains(BoundingBox(n.Center, XMFLOAT3(loose, loose, loose)));
+        if (t == DISJOINT)
+            return;
+        // Everything below a contained node is a hit without further tests.
+        contained = t == CONTAINS;
+    }
+
+    for (UINT handle : n.Objects)
+    {
+        if (contained || shape.Intersects(mObjects[handle].Bounds))
+            values.push_back(mObjects[handle].Value);
+    }
+
+    for (UINT c = 0; c < 8; ++c)
+    {
+        if (n.Children[c] != InvalidIndex)
+            QueryNode(n.Children[c], shape, contained, values);
+    }
+}
+
+template<typename Shape>
+void LampOctree::QueryBatchImpl(const std::vector<Shape>& shapes, std::vector<std::vector<UINT>>& results)const
+{
+    results.resize(shapes.size());
+    LampThreadPool::Default().ParallelFor((UINT)shapes.size(), 8, [&](UINT begin, UINT end)
+    {
+        for (UINT i = begin; i < end; ++i)
+        {
+            results[i].clear();
+            if (!mNodes.empty())
+                QueryNode(0, shapes[i], false, results[i]);
+        }
+    });
+}
+
+void LampOctree::Query(const BoundingSphere& sphere, std::vector<UINT>& values)const
+{
+    if (!mNodes.empty())
+        QueryNode(0, sphere, false, values);
+}
+
+void LampOctree::Query(const BoundingBox& box, std::vector<UINT>& values)const
+{
+    if (!mNodes.empty())
+        QueryNode(0, box, false, values);
+}
+
+void LampOctree::Query(const BoundingFrustum& frustum, std::vector<UINT>& values)const
+{
+    if (!mNodes.empty())
+        QueryNode(0, frustum, false, values);
+}
+
+void LampOctree::QueryBatch(const std::vector<BoundingSphere>& spheres, std::vector<std::vector<UINT>>& results)const
+{
+    QueryBatchImpl(spheres, results);
+}
+
+void LampOctree::QueryBatch(const std::vector<BoundingBox>& boxes, std::vector<std::vector<UINT>>& results)const
+{
+    QueryBatchImpl(boxes, results);
+}
+
+void LampOctree::QueryBatch(const std::vector<BoundingFrustum>& frustums, std::vector<std::vector<UINT>>& results)const
+{
+    QueryBatchImpl(frustums, results);
+}
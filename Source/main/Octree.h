@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../D3D/d3dUtil.h"
+
+// Loose octree over world-space AABBs with a factor-2 loose bound.
+// An object's depth follows from its size and its cell from its center, so
+// insert, move and remove only walk a fixed-length path and never search.
+// Nodes come from a pool and go back to it when their subtree empties.
+class LampOctree
+{
+public:
+    LampOctree() = default;
+    LampOctree(const LampOctree& rhs) = delete;
+    LampOctree& operator=(const LampOctree& rhs) = delete;
+    ~LampOctree() = default;
+
+    static const UINT InvalidIndex = 0xffffffff;
+
+    // Drops every object and sets the world cube enclosing the box.
+    void Reset(const DirectX::BoundingBox& world, UINT maxDepth = 8);
+
+    // Returns a stable handle; value is handed back by the queries.
+    UINT Insert(const DirectX::BoundingBox& bounds, UINT value);
+    void Move(UINT handle, const DirectX::BoundingBox& bounds);
+    void Remove(UINT handle);
+
+    // Appends the values of every object intersecting the shape.
+    void Query(const DirectX::BoundingSphere& sphere, std::vector<UINT>& values)const;
+    void Query(const DirectX::BoundingBox& box, std::vector<UINT>& values)const;
+    void Query(const DirectX::BoundingFrustum& frustum, std::vector<UINT>& values)const;
+
+    // One result list per shape, spread over the thread pool.
+    void QueryBatch(const std::vector<DirectX::BoundingSphere>& spheres, std::vector<std::vector<UINT>>& results)const;
+    void QueryBatch(const std::vector<DirectX::BoundingBox>& boxes, std::vector<std::vector<UINT>>& results)const;
+    void QueryBatch(const std::vector<DirectX::BoundingFrustum>& frustums, std::vector<std::vector<UINT>>& results)const;
+
+    UINT ObjectCount()const { return mObjectCount; }
+    UINT NodeCount()const { return (UINT)(mNodes.size() - mFreeNodes.size()); }
+    UINT PooledNodeCount()const { return (UINT)mNodes.size(); }
+
+private:
+    struct Node
+    {
+        DirectX::XMFLOAT3 Center;
+        float HalfSize = 0.0f; // tight half size; the loose box is twice as large
+        UINT Parent = InvalidIndex;
+        UINT ChildSlot = 0;
+        UINT Children[8];
+        UINT SubtreeCount = 0;
+        std::vector<UINT> Objects;
+    };
+
+    struct Object
+    {
+        DirectX::BoundingBox Bounds;
+        UINT Value = 0;
+        UINT Node = InvalidIndex;
+        UINT Slot = 0;
+        UINT64 Cell = 0; // depth and cell coordinates the object was filed under
+    };
+
+    UINT64 Locate(const DirectX::BoundingBox& bounds)const;
+    static UINT SharedDepth(UINT64 a, UINT64 b);
+    // Files the object under cell, walking down from node at nodeDepth on the cell's path.
+    void Attach(UINT handle, UINT64 cell, UINT node, UINT nodeDepth);
+    // Takes the object out of its node and releases the path below keepDepth; returns the ancestor there.
+    UINT Detach(UINT handle, UINT keepDepth);
+    UINT AllocNode(UINT parent, UINT childSlot);
+    void FreeNode(UINT node);
+
+    template<typename Shape>
+    void QueryNode(UINT node, const Shape& shape, bool contained, std::vector<UINT>& values)const;
+    template<typename Shape>
+    void QueryBatchImpl(const std::vector<Shape>& shapes, std::vector<std::vector<UINT>>& results)const;
+
+    DirectX::XMFLOAT3 mCenter = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    float mHalfSize = 1.0f;
+    UINT mMaxDepth = 8;
+
+    std::vector<Node> mNodes;
+    std::vector<UINT> mFreeNodes;
+    std::vector<Object> mObjects;
+    std::vector<UINT> mFreeObjects;
+    UINT mObjectCount = 0;
+};
@@ -1,10 +1,19 @@
 #include "PSO.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // Shaders\cache is made by LampShader.
+    const char* PipelineCachePath = "Shaders\\cache\\pipelines.bin";
+}
 
 LampPSO::LampPSO(Microsoft::WRL::ComPtr<ID3D12Device> d3dDevice, bool msaa, UINT msaaQuality)
 {
 	md3dDevice = d3dDevice;
     mRootSig = std::make_unique<LampRootSignature>(d3dDevice);
     mShader = std::make_unique<LampShader>(d3dDevice);
+    mPipelineCache.Load(PipelineCachePath);
     m4xMsaaState = msaa;
     m4xMsaaQuality = msaaQuality;
     mInputLayout =
@@ -121,16 +130,149 @@ void LampPSO::BuildPSOs()
 
 }
 
-void LampPSO::BuildPSO(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, std::wstring name)
+LampPSO::~LampPSO()
+{
+    if (mPipelineCache.Dirty())
+        mPipelineCache.Save(PipelineCachePath);
+}
+
+void LampPSO::BuildPSO(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, std::wstring name, PipelineShaders shaders)
+{
+    const UINT64 key = LampPipelineKey::Graphics(desc, mRootSig->Key(desc.pRootSignature));
+    const PsoId id = FindPSO(name);
+    mSources[id.Index].Built = true;
+    mSources[id.Index].Compute = false;
+    mSources[id.Index].Graphics = desc;
+    mSources[id.Index].Shaders = shaders;
+    mPSOs[id] = CreatePipeline(key, name, [&](D3D12_CACHED_PIPELINE_STATE cached, ID3D12PipelineState** pso)
+    {
+        desc.CachedPSO = cached;
+        return md3dDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pso));
+    });
+}
+
+void LampPSO::BuildPSO(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, std::wstring name, PipelineShaders shaders)
+{
+    const UINT64 key = LampPipelineKey::Compute(desc, mRootSig->Key(desc.pRootSignature));
+    const PsoId id = FindPSO(name);
+    mSources[id.Index].Built = true;
+    mSources[id.Index].Compute = true;
+    mSources[id.Index].ComputeDesc = desc;
+    mSources[id.Index].Shaders = shaders;
+    mPSOs[id] = CreatePipeline(key, name, [&](D3D12_CACHED_PIPELINE_STATE cached, ID3D12PipelineState** pso)
+    {
+        desc.CachedPSO = cached;
+        return md3dDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(pso));
+    });
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> LampPSO::CreatePipeline(UINT64 key, const std::wstring& name,
+    const std::function<HRESULT(D3D12_CACHED_PIPELINE_STATE, ID3D12PipelineState**)>& create)
 {
-    ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&mPSOs[name])));
-    mPSOs[name]->SetName(name.c_str());
+    auto shared = mByKey.find(key);
+    if (shared != mByKey.end())
+    {
+        mShared++;
+        return shared->second;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> pso;
+    const std::vector<BYTE>* blob = mPipelineCache.Find(key);
+    if (blob != nullptr)
+    {
+        // Refused after a driver update or on another adapter.
+        if (SUCCEEDED(create({ blob->data(), blob->size() }, pso.GetAddressOf())))
+        {
+            mFromCache++;
+        }
+        else
+        {
+            mPipelineCache.Remove(key);
+            mRejected++;
+            pso.Reset();
+        }
+    }
+    if (pso == nullptr)
+    {
+        ThrowIfFailed(create({ nullptr, 0 }, pso.GetAddressOf()));
+        mCompiled++;
+
+        Microsoft::WRL::ComPtr<ID3DBlob> cached;
+        if (SUCCEEDED(pso->GetCachedBlob(cached.GetAddressOf())))
+            mPipelineCache.Store(key, cached->GetBufferPointer(), cached->GetBufferSize());
+    }
+    mBuildMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+    pso->SetName(name.c_str());
+    mByKey[key] = pso;
+    return pso;
 }
 
-void LampPSO::BuildPSO(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, std::wstring name)
+D3D12_SHADER_BYTECODE LampPSO::Bytecode(ShaderId id)const
 {
-    ThrowIfFailed(md3dDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(&mPSOs[name])));
-    mPSOs[name]->SetName(name.c_str());
+    if (!id.Valid())
+        return { nullptr, 0 };
+    return { mShader->GetShader(id), mShader->GetSize(id) };
+}
+
+UINT LampPSO::ApplyShaderReloads()
+{
+    std::vector<ShaderId> swapped = mShader->ApplyReloads();
+    if (swapped.empty())
+        return 0;
+    auto uses = [&](ShaderId stage)
+    {
+        return stage.Valid() && std::any_of(swapped.begin(), swapped.end(), [&](ShaderId s) { return s.Index == stage.Index; });
+    };
+
+    UINT rebuilt = 0;
+    for (UINT i = 0; i < (UINT)mSources.size(); ++i)
+    {
+        PipelineSource source = mSources[i];
+        const PipelineShaders& s = source.Shaders;
+        if (!source.Built || !(uses(s.VS) || uses(s.GS) || uses(s.PS) || uses(s.CS)))
+            continue;
+
+        PsoId id;
+        id.Index = i;
+        try
+        {
+            // Every stage again: the bytecode of the others may have moved as well.
+            if (source.Compute)
+            {
+                source.ComputeDesc.CS = Bytecode(s.CS);
+                BuildPSO(source.ComputeDesc, mPSOs.Name(id), s);
+            }
+            else
+            {
+                source.Graphics.VS = Bytecode(s.VS);
+                source.Graphics.GS = Bytecode(s.GS);
+                source.Graphics.PS = Bytecode(s.PS);
+                BuildPSO(source.Graphics, mPSOs.Name(id), s);
+            }
+            rebuilt++;
+        }
+        catch (DxException& e)
+        {
+            // Usually a shader that no longer matches its root signature; the old pipeline stays.
+            OutputDebugString((L"Pipeline " + mPSOs.Name(id) + L" not rebuilt: " + e.ToString() + L"\n").c_str());
+        }
+    }
+    mRebuilt += rebuilt;
+    OutputDebugString((L"Hot reload: " + std::to_wstring(swapped.size()) + L" shaders, "
+        + std::to_wstring(rebuilt) + L" pipelines rebuilt\n").c_str());
+    return rebuilt;
+}
+
+std::wstring LampPSO::PipelineReport()const
+{
+    return L"Pipelines: " + std::to_wstring(mCompiled) + L" compiled, " + std::to_wstring(mFromCache)
+        + L" from the cache (" + std::to_wstring(mRejected) + L" refused), " + std::to_wstring(mShared)
+        + L" names sharing one, " + std::to_wstring(mRebuilt) + L" rebuilt after a shader reload, "
+        + std::to_wstring(mBuildMs) + L" ms; root signatures: "
+        + std::to_wstring(mRootSig->CreatedCount()) + L" created, " + std::to_wstring(mRootSig->SharedCount())
+        + L" names sharing one\n";
 }
 
 // postProcess
@@ -176,7 +318,7 @@ void LampPSO::BuildGraphicsPSO(
     mPsoDesc.SampleDesc.Count = 1;
     mPsoDesc.SampleDesc.Quality = 0;
 
-    BuildPSO(mPsoDesc, name);
+    BuildPSO(mPsoDesc, name, { mShader->FindShader(FullScreenVSName), ShaderId(), mShader->FindShader(ShaderPS), ShaderId() });
 }
 
 void LampPSO::BuildGraphicsPSO(
@@ -226,7 +368,7 @@ void LampPSO::BuildGraphicsPSO(
     mPsoDesc.SampleDesc.Count = 1;
     mPsoDesc.SampleDesc.Quality = 0;
 
-    BuildPSO(mPsoDesc, name);
+    BuildPSO(mPsoDesc, name, { mShader->FindShader(ShaderVS), ShaderId(), mShader->FindShader(ShaderPS), ShaderId() });
 }
 
 void LampPSO::BuildGraphicsPSO(
@@ -282,7 +424,7 @@ void LampPSO::BuildGraphicsPSO(
     mPsoDesc.SampleDesc.Count = 1;
     mPsoDesc.SampleDesc.Quality = 0;
 
-    BuildPSO(mPsoDesc, name);
+    BuildPSO(mPsoDesc, name, { mShader->FindShader(ShaderVS), ShaderId(), mShader->FindShader(ShaderPS), ShaderId() });
 }
 
 void LampPSO::BuildGraphicsPSO(
@@ -331,7 +473,7 @@ void LampPSO::BuildGraphicsPSO(
     mPsoDesc.SampleDesc.Count = 1;
     mPsoDesc.SampleDesc.Quality = 0;
 
-    BuildPSO(mPsoDesc, name);
+    BuildPSO(mPsoDesc, name, { mShader->FindShader(ShaderVS), mShader->FindShader(ShaderGS), mShader->FindShader(ShaderPS), ShaderId() });
 }
 
 void LampPSO::BuildComputePSO(
@@ -349,14 +491,41 @@ void LampPSO::BuildComputePSO(
     };
     mPSODesc.Flags = Flags;
 
-    BuildPSO(mPSODesc, name);
+    BuildPSO(mPSODesc, name, { ShaderId(), ShaderId(), ShaderId(), mShader->FindShader(ShaderCS) });
 }
 
-ID3D12PipelineState* LampPSO::GetPSO(std::wstring name)
+PsoId LampPSO::FindPSO(const std::wstring& name)
 {
-    return mPSOs[name].Get();
+    PsoId id = mPSOs.Find(name);
+    if (id.Index == mSources.size())
+        mSources.emplace_back();
+    return id;
 }
-ID3D12RootSignature* LampPSO::GetRootSignature(std::wstring name)
+
+RootSignatureId LampPSO::FindRootSignature(const std::wstring& name)
+{
+    return mRootSig->FindRootSignature(name);
+}
+
+ID3D12PipelineState* LampPSO::GetPSO(PsoId id)const
+{
+    assert(id.Valid());
+    return mPSOs[id].Get();
+}
+
+ID3D12RootSignature* LampPSO::GetRootSignature(RootSignatureId id)const
+{
+    return mRootSig->GetRootSignature(id);
+}
+
+ID3D12PipelineState* LampPSO::GetPSO(const std::wstring& name)const
+{
+    // Command lists are recorded on several threads; a lookup must never insert.
+    auto pso = mPSOs.Lookup(name);
+    return pso != nullptr ? pso->Get() : nullptr;
+}
+
+ID3D12RootSignature* LampPSO::GetRootSignature(const std::wstring& name)const
 {
     return mRootSig->GetRootSignature(name);
 }
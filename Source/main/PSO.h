@@ -10,7 +10,8 @@ public:
     LampPSO(Microsoft::WRL::ComPtr <ID3D12Device> d3dDevice, bool msaa, UINT msaaQuality);
     LampPSO(const LampPSO& rhs) = delete;
     LampPSO& operator=(const LampPSO& rhs) = delete;
-    ~LampPSO() = default;
+    // Writes the pipeline cache back when pipelines were compiled.
+    ~LampPSO();
 
     void BuildGraphicsPSO(
             std::wstring name,
@@ -63,8 +64,29 @@ public:
         std::string ShaderCS,
         D3D12_PIPELINE_STATE_FLAGS Flags = D3D12_PIPELINE_STATE_FLAG_NONE);
 
-    ID3D12PipelineState* GetPSO(std::wstring name);
-    ID3D12RootSignature* GetRootSignature(std::wstring name);
+    // Ids are interned while passes are built, before or after the PSO is;
+    // recording threads only index with them.
+    PsoId FindPSO(const std::wstring& name);
+    RootSignatureId FindRootSignature(const std::wstring& name);
+    ID3D12PipelineState* GetPSO(PsoId id)const;
+    ID3D12RootSignature* GetRootSignature(RootSignatureId id)const;
+    ID3D12PipelineState* GetPSO(const std::wstring& name)const;
+    ID3D12RootSignature* GetRootSignature(const std::wstring& name)const;
+
+    // Hot reload, called between frames while nothing records: rebuilds the pipelines whose
+    // shaders were swapped. The old pipelines stay alive in mByKey for the frames still in flight.
+    UINT ApplyShaderReloads();
+
+    // A pass asks for its shader specialized on the scene's lights before building its PSO with it.
+    std::string AddLightPermutation(const std::string& name, const std::string& shader, const LampLightCounts& lights)
+    {
+        return mShader->AddLightPermutation(name, shader, lights);
+    }
+
+    // Which shaders were loaded so far, and from where.
+    std::wstring ShaderReport()const { return mShader->Report(); }
+    // Pipelines compiled, read from the cache or shared, and root signatures shared.
+    std::wstring PipelineReport()const;
 
     void CreateRootSignature(D3D12_ROOT_SIGNATURE_DESC rootSigDesc, std::wstring name);
     std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
@@ -72,10 +94,41 @@ public:
 
 private:
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
-    std::unordered_map<std::wstring, Microsoft::WRL::ComPtr<ID3D12PipelineState>> mPSOs;
+    LampNamedObjects<std::wstring, PsoTag, Microsoft::WRL::ComPtr<ID3D12PipelineState>> mPSOs;
+
+    // What each pipeline was built from, to build it again when a shader is reloaded.
+    struct PipelineShaders
+    {
+        ShaderId VS, GS, PS, CS;
+    };
+    struct PipelineSource
+    {
+        bool Built = false;
+        bool Compute = false;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Graphics = {};
+        D3D12_COMPUTE_PIPELINE_STATE_DESC ComputeDesc = {};
+        PipelineShaders Shaders;
+    };
+    // Indexed by PsoId.
+    std::vector<PipelineSource> mSources;
 
     std::unique_ptr<LampRootSignature> mRootSig;
     std::unique_ptr<LampShader> mShader;
+
+    // Names with equal descriptions share one pipeline; the driver's blobs of
+    // those compiled are kept across runs.
+    std::unordered_map<UINT64, Microsoft::WRL::ComPtr<ID3D12PipelineState>> mByKey;
+    LampPipelineCache mPipelineCache;
+    UINT mCompiled = 0;
+    UINT mFromCache = 0;
+    UINT mRejected = 0;
+    UINT mShared = 0;
+    UINT mRebuilt = 0;
+    float mBuildMs = 0.0f;
+
+    // create is called with the cached blob, if any, then without it if the driver refuses that.
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipeline(UINT64 key, const std::wstring& name,
+        const std::function<HRESULT(D3D12_CACHED_PIPELINE_STATE, ID3D12PipelineState**)>& create);
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
     static const DXGI_FORMAT mDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
@@ -88,6 +141,7 @@ private:
     UINT m4xMsaaQuality;
 
     void BuildPSOs();
-    void BuildPSO(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, std::wstring name);
-    void BuildPSO(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, std::wstring name);
+    void BuildPSO(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, std::wstring name, PipelineShaders shaders);
+    void BuildPSO(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, std::wstring name, PipelineShaders shaders);
+    D3D12_SHADER_BYTECODE Bytecode(ShaderId id)const;
 };
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "PipelineCache.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+constexpr std::uint32_t LampPipelineCache::Magic;
+constexpr std::uint32_t LampPipelineCache::Version;
+
+void LampHashStream::Bytes(const void* data, std::size_t size)
+{
+    auto bytes = static_cast<const std::uint8_t*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        mHash ^= bytes[i];
+        mHash *= 1099511628211ull;
+    }
+}
+
+void LampHashStream::String(const char* text)
+{
+    // Length first, so "AB"+"C" and "A"+"BC" differ.
+    const std::size_t length = text != nullptr ? std::strlen(text) : 0;
+    Value((std::uint64_t)length);
+    Bytes(text, length);
+}
+
+const std::vector<std::uint8_t>* LampPipelineCache::Find(std::uint64_t key)const
+{
+    auto found = mBlobs.find(key);
+    return found != mBlobs.end() ? &found->second : nullptr;
+}
+
+void LampPipelineCache::Store(std::uint64_t key, const void* data, std::size_t size)
+{
+    auto bytes = static_cast<const std::uint8_t*>(data);
+    mBlobs[key].assign(bytes, bytes + size);
+    mDirty = true;
+}
+
+void LampPipelineCache::Remove(std::uint64_t key)
+{
+    mDirty |= mBlobs.erase(key) != 0;
+}
+
+namespace
+{
+    struct CacheHeader
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        std::uint32_t Count;
+        std::uint32_t Reserved;
+    };
+
+    struct CacheEntry
+    {
+        std::uint64_t Key;
+        std::uint64_t Size;
+    };
+
+    std::size_t Align8(std::size_t size)
+    {
+        return (size + 7) & ~(std::size_t)7;
+    }
+}
+
+std::vector<std::uint8_t> LampPipelineCache::Serialize()const
+{
+    // Sorted by key, so the same contents always write the same file.
+    std::vector<std::uint64_t> keys;
+    for (auto& b : mBlobs)
+        keys.push_back(b.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<std::uint8_t> data(sizeof(CacheHeader));
+    CacheHeader header = { Magic, Version, (std::uint32_t)keys.size(), 0 };
+    std::memcpy(data.data(), &header, sizeof(header));
+    for (std::uint64_t key : keys)
+    {
+        const std::vector<std::uint8_t>& blob = mBlobs.at(key);
+        CacheEntry entry = { key, blob.size() };
+        std::size_t offset = data.size();
+        data.resize(offset + sizeof(entry) + Align8(blob.size()), 0);
+        std::memcpy(&data[offset], &entry, sizeof(entry));
+        if (!blob.empty())
+            std::memcpy(&data[offset + sizeof(entry)], blob.data(), blob.size());
+    }
+    return data;
+}
+
+bool LampPipelineCache::Deserialize(const std::uint8_t* data, std::size_t size)
+{
+    mBlobs.clear();
+    mDirty = false;
+
+    CacheHeader header;
+    if (data == nullptr || size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.Magic != Magic || header.Version != Version)
+        return false;
+
+    std::unordered_map<std::uint64_t, std::vector<std::uint8_t>> blobs;
+    std::size_t offset = sizeof(header);
+    for (std::uint32_t i = 0; i < header.Count; ++i)
+    {
+        CacheEntry entry;
+        if (size - offset < sizeof(entry))
+            return false;
+        std::memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.Size > size - offset || Align8((std::size_t)entry.Size) > size - offset)
+            return false;
+        blobs[entry.Key].assign(data + offset, data + offset + entry.Size);
+        offset += Align8((std::size_t)entry.Size);
+    }
+    if (offset != size || blobs.size() != header.Count)
+        return false;
+
+    mBlobs.swap(blobs);
+    return true;
+}
+
+bool LampPipelineCache::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Deserialize(data.data(), data.size());
+}
+
+bool LampPipelineCache::Save(const std::string& path)
+{
+    std::vector<std::uint8_t> data = Serialize();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    if (!file)
+        return false;
+    mDirty = false;
+    return true;
+}
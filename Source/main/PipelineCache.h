@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// 64-bit FNV-1a over values fed field by field, so padding, pointers and
+// fields past a count never reach the hash.
+class LampHashStream
+{
+public:
+    void Bytes(const void* data, std::size_t size);
+    void String(const char* text);
+    template<typename T>
+    void Value(const T& value)
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "hash fields one at a time");
+        Bytes(&value, sizeof(T));
+    }
+    std::uint64_t Hash()const { return mHash; }
+
+private:
+    std::uint64_t mHash = 14695981039346656037ull;
+};
+
+// Driver blobs of compiled pipelines by LampPipelineKey (PipelineKey.h), kept in one versioned file.
+class LampPipelineCache
+{
+public:
+    static constexpr std::uint32_t Magic = 0x3150504C; // "LPP1"
+    static constexpr std::uint32_t Version = 1;
+
+    LampPipelineCache() = default;
+    LampPipelineCache(const LampPipelineCache& rhs) = delete;
+    LampPipelineCache& operator=(const LampPipelineCache& rhs) = delete;
+    ~LampPipelineCache() = default;
+
+    // Null when the key is not cached.
+    const std::vector<std::uint8_t>* Find(std::uint64_t key)const;
+    void Store(std::uint64_t key, const void* data, std::size_t size);
+    // For a blob the driver refused.
+    void Remove(std::uint64_t key);
+    std::uint32_t Count()const { return (std::uint32_t)mBlobs.size(); }
+    bool Dirty()const { return mDirty; }
+
+    std::vector<std::uint8_t> Serialize()const;
+    // Leaves the cache empty and returns false for a damaged file or another version.
+    bool Deserialize(const std::uint8_t* data, std::size_t size);
+    bool Load(const std::string& path);
+    bool Save(const std::string& path);
+
+private:
+    std::unordered_map<std::uint64_t, std::vector<std::uint8_t>> mBlobs;
+    bool mDirty = false;
+};
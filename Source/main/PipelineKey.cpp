@@ -0,0 +1,186 @@
+#include "PipelineKey.h"
+
+namespace
+{
+    void HashShader(LampHashStream& h, const D3D12_SHADER_BYTECODE& shader)
+    {
+        const size_t size = shader.pShaderBytecode != nullptr ? shader.BytecodeLength : 0;
+        h.Value((UINT64)size);
+        h.Bytes(shader.pShaderBytecode, size);
+    }
+
+    void HashStencilOp(LampHashStream& h, const D3D12_DEPTH_STENCILOP_DESC& op)
+    {
+        h.Value(op.StencilFailOp);
+        h.Value(op.StencilDepthFailOp);
+        h.Value(op.StencilPassOp);
+        h.Value(op.StencilFunc);
+    }
+}
+
+UINT64 LampPipelineKey::RootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+    LampHashStream h;
+    h.Value(desc.NumParameters);
+    for (UINT i = 0; i < desc.NumParameters; ++i)
+    {
+        const D3D12_ROOT_PARAMETER& p = desc.pParameters[i];
+        h.Value(p.ParameterType);
+        h.Value(p.ShaderVisibility);
+        // Only the member of the union the type selects.
+        switch (p.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            h.Value(p.DescriptorTable.NumDescriptorRanges);
+            for (UINT r = 0; r < p.DescriptorTable.NumDescriptorRanges; ++r)
+            {
+                const D3D12_DESCRIPTOR_RANGE& range = p.DescriptorTable.pDescriptorRanges[r];
+                h.Value(range.RangeType);
+                h.Value(range.NumDescriptors);
+                h.Value(range.BaseShaderRegister);
+                h.Value(range.RegisterSpace);
+                h.Value(range.OffsetInDescriptorsFromTableStart);
+            }
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            h.Value(p.Constants.ShaderRegister);
+            h.Value(p.Constants.RegisterSpace);
+            h.Value(p.Constants.Num32BitValues);
+            break;
+        default:
+            h.Value(p.Descriptor.ShaderRegister);
+            h.Value(p.Descriptor.RegisterSpace);
+            break;
+        }
+    }
+
+    h.Value(desc.NumStaticSamplers);
+    for (UINT i = 0; i < desc.NumStaticSamplers; ++i)
+    {
+        const D3D12_STATIC_SAMPLER_DESC& s = desc.pStaticSamplers[i];
+        h.Value(s.Filter);
+        h.Value(s.AddressU);
+        h.Value(s.AddressV);
+        h.Value(s.AddressW);
+        h.Value(s.MipLODBias);
+        h.Value(s.MaxAnisotropy);
+        h.Value(s.ComparisonFunc);
+        h.Value(s.BorderColor);
+        h.Value(s.MinLOD);
+        h.Value(s.MaxLOD);
+        h.Value(s.ShaderRegister);
+        h.Value(s.RegisterSpace);
+        h.Value(s.ShaderVisibility);
+    }
+    h.Value(desc.Flags);
+    return h.Hash();
+}
+
+UINT64 LampPipelineKey::Graphics(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignature)
+{
+    LampHashStream h;
+    h.Value(rootSignature);
+    HashShader(h, desc.VS);
+    HashShader(h, desc.PS);
+    HashShader(h, desc.DS);
+    HashShader(h, desc.HS);
+    HashShader(h, desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+    h.Value(so.NumEntries);
+    for (UINT i = 0; i < so.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& e = so.pSODeclaration[i];
+        h.Value(e.Stream);
+        h.String(e.SemanticName);
+        h.Value(e.SemanticIndex);
+        h.Value(e.StartComponent);
+        h.Value(e.ComponentCount);
+        h.Value(e.OutputSlot);
+    }
+    h.Value(so.NumStrides);
+    for (UINT i = 0; i < so.NumStrides; ++i)
+        h.Value(so.pBufferStrides[i]);
+    h.Value(so.RasterizedStream);
+
+    // Without independent blending only the first target's state applies.
+    const D3D12_BLEND_DESC& blend = desc.BlendState;
+    h.Value(blend.AlphaToCoverageEnable);
+    h.Value(blend.IndependentBlendEnable);
+    const UINT blendTargets = blend.IndependentBlendEnable ? std::max<UINT>(1u, desc.NumRenderTargets) : 1;
+    for (UINT i = 0; i < blendTargets && i < 8; ++i)
+    {
+        const D3D12_RENDER_TARGET_BLEND_DESC& rt = blend.RenderTarget[i];
+        h.Value(rt.BlendEnable);
+        h.Value(rt.LogicOpEnable);
+        h.Value(rt.SrcBlend);
+        h.Value(rt.DestBlend);
+        h.Value(rt.BlendOp);
+        h.Value(rt.SrcBlendAlpha);
+        h.Value(rt.DestBlendAlpha);
+        h.Value(rt.BlendOpAlpha);
+        h.Value(rt.LogicOp);
+        h.Value(rt.RenderTargetWriteMask);
+    }
+    h.Value(desc.SampleMask);
+
+    const D3D12_RASTERIZER_DESC& r = desc.RasterizerState;
+    h.Value(r.FillMode);
+    h.Value(r.CullMode);
+    h.Value(r.FrontCounterClockwise);
+    h.Value(r.DepthBias);
+    h.Value(r.DepthBiasClamp);
+    h.Value(r.SlopeScaledDepthBias);
+    h.Value(r.DepthClipEnable);
+    h.Value(r.MultisampleEnable);
+    h.Value(r.AntialiasedLineEnable);
+    h.Value(r.ForcedSampleCount);
+    h.Value(r.ConservativeRaster);
+
+    const D3D12_DEPTH_STENCIL_DESC& ds = desc.DepthStencilState;
+    h.Value(ds.DepthEnable);
+    h.Value(ds.DepthWriteMask);
+    h.Value(ds.DepthFunc);
+    h.Value(ds.StencilEnable);
+    h.Value(ds.StencilReadMask);
+    h.Value(ds.StencilWriteMask);
+    HashStencilOp(h, ds.FrontFace);
+    HashStencilOp(h, ds.BackFace);
+
+    h.Value(desc.InputLayout.NumElements);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+        h.String(e.SemanticName);
+        h.Value(e.SemanticIndex);
+        h.Value(e.Format);
+        h.Value(e.InputSlot);
+        h.Value(e.AlignedByteOffset);
+        h.Value(e.InputSlotClass);
+        h.Value(e.InstanceDataStepRate);
+    }
+
+    h.Value(desc.IBStripCutValue);
+    h.Value(desc.PrimitiveTopologyType);
+    h.Value(desc.NumRenderTargets);
+    for (UINT i = 0; i < desc.NumRenderTargets && i < 8; ++i)
+        h.Value(desc.RTVFormats[i]);
+    h.Value(desc.DSVFormat);
+    h.Value(desc.SampleDesc.Count);
+    h.Value(desc.SampleDesc.Quality);
+    h.Value(desc.NodeMask);
+    h.Value(desc.Flags);
+    return h.Hash();
+}
+
+UINT64 LampPipelineKey::Compute(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, UINT64 rootSignature)
+{
+    LampHashStream h;
+    // Apart from graphics keys of the same shader bytes.
+    h.String("compute");
+    h.Value(rootSignature);
+    HashShader(h, desc.CS);
+    h.Value(desc.NodeMask);
+    h.Value(desc.Flags);
+    return h.Hash();
+}
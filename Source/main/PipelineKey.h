@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../D3D/d3dUtil.h"
+#include "PipelineCache.h"
+
+// Content keys of root signature and pipeline descriptions. Equal descriptions
+// hash alike wherever they live; shaders count by their bytecode and the root
+// signature by its own key.
+class LampPipelineKey
+{
+public:
+    static UINT64 RootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc);
+    static UINT64 Graphics(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignature);
+    static UINT64 Compute(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, UINT64 rootSignature);
+};
@@ -0,0 +1,312 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <set>
+
+constexpr std::uint32_t LampRenderGraph::RestingState;
+constexpr std::uint32_t LampRenderGraph::UnknownState;
+
+static const std::uint32_t InvalidPass = 0xffffffff;
+
+static std::wstring StateName(std::uint32_t state)
+{
+    switch (state)
+    {
+    case LampStateCommon: return L"COMMON";
+    case LampStateGenericRead: return L"GENERIC_READ";
+    case LampStateRenderTarget: return L"RENDER_TARGET";
+    case LampStateUnorderedAccess: return L"UNORDERED_ACCESS";
+    case LampStateDepthWrite: return L"DEPTH_WRITE";
+    case LampStateDepthRead: return L"DEPTH_READ";
+    case LampStatePixelShaderResource: return L"PIXEL_SHADER_RESOURCE";
+    case LampStateNonPixelShaderResource: return L"NON_PIXEL_SHADER_RESOURCE";
+    case LampStateCopySource: return L"COPY_SOURCE";
+    case LampStateCopyDest: return L"COPY_DEST";
+    case LampRenderGraph::UnknownState: return L"UNKNOWN";
+    default: return std::to_wstring(state);
+    }
+}
+
+std::uint32_t LampRenderGraph::AddPass(const std::wstring& name, std::uint32_t stage, bool managed, bool cullable)
+{
+    Pass pass;
+    pass.Name = name;
+    pass.Stage = stage;
+    pass.Managed = managed;
+    pass.Cullable = cullable;
+    mPasses.push_back(pass);
+    mCompiled = false;
+    return (std::uint32_t)mPasses.size() - 1;
+}
+
+std::uint32_t LampRenderGraph::ResourceIndex(const std::wstring& name)
+{
+    auto it = mResourceIndex.find(name);
+    if (it != mResourceIndex.end())
+        return it->second;
+    mResources.push_back(name);
+    mResourceIndex[name] = (std::uint32_t)mResources.size() - 1;
+    return (std::uint32_t)mResources.size() - 1;
+}
+
+void LampRenderGraph::Read(std::uint32_t pass, const std::wstring& resource, std::uint32_t state)
+{
+    mPasses[pass].Accesses.push_back({ ResourceIndex(resource), state, false });
+    mCompiled = false;
+}
+
+void LampRenderGraph::Write(std::uint32_t pass, const std::wstring& resource, std::uint32_t state)
+{
+    mPasses[pass].Accesses.push_back({ ResourceIndex(resource), state, true });
+    mCompiled = false;
+}
+
+bool LampRenderGraph::Touches(std::uint32_t pass, std::uint32_t resource, bool& writes)const
+{
+    bool touches = false;
+    writes = false;
+    for (auto& a : mPasses[pass].Accesses)
+    {
+        if (a.Resource != resource)
+            continue;
+        touches = true;
+        writes |= a.Write;
+    }
+    return touches;
+}
+
+bool LampRenderGraph::Compile()
+{
+    const std::uint32_t numPasses = PassCount();
+    const std::uint32_t numResources = ResourceCount();
+    mSchedule.clear();
+    mFinalBarriers.clear();
+
+    // Cull backwards: a cullable pass survives when a surviving pass after it
+    // reads something it writes before anything else rewrites it.
+    std::vector<bool> needed(numResources, false);
+    for (std::uint32_t p = numPasses; p-- > 0;)
+    {
+        Pass& pass = mPasses[p];
+        bool live = !pass.Cullable;
+        for (auto& a : pass.Accesses)
+            live |= a.Write && needed[a.Resource];
+        pass.Culled = !live;
+        if (!live)
+            continue;
+
+        for (auto& a : pass.Accesses)
+        {
+            if (a.Write)
+                needed[a.Resource] = false;
+        }
+        for (auto& a : pass.Accesses)
+        {
+            if (!a.Write)
+                needed[a.Resource] = true;
+        }
+    }
+
+    // Read-after-write, write-after-write and write-after-read edges.
+    std::vector<std::vector<std::uint32_t>> edges(numPasses);
+    std::vector<std::uint32_t> inDegree(numPasses, 0);
+    auto addEdge = [&](std::uint32_t from, std::uint32_t to)
+    {
+        if (from == InvalidPass || from == to)
+            return;
+        if (std::find(edges[from].begin(), edges[from].end(), to) != edges[from].end())
+            return;
+        edges[from].push_back(to);
+        inDegree[to]++;
+    };
+
+    std::vector<std::uint32_t> lastWriter(numResources, InvalidPass);
+    std::vector<std::vector<std::uint32_t>> readers(numResources);
+    for (std::uint32_t p = 0; p < numPasses; ++p)
+    {
+        if (mPasses[p].Culled)
+            continue;
+        for (auto& a : mPasses[p].Accesses)
+        {
+            if (a.Write)
+                continue;
+            addEdge(lastWriter[a.Resource], p);
+            readers[a.Resource].push_back(p);
+        }
+        for (auto& a : mPasses[p].Accesses)
+        {
+            if (!a.Write)
+                continue;
+            addEdge(lastWriter[a.Resource], p);
+            for (std::uint32_t reader : readers[a.Resource])
+                addEdge(reader, p);
+            readers[a.Resource].clear();
+            lastWriter[a.Resource] = p;
+        }
+    }
+
+    // Kahn's algorithm, lowest (stage, declaration) first among the ready passes.
+    std::set<std::pair<std::uint32_t, std::uint32_t>> ready;
+    for (std::uint32_t p = 0; p < numPasses; ++p)
+    {
+        if (!mPasses[p].Culled && inDegree[p] == 0)
+            ready.insert({ mPasses[p].Stage, p });
+    }
+
+    bool stagesInOrder = true;
+    std::uint32_t stage = 0;
+    while (!ready.empty())
+    {
+        std::uint32_t p = ready.begin()->second;
+        ready.erase(ready.begin());
+        stagesInOrder &= mPasses[p].Stage >= stage;
+        stage = std::max<std::uint32_t>(stage, mPasses[p].Stage);
+
+        GraphStep step;
+        step.Pass = p;
+        mSchedule.push_back(step);
+        for (std::uint32_t next : edges[p])
+        {
+            if (--inDegree[next] == 0)
+                ready.insert({ mPasses[next].Stage, next });
+        }
+    }
+
+    // Walk the schedule tracking each resource's state.
+    std::vector<std::uint32_t> state(numResources, RestingState);
+    // Unordered access since the last transition; two in a row need a UAV
+    // barrier unless both only read.
+    std::vector<bool> uavTouched(numResources, false);
+    std::vector<bool> uavWritten(numResources, false);
+    for (auto& step : mSchedule)
+    {
+        const Pass& pass = mPasses[step.Pass];
+        if (!pass.Managed)
+        {
+            // Its own barriers may have moved anything; the next managed pass starts from scratch.
+            std::fill(state.begin(), state.end(), UnknownState);
+            std::fill(uavTouched.begin(), uavTouched.end(), false);
+            continue;
+        }
+
+        // One required state per resource; a write decides over a read.
+        std::vector<Access> wanted;
+        for (auto& a : pass.Accesses)
+        {
+            auto it = std::find_if(wanted.begin(), wanted.end(),
+                [&](const Access& w) { return w.Resource == a.Resource; });
+            if (it == wanted.end())
+                wanted.push_back(a);
+            else if (a.Write)
+                *it = a;
+        }
+
+        for (auto& a : wanted)
+        {
+            const bool unknown = state[a.Resource] == UnknownState;
+            if (state[a.Resource] != a.State)
+                step.Barriers.push_back({ a.Resource, state[a.Resource], a.State, false });
+            if (unknown && a.State == LampStateUnorderedAccess)
+                step.Barriers.push_back({ a.Resource, a.State, a.State, true });
+            else if (uavTouched[a.Resource] && (uavWritten[a.Resource] || a.Write))
+                step.Barriers.push_back({ a.Resource, a.State, a.State, true });
+            state[a.Resource] = a.State;
+            uavTouched[a.Resource] = a.State == LampStateUnorderedAccess;
+            uavWritten[a.Resource] = a.Write;
+        }
+    }
+
+    for (std::uint32_t r = 0; r < numResources; ++r)
+    {
+        if (state[r] != RestingState)
+            mFinalBarriers.push_back({ r, state[r], RestingState, false });
+    }
+
+    mCompiled = stagesInOrder;
+    return mCompiled;
+}
+
+void LampRenderGraph::Clear()
+{
+    mPasses.clear();
+    mResources.clear();
+    mResourceIndex.clear();
+    mSchedule.clear();
+    mFinalBarriers.clear();
+    mCompiled = false;
+}
+
+bool LampRenderGraph::Lifetime(const std::wstring& resource, std::uint32_t& first, std::uint32_t& last)const
+{
+    auto it = mResourceIndex.find(resource);
+    if (it == mResourceIndex.end())
+        return false;
+
+    bool found = false;
+    bool writtenFirst = false;
+    for (std::uint32_t pos = 0; pos < (std::uint32_t)mSchedule.size(); ++pos)
+    {
+        bool writes;
+        if (!Touches(mSchedule[pos].Pass, it->second, writes))
+            continue;
+        if (!found)
+        {
+            first = pos;
+            writtenFirst = writes;
+            found = true;
+        }
+        last = pos;
+    }
+    return found && writtenFirst;
+}
+
+std::uint32_t LampRenderGraph::BarrierCount()const
+{
+    std::uint32_t count = (std::uint32_t)mFinalBarriers.size();
+    for (auto& step : mSchedule)
+        count += (std::uint32_t)step.Barriers.size();
+    return count;
+}
+
+std::uint32_t LampRenderGraph::BatchCount()const
+{
+    std::uint32_t count = mFinalBarriers.empty() ? 0 : 1;
+    for (auto& step : mSchedule)
+        count += step.Barriers.empty() ? 0 : 1;
+    return count;
+}
+
+std::wstring LampRenderGraph::Dump()const
+{
+    std::uint32_t culled = 0;
+    for (auto& pass : mPasses)
+        culled += pass.Culled ? 1 : 0;
+
+    auto barrierText = [&](const GraphBarrier& b)
+    {
+        if (b.Uav)
+            return L"      " + mResources[b.Resource] + L" UAV\n";
+        return L"      " + mResources[b.Resource] + L" " + StateName(b.Before) + L" -> " + StateName(b.After) + L"\n";
+    };
+
+    std::wstring text = L"Render graph: " + std::to_wstring(PassCount()) + L" passes ("
+        + std::to_wstring(culled) + L" culled), " + std::to_wstring(BarrierCount()) + L" barriers in "
+        + std::to_wstring(BatchCount()) + L" batches" + (mCompiled ? L"\n" : L", STAGES OUT OF ORDER\n");
+    for (std::uint32_t pos = 0; pos < (std::uint32_t)mSchedule.size(); ++pos)
+    {
+        const Pass& pass = mPasses[mSchedule[pos].Pass];
+        text += L"  " + std::to_wstring(pos) + L" [stage " + std::to_wstring(pass.Stage) + L"] " + pass.Name
+            + (pass.Managed ? L"\n" : L" (own barriers)\n");
+        for (auto& b : mSchedule[pos].Barriers)
+            text += barrierText(b);
+    }
+    for (auto& pass : mPasses)
+    {
+        if (pass.Culled)
+            text += L"  culled: " + pass.Name + L"\n";
+    }
+    if (!mFinalBarriers.empty())
+        text += L"  end of frame\n";
+    for (auto& b : mFinalBarriers)
+        text += barrierText(b);
+    return text;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ResourceStates.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct GraphBarrier
+{
+    std::uint32_t Resource;
+    std::uint32_t Before;
+    std::uint32_t After;
+    // UAV barrier between two unordered-access writes, Before == After.
+    bool Uav = false;
+};
+
+// One scheduled pass and the barriers issued as a single batch before it.
+struct GraphStep
+{
+    std::uint32_t Pass;
+    std::vector<GraphBarrier> Barriers;
+};
+
+// Frame graph over named resources.
+// Passes are added in the order they should be recorded and declare what they
+// read and write. Compile() culls passes whose outputs nobody reads, orders the
+// rest by their dependencies (stage first, then declaration order), and derives
+// the transitions between passes. Resources start the frame resting in
+// GENERIC_READ. Passes that still write their own barriers are unmanaged: the
+// graph issues nothing around them and afterwards takes every resource to be
+// in an unknown state, so the next managed pass requires its states outright
+// and the state tracker drops the transitions that turn out to be no-ops.
+// Nothing here touches the device, so Dump() can be checked headless.
+class LampRenderGraph
+{
+public:
+    static constexpr std::uint32_t RestingState = LampStateGenericRead;
+    // Before state of the barriers that follow an unmanaged pass.
+    static constexpr std::uint32_t UnknownState = 0xffffffff;
+
+    LampRenderGraph() = default;
+    LampRenderGraph(const LampRenderGraph& rhs) = delete;
+    LampRenderGraph& operator=(const LampRenderGraph& rhs) = delete;
+    ~LampRenderGraph() = default;
+
+    // stage orders command lists: a pass never runs before one of a lower stage.
+    // managed: the graph issues this pass's barriers.
+    // cullable: the declared outputs are all the pass writes.
+    std::uint32_t AddPass(const std::wstring& name, std::uint32_t stage, bool managed, bool cullable);
+    void Read(std::uint32_t pass, const std::wstring& resource, std::uint32_t state = RestingState);
+    void Write(std::uint32_t pass, const std::wstring& resource, std::uint32_t state);
+
+    // False when dependencies would run a pass before one of a lower stage.
+    bool Compile();
+    // Forgets every pass and resource, to declare the frame anew.
+    void Clear();
+    bool Compiled()const { return mCompiled; }
+
+    const std::vector<GraphStep>& Schedule()const { return mSchedule; }
+    // Returns every resource to the resting state at the end of the frame.
+    const std::vector<GraphBarrier>& FinalBarriers()const { return mFinalBarriers; }
+
+    std::uint32_t PassCount()const { return (std::uint32_t)mPasses.size(); }
+    const std::wstring& PassName(std::uint32_t pass)const { return mPasses[pass].Name; }
+    std::uint32_t PassStage(std::uint32_t pass)const { return mPasses[pass].Stage; }
+    bool Culled(std::uint32_t pass)const { return mPasses[pass].Culled; }
+    const std::wstring& ResourceName(std::uint32_t resource)const { return mResources[resource]; }
+    std::uint32_t ResourceCount()const { return (std::uint32_t)mResources.size(); }
+
+    // Schedule positions of the first and last step touching the resource.
+    // False when nothing touches it or its first access is a read.
+    bool Lifetime(const std::wstring& resource, std::uint32_t& first, std::uint32_t& last)const;
+
+    std::uint32_t BarrierCount()const;
+    std::uint32_t BatchCount()const;
+
+    std::wstring Dump()const;
+
+private:
+    struct Access
+    {
+        std::uint32_t Resource;
+        std::uint32_t State;
+        bool Write;
+    };
+
+    struct Pass
+    {
+        std::wstring Name;
+        std::uint32_t Stage;
+        bool Managed;
+        bool Cullable;
+        bool Culled = false;
+        std::vector<Access> Accesses;
+    };
+
+    std::uint32_t ResourceIndex(const std::wstring& name);
+    bool Touches(std::uint32_t pass, std::uint32_t resource, bool& writes)const;
+
+    std::vector<Pass> mPasses;
+    std::vector<std::wstring> mResources;
+    std::unordered_map<std::wstring, std::uint32_t> mResourceIndex;
+
+    std::vector<GraphStep> mSchedule;
+    std::vector<GraphBarrier> mFinalBarriers;
+    bool mCompiled = false;
+};
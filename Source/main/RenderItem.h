@@ -16,11 +16,8 @@ struct RenderItem
 
     DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-    // Dirty flag indicating the object data has changed and we need to update the constant buffer.
-    // Because we have an object cbuffer for each FrameResource, we have to apply the
-    // update to each FrameResource.  Thus, when we modify obect data we should set 
-    // NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-    int NumFramesDirty = gNumFrameResources;
+    // After modifying the object data call LampGeo::MarkDirty(), which queues the
+    // constant buffer update on every FrameResource.
 
     // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
     UINT ObjCBIndex = -1;
@@ -35,6 +32,20 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+    // Object-space bounds of the drawn index range, and the same box in world space.
+    DirectX::BoundingBox LocalBounds;
+    DirectX::BoundingBox Bounds;
+
+    // Cleared by the CPU occlusion culler when the item is hidden from the main camera.
+    bool Visible = true;
+
+    // Static items are baked into the voxel clipmap once (LampVoxelBake); dynamic ones are
+    // voxelized again every frame. An item whose transform changes becomes dynamic.
+    bool Static = true;
+
+    // Handle in the scene octree.
+    UINT OctreeHandle = -1;
 };
 
 enum class RenderLayer : int
@@ -0,0 +1,288 @@
+#include "ResourceStateTracker.h"
+#include <algorithm>
+
+constexpr std::uint32_t LampStateTracker::RestingState;
+constexpr std::uint32_t LampStateTracker::AllSubresources;
+
+void LampStateTracker::Register(void* resource, std::uint32_t state, std::uint32_t subresources)
+{
+    Unregister(resource);
+
+    Subresource s;
+    s.State = state;
+    s.Target = state;
+    s.SplitFrom = state;
+    s.Start = state;
+    mResources[resource].Subresources.assign(std::max<std::uint32_t>(subresources, 1), s);
+}
+
+void LampStateTracker::Unregister(void* resource)
+{
+    if (mResources.erase(resource) == 0)
+        return;
+    mDirty.erase(std::remove(mDirty.begin(), mDirty.end(), resource), mDirty.end());
+}
+
+LampStateTracker::Tracked& LampStateTracker::Track(void* resource)
+{
+    auto it = mResources.find(resource);
+    if (it == mResources.end())
+    {
+        // Sized from the resource itself: a later call may name any of its subresources.
+        Register(resource, RestingState, CountSubresources(resource));
+        it = mResources.find(resource);
+    }
+    it->second.Used = true;
+    return it->second;
+}
+
+void LampStateTracker::MarkDirty(void* resource, Tracked& tracked)
+{
+    if (tracked.Dirty)
+        return;
+    tracked.Dirty = true;
+    mDirty.push_back(resource);
+}
+
+void LampStateTracker::Require(void* resource, std::uint32_t state, std::uint32_t subresource)
+{
+    Tracked& t = Track(resource);
+    const std::uint32_t first = subresource == AllSubresources ? 0 : subresource;
+    const std::uint32_t last = subresource == AllSubresources ? (std::uint32_t)t.Subresources.size() : subresource + 1;
+
+    bool roundTrip = false;
+    for (std::uint32_t i = first; i < last; ++i)
+    {
+        Subresource& s = t.Subresources[i];
+        roundTrip |= s.Want != Pending::None && s.Want != Pending::Required && s.State == state && s.Target != state;
+        s.Want = Pending::Required;
+        s.Target = state;
+    }
+    mFrame.Requests++;
+    mFrame.RoundTrips += roundTrip ? 1 : 0;
+    MarkDirty(resource, t);
+}
+
+void LampStateTracker::Release(void* resource, std::uint32_t state, bool split, std::uint32_t subresource)
+{
+    Tracked& t = Track(resource);
+    const std::uint32_t first = subresource == AllSubresources ? 0 : subresource;
+    const std::uint32_t last = subresource == AllSubresources ? (std::uint32_t)t.Subresources.size() : subresource + 1;
+
+    for (std::uint32_t i = first; i < last; ++i)
+    {
+        Subresource& s = t.Subresources[i];
+        s.Want = split ? Pending::SplitRelease : Pending::Released;
+        s.Target = state;
+    }
+    mFrame.Requests++;
+    MarkDirty(resource, t);
+}
+
+void LampStateTracker::Uav(void* resource)
+{
+    mQueued.push_back({ StateBarrierType::Uav, StateBarrierSplit::None, resource, nullptr, AllSubresources, 0, 0 });
+    mFrame.UavBarriers++;
+}
+
+void LampStateTracker::Aliasing(void* before, void* after)
+{
+    mQueued.push_back({ StateBarrierType::Aliasing, StateBarrierSplit::None, before, after, AllSubresources, 0, 0 });
+    mFrame.AliasingBarriers++;
+}
+
+void LampStateTracker::Issue(bool settle, std::vector<StateBarrier>& barriers)
+{
+    const size_t start = barriers.size();
+    barriers.insert(barriers.end(), mQueued.begin(), mQueued.end());
+    mQueued.clear();
+
+    std::vector<Change> changes;
+    std::vector<void*> stillDirty;
+    for (void* resource : mDirty)
+    {
+        Tracked& t = mResources[resource];
+        changes.clear();
+        bool open = false;
+        for (std::uint32_t i = 0; i < (std::uint32_t)t.Subresources.size(); ++i)
+        {
+            Subresource& s = t.Subresources[i];
+            if (s.Splitting && (settle || s.Want != Pending::None))
+            {
+                changes.push_back({ i, s.SplitFrom, s.State, StateBarrierSplit::End });
+                s.Splitting = false;
+            }
+
+            if (s.Want != Pending::None && s.State != s.Target)
+            {
+                if (s.Want == Pending::SplitRelease && !settle)
+                {
+                    changes.push_back({ i, s.State, s.Target, StateBarrierSplit::Begin });
+                    s.SplitFrom = s.State;
+                    s.Splitting = true;
+                }
+                else
+                {
+                    changes.push_back({ i, s.State, s.Target, StateBarrierSplit::None });
+                }
+                s.State = s.Target;
+            }
+            s.Want = Pending::None;
+            open |= s.Splitting;
+        }
+
+        Emit(resource, (std::uint32_t)t.Subresources.size(), changes, barriers);
+
+        t.Dirty = open;
+        if (open)
+            stillDirty.push_back(resource);
+    }
+    mDirty.swap(stillDirty);
+
+    if (barriers.size() > start)
+        mFrame.Batches++;
+}
+
+void LampStateTracker::Emit(void* resource, std::uint32_t subresources, const std::vector<Change>& changes,
+    std::vector<StateBarrier>& barriers)
+{
+    bool uniform = changes.size() == subresources;
+    for (auto& c : changes)
+    {
+        uniform &= c.Before == changes[0].Before && c.After == changes[0].After && c.Split == changes[0].Split;
+    }
+    for (size_t c = 0; c < (uniform ? 1 : changes.size()); ++c)
+    {
+        const Change& change = changes[c];
+        barriers.push_back({ StateBarrierType::Transition, change.Split, resource, nullptr,
+            uniform ? AllSubresources : change.Subresource, change.Before, change.After });
+        if (change.Split == StateBarrierSplit::None)
+            mFrame.Transitions++;
+        else if (change.Split == StateBarrierSplit::Begin)
+            mFrame.SplitBarriers++;
+    }
+}
+
+void LampStateTracker::Flush(std::vector<StateBarrier>& barriers)
+{
+    Issue(false, barriers);
+}
+
+void LampStateTracker::FlushAll(std::vector<StateBarrier>& barriers)
+{
+    Issue(true, barriers);
+}
+
+std::uint32_t LampStateTracker::State(void* resource, std::uint32_t subresource)const
+{
+    auto it = mResources.find(resource);
+    if (it == mResources.end())
+        return RestingState;
+    auto& subresources = it->second.Subresources;
+    return subresources[std::min<std::uint32_t>(subresource, (std::uint32_t)subresources.size() - 1)].State;
+}
+
+void LampStateTracker::Begin(const LampStateTracker& registry)
+{
+    mResources.clear();
+    mDirty.clear();
+    mQueued.clear();
+    for (auto& pair : registry.mResources)
+    {
+        std::vector<std::uint32_t> states;
+        for (auto& s : pair.second.Subresources)
+            states.push_back(s.State);
+
+        // Only resources still registered and of the same shape are taken from last time.
+        auto expected = mExpected.find(pair.first);
+        if (expected != mExpected.end() && expected->second.size() == states.size())
+            states = expected->second;
+
+        Tracked& t = mResources[pair.first];
+        for (auto state : states)
+        {
+            Subresource s;
+            s.State = state;
+            s.Target = state;
+            s.SplitFrom = state;
+            s.Start = state;
+            t.Subresources.push_back(s);
+        }
+    }
+}
+
+void LampStateTracker::Join(LampStateTracker& list, std::vector<StateBarrier>& patch)
+{
+    // The list starts where the previous one left off next time.
+    list.mExpected.clear();
+    for (auto& pair : mResources)
+    {
+        auto& states = list.mExpected[pair.first];
+        for (auto& s : pair.second.Subresources)
+            states.push_back(s.State);
+    }
+
+    const size_t start = patch.size();
+    std::vector<Change> changes;
+    for (auto& pair : list.mResources)
+    {
+        const Tracked& recorded = pair.second;
+        if (!recorded.Used)
+            continue;
+
+        auto it = mResources.find(pair.first);
+        if (it == mResources.end() || it->second.Subresources.size() != recorded.Subresources.size())
+        {
+            Register(pair.first, RestingState, (std::uint32_t)recorded.Subresources.size());
+            it = mResources.find(pair.first);
+        }
+
+        Tracked& actual = it->second;
+        changes.clear();
+        for (std::uint32_t i = 0; i < (std::uint32_t)actual.Subresources.size(); ++i)
+        {
+            Subresource& s = actual.Subresources[i];
+            const Subresource& r = recorded.Subresources[i];
+            if (s.State != r.Start)
+                changes.push_back({ i, s.State, r.Start, StateBarrierSplit::None });
+            s.State = r.State;
+            s.Target = r.State;
+            s.SplitFrom = r.State;
+            s.Want = Pending::None;
+            s.Splitting = false;
+        }
+        Emit(pair.first, (std::uint32_t)actual.Subresources.size(), changes, patch);
+    }
+
+    const StateTrackerStats& add = list.mFrame;
+    mFrame.Requests += add.Requests;
+    mFrame.Transitions += add.Transitions;
+    mFrame.SplitBarriers += add.SplitBarriers;
+    mFrame.UavBarriers += add.UavBarriers;
+    mFrame.AliasingBarriers += add.AliasingBarriers;
+    mFrame.Batches += add.Batches;
+    mFrame.RoundTrips += add.RoundTrips;
+    mFrame.Patched += add.Patched + (std::uint32_t)(patch.size() - start);
+    if (patch.size() > start)
+        mFrame.Batches++;
+    list.mFrame = StateTrackerStats();
+}
+
+void LampStateTracker::EndFrame()
+{
+    mLastFrame = mFrame;
+    mFrame = StateTrackerStats();
+}
+
+std::wstring LampStateTracker::Report()const
+{
+    return L"State tracker: " + std::to_wstring(mResources.size()) + L" resources, last frame "
+        + std::to_wstring(mLastFrame.Transitions) + L" transitions, "
+        + std::to_wstring(mLastFrame.SplitBarriers) + L" split, "
+        + std::to_wstring(mLastFrame.UavBarriers) + L" UAV, "
+        + std::to_wstring(mLastFrame.AliasingBarriers) + L" aliasing in "
+        + std::to_wstring(mLastFrame.Batches) + L" batches from "
+        + std::to_wstring(mLastFrame.Requests) + L" requests, "
+        + std::to_wstring(mLastFrame.RoundTrips) + L" round trips dropped, "
+        + std::to_wstring(mLastFrame.Patched) + L" patched at submission\n";
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ResourceStates.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct StateTrackerStats
+{
+    // Require() and Release() calls.
+    std::uint32_t Requests = 0;
+    std::uint32_t Transitions = 0;
+    // Transitions issued as a begin/end pair, counted once.
+    std::uint32_t SplitBarriers = 0;
+    std::uint32_t UavBarriers = 0;
+    std::uint32_t AliasingBarriers = 0;
+    // ResourceBarrier calls.
+    std::uint32_t Batches = 0;
+    // Releases a later Require() cancelled before they reached the command list.
+    std::uint32_t RoundTrips = 0;
+    // Transitions added at submission because a command list assumed the wrong start state.
+    std::uint32_t Patched = 0;
+};
+
+enum class StateBarrierType { Transition, Uav, Aliasing };
+enum class StateBarrierSplit { None, Begin, End };
+
+// One D3D12_RESOURCE_BARRIER, without the headers; D3DStateTracker writes them out.
+struct StateBarrier
+{
+    StateBarrierType Type;
+    StateBarrierSplit Split;
+    void* Resource;
+    // Aliasing: the resource placed over Resource.
+    void* AliasAfter;
+    std::uint32_t Subresource;
+    std::uint32_t Before;
+    std::uint32_t After;
+};
+
+// Recorded state of every tracked subresource. Transitions are queued and only
+// written by Flush(), so everything a pass needs, plus what the pass before it
+// gave back, goes out in one ResourceBarrier call.
+// Require(): the state the commands about to be recorded need.
+// Release(): the state a pass leaves a resource in once it is done with it. A
+// release the next pass overrides never reaches the command list; a split
+// release begins at the next flush that does not need the resource and ends
+// where something requires it again.
+// Resources are opaque handles and only barrier records are built here, so the
+// logic runs without a device; D3DStateTracker puts them on command lists.
+class LampStateTracker
+{
+public:
+    static constexpr std::uint32_t RestingState = LampStateGenericRead;
+    static constexpr std::uint32_t AllSubresources = 0xffffffff;
+
+    LampStateTracker() = default;
+    LampStateTracker(const LampStateTracker& rhs) = delete;
+    LampStateTracker& operator=(const LampStateTracker& rhs) = delete;
+    virtual ~LampStateTracker() = default;
+
+    // Resources used before they are registered are taken to rest in RestingState,
+    // with CountSubresources() subresources.
+    void Register(void* resource, std::uint32_t state, std::uint32_t subresources = 1);
+    void Unregister(void* resource);
+
+    void Require(void* resource, std::uint32_t state, std::uint32_t subresource = AllSubresources);
+    // split: nothing records commands on the resource until it is required again.
+    void Release(void* resource, std::uint32_t state, bool split = false,
+        std::uint32_t subresource = AllSubresources);
+    void Uav(void* resource);
+    void Aliasing(void* before, void* after);
+
+    void Flush(std::vector<StateBarrier>& barriers);
+    // Also ends open split barriers and issues every release. Before closing a command list.
+    void FlushAll(std::vector<StateBarrier>& barriers);
+
+    // State as of the barriers flushed so far.
+    std::uint32_t State(void* resource, std::uint32_t subresource = 0)const;
+    std::uint32_t TrackedCount()const { return (std::uint32_t)mResources.size(); }
+
+    // Command lists recorded in parallel each get their own tracker. Begin() resets
+    // one to the states its list started from last time, filling in from the
+    // registry; Join(), called on the registry in submission order, puts the
+    // transitions the assumption missed into patch and takes over the end states
+    // and stats of the list.
+    void Begin(const LampStateTracker& registry);
+    void Join(LampStateTracker& list, std::vector<StateBarrier>& patch);
+
+    void EndFrame();
+    const StateTrackerStats& LastFrame()const { return mLastFrame; }
+    std::wstring Report()const;
+
+protected:
+    // Subresources of a resource used before it was registered.
+    virtual std::uint32_t CountSubresources(void*)const { return 1; }
+
+private:
+    enum class Pending { None, Required, Released, SplitRelease };
+
+    struct Subresource
+    {
+        std::uint32_t State;
+        std::uint32_t Target;
+        Pending Want = Pending::None;
+        // A begin-only barrier from SplitFrom to State is open.
+        bool Splitting = false;
+        std::uint32_t SplitFrom;
+        // State when the list began; see Begin().
+        std::uint32_t Start;
+    };
+
+    struct Tracked
+    {
+        std::vector<Subresource> Subresources;
+        bool Dirty = false;
+        // Required or released since Begin().
+        bool Used = false;
+    };
+
+    struct Change
+    {
+        std::uint32_t Subresource;
+        std::uint32_t Before;
+        std::uint32_t After;
+        StateBarrierSplit Split;
+    };
+
+    Tracked& Track(void* resource);
+    void MarkDirty(void* resource, Tracked& tracked);
+    void Issue(bool settle, std::vector<StateBarrier>& barriers);
+    // Subresources changing alike go out as one barrier.
+    void Emit(void* resource, std::uint32_t subresources, const std::vector<Change>& changes,
+        std::vector<StateBarrier>& barriers);
+
+    std::unordered_map<void*, Tracked> mResources;
+    // Resources with pending transitions or an open split.
+    std::vector<void*> mDirty;
+    // UAV and aliasing barriers, issued ahead of the transitions.
+    std::vector<StateBarrier> mQueued;
+    // Per-list trackers: registry states as of the last Join(), the next Begin() starts from them.
+    std::unordered_map<void*, std::vector<std::uint32_t>> mExpected;
+
+    StateTrackerStats mFrame;
+    StateTrackerStats mLastFrame;
+};
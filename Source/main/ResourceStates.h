@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Resource states as the render graph and the state tracker keep them. The
+// values are those of D3D12_RESOURCE_STATES, so D3D12 states pass straight in
+// and the cores build without the Windows headers.
+enum LampResourceState : std::uint32_t
+{
+    LampStateCommon = 0,
+    LampStateVertexAndConstantBuffer = 0x1,
+    LampStateIndexBuffer = 0x2,
+    LampStateRenderTarget = 0x4,
+    LampStateUnorderedAccess = 0x8,
+    LampStateDepthWrite = 0x10,
+    LampStateDepthRead = 0x20,
+    LampStateNonPixelShaderResource = 0x40,
+    LampStatePixelShaderResource = 0x80,
+    LampStateIndirectArgument = 0x200,
+    LampStateCopyDest = 0x400,
+    LampStateCopySource = 0x800,
+    LampStateGenericRead = 0xac3,
+};
@@ -261,7 +261,18 @@ void LampRootSignature::BuildComposeVXGIRootSignature()
 
 void LampRootSignature::CreateRootSignature(D3D12_ROOT_SIGNATURE_DESC rootSigDesc, std::wstring name)
 {
-    if (mRootSignatures.find(name) != mRootSignatures.end()) return;
+    RootSignatureId id = FindRootSignature(name);
+    if (mRootSignatures[id] != nullptr) return;
+
+    const UINT64 key = LampPipelineKey::RootSignature(rootSigDesc);
+    auto shared = mByKey.find(key);
+    if (shared != mByKey.end())
+    {
+        mRootSignatures[id] = shared->second;
+        mShared++;
+        return;
+    }
+
     // create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
     ComPtr<ID3DBlob> serializedRootSig = nullptr;
     ComPtr<ID3DBlob> errorBlob = nullptr;
@@ -278,14 +289,34 @@ void LampRootSignature::CreateRootSignature(D3D12_ROOT_SIGNATURE_DESC rootSigDes
         0,
         serializedRootSig->GetBufferPointer(),
         serializedRootSig->GetBufferSize(),
-        IID_PPV_ARGS(mRootSignatures[name].GetAddressOf())));
+        IID_PPV_ARGS(mRootSignatures[id].GetAddressOf())));
 
-    mRootSignatures[name]->SetName(name.c_str());
+    mRootSignatures[id]->SetName(name.c_str());
+    mByKey[key] = mRootSignatures[id].Get();
+    mKeys[mRootSignatures[id].Get()] = key;
+}
+
+UINT64 LampRootSignature::Key(ID3D12RootSignature* rootSignature)const
+{
+    auto found = mKeys.find(rootSignature);
+    return found != mKeys.end() ? found->second : 0;
+}
+
+RootSignatureId LampRootSignature::FindRootSignature(const std::wstring& name)
+{
+    return mRootSignatures.Find(name);
+}
+
+ID3D12RootSignature* LampRootSignature::GetRootSignature(RootSignatureId id)const
+{
+    assert(id.Valid());
+    return mRootSignatures[id].Get();
 }
 
-ID3D12RootSignature* LampRootSignature::GetRootSignature(std::wstring name)
+ID3D12RootSignature* LampRootSignature::GetRootSignature(const std::wstring& name)const
 {
-    return mRootSignatures[name].Get();
+    auto rootSignature = mRootSignatures.Lookup(name);
+    return rootSignature != nullptr ? rootSignature->Get() : nullptr;
 }
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> LampRootSignature::GetStaticSamplers()
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../D3D/d3dUtil.h"
+#include "NameTable.h"
+#include "PipelineKey.h"
 
 class LampRootSignature
 {
@@ -10,12 +12,23 @@ public:
     LampRootSignature& operator=(const LampRootSignature& rhs) = delete;
     ~LampRootSignature() = default;
 
-    ID3D12RootSignature* GetRootSignature(std::wstring name);
+    // Interns the name; the id may be taken before the root signature is created.
+    RootSignatureId FindRootSignature(const std::wstring& name);
+    ID3D12RootSignature* GetRootSignature(RootSignatureId id)const;
+    ID3D12RootSignature* GetRootSignature(const std::wstring& name)const;
+    // A name whose description matches one already created shares that root signature.
     void CreateRootSignature(D3D12_ROOT_SIGNATURE_DESC rootSigDesc, std::wstring name);
+    // LampPipelineKey of a root signature created here, 0 for null.
+    UINT64 Key(ID3D12RootSignature* rootSignature)const;
+    UINT CreatedCount()const { return (UINT)mByKey.size(); }
+    UINT SharedCount()const { return mShared; }
 
 private:
     Microsoft::WRL::ComPtr <ID3D12Device> md3dDevice;
-    std::unordered_map<std::wstring, Microsoft::WRL::ComPtr<ID3D12RootSignature>> mRootSignatures;
+    LampNamedObjects<std::wstring, RootSignatureTag, Microsoft::WRL::ComPtr<ID3D12RootSignature>> mRootSignatures;
+    std::unordered_map<UINT64, ID3D12RootSignature*> mByKey;
+    std::unordered_map<ID3D12RootSignature*, UINT64> mKeys;
+    UINT mShared = 0;
 
     void BuildSsaoRootSignature();
     void BuildDebugRootSignature();
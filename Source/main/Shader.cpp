@@ -1,165 +1,476 @@
 #include "Shader.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+namespace
+{
+#if defined(DEBUG) || defined(_DEBUG)
+    const UINT CompileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    // Debug and release blobs differ under the same key.
+    const wchar_t* CacheDirectory = L"Shaders\\cache\\debug";
+#else
+    const UINT CompileFlags = 0;
+    const wchar_t* CacheDirectory = L"Shaders\\cache\\release";
+#endif
+
+    bool CompilePermutation(const LampShaderDesc& desc, const ShaderDefines& defines, std::vector<std::uint8_t>& blob, std::string& log)
+    {
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (auto& d : defines)
+            macros.push_back({ d.first.c_str(), d.second.c_str() });
+        macros.push_back({ NULL, NULL });
+
+        Microsoft::WRL::ComPtr<ID3DBlob> byteCode;
+        Microsoft::WRL::ComPtr<ID3DBlob> errors;
+        HRESULT hr = D3DCompileFromFile(AnsiToWString(desc.File).c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            desc.Entry.c_str(), desc.Target.c_str(), CompileFlags, 0, &byteCode, &errors);
+        if (errors != nullptr)
+            log.assign(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize());
+        if (FAILED(hr))
+            return false;
+
+        auto bytes = static_cast<const std::uint8_t*>(byteCode->GetBufferPointer());
+        blob.assign(bytes, bytes + byteCode->GetBufferSize());
+        return true;
+    }
+}
 
 LampShader::LampShader(Microsoft::WRL::ComPtr<ID3D12Device> d3dDevice)
 {
 	md3dDevice = d3dDevice;
-    LoadShaders();
+    CreateDirectory(L"Shaders\\cache", nullptr);
+    CreateDirectory(CacheDirectory, nullptr);
+    std::wstring directory = CacheDirectory;
+    mPermutations = std::make_unique<LampShaderPermutations>(std::string(directory.begin(), directory.end()), CompilePermutation);
+    DeclarePermutations();
+    RegisterShaders();
+    OpenArchive(L"Shaders\\cso\\Shaders.lsa");
+    WatchSources();
 }
 
-LPVOID LampShader::GetShader(std::string name)
+LampShader::~LampShader()
 {
-	return mShaders[name]->GetBufferPointer();
+    // Stopped before the handle it waits on is closed.
+    mWatcher.reset();
+    if (mChangeNotification != INVALID_HANDLE_VALUE)
+        FindCloseChangeNotification(mChangeNotification);
+    if (mArchiveView != nullptr)
+        UnmapViewOfFile(mArchiveView);
+    if (mArchiveMapping != nullptr)
+        CloseHandle(mArchiveMapping);
+    if (mArchiveFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mArchiveFile);
 }
 
-SIZE_T LampShader::GetSize(std::string name)
+ShaderId LampShader::FindShader(const std::string& name)const
 {
-	return mShaders[name]->GetBufferSize();
+    return mNames.Find(name);
 }
 
-void LampShader::LoadShaders()
+LPVOID LampShader::GetShader(ShaderId id)const
 {
-    OutputDebugString(L"Begin Loading Shaders\n");
-    LoadBlobs();
-    OutputDebugString(L"Finish Loading Shaders\n");
+    return Load(id).Data;
 }
 
-void LampShader::LoadBlobs()
+SIZE_T LampShader::GetSize(ShaderId id)const
 {
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Default_VS.cso", mShaders["standardVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Default_PS.cso", mShaders["opaquePS"].GetAddressOf()));
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Blit_PS.cso", mShaders["blitPS"].GetAddressOf()));
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\fullScreen_VS.cso", mShaders["fullScreenVS"].GetAddressOf()));
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Shadows_VS.cso", mShaders["shadowVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Shadows_PS.cso", mShaders["shadowOpaquePS"].GetAddressOf()));
-    // mShaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "PS", "ps_5_1");
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\RSM_VS.cso", mShaders["RSMVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\RSM_PS.cso", mShaders["RSMPS"].GetAddressOf()));
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ShadowDebug_VS.cso", mShaders["debugVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ShadowDebug_PS.cso", mShaders["debugPS"].GetAddressOf()));
-
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\DrawNormals_VS.cso", mShaders["drawNormalsVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\DrawNormals_PS.cso", mShaders["drawNormalsPS"].GetAddressOf()));
+    return Load(id).Size;
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\GBuffer_VS.cso", mShaders["drawGBufferVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\GBuffer_PS.cso", mShaders["drawGBufferPS"].GetAddressOf()));
+LPVOID LampShader::GetShader(const std::string& name)const
+{
+	return GetShader(Registered(name));
+}
 
-    // mShaders["drawDeferLightingVS"] = d3dUtil::CompileShader(L"Shaders\\DeferLighting.hlsl", nullptr, "VS", "vs_5_1");
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\DeferLighting_PS.cso", mShaders["DeferLightingPS"].GetAddressOf()));
+SIZE_T LampShader::GetSize(const std::string& name)const
+{
+	return GetSize(Registered(name));
+}
 
-    // mShaders["SSGILightingVS"] = d3dUtil::CompileShader(L"Shaders\\SSGI.hlsl", nullptr, "VS", "vs_5_1");
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\SSGI_PS.cso", mShaders["ssgiPS"].GetAddressOf()));
+ShaderId LampShader::Registered(const std::string& name)const
+{
+    ShaderId id = FindShader(name);
+    if (!id.Valid())
+        throw std::out_of_range("Shader not registered: " + name);
+    return id;
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Voxelize_VS.cso", mShaders["VoxelizeVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Voxelize_GS.cso", mShaders["VoxelizeGS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Voxelize_PS.cso", mShaders["VoxelizePS"].GetAddressOf()));
+const LampShader::Loaded& LampShader::Load(ShaderId id)const
+{
+    assert(id.Valid());
+    std::lock_guard<std::mutex> lock(mMutex);
+    Loaded& loaded = mLoaded[id.Index];
+    if (loaded.Ready)
+        return loaded;
+
+    auto t0 = Clock::now();
+    const Source& source = mSources[id.Index];
+    if (source.Cso.empty())
+    {
+        // Usually compiled by now; waits otherwise.
+        std::string log;
+        const std::vector<std::uint8_t>* code = mPermutations->Wait(source.Permutation, &log);
+        if (!log.empty())
+            OutputDebugStringA(log.c_str());
+        if (code == nullptr)
+            throw std::runtime_error("Shader permutation failed to compile: " + mNames.Name(id));
+        loaded.Data = const_cast<std::uint8_t*>(code->data());
+        loaded.Size = code->size();
+        mFromPermutations++;
+    }
+    else
+    {
+        LampShaderArchive::Blob blob = mArchive.Find(source.Cso);
+        if (blob.Data != nullptr)
+        {
+            loaded.Data = const_cast<void*>(blob.Data);
+            loaded.Size = blob.Size;
+            mFromArchive++;
+        }
+        else
+        {
+            ThrowIfFailed(D3DReadFileToBlob((L"Shaders\\cso\\" + AnsiToWString(source.Cso) + L".cso").c_str(),
+                loaded.Blob.GetAddressOf()));
+            loaded.Data = loaded.Blob->GetBufferPointer();
+            loaded.Size = loaded.Blob->GetBufferSize();
+            mFromFile++;
+        }
+    }
+    loaded.Ready = true;
+    mLoadMs += std::chrono::duration<float, std::milli>(Clock::now() - t0).count();
+    return loaded;
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Ssao_VS.cso", mShaders["ssaoVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Ssao_PS.cso", mShaders["ssaoPS"].GetAddressOf()));
+std::wstring LampShader::Report()const
+{
+    const PermutationStats stats = mPermutations->Stats();
+    std::lock_guard<std::mutex> lock(mMutex);
+    return L"Shaders: " + std::to_wstring(mFromArchive + mFromFile + mFromPermutations) + L" of "
+        + std::to_wstring(mSources.size()) + L" loaded, " + std::to_wstring(mFromArchive) + L" from the archive ("
+        + (mArchive.IsOpen() ? std::to_wstring(mArchive.Count()) + L" entries" : std::wstring(L"not found"))
+        + L"), " + std::to_wstring(mFromFile) + L" from .cso, " + std::to_wstring(mFromPermutations) + L" permutations, "
+        + std::to_wstring(mLoadMs) + L" ms\n"
+        + L"Permutations: " + std::to_wstring(stats.Requests) + L" requested, " + std::to_wstring(stats.MemoryHits)
+        + L" already known, " + std::to_wstring(stats.DiskHits) + L" from disk, " + std::to_wstring(stats.Compiled)
+        + L" compiled in " + std::to_wstring(stats.CompileMs) + L" ms, " + std::to_wstring(stats.Failed) + L" failed\n"
+        + L"Hot reload: " + std::to_wstring(mWatcher->FileCount()) + L" files watched, " + std::to_wstring(stats.Reloaded)
+        + L" permutations recompiled, " + std::to_wstring(mReloaded) + L" shaders swapped, "
+        + std::to_wstring(mReloadsFailed) + L" failed\n";
+}
 
-    // mShaders["ssaoBlurVS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "VS", "vs_5_1");
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\SsaoBlur_PS.cso", mShaders["ssaoBlurPS"].GetAddressOf()));
+std::vector<ShaderId> LampShader::ApplyReloads()
+{
+    std::vector<ShaderId> swapped;
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto swap = [&](UINT index)
+    {
+        mLoaded[index] = Loaded();
+        ShaderId id;
+        id.Index = index;
+        swapped.push_back(id);
+        mReloaded++;
+    };
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Sky_VS.cso", mShaders["skyVS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Sky_PS.cso", mShaders["skyPS"].GetAddressOf()));
+    for (std::uint32_t declared : mWatcher->TakeChanged())
+    {
+        mPermutations->Reload(declared);
+        // Prebuilt shaders move to a permutation compiled from the edited source.
+        for (UINT i = 0; i < (UINT)mSources.size(); ++i)
+        {
+            if (mSources[i].Cso.empty() || mSources[i].Declared != declared)
+                continue;
+            auto switching = std::find_if(mSwitching.begin(), mSwitching.end(),
+                [&](const std::pair<ShaderId, PermutationKey>& s) { return s.first.Index == i; });
+            if (switching == mSwitching.end())
+            {
+                ShaderId id;
+                id.Index = i;
+                mSwitching.push_back({ id, mPermutations->Request(declared, {}) });
+            }
+        }
+    }
+
+    for (auto s = mSwitching.begin(); s != mSwitching.end();)
+    {
+        if (!mPermutations->Done(s->second))
+        {
+            ++s;
+            continue;
+        }
+        std::string log;
+        const bool compiled = mPermutations->Wait(s->second, &log) != nullptr;
+        if (!log.empty())
+            OutputDebugStringA(log.c_str());
+
+        // From now on reloaded with the permutation; until that compiles, the cso stays loaded.
+        Source& source = mSources[s->first.Index];
+        source.Cso.clear();
+        source.Permutation = s->second;
+        if (compiled)
+            swap(s->first.Index);
+        else
+            mReloadsFailed++;
+        s = mSwitching.erase(s);
+    }
+
+    // Replaces the blobs of these keys, so every shader loaded from one is swapped right here.
+    for (auto& r : mPermutations->TakeReloaded())
+    {
+        if (!r.Log.empty())
+            OutputDebugStringA(r.Log.c_str());
+        if (!r.Compiled)
+        {
+            mReloadsFailed++;
+            continue;
+        }
+        for (UINT i = 0; i < (UINT)mSources.size(); ++i)
+        {
+            if (mSources[i].Cso.empty() && mSources[i].Permutation == r.Key)
+                swap(i);
+        }
+    }
+    return swapped;
+}
 
-    // mShaders["compositeVS"] = d3dUtil::CompileShader(L"Shaders\\Composite.hlsl", nullptr, "VS", "vs_5_0");
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Composite_PS.cso", mShaders["compositePS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Sobel_CS.cso", mShaders["sobelCS"].GetAddressOf()));
+ShaderId LampShader::AddPermutation(const std::string& name, const std::string& shader,
+    const std::vector<std::pair<std::string, UINT>>& values)
+{
+    auto declared = mDeclared.find(shader);
+    if (declared == mDeclared.end())
+        throw std::out_of_range("Shader has no permutations: " + shader);
 
-    // mShaders["cloudVS"] = d3dUtil::CompileShader(L"Shaders\\Cloud.hlsl", nullptr, "VS", "vs_5_0");
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Cloud_PS.cso", mShaders["cloudPS"].GetAddressOf()));
+    std::vector<std::pair<std::string, std::uint32_t>> request(values.begin(), values.end());
+    PermutationKey key = mPermutations->Request(declared->second, request);
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\VXGI_PS.cso", mShaders["vxgiPS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\CompositeVXGI_PS.cso", mShaders["compositeVXGIPS"].GetAddressOf()));
+    ShaderId id = mNames.Intern(name);
+    if (id.Index == mSources.size())
+    {
+        mSources.emplace_back();
+        mLoaded.emplace_back();
+    }
+    // Re-registering a name with the same key keeps what was loaded.
+    assert(mSources[id.Index].Cso.empty() && (mSources[id.Index].Permutation == 0 || mSources[id.Index].Permutation == key));
+    mSources[id.Index].Permutation = key;
+    mSources[id.Index].Declared = declared->second;
+    return id;
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\GenerateMip_CS.cso", mShaders["mipmapCS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\GenerateMip3D_CS.cso", mShaders["mipmap3DCS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\GenerateHiz_CS.cso", mShaders["hizCS"].GetAddressOf()));
+std::string LampShader::AddLightPermutation(const std::string& name, const std::string& shader,
+    const LampLightCounts& lights)
+{
+    const LampLightCounts defaults;
+    if (lights.Directional == defaults.Directional && lights.Point == defaults.Point && lights.Spot == defaults.Spot)
+        return name;
+
+    std::string permutation = name + "." + std::to_string(lights.Directional) + "d" +
+        std::to_string(lights.Point) + "p" + std::to_string(lights.Spot) + "s";
+    AddPermutation(permutation, shader, {
+        { "NUM_DIR_LIGHTS", lights.Directional },
+        { "NUM_POINT_LIGHTS", lights.Point },
+        { "NUM_SPOT_LIGHTS", lights.Spot } });
+    return permutation;
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\TAA_PS.cso", mShaders["taaPS"].GetAddressOf()));
+void LampShader::Add(const std::string& name, const std::string& cso)
+{
+    ShaderId id = mNames.Intern(name);
+    assert(id.Index == mSources.size());
+    Source source;
+    source.Cso = cso;
+    auto declared = mDeclared.find(cso);
+    if (declared != mDeclared.end())
+        source.Declared = declared->second;
+    mSources.push_back(source);
+    mLoaded.emplace_back();
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\WorldProbe_CS.cso", mShaders["WorldProbeCS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\UpdateProbe_PS.cso", mShaders["WorldProbePS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ProbeToSH_CS.cso", mShaders["ProbeToSHCS"].GetAddressOf()));
+void LampShader::Declare(const std::string& cso, const std::wstring& hlsl, const std::string& entry, const std::string& target,
+    const std::vector<LampShaderFeature>& features)
+{
+    LampShaderDesc desc;
+    desc.File = std::string(hlsl.begin(), hlsl.end());
+    desc.Entry = entry;
+    desc.Target = target;
+    desc.Features = features;
+    mDeclared[cso] = mPermutations->Declare(desc);
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ProbeGI_PS.cso", mShaders["ProbegiPS"].GetAddressOf()));
+void LampShader::DeclarePermutations()
+{
+    // Defaults match the #defines in the hlsl, so the default permutation is the prebuilt cso.
+    const LampLightCounts defaults;
+    const std::vector<LampShaderFeature> lights =
+    {
+        { "NUM_DIR_LIGHTS", defaults.Directional, LampLightCounts::MaxDirectional, false },
+        { "NUM_POINT_LIGHTS", defaults.Point, LampLightCounts::MaxPoint, false },
+        { "NUM_SPOT_LIGHTS", defaults.Spot, LampLightCounts::MaxSpot, false },
+    };
+    std::vector<LampShaderFeature> gbuffer = lights;
+    gbuffer.push_back({ "INSTANCING", 0, 1, true });
+
+    Declare("GBuffer_VS", L"Shaders\\GBuffer.hlsl", "VS", "vs_5_1", gbuffer);
+    Declare("GBuffer_PS", L"Shaders\\GBuffer.hlsl", "PS", "ps_5_1", gbuffer);
+    Declare("DeferLighting_PS", L"Shaders\\DeferLighting.hlsl", "PS", "ps_5_1", lights);
+    Declare("SSGI_PS", L"Shaders\\SSGI.hlsl", "PS", "ps_5_1", lights);
+    Declare("Shadows_PS", L"Shaders\\Shadows.hlsl", "PS", "ps_5_1", { { "ALPHA_TEST", 0, 1, true } });
+    // No features; compiled from source since cbTaa moved to the shared layout.
+    Declare("TAA_PS", L"Shaders\\TAA.hlsl", "PS", "ps_5_1", {});
+    // Read the voxel clipmap, which has no prebuilt cso.
+    Declare("Voxelize_VS", L"Shaders\\Voxelize.hlsl", "VS", "vs_5_1", {});
+    Declare("Voxelize_GS", L"Shaders\\Voxelize.hlsl", "GS", "gs_5_1", {});
+    Declare("Voxelize_PS", L"Shaders\\Voxelize.hlsl", "PS", "ps_5_1", {});
+    Declare("ClearVoxels_CS", L"Shaders\\ClearVoxels.hlsl", "CS", "cs_5_1", {});
+    Declare("InjectVoxels_CS", L"Shaders\\InjectVoxels.hlsl", "CS", "cs_5_1", {});
+    Declare("GenerateAnisoMip3D_CS", L"Shaders\\GenerateAnisoMip3D.hlsl", "CS", "cs_5_1", {});
+    Declare("VoxelDI_PS", L"Shaders\\VoxelDI.hlsl", "PS", "ps_5_1", { { "VOXEL_ANISO", 0, 1, true } });
+    Declare("ProbeDI_PS", L"Shaders\\ProbeDI.hlsl", "PS", "ps_5_1", {});
+    Declare("Reflection_PS", L"Shaders\\Reflection.hlsl", "PS", "ps_5_1", {});
+    Declare("UpdateProbe_PS", L"Shaders\\UpdateProbe.hlsl", "PS", "ps_5_1", {});
+}
 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ScreenProbeND_PS.cso", mShaders["ProbeNDPS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ScreenDI_PS.cso", mShaders["ScreenDIPS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\VoxelDI_PS.cso", mShaders["VoxelDIPS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ProbeDI_PS.cso", mShaders["ProbeDIPS"].GetAddressOf())); 
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\ScreenProbeToSH_CS.cso", mShaders["ScreenProbeCS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\Reflection_PS.cso", mShaders["ReflectionPS"].GetAddressOf()));
-    ThrowIfFailed(D3DReadFileToBlob(L"Shaders\\cso\\CompositeDI_PS.cso", mShaders["CompositeDIPS"].GetAddressOf()));
+void LampShader::WatchSources()
+{
+    // Default_VS is the entry VS of Shaders\Default.hlsl, compiled as vs_5_1.
+    for (auto& source : mSources)
+    {
+        const std::size_t split = source.Cso.rfind('_');
+        if (source.Declared != UINT_MAX || split == std::string::npos)
+            continue;
+        const std::string entry = source.Cso.substr(split + 1);
+        const std::string hlsl = "Shaders\\" + source.Cso.substr(0, split) + ".hlsl";
+        if ((entry != "VS" && entry != "GS" && entry != "PS" && entry != "CS")
+            || GetFileAttributesA(hlsl.c_str()) == INVALID_FILE_ATTRIBUTES)
+            continue;
+        std::string target = entry + "_5_1";
+        std::transform(target.begin(), target.end(), target.begin(), [](char c) { return (char)std::tolower(c); });
+
+        auto declared = mDeclared.find(source.Cso);
+        if (declared == mDeclared.end())
+        {
+            Declare(source.Cso, AnsiToWString(hlsl), entry, target, {});
+            declared = mDeclared.find(source.Cso);
+        }
+        source.Declared = declared->second;
+    }
+
+    // Not the subtree, so the cache written below Shaders does not wake the watcher.
+    mChangeNotification = FindFirstChangeNotification(L"Shaders", FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    HANDLE notification = mChangeNotification;
+    mWatcher = std::make_unique<LampShaderWatcher>(250, [notification](std::uint32_t ms)
+    {
+        if (notification == INVALID_HANDLE_VALUE)
+            Sleep(ms);
+        else if (WaitForSingleObject(notification, ms) == WAIT_OBJECT_0)
+            FindNextChangeNotification(notification);
+    });
+    std::set<std::uint32_t> watched;
+    for (auto& source : mSources)
+    {
+        if (source.Declared != UINT_MAX && watched.insert(source.Declared).second)
+            mWatcher->Watch(mPermutations->File(source.Declared), source.Declared);
+    }
+    mWatcher->Start();
 }
 
-void LampShader::CompileShaders()
+void LampShader::OpenArchive(const std::wstring& path)
 {
-    const D3D_SHADER_MACRO alphaTestDefines[] =
+    // A missing archive is not an error: every shader is then read from its .cso.
+    mArchiveFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mArchiveFile == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(mArchiveFile, &size) && size.QuadPart > 0)
+        mArchiveMapping = CreateFileMapping(mArchiveFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mArchiveMapping != nullptr)
+        mArchiveView = MapViewOfFile(mArchiveMapping, FILE_MAP_READ, 0, 0, 0);
+
+    std::string error = "could not be mapped";
+    if (mArchiveView == nullptr || !mArchive.Open(mArchiveView, (size_t)size.QuadPart, error))
     {
-        "ALPHA_TEST", "1",
-        NULL, NULL
-    };
+        std::wstring msg = L"Shader archive " + path + L" " + AnsiToWString(error) + L", reading .cso files\n";
+        OutputDebugString(msg.c_str());
+    }
+}
+
+void LampShader::RegisterShaders()
+{
+    Add("standardVS", "Default_VS");
+    Add("opaquePS", "Default_PS");
 
-    mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
+    Add("blitPS", "Blit_PS");
 
-    mShaders["fullScreenVS"] = d3dUtil::CompileShader(L"Shaders\\fullScreenVS.hlsl", nullptr, "VS", "vs_5_1");
+    Add("fullScreenVS", "fullScreen_VS");
 
-    mShaders["shadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "PS", "ps_5_1");
-    mShaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1");
+    Add("shadowVS", "Shadows_VS");
+    Add("shadowOpaquePS", "Shadows_PS");
+    // AddPermutation("shadowAlphaTestedPS", "Shadows_PS", { { "ALPHA_TEST", 1 } });
 
-    mShaders["RSMVS"] = d3dUtil::CompileShader(L"Shaders\\RSM.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["RSMPS"] = d3dUtil::CompileShader(L"Shaders\\RSM.hlsl", nullptr, "PS", "ps_5_1");
+    Add("RSMVS", "RSM_VS");
+    Add("RSMPS", "RSM_PS");
 
-    mShaders["debugVS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["debugPS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "PS", "ps_5_1");
+    Add("debugVS", "ShadowDebug_VS");
+    Add("debugPS", "ShadowDebug_PS");
 
-    mShaders["drawNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["drawNormalsPS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "PS", "ps_5_1");
+    Add("drawNormalsVS", "DrawNormals_VS");
+    Add("drawNormalsPS", "DrawNormals_PS");
 
-    mShaders["drawGBufferVS"] = d3dUtil::CompileShader(L"Shaders\\GBuffer.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["drawGBufferPS"] = d3dUtil::CompileShader(L"Shaders\\GBuffer.hlsl", nullptr, "PS", "ps_5_1");
+    Add("drawGBufferVS", "GBuffer_VS");
+    Add("drawGBufferPS", "GBuffer_PS");
+    // The instanced variant has no prebuilt cso.
+    AddPermutation("drawGBufferInstancedVS", "GBuffer_VS", { { "INSTANCING", 1 } });
+    AddPermutation("drawGBufferInstancedPS", "GBuffer_PS", { { "INSTANCING", 1 } });
 
-    // mShaders["drawDeferLightingVS"] = d3dUtil::CompileShader(L"Shaders\\DeferLighting.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["DeferLightingPS"] = d3dUtil::CompileShader(L"Shaders\\DeferLighting.hlsl", nullptr, "PS", "ps_5_1");
+    Add("DeferLightingPS", "DeferLighting_PS");
 
-    // mShaders["SSGILightingVS"] = d3dUtil::CompileShader(L"Shaders\\SSGI.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["ssgiPS"] = d3dUtil::CompileShader(L"Shaders\\SSGI.hlsl", nullptr, "PS", "ps_5_1");
+    Add("ssgiPS", "SSGI_PS");
 
-    mShaders["VoxelizeVS"] = d3dUtil::CompileShader(L"Shaders\\Voxelize.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["VoxelizePS"] = d3dUtil::CompileShader(L"Shaders\\Voxelize.hlsl", nullptr, "PS", "ps_5_1");
-    mShaders["VoxelizeGS"] = d3dUtil::CompileShader(L"Shaders\\Voxelize.hlsl", nullptr, "GS", "gs_5_1");
+    AddPermutation("VoxelizeVS", "Voxelize_VS", {});
+    AddPermutation("VoxelizeGS", "Voxelize_GS", {});
+    AddPermutation("VoxelizePS", "Voxelize_PS", {});
+    AddPermutation("clearVoxelsCS", "ClearVoxels_CS", {});
+    AddPermutation("injectVoxelsCS", "InjectVoxels_CS", {});
 
-    mShaders["ssaoVS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["ssaoPS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "PS", "ps_5_1");
+    Add("ssaoVS", "Ssao_VS");
+    Add("ssaoPS", "Ssao_PS");
 
-    // mShaders["ssaoBlurVS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["ssaoBlurPS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "PS", "ps_5_1");
+    Add("ssaoBlurPS", "SsaoBlur_PS");
 
-    mShaders["skyVS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["skyPS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
+    Add("skyVS", "Sky_VS");
+    Add("skyPS", "Sky_PS");
 
-    // mShaders["compositeVS"] = d3dUtil::CompileShader(L"Shaders\\Composite.hlsl", nullptr, "VS", "vs_5_0");
-    mShaders["compositePS"] = d3dUtil::CompileShader(L"Shaders\\Composite.hlsl", nullptr, "PS", "ps_5_0");
-    mShaders["sobelCS"] = d3dUtil::CompileShader(L"Shaders\\Sobel.hlsl", nullptr, "SobelCS", "cs_5_0");
+    Add("compositePS", "Composite_PS");
+    Add("sobelCS", "Sobel_CS");
 
-    // mShaders["cloudVS"] = d3dUtil::CompileShader(L"Shaders\\Cloud.hlsl", nullptr, "VS", "vs_5_0");
-    mShaders["cloudPS"] = d3dUtil::CompileShader(L"Shaders\\Cloud.hlsl", nullptr, "PS", "ps_5_0");
+    Add("cloudPS", "Cloud_PS");
 
-    mShaders["vxgiPS"] = d3dUtil::CompileShader(L"Shaders\\VXGI.hlsl", nullptr, "PS", "ps_5_0");
+    Add("vxgiPS", "VXGI_PS");
+    Add("compositeVXGIPS", "CompositeVXGI_PS");
 
-    mShaders["mipmapCS"] = d3dUtil::CompileShader(L"Shaders\\GenerateMip.hlsl", nullptr, "CS", "cs_5_0");
-    mShaders["mipmap3DCS"] = d3dUtil::CompileShader(L"Shaders\\GenerateMip3D.hlsl", nullptr, "CS", "cs_5_0");
-    mShaders["hizCS"] = d3dUtil::CompileShader(L"Shaders\\GenerateHiz.hlsl", nullptr, "CS", "cs_5_0");
+    Add("mipmapCS", "GenerateMip_CS");
+    Add("mipmap3DCS", "GenerateMip3D_CS");
+    AddPermutation("anisoMipmap3DCS", "GenerateAnisoMip3D_CS", {});
+    Add("hizCS", "GenerateHiz_CS");
 
-    mShaders["blitVS"] = d3dUtil::CompileShader(L"Shaders\\Blit.hlsl", nullptr, "VS", "vs_5_0");
-    mShaders["blitPS"] = d3dUtil::CompileShader(L"Shaders\\Blit.hlsl", nullptr, "PS", "ps_5_0");
+    AddPermutation("taaPS", "TAA_PS", {});
 
-}
\ No newline at end of file
+    Add("WorldProbeCS", "WorldProbe_CS");
+    AddPermutation("WorldProbePS", "UpdateProbe_PS", {});
+    Add("ProbeToSHCS", "ProbeToSH_CS");
+
+    Add("ProbegiPS", "ProbeGI_PS");
+
+    Add("ProbeNDPS", "ScreenProbeND_PS");
+    Add("ScreenDIPS", "ScreenDI_PS");
+    // Cone traces through the anisotropic mips.
+    AddPermutation("VoxelDIPS", "VoxelDI_PS", { { "VOXEL_ANISO", 1 } });
+    AddPermutation("ProbeDIPS", "ProbeDI_PS", {});
+    Add("ScreenProbeCS", "ScreenProbeToSH_CS");
+    AddPermutation("ReflectionPS", "Reflection_PS", {});
+    Add("CompositeDIPS", "CompositeDI_PS");
+}
@@ -1,24 +1,120 @@
 #pragma once
 
 #include "../D3D/d3dUtil.h"
+#include "NameTable.h"
+#include "ShaderArchive.h"
+#include "ShaderPermutation.h"
+#include "ShaderWatcher.h"
 
+// Lights a scene fills in PassConstants::Lights, in that order. The defaults and maxima are
+// the NUM_*_LIGHTS #defines and the features declared for the lit shaders.
+struct LampLightCounts
+{
+    static const UINT MaxDirectional = 3;
+    static const UINT MaxPoint = 4;
+    static const UINT MaxSpot = 4;
+
+    UINT Directional = 3;
+    UINT Point = 0;
+    UINT Spot = 0;
+};
+
+// Shaders are registered by name at startup and read on first use: from
+// Shaders\cso\Shaders.lsa when it holds them, mapped once and used in place,
+// otherwise from the loose .cso. Permutations are compiled in the background
+// as soon as they are registered, through a disk cache in Shaders\cache.
+// Sources under Shaders and what they include are watched: an edited shader is
+// compiled again in the background and swapped in by ApplyReloads().
 class LampShader
 {
 public:
     LampShader(Microsoft::WRL::ComPtr <ID3D12Device> d3dDevice);
     LampShader(const LampShader& rhs) = delete;
     LampShader& operator=(const LampShader& rhs) = delete;
-    ~LampShader() = default;
+    ~LampShader();
+
+    // Invalid when no shader of that name was registered.
+    ShaderId FindShader(const std::string& name)const;
+    // Load the shader if this is its first use.
+    LPVOID GetShader(ShaderId id)const;
+    SIZE_T GetSize(ShaderId id)const;
+    // Throw std::out_of_range for a shader that was not registered.
+    LPVOID GetShader(const std::string& name)const;
+    SIZE_T GetSize(const std::string& name)const;
+
+    // Registers name as a permutation of a declared shader, e.g. ("DeferLightingPS", "DeferLighting_PS",
+    // {{"NUM_DIR_LIGHTS", 1}}), and starts compiling it. Throws std::out_of_range for an undeclared
+    // shader or feature. Like the PSO ids, called while passes are built, not while they record.
+    ShaderId AddPermutation(const std::string& name, const std::string& shader,
+        const std::vector<std::pair<std::string, UINT>>& values);
+    // Registers the permutation of a declared shader that loops over exactly these lights, named
+    // after name and the counts, and returns that name; name itself, the prebuilt shader, for the
+    // default counts. Throws std::out_of_range for counts above the maxima.
+    std::string AddLightPermutation(const std::string& name, const std::string& shader, const LampLightCounts& lights);
+
+    // Hot reload, called between frames while nothing records or builds pipelines. Swaps in the
+    // shaders compiled since the last call and returns their ids; what GetShader() returned for
+    // them before is invalid afterwards. A shader that fails to compile keeps its old code.
+    std::vector<ShaderId> ApplyReloads();
 
-    LPVOID GetShader(std::string name);
-    SIZE_T GetSize(std::string name);
+    std::wstring Report()const;
 
 private:
+    struct Source
+    {
+        // Stem of the .cso and archive key, e.g. "Default_VS"; empty for a permutation.
+        std::string Cso;
+        PermutationKey Permutation = 0;
+        // The declared shader it is compiled from, UINT_MAX when its source is unknown.
+        std::uint32_t Declared = UINT_MAX;
+    };
+
+    struct Loaded
+    {
+        bool Ready = false;
+        LPVOID Data = nullptr;
+        SIZE_T Size = 0;
+        // Holds the bytes when they are not in the archive.
+        Microsoft::WRL::ComPtr<ID3DBlob> Blob;
+    };
+
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
 
-    std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> mShaders;
+    LampNameTable<std::string, ShaderTag> mNames;
+    // Both indexed by ShaderId.
+    std::vector<Source> mSources;
+    mutable std::vector<Loaded> mLoaded;
+    mutable std::mutex mMutex;
+
+    HANDLE mArchiveFile = INVALID_HANDLE_VALUE;
+    HANDLE mArchiveMapping = nullptr;
+    const void* mArchiveView = nullptr;
+    LampShaderArchive mArchive;
+
+    std::unique_ptr<LampShaderPermutations> mPermutations;
+    // Declared shaders by the name of their cso.
+    std::unordered_map<std::string, std::uint32_t> mDeclared;
+
+    mutable UINT mFromArchive = 0;
+    mutable UINT mFromFile = 0;
+    mutable UINT mFromPermutations = 0;
+    mutable float mLoadMs = 0.0f;
+
+    HANDLE mChangeNotification = INVALID_HANDLE_VALUE;
+    std::unique_ptr<LampShaderWatcher> mWatcher;
+    // Prebuilt shaders whose source was edited, waiting for their first compile.
+    std::vector<std::pair<ShaderId, PermutationKey>> mSwitching;
+    UINT mReloaded = 0;
+    UINT mReloadsFailed = 0;
 
-    void LoadShaders();
-    void CompileShaders();
-    void LoadBlobs();
-};
\ No newline at end of file
+    ShaderId Registered(const std::string& name)const;
+    const Loaded& Load(ShaderId id)const;
+    void Add(const std::string& name, const std::string& cso);
+    void Declare(const std::string& cso, const std::wstring& hlsl, const std::string& entry, const std::string& target,
+        const std::vector<LampShaderFeature>& features);
+    void DeclarePermutations();
+    void RegisterShaders();
+    // Declares the source of each prebuilt shader, found by the name of its cso, and watches them all.
+    void WatchSources();
+    void OpenArchive(const std::wstring& path);
+};
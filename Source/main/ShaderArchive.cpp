@@ -0,0 +1,159 @@
+#include "ShaderArchive.h"
+#include <algorithm>
+#include <cstring>
+
+constexpr std::uint32_t LampShaderArchive::Magic;
+constexpr std::uint32_t LampShaderArchive::Version;
+constexpr std::uint32_t LampShaderArchive::BlobAlignment;
+
+namespace
+{
+    std::uint64_t Align(std::uint64_t offset, std::uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+std::uint64_t LampShaderArchive::Hash(const std::string& name)
+{
+    // FNV-1a.
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : name)
+    {
+        hash ^= (std::uint8_t)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::vector<std::uint8_t> LampShaderArchive::Pack(
+    const std::vector<std::pair<std::string, std::vector<std::uint8_t>>>& blobs)
+{
+    std::vector<Entry> entries(blobs.size());
+    std::string names;
+    for (std::size_t i = 0; i < blobs.size(); ++i)
+    {
+        entries[i].Hash = Hash(blobs[i].first);
+        entries[i].NameOffset = (std::uint32_t)names.size();
+        entries[i].NameLength = (std::uint32_t)blobs[i].first.size();
+        entries[i].BlobSize = blobs[i].second.size();
+        names += blobs[i].first;
+    }
+
+    std::uint64_t offset = Align(sizeof(Header) + entries.size() * sizeof(Entry) + names.size(), BlobAlignment);
+    for (auto& e : entries)
+    {
+        e.BlobOffset = offset;
+        offset = Align(offset + e.BlobSize, BlobAlignment);
+    }
+
+    std::vector<std::uint8_t> archive((std::size_t)offset, 0);
+    for (std::size_t i = 0; i < blobs.size(); ++i)
+    {
+        if (!blobs[i].second.empty())
+            std::memcpy(&archive[(std::size_t)entries[i].BlobOffset], blobs[i].second.data(), blobs[i].second.size());
+    }
+
+    // Sorted once the blobs are placed, so the index is searchable and the blobs stay in input order.
+    std::sort(entries.begin(), entries.end(), [&](const Entry& a, const Entry& b)
+    {
+        if (a.Hash != b.Hash)
+            return a.Hash < b.Hash;
+        return names.compare(a.NameOffset, a.NameLength, names, b.NameOffset, b.NameLength) < 0;
+    });
+
+    Header header = { Magic, Version, (std::uint32_t)entries.size(), (std::uint32_t)names.size(), offset };
+    std::memcpy(archive.data(), &header, sizeof(Header));
+    if (!entries.empty())
+        std::memcpy(&archive[sizeof(Header)], entries.data(), entries.size() * sizeof(Entry));
+    if (!names.empty())
+        std::memcpy(&archive[sizeof(Header) + entries.size() * sizeof(Entry)], names.data(), names.size());
+    return archive;
+}
+
+bool LampShaderArchive::Open(const void* data, std::size_t size, std::string& error)
+{
+    mData = nullptr;
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mNames = nullptr;
+
+    auto bytes = static_cast<const std::uint8_t*>(data);
+    if (bytes == nullptr || size < sizeof(Header))
+    {
+        error = "shorter than the header";
+        return false;
+    }
+    auto header = reinterpret_cast<const Header*>(bytes);
+    if (header->Magic != Magic || header->Version != Version)
+    {
+        error = "not a version " + std::to_string(Version) + " shader archive";
+        return false;
+    }
+    if (header->Size != size)
+    {
+        error = "size does not match the header";
+        return false;
+    }
+
+    const std::uint64_t namesOffset = sizeof(Header) + (std::uint64_t)header->Count * sizeof(Entry);
+    if (namesOffset + header->NamesSize > size)
+    {
+        error = "index runs past the end";
+        return false;
+    }
+    auto entries = reinterpret_cast<const Entry*>(bytes + sizeof(Header));
+    for (std::uint32_t i = 0; i < header->Count; ++i)
+    {
+        const Entry& e = entries[i];
+        if ((std::uint64_t)e.NameOffset + e.NameLength > header->NamesSize
+            || e.BlobOffset > size || e.BlobSize > size - e.BlobOffset
+            || e.BlobOffset % BlobAlignment != 0)
+        {
+            error = "entry " + std::to_string(i) + " out of bounds";
+            return false;
+        }
+        if (i > 0 && entries[i - 1].Hash > e.Hash)
+        {
+            error = "index not sorted";
+            return false;
+        }
+    }
+
+    mData = bytes;
+    mHeader = header;
+    mEntries = entries;
+    mNames = reinterpret_cast<const char*>(bytes + namesOffset);
+    return true;
+}
+
+std::uint32_t LampShaderArchive::Count()const
+{
+    return mHeader != nullptr ? mHeader->Count : 0;
+}
+
+std::string LampShaderArchive::Name(std::uint32_t index)const
+{
+    return std::string(mNames + mEntries[index].NameOffset, mEntries[index].NameLength);
+}
+
+LampShaderArchive::Blob LampShaderArchive::Find(const std::string& name)const
+{
+    Blob blob;
+    if (mHeader == nullptr)
+        return blob;
+
+    const std::uint64_t hash = Hash(name);
+    const Entry* end = mEntries + mHeader->Count;
+    auto it = std::lower_bound(mEntries, end, hash, [](const Entry& e, std::uint64_t h) { return e.Hash < h; });
+    for (; it != end && it->Hash == hash; ++it)
+    {
+        if (it->NameLength == name.size() && std::memcmp(mNames + it->NameOffset, name.data(), name.size()) == 0)
+        {
+            blob.Data = mData + it->BlobOffset;
+            blob.Size = (std::size_t)it->BlobSize;
+            break;
+        }
+    }
+    return blob;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One file holding every compiled shader: a header, an index sorted by name hash,
+// the names, then the blobs, each aligned to BlobAlignment. Read in place from a
+// mapped view; written by Tools/ShaderPacker. Needs nothing from Windows or D3D.
+class LampShaderArchive
+{
+public:
+    static constexpr std::uint32_t Magic = 0x3141534C; // "LSA1"
+    static constexpr std::uint32_t Version = 1;
+    static constexpr std::uint32_t BlobAlignment = 16;
+
+    struct Header
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        std::uint32_t Count;
+        std::uint32_t NamesSize;
+        std::uint64_t Size;
+    };
+
+    struct Entry
+    {
+        std::uint64_t Hash;
+        std::uint32_t NameOffset;
+        std::uint32_t NameLength;
+        std::uint64_t BlobOffset;
+        std::uint64_t BlobSize;
+    };
+
+    struct Blob
+    {
+        const void* Data = nullptr;
+        std::size_t Size = 0;
+    };
+
+    LampShaderArchive() = default;
+    LampShaderArchive(const LampShaderArchive& rhs) = delete;
+    LampShaderArchive& operator=(const LampShaderArchive& rhs) = delete;
+    ~LampShaderArchive() = default;
+
+    // Checks the header and that every entry lies inside data, which must outlive the archive.
+    // On failure the archive stays empty and error says why.
+    bool Open(const void* data, std::size_t size, std::string& error);
+    bool IsOpen()const { return mHeader != nullptr; }
+    std::uint32_t Count()const;
+
+    // Binary search on the name hash; a Blob with no data when the name is not in the archive.
+    Blob Find(const std::string& name)const;
+    std::string Name(std::uint32_t index)const;
+
+    static std::uint64_t Hash(const std::string& name);
+    // Names must be unique.
+    static std::vector<std::uint8_t> Pack(const std::vector<std::pair<std::string, std::vector<std::uint8_t>>>& blobs);
+
+private:
+    const std::uint8_t* mData = nullptr;
+    const Header* mHeader = nullptr;
+    const Entry* mEntries = nullptr;
+    const char* mNames = nullptr;
+};
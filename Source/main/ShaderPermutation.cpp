@@ -0,0 +1,424 @@
+#include "ShaderPermutation.h"
+#include "ShaderArchive.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+namespace
+{
+    const std::uint32_t CacheMagic = 0x3143504C; // "LPC1"
+    const std::uint32_t CacheVersion = 1;
+
+    struct CacheHeader
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        std::uint64_t Key;
+        std::uint64_t SourceHash;
+        std::uint64_t Size;
+    };
+
+    std::string Hex(std::uint64_t value)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+        return text;
+    }
+
+    std::uint64_t HashFile(const std::string& path, std::set<std::string>& visited)
+    {
+        if (!visited.insert(path).second)
+            return 0;
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return 0;
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // The includes' hashes are appended, so editing an included file changes this one's.
+        std::string combined = text;
+        for (auto& include : LampShaderPermutations::Includes(path, text))
+            combined += Hex(HashFile(include, visited));
+        return LampShaderArchive::Hash(combined);
+    }
+}
+
+LampPermutationCache::LampPermutationCache(const std::string& directory) : mDirectory(directory)
+{
+    if (!mDirectory.empty() && mDirectory.back() != '/' && mDirectory.back() != '\\')
+        mDirectory += '/';
+}
+
+std::string LampPermutationCache::Path(PermutationKey key)const
+{
+    return mDirectory + Hex(key) + ".bin";
+}
+
+bool LampPermutationCache::Load(PermutationKey key, std::uint64_t sourceHash, std::vector<std::uint8_t>& blob)const
+{
+    std::ifstream file(Path(key), std::ios::binary);
+    CacheHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    if (header.Magic != CacheMagic || header.Version != CacheVersion || header.Key != key
+        || header.SourceHash != sourceHash || header.Size > (1ull << 30))
+        return false;
+
+    blob.resize((std::size_t)header.Size);
+    if (header.Size > 0 && !file.read(reinterpret_cast<char*>(blob.data()), (std::streamsize)header.Size))
+        return false;
+    // Trailing bytes mean the file is not what this header describes.
+    return file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool LampPermutationCache::Store(PermutationKey key, std::uint64_t sourceHash, const std::vector<std::uint8_t>& blob)const
+{
+    const std::string path = Path(key);
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        CacheHeader header = { CacheMagic, CacheVersion, key, sourceHash, blob.size() };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!blob.empty())
+            file.write(reinterpret_cast<const char*>(blob.data()), (std::streamsize)blob.size());
+        if (!file)
+        {
+            file.close();
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    // rename() does not replace an existing file on Windows.
+    std::remove(path.c_str());
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+void LampPermutationCache::Remove(PermutationKey key)const
+{
+    std::remove(Path(key).c_str());
+}
+
+LampShaderPermutations::LampShaderPermutations(const std::string& cacheDirectory, Compiler compiler, LampThreadPool& pool)
+    : mCache(cacheDirectory), mCompiler(std::move(compiler)), mPool(pool)
+{
+}
+
+LampShaderPermutations::~LampShaderPermutations()
+{
+    // The pool jobs still queued hold this; they return at once from now on.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mQuit = true;
+    mQueue.clear();
+    mIdle.wait(lock, [this] { return mSubmitted == 0; });
+}
+
+std::uint32_t LampShaderPermutations::Declare(const LampShaderDesc& desc)
+{
+    return Declare(desc, SourceHash(desc.File));
+}
+
+std::uint32_t LampShaderPermutations::Declare(const LampShaderDesc& desc, std::uint64_t sourceHash)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mShaders.push_back({ desc, sourceHash });
+    return (std::uint32_t)mShaders.size() - 1;
+}
+
+std::string LampShaderPermutations::File(std::uint32_t shader)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mShaders.at(shader).Desc.File;
+}
+
+PermutationKey LampShaderPermutations::Key(const LampShaderDesc& desc, const std::vector<std::uint32_t>& values)
+{
+    std::string text = desc.File + "|" + desc.Entry + "|" + desc.Target;
+    for (std::size_t i = 0; i < desc.Features.size(); ++i)
+        text += "|" + desc.Features[i].Name + "=" + std::to_string(values[i]);
+    return LampShaderArchive::Hash(text);
+}
+
+ShaderDefines LampShaderPermutations::Defines(const LampShaderDesc& desc, const std::vector<std::uint32_t>& values)
+{
+    ShaderDefines defines;
+    for (std::size_t i = 0; i < desc.Features.size(); ++i)
+    {
+        const LampShaderFeature& f = desc.Features[i];
+        if (f.Toggle && values[i] == 0)
+            continue;
+        defines.push_back({ f.Name, std::to_string(values[i]) });
+    }
+    return defines;
+}
+
+std::uint64_t LampShaderPermutations::SourceHash(const std::string& path)
+{
+    std::set<std::string> visited;
+    return HashFile(path, visited);
+}
+
+std::vector<std::string> LampShaderPermutations::Includes(const std::string& path, const std::string& text)
+{
+    const std::size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+    std::vector<std::string> includes;
+    std::size_t pos = 0;
+    while ((pos = text.find("#include", pos)) != std::string::npos)
+    {
+        pos += 8;
+        std::size_t open = text.find_first_not_of(" \t", pos);
+        if (open == std::string::npos || text[open] != '"')
+            continue;
+        std::size_t close = text.find('"', open + 1);
+        if (close == std::string::npos)
+            break;
+        includes.push_back(directory + text.substr(open + 1, close - open - 1));
+        pos = close;
+    }
+    return includes;
+}
+
+PermutationKey LampShaderPermutations::Request(std::uint32_t shader,
+    const std::vector<std::pair<std::string, std::uint32_t>>& values)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    const LampShaderDesc& desc = mShaders.at(shader).Desc;
+
+    std::vector<std::uint32_t> resolved(desc.Features.size());
+    for (std::size_t i = 0; i < desc.Features.size(); ++i)
+        resolved[i] = desc.Features[i].Default;
+    for (auto& v : values)
+    {
+        auto f = std::find_if(desc.Features.begin(), desc.Features.end(),
+            [&](const LampShaderFeature& feature) { return feature.Name == v.first; });
+        if (f == desc.Features.end())
+            throw std::out_of_range("Shader " + desc.File + " " + desc.Entry + " has no feature " + v.first);
+        if (v.second > f->Max)
+            throw std::out_of_range("Shader feature " + v.first + " above " + std::to_string(f->Max));
+        resolved[f - desc.Features.begin()] = v.second;
+    }
+
+    const PermutationKey key = Key(desc, resolved);
+    mStats.Requests++;
+    auto found = mPermutations.find(key);
+    if (found != mPermutations.end())
+    {
+        mStats.MemoryHits++;
+        return key;
+    }
+
+    Permutation& p = mPermutations[key];
+    p.Shader = shader;
+    p.Values = resolved;
+    mQueue.push_back({ key, false });
+    lock.unlock();
+    Submit(1);
+    return key;
+}
+
+const std::vector<std::uint8_t>* LampShaderPermutations::Find(PermutationKey key)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto found = mPermutations.find(key);
+    if (found == mPermutations.end() || found->second.Status != State::Ready)
+        return nullptr;
+    return &found->second.Blob;
+}
+
+const std::vector<std::uint8_t>* LampShaderPermutations::Wait(PermutationKey key, std::string* log)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto found = mPermutations.find(key);
+    if (found == mPermutations.end())
+        return nullptr;
+    const Permutation& p = found->second;
+
+    // The pool job submitted for it then takes the next one.
+    auto queued = std::find_if(mQueue.begin(), mQueue.end(),
+        [&](const Job& job) { return job.Key == key && !job.Reload; });
+    if (queued != mQueue.end())
+    {
+        const Job job = *queued;
+        mQueue.erase(queued);
+        lock.unlock();
+        Compile(job);
+        lock.lock();
+    }
+    mReady.wait(lock, [&] { return p.Status != State::Queued; });
+    if (log != nullptr)
+        *log = p.Log;
+    return p.Status == State::Ready ? &p.Blob : nullptr;
+}
+
+bool LampShaderPermutations::Done(PermutationKey key)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto found = mPermutations.find(key);
+    return found != mPermutations.end() && found->second.Status != State::Queued;
+}
+
+std::uint32_t LampShaderPermutations::Reload(std::uint32_t shader)
+{
+    return Reload(shader, SourceHash(File(shader)));
+}
+
+std::uint32_t LampShaderPermutations::Reload(std::uint32_t shader, std::uint64_t sourceHash)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    Declared& declared = mShaders.at(shader);
+    if (declared.SourceHash == sourceHash)
+        return 0;
+    declared.SourceHash = sourceHash;
+
+    // One still on its first compile reads the new hash when it starts.
+    std::uint32_t queued = 0;
+    for (auto& entry : mPermutations)
+    {
+        Permutation& p = entry.second;
+        if (p.Shader != shader || p.Status == State::Queued)
+            continue;
+        p.Generation++;
+        mQueue.push_back({ entry.first, true });
+        queued++;
+    }
+    lock.unlock();
+    Submit(queued);
+    return queued;
+}
+
+std::vector<PermutationReload> LampShaderPermutations::TakeReloaded()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<PermutationReload> reloaded;
+    for (auto& entry : mPermutations)
+    {
+        Permutation& p = entry.second;
+        if (!p.NextDone)
+            continue;
+        p.NextDone = false;
+
+        PermutationReload r;
+        r.Key = entry.first;
+        r.Compiled = p.NextCompiled;
+        r.Log = std::move(p.NextLog);
+        if (p.NextCompiled)
+        {
+            p.Blob = std::move(p.Next);
+            p.Log = r.Log;
+            p.Status = State::Ready;
+        }
+        p.Next.clear();
+        reloaded.push_back(std::move(r));
+    }
+    return reloaded;
+}
+
+PermutationStats LampShaderPermutations::Stats()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void LampShaderPermutations::Submit(std::uint32_t jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSubmitted += jobs;
+    }
+    for (std::uint32_t i = 0; i < jobs; ++i)
+        mPool.Submit([this] { RunQueued(); });
+}
+
+void LampShaderPermutations::RunQueued()
+{
+    Job job;
+    bool taken = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQuit && !mQueue.empty())
+        {
+            job = mQueue.front();
+            mQueue.pop_front();
+            taken = true;
+        }
+    }
+    if (taken)
+        Compile(job);
+
+    // Notified under the lock: the destructor may go ahead the moment it is released.
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (--mSubmitted == 0)
+        mIdle.notify_all();
+}
+
+void LampShaderPermutations::Compile(const Job& job)
+{
+    const PermutationKey key = job.Key;
+    LampShaderDesc desc;
+    std::vector<std::uint32_t> values;
+    std::uint64_t sourceHash;
+    std::uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const Permutation& p = mPermutations.at(key);
+        desc = mShaders[p.Shader].Desc;
+        sourceHash = mShaders[p.Shader].SourceHash;
+        values = p.Values;
+        generation = p.Generation;
+    }
+
+    std::vector<std::uint8_t> blob;
+    std::string log;
+    bool disk = mCache.Load(key, sourceHash, blob);
+    bool ok = disk;
+    float ms = 0.0f;
+    if (!disk)
+    {
+        blob.clear();
+        auto t0 = Clock::now();
+        ok = mCompiler(desc, Defines(desc, values), blob, log);
+        ms = std::chrono::duration<float, std::milli>(Clock::now() - t0).count();
+        if (ok)
+            mCache.Store(key, sourceHash, blob);
+    }
+
+    if (job.Reload)
+    {
+        // Parked until TakeReloaded(); the blob in use is not touched here.
+        std::lock_guard<std::mutex> lock(mMutex);
+        Permutation& p = mPermutations.at(key);
+        if (generation >= p.NextGeneration)
+        {
+            p.NextGeneration = generation;
+            p.NextDone = true;
+            p.NextCompiled = ok;
+            p.Next = std::move(blob);
+            p.NextLog = std::move(log);
+        }
+        mStats.DiskHits += disk ? 1 : 0;
+        mStats.Compiled += !disk && ok ? 1 : 0;
+        mStats.Failed += ok ? 0 : 1;
+        mStats.Reloaded++;
+        mStats.CompileMs += ms;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Permutation& p = mPermutations.at(key);
+        p.Blob = std::move(blob);
+        p.Log = std::move(log);
+        p.Status = ok ? State::Ready : State::Failed;
+        mStats.DiskHits += disk ? 1 : 0;
+        mStats.Compiled += !disk && ok ? 1 : 0;
+        mStats.Failed += ok ? 0 : 1;
+        mStats.CompileMs += ms;
+    }
+    mReady.notify_all();
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One define a shader can be specialized on.
+struct LampShaderFeature
+{
+    std::string Name;
+    std::uint32_t Default = 0;
+    std::uint32_t Max = 1;
+    // Tested with #ifdef: defined as 1 when on, left out when off.
+    bool Toggle = false;
+};
+
+// A shader entry point and the features it declares.
+struct LampShaderDesc
+{
+    std::string File;
+    std::string Entry;
+    std::string Target;
+    std::vector<LampShaderFeature> Features;
+};
+
+typedef std::uint64_t PermutationKey;
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// Compiled shaders on disk, one file per permutation key, tagged with the hash
+// of the source they were compiled from so that edited shaders miss.
+class LampPermutationCache
+{
+public:
+    LampPermutationCache(const std::string& directory);
+    LampPermutationCache(const LampPermutationCache& rhs) = delete;
+    LampPermutationCache& operator=(const LampPermutationCache& rhs) = delete;
+    ~LampPermutationCache() = default;
+
+    // False when the file is missing, damaged or from other source.
+    bool Load(PermutationKey key, std::uint64_t sourceHash, std::vector<std::uint8_t>& blob)const;
+    // Written to a temporary file and renamed, so a reader never sees half of one.
+    bool Store(PermutationKey key, std::uint64_t sourceHash, const std::vector<std::uint8_t>& blob)const;
+    void Remove(PermutationKey key)const;
+    std::string Path(PermutationKey key)const;
+
+private:
+    std::string mDirectory;
+};
+
+struct PermutationStats
+{
+    std::uint32_t Requests = 0;
+    std::uint32_t MemoryHits = 0;
+    std::uint32_t DiskHits = 0;
+    std::uint32_t Compiled = 0;
+    std::uint32_t Failed = 0;
+    std::uint32_t Reloaded = 0;
+    float CompileMs = 0.0f;
+};
+
+// A permutation compiled again after its source changed.
+struct PermutationReload
+{
+    PermutationKey Key = 0;
+    // False when the new source did not compile; the old blob stays.
+    bool Compiled = false;
+    std::string Log;
+};
+
+// Shaders declare their features once; each requested combination is hashed to a
+// PermutationKey, looked up in memory, then on disk, and compiled as a background
+// job of the thread pool only when both miss. Needs nothing from Windows or D3D:
+// the compiler is passed in.
+class LampShaderPermutations
+{
+public:
+    // Fills blob or log; called on the pool's background thread and on threads in Wait().
+    typedef std::function<bool(const LampShaderDesc& desc, const ShaderDefines& defines,
+        std::vector<std::uint8_t>& blob, std::string& log)> Compiler;
+
+    LampShaderPermutations(const std::string& cacheDirectory, Compiler compiler,
+        LampThreadPool& pool = LampThreadPool::Default());
+    LampShaderPermutations(const LampShaderPermutations& rhs) = delete;
+    LampShaderPermutations& operator=(const LampShaderPermutations& rhs) = delete;
+    // Queued compiles are dropped; waits until the pool has finished the one in progress
+    // and let go of the jobs submitted for the others. Not to be called from a background job.
+    ~LampShaderPermutations();
+
+    // sourceHash tags the disk cache; SourceHash() of the file by default.
+    std::uint32_t Declare(const LampShaderDesc& desc);
+    std::uint32_t Declare(const LampShaderDesc& desc, std::uint64_t sourceHash);
+    std::string File(std::uint32_t shader)const;
+
+    // Features left out take their default. Throws std::out_of_range for a feature the
+    // shader did not declare or a value above its Max. Returns at once; a miss is queued.
+    PermutationKey Request(std::uint32_t shader, const std::vector<std::pair<std::string, std::uint32_t>>& values);
+    // Null while compiling and when the compile failed.
+    const std::vector<std::uint8_t>* Find(PermutationKey key)const;
+    // Blocks until the permutation is ready; null when it failed, with the compiler's log.
+    // One not started yet is compiled on the caller instead of behind other background jobs.
+    const std::vector<std::uint8_t>* Wait(PermutationKey key, std::string* log = nullptr);
+    // Compiled or failed, so Wait() would not block.
+    bool Done(PermutationKey key)const;
+
+    // Hot reload. Takes the shader's new source hash, SourceHash() of the file by default; when it
+    // changed, every permutation of the shader that has compiled is compiled again in the background
+    // while its current blob stays in use. Returns how many were queued.
+    std::uint32_t Reload(std::uint32_t shader);
+    std::uint32_t Reload(std::uint32_t shader, std::uint64_t sourceHash);
+    // Reloads finished since the last call. A compiled one replaces its permutation's blob, so
+    // pointers to the blobs of these keys are invalid afterwards: call it while nothing reads them.
+    std::vector<PermutationReload> TakeReloaded();
+
+    PermutationStats Stats()const;
+
+    // Over the declared values in order, so equal requests hash alike however they are written.
+    static PermutationKey Key(const LampShaderDesc& desc, const std::vector<std::uint32_t>& values);
+    static ShaderDefines Defines(const LampShaderDesc& desc, const std::vector<std::uint32_t>& values);
+    // The file and every file it #includes with quotes, resolved next to the includer.
+    static std::uint64_t SourceHash(const std::string& path);
+    // Files that text, read from path, #includes with quotes, resolved next to path.
+    static std::vector<std::string> Includes(const std::string& path, const std::string& text);
+
+private:
+    struct Declared
+    {
+        LampShaderDesc Desc;
+        std::uint64_t SourceHash;
+    };
+
+    enum class State
+    {
+        Queued,
+        Ready,
+        Failed
+    };
+
+    struct Permutation
+    {
+        State Status = State::Queued;
+        std::uint32_t Shader = 0;
+        std::vector<std::uint32_t> Values;
+        std::vector<std::uint8_t> Blob;
+        std::string Log;
+
+        // Bumped by each Reload(); a reload that finishes behind a newer one is dropped.
+        std::uint32_t Generation = 0;
+        std::uint32_t NextGeneration = 0;
+        bool NextDone = false;
+        bool NextCompiled = false;
+        std::vector<std::uint8_t> Next;
+        std::string NextLog;
+    };
+
+    struct Job
+    {
+        PermutationKey Key;
+        bool Reload;
+    };
+
+    // Each queued job has one pool job submitted for it, which takes the front of mQueue.
+    void Submit(std::uint32_t jobs);
+    void RunQueued();
+    void Compile(const Job& job);
+
+    LampPermutationCache mCache;
+    Compiler mCompiler;
+    LampThreadPool& mPool;
+    std::vector<Declared> mShaders;
+
+    mutable std::mutex mMutex;
+    mutable std::condition_variable mReady;
+    std::condition_variable mIdle;
+    // Node-based, so a blob handed out stays put while others are added.
+    std::unordered_map<PermutationKey, Permutation> mPermutations;
+    std::deque<Job> mQueue;
+    PermutationStats mStats;
+    // Pool jobs submitted that have not returned yet.
+    std::uint32_t mSubmitted = 0;
+    bool mQuit = false;
+};
@@ -0,0 +1,169 @@
+#include "ShaderWatcher.h"
+#include "ShaderArchive.h"
+#include "ShaderPermutation.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    bool ReadFile(const std::string& path, std::string& text)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        text.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return true;
+    }
+}
+
+LampShaderWatcher::LampShaderWatcher(std::uint32_t pollMs, Wait wait) : mPollMs(pollMs), mWait(std::move(wait))
+{
+}
+
+LampShaderWatcher::~LampShaderWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mQuitMutex);
+        mQuit = true;
+    }
+    mQuitSignal.notify_all();
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void LampShaderWatcher::Watch(const std::string& path, std::uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRoots.push_back({ path, id });
+    Track(path);
+}
+
+void LampShaderWatcher::Track(const std::string& path)
+{
+    if (mFiles.count(path) != 0)
+        return;
+    File& file = mFiles[path];
+    std::string text;
+    file.Exists = ReadFile(path, text);
+    file.Hash = LampShaderArchive::Hash(text);
+    file.Includes = LampShaderPermutations::Includes(path, text);
+    // Copied: Track() may add to mFiles.
+    const std::vector<std::string> includes = file.Includes;
+    for (auto& include : includes)
+        Track(include);
+}
+
+void LampShaderWatcher::Start()
+{
+    assert(!mThread.joinable());
+    mThread = std::thread(&LampShaderWatcher::PollLoop, this);
+}
+
+void LampShaderWatcher::PollLoop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mQuitMutex);
+            if (mQuit)
+                return;
+            if (!mWait)
+                mQuitSignal.wait_for(lock, std::chrono::milliseconds(mPollMs), [&] { return mQuit; });
+        }
+        if (mWait)
+            mWait(mPollMs);
+        Poll();
+    }
+}
+
+void LampShaderWatcher::Poll()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::set<std::string> changed;
+    std::vector<std::string> added;
+    for (auto& entry : mFiles)
+    {
+        File& file = entry.second;
+        std::string text;
+        const bool exists = ReadFile(entry.first, text);
+        const std::uint64_t hash = LampShaderArchive::Hash(text);
+
+        if (exists == file.Exists && hash == file.Hash)
+        {
+            file.Pending = false;
+            continue;
+        }
+        if (!file.Pending || file.PendingExists != exists || file.PendingHash != hash)
+        {
+            // Possibly half written: wait for the next poll to read the same.
+            file.Pending = true;
+            file.PendingExists = exists;
+            file.PendingHash = hash;
+            continue;
+        }
+
+        file.Pending = false;
+        file.Exists = exists;
+        file.Hash = hash;
+        file.Includes = LampShaderPermutations::Includes(entry.first, text);
+        changed.insert(entry.first);
+        added.insert(added.end(), file.Includes.begin(), file.Includes.end());
+    }
+    if (changed.empty())
+        return;
+
+    // Newly included files are read now; they count as changed through their includer.
+    for (auto& path : added)
+        Track(path);
+
+    for (auto& root : mRoots)
+    {
+        std::set<std::string> files;
+        Closure(root.Path, files);
+        for (auto& path : changed)
+        {
+            if (files.count(path) != 0)
+            {
+                mChanged.insert(root.Id);
+                break;
+            }
+        }
+    }
+}
+
+void LampShaderWatcher::Closure(const std::string& path, std::set<std::string>& files)const
+{
+    if (!files.insert(path).second)
+        return;
+    auto file = mFiles.find(path);
+    if (file == mFiles.end())
+        return;
+    for (auto& include : file->second.Includes)
+        Closure(include, files);
+}
+
+std::vector<std::uint32_t> LampShaderWatcher::TakeChanged()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<std::uint32_t> changed(mChanged.begin(), mChanged.end());
+    mChanged.clear();
+    return changed;
+}
+
+std::vector<std::string> LampShaderWatcher::Dependencies(const std::string& path)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::set<std::string> files;
+    Closure(path, files);
+    return std::vector<std::string>(files.begin(), files.end());
+}
+
+std::uint32_t LampShaderWatcher::FileCount()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (std::uint32_t)mFiles.size();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches shader sources and every file they #include with quotes, and reports
+// which sources changed. A file counts as changed once its content differs from
+// what was last reported and has read the same on two polls in a row, so a save
+// that lands in several writes is reported once, whole.
+// Polls by content, with nothing from the OS; the owner can pass a wait that
+// wakes it early on a change notification.
+class LampShaderWatcher
+{
+public:
+    // Blocks for at most the given milliseconds, returning early when a file may have changed.
+    typedef std::function<void(std::uint32_t ms)> Wait;
+
+    // Sleeps between polls when wait is empty.
+    LampShaderWatcher(std::uint32_t pollMs = 250, Wait wait = Wait());
+    LampShaderWatcher(const LampShaderWatcher& rhs) = delete;
+    LampShaderWatcher& operator=(const LampShaderWatcher& rhs) = delete;
+    ~LampShaderWatcher();
+
+    // id is what TakeChanged() reports when path or anything it includes changes.
+    void Watch(const std::string& path, std::uint32_t id);
+    // Polls on a thread of its own until destroyed.
+    void Start();
+    // One poll on the caller's thread.
+    void Poll();
+
+    // Ids whose sources changed since the last call, in ascending order.
+    std::vector<std::uint32_t> TakeChanged();
+    // path and the files it includes, directly or not, as currently on disk.
+    std::vector<std::string> Dependencies(const std::string& path)const;
+    std::uint32_t FileCount()const;
+
+private:
+    struct File
+    {
+        bool Exists = false;
+        // Content last reported, and its includes.
+        std::uint64_t Hash = 0;
+        std::vector<std::string> Includes;
+        // Content seen on the last poll when it differs from Hash.
+        bool Pending = false;
+        bool PendingExists = false;
+        std::uint64_t PendingHash = 0;
+    };
+
+    struct Root
+    {
+        std::string Path;
+        std::uint32_t Id;
+    };
+
+    // Reads path, and what it includes the first time they are seen.
+    void Track(const std::string& path);
+    void Closure(const std::string& path, std::set<std::string>& files)const;
+    void PollLoop();
+
+    std::uint32_t mPollMs;
+    Wait mWait;
+
+    mutable std::mutex mMutex;
+    std::map<std::string, File> mFiles;
+    std::vector<Root> mRoots;
+    std::set<std::uint32_t> mChanged;
+
+    std::mutex mQuitMutex;
+    std::condition_variable mQuitSignal;
+    bool mQuit = false;
+    std::thread mThread;
+};
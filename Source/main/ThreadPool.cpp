@@ -0,0 +1,221 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+    // Set while a thread runs a pool task, so nested calls do not wait on themselves.
+    thread_local bool gInsideTask = false;
+}
+
+LampThreadPool::LampThreadPool(std::uint32_t numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max<std::uint32_t>(1u, std::thread::hardware_concurrency());
+
+    for (std::uint32_t i = 0; i < numThreads; ++i)
+        mQueues.push_back(std::make_unique<JobQueue>());
+    for (std::uint32_t i = 1; i < numThreads; ++i)
+        mWorkers.emplace_back(&LampThreadPool::WorkerLoop, this, i);
+}
+
+LampThreadPool::~LampThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mBackgroundMutex);
+        // The job running finishes; the ones queued behind it are dropped.
+        mBackgroundQuit = true;
+    }
+    mBackgroundWake.notify_all();
+    if (mBackground.joinable())
+        mBackground.join();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+    for (auto& w : mWorkers)
+        w.join();
+}
+
+LampThreadPool& LampThreadPool::Default()
+{
+    static LampThreadPool pool;
+    return pool;
+}
+
+void LampThreadPool::ParallelFor(std::uint32_t count, std::uint32_t grain, const std::function<void(std::uint32_t, std::uint32_t)>& func)
+{
+    grain = std::max<std::uint32_t>(1u, grain);
+    if (mWorkers.empty() || count <= grain || gInsideTask)
+    {
+        if (count > 0)
+            func(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> caller(mCallerMutex);
+    mNext = 0;
+    std::function<void(std::uint32_t)> task = [&](std::uint32_t) { RunChunks(func, count, grain); };
+    Run(task);
+}
+
+std::uint32_t LampThreadPool::RunJobs(std::uint32_t count, const std::function<void(std::uint32_t, std::uint32_t)>& func)
+{
+    if (mWorkers.empty() || count <= 1 || gInsideTask)
+    {
+        for (std::uint32_t job = 0; job < count; ++job)
+            func(job, 0);
+        return 0;
+    }
+
+    // Nobody is inside a task between two Run() calls, so the queues are free to fill.
+    std::lock_guard<std::mutex> caller(mCallerMutex);
+    for (std::uint32_t job = 0; job < count; ++job)
+        mQueues[job % mQueues.size()]->Jobs.push_back(job);
+    mSteals = 0;
+
+    std::function<void(std::uint32_t)> task = [&](std::uint32_t thread) { RunQueues(func, thread); };
+    Run(task);
+    return mSteals;
+}
+
+void LampThreadPool::Submit(const std::function<void()>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mBackgroundMutex);
+        mBackgroundJobs.push_back(job);
+        if (!mBackground.joinable())
+            mBackground = std::thread(&LampThreadPool::BackgroundLoop, this);
+    }
+    mBackgroundWake.notify_one();
+}
+
+void LampThreadPool::WaitBackground()
+{
+    std::unique_lock<std::mutex> lock(mBackgroundMutex);
+    mBackgroundDone.wait(lock, [this] { return mBackgroundJobs.empty(); });
+}
+
+void LampThreadPool::BackgroundLoop()
+{
+    // Never inside a loop of the pool, so everything the jobs call runs here.
+    gInsideTask = true;
+    std::unique_lock<std::mutex> lock(mBackgroundMutex);
+    while (true)
+    {
+        mBackgroundWake.wait(lock, [this] { return mBackgroundQuit || !mBackgroundJobs.empty(); });
+        if (mBackgroundQuit)
+            break;
+
+        std::function<void()> job = mBackgroundJobs.front();
+        lock.unlock();
+        job();
+        lock.lock();
+        mBackgroundJobs.pop_front();
+        mBackgroundDone.notify_all();
+    }
+    mBackgroundJobs.clear();
+    mBackgroundDone.notify_all();
+}
+
+void LampThreadPool::Run(const std::function<void(std::uint32_t)>& task)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    // A worker still inside the previous task would read the new one.
+    mDone.wait(lock, [this] { return mActive == 0; });
+
+    mTask = &task;
+    mGeneration++;
+    mActive++;
+    lock.unlock();
+    mWake.notify_all();
+
+    gInsideTask = true;
+    task(0);
+    gInsideTask = false;
+
+    // Everyone who joined has left only after the last piece of work was claimed and finished.
+    lock.lock();
+    mActive--;
+    mDone.wait(lock, [this] { return mActive == 0; });
+    mTask = nullptr;
+    lock.unlock();
+    mDone.notify_all();
+}
+
+void LampThreadPool::WorkerLoop(std::uint32_t thread)
+{
+    std::uint64_t seen = 0;
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [&] { return mQuit || mGeneration != seen; });
+        if (mQuit)
+            return;
+
+        seen = mGeneration;
+        const std::function<void(std::uint32_t)>* task = mTask;
+        mActive++;
+        lock.unlock();
+
+        if (task != nullptr)
+        {
+            gInsideTask = true;
+            (*task)(thread);
+            gInsideTask = false;
+        }
+
+        lock.lock();
+        mActive--;
+        lock.unlock();
+        mDone.notify_all();
+    }
+}
+
+void LampThreadPool::RunChunks(const std::function<void(std::uint32_t, std::uint32_t)>& func, std::uint32_t count, std::uint32_t grain)
+{
+    while (true)
+    {
+        std::uint32_t begin = mNext.fetch_add(grain);
+        if (begin >= count)
+            break;
+        func(begin, std::min<std::uint32_t>(begin + grain, count));
+    }
+}
+
+void LampThreadPool::RunQueues(const std::function<void(std::uint32_t, std::uint32_t)>& func, std::uint32_t thread)
+{
+    // Jobs never queue more jobs, so once every queue is empty the rest are already running.
+    const std::uint32_t queues = (std::uint32_t)mQueues.size();
+    while (true)
+    {
+        std::uint32_t job = 0;
+        bool found = false;
+        {
+            JobQueue& own = *mQueues[thread];
+            std::lock_guard<std::mutex> lock(own.Mutex);
+            if (!own.Jobs.empty())
+            {
+                job = own.Jobs.back();
+                own.Jobs.pop_back();
+                found = true;
+            }
+        }
+        for (std::uint32_t i = 1; i < queues && !found; ++i)
+        {
+            JobQueue& victim = *mQueues[(thread + i) % queues];
+            std::lock_guard<std::mutex> lock(victim.Mutex);
+            if (!victim.Jobs.empty())
+            {
+                job = victim.Jobs.front();
+                victim.Jobs.pop_front();
+                found = true;
+                mSteals++;
+            }
+        }
+        if (!found)
+            break;
+        func(job, thread);
+    }
+}
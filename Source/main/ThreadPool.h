@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+
+// Persistent worker threads for data-parallel loops and independent jobs.
+// The calling thread takes part in the work, so a pool of N threads keeps N-1 workers.
+// Calls made from inside a running loop or job run inline on that thread.
+// Long work that must not hold up a frame is submitted as a background job instead.
+class LampThreadPool
+{
+public:
+    LampThreadPool(std::uint32_t numThreads = 0);
+    LampThreadPool(const LampThreadPool& rhs) = delete;
+    LampThreadPool& operator=(const LampThreadPool& rhs) = delete;
+    ~LampThreadPool();
+
+    // Shared pool sized to the hardware.
+    static LampThreadPool& Default();
+
+    std::uint32_t NumThreads()const { return (std::uint32_t)mWorkers.size() + 1; }
+
+    // Calls func(begin, end) over [0, count) in chunks of grain and blocks until all are done.
+    void ParallelFor(std::uint32_t count, std::uint32_t grain, const std::function<void(std::uint32_t, std::uint32_t)>& func);
+
+    // Calls func(job, thread) once for every job in [0, count) and blocks until all are done.
+    // thread is in [0, NumThreads()), 0 being the caller. Jobs are dealt round-robin to
+    // per-thread queues; a thread takes from the back of its own and steals from the
+    // front of the others once it runs dry. Returns how many jobs were stolen.
+    std::uint32_t RunJobs(std::uint32_t count, const std::function<void(std::uint32_t, std::uint32_t)>& func);
+
+    // Queues job for the pool's background thread, started on first use, and returns at once.
+    // Background jobs run one at a time in the order queued. Loops and jobs they call run inline
+    // on the background thread, so they never take the pool from the frame's calls.
+    void Submit(const std::function<void()>& job);
+    // Blocks until every background job queued so far has finished.
+    void WaitBackground();
+
+private:
+    struct JobQueue
+    {
+        std::mutex Mutex;
+        std::deque<std::uint32_t> Jobs;
+    };
+
+    void WorkerLoop(std::uint32_t thread);
+    // Publishes task to the workers, runs it on the caller as thread 0 and waits for everyone.
+    void Run(const std::function<void(std::uint32_t)>& task);
+    void RunChunks(const std::function<void(std::uint32_t, std::uint32_t)>& func, std::uint32_t count, std::uint32_t grain);
+    void RunQueues(const std::function<void(std::uint32_t, std::uint32_t)>& func, std::uint32_t thread);
+    void BackgroundLoop();
+
+    std::vector<std::thread> mWorkers;
+
+    // One ParallelFor() or RunJobs() at a time when several threads share the pool.
+    std::mutex mCallerMutex;
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+
+    // Current task, guarded by mMutex; loop chunks are claimed through mNext.
+    const std::function<void(std::uint32_t)>* mTask = nullptr;
+    std::atomic<std::uint32_t> mNext{ 0 };
+
+    // One per thread, filled before RunJobs publishes its task.
+    std::vector<std::unique_ptr<JobQueue>> mQueues;
+    std::atomic<std::uint32_t> mSteals{ 0 };
+
+    std::uint64_t mGeneration = 0;
+    std::uint32_t mActive = 0;
+    bool mQuit = false;
+
+    // Background jobs, guarded by mBackgroundMutex; the one running stays at the front.
+    std::thread mBackground;
+    std::mutex mBackgroundMutex;
+    std::condition_variable mBackgroundWake;
+    std::condition_variable mBackgroundDone;
+    std::deque<std::function<void()>> mBackgroundJobs;
+    bool mBackgroundQuit = false;
+};
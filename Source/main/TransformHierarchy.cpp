@@ -0,0 +1,177 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#include <chrono>
+
+using namespace DirectX;
+
+UINT LampTransforms::AddNode(UINT parent, const XMFLOAT4X4& local, RenderItem* ri)
+{
+    UINT handle = (UINT)mHandleToSlot.size();
+    UINT slot = (UINT)mParent.size();
+    assert(parent == InvalidNode || parent < handle);
+
+    mHandleToSlot.push_back(slot);
+    mParent.push_back(parent == InvalidNode ? InvalidNode : mHandleToSlot[parent]);
+    mLocal.push_back(local);
+    mWorld.push_back(MathHelper::Identity4x4());
+    mDirty.push_back(1);
+    mChanged.push_back(0);
+    mItems.push_back(ri);
+
+    mTopologyDirty = true;
+    return handle;
+}
+
+UINT LampTransforms::AddNode(UINT parent,
+    const XMFLOAT3& translation,
+    const XMFLOAT4& rotation,
+    const XMFLOAT3& scale,
+    RenderItem* ri)
+{
+    XMFLOAT4X4 local;
+    XMStoreFloat4x4(&local, XMMatrixAffineTransformation(
+        XMLoadFloat3(&scale), XMVectorZero(), XMLoadFloat4(&rotation), XMLoadFloat3(&translation)));
+    return AddNode(parent, local, ri);
+}
+
+void LampTransforms::Clear()
+{
+    mHandleToSlot.clear();
+    mParent.clear();
+    mLocal.clear();
+    mWorld.clear();
+    mDirty.clear();
+    mChanged.clear();
+    mItems.clear();
+    mLevelStart.clear();
+    mTopologyDirty = false;
+}
+
+void LampTransforms::SetLocal(UINT node, const XMFLOAT4X4& local)
+{
+    UINT slot = mHandleToSlot[node];
+    mLocal[slot] = local;
+    mDirty[slot] = 1;
+}
+
+const XMFLOAT4X4& LampTransforms::Local(UINT node)const
+{
+    return mLocal[mHandleToSlot[node]];
+}
+
+const XMFLOAT4X4& LampTransforms::World(UINT node)const
+{
+    return mWorld[mHandleToSlot[node]];
+}
+
+void LampTransforms::Rebuild()
+{
+    const UINT count = (UINT)mParent.size();
+
+    // Parents always sit in a lower slot, so one forward pass finds every depth.
+    std::vector<UINT> level(count);
+    UINT numLevels = 0;
+    for (UINT s = 0; s < count; ++s)
+    {
+        level[s] = mParent[s] == InvalidNode ? 0 : level[mParent[s]] + 1;
+        numLevels = std::max<UINT>(numLevels, level[s] + 1);
+    }
+
+    // Stable counting sort by level.
+    mLevelStart.assign(numLevels + 1, 0);
+    for (UINT s = 0; s < count; ++s)
+        mLevelStart[level[s] + 1]++;
+    for (UINT l = 0; l < numLevels; ++l)
+        mLevelStart[l + 1] += mLevelStart[l];
+
+    std::vector<UINT> cursor(mLevelStart.begin(), mLevelStart.end() - 1);
+    std::vector<UINT> newSlot(count);
+    for (UINT s = 0; s < count; ++s)
+        newSlot[s] = cursor[level[s]]++;
+
+    auto permute = [&](auto& data)
+    {
+        std::remove_reference_t<decltype(data)> sorted(data.size());
+        for (UINT s = 0; s < count; ++s)
+            sorted[newSlot[s]] = data[s];
+        data.swap(sorted);
+    };
+
+    for (auto& parent : mParent)
+    {
+        if (parent != InvalidNode)
+            parent = newSlot[parent];
+    }
+    permute(mParent);
+    permute(mLocal);
+    permute(mWorld);
+    permute(mDirty);
+    permute(mChanged);
+    permute(mItems);
+
+    for (auto& slot : mHandleToSlot)
+        slot = newSlot[slot];
+
+    mTopologyDirty = false;
+}
+
+UINT LampTransforms::UpdateRange(UINT begin, UINT end, std::vector<RenderItem*>& changedItems)
+{
+    UINT updated = 0;
+    for (UINT i = begin; i < end; ++i)
+    {
+        UINT parent = mParent[i];
+        bool changed = mDirty[i] || (parent != InvalidNode && mChanged[parent]);
+        mChanged[i] = changed;
+        if (!changed)
+            continue;
+
+        XMMATRIX world = XMLoadFloat4x4(&mLocal[i]);
+        if (parent != InvalidNode)
+            world = XMMatrixMultiply(world, XMLoadFloat4x4(&mWorld[parent]));
+
+        XMStoreFloat4x4(&mWorld[i], world);
+        mDirty[i] = 0;
+        updated++;
+
+        if (mItems[i] != nullptr)
+        {
+            RenderItem* ri = mItems[i];
+            ri->World = mWorld[i];
+            ri->LocalBounds.Transform(ri->Bounds, world);
+            changedItems.push_back(ri);
+        }
+    }
+    return updated;
+}
+
+void LampTransforms::Update()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (mTopologyDirty)
+        Rebuild();
+
+    // A level only reads the world matrices of the level above it.
+    std::atomic<UINT> updated{ 0 };
+    mChangedItems.clear();
+    for (UINT l = 0; l + 1 < (UINT)mLevelStart.size(); ++l)
+    {
+        UINT levelBegin = mLevelStart[l];
+        UINT levelCount = mLevelStart[l + 1] - levelBegin;
+        LampThreadPool::Default().ParallelFor(levelCount, 1024, [&](UINT begin, UINT end)
+        {
+            std::vector<RenderItem*> changedItems;
+            updated += UpdateRange(levelBegin + begin, levelBegin + end, changedItems);
+            if (!changedItems.empty())
+            {
+                std::lock_guard<std::mutex> lock(mChangedMutex);
+                mChangedItems.insert(mChangedItems.end(), changedItems.begin(), changedItems.end());
+            }
+        });
+    }
+    mUpdatedCount = updated;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mUpdateMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
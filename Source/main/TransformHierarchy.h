@@ -0,0 +1,71 @@
+#pragma once
+
+#include "RenderItem.h"
+#include <mutex>
+
+// Runtime transform hierarchy stored as structure-of-arrays in breadth-first order.
+// Each node keeps its local matrix as given, so sheared or mirrored glTF matrices
+// survive unchanged.
+// Parents always precede their children and every level is a contiguous range,
+// so world matrices are rebuilt level by level with each level split over the
+// thread pool. Nodes bound to a RenderItem write its World and Bounds when
+// their world matrix changes and report the item through ChangedItems().
+class LampTransforms
+{
+public:
+    LampTransforms() = default;
+    LampTransforms(const LampTransforms& rhs) = delete;
+    LampTransforms& operator=(const LampTransforms& rhs) = delete;
+    ~LampTransforms() = default;
+
+    static const UINT InvalidNode = 0xffffffff;
+
+    // Node handles are stable; the parent must already exist.
+    UINT AddNode(UINT parent, const DirectX::XMFLOAT4X4& local, RenderItem* ri = nullptr);
+    // Composes scale, then rotation, then translation into the local matrix.
+    UINT AddNode(UINT parent,
+        const DirectX::XMFLOAT3& translation,
+        const DirectX::XMFLOAT4& rotation,
+        const DirectX::XMFLOAT3& scale,
+        RenderItem* ri = nullptr);
+    void Clear();
+
+    void SetLocal(UINT node, const DirectX::XMFLOAT4X4& local);
+    const DirectX::XMFLOAT4X4& Local(UINT node)const;
+
+    const DirectX::XMFLOAT4X4& World(UINT node)const;
+    UINT NodeCount()const { return (UINT)mHandleToSlot.size(); }
+    UINT LevelCount()const { return mLevelStart.empty() ? 0 : (UINT)mLevelStart.size() - 1; }
+
+    // Propagates dirty flags down the tree and recomputes the changed world matrices.
+    void Update();
+
+    UINT UpdatedCount()const { return mUpdatedCount; }
+    // Items whose World changed in the last Update(), in no particular order.
+    const std::vector<RenderItem*>& ChangedItems()const { return mChangedItems; }
+    double UpdateMs()const { return mUpdateMs; }
+
+private:
+    void Rebuild();
+    UINT UpdateRange(UINT begin, UINT end, std::vector<RenderItem*>& changedItems);
+
+    std::vector<UINT> mHandleToSlot;
+
+    // Indexed by slot.
+    std::vector<UINT> mParent;
+    std::vector<DirectX::XMFLOAT4X4> mLocal;
+    std::vector<DirectX::XMFLOAT4X4> mWorld;
+    std::vector<std::uint8_t> mDirty;   // local matrix changed since the last Update
+    std::vector<std::uint8_t> mChanged; // world matrix changed in this Update
+    std::vector<RenderItem*> mItems;
+
+    // Level l covers slots [mLevelStart[l], mLevelStart[l + 1]).
+    std::vector<UINT> mLevelStart;
+    bool mTopologyDirty = false;
+
+    std::vector<RenderItem*> mChangedItems;
+    std::mutex mChangedMutex;
+
+    UINT mUpdatedCount = 0;
+    double mUpdateMs = 0.0;
+};
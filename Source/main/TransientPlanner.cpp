@@ -0,0 +1,104 @@
+#include "TransientPlanner.h"
+#include <algorithm>
+#include <numeric>
+
+static bool LifetimesOverlap(const TransientRequest& a, const TransientRequest& b)
+{
+    return a.FirstPass <= b.LastPass && b.FirstPass <= a.LastPass;
+}
+
+static std::uint64_t AlignUp(std::uint64_t v, std::uint64_t alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+std::uint64_t LampTransientPlanner::Plan(const std::vector<TransientRequest>& requests, std::vector<std::uint64_t>& offsets)
+{
+    const std::uint32_t count = (std::uint32_t)requests.size();
+    offsets.assign(count, 0);
+
+    std::vector<std::uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+    {
+        if (requests[a].Size != requests[b].Size)
+            return requests[a].Size > requests[b].Size;
+        return requests[a].FirstPass < requests[b].FirstPass;
+    });
+
+    std::uint64_t heapSize = 0;
+    std::vector<std::uint32_t> placed;
+    std::vector<std::uint32_t> live;
+    for (std::uint32_t i : order)
+    {
+        const TransientRequest& r = requests[i];
+
+        // Placed transients alive at the same time, lowest offset first.
+        live.clear();
+        for (std::uint32_t p : placed)
+        {
+            if (LifetimesOverlap(r, requests[p]))
+                live.push_back(p);
+        }
+        std::sort(live.begin(), live.end(), [&](std::uint32_t a, std::uint32_t b) { return offsets[a] < offsets[b]; });
+
+        // First gap that fits.
+        std::uint64_t offset = 0;
+        for (std::uint32_t p : live)
+        {
+            if (offset + r.Size <= offsets[p])
+                break;
+            offset = std::max<std::uint64_t>(offset, AlignUp(offsets[p] + requests[p].Size, r.Alignment));
+        }
+
+        offsets[i] = offset;
+        placed.push_back(i);
+        heapSize = std::max<std::uint64_t>(heapSize, offset + r.Size);
+    }
+    return heapSize;
+}
+
+bool LampTransientPlanner::Validate(const std::vector<TransientRequest>& requests, const std::vector<std::uint64_t>& offsets)
+{
+    for (size_t a = 0; a < requests.size(); ++a)
+    {
+        if (offsets[a] % requests[a].Alignment != 0)
+            return false;
+        for (size_t b = a + 1; b < requests.size(); ++b)
+        {
+            if (!LifetimesOverlap(requests[a], requests[b]))
+                continue;
+            if (offsets[a] < offsets[b] + requests[b].Size && offsets[b] < offsets[a] + requests[a].Size)
+                return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t LampTransientPlanner::RequestedBytes(const std::vector<TransientRequest>& requests)
+{
+    std::uint64_t bytes = 0;
+    for (auto& r : requests)
+        bytes += r.Size;
+    return bytes;
+}
+
+std::uint64_t LampTransientPlanner::PeakLiveBytes(const std::vector<TransientRequest>& requests)
+{
+    std::uint32_t lastPass = 0;
+    for (auto& r : requests)
+        lastPass = std::max<std::uint32_t>(lastPass, r.LastPass);
+
+    std::uint64_t peak = 0;
+    for (std::uint32_t pass = 0; pass <= lastPass && !requests.empty(); ++pass)
+    {
+        std::uint64_t live = 0;
+        for (auto& r : requests)
+        {
+            if (r.FirstPass <= pass && pass <= r.LastPass)
+                live += r.Size;
+        }
+        peak = std::max<std::uint64_t>(peak, live);
+    }
+    return peak;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A resource that is only alive between two positions of the frame's pass order.
+struct TransientRequest
+{
+    std::uint64_t Size = 0;
+    // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT until the device says otherwise.
+    std::uint64_t Alignment = 64 * 1024;
+    std::uint32_t FirstPass = 0;
+    std::uint32_t LastPass = 0;
+};
+
+// Assigns heap offsets to transients so that two of them share memory only
+// when their lifetimes do not overlap. Largest first, each at the lowest
+// offset clear of every placed transient alive at the same time: interval
+// coloring where the colors are byte ranges. No device needed; DescriptorHeap
+// places the transients in one D3D12 heap at the planned offsets.
+class LampTransientPlanner
+{
+public:
+    // Fills offsets (one per request) and returns the heap size they need.
+    static std::uint64_t Plan(const std::vector<TransientRequest>& requests, std::vector<std::uint64_t>& offsets);
+
+    // True when no two requests overlap in both lifetime and memory.
+    static bool Validate(const std::vector<TransientRequest>& requests, const std::vector<std::uint64_t>& offsets);
+
+    // Sum of sizes, what the requests cost without aliasing.
+    static std::uint64_t RequestedBytes(const std::vector<TransientRequest>& requests);
+    // Most bytes alive at any one pass, the bound no placement can beat.
+    static std::uint64_t PeakLiveBytes(const std::vector<TransientRequest>& requests);
+};
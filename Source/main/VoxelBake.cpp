@@ -0,0 +1,430 @@
+#include "VoxelBake.h"
+#include "PipelineCache.h"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+using namespace DirectX;
+
+constexpr UINT LampVoxelBake::Magic;
+constexpr UINT LampVoxelBake::Version;
+
+namespace
+{
+    struct BakeHeader
+    {
+        UINT Magic;
+        UINT Version;
+        UINT Levels;
+        float VoxelSize;
+        UINT64 Key;
+        // Of everything after the header.
+        UINT64 PayloadHash;
+    };
+
+    // Key, albedo, normal, mat.
+    const size_t RecordSize = sizeof(UINT64) + 3 * sizeof(UINT);
+
+    int Mod(int a, int b)
+    {
+        const int m = a % b;
+        return m < 0 ? m + b : m;
+    }
+
+    // Row vector times the item's world matrix, as the shaders multiply.
+    XMFLOAT3 TransformPoint(const XMFLOAT3& p, const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(
+            p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+            p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+            p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]);
+    }
+
+    XMFLOAT3 TransformNormal(const XMFLOAT3& n, const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(
+            n.x * m.m[0][0] + n.y * m.m[1][0] + n.z * m.m[2][0],
+            n.x * m.m[0][1] + n.y * m.m[1][1] + n.z * m.m[2][1],
+            n.x * m.m[0][2] + n.y * m.m[1][2] + n.z * m.m[2][2]);
+    }
+
+    UINT ItemIndex(const RenderItem& ri, UINT i)
+    {
+        const BYTE* ib = (const BYTE*)ri.Geo->IndexBufferCPU->GetBufferPointer();
+        const UINT index = ri.StartIndexLocation + i;
+        const UINT v = ri.Geo->IndexFormat == DXGI_FORMAT_R16_UINT ? ((const std::uint16_t*)ib)[index] : ((const std::uint32_t*)ib)[index];
+        return ri.BaseVertexLocation + v;
+    }
+
+    const Vertex& ItemVertex(const RenderItem& ri, UINT v)
+    {
+        const BYTE* vb = (const BYTE*)ri.Geo->VertexBufferCPU->GetBufferPointer();
+        return *(const Vertex*)(vb + (size_t)v * ri.Geo->VertexByteStride);
+    }
+
+    template<typename T>
+    void Put(std::vector<BYTE>& data, const T& value)
+    {
+        const size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        memcpy(&data[offset], &value, sizeof(T));
+    }
+
+    template<typename T>
+    T Get(const BYTE* data, size_t& offset)
+    {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    const LampCpuTexture* TextureAt(const std::vector<const LampCpuTexture*>& textures, int index)
+    {
+        return index >= 0 && index < (int)textures.size() ? textures[index] : nullptr;
+    }
+
+    void HashMatrix(LampHashStream& h, const XMFLOAT4X4& m)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+                h.Value(m.m[r][c]);
+        }
+    }
+
+    // The voxelize vertex shader: uv * TexTransform * MatTransform.
+    XMFLOAT2 TransformTexC(const XMFLOAT2& uv, const XMFLOAT4X4& tex, const XMFLOAT4X4& mat)
+    {
+        const float t[4] = {
+            uv.x * tex.m[0][0] + uv.y * tex.m[1][0] + tex.m[3][0],
+            uv.x * tex.m[0][1] + uv.y * tex.m[1][1] + tex.m[3][1],
+            uv.x * tex.m[0][2] + uv.y * tex.m[1][2] + tex.m[3][2],
+            uv.x * tex.m[0][3] + uv.y * tex.m[1][3] + tex.m[3][3] };
+        return XMFLOAT2(
+            t[0] * mat.m[0][0] + t[1] * mat.m[1][0] + t[2] * mat.m[2][0] + t[3] * mat.m[3][0],
+            t[0] * mat.m[0][1] + t[1] * mat.m[1][1] + t[2] * mat.m[2][1] + t[3] * mat.m[3][1]);
+    }
+}
+
+LampVoxelBake::LampVoxelBake(UINT levels, float voxelSize) : mVoxelSize(voxelSize), mLevels(levels)
+{
+    assert(levels > 0 && voxelSize > 0.0f);
+}
+
+UINT64 LampVoxelBake::SceneKey(const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures)const
+{
+    LampHashStream h;
+    h.Value(Version);
+    h.Value(Levels());
+    h.Value(mVoxelSize);
+
+    // Each mesh's buffers once, however many items draw from them.
+    std::unordered_map<const Mesh*, UINT64> meshes;
+    for (auto ri : items)
+    {
+        if (!ri->Static)
+            continue;
+        auto mesh = meshes.find(ri->Geo);
+        if (mesh == meshes.end())
+        {
+            LampHashStream g;
+            g.Value(ri->Geo->VertexByteStride);
+            g.Value(ri->Geo->IndexFormat);
+            g.Value((UINT64)ri->Geo->VertexBufferCPU->GetBufferSize());
+            g.Bytes(ri->Geo->VertexBufferCPU->GetBufferPointer(), ri->Geo->VertexBufferCPU->GetBufferSize());
+            g.Value((UINT64)ri->Geo->IndexBufferCPU->GetBufferSize());
+            g.Bytes(ri->Geo->IndexBufferCPU->GetBufferPointer(), ri->Geo->IndexBufferCPU->GetBufferSize());
+            mesh = meshes.insert({ ri->Geo, g.Hash() }).first;
+        }
+        h.Value(mesh->second);
+        HashMatrix(h, ri->World);
+        HashMatrix(h, ri->TexTransform);
+        h.Value(ri->IndexCount);
+        h.Value(ri->StartIndexLocation);
+        h.Value(ri->BaseVertexLocation);
+        const bool material = ri->Mat != nullptr;
+        h.Value(material);
+        if (material)
+        {
+            h.Value(ri->Mat->DiffuseAlbedo.x);
+            h.Value(ri->Mat->DiffuseAlbedo.y);
+            h.Value(ri->Mat->DiffuseAlbedo.z);
+            h.Value(ri->Mat->FresnelR0.x);
+            h.Value(ri->Mat->Roughness);
+            HashMatrix(h, ri->Mat->MatTransform);
+            for (int index : { ri->Mat->DiffuseSrvHeapIndex, ri->Mat->NormalSrvHeapIndex })
+            {
+                const LampCpuTexture* texture = TextureAt(textures, index);
+                h.Value(texture != nullptr ? texture->Hash() : 0ull);
+            }
+        }
+    }
+    return h.Hash();
+}
+
+void LampVoxelBake::Bake(const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::unique_ptr<LampVoxelizer>> voxelizers;
+    for (UINT l = 0; l < Levels(); ++l)
+        voxelizers.push_back(std::make_unique<LampVoxelizer>(mVoxelSize * (float)(1u << l)));
+
+    mTriangles = 0;
+    for (auto ri : items)
+    {
+        if (!ri->Static)
+            continue;
+        // The voxelize shader's inputs.
+        VoxelMaterial material;
+        XMFLOAT4X4 matTransform = MathHelper::Identity4x4();
+        if (ri->Mat != nullptr)
+        {
+            material.DiffuseAlbedo = ri->Mat->DiffuseAlbedo;
+            material.Metallic = ri->Mat->FresnelR0.x;
+            material.Roughness = ri->Mat->Roughness;
+            material.DiffuseMap = TextureAt(textures, ri->Mat->DiffuseSrvHeapIndex);
+            material.NormalMap = TextureAt(textures, ri->Mat->NormalSrvHeapIndex);
+            matTransform = ri->Mat->MatTransform;
+        }
+        for (UINT i = 0; i + 2 < ri->IndexCount; i += 3)
+        {
+            VoxelVertex tri[3];
+            for (UINT k = 0; k < 3; ++k)
+            {
+                const Vertex& v = ItemVertex(*ri, ItemIndex(*ri, i + k));
+                tri[k].Position = TransformPoint(v.position, ri->World);
+                tri[k].Normal = TransformNormal(v.normal, ri->World);
+                tri[k].Tangent = TransformNormal(XMFLOAT3(v.tangent.x, v.tangent.y, v.tangent.z), ri->World);
+                tri[k].TexC = TransformTexC(v.uv0, ri->TexTransform, matTransform);
+            }
+            for (auto& voxelizer : voxelizers)
+                voxelizer->AddTriangle(tri, material);
+            mTriangles++;
+        }
+    }
+
+    for (UINT l = 0; l < Levels(); ++l)
+        mLevels[l] = voxelizers[l]->Resolve();
+    mKey = SceneKey(items, textures);
+    mReady = true;
+    mLoaded = false;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mBakeMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool LampVoxelBake::LoadOrBake(const std::string& path, const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures)
+{
+    if (Load(path, SceneKey(items, textures)))
+        return true;
+    Bake(items, textures);
+    if (!Save(path))
+        OutputDebugString(L"Voxel bake: could not write the bake file\n");
+    return false;
+}
+
+std::unique_ptr<LampVoxelBake::StaticItems> LampVoxelBake::CopyStatic(const std::vector<RenderItem*>& items)
+{
+    auto copy = std::make_unique<StaticItems>();
+    // Items that share a material share its copy.
+    std::unordered_map<const Material*, Material*> materials;
+    for (auto ri : items)
+    {
+        if (!ri->Static)
+            continue;
+        auto item = std::make_unique<RenderItem>();
+        item->World = ri->World;
+        item->TexTransform = ri->TexTransform;
+        item->ObjCBIndex = ri->ObjCBIndex;
+        item->Geo = ri->Geo;
+        item->PrimitiveType = ri->PrimitiveType;
+        item->IndexCount = ri->IndexCount;
+        item->StartIndexLocation = ri->StartIndexLocation;
+        item->BaseVertexLocation = ri->BaseVertexLocation;
+        item->LocalBounds = ri->LocalBounds;
+        item->Bounds = ri->Bounds;
+        if (ri->Mat != nullptr)
+        {
+            auto material = materials.find(ri->Mat);
+            if (material == materials.end())
+            {
+                copy->Materials.push_back(std::make_unique<Material>(*ri->Mat));
+                material = materials.insert({ ri->Mat, copy->Materials.back().get() }).first;
+            }
+            item->Mat = material->second;
+        }
+        copy->Items.push_back(item.get());
+        copy->Copies.push_back(std::move(item));
+    }
+    return copy;
+}
+
+void LampVoxelBake::Swap(LampVoxelBake& other)
+{
+    std::swap(mVoxelSize, other.mVoxelSize);
+    std::swap(mKey, other.mKey);
+    std::swap(mReady, other.mReady);
+    mLevels.swap(other.mLevels);
+    mGathered.swap(other.mGathered);
+    mRanges.swap(other.mRanges);
+    std::swap(mLoaded, other.mLoaded);
+    std::swap(mTriangles, other.mTriangles);
+    std::swap(mBakeMs, other.mBakeMs);
+}
+
+UINT LampVoxelBake::PackTexel(UINT x, UINT y, UINT z)
+{
+    assert(x < 1024 && y < 1024 && z < 1024);
+    return x | (y << 10) | (z << 20);
+}
+
+void LampVoxelBake::Gather(const LampVoxelClipmap& clipmap)
+{
+    assert(clipmap.Levels() == Levels());
+    mGathered.clear();
+    mRanges.clear();
+    const UINT* dims = clipmap.Dims();
+    for (auto& slab : clipmap.Slabs())
+    {
+        Range range;
+        range.First = (UINT)mGathered.size();
+        const std::vector<BakedVoxel>& voxels = mLevels[slab.Level];
+        const VoxelBox& box = slab.Box;
+        // Keys order z, then y, then x: each row of the box is one run.
+        for (int z = box.Min[2]; z < box.Max[2]; ++z)
+        {
+            for (int y = box.Min[1]; y < box.Max[1]; ++y)
+            {
+                const UINT64 last = LampVoxelizer::Key(box.Max[0] - 1, y, z);
+                auto it = std::lower_bound(voxels.begin(), voxels.end(), LampVoxelizer::Key(box.Min[0], y, z),
+                    [](const BakedVoxel& v, UINT64 key) { return v.Key < key; });
+                for (; it != voxels.end() && it->Key <= last; ++it)
+                {
+                    int v[3];
+                    LampVoxelizer::Unkey(it->Key, v);
+                    StaticVoxel voxel;
+                    voxel.Texel = PackTexel(Mod(v[0], (int)dims[0]), Mod(v[1], (int)dims[1]), Mod(v[2], (int)dims[2]));
+                    voxel.Albedo = it->Albedo;
+                    voxel.Normal = it->Normal;
+                    voxel.Mat = it->Mat;
+                    mGathered.push_back(voxel);
+                }
+            }
+        }
+        range.Count = (UINT)mGathered.size() - range.First;
+        mRanges.push_back(range);
+    }
+}
+
+std::vector<BYTE> LampVoxelBake::Serialize()const
+{
+    std::vector<BYTE> payload;
+    for (auto& level : mLevels)
+    {
+        Put(payload, (UINT64)level.size());
+        for (auto& voxel : level)
+        {
+            Put(payload, voxel.Key);
+            Put(payload, voxel.Albedo);
+            Put(payload, voxel.Normal);
+            Put(payload, voxel.Mat);
+        }
+    }
+
+    LampHashStream h;
+    h.Bytes(payload.data(), payload.size());
+    BakeHeader header = { Magic, Version, Levels(), mVoxelSize, mKey, h.Hash() };
+    std::vector<BYTE> data(sizeof(header));
+    memcpy(data.data(), &header, sizeof(header));
+    data.insert(data.end(), payload.begin(), payload.end());
+    return data;
+}
+
+bool LampVoxelBake::Deserialize(const BYTE* data, size_t size, UINT64 key)
+{
+    for (auto& level : mLevels)
+        level.clear();
+    mReady = false;
+    mKey = 0;
+
+    BakeHeader header;
+    if (data == nullptr || size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.Magic != Magic || header.Version != Version || header.Key != key
+        || header.Levels != Levels() || header.VoxelSize != mVoxelSize)
+        return false;
+    LampHashStream h;
+    h.Bytes(data + sizeof(header), size - sizeof(header));
+    if (h.Hash() != header.PayloadHash)
+        return false;
+
+    std::vector<std::vector<BakedVoxel>> levels(Levels());
+    size_t offset = sizeof(header);
+    for (auto& level : levels)
+    {
+        if (size - offset < sizeof(UINT64))
+            return false;
+        const UINT64 count = Get<UINT64>(data, offset);
+        if (count > (size - offset) / RecordSize)
+            return false;
+        level.resize((size_t)count);
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            BakedVoxel& voxel = level[i];
+            voxel.Key = Get<UINT64>(data, offset);
+            voxel.Albedo = Get<UINT>(data, offset);
+            voxel.Normal = Get<UINT>(data, offset);
+            voxel.Mat = Get<UINT>(data, offset);
+            // Gather() relies on the order.
+            if (i > 0 && level[i - 1].Key >= voxel.Key)
+                return false;
+        }
+    }
+    if (offset != size)
+        return false;
+
+    mLevels.swap(levels);
+    mKey = key;
+    mReady = true;
+    return true;
+}
+
+bool LampVoxelBake::Load(const std::string& path, UINT64 key)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<BYTE> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    mLoaded = Deserialize(data.data(), data.size(), key);
+    return mLoaded;
+}
+
+bool LampVoxelBake::Save(const std::string& path)const
+{
+    std::vector<BYTE> data = Serialize();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    return (bool)file;
+}
+
+std::wstring LampVoxelBake::Report()const
+{
+    std::wstring report = L"Voxel bake: ";
+    if (!mReady)
+        return report + L"none, every item is voxelized on the GPU\n";
+    size_t total = 0;
+    std::wstring counts;
+    for (UINT l = 0; l < Levels(); ++l)
+    {
+        total += mLevels[l].size();
+        counts += (l > 0 ? L"/" : L"") + std::to_wstring(mLevels[l].size());
+    }
+    report += std::to_wstring(total) + L" static voxels (" + counts + L" by level), "
+        + std::to_wstring(total * RecordSize / 1024) + L" KiB, ";
+    report += mLoaded ? std::wstring(L"loaded from file\n")
+        : L"baked from " + std::to_wstring(mTriangles) + L" triangles in " + std::to_wstring(mBakeMs) + L" ms\n";
+    report += L"  last frame: " + std::to_wstring(mGathered.size()) + L" voxels injected into "
+        + std::to_wstring(mRanges.size()) + L" slabs, " + std::to_wstring(mGathered.size() * sizeof(StaticVoxel) / 1024) + L" KiB uploaded\n";
+    return report;
+}
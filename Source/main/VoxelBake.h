@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Voxelizer.h"
+#include "VoxelClipmap.h"
+#include "../D3D/FrameResource.h"
+
+// Static voxels of every clipmap level, voxelized once on the CPU from the static render
+// items and kept on disk. The Voxel pass injects them into the slabs it clears and
+// rasterizes only the dynamic items. A file holds the key of what it was baked from
+// (SceneKey()), so a changed scene is baked again rather than loaded stale.
+class LampVoxelBake
+{
+public:
+    static constexpr UINT Magic = 0x3142564C; // "LVB1"
+    static constexpr UINT Version = 2;
+
+    // Gathered()[First, First + Count).
+    struct Range
+    {
+        UINT First = 0;
+        UINT Count = 0;
+    };
+
+    // Copies of static render items and of their materials, for a bake on another thread
+    // while the frame goes on writing the originals. Meshes are shared; they do not change.
+    struct StaticItems
+    {
+        std::vector<std::unique_ptr<RenderItem>> Copies;
+        std::vector<std::unique_ptr<Material>> Materials;
+        // The copies, as Bake() takes them.
+        std::vector<RenderItem*> Items;
+    };
+
+    // Level l has voxels voxelSize * 2^l wide, as LampVoxelClipmap.
+    LampVoxelBake(UINT levels, float voxelSize);
+    LampVoxelBake(const LampVoxelBake& rhs) = delete;
+    LampVoxelBake& operator=(const LampVoxelBake& rhs) = delete;
+    ~LampVoxelBake() = default;
+
+    // textures are the CPU copies of the SRV table the materials index, null where there is
+    // none; such maps are left out of the bake.
+
+    // Hash of the levels and of the static items' geometry, placement, materials and maps.
+    UINT64 SceneKey(const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures)const;
+    // Voxelizes the static items among items into every level.
+    void Bake(const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures);
+    // Loads the bake of items from path, or bakes and saves it there. True when loaded.
+    bool LoadOrBake(const std::string& path, const std::vector<RenderItem*>& items, const std::vector<const LampCpuTexture*>& textures);
+    // The static items among items, copied.
+    static std::unique_ptr<StaticItems> CopyStatic(const std::vector<RenderItem*>& items);
+    // Exchanges everything with other, e.g. a bake made in the background for the one in use.
+    void Swap(LampVoxelBake& other);
+
+    bool Ready()const { return mReady; }
+    UINT Levels()const { return (UINT)mLevels.size(); }
+    float VoxelSize()const { return mVoxelSize; }
+    // Sorted by LampVoxelizer::Key.
+    const std::vector<BakedVoxel>& Voxels(UINT level)const { return mLevels[level]; }
+
+    // The baked voxels in each of the clipmap's slabs, as uploaded; Ranges()[i] are those
+    // of clipmap.Slabs()[i].
+    void Gather(const LampVoxelClipmap& clipmap);
+    const std::vector<StaticVoxel>& Gathered()const { return mGathered; }
+    const std::vector<Range>& Ranges()const { return mRanges; }
+    // A texel as StaticVoxel::Texel holds it.
+    static UINT PackTexel(UINT x, UINT y, UINT z);
+
+    std::vector<BYTE> Serialize()const;
+    // Leaves the bake empty and returns false for a damaged file, another version or key.
+    bool Deserialize(const BYTE* data, size_t size, UINT64 key);
+    bool Load(const std::string& path, UINT64 key);
+    bool Save(const std::string& path)const;
+
+    std::wstring Report()const;
+
+private:
+    float mVoxelSize;
+    UINT64 mKey = 0;
+    bool mReady = false;
+    std::vector<std::vector<BakedVoxel>> mLevels;
+
+    std::vector<StaticVoxel> mGathered;
+    std::vector<Range> mRanges;
+
+    bool mLoaded = false;
+    UINT64 mTriangles = 0;
+    double mBakeMs = 0.0;
+};
@@ -0,0 +1,283 @@
+#include "VoxelClipmap.h"
+
+using namespace DirectX;
+
+namespace
+{
+    int FloorDiv(int a, int b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    int Mod(int a, int b)
+    {
+        return a - FloorDiv(a, b) * b;
+    }
+}
+
+LampVoxelClipmap::LampVoxelClipmap(UINT levels, const UINT dims[3], float voxelSize, UINT snap, UINT refreshSlices)
+    : mSnap(snap), mRefreshSlices(refreshSlices), mLevels(levels)
+{
+    assert(levels > 0 && snap > 0 && refreshSlices <= dims[2]);
+    for (int a = 0; a < 3; ++a)
+    {
+        // The camera's voxel stays inside the window however the origin snaps.
+        assert(dims[a] >= 2 * snap);
+        mDims[a] = dims[a];
+    }
+    for (UINT l = 0; l < levels; ++l)
+        mLevels[l].VoxelSize = voxelSize * (float)(1u << l);
+}
+
+void LampVoxelClipmap::Update(const XMFLOAT3& eye, const std::vector<BoundingBox>& dynamicBounds)
+{
+    mSlabs.clear();
+    mLastVoxels = 0;
+    const float e[3] = { eye.x, eye.y, eye.z };
+    bool moved = false;
+
+    for (UINT l = 0; l < Levels(); ++l)
+    {
+        VoxelClipLevel& level = mLevels[l];
+        int origin[3];
+        bool whole = !level.Valid;
+        for (int a = 0; a < 3; ++a)
+        {
+            const int center = (int)std::floor(e[a] / level.VoxelSize);
+            origin[a] = FloorDiv(center - (int)mDims[a] / 2, (int)mSnap) * (int)mSnap;
+            if (std::abs(origin[a] - level.Origin[a]) >= (int)mDims[a])
+                whole = true;
+        }
+
+        VoxelBox window;
+        for (int a = 0; a < 3; ++a)
+        {
+            window.Min[a] = origin[a];
+            window.Max[a] = origin[a] + (int)mDims[a];
+        }
+        if (whole)
+        {
+            AddSlab(l, window, false);
+        }
+        else
+        {
+            // The voxels entered along x, then those along y among the rest, then along z:
+            // disjoint, and together exactly the new window less the old one.
+            VoxelBox rest = window;
+            for (int a = 0; a < 3; ++a)
+            {
+                VoxelBox slab = rest;
+                if (origin[a] < level.Origin[a])
+                {
+                    slab.Max[a] = level.Origin[a];
+                    rest.Min[a] = level.Origin[a];
+                    AddSlab(l, slab, false);
+                }
+                else if (origin[a] > level.Origin[a])
+                {
+                    slab.Min[a] = level.Origin[a] + (int)mDims[a];
+                    rest.Max[a] = slab.Min[a];
+                    AddSlab(l, slab, false);
+                }
+            }
+        }
+        moved = moved || !mSlabs.empty();
+        for (int a = 0; a < 3; ++a)
+            level.Origin[a] = origin[a];
+        level.Valid = true;
+    }
+
+    if (mRefreshSlices > 0)
+    {
+        // A level that moved this frame gets its slice on the next round.
+        const UINT l = (UINT)(mFrame % Levels());
+        const UINT slice = (UINT)((mFrame / Levels()) % mRefreshSlices);
+        bool levelMoved = false;
+        for (auto& slab : mSlabs)
+            levelMoved = levelMoved || slab.Level == l;
+
+        const int thickness = (int)((mDims[2] + mRefreshSlices - 1) / mRefreshSlices);
+        const VoxelClipLevel& level = mLevels[l];
+        VoxelBox box;
+        for (int a = 0; a < 3; ++a)
+        {
+            box.Min[a] = level.Origin[a];
+            box.Max[a] = level.Origin[a] + (int)mDims[a];
+        }
+        box.Min[2] = level.Origin[2] + (int)slice * thickness;
+        box.Max[2] = std::min<int>(box.Min[2] + thickness, box.Max[2]);
+        if (!levelMoved && box.Min[2] < box.Max[2])
+            AddSlab(l, box, true);
+    }
+
+    // Where dynamic items are now, and where they were: the voxels they left need clearing.
+    mLastDynamic.insert(mLastDynamic.end(), dynamicBounds.begin(), dynamicBounds.end());
+    for (UINT l = 0; l < Levels(); ++l)
+    {
+        const VoxelClipLevel& level = mLevels[l];
+        for (auto& bounds : mLastDynamic)
+        {
+            VoxelBox box = Footprint(l, bounds);
+            bool empty = false;
+            for (int a = 0; a < 3; ++a)
+            {
+                box.Min[a] = std::max<int>(box.Min[a], level.Origin[a]);
+                box.Max[a] = std::min<int>(box.Max[a], level.Origin[a] + (int)mDims[a]);
+                empty = empty || box.Min[a] >= box.Max[a];
+            }
+            if (!empty)
+                AddSlab(l, box, false, true);
+        }
+    }
+    mLastDynamic = dynamicBounds;
+
+    mFrame++;
+    mUpdates++;
+    mMovedFrames += moved ? 1 : 0;
+    mRevoxelized += mLastVoxels;
+}
+
+void LampVoxelClipmap::AddSlab(UINT level, const VoxelBox& box, bool refresh, bool dynamic)
+{
+    VoxelSlab slab;
+    slab.Level = level;
+    slab.Box = box;
+    slab.Refresh = refresh;
+    slab.Dynamic = dynamic;
+
+    // Per axis, the texel ranges the box wraps into.
+    int pieces[3][2][2];
+    int counts[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        const int dims = (int)mDims[a];
+        const int first = Mod(box.Min[a], dims);
+        const int length = box.Max[a] - box.Min[a];
+        assert(length > 0 && length <= dims);
+        pieces[a][0][0] = first;
+        pieces[a][0][1] = std::min<int>(first + length, dims);
+        counts[a] = 1;
+        if (first + length > dims)
+        {
+            pieces[a][1][0] = 0;
+            pieces[a][1][1] = first + length - dims;
+            counts[a] = 2;
+        }
+    }
+    for (int x = 0; x < counts[0]; ++x)
+    {
+        for (int y = 0; y < counts[1]; ++y)
+        {
+            for (int z = 0; z < counts[2]; ++z)
+            {
+                VoxelBox texels;
+                const int which[3] = { x, y, z };
+                for (int a = 0; a < 3; ++a)
+                {
+                    texels.Min[a] = pieces[a][which[a]][0];
+                    texels.Max[a] = pieces[a][which[a]][1];
+                }
+                slab.Texels.push_back(texels);
+            }
+        }
+    }
+
+    mLastVoxels += Voxels(box);
+    mSlabs.push_back(std::move(slab));
+}
+
+void LampVoxelClipmap::Invalidate()
+{
+    for (auto& level : mLevels)
+        level.Valid = false;
+}
+
+XMFLOAT4 LampVoxelClipmap::Window(UINT level)const
+{
+    const VoxelClipLevel& l = mLevels[level];
+    return XMFLOAT4(l.Origin[0] * l.VoxelSize, l.Origin[1] * l.VoxelSize, l.Origin[2] * l.VoxelSize, l.VoxelSize);
+}
+
+VoxelBox LampVoxelClipmap::Footprint(UINT level, const BoundingBox& bounds)const
+{
+    const float size = mLevels[level].VoxelSize;
+    const float center[3] = { bounds.Center.x, bounds.Center.y, bounds.Center.z };
+    const float extents[3] = { bounds.Extents.x, bounds.Extents.y, bounds.Extents.z };
+    VoxelBox box;
+    for (int a = 0; a < 3; ++a)
+    {
+        // Conservative rasterization extrapolates up to a voxel past the triangle.
+        box.Min[a] = (int)std::floor((center[a] - extents[a]) / size) - 1;
+        box.Max[a] = (int)std::floor((center[a] + extents[a]) / size) + 2;
+    }
+    return box;
+}
+
+bool LampVoxelClipmap::Touches(const VoxelSlab& slab, const BoundingBox& bounds)const
+{
+    const VoxelBox box = Footprint(slab.Level, bounds);
+    for (int a = 0; a < 3; ++a)
+    {
+        if (box.Max[a] <= slab.Box.Min[a] || box.Min[a] >= slab.Box.Max[a])
+            return false;
+    }
+    return true;
+}
+
+void LampVoxelClipmap::SelectItems(const VoxelSlab& slab, const std::vector<RenderItem*>& items, std::vector<RenderItem*>& selected)const
+{
+    selected.clear();
+    for (auto ri : items)
+    {
+        if (Touches(slab, ri->Bounds))
+            selected.push_back(ri);
+    }
+}
+
+D3D12_RECT LampVoxelClipmap::Scissor(const VoxelSlab& slab, UINT axis, UINT rasterSize)const
+{
+    const VoxelClipLevel& level = mLevels[slab.Level];
+    const UINT64 size = rasterSize;
+    // First pixel of a voxel boundary, and one past the last pixel before it.
+    auto floorPixel = [&](int a, int v) { return (LONG)((UINT64)(v - level.Origin[a]) * size / mDims[a]); };
+    auto ceilPixel = [&](int a, int v) { return (LONG)(((UINT64)(v - level.Origin[a]) * size + mDims[a] - 1) / mDims[a]); };
+
+    const int x = (int)(axis + 1) % 3;
+    const int y = (int)(axis + 2) % 3;
+    D3D12_RECT rect;
+    rect.left = floorPixel(x, slab.Box.Min[x]);
+    rect.right = ceilPixel(x, slab.Box.Max[x]);
+    rect.top = (LONG)size - ceilPixel(y, slab.Box.Max[y]);
+    rect.bottom = (LONG)size - floorPixel(y, slab.Box.Min[y]);
+    return rect;
+}
+
+std::wstring LampVoxelClipmap::VolumeName(const std::wstring& base, UINT level)
+{
+    return level == 0 ? base : base + std::to_wstring(level);
+}
+
+UINT64 LampVoxelClipmap::Voxels(const VoxelBox& box)
+{
+    return (UINT64)(box.Max[0] - box.Min[0]) * (UINT64)(box.Max[1] - box.Min[1]) * (UINT64)(box.Max[2] - box.Min[2]);
+}
+
+UINT64 LampVoxelClipmap::TotalVoxels()const
+{
+    return (UINT64)Levels() * mDims[0] * mDims[1] * mDims[2];
+}
+
+std::wstring LampVoxelClipmap::Report()const
+{
+    std::wstring report = L"Voxel clipmap: " + std::to_wstring(Levels()) + L" levels of " + std::to_wstring(mDims[0])
+        + L"x" + std::to_wstring(mDims[1]) + L"x" + std::to_wstring(mDims[2]) + L", voxels "
+        + std::to_wstring(mLevels.front().VoxelSize) + L" to " + std::to_wstring(mLevels.back().VoxelSize) + L"\n";
+    report += L"  last frame: " + std::to_wstring(mSlabs.size()) + L" slabs, " + std::to_wstring(mLastVoxels) + L"/"
+        + std::to_wstring(TotalVoxels()) + L" voxels revoxelized\n";
+    if (mUpdates > 0)
+    {
+        report += L"  moved on " + std::to_wstring(mMovedFrames) + L"/" + std::to_wstring(mUpdates) + L" frames, "
+            + std::to_wstring(mRevoxelized / mUpdates) + L" voxels per frame on average\n";
+    }
+    return report;
+}
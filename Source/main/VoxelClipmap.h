@@ -0,0 +1,96 @@
+#pragma once
+
+#include "RenderItem.h"
+
+// Voxels [Min, Max) on each axis.
+struct VoxelBox
+{
+    int Min[3];
+    int Max[3];
+};
+
+// Voxels of one level to clear and voxelize again this frame.
+struct VoxelSlab
+{
+    UINT Level = 0;
+    // In the level's voxels: voxel v covers [v, v + 1) * VoxelSize in world space.
+    VoxelBox Box;
+    // Box in texels, split where the volume wraps: at most two pieces per axis.
+    std::vector<VoxelBox> Texels;
+    // Voxelized again to refresh its lighting, not because the window moved onto it.
+    bool Refresh = false;
+    // Around a dynamic item, this frame or the last; may overlap the other slabs.
+    bool Dynamic = false;
+};
+
+struct VoxelClipLevel
+{
+    float VoxelSize = 0.0f;
+    // The level holds voxels [Origin, Origin + dims).
+    int Origin[3] = {};
+    bool Valid = false;
+};
+
+// Camera-centered voxel clipmap. Level l has voxels voxelSize * 2^l wide and a window
+// of dims voxels around the camera. Voxel v is stored at texel v mod dims, so when the
+// window moves, the texels of the voxels it leaves hold the ones it enters, and only
+// those slabs are cleared and voxelized; the rest of the volume stays as it is.
+// Windows move in steps of snap voxels, so mips up to that size never mix the two sides
+// of the seam. The voxels carry their lighting, so one z slice of one level is also
+// voxelized again each frame, cycling through refreshSlices slices per level.
+class LampVoxelClipmap
+{
+public:
+    LampVoxelClipmap(UINT levels, const UINT dims[3], float voxelSize, UINT snap, UINT refreshSlices);
+    LampVoxelClipmap(const LampVoxelClipmap& rhs) = delete;
+    LampVoxelClipmap& operator=(const LampVoxelClipmap& rhs) = delete;
+    ~LampVoxelClipmap() = default;
+
+    // Centers the windows on the camera and collects this frame's slabs, with one per level
+    // around each of the dynamic bounds and each of the last frame's.
+    void Update(const DirectX::XMFLOAT3& eye, const std::vector<DirectX::BoundingBox>& dynamicBounds = {});
+    // The volumes were recreated: the next Update() voxelizes every level whole.
+    void Invalidate();
+
+    const std::vector<VoxelSlab>& Slabs()const { return mSlabs; }
+    UINT Levels()const { return (UINT)mLevels.size(); }
+    const VoxelClipLevel& Level(UINT level)const { return mLevels[level]; }
+    const UINT* Dims()const { return mDims; }
+    // The window's min corner in world space, and the voxel size, as the shaders read them.
+    DirectX::XMFLOAT4 Window(UINT level)const;
+
+    // Whether a world-space box, voxelized into the slab's level, can touch a voxel of the slab.
+    bool Touches(const VoxelSlab& slab, const DirectX::BoundingBox& bounds)const;
+    // The items of items that can touch the slab.
+    void SelectItems(const VoxelSlab& slab, const std::vector<RenderItem*>& items, std::vector<RenderItem*>& selected)const;
+    // The pixels of a rasterSize square target the slab covers when projected along axis:
+    // target x is axis (axis + 1) % 3 and target y is axis (axis + 2) % 3, pointing down.
+    D3D12_RECT Scissor(const VoxelSlab& slab, UINT axis, UINT rasterSize)const;
+
+    // Names of a level's volumes: level 0 keeps the base name.
+    static std::wstring VolumeName(const std::wstring& base, UINT level);
+    static UINT64 Voxels(const VoxelBox& box);
+    // The voxels of a level a world-space box can touch once voxelized, margin included.
+    VoxelBox Footprint(UINT level, const DirectX::BoundingBox& bounds)const;
+
+    // Voxels the last Update() had voxelized again, and the whole clipmap.
+    UINT64 LastVoxels()const { return mLastVoxels; }
+    UINT64 TotalVoxels()const;
+    std::wstring Report()const;
+
+private:
+    void AddSlab(UINT level, const VoxelBox& box, bool refresh, bool dynamic = false);
+
+    UINT mDims[3];
+    UINT mSnap;
+    UINT mRefreshSlices;
+    UINT64 mFrame = 0;
+    std::vector<VoxelClipLevel> mLevels;
+    std::vector<VoxelSlab> mSlabs;
+    std::vector<DirectX::BoundingBox> mLastDynamic;
+
+    UINT64 mLastVoxels = 0;
+    UINT64 mMovedFrames = 0;
+    UINT64 mRevoxelized = 0;
+    UINT64 mUpdates = 0;
+};
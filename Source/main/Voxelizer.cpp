@@ -0,0 +1,573 @@
+#include "Voxelizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    const int KeyBias = 1 << 20;
+    const UINT64 KeyMask = (1ull << 21) - 1;
+    // The triangle's plane and its edges crossed with the box axes. The box axes
+    // themselves are the voxel range.
+    const int AxisCount = 10;
+
+    void Cross(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    float Dot(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    float Saturate(float v)
+    {
+        return std::min<float>(std::max<float>(v, 0.0f), 1.0f);
+    }
+
+    bool Normalize(float v[3])
+    {
+        const float length = std::sqrt(Dot(v, v));
+        if (!(length > 1e-6f))
+            return false;
+        for (int a = 0; a < 3; ++a)
+            v[a] /= length;
+        return true;
+    }
+
+    int FloorDiv(int a, int b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    // The voxel whose center is at ((float)v + 0.5) * size, in the SIMD rows too.
+    float Center(int v, float size)
+    {
+        return ((float)v + 0.5f) * size;
+    }
+
+    // floor(lo / size) .. floor(hi / size) on each axis: the box faces of the separating axis test.
+    void VoxelRange(const XMFLOAT3 v[3], float size, int first[3], int last[3])
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            const float lo = std::min<float>((&v[0].x)[a], std::min<float>((&v[1].x)[a], (&v[2].x)[a]));
+            const float hi = std::max<float>((&v[0].x)[a], std::max<float>((&v[1].x)[a], (&v[2].x)[a]));
+            first[a] = (int)std::floor(lo / size);
+            last[a] = (int)std::floor(hi / size);
+        }
+    }
+
+    // The triangle projected on each remaining separating axis, against the radius of a
+    // voxel on it.
+    struct TriangleAxes
+    {
+        float X[AxisCount];
+        float Y[AxisCount];
+        float Z[AxisCount];
+        float Min[AxisCount];
+        float Max[AxisCount];
+        float Radius[AxisCount];
+
+        TriangleAxes(const XMFLOAT3 v[3], float size)
+        {
+            const float* p[3] = { &v[0].x, &v[1].x, &v[2].x };
+            float e[3][3];
+            for (int a = 0; a < 3; ++a)
+            {
+                e[0][a] = p[1][a] - p[0][a];
+                e[1][a] = p[2][a] - p[1][a];
+                e[2][a] = p[0][a] - p[2][a];
+            }
+            float axes[AxisCount][3];
+            Cross(e[0], e[1], axes[0]);
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int a = 0; a < 3; ++a)
+                {
+                    const float unit[3] = { a == 0 ? 1.0f : 0.0f, a == 1 ? 1.0f : 0.0f, a == 2 ? 1.0f : 0.0f };
+                    Cross(e[i], unit, axes[1 + i * 3 + a]);
+                }
+            }
+            const float h = 0.5f * size;
+            for (int k = 0; k < AxisCount; ++k)
+            {
+                X[k] = axes[k][0];
+                Y[k] = axes[k][1];
+                Z[k] = axes[k][2];
+                const float d0 = Dot(axes[k], p[0]);
+                const float d1 = Dot(axes[k], p[1]);
+                const float d2 = Dot(axes[k], p[2]);
+                Min[k] = std::min<float>(d0, std::min<float>(d1, d2));
+                Max[k] = std::max<float>(d0, std::max<float>(d1, d2));
+                Radius[k] = h * (std::fabs(X[k]) + std::fabs(Y[k]) + std::fabs(Z[k]));
+            }
+        }
+
+        // Operations in the order of the SIMD rows, so both agree to the bit.
+        bool Separates(float cx, float cy, float cz)const
+        {
+            for (int k = 0; k < AxisCount; ++k)
+            {
+                const float row = Y[k] * cy + Z[k] * cz;
+                const float d = X[k] * cx + row;
+                if (Min[k] - d > Radius[k] || Max[k] - d < -Radius[k])
+                    return true;
+            }
+            return false;
+        }
+    };
+
+    void Positions(const VoxelVertex v[3], XMFLOAT3 p[3])
+    {
+        for (int i = 0; i < 3; ++i)
+            p[i] = v[i].Position;
+    }
+
+    bool SameMaterial(const VoxelMaterial& a, const VoxelMaterial& b)
+    {
+        return a.DiffuseAlbedo.x == b.DiffuseAlbedo.x && a.DiffuseAlbedo.y == b.DiffuseAlbedo.y
+            && a.DiffuseAlbedo.z == b.DiffuseAlbedo.z && a.DiffuseAlbedo.w == b.DiffuseAlbedo.w
+            && a.Metallic == b.Metallic && a.Roughness == b.Roughness
+            && a.DiffuseMap == b.DiffuseMap && a.NormalMap == b.NormalMap;
+    }
+}
+
+LampVoxelizer::LampVoxelizer(float voxelSize) : mVoxelSize(voxelSize)
+{
+    assert(voxelSize > 0.0f);
+}
+
+UINT64 LampVoxelizer::Key(int x, int y, int z)
+{
+    assert(x >= -KeyBias && x < KeyBias && y >= -KeyBias && y < KeyBias && z >= -KeyBias && z < KeyBias);
+    return ((UINT64)(z + KeyBias) << 42) | ((UINT64)(y + KeyBias) << 21) | (UINT64)(x + KeyBias);
+}
+
+void LampVoxelizer::Unkey(UINT64 key, int voxel[3])
+{
+    voxel[0] = (int)(key & KeyMask) - KeyBias;
+    voxel[1] = (int)((key >> 21) & KeyMask) - KeyBias;
+    voxel[2] = (int)((key >> 42) & KeyMask) - KeyBias;
+}
+
+bool LampVoxelizer::Overlaps(const XMFLOAT3 v[3], const int voxel[3], float voxelSize)
+{
+    // The box's faces: half open, so a triangle on a face belongs to the voxel above it.
+    int first[3];
+    int last[3];
+    VoxelRange(v, voxelSize, first, last);
+    for (int a = 0; a < 3; ++a)
+    {
+        if (voxel[a] < first[a] || voxel[a] > last[a])
+            return false;
+    }
+    const TriangleAxes axes(v, voxelSize);
+    return !axes.Separates(Center(voxel[0], voxelSize), Center(voxel[1], voxelSize), Center(voxel[2], voxelSize));
+}
+
+void LampVoxelizer::AddTriangle(const VoxelVertex v[3], const VoxelMaterial& material)
+{
+    if (mMaterials.empty() || !SameMaterial(mMaterials.back(), material))
+        mMaterials.push_back(material);
+    Triangle tri;
+    for (int i = 0; i < 3; ++i)
+        tri.V[i] = v[i];
+    tri.Material = (UINT)mMaterials.size() - 1;
+    mTriangles.push_back(tri);
+}
+
+void LampVoxelizer::Clear()
+{
+    mTriangles.clear();
+    mMaterials.clear();
+}
+
+void LampVoxelizer::Accumulate(const Triangle& tri, const int voxel[3], Sum& sum)const
+{
+    const VoxelMaterial& material = mMaterials[tri.Material];
+    const float* p[3] = { &tri.V[0].Position.x, &tri.V[1].Position.x, &tri.V[2].Position.x };
+    const float c[3] = { Center(voxel[0], mVoxelSize), Center(voxel[1], mVoxelSize), Center(voxel[2], mVoxelSize) };
+
+    // Barycentrics of the voxel center projected onto the plane, clamped onto the triangle.
+    float e1[3];
+    float e2[3];
+    float q[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        e1[a] = p[1][a] - p[0][a];
+        e2[a] = p[2][a] - p[0][a];
+        q[a] = c[a] - p[0][a];
+    }
+    const float d00 = Dot(e1, e1);
+    const float d01 = Dot(e1, e2);
+    const float d11 = Dot(e2, e2);
+    const float d20 = Dot(q, e1);
+    const float d21 = Dot(q, e2);
+    const float denom = d00 * d11 - d01 * d01;
+    float w[3] = { 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f };
+    if (denom > 1e-12f * d00 * d11)
+    {
+        w[1] = std::max<float>((d11 * d20 - d01 * d21) / denom, 0.0f);
+        w[2] = std::max<float>((d00 * d21 - d01 * d20) / denom, 0.0f);
+        w[0] = std::max<float>(1.0f - (d11 * d20 - d01 * d21) / denom - (d00 * d21 - d01 * d20) / denom, 0.0f);
+        const float total = w[0] + w[1] + w[2];
+        for (int i = 0; i < 3; ++i)
+            w[i] /= total;
+    }
+
+    float n[3] = { 0.0f, 0.0f, 0.0f };
+    float t[3] = { 0.0f, 0.0f, 0.0f };
+    XMFLOAT2 uv(0.0f, 0.0f);
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            n[a] += w[i] * (&tri.V[i].Normal.x)[a];
+            t[a] += w[i] * (&tri.V[i].Tangent.x)[a];
+        }
+        uv.x += w[i] * tri.V[i].TexC.x;
+        uv.y += w[i] * tri.V[i].TexC.y;
+    }
+    if (!Normalize(n))
+    {
+        Cross(e1, e2, n);
+        if (!Normalize(n))
+        {
+            n[0] = 0.0f;
+            n[1] = 1.0f;
+            n[2] = 0.0f;
+        }
+    }
+
+    float albedo[3] = { material.DiffuseAlbedo.x, material.DiffuseAlbedo.y, material.DiffuseAlbedo.z };
+    if (material.DiffuseMap != nullptr)
+    {
+        float texel[4];
+        material.DiffuseMap->Sample(uv.x, uv.y, texel);
+        albedo[0] *= texel[0];
+        albedo[1] *= texel[1];
+        albedo[2] *= texel[2];
+    }
+
+    // NormalSampleToWorldSpace().
+    if (material.NormalMap != nullptr)
+    {
+        float texel[4];
+        material.NormalMap->Sample(uv.x, uv.y, texel);
+        const float normalT[3] = { 2.0f * texel[0] - 1.0f, 2.0f * texel[1] - 1.0f, 2.0f * texel[2] - 1.0f };
+        const float tn = Dot(t, n);
+        for (int a = 0; a < 3; ++a)
+            t[a] -= tn * n[a];
+        if (Normalize(t))
+        {
+            float b[3];
+            Cross(n, t, b);
+            float bumped[3];
+            for (int a = 0; a < 3; ++a)
+                bumped[a] = normalT[0] * t[a] + normalT[1] * b[a] + normalT[2] * n[a];
+            if (Normalize(bumped))
+            {
+                for (int a = 0; a < 3; ++a)
+                    n[a] = bumped[a];
+            }
+        }
+    }
+
+    for (int a = 0; a < 3; ++a)
+    {
+        sum.Albedo[a] += albedo[a];
+        sum.Normal[a] += n[a];
+    }
+    sum.Metallic += material.Metallic;
+    sum.Roughness += material.Roughness;
+    sum.Count++;
+}
+
+BakedVoxel LampVoxelizer::Pack(UINT64 key, const Sum& sum)
+{
+    const float inv = 1.0f / (float)sum.Count;
+    float n[3] = { sum.Normal[0], sum.Normal[1], sum.Normal[2] };
+    // Opposite faces in one voxel cancel out; point it up rather than nowhere.
+    if (!Normalize(n))
+    {
+        n[0] = 0.0f;
+        n[1] = 1.0f;
+        n[2] = 0.0f;
+    }
+
+    BakedVoxel voxel;
+    voxel.Key = key;
+    voxel.Albedo = PackUnorm(sum.Albedo[0] * inv, sum.Albedo[1] * inv, sum.Albedo[2] * inv, 1.0f);
+    voxel.Normal = PackUnorm(n[0] * 0.5f + 0.5f, n[1] * 0.5f + 0.5f, n[2] * 0.5f + 0.5f, 1.0f);
+    voxel.Mat = PackUnorm(sum.Metallic * inv, sum.Roughness * inv, 0.0f, 1.0f);
+    return voxel;
+}
+
+void LampVoxelizer::VoxelizeBin(const Bin& bin, std::vector<Sum>& grid, std::vector<BakedVoxel>& voxels)const
+{
+    const size_t cells = (size_t)BinSize * BinSize * BinSize;
+    if (grid.size() != cells)
+        grid.assign(cells, Sum());
+    std::vector<UINT> touched;
+
+    const XMVECTOR lanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+    const XMVECTOR half = XMVectorReplicate(0.5f);
+    const XMVECTOR size = XMVectorReplicate(mVoxelSize);
+    for (UINT index : bin.Triangles)
+    {
+        const Triangle& tri = mTriangles[index];
+        XMFLOAT3 p[3];
+        Positions(tri.V, p);
+        int first[3];
+        int last[3];
+        VoxelRange(p, mVoxelSize, first, last);
+        for (int a = 0; a < 3; ++a)
+        {
+            first[a] = std::max<int>(first[a], bin.Origin[a]);
+            last[a] = std::min<int>(last[a], bin.Origin[a] + BinSize - 1);
+        }
+
+        const TriangleAxes axes(p, mVoxelSize);
+        XMVECTOR ax[AxisCount];
+        XMVECTOR minus[AxisCount];
+        XMVECTOR plus[AxisCount];
+        for (int k = 0; k < AxisCount; ++k)
+        {
+            ax[k] = XMVectorReplicate(axes.X[k]);
+            // Separated where min - d > radius or max - d < -radius.
+            minus[k] = XMVectorReplicate(axes.Min[k]);
+            plus[k] = XMVectorReplicate(axes.Max[k]);
+        }
+
+        int voxel[3];
+        for (voxel[2] = first[2]; voxel[2] <= last[2]; ++voxel[2])
+        {
+            const float cz = Center(voxel[2], mVoxelSize);
+            for (voxel[1] = first[1]; voxel[1] <= last[1]; ++voxel[1])
+            {
+                const float cy = Center(voxel[1], mVoxelSize);
+                float row[AxisCount];
+                for (int k = 0; k < AxisCount; ++k)
+                    row[k] = axes.Y[k] * cy + axes.Z[k] * cz;
+
+                // Four voxels of the row at a time; lanes past the end count as separated.
+                for (int x = first[0]; x <= last[0]; x += 4)
+                {
+                    const XMVECTOR lane = XMVectorAdd(XMVectorReplicate((float)x), lanes);
+                    const XMVECTOR cx = XMVectorMultiply(XMVectorAdd(lane, half), size);
+                    XMVECTOR separated = XMVectorGreater(lane, XMVectorReplicate((float)last[0]));
+                    for (int k = 0; k < AxisCount; ++k)
+                    {
+                        const XMVECTOR d = XMVectorAdd(XMVectorMultiply(ax[k], cx), XMVectorReplicate(row[k]));
+                        const XMVECTOR radius = XMVectorReplicate(axes.Radius[k]);
+                        separated = XMVectorOrInt(separated, XMVectorOrInt(
+                            XMVectorGreater(XMVectorSubtract(minus[k], d), radius),
+                            XMVectorLess(XMVectorSubtract(plus[k], d), XMVectorNegate(radius))));
+                    }
+                    if (XMVector4EqualInt(separated, XMVectorTrueInt()))
+                        continue;
+
+                    XMUINT4 mask;
+                    XMStoreUInt4(&mask, separated);
+                    const UINT lanesSeparated[4] = { mask.x, mask.y, mask.z, mask.w };
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        if (lanesSeparated[i] != 0)
+                            continue;
+                        const int v[3] = { x + i, voxel[1], voxel[2] };
+                        const UINT cell = (UINT)(((v[2] - bin.Origin[2]) * BinSize + (v[1] - bin.Origin[1])) * BinSize + (v[0] - bin.Origin[0]));
+                        Sum& sum = grid[cell];
+                        if (sum.Count == 0)
+                            touched.push_back(cell);
+                        Accumulate(tri, v, sum);
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(touched.begin(), touched.end());
+    voxels.reserve(touched.size());
+    for (UINT cell : touched)
+    {
+        const int x = bin.Origin[0] + (int)(cell % BinSize);
+        const int y = bin.Origin[1] + (int)(cell / BinSize % BinSize);
+        const int z = bin.Origin[2] + (int)(cell / (BinSize * BinSize));
+        voxels.push_back(Pack(Key(x, y, z), grid[cell]));
+        grid[cell] = Sum();
+    }
+}
+
+std::vector<BakedVoxel> LampVoxelizer::Resolve(LampThreadPool& pool)const
+{
+    // Each triangle goes to every bin its voxel range reaches.
+    std::vector<Bin> bins;
+    std::unordered_map<UINT64, UINT> binIndex;
+    for (UINT t = 0; t < (UINT)mTriangles.size(); ++t)
+    {
+        XMFLOAT3 p[3];
+        Positions(mTriangles[t].V, p);
+        int first[3];
+        int last[3];
+        VoxelRange(p, mVoxelSize, first, last);
+        int b[3];
+        for (b[2] = FloorDiv(first[2], BinSize); b[2] <= FloorDiv(last[2], BinSize); ++b[2])
+        {
+            for (b[1] = FloorDiv(first[1], BinSize); b[1] <= FloorDiv(last[1], BinSize); ++b[1])
+            {
+                for (b[0] = FloorDiv(first[0], BinSize); b[0] <= FloorDiv(last[0], BinSize); ++b[0])
+                {
+                    auto found = binIndex.insert({ Key(b[0], b[1], b[2]), (UINT)bins.size() });
+                    if (found.second)
+                    {
+                        bins.emplace_back();
+                        for (int a = 0; a < 3; ++a)
+                            bins.back().Origin[a] = b[a] * BinSize;
+                    }
+                    bins[found.first->second].Triangles.push_back(t);
+                }
+            }
+        }
+    }
+
+    // Bins own disjoint voxels: no locks, one scratch grid per thread.
+    std::vector<std::vector<BakedVoxel>> binVoxels(bins.size());
+    std::vector<std::vector<Sum>> grids(pool.NumThreads());
+    pool.RunJobs((UINT)bins.size(), [&](UINT job, UINT thread)
+    {
+        VoxelizeBin(bins[job], grids[thread], binVoxels[job]);
+    });
+
+    size_t total = 0;
+    for (auto& v : binVoxels)
+        total += v.size();
+    std::vector<BakedVoxel> voxels;
+    voxels.reserve(total);
+    for (auto& v : binVoxels)
+        voxels.insert(voxels.end(), v.begin(), v.end());
+    std::sort(voxels.begin(), voxels.end(), [](const BakedVoxel& a, const BakedVoxel& b) { return a.Key < b.Key; });
+    return voxels;
+}
+
+std::vector<BakedVoxel> LampVoxelizer::ResolveReference()const
+{
+    std::unordered_map<UINT64, Sum> sums;
+    for (auto& tri : mTriangles)
+    {
+        XMFLOAT3 p[3];
+        Positions(tri.V, p);
+        int first[3];
+        int last[3];
+        VoxelRange(p, mVoxelSize, first, last);
+        int voxel[3];
+        for (voxel[2] = first[2]; voxel[2] <= last[2]; ++voxel[2])
+        {
+            for (voxel[1] = first[1]; voxel[1] <= last[1]; ++voxel[1])
+            {
+                for (voxel[0] = first[0]; voxel[0] <= last[0]; ++voxel[0])
+                {
+                    if (!Overlaps(p, voxel, mVoxelSize))
+                        continue;
+                    auto inserted = sums.insert({ Key(voxel[0], voxel[1], voxel[2]), Sum() });
+                    Accumulate(tri, voxel, inserted.first->second);
+                }
+            }
+        }
+    }
+
+    std::vector<BakedVoxel> voxels;
+    voxels.reserve(sums.size());
+    for (auto& entry : sums)
+        voxels.push_back(Pack(entry.first, entry.second));
+    std::sort(voxels.begin(), voxels.end(), [](const BakedVoxel& a, const BakedVoxel& b) { return a.Key < b.Key; });
+    return voxels;
+}
+
+UINT LampVoxelizer::PackUnorm(float r, float g, float b, float a)
+{
+    // R in the low byte, as DXGI_FORMAT_R8G8B8A8_UNORM lays it out.
+    auto unorm = [](float v) { return (UINT)(Saturate(v) * 255.0f + 0.5f); };
+    return unorm(r) | (unorm(g) << 8) | (unorm(b) << 16) | (unorm(a) << 24);
+}
+
+XMFLOAT4 LampVoxelizer::UnpackUnorm(UINT packed)
+{
+    return XMFLOAT4((packed & 0xff) / 255.0f, ((packed >> 8) & 0xff) / 255.0f,
+        ((packed >> 16) & 0xff) / 255.0f, ((packed >> 24) & 0xff) / 255.0f);
+}
+
+void LampVoxelizer::WriteVolumes(const std::vector<BakedVoxel>& voxels, const int windowMin[3], const UINT dims[3],
+    const XMFLOAT3& lightDirection, std::vector<UINT>& color, std::vector<UINT>& normal, std::vector<UINT>& mat)
+{
+    const size_t texels = (size_t)dims[0] * dims[1] * dims[2];
+    color.assign(texels, 0);
+    normal.assign(texels, 0);
+    mat.assign(texels, 0);
+    for (auto& voxel : voxels)
+    {
+        UINT texel[3];
+        if (!WindowTexel(voxel.Key, windowMin, dims, texel))
+            continue;
+        const size_t index = ((size_t)texel[2] * dims[1] + texel[1]) * dims[0] + texel[0];
+        color[index] = LitColor(voxel, lightDirection);
+        normal[index] = voxel.Normal;
+        mat[index] = voxel.Mat;
+    }
+}
+
+bool LampVoxelizer::WindowTexel(UINT64 key, const int windowMin[3], const UINT dims[3], UINT texel[3])
+{
+    int v[3];
+    Unkey(key, v);
+    bool inside = true;
+    for (int a = 0; a < 3; ++a)
+    {
+        const int offset = v[a] - windowMin[a];
+        inside = inside && offset >= 0 && offset < (int)dims[a];
+        texel[a] = (UINT)(((v[a] % (int)dims[a]) + (int)dims[a]) % (int)dims[a]);
+    }
+    return inside;
+}
+
+UINT LampVoxelizer::LitColor(const BakedVoxel& voxel, const XMFLOAT3& lightDirection)
+{
+    float toLight[3] = { -lightDirection.x, -lightDirection.y, -lightDirection.z };
+    Normalize(toLight);
+
+    // Voxelize.hlsl, with the shadow factor at 1.
+    const XMFLOAT4 albedo = UnpackUnorm(voxel.Albedo);
+    const XMFLOAT4 n = UnpackUnorm(voxel.Normal);
+    const XMFLOAT4 m = UnpackUnorm(voxel.Mat);
+    const float normalW[3] = { n.x * 2.0f - 1.0f, n.y * 2.0f - 1.0f, n.z * 2.0f - 1.0f };
+    const float radiance = std::max<float>(Dot(toLight, normalW), 0.0f);
+    const float scale = radiance * 0.32f * (1.0f - m.x * 0.5f);
+    return PackUnorm(albedo.x * scale, albedo.y * scale, albedo.z * scale, 1.0f);
+}
+
+UINT64 LampVoxelizer::CompareVolumes(const std::vector<UINT>& a, const std::vector<UINT>& b, UINT tolerance, UINT* maxError)
+{
+    assert(a.size() == b.size());
+    UINT64 differing = 0;
+    UINT largest = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        UINT error = 0;
+        for (int c = 0; c < 4; ++c)
+        {
+            const int x = (int)((a[i] >> (8 * c)) & 0xff);
+            const int y = (int)((b[i] >> (8 * c)) & 0xff);
+            error = std::max<UINT>(error, (UINT)std::abs(x - y));
+        }
+        largest = std::max<UINT>(largest, error);
+        if (error > tolerance)
+            differing++;
+    }
+    if (maxError != nullptr)
+        *maxError = largest;
+    return differing;
+}
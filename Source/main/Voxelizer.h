@@ -0,0 +1,120 @@
+#pragma once
+
+#include "../D3D/d3dUtil.h"
+#include "CpuTexture.h"
+#include "ThreadPool.h"
+#include <unordered_map>
+
+// A triangle corner in world space, with the texture coordinate the shaders sample at.
+struct VoxelVertex
+{
+    DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Normal = { 0.0f, 1.0f, 0.0f };
+    DirectX::XMFLOAT3 Tangent = { 1.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT2 TexC = { 0.0f, 0.0f };
+};
+
+// The voxelize pixel shader's material inputs. Without a map, the constants alone.
+struct VoxelMaterial
+{
+    DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float Metallic = 0.0f;
+    float Roughness = 0.0f;
+    const LampCpuTexture* DiffuseMap = nullptr;
+    const LampCpuTexture* NormalMap = nullptr;
+};
+
+// A voxel of a world-space grid, with attributes packed RGBA8 UNORM the way the voxel
+// volumes store them: albedo, normal * 0.5 + 0.5, and metallic, roughness, emissive.
+struct BakedVoxel
+{
+    UINT64 Key = 0;
+    UINT Albedo = 0;
+    UINT Normal = 0;
+    UINT Mat = 0;
+};
+
+// Voxelizes triangles on the CPU into a grid of voxelSize voxels: voxel v covers
+// [v, v + 1) * voxelSize. A triangle reaches every voxel it overlaps, faces and edges
+// included, as conservative rasterization does. Each voxel samples the material where
+// its center projects onto the triangle, as the voxelize shader does per pixel, and
+// averages the triangles that reached it.
+//
+// Resolve() bins the triangles into blocks of BinSize voxels per axis and voxelizes the
+// bins in parallel, testing four voxels of a row at once. A voxel belongs to one bin and
+// sums its triangles in the order they were added, so the result matches
+// ResolveReference(), which tests one voxel at a time with Overlaps().
+class LampVoxelizer
+{
+public:
+    static const int BinSize = 32;
+
+    explicit LampVoxelizer(float voxelSize);
+    LampVoxelizer(const LampVoxelizer& rhs) = delete;
+    LampVoxelizer& operator=(const LampVoxelizer& rhs) = delete;
+    ~LampVoxelizer() = default;
+
+    // The material's maps must outlive Resolve().
+    void AddTriangle(const VoxelVertex v[3], const VoxelMaterial& material);
+    void Clear();
+
+    // The voxels the triangles reach, sorted by key.
+    std::vector<BakedVoxel> Resolve(LampThreadPool& pool = LampThreadPool::Default())const;
+    std::vector<BakedVoxel> ResolveReference()const;
+
+    float VoxelSize()const { return mVoxelSize; }
+    UINT64 TriangleCount()const { return mTriangles.size(); }
+
+    // Voxel coordinates within +-2^20, ordered by z, then y, then x.
+    static UINT64 Key(int x, int y, int z);
+    static void Unkey(UINT64 key, int voxel[3]);
+    // Separating axis test of a triangle against one voxel. A triangle lying on a voxel
+    // face reaches the voxel above it only, like the shader's floor().
+    static bool Overlaps(const DirectX::XMFLOAT3 v[3], const int voxel[3], float voxelSize);
+
+    static UINT PackUnorm(float r, float g, float b, float a);
+    static DirectX::XMFLOAT4 UnpackUnorm(UINT packed);
+
+    // The three volumes Voxelize writes for a window of dims voxels from windowMin, each
+    // voxel at texel voxel mod dims, RGBA8 in x, then y, then z order. Color is lit by a
+    // directional light as the shader lights it, without shadows.
+    static void WriteVolumes(const std::vector<BakedVoxel>& voxels, const int windowMin[3], const UINT dims[3],
+        const DirectX::XMFLOAT3& lightDirection, std::vector<UINT>& color, std::vector<UINT>& normal, std::vector<UINT>& mat);
+    // The texel of such a window that holds the voxel; false when the window does not.
+    static bool WindowTexel(UINT64 key, const int windowMin[3], const UINT dims[3], UINT texel[3]);
+    static UINT LitColor(const BakedVoxel& voxel, const DirectX::XMFLOAT3& lightDirection);
+    // Texels whose channels differ by more than tolerance, out of 255; maxError gets the largest difference.
+    static UINT64 CompareVolumes(const std::vector<UINT>& a, const std::vector<UINT>& b, UINT tolerance, UINT* maxError = nullptr);
+
+private:
+    struct Triangle
+    {
+        VoxelVertex V[3];
+        UINT Material;
+    };
+
+    struct Sum
+    {
+        float Albedo[3];
+        float Normal[3];
+        float Metallic;
+        float Roughness;
+        UINT Count;
+    };
+
+    struct Bin
+    {
+        int Origin[3];
+        std::vector<UINT> Triangles;
+    };
+
+    void VoxelizeBin(const Bin& bin, std::vector<Sum>& grid, std::vector<BakedVoxel>& voxels)const;
+    // What the triangle leaves in the voxel: the material sampled at the voxel's center.
+    void Accumulate(const Triangle& tri, const int voxel[3], Sum& sum)const;
+    static BakedVoxel Pack(UINT64 key, const Sum& sum);
+
+    float mVoxelSize;
+    std::vector<Triangle> mTriangles;
+    // Consecutive triangles of one material share it.
+    std::vector<VoxelMaterial> mMaterials;
+};
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "RenderItem.h"
+#include "Instancing.h"
+#include "TransformHierarchy.h"
+#include "Octree.h"
+#include "DirtyTracker.h"
+#include "CpuTexture.h"
 #include "./Geometry/GeometryGenerator.h"
 #include "../D3D/FrameResource.h"
 
@@ -17,7 +22,28 @@ public:
     std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 
     std::vector<RenderItem*>& RenderItems(RenderLayer layer);
+    LampInstancing& Instancing(RenderLayer layer);
+    LampTransforms& Transforms() { return mTransforms; }
+    // Query values are indices into mAllRitems.
+    LampOctree& Octree() { return mOctree; }
+    // Refiles the items whose bounds moved since the last call.
+    void UpdateOctree();
+
+    // Queue the item's object constants or the material's data for upload to every frame resource.
+    void MarkDirty(RenderItem* ri) { mObjectDirty.MarkDirty(ri->ObjCBIndex); }
+    void MarkDirty(Material* mat) { mMaterialDirty.MarkDirty(mat->MatCBIndex); }
+    LampDirtyTracker& ObjectDirty() { return mObjectDirty; }
+    LampDirtyTracker& MaterialDirty() { return mMaterialDirty; }
+    // Constant buffer index to owner; also the element counts the frame buffers need.
+    RenderItem* ItemByCBIndex(UINT index) { return mItemByCBIndex[index]; }
+    Material* MaterialByCBIndex(UINT index) { return mMaterialByCBIndex[index]; }
+    UINT ObjectCBCount()const { return (UINT)mItemByCBIndex.size(); }
+    UINT MaterialCBCount()const { return (UINT)mMaterialByCBIndex.size(); }
     Microsoft::WRL::ComPtr<ID3D12Resource> TextureRes(std::string name);
+    // The 2D textures in SRV table order, as materials index them.
+    static const std::vector<std::string>& TextureTable();
+    // CPU copies of TextureTable(), null where the format has none.
+    std::vector<const LampCpuTexture*> CpuTextures()const;
     void LoadScene(ID3D12GraphicsCommandList* mCommandList);
 
 private:
@@ -29,14 +55,39 @@ private:
     std::vector<Submesh> submeshes;
     // Render items divided by PSO.
     std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
+    // Instanced batches of each layer, rebuilt per frame.
+    LampInstancing mInstancing[(int)RenderLayer::Count];
+    // Scene graph driving RenderItem::World.
+    LampTransforms mTransforms;
+    // Nodes of the loaded glTF model in file order.
+    struct ModelNode
+    {
+        int Parent = -1;
+        // Mesh geometry the node draws, empty for grouping nodes.
+        std::string MeshName;
+        DirectX::XMFLOAT4X4 Local;
+    };
+    std::vector<ModelNode> mModelNodes;
+    // Opaque and wall items for region queries.
+    LampOctree mOctree;
+
+    LampDirtyTracker mObjectDirty;
+    LampDirtyTracker mMaterialDirty;
+    std::vector<RenderItem*> mItemByCBIndex;
+    std::vector<Material*> mMaterialByCBIndex;
 
     std::unordered_map<std::string, std::unique_ptr<Mesh>> mGeometries;
     std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+    std::unordered_map<std::string, std::unique_ptr<LampCpuTexture>> mCpuTextures;
 
     void BuildShapeGeometry(ID3D12GraphicsCommandList* mCommandList);
     void BuildSkullGeometry(ID3D12GraphicsCommandList* mCommandList);
     void BuildMaterials();
     void BuildRenderItems();
+    void BuildBounds();
+    void BuildTransforms();
+    void BuildOctree();
+    void BuildDirtyTracking();
     void LoadTextures(ID3D12GraphicsCommandList* mCommandList);
     HRESULT LoadOBJ(ID3D12GraphicsCommandList* mCommandList, const char* fileName);
     HRESULT mLoadOBJ(ID3D12GraphicsCommandList* mCommandList);
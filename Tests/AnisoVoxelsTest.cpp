@@ -0,0 +1,266 @@
+#include "LampTest.h"
+#include "main/AnisoVoxels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    XMFLOAT3 RandomUnit(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (;;)
+        {
+            const XMFLOAT3 d(unit(rng), unit(rng), unit(rng));
+            const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+            if (length > 0.1f && length <= 1.0f)
+                return XMFLOAT3(d.x / length, d.y / length, d.z / length);
+        }
+    }
+
+    float ColorError(const VoxelConeResult& a, const VoxelConeResult& b)
+    {
+        return (std::fabs(a.Radiance.x - b.Radiance.x) + std::fabs(a.Radiance.y - b.Radiance.y) + std::fabs(a.Radiance.z - b.Radiance.z)) / 3.0f;
+    }
+
+    // Solid box [lo, hi) of texels.
+    void FillBox(std::vector<UINT>& volume, const UINT dims[3], const UINT lo[3], const UINT hi[3], UINT texel)
+    {
+        for (UINT z = lo[2]; z < std::min<UINT>(hi[2], dims[2]); ++z)
+            for (UINT y = lo[1]; y < std::min<UINT>(hi[1], dims[1]); ++y)
+                for (UINT x = lo[0]; x < std::min<UINT>(hi[0], dims[0]); ++x)
+                    volume[((size_t)z * dims[1] + y) * dims[0] + x] = texel;
+    }
+}
+
+// Build times, memory, and the error of isotropic and anisotropic cones against rays
+// in a room of thin walls, by step count.
+static std::wstring Room(UINT cones)
+{
+    // Level 0's volume: the room between two walls one voxel thick, with doorways, and
+    // bright panels behind the walls.
+    const UINT dims[3] = { 256, 128, 256 };
+    const UINT mips = 7;
+    std::vector<UINT> base((size_t)dims[0] * dims[1] * dims[2], 0);
+    auto box = [&](UINT x0, UINT y0, UINT z0, UINT x1, UINT y1, UINT z1, float r, float g, float b)
+    {
+        const UINT lo[3] = { x0, y0, z0 };
+        const UINT hi[3] = { x1, y1, z1 };
+        FillBox(base, dims, lo, hi, LampVoxelizer::PackUnorm(r, g, b, 1.0f));
+    };
+    box(0, 0, 0, 256, 1, 256, 0.4f, 0.4f, 0.4f);
+    for (UINT wall : { 80u, 176u })
+    {
+        box(wall, 0, 0, wall + 1, 80, 112, 0.5f, 0.5f, 0.5f);
+        box(wall, 48, 112, wall + 1, 80, 144, 0.5f, 0.5f, 0.5f);
+        box(wall, 0, 144, wall + 1, 80, 256, 0.5f, 0.5f, 0.5f);
+    }
+    box(72, 8, 16, 73, 72, 240, 1.0f, 0.2f, 0.1f);
+    box(184, 8, 16, 185, 72, 240, 0.1f, 1.0f, 0.2f);
+    box(120, 1, 60, 136, 24, 76, 0.2f, 0.3f, 0.9f);
+    box(112, 1, 170, 144, 8, 200, 0.9f, 0.8f, 0.2f);
+
+    std::wstring report = L"Anisotropic voxel benchmark: " + std::to_wstring(dims[0]) + L"x" + std::to_wstring(dims[1]) + L"x"
+        + std::to_wstring(dims[2]) + L", " + std::to_wstring(mips) + L" mips\n";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::vector<std::vector<UINT>> isotropic = LampBrickMap::DenseMips(base, dims, mips);
+    const double isotropicMs = Milliseconds(start);
+    LampAnisoVoxels aniso(dims, mips);
+    start = std::chrono::high_resolution_clock::now();
+    aniso.BuildReference(base);
+    const double referenceMs = Milliseconds(start);
+    LampThreadPool single(1);
+    start = std::chrono::high_resolution_clock::now();
+    aniso.Build(base, single);
+    const double simdMs = Milliseconds(start);
+    start = std::chrono::high_resolution_clock::now();
+    aniso.Build(base);
+    const double poolMs = Milliseconds(start);
+    report += L"  build: " + std::to_wstring(isotropicMs) + L" ms isotropic, " + std::to_wstring(referenceMs) + L" ms reference, "
+        + std::to_wstring(simdMs) + L" ms SIMD on one thread, " + std::to_wstring(poolMs) + L" ms on "
+        + std::to_wstring(LampThreadPool::Default().NumThreads()) + L" threads\n";
+    report += L"  memory: " + std::to_wstring(aniso.IsotropicBytes() / (1024 * 1024)) + L" MiB isotropic, "
+        + std::to_wstring(aniso.Bytes() / (1024 * 1024)) + L" MiB with six faces above mip 0, "
+        + std::to_wstring((aniso.Bytes() + 6 * base.size() * sizeof(UINT)) / (1024 * 1024)) + L" MiB with six faces of mip 0 too\n";
+
+    // Cones from the middle room, against rays spread over them.
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> x(90.0f, 166.0f);
+    std::uniform_real_distribution<float> y(4.0f, 60.0f);
+    std::uniform_real_distribution<float> z(16.0f, 240.0f);
+    VoxelConeSetup setup;
+    setup.VoxelSize = 0.1f;
+    struct Cone
+    {
+        XMFLOAT3 Start;
+        XMFLOAT3 Direction;
+    };
+    std::vector<Cone> tests(cones);
+    for (auto& cone : tests)
+        cone = { XMFLOAT3(x(rng) * setup.VoxelSize, y(rng) * setup.VoxelSize, z(rng) * setup.VoxelSize), RandomUnit(rng) };
+
+    for (float aperture : { 0.15f, 0.3f })
+    {
+        setup.Aperture = aperture;
+        std::vector<VoxelConeResult> rays(cones);
+        for (UINT i = 0; i < cones; ++i)
+            rays[i] = LampAnisoVoxels::ConeTraceRays(base, dims, setup, tests[i].Start, tests[i].Direction, 32);
+        report += L"  aperture " + std::to_wstring(aperture) + L", mean color error against 32 rays:";
+        for (UINT steps : { 6u, 8u, 12u, 16u, 24u })
+        {
+            setup.Steps = steps;
+            double isoError = 0.0;
+            double anisoError = 0.0;
+            UINT64 samples = 0;
+            for (UINT i = 0; i < cones; ++i)
+            {
+                isoError += ColorError(LampAnisoVoxels::ConeTraceIsotropic(isotropic, dims, setup, tests[i].Start, tests[i].Direction), rays[i]);
+                const VoxelConeResult cone = aniso.ConeTrace(setup, tests[i].Start, tests[i].Direction);
+                anisoError += ColorError(cone, rays[i]);
+                samples += cone.Samples;
+            }
+            report += L" " + std::to_wstring(steps) + L" steps " + std::to_wstring(isoError / cones) + L" isotropic / "
+                + std::to_wstring(anisoError / cones) + L" anisotropic (" + std::to_wstring((double)samples / cones) + L" samples);";
+        }
+        report += L"\n";
+    }
+    return report;
+}
+
+// Build() against BuildReference(), walls and solids with known mips, and cones through a wall.
+static std::wstring Volumes(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT64 texels = 0;
+
+    // Random volumes: the parallel SIMD build is the reference's, texel for texel.
+    LampThreadPool single(1);
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        UINT dims[3];
+        for (int a = 0; a < 3; ++a)
+            dims[a] = 4 * (1 + rng() % 6) + (rng() % 4 == 0 ? rng() % 3 : 0);
+        const UINT mips = 2 + rng() % 3;
+        const bool anisotropicBase = rng() % 4 == 0;
+        std::vector<UINT> base((size_t)dims[0] * dims[1] * dims[2], 0);
+        for (auto& texel : base)
+        {
+            const UINT kind = rng() % 8;
+            texel = kind < 5 ? 0 : kind < 7 ? rng() | 0xff000000u : rng();
+        }
+        LampAnisoVoxels reference(dims, mips, anisotropicBase);
+        reference.BuildReference(base);
+        LampAnisoVoxels simd(dims, mips, anisotropicBase);
+        simd.Build(base, single);
+        LampAnisoVoxels parallel(dims, mips, anisotropicBase);
+        parallel.Build(base);
+        for (UINT m = 0; m < mips && error.empty(); ++m)
+        {
+            const UINT* d = reference.Dims(m);
+            for (UINT face = 0; face < LampAnisoVoxels::Faces && error.empty(); ++face)
+            {
+                for (UINT z = 0; z < d[2] && error.empty(); ++z)
+                {
+                    for (UINT y = 0; y < d[1] && error.empty(); ++y)
+                    {
+                        for (UINT x = 0; x < d[0]; ++x)
+                        {
+                            const UINT expected = reference.Fetch(face, m, x, y, z);
+                            texels++;
+                            if (simd.Fetch(face, m, x, y, z) != expected || parallel.Fetch(face, m, x, y, z) != expected)
+                            {
+                                error = L"SIMD build differs from the reference in mip " + std::to_wstring(m) + L" " + LampAnisoVoxels::FaceName(face);
+                                break;
+                            }
+                            if (m == 0 && expected != base[((size_t)z * d[1] + y) * d[0] + x])
+                            {
+                                error = L"mip 0 is not the base";
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // A wall one voxel thick across x: opaque to cones along x at every mip, half as
+    // opaque along y in mip 1. A solid block keeps its color in every face.
+    if (error.empty())
+    {
+        const UINT dims[3] = { 32, 16, 16 };
+        std::vector<UINT> base((size_t)32 * 16 * 16, 0);
+        const UINT wallLo[3] = { 9, 0, 0 };
+        const UINT wallHi[3] = { 10, 16, 16 };
+        FillBox(base, dims, wallLo, wallHi, LampVoxelizer::PackUnorm(0.2f, 0.4f, 0.6f, 1.0f));
+        LampAnisoVoxels aniso(dims, 4);
+        aniso.Build(base);
+        for (UINT m = 1; m < 4 && error.empty(); ++m)
+        {
+            const UINT x = 9 >> m;
+            if (aniso.Fetch(0, m, x, 1, 1) >> 24 != 255 || aniso.Fetch(1, m, x, 1, 1) >> 24 != 255)
+                error = L"a wall is not opaque across it in mip " + std::to_wstring(m);
+        }
+        if (error.empty() && (aniso.Fetch(2, 1, 4, 1, 1) >> 24 != 128 || aniso.Fetch(5, 1, 4, 1, 1) >> 24 != 128))
+            error = L"a wall is not half opaque along it in mip 1";
+
+        const UINT solid = LampVoxelizer::PackUnorm(0.2f, 0.4f, 0.6f, 1.0f);
+        std::vector<UINT> block((size_t)32 * 16 * 16, solid);
+        LampAnisoVoxels filled(dims, 4);
+        filled.Build(block);
+        for (UINT face = 0; face < LampAnisoVoxels::Faces && error.empty(); ++face)
+        {
+            if (filled.Fetch(face, 3, 1, 1, 1) != solid)
+                error = L"a solid block changes color in face " + std::wstring(LampAnisoVoxels::FaceName(face));
+        }
+
+        // A lit panel right behind the wall, in the same coarse texels: anisotropic cones see
+        // the wall's side only, isotropic ones average the panel's light in.
+        std::vector<UINT> lit = base;
+        const UINT panelLo[3] = { 8, 0, 0 };
+        const UINT panelHi[3] = { 9, 16, 16 };
+        FillBox(lit, dims, panelLo, panelHi, LampVoxelizer::PackUnorm(1.0f, 1.0f, 1.0f, 1.0f));
+        const UINT wallColor = LampVoxelizer::PackUnorm(0.0f, 0.0f, 0.0f, 1.0f);
+        FillBox(lit, dims, wallLo, wallHi, wallColor);
+        LampAnisoVoxels litAniso(dims, 4);
+        litAniso.Build(lit);
+        const std::vector<std::vector<UINT>> isotropic = LampBrickMap::DenseMips(lit, dims, 4);
+        VoxelConeSetup setup;
+        setup.VoxelSize = 1.0f;
+        setup.Aperture = 0.5f;
+        setup.Steps = 16;
+        setup.Miss = 0.0f;
+        const XMFLOAT3 from(20.5f, 8.0f, 8.0f);
+        const XMFLOAT3 toward(-1.0f, 0.0f, 0.0f);
+        const VoxelConeResult anisoCone = litAniso.ConeTrace(setup, from, toward);
+        const VoxelConeResult isoCone = LampAnisoVoxels::ConeTraceIsotropic(isotropic, dims, setup, from, toward);
+        if (error.empty() && (anisoCone.Radiance.w < 0.9f || anisoCone.Radiance.x > 0.01f))
+            error = L"light leaks through a wall into an anisotropic cone";
+        if (error.empty() && !(isoCone.Radiance.x > anisoCone.Radiance.x + 0.05f))
+            error = L"isotropic cone shows no leak to compare against";
+    }
+
+    if (!error.empty())
+        return L"Anisotropic voxels FAILED: " + error + L"\n";
+    return L"Anisotropic voxels: " + std::to_wstring(iterations) + L" volumes, " + std::to_wstring(texels) + L" texels, ok\n";
+}
+
+LAMP_TEST(AnisoVoxels, Volumes)
+{
+    return Volumes(50, 1);
+}
+
+LAMP_BENCHMARK(AnisoVoxels, Room)
+{
+    return Room(500);
+}
@@ -0,0 +1,444 @@
+#include "LampTest.h"
+#include "main/BrickMap.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const UINT BrickSize = LampBrickMap::BrickSize;
+    const UINT BrickTexels = LampBrickMap::BrickTexels;
+
+    bool SameTrace(const VoxelTraceResult& a, const VoxelTraceResult& b)
+    {
+        return a.Hit == b.Hit && a.Samples == b.Samples && a.Color.x == b.Color.x && a.Color.y == b.Color.y && a.Color.z == b.Color.z;
+    }
+
+    XMFLOAT3 RandomDirection(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (;;)
+        {
+            const XMFLOAT3 d(unit(rng), unit(rng), unit(rng));
+            const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+            if (length > 0.1f && length <= 1.0f)
+                return XMFLOAT3(d.x / length, d.y / length, d.z / length);
+        }
+    }
+
+    // Two triangles of a quad from corner along u and v.
+    void AddQuad(LampVoxelizer& voxelizer, const XMFLOAT3& corner, const XMFLOAT3& u, const XMFLOAT3& v, const VoxelMaterial& material)
+    {
+        const XMFLOAT3 p[4] = { corner, XMFLOAT3(corner.x + u.x, corner.y + u.y, corner.z + u.z),
+            XMFLOAT3(corner.x + v.x, corner.y + v.y, corner.z + v.z),
+            XMFLOAT3(corner.x + u.x + v.x, corner.y + u.y + v.y, corner.z + u.z + v.z) };
+        XMFLOAT3 n(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x);
+        const float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        n = XMFLOAT3(n.x / length, n.y / length, n.z / length);
+        VoxelVertex quad[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            quad[i].Position = p[i];
+            quad[i].Normal = n;
+        }
+        const VoxelVertex a[3] = { quad[0], quad[1], quad[2] };
+        const VoxelVertex b[3] = { quad[1], quad[3], quad[2] };
+        voxelizer.AddTriangle(a, material);
+        voxelizer.AddTriangle(b, material);
+    }
+
+    // A closed box from lo to hi.
+    void AddBox(LampVoxelizer& voxelizer, const XMFLOAT3& lo, const XMFLOAT3& hi, const VoxelMaterial& material)
+    {
+        const XMFLOAT3 size(hi.x - lo.x, hi.y - lo.y, hi.z - lo.z);
+        const XMFLOAT3 x(size.x, 0.0f, 0.0f);
+        const XMFLOAT3 y(0.0f, size.y, 0.0f);
+        const XMFLOAT3 z(0.0f, 0.0f, size.z);
+        AddQuad(voxelizer, lo, z, x, material);
+        AddQuad(voxelizer, XMFLOAT3(lo.x, hi.y, lo.z), x, z, material);
+        AddQuad(voxelizer, lo, x, y, material);
+        AddQuad(voxelizer, XMFLOAT3(lo.x, lo.y, hi.z), y, x, material);
+        AddQuad(voxelizer, lo, y, z, material);
+        AddQuad(voxelizer, XMFLOAT3(hi.x, lo.y, lo.z), z, y, material);
+    }
+
+    double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+// Memory and build times of the sparse and dense layouts of a voxelized room, and traces of rays through both.
+static std::wstring Room(UINT rays)
+{
+    // The clipmap's level 0 over a room the size of the probe grid: a floor, four walls and pillars.
+    const UINT dims[3] = { 256, 128, 256 };
+    const UINT mips = 7;
+    VoxelTraceSetup setup;
+    const int windowMin[3] = { -128, -2, -128 };
+    setup.WindowMin = XMFLOAT3(windowMin[0] * setup.VoxelSize, windowMin[1] * setup.VoxelSize, windowMin[2] * setup.VoxelSize);
+    const XMFLOAT3 light(0.3f, -1.0f, 0.2f);
+
+    LampVoxelizer voxelizer(setup.VoxelSize);
+    VoxelMaterial floor;
+    floor.DiffuseAlbedo = XMFLOAT4(0.8f, 0.7f, 0.6f, 1.0f);
+    VoxelMaterial wall;
+    wall.DiffuseAlbedo = XMFLOAT4(0.6f, 0.6f, 0.8f, 1.0f);
+    AddQuad(voxelizer, XMFLOAT3(-12.0f, 0.0f, -12.0f), XMFLOAT3(0.0f, 0.0f, 24.0f), XMFLOAT3(24.0f, 0.0f, 0.0f), floor);
+    AddBox(voxelizer, XMFLOAT3(-12.0f, 0.0f, -12.0f), XMFLOAT3(12.0f, 8.0f, -11.8f), wall);
+    AddBox(voxelizer, XMFLOAT3(-12.0f, 0.0f, 11.8f), XMFLOAT3(12.0f, 8.0f, 12.0f), wall);
+    AddBox(voxelizer, XMFLOAT3(-12.0f, 0.0f, -12.0f), XMFLOAT3(-11.8f, 8.0f, 12.0f), wall);
+    AddBox(voxelizer, XMFLOAT3(11.8f, 0.0f, -12.0f), XMFLOAT3(12.0f, 8.0f, 12.0f), wall);
+    for (int i = 0; i < 8; ++i)
+    {
+        const float x = -9.0f + 6.0f * (i % 4);
+        const float z = i < 4 ? -4.0f : 4.0f;
+        AddBox(voxelizer, XMFLOAT3(x, 0.0f, z), XMFLOAT3(x + 1.0f, 6.0f, z + 1.0f), wall);
+    }
+    const std::vector<BakedVoxel> voxels = voxelizer.Resolve();
+
+    // Dense: the three volumes, then the color volume's mips.
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<UINT> color;
+    std::vector<UINT> normal;
+    std::vector<UINT> mat;
+    LampVoxelizer::WriteVolumes(voxels, windowMin, dims, light, color, normal, mat);
+    const std::vector<std::vector<UINT>> denseMips = LampBrickMap::DenseMips(color, dims, mips);
+    const double denseMs = Milliseconds(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    LampBrickMap map(dims, mips);
+    map.Build(voxels, windowMin, light);
+    const double sparseMs = Milliseconds(start);
+
+    // Incremental: a pillar's bricks out and back in.
+    std::vector<UINT> removed;
+    const UINT pillar[3] = { (UINT)(-9.0f / setup.VoxelSize - windowMin[0]) / BrickSize, 1, (UINT)(-4.0f / setup.VoxelSize - windowMin[2]) / BrickSize };
+    start = std::chrono::high_resolution_clock::now();
+    UINT edited = 0;
+    for (UINT y = 0; y < 9; ++y)
+    {
+        for (UINT z = 0; z < 3; ++z)
+        {
+            for (UINT x = 0; x < 3; ++x)
+            {
+                const UINT brick[3] = { pillar[0] + x, pillar[1] + y, pillar[2] + z };
+                map.RemoveBrick(brick);
+                edited++;
+            }
+        }
+    }
+    map.UpdateMips();
+    const double removeMs = Milliseconds(start);
+    map.Build(voxels, windowMin, light);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> across(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> height(0.5f, 6.0f);
+    std::uniform_real_distribution<float> jitter(1.0f, 2.0f);
+    struct Ray
+    {
+        XMFLOAT3 Start;
+        XMFLOAT3 Direction;
+        float Jitter;
+    };
+    std::vector<Ray> tests(rays);
+    for (auto& ray : tests)
+        ray = { XMFLOAT3(across(rng), height(rng), across(rng)), RandomDirection(rng), jitter(rng) };
+    UINT hits = 0;
+    UINT mismatches = 0;
+    UINT64 samples = 0;
+    std::vector<VoxelTraceResult> dense(rays);
+    start = std::chrono::high_resolution_clock::now();
+    for (UINT i = 0; i < rays; ++i)
+        dense[i] = LampBrickMap::TraceDense(denseMips, dims, setup, tests[i].Start, tests[i].Direction, tests[i].Jitter);
+    const double denseTraceMs = Milliseconds(start);
+    start = std::chrono::high_resolution_clock::now();
+    for (UINT i = 0; i < rays; ++i)
+    {
+        const VoxelTraceResult trace = map.Trace(setup, tests[i].Start, tests[i].Direction, tests[i].Jitter);
+        hits += trace.Hit;
+        samples += trace.Samples;
+        mismatches += !SameTrace(trace, dense[i]);
+    }
+    const double sparseTraceMs = Milliseconds(start);
+
+    std::wstring report = L"Brick map benchmark: " + std::to_wstring(voxels.size()) + L" voxels of a room\n" + map.Report();
+    report += L"  three volumes: " + std::to_wstring(3 * map.DenseBytes() / (1024 * 1024)) + L" MiB dense, "
+        + std::to_wstring((3 * map.BrickBytes() + map.TableBytes()) / (1024 * 1024)) + L" MiB as bricks sharing one table\n";
+    report += L"  build: " + std::to_wstring(denseMs) + L" ms dense, " + std::to_wstring(sparseMs) + L" ms bricks; "
+        + std::to_wstring(edited) + L" bricks removed and mips updated in " + std::to_wstring(removeMs) + L" ms\n";
+    report += L"  " + std::to_wstring(rays) + L" traces, " + std::to_wstring(hits) + L" hits, " + std::to_wstring(samples) + L" samples: "
+        + std::to_wstring(denseTraceMs) + L" ms dense, " + std::to_wstring(sparseTraceMs) + L" ms bricks";
+    report += mismatches == 0 ? std::wstring(L", identical\n") : L", " + std::to_wstring(mismatches) + L" differ!\n";
+    return report;
+}
+
+// Builds and edits of random volumes against the dense layout, samples and traces.
+static std::wstring Volumes(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT64 bricks = 0;
+    UINT64 samples = 0;
+    UINT64 traces = 0;
+
+    // Every stored texel of every mip against the dense layout, and no empty bricks stored.
+    auto compare = [&](const LampBrickMap& map, const std::vector<UINT>& dense, const UINT dims[3], const wchar_t* what)
+    {
+        const std::vector<std::vector<UINT>> mips = LampBrickMap::DenseMips(dense, dims, map.Mips());
+        for (UINT m = 0; m < map.Mips() && error.empty(); ++m)
+        {
+            const UINT* d = map.Dims(m);
+            UINT occupied = 0;
+            for (UINT bz = 0; bz < (d[2] + BrickSize - 1) / BrickSize; ++bz)
+            {
+                for (UINT by = 0; by < (d[1] + BrickSize - 1) / BrickSize; ++by)
+                {
+                    for (UINT bx = 0; bx < (d[0] + BrickSize - 1) / BrickSize; ++bx)
+                    {
+                        bool any = false;
+                        for (UINT z = bz * BrickSize; z < std::min<UINT>((bz + 1) * BrickSize, d[2]); ++z)
+                        {
+                            for (UINT y = by * BrickSize; y < std::min<UINT>((by + 1) * BrickSize, d[1]); ++y)
+                            {
+                                for (UINT x = bx * BrickSize; x < std::min<UINT>((bx + 1) * BrickSize, d[0]); ++x)
+                                {
+                                    const UINT texel = mips[m][((size_t)z * d[1] + y) * d[0] + x];
+                                    any = any || texel != 0;
+                                    if (error.empty() && map.Fetch(m, x, y, z) != texel)
+                                        error = std::wstring(what) + L": brick map texel differs from the dense mip " + std::to_wstring(m);
+                                }
+                            }
+                        }
+                        occupied += any;
+                    }
+                }
+            }
+            if (error.empty() && occupied != map.BrickCount(m))
+                error = std::wstring(what) + L": brick map keeps " + std::to_wstring(map.BrickCount(m)) + L" bricks in mip "
+                    + std::to_wstring(m) + L", " + std::to_wstring(occupied) + L" hold anything";
+        }
+        return mips;
+    };
+
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        UINT dims[3];
+        for (int a = 0; a < 3; ++a)
+            dims[a] = BrickSize * (1 + rng() % 4) - (rng() % 4 == 0 ? rng() % 4 : 0);
+        const UINT mips = 1 + rng() % 4;
+
+        // A few solid blocks and scattered voxels; whole bricks stay empty.
+        const size_t count = (size_t)dims[0] * dims[1] * dims[2];
+        std::vector<UINT> dense(count, 0);
+        auto at = [&](UINT x, UINT y, UINT z) -> UINT& { return dense[((size_t)z * dims[1] + y) * dims[0] + x]; };
+        for (UINT b = 0; b < 1 + rng() % 3; ++b)
+        {
+            UINT lo[3];
+            UINT hi[3];
+            for (int a = 0; a < 3; ++a)
+            {
+                lo[a] = rng() % dims[a];
+                hi[a] = std::min<UINT>(dims[a], lo[a] + 1 + rng() % 6);
+            }
+            const UINT texel = rng() | 0xff000000u;
+            for (UINT z = lo[2]; z < hi[2]; ++z)
+                for (UINT y = lo[1]; y < hi[1]; ++y)
+                    for (UINT x = lo[0]; x < hi[0]; ++x)
+                        at(x, y, z) = texel;
+        }
+        for (UINT v = 0; v < 8; ++v)
+            at(rng() % dims[0], rng() % dims[1], rng() % dims[2]) = rng();
+
+        LampBrickMap map(dims, mips);
+        map.Build(dense);
+        compare(map, dense, dims, L"build");
+        bricks += map.BrickCount();
+
+        // Edits applied to both, then the mips of the edited bricks only.
+        for (UINT e = 0; e < 1 + rng() % 6 && error.empty(); ++e)
+        {
+            const UINT* bricks = map.Bricks(0);
+            const UINT brick[3] = { (UINT)(rng() % bricks[0]), (UINT)(rng() % bricks[1]), (UINT)(rng() % bricks[2]) };
+            const UINT kind = rng() % 4;
+            UINT texels[BrickTexels] = {};
+            if (kind == 1 && rng() % 2)
+            {
+                for (UINT i = 0; i < 16; ++i)
+                    texels[rng() % BrickTexels] = rng();
+            }
+            for (UINT z = 0; z < BrickSize; ++z)
+            {
+                for (UINT y = 0; y < BrickSize; ++y)
+                {
+                    for (UINT x = 0; x < BrickSize; ++x)
+                    {
+                        const UINT p[3] = { brick[0] * BrickSize + x, brick[1] * BrickSize + y, brick[2] * BrickSize + z };
+                        if (kind == 3 || p[0] >= dims[0] || p[1] >= dims[1] || p[2] >= dims[2])
+                            continue;
+                        if (kind < 2)
+                            at(p[0], p[1], p[2]) = texels[(z * BrickSize + y) * BrickSize + x];
+                        else if (kind == 2)
+                        {
+                            // Cleared one texel at a time, so the brick is left stored empty until UpdateMips().
+                            at(p[0], p[1], p[2]) = 0;
+                            map.SetTexel(p[0], p[1], p[2], 0);
+                        }
+                    }
+                }
+            }
+            if (kind == 0)
+                map.RemoveBrick(brick);
+            else if (kind == 1)
+                map.SetBrick(brick, texels);
+            else if (kind == 3)
+            {
+                const UINT p[3] = { (UINT)(rng() % dims[0]), (UINT)(rng() % dims[1]), (UINT)(rng() % dims[2]) };
+                const UINT texel = rng() % 2 ? rng() : 0;
+                at(p[0], p[1], p[2]) = texel;
+                map.SetTexel(p[0], p[1], p[2], texel);
+            }
+        }
+        map.UpdateMips();
+        const std::vector<std::vector<UINT>> mips0 = compare(map, dense, dims, L"edits");
+
+        // Every brick out and back in: nothing is left stored, and the freed slots take the
+        // bricks back without the pool growing.
+        if (error.empty())
+        {
+            const UINT stored = map.BrickCount();
+            const UINT64 pool = map.PoolBytes();
+            const UINT* bricks = map.Bricks(0);
+            for (UINT bz = 0; bz < bricks[2]; ++bz)
+            {
+                for (UINT by = 0; by < bricks[1]; ++by)
+                {
+                    for (UINT bx = 0; bx < bricks[0]; ++bx)
+                    {
+                        const UINT brick[3] = { bx, by, bz };
+                        map.RemoveBrick(brick);
+                    }
+                }
+            }
+            map.UpdateMips();
+            if (map.BrickCount() != 0)
+                error = L"brick map keeps bricks after all are removed";
+            for (UINT bz = 0; bz < bricks[2]; ++bz)
+            {
+                for (UINT by = 0; by < bricks[1]; ++by)
+                {
+                    for (UINT bx = 0; bx < bricks[0]; ++bx)
+                    {
+                        UINT texels[BrickTexels] = {};
+                        for (UINT z = 0; z < BrickSize; ++z)
+                            for (UINT y = 0; y < BrickSize; ++y)
+                                for (UINT x = 0; x < BrickSize; ++x)
+                                    if (bx * BrickSize + x < dims[0] && by * BrickSize + y < dims[1] && bz * BrickSize + z < dims[2])
+                                        texels[(z * BrickSize + y) * BrickSize + x] = at(bx * BrickSize + x, by * BrickSize + y, bz * BrickSize + z);
+                        const UINT brick[3] = { bx, by, bz };
+                        map.SetBrick(brick, texels);
+                    }
+                }
+            }
+            map.UpdateMips();
+            if (error.empty() && (map.BrickCount() != stored || map.PoolBytes() != pool))
+                error = L"brick pool grows while slots are free";
+            compare(map, dense, dims, L"reinsert");
+        }
+
+        // Samples at random points, inside and wrapped, and traces through the volume.
+        for (UINT s = 0; s < 64 && error.empty(); ++s)
+        {
+            const UINT m = rng() % mips;
+            std::uniform_real_distribution<float> coord(-0.5f, 1.5f);
+            const XMFLOAT3 uvw(coord(rng), coord(rng), coord(rng));
+            const XMFLOAT4 a = map.Sample(uvw, m);
+            const XMFLOAT4 b = LampBrickMap::SampleDense(mips0[m], map.Dims(m), uvw);
+            samples++;
+            if (a.x != b.x || a.y != b.y || a.z != b.z || a.w != b.w)
+                error = L"brick map sample differs from the dense volume";
+        }
+        VoxelTraceSetup setup;
+        setup.VoxelSize = 0.25f;
+        setup.WindowMin = XMFLOAT3(-(float)(rng() % 8), 0.0f, (float)(rng() % 8));
+        setup.Steps = rng() % 2 ? 24 : 32;
+        for (UINT t = 0; t < 16 && error.empty(); ++t)
+        {
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            const XMFLOAT3 start(setup.WindowMin.x + unit(rng) * dims[0] * setup.VoxelSize, setup.WindowMin.y + unit(rng) * dims[1] * setup.VoxelSize,
+                setup.WindowMin.z + unit(rng) * dims[2] * setup.VoxelSize);
+            const XMFLOAT3 direction = RandomDirection(rng);
+            const float jitter = 1.0f + unit(rng);
+            traces++;
+            if (!SameTrace(map.Trace(setup, start, direction, jitter), LampBrickMap::TraceDense(mips0, dims, setup, start, direction, jitter)))
+                error = L"brick map trace differs from the dense volume";
+        }
+    }
+
+    // A wall across the ray: it stops on the wall's color.
+    if (error.empty())
+    {
+        const UINT dims[3] = { 64, 32, 32 };
+        std::vector<UINT> dense((size_t)64 * 32 * 32, 0);
+        const UINT wall = LampVoxelizer::PackUnorm(0.6f, 0.4f, 0.2f, 1.0f);
+        for (UINT z = 0; z < 32; ++z)
+            for (UINT y = 0; y < 32; ++y)
+                dense[((size_t)z * 32 + y) * 64 + 20] = wall;
+        LampBrickMap map(dims, 4);
+        map.Build(dense);
+        VoxelTraceSetup setup;
+        setup.VoxelSize = 1.0f;
+        const VoxelTraceResult trace = map.Trace(setup, XMFLOAT3(4.5f, 16.5f, 16.5f), XMFLOAT3(1.0f, 0.0f, 0.0f), 1.0f);
+        if (!trace.Hit || std::fabs(trace.Color.x - 0.6f) > 0.01f || std::fabs(trace.Color.y - 0.4f) > 0.01f || std::fabs(trace.Color.z - 0.2f) > 0.01f)
+            error = L"trace does not stop on a wall in its way";
+        const VoxelTraceResult away = map.Trace(setup, XMFLOAT3(4.5f, 16.5f, 16.5f), XMFLOAT3(-1.0f, 0.0f, 0.0f), 1.0f);
+        if (error.empty() && (away.Hit || away.Color.x != setup.Miss))
+            error = L"trace away from the wall does not leave the window";
+    }
+
+    // Built from voxels, as the color volume WriteVolumes() writes.
+    for (UINT it = 0; it < iterations / 10 + 1 && error.empty(); ++it)
+    {
+        const UINT dims[3] = { 16, 8, 24 };
+        const int windowMin[3] = { (int)(rng() % 16) - 8, (int)(rng() % 8) - 4, (int)(rng() % 16) - 8 };
+        std::vector<BakedVoxel> voxels;
+        for (UINT v = 0; v < 200; ++v)
+        {
+            BakedVoxel voxel;
+            voxel.Key = LampVoxelizer::Key((int)(rng() % 40) - 20, (int)(rng() % 20) - 10, (int)(rng() % 40) - 20);
+            voxel.Albedo = rng();
+            voxel.Normal = rng();
+            voxel.Mat = rng();
+            voxels.push_back(voxel);
+        }
+        std::sort(voxels.begin(), voxels.end(), [](const BakedVoxel& a, const BakedVoxel& b) { return a.Key < b.Key; });
+        voxels.erase(std::unique(voxels.begin(), voxels.end(), [](const BakedVoxel& a, const BakedVoxel& b) { return a.Key == b.Key; }), voxels.end());
+        const XMFLOAT3 light(0.2f, -1.0f, 0.4f);
+        std::vector<UINT> color;
+        std::vector<UINT> normal;
+        std::vector<UINT> mat;
+        LampVoxelizer::WriteVolumes(voxels, windowMin, dims, light, color, normal, mat);
+        LampBrickMap map(dims, 3);
+        map.Build(voxels, windowMin, light);
+        compare(map, color, dims, L"voxels");
+    }
+
+    if (!error.empty())
+        return L"Brick map FAILED: " + error + L"\n";
+    return L"Brick map: " + std::to_wstring(iterations) + L" volumes, " + std::to_wstring(bricks) + L" bricks, "
+        + std::to_wstring(samples) + L" samples, " + std::to_wstring(traces) + L" traces, ok\n";
+}
+
+LAMP_TEST(BrickMap, Volumes)
+{
+    return Volumes(50, 1);
+}
+
+LAMP_BENCHMARK(BrickMap, Room)
+{
+    return Room(100000);
+}
@@ -0,0 +1,116 @@
+#include "LampTest.h"
+#include "main/ConstantBlocks.h"
+#include <cstring>
+#include <random>
+
+// Random blocks and edits against a model of every copy: each copy ends equal
+// to its data, and exactly the changed blocks are written.
+static std::wstring Buffers(std::uint32_t iterations, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint64_t written = 0;
+    std::uint64_t full = 0;
+    const std::uint32_t guard = 16;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        // Blocks of whole floats, like the layouts they stand for.
+        std::vector<ConstantBlock> blocks;
+        std::uint32_t size = 0;
+        const std::uint32_t numBlocks = 1 + rng() % 6;
+        for (std::uint32_t b = 0; b < numBlocks; ++b)
+        {
+            std::uint32_t blockSize = 4 * (1 + rng() % 40);
+            blocks.push_back({ L"block" + std::to_wstring(b), size, blockSize });
+            size += blockSize;
+        }
+        LampConstantBlocks constants(L"Test", size, blocks);
+
+        const std::uint32_t copies = 1 + rng() % 6;
+        std::vector<std::vector<std::uint8_t>> data(copies, std::vector<std::uint8_t>(size, 0));
+        // The mapped memory of each copy, with guard bytes behind it.
+        std::vector<std::vector<std::uint8_t>> memory(copies, std::vector<std::uint8_t>(size + guard, 0xcd));
+        // What each copy held after its last write; empty before the first.
+        std::vector<std::vector<std::uint8_t>> model(copies);
+
+        const std::uint32_t steps = 1 + rng() % 100;
+        for (std::uint32_t step = 0; step < steps && error.empty(); ++step)
+        {
+            const std::uint32_t copy = rng() % copies;
+            const std::uint32_t op = rng() % 10;
+            if (op == 0)
+            {
+                constants.Invalidate(copy);
+                model[copy].clear();
+                continue;
+            }
+            if (op == 1)
+            {
+                constants.BeginFrame();
+                continue;
+            }
+
+            // Edit a few floats, sometimes rewriting one with the value it already has.
+            const std::uint32_t edits = rng() % 4;
+            for (std::uint32_t e = 0; e < edits; ++e)
+            {
+                std::uint32_t at = 4 * (rng() % (size / 4));
+                float value = (float)(rng() % 3);
+                std::memcpy(&data[copy][at], &value, sizeof(value));
+            }
+
+            // Blocks the copy already holds must not be written: poison them, check, then restore.
+            std::vector<bool> unchanged(blocks.size(), false);
+            std::uint32_t expected = 0;
+            for (std::size_t b = 0; b < blocks.size(); ++b)
+            {
+                const ConstantBlock& block = blocks[b];
+                unchanged[b] = !model[copy].empty()
+                    && std::memcmp(&model[copy][block.Offset], &data[copy][block.Offset], block.Size) == 0;
+                if (unchanged[b])
+                    std::memset(&memory[copy][block.Offset], 0xab, block.Size);
+                else
+                    expected += block.Size;
+            }
+
+            std::uint32_t bytes = constants.Write(copy, data[copy].data(), memory[copy].data());
+            written += bytes;
+            full += size;
+            model[copy] = data[copy];
+
+            for (std::size_t b = 0; b < blocks.size(); ++b)
+            {
+                const ConstantBlock& block = blocks[b];
+                if (!unchanged[b])
+                    continue;
+                for (std::uint32_t i = 0; i < block.Size; ++i)
+                {
+                    if (memory[copy][block.Offset + i] != 0xab)
+                        error = L"unchanged block rewritten";
+                }
+                std::memcpy(&memory[copy][block.Offset], &data[copy][block.Offset], block.Size);
+            }
+
+            if (error.empty() && bytes != expected)
+                error = L"wrote " + std::to_wstring(bytes) + L" bytes, expected " + std::to_wstring(expected);
+            if (error.empty() && std::memcmp(memory[copy].data(), data[copy].data(), size) != 0)
+                error = L"copy does not match its data";
+            for (std::uint32_t g = 0; g < guard && error.empty(); ++g)
+            {
+                if (memory[copy][size + g] != 0xcd)
+                    error = L"wrote past the end of the buffer";
+            }
+        }
+    }
+
+    if (!error.empty())
+        return L"Constant blocks FAILED: " + error + L"\n";
+    return L"Constant blocks: " + std::to_wstring(iterations) + L" buffers, "
+        + std::to_wstring(written) + L"/" + std::to_wstring(full) + L" bytes written, ok\n";
+}
+
+LAMP_TEST(ConstantBlocks, Buffers)
+{
+    return Buffers(1000, 1);
+}
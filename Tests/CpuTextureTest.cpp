@@ -0,0 +1,114 @@
+#include "LampTest.h"
+#include "main/CpuTexture.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // A DDS file of a width x height texture with the given pixel format words and data.
+    std::vector<std::uint8_t> MakeDDS(std::uint32_t width, std::uint32_t height, std::uint32_t pfFlags, std::uint32_t fourCC,
+        std::uint32_t bitCount, const std::uint32_t masks[4], const std::vector<std::uint8_t>& payload)
+    {
+        std::vector<std::uint8_t> file(128, 0);
+        auto put = [&](size_t offset, std::uint32_t value) { memcpy(&file[offset], &value, sizeof(value)); };
+        put(0, 0x20534444);
+        put(4, 124);
+        put(12, height);
+        put(16, width);
+        put(76, 32);
+        put(80, pfFlags);
+        put(84, fourCC);
+        put(88, bitCount);
+        for (int i = 0; i < 4; ++i)
+            put(92 + 4 * i, masks[i]);
+        file.insert(file.end(), payload.begin(), payload.end());
+        return file;
+    }
+}
+
+// BC1 four and three color blocks, BC3 alpha, masked 32-bit and DX10 headers.
+static std::wstring Decoding()
+{
+    std::wstring error;
+
+    // Red and blue endpoints, texel i using index i % 4.
+    const std::uint8_t red[2] = { 0x00, 0xf8 };
+    const std::uint8_t blue[2] = { 0x1f, 0x00 };
+    std::vector<std::uint8_t> bc1 = { red[0], red[1], blue[0], blue[1], 0xe4, 0xe4, 0xe4, 0xe4 };
+    const std::uint32_t noMasks[4] = { 0, 0, 0, 0 };
+    auto texture = LampCpuTexture::FromDDS(MakeDDS(4, 4, 0x4, 0x31545844, 0, noMasks, bc1).data(), 128 + bc1.size());
+    const std::uint32_t expected[4] = { 0xff0000ff, 0xffff0000, 0xff5500aa, 0xffaa0055 };
+    if (texture == nullptr || texture->Width() != 4)
+        error = L"BC1 texture does not load";
+    for (std::uint32_t i = 0; i < 16 && error.empty(); ++i)
+    {
+        if (texture->Texels()[i] != expected[i % 4])
+            error = L"BC1 block decodes wrong";
+    }
+
+    // c0 <= c1: the third color is the midpoint and the fourth transparent black.
+    const std::uint8_t three[8] = { blue[0], blue[1], red[0], red[1], 0xe4, 0xe4, 0xe4, 0xe4 };
+    std::uint32_t block[16];
+    LampCpuTexture::DecodeBC1(three, block);
+    if (error.empty() && (block[2] != 0xff7f007f || block[3] != 0))
+        error = L"three color BC1 block decodes wrong";
+
+    // Alpha 255 and 0 with six steps between; 0x88... gives texels indices 0, 1, 2.
+    std::uint8_t bc3[16] = { 255, 0, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88 };
+    memcpy(bc3 + 8, bc1.data(), 8);
+    LampCpuTexture::DecodeBC3(bc3, block);
+    if (error.empty() && ((block[0] >> 24) != 255 || (block[1] >> 24) != 0 || (block[2] >> 24) != 218 || (block[0] & 0xffffff) != 0x0000ff))
+        error = L"BC3 block decodes wrong";
+
+    const std::uint32_t bgra[4] = { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
+    std::vector<std::uint8_t> pixel = { 0x30, 0x20, 0x10, 0x40 };
+    texture = LampCpuTexture::FromDDS(MakeDDS(1, 1, 0x41, 0, 32, bgra, pixel).data(), 128 + pixel.size());
+    if (error.empty() && (texture == nullptr || texture->Texels()[0] != 0x40302010))
+        error = L"32-bit texture decodes wrong";
+    texture = LampCpuTexture::FromDDS(MakeDDS(4, 4, 0x4, 0x31545844, 0, noMasks, bc1).data(), 128 + bc1.size() - 1);
+    if (error.empty() && texture != nullptr)
+        error = L"truncated texture loads";
+
+    // DX10 headers: B8G8R8A8_UNORM_SRGB swizzles, a texture array is refused.
+    std::vector<std::uint8_t> dx10(20, 0);
+    const std::uint32_t header[4] = { 91, 3, 0, 1 };
+    memcpy(dx10.data(), header, sizeof(header));
+    dx10.insert(dx10.end(), pixel.begin(), pixel.end());
+    texture = LampCpuTexture::FromDDS(MakeDDS(1, 1, 0x4, 0x30315844, 0, noMasks, dx10).data(), 128 + dx10.size());
+    if (error.empty() && (texture == nullptr || texture->Texels()[0] != 0x40302010))
+        error = L"DX10 texture decodes wrong";
+    dx10[12] = 2;
+    texture = LampCpuTexture::FromDDS(MakeDDS(1, 1, 0x4, 0x30315844, 0, noMasks, dx10).data(), 128 + dx10.size());
+    if (error.empty() && texture != nullptr)
+        error = L"texture array loads";
+
+    if (!error.empty())
+        return L"CPU texture FAILED: " + error + L"\n";
+    return L"CPU texture decoding: ok\n";
+}
+
+// Bilinear filtering with wrap: texel centers return the texel, edges blend across the wrap.
+static std::wstring Sampling()
+{
+    // Red 0 and 255 side by side.
+    LampCpuTexture texture(2, 1, { 0xff000000, 0xff0000ff });
+    const float cases[][2] = { { 0.25f, 0.0f }, { 0.75f, 1.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f }, { 1.25f, 0.0f }, { -0.25f, 1.0f }, { 0.375f, 0.25f } };
+    for (auto& c : cases)
+    {
+        float rgba[4];
+        texture.Sample(c[0], 0.5f, rgba);
+        if (std::fabs(rgba[0] - c[1]) > 1e-5f || rgba[1] != 0.0f || std::fabs(rgba[3] - 1.0f) > 1e-5f)
+            return L"CPU texture FAILED: sample at u = " + std::to_wstring(c[0]) + L" gives " + std::to_wstring(rgba[0]) + L"\n";
+    }
+    return L"CPU texture sampling: ok\n";
+}
+
+LAMP_TEST(CpuTexture, Decoding)
+{
+    return Decoding();
+}
+
+LAMP_TEST(CpuTexture, Sampling)
+{
+    return Sampling();
+}
@@ -0,0 +1,190 @@
+#include "LampTest.h"
+#include "main/DescriptorAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Stands in for D3D12_GPU_DESCRIPTOR_HANDLE.
+struct GpuHandle
+{
+    std::uint64_t ptr;
+};
+
+// Random allocations, frees and per-frame tables checked against a model of the heap.
+static std::wstring Heaps(std::uint32_t iterations, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t slots = 0;
+    std::uint32_t tables = 0;
+    std::uint32_t failures = 0;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        const std::uint32_t initial = 1 + rng() % 8;
+        const std::uint32_t ring = 8 + rng() % 64;
+        LampDescriptorAllocator alloc(initial, ring);
+
+        std::set<std::uint32_t> live;
+        std::vector<std::uint32_t> freed;
+        std::uint32_t highest = 0;
+
+        struct Table
+        {
+            std::uint64_t Frame;
+            std::uint32_t Start;
+            std::uint32_t Count;
+        };
+        std::vector<Table> inFlight;
+        std::uint64_t frame = 0;
+        std::uint64_t completed = 0;
+
+        const std::uint32_t steps = 1 + rng() % 200;
+        for (std::uint32_t step = 0; step < steps && error.empty(); ++step)
+        {
+            const std::uint32_t op = rng() % 10;
+            if (op < 4)
+            {
+                std::uint32_t slot = alloc.Allocate();
+                slots++;
+                if (live.count(slot) != 0)
+                    error = L"slot handed out twice";
+                else if (!freed.empty() && slot != freed.back())
+                    error = L"freed slot not reused first";
+                else if (freed.empty() && slot != highest)
+                    error = L"new slots not handed out in order";
+                else if (slot >= alloc.Capacity())
+                    error = L"slot beyond capacity";
+
+                if (!freed.empty())
+                    freed.pop_back();
+                else
+                    highest++;
+                live.insert(slot);
+            }
+            else if (op < 6 && !live.empty())
+            {
+                auto victim = live.begin();
+                std::advance(victim, rng() % live.size());
+                alloc.Free(*victim);
+                // A second free of the same slot is ignored.
+                if (rng() % 4 == 0)
+                    alloc.Free(*victim);
+                freed.push_back(*victim);
+                live.erase(victim);
+            }
+            else if (op < 8)
+            {
+                std::uint32_t count = 1 + rng() % 8;
+                std::uint32_t slot = alloc.AllocateTable(count);
+                std::uint32_t held = 0;
+                for (auto& t : inFlight)
+                    held += t.Count;
+
+                if (slot == LampDescriptorAllocator::InvalidSlot)
+                {
+                    failures++;
+                    // Only the slots skipped at the end of the ring, fewer than a table, are lost.
+                    if (count <= ring && held + 2 * count + 8 <= ring)
+                        error = L"table refused with room in the ring";
+                    continue;
+                }
+                tables++;
+                if (slot < alloc.Capacity() || slot + count > alloc.Capacity() + ring)
+                {
+                    error = L"table outside the ring";
+                    break;
+                }
+                std::uint32_t start = slot - alloc.Capacity();
+                for (auto& t : inFlight)
+                {
+                    if (start < t.Start + t.Count && t.Start < start + count)
+                        error = L"table overlaps one still in flight";
+                }
+                inFlight.push_back({ frame, start, count });
+            }
+            else
+            {
+                // Up to three frames in flight.
+                frame++;
+                completed = std::max<std::uint64_t>(completed, frame > 3 ? frame - 1 - rng() % 3 : 0);
+                completed = std::min<std::uint64_t>(completed, frame - 1);
+                alloc.BeginFrame(frame, completed);
+                inFlight.erase(std::remove_if(inFlight.begin(), inFlight.end(),
+                    [&](const Table& t) { return t.Frame <= completed; }), inFlight.end());
+            }
+
+            if (error.empty() && alloc.Stats().Used != (std::uint32_t)live.size())
+                error = L"used count does not match the live slots";
+        }
+        if (error.empty() && (alloc.Capacity() % initial != 0 || alloc.Capacity() < highest))
+            error = L"capacity did not grow by doubling";
+    }
+
+    if (!error.empty())
+        return L"Descriptor allocator FAILED: " + error + L"\n";
+    return L"Descriptor allocator: " + std::to_wstring(iterations) + L" heaps, "
+        + std::to_wstring(slots) + L" slots, " + std::to_wstring(tables) + L" tables, "
+        + std::to_wstring(failures) + L" refused when full, ok\n";
+}
+
+// Name lookups in the string-keyed maps this replaces against handle resolves.
+static std::wstring Lookups(std::uint32_t names, std::uint32_t lookups)
+{
+    const std::uint32_t increment = 32;
+    const GpuHandle start = { 0x10000 };
+
+    // What DescriptorHeap kept before: a map per view type, looked up with a
+    // std::wstring copied from the pass's name on every call.
+    std::vector<std::wstring> keys;
+    std::unordered_map<std::wstring, GpuHandle> byName;
+    std::vector<std::uint32_t> slotOf;
+    std::vector<SrvHandle> handles;
+    for (std::uint32_t i = 0; i < names; ++i)
+    {
+        keys.push_back(L"ScreenProbeResource" + std::to_wstring(i));
+        byName[keys.back()] = { start.ptr + (std::uint64_t)i * increment };
+        slotOf.push_back(i);
+        SrvHandle h;
+        h.Index = i;
+        handles.push_back(h);
+    }
+
+    std::vector<std::uint32_t> order(lookups);
+    std::mt19937 rng(1);
+    for (auto& o : order)
+        o = rng() % names;
+
+    auto lookup = [&](const std::wstring name) { return byName.at(name); };
+    std::uint64_t sum = 0;
+    auto t0 = Clock::now();
+    for (std::uint32_t i = 0; i < lookups; ++i)
+        sum += lookup(keys[order[i]]).ptr;
+    auto t1 = Clock::now();
+    for (std::uint32_t i = 0; i < lookups; ++i)
+        sum -= start.ptr + (std::uint64_t)slotOf[handles[order[i]].Index] * increment;
+    auto t2 = Clock::now();
+
+    double stringNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / std::max<std::uint32_t>(1u, lookups);
+    double handleNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / std::max<std::uint32_t>(1u, lookups);
+    return L"Descriptor lookup benchmark: " + std::to_wstring(names) + L" names, "
+        + std::to_wstring(lookups) + L" lookups, ns per lookup\n"
+        + L"  by name: " + std::to_wstring(stringNs) + L"\n"
+        + L"  by handle: " + std::to_wstring(handleNs)
+        + (sum == 0 ? L"\n" : L" (MISMATCH)\n");
+}
+
+LAMP_TEST(DescriptorAllocator, Heaps)
+{
+    return Heaps(1000, 1);
+}
+
+LAMP_BENCHMARK(DescriptorAllocator, Lookups)
+{
+    return Lookups(96, 1000000);
+}
@@ -0,0 +1,144 @@
+#include "LampTest.h"
+#include "main/DrawList.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// Times the sort and bind elimination on a synthetic scene.
+static std::wstring SortBenchmark(UINT numItems, UINT numMeshes, UINT numMaterials)
+{
+    std::mt19937 rng(1234);
+
+    std::vector<std::unique_ptr<Mesh>> meshes(numMeshes);
+    for (UINT i = 0; i < numMeshes; ++i)
+    {
+        meshes[i] = std::make_unique<Mesh>();
+        meshes[i]->ID = i;
+    }
+
+    std::vector<std::unique_ptr<Material>> materials(numMaterials);
+    for (UINT i = 0; i < numMaterials; ++i)
+    {
+        materials[i] = std::make_unique<Material>();
+        materials[i]->MatCBIndex = i;
+    }
+
+    std::vector<std::unique_ptr<RenderItem>> items(numItems);
+    std::vector<float> depths(numItems);
+    std::uniform_real_distribution<float> depthDist(1.0f, 1000.0f);
+    for (UINT i = 0; i < numItems; ++i)
+    {
+        items[i] = std::make_unique<RenderItem>();
+        items[i]->Geo = meshes[rng() % numMeshes].get();
+        items[i]->Mat = materials[rng() % numMaterials].get();
+        depths[i] = depthDist(rng);
+    }
+
+    LampDrawList list;
+    list.Begin();
+    for (UINT i = 0; i < numItems; ++i)
+        list.Add(0, 0, items[i].get(), depths[i]);
+    std::vector<UINT64> reference = list.Keys();
+    list.Sort();
+    list.BeginFrame();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::sort(reference.begin(), reference.end());
+    auto end = std::chrono::high_resolution_clock::now();
+    double stdSortMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    bool sorted = reference == list.Keys();
+
+    const DrawListStats& stats = list.Stats();
+    return L"DrawList benchmark: " + std::to_wstring(numItems) + L" items, "
+        + std::to_wstring(numMeshes) + L" meshes, " + std::to_wstring(numMaterials) + L" materials\n"
+        + L"  radix sort + binds: " + std::to_wstring(stats.SortMs) + L" ms, std::sort: " + std::to_wstring(stdSortMs) + L" ms\n"
+        + L"  binds issued " + std::to_wstring(stats.BindsIssued) + L", saved " + std::to_wstring(stats.BindsSaved)
+        + (sorted ? L"\n" : L", FAILED: order differs from std::sort\n");
+}
+
+// Field order, front to back depth, pipeline binds and per-frame stats.
+static std::wstring Keys()
+{
+    Mesh meshes[2];
+    meshes[0].ID = 0;
+    meshes[1].ID = 1;
+    Material material;
+    material.MatCBIndex = 0;
+    RenderItem items[4];
+    for (UINT i = 0; i < 4; ++i)
+    {
+        items[i].Geo = &meshes[i / 2];
+        items[i].Mat = &material;
+    }
+
+    std::wstring error;
+    if (!(LampDrawList::MakeKey(1, 0, 0, 0, 0.0f) > LampDrawList::MakeKey(0, LampDrawList::MaxPso, LampDrawList::MaxMesh, LampDrawList::MaxMaterial, 1e30f)
+        && LampDrawList::MakeKey(0, 1, 0, 0, 0.0f) > LampDrawList::MakeKey(0, 0, LampDrawList::MaxMesh, LampDrawList::MaxMaterial, 1e30f)
+        && LampDrawList::MakeKey(0, 0, 1, 0, 0.0f) > LampDrawList::MakeKey(0, 0, 0, LampDrawList::MaxMaterial, 1e30f)
+        && LampDrawList::MakeKey(0, 0, 0, 1, 0.0f) > LampDrawList::MakeKey(0, 0, 0, 0, 1e30f)
+        && LampDrawList::MakeKey(0, 0, 0, 0, 2.0f) > LampDrawList::MakeKey(0, 0, 0, 0, 1.0f)
+        && LampDrawList::MakeKey(0, 0, 0, 0, -1.0f) == LampDrawList::MakeKey(0, 0, 0, 0, 0.0f)))
+        error = L"key fields are out of order";
+    if (error.empty() && !(LampDrawList::MakeKey(0, 0, LampDrawList::MaxMesh + 1, 0, 0.0f) < LampDrawList::MakeKey(0, 1, 0, 0, 0.0f)
+        && LampDrawList::MakeKey(0, 0, 0, LampDrawList::MaxMaterial + 1, 0.0f) < LampDrawList::MakeKey(0, 0, 1, 0, 0.0f)
+        && LampDrawList::MakeKey(0, LampDrawList::MaxPso + 1, 0, 0, 0.0f) < LampDrawList::MakeKey(1, 0, 0, 0, 0.0f)))
+        error = L"an id past its field spills into the fields above";
+
+    // Two pipelines, the far draw of each pipeline added first.
+    LampDrawList list;
+    list.Begin();
+    list.Add(0, 3, &items[0], 10.0f);
+    list.Add(0, 3, &items[1], 1.0f);
+    list.Add(0, 2, &items[2], 10.0f);
+    list.Add(0, 2, &items[3], 1.0f);
+    list.Sort();
+    const std::vector<DrawCommand>& commands = list.Commands();
+    const RenderItem* order[4] = { &items[3], &items[2], &items[1], &items[0] };
+    for (UINT i = 0; i < 4 && error.empty(); ++i)
+    {
+        if (commands[i].Item != order[i] || commands[i].Pso != (i < 2 ? 2u : 3u))
+            error = L"draws are not sorted by pipeline, then front to back";
+        else if (((commands[i].Flags & DrawBindPipeline) != 0) != (i % 2 == 0))
+            error = L"pipeline binds on draw " + std::to_wstring(i);
+    }
+
+    // Stats sum over both sorts and only show after BeginFrame().
+    list.Sort();
+    if (error.empty() && list.Stats().Draws != 0)
+        error = L"stats show before the frame ends";
+    list.BeginFrame();
+    if (error.empty() && (list.Stats().Draws != 8 || list.Stats().PipelineBinds != 4))
+        error = L"stats are not summed over the frame";
+    list.BeginFrame();
+    if (error.empty() && list.Stats().Draws != 0)
+        error = L"stats carry over to the next frame";
+
+    // A mesh id past its field is counted, and its draw still binds its own pipeline.
+    Mesh big;
+    big.ID = LampDrawList::MaxMesh + 1;
+    items[0].Geo = &big;
+    list.Begin();
+    list.Add(0, 2, &items[1], 1.0f);
+    list.Add(0, 1, &items[0], 1.0f);
+    list.Sort();
+    list.BeginFrame();
+    if (error.empty() && (list.Commands()[0].Item != &items[0] || list.Commands()[0].Pso != 1 || list.Commands()[1].Pso != 2))
+        error = L"a draw with an overflowing mesh id binds the wrong pipeline";
+    if (error.empty() && list.Stats().KeyOverflows != 1)
+        error = L"key overflows are not counted";
+
+    if (!error.empty())
+        return L"DrawList FAILED: " + error + L"\n";
+    return L"DrawList keys: ok\n";
+}
+
+LAMP_TEST(DrawList, Keys)
+{
+    return Keys();
+}
+
+LAMP_BENCHMARK(DrawList, Sort)
+{
+    return SortBenchmark(100000, 512, 1024);
+}
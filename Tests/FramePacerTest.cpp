@@ -0,0 +1,202 @@
+#include "LampTest.h"
+#include "main/FramePacer.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // A GPU that runs submitted frames back to back, on a clock that only moves when told to.
+    class ModelTimeline : public LampFrameTimeline
+    {
+    public:
+        struct Signal
+        {
+            std::uint64_t Fence;
+            double FinishMs;
+        };
+
+        // gap > 1 stands for fences signalled outside the frame, as FlushCommandQueue() does.
+        std::uint64_t Submit(double gpuMs, std::uint64_t gap)
+        {
+            mLastFence += gap;
+            mGpuFreeMs = std::max<double>(mGpuFreeMs, Now) + gpuMs;
+            Signals.push_back({ mLastFence, mGpuFreeMs });
+            return mLastFence;
+        }
+        // 0 for fence 0, which every frame resource starts with.
+        double FinishMs(std::uint64_t fence)const
+        {
+            if (fence == 0)
+                return 0.0;
+            for (auto& s : Signals)
+            {
+                if (s.Fence >= fence)
+                    return s.FinishMs;
+            }
+            return 0.0;
+        }
+        std::uint32_t Queued()const
+        {
+            std::uint32_t queued = 0;
+            for (auto& s : Signals)
+                queued += s.FinishMs > Now ? 1 : 0;
+            return queued;
+        }
+        double GpuFreeMs()const { return mGpuFreeMs; }
+
+        virtual std::uint64_t CompletedFence()override
+        {
+            std::uint64_t completed = 0;
+            for (auto& s : Signals)
+            {
+                if (s.FinishMs > Now)
+                    break;
+                completed = s.Fence;
+            }
+            return completed;
+        }
+        virtual void WaitForFence(std::uint64_t fence)override
+        {
+            if (fence > mLastFence)
+                WaitedUnsubmitted = true;
+            Now = std::max<double>(Now, FinishMs(fence));
+        }
+        virtual double NowMs()override { return Now; }
+
+        double Now = 0.0;
+        std::vector<Signal> Signals;
+        bool WaitedUnsubmitted = false;
+
+    private:
+        std::uint64_t mLastFence = 0;
+        double mGpuFreeMs = 0.0;
+    };
+}
+
+// A modelled GPU with random frame times, fence gaps and frames-in-flight changes:
+// never more frames queued than allowed, no frame resource reused before its fence,
+// no wait when none is needed, a latency for every frame.
+static std::wstring Frames(std::uint32_t iterations, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t frames = 0;
+    std::uint32_t waits = 0;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        LampFramePacer pacer(1 + rng() % LampFramePacer::MaxFramesInFlight);
+        ModelTimeline gpu;
+        std::array<std::uint64_t, LampFramePacer::MaxFramesInFlight> slotFences = {};
+        std::vector<double> beginMs;
+        std::vector<double> finishMs;
+        std::uint32_t slot = 0;
+
+        const std::uint32_t steps = 1 + rng() % 100;
+        for (std::uint32_t step = 0; step < steps && error.empty(); ++step)
+        {
+            if (rng() % 8 == 0)
+                pacer.SetFramesInFlight(rng() % (LampFramePacer::MaxFramesInFlight + 2));
+            const std::uint32_t count = pacer.FramesInFlight();
+
+            // What the pacer has to wait for, worked out from the model.
+            std::uint32_t expectedSlot = (slot + 1) % count;
+            double readyMs = gpu.FinishMs(slotFences[expectedSlot]);
+            if (gpu.Signals.size() >= count)
+                readyMs = std::max<double>(readyMs, gpu.Signals[gpu.Signals.size() - count].FinishMs);
+            const double startMs = gpu.Now;
+
+            slot = pacer.BeginFrame(gpu);
+            const FramePacing& pacing = pacer.History().back();
+            frames++;
+            waits += pacing.CpuWaitMs > 0.0f ? 1 : 0;
+
+            if (slot != expectedSlot || slot >= count)
+                error = L"frame resources not used in turn";
+            else if (gpu.FinishMs(slotFences[slot]) > gpu.Now)
+                error = L"frame resource handed out before its fence";
+            else if (gpu.Queued() > count - 1)
+                error = L"more frames queued than allowed";
+            else if (gpu.Now > std::max<double>(startMs, readyMs))
+                error = L"waited longer than needed";
+            else if (readyMs <= startMs && pacing.CpuWaitMs != 0.0f)
+                error = L"waited when nothing was queued";
+            else if (gpu.WaitedUnsubmitted)
+                error = L"waited on a fence never signalled";
+
+            beginMs.push_back(gpu.Now);
+            gpu.Now += (double)(rng() % 20) / 2.0;
+            std::uint64_t fence = gpu.Submit((double)(rng() % 20) / 2.0, 1 + rng() % 2);
+            finishMs.push_back(gpu.FinishMs(fence));
+            slotFences[slot] = fence;
+            pacer.EndFrame(fence);
+        }
+
+        // Once the GPU is idle the next frame sees every earlier one complete.
+        gpu.Now = gpu.GpuFreeMs();
+        pacer.BeginFrame(gpu);
+        auto& history = pacer.History();
+        for (size_t f = 0; f + 1 < history.size() && error.empty(); ++f)
+        {
+            if (history[f].LatencyMs < 0.0f)
+                error = L"frame without a latency";
+            else if (history[f].LatencyMs + 1e-3f < (float)(finishMs[f] - beginMs[f]))
+                error = L"latency shorter than the frame took";
+        }
+    }
+
+    if (!error.empty())
+        return L"Frame pacer FAILED: " + error + L"\n";
+    return L"Frame pacer: " + std::to_wstring(iterations) + L" runs, "
+        + std::to_wstring(frames) + L" frames, " + std::to_wstring(waits) + L" waited, ok\n";
+}
+
+// CPU- and GPU-bound frames on the model at each frames-in-flight setting.
+static std::wstring Pacing(float cpuMs, float gpuMs, std::uint32_t frames)
+{
+    std::wstring report = L"Frame pacing on a model, CPU " + std::to_wstring(cpuMs) + L" ms, GPU "
+        + std::to_wstring(gpuMs) + L" ms per frame\n";
+    for (std::uint32_t count = 1; count <= LampFramePacer::MaxFramesInFlight; ++count)
+    {
+        LampFramePacer pacer(count);
+        ModelTimeline gpu;
+        for (std::uint32_t f = 0; f < frames; ++f)
+        {
+            pacer.BeginFrame(gpu);
+            gpu.Now += cpuMs;
+            pacer.EndFrame(gpu.Submit(gpuMs, 1));
+        }
+        gpu.Now = gpu.GpuFreeMs();
+        pacer.BeginFrame(gpu);
+
+        // Steady state only: the first frames fill the queue.
+        float waitMs = 0.0f;
+        float ahead = 0.0f;
+        float latencyMs = 0.0f;
+        std::uint32_t measured = 0;
+        auto& history = pacer.History();
+        for (size_t f = std::min<size_t>(history.size() - 1, LampFramePacer::MaxFramesInFlight); f + 1 < history.size(); ++f)
+        {
+            waitMs += history[f].CpuWaitMs;
+            ahead += (float)history[f].GpuAhead;
+            latencyMs += history[f].LatencyMs;
+            measured++;
+        }
+        measured = std::max<std::uint32_t>(measured, 1u);
+        report += L"  " + std::to_wstring(count) + L" in flight: " + std::to_wstring(gpu.GpuFreeMs() / frames)
+            + L" ms per frame, CPU wait " + std::to_wstring(waitMs / measured) + L" ms, GPU ahead "
+            + std::to_wstring(ahead / measured) + L", latency " + std::to_wstring(latencyMs / measured) + L" ms\n";
+    }
+    return report;
+}
+
+LAMP_TEST(FramePacer, Frames)
+{
+    return Frames(1000, 1);
+}
+
+LAMP_BENCHMARK(FramePacer, Pacing)
+{
+    return Pacing(4.0f, 8.0f, 200) + Pacing(8.0f, 4.0f, 200);
+}
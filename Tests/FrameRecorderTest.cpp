@@ -0,0 +1,200 @@
+#include "LampTest.h"
+#include "main/FrameRecorder.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+namespace
+{
+    void Spin(float ms)
+    {
+        auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(ms));
+        while (Clock::now() < end)
+        {
+        }
+    }
+
+    // Logs what the frame recorder asks for, from any thread.
+    class LogRecorder : public LampCommandRecorder
+    {
+    public:
+        struct ListLog
+        {
+            std::uint32_t Opened = 0;
+            std::uint32_t Recorded = 0;
+            std::uint32_t Closed = 0;
+            bool Open = false;
+            bool SameThread = true;
+            std::thread::id Thread;
+        };
+
+        LogRecorder(std::uint32_t count) : Lists(count) {}
+
+        virtual void Open(std::uint32_t list)override
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ListLog& l = Lists[list];
+            l.Opened++;
+            l.Open = true;
+            l.Thread = std::this_thread::get_id();
+        }
+        void Record(std::uint32_t list)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ListLog& l = Lists[list];
+            l.Recorded += l.Open ? 1 : 100;
+            l.SameThread &= l.Thread == std::this_thread::get_id();
+        }
+        virtual void Close(std::uint32_t list)override
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ListLog& l = Lists[list];
+            l.Closed++;
+            l.Open = false;
+            l.SameThread &= l.Thread == std::this_thread::get_id();
+        }
+        virtual void Submit(const std::vector<std::uint32_t>& lists)override
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Submits++;
+            Submitted = lists;
+            for (auto& l : Lists)
+                ClosedBeforeSubmit &= l.Closed == 1;
+        }
+
+        std::mutex Mutex;
+        std::vector<ListLog> Lists;
+        std::uint32_t Submits = 0;
+        std::vector<std::uint32_t> Submitted;
+        bool ClosedBeforeSubmit = true;
+    };
+}
+
+// Random record times and pool sizes against a logging recorder:
+// one submission in order, every list opened, recorded and closed once on one thread.
+static std::wstring Frames(std::uint32_t iterations, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<std::unique_ptr<LampThreadPool>> pools;
+    for (std::uint32_t threads = 1; threads <= 4; ++threads)
+        pools.push_back(std::make_unique<LampThreadPool>(threads));
+
+    std::wstring error;
+    std::uint32_t lists = 0;
+    std::uint32_t steals = 0;
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        LampThreadPool& pool = *pools[rng() % pools.size()];
+
+        // The job system alone: every job once, thread indices in range, nested loops inline.
+        const std::uint32_t jobs = rng() % 16;
+        std::vector<std::atomic<std::uint32_t>> ran(jobs);
+        std::vector<std::atomic<std::uint32_t>> covered(jobs * 4);
+        std::atomic<bool> threadsInRange{ true };
+        steals += pool.RunJobs(jobs, [&](std::uint32_t job, std::uint32_t thread)
+        {
+            ran[job]++;
+            if (thread >= pool.NumThreads())
+                threadsInRange = false;
+            pool.ParallelFor(4, 1, [&](std::uint32_t begin, std::uint32_t end)
+            {
+                for (std::uint32_t i = begin; i < end; ++i)
+                    covered[job * 4 + i]++;
+            });
+        });
+        for (auto& r : ran)
+            error += r != 1 ? L"job did not run exactly once; " : L"";
+        for (auto& c : covered)
+            error += c != 1 ? L"nested loop did not cover its range once; " : L"";
+        if (!threadsInRange)
+            error += L"thread index out of range; ";
+        if (!error.empty())
+            break;
+
+        // The recorder on top of it.
+        const std::uint32_t count = rng() % 12;
+        LampFrameRecorder recorder(pool);
+        recorder.SetParallel(rng() % 4 != 0);
+        LogRecorder log(count);
+        std::vector<float> work(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            work[i] = (float)(rng() % 50) / 1000.0f;
+            recorder.Add(L"list" + std::to_wstring(i), [&log, &work, i](std::uint32_t) { Spin(work[i]); log.Record(i); });
+        }
+        recorder.Record(log);
+        lists += count;
+
+        std::vector<std::uint32_t> order(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+            order[i] = i;
+        if (log.Submits != 1 || log.Submitted != order)
+            error = L"lists not submitted once in order";
+        if (!log.ClosedBeforeSubmit)
+            error = L"list submitted before it was closed";
+        for (auto& l : log.Lists)
+        {
+            if (l.Opened != 1 || l.Recorded != 1 || l.Closed != 1)
+                error = L"list not opened, recorded and closed once";
+            if (!l.SameThread)
+                error = L"list recorded across threads";
+        }
+        if (recorder.LastFrame().size() != count)
+            error = L"stats do not cover every list";
+    }
+
+    if (!error.empty())
+        return L"Frame recorder FAILED: " + error + L"\n";
+    return L"Frame recorder: " + std::to_wstring(iterations) + L" frames, "
+        + std::to_wstring(lists) + L" lists, " + std::to_wstring(steals) + L" jobs stolen, ok\n";
+}
+
+// Serial against parallel recording of passes that each take passMs on the CPU.
+static std::wstring SerialAndParallel(std::uint32_t passes, float passMs)
+{
+    const std::uint32_t frames = 20;
+
+    class NullRecorder : public LampCommandRecorder
+    {
+    public:
+        virtual void Open(std::uint32_t)override {}
+        virtual void Close(std::uint32_t)override {}
+        virtual void Submit(const std::vector<std::uint32_t>&)override {}
+    };
+
+    auto run = [&](bool parallel)
+    {
+        LampFrameRecorder recorder;
+        recorder.SetParallel(parallel);
+        for (std::uint32_t i = 0; i < passes; ++i)
+            recorder.Add(L"pass" + std::to_wstring(i), [passMs](std::uint32_t) { Spin(passMs); });
+
+        NullRecorder null;
+        auto t0 = Clock::now();
+        for (std::uint32_t f = 0; f < frames; ++f)
+            recorder.Record(null);
+        return std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / frames;
+    };
+
+    double serialMs = run(false);
+    double parallelMs = run(true);
+
+    return L"Frame recording benchmark: " + std::to_wstring(passes) + L" passes of "
+        + std::to_wstring(passMs) + L" ms, ms per frame\n"
+        + L"  serial: " + std::to_wstring(serialMs) + L"\n"
+        + L"  " + std::to_wstring(LampThreadPool::Default().NumThreads()) + L" threads: "
+        + std::to_wstring(parallelMs) + L"\n";
+}
+
+LAMP_TEST(FrameRecorder, Frames)
+{
+    return Frames(1000, 1);
+}
+
+LAMP_BENCHMARK(FrameRecorder, SerialAndParallel)
+{
+    return SerialAndParallel(16, 0.25f);
+}
@@ -0,0 +1,91 @@
+#include "LampTest.h"
+#include "main/Instancing.h"
+#include <algorithm>
+#include <random>
+
+// Items over two meshes, two index ranges, two topologies and two materials, shuffled:
+// every batch holds one combination, its instance range is where the root SRV of
+// SceneRenderPass::DrawInstanceBatches points, and its instances keep ObjCBIndex order.
+static std::wstring Batches()
+{
+    std::vector<std::unique_ptr<Mesh>> meshes;
+    std::vector<std::unique_ptr<Material>> materials;
+    for (UINT i = 0; i < 2; ++i)
+    {
+        meshes.push_back(std::make_unique<Mesh>());
+        materials.push_back(std::make_unique<Material>());
+        materials.back()->MatCBIndex = i;
+    }
+
+    std::vector<std::unique_ptr<RenderItem>> items;
+    for (UINT i = 0; i < 64; ++i)
+    {
+        auto ri = std::make_unique<RenderItem>();
+        ri->ObjCBIndex = i;
+        ri->Geo = meshes[i % 2].get();
+        ri->Mat = materials[(i / 2) % 2].get();
+        ri->StartIndexLocation = (i / 4) % 2 == 0 ? 0 : 36;
+        ri->IndexCount = 36;
+        ri->PrimitiveType = (i / 8) % 2 == 0 ? D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST : D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+        // The item's index travels in the instance data, transposed into _14.
+        ri->World._41 = (float)i;
+        ri->Visible = i % 3 != 0;
+        items.push_back(std::move(ri));
+    }
+    std::vector<RenderItem*> ritems;
+    for (auto& ri : items)
+        ritems.push_back(ri.get());
+    std::shuffle(ritems.begin(), ritems.end(), std::mt19937(7));
+
+    LampInstancing instancing;
+    for (bool visibleOnly : { false, true })
+    {
+        instancing.Build(ritems, visibleOnly);
+        UINT expected = 0;
+        for (auto ri : ritems)
+            expected += !visibleOnly || ri->Visible ? 1 : 0;
+        const std::wstring mode = visibleOnly ? L" (visible only)" : L"";
+
+        if (instancing.ItemCount() != expected || instancing.Instances().size() != expected)
+            return L"Instancing FAILED: " + std::to_wstring(instancing.Instances().size()) + L" instances of "
+                + std::to_wstring(expected) + L" items" + mode + L"\n";
+        // 16 combinations, every one with items left after the visibility filter.
+        if (instancing.Batches().size() != 16)
+            return L"Instancing FAILED: " + std::to_wstring(instancing.Batches().size()) + L" batches instead of 16" + mode + L"\n";
+
+        UINT next = 0;
+        for (size_t b = 0; b < instancing.Batches().size(); ++b)
+        {
+            const InstanceBatch& batch = instancing.Batches()[b];
+            if (batch.FirstInstance != next || batch.InstanceCount == 0)
+                return L"Instancing FAILED: batch " + std::to_wstring(b) + L" does not start where the previous one ended" + mode + L"\n";
+            next += batch.InstanceCount;
+
+            int last = -1;
+            for (UINT i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; ++i)
+            {
+                const InstanceData& data = instancing.Instances()[i];
+                const RenderItem* ri = items[(UINT)data.World._14].get();
+                if (ri->Geo != batch.Geo || ri->Mat != batch.Mat || ri->StartIndexLocation != batch.StartIndexLocation
+                    || ri->IndexCount != batch.IndexCount || ri->BaseVertexLocation != batch.BaseVertexLocation
+                    || ri->PrimitiveType != batch.PrimitiveType)
+                    return L"Instancing FAILED: item " + std::to_wstring(ri->ObjCBIndex) + L" is drawn by another item's batch" + mode + L"\n";
+                if (visibleOnly && !ri->Visible)
+                    return L"Instancing FAILED: hidden item " + std::to_wstring(ri->ObjCBIndex) + L" is drawn\n";
+                if ((int)ri->ObjCBIndex <= last)
+                    return L"Instancing FAILED: batch " + std::to_wstring(b) + L" is out of ObjCBIndex order" + mode + L"\n";
+                last = (int)ri->ObjCBIndex;
+                if (data.MaterialIndex != (UINT)ri->Mat->MatCBIndex)
+                    return L"Instancing FAILED: item " + std::to_wstring(ri->ObjCBIndex) + L" has the wrong material index\n";
+            }
+        }
+        if (next != instancing.Instances().size())
+            return L"Instancing FAILED: the batches do not cover the instance buffer" + mode + L"\n";
+    }
+    return L"Instancing: 64 items in 16 batches, ranges, order and visibility ok\n";
+}
+
+LAMP_TEST(Instancing, Batches)
+{
+    return Batches();
+}
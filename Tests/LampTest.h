@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+// Tests and benchmarks run by LampTests, outside the app. A test passes when
+// its report does not contain "FAILED"; benchmarks only run with --bench.
+typedef std::wstring (*LampTestFunc)();
+
+struct LampTestRegistrar
+{
+    LampTestRegistrar(const char* name, LampTestFunc func, bool benchmark);
+};
+
+// Registered as "Suite.Name"; ctest runs each suite on its own.
+#define LAMP_TEST(suite, name) \
+    static std::wstring suite##_##name(); \
+    static LampTestRegistrar suite##_##name##Registrar(#suite "." #name, suite##_##name, false); \
+    static std::wstring suite##_##name()
+
+#define LAMP_BENCHMARK(suite, name) \
+    static std::wstring suite##_##name(); \
+    static LampTestRegistrar suite##_##name##Registrar(#suite "." #name, suite##_##name, true); \
+    static std::wstring suite##_##name()
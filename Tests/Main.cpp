@@ -0,0 +1,108 @@
+// Runs the tests and benchmarks of the engine's cores.
+//
+//   LampTests                   every test
+//   LampTests <name>...         tests whose name is <name> or starts with "<name>.",
+//                               e.g. TlsfAllocator or TlsfAllocator.Fuzz
+//   LampTests --bench [name]... benchmarks too
+//   LampTests --list
+//
+// Exits with 1 when a test fails or no name matches.
+
+#include "LampTest.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    struct Entry
+    {
+        std::string Name;
+        LampTestFunc Func;
+        bool Benchmark;
+    };
+
+    std::vector<Entry>& Registry()
+    {
+        static std::vector<Entry> registry;
+        return registry;
+    }
+
+    // Names are ASCII.
+    std::wstring Wide(const std::string& s)
+    {
+        return std::wstring(s.begin(), s.end());
+    }
+
+    bool Matches(const std::string& name, const std::vector<std::string>& filters)
+    {
+        if (filters.empty())
+            return true;
+        for (auto& filter : filters)
+        {
+            if (name == filter || name.compare(0, filter.size() + 1, filter + ".") == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+LampTestRegistrar::LampTestRegistrar(const char* name, LampTestFunc func, bool benchmark)
+{
+    Registry().push_back({ name, func, benchmark });
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = false;
+    bool list = false;
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bench")
+            bench = true;
+        else if (arg == "--list")
+            list = true;
+        else
+            filters.push_back(arg);
+    }
+
+    auto& registry = Registry();
+    std::sort(registry.begin(), registry.end(),
+        [](const Entry& a, const Entry& b) { return a.Name < b.Name; });
+
+    unsigned matched = 0;
+    unsigned run = 0;
+    unsigned failed = 0;
+    for (auto& entry : registry)
+    {
+        if (!Matches(entry.Name, filters))
+            continue;
+        matched++;
+        if (list)
+        {
+            std::wcout << Wide(entry.Name) << (entry.Benchmark ? L" (benchmark)\n" : L"\n");
+            continue;
+        }
+        if (entry.Benchmark && !bench)
+            continue;
+
+        std::wcout << L"[" << Wide(entry.Name) << L"]\n";
+        std::wstring report = entry.Func();
+        std::wcout << report << std::flush;
+        run++;
+        if (report.find(L"FAILED") != std::wstring::npos)
+            failed++;
+    }
+    if (list)
+        return 0;
+
+    if (matched == 0)
+    {
+        std::wcout << L"No tests match.\n";
+        return 1;
+    }
+    std::wcout << run << L" run, " << failed << L" failed\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#include "LampTest.h"
+#include "main/NameTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Every allocation of this thread is counted, in every build.
+static thread_local std::uint64_t gAllocations = 0;
+
+void* operator new(std::size_t size)
+{
+    gAllocations++;
+    if (void* p = std::malloc(size != 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// The pipelines a frame binds, pass by pass.
+static const std::vector<std::wstring>& FrameNames()
+{
+    static const std::vector<std::wstring> names =
+    {
+        L"Shadow", L"shadow", L"GBuffer", L"GBufferInstanced", L"deferLighting", L"Voxelize",
+        L"taa", L"mipmap3D", L"hiz", L"blit", L"WorldProbe", L"ProbeToSH", L"LampNDDI",
+        L"LampSDI", L"LampVDI", L"LampPDI", L"LampPDi", L"LampSH", L"LampRef", L"LampCDi"
+    };
+    return names;
+}
+
+// What LampPSO and LampRootSignature keep, with a stand-in for the ComPtr.
+typedef LampNamedObjects<std::wstring, PsoTag, const void*> PsoTable;
+
+static const void* FakePso(std::uint32_t i)
+{
+    return reinterpret_cast<const void*>((std::uintptr_t)(i + 1) * 16);
+}
+
+// Interned while the passes are built, before and after the pipelines are set.
+static std::vector<PsoId> BuildTable(PsoTable& table)
+{
+    auto& names = FrameNames();
+    std::vector<PsoId> ids;
+    for (std::uint32_t i = 0; i < (std::uint32_t)names.size(); ++i)
+    {
+        if (i % 2 == 0)
+            table[table.Find(names[i])] = FakePso(i);
+        ids.push_back(table.Find(names[i]));
+    }
+    for (std::uint32_t i = 1; i < (std::uint32_t)names.size(); i += 2)
+        table[ids[i]] = FakePso(i);
+    return ids;
+}
+
+LAMP_TEST(NameTable, LookupsDoNotAllocate)
+{
+    auto& names = FrameNames();
+    PsoTable table;
+    std::vector<PsoId> ids = BuildTable(table);
+    const std::wstring missing = L"NoSuchPipeline";
+
+    // The lookups recording threads make each frame: GetPSO(id), GetRootSignature(id)
+    // and the by-name ones that must never insert.
+    std::uint32_t wrong = 0;
+    const std::uint64_t before = gAllocations;
+    for (std::uint32_t f = 0; f < 100; ++f)
+    {
+        for (std::uint32_t i = 0; i < (std::uint32_t)names.size(); ++i)
+        {
+            const void* const* byName = table.Lookup(names[i]);
+            if (table[ids[i]] != FakePso(i) || byName == nullptr || *byName != FakePso(i))
+                wrong++;
+        }
+        if (table.Lookup(missing) != nullptr)
+            wrong++;
+    }
+    const std::uint64_t allocations = gAllocations - before;
+
+    std::wstring report = L"Named objects: " + std::to_wstring(table.Size()) + L" names, "
+        + std::to_wstring(allocations) + L" allocations over 100 frames of lookups\n";
+    if (table.Size() != (std::uint32_t)names.size())
+        report += L"FAILED: names were interned twice or a lookup inserted\n";
+    if (wrong != 0)
+        report += L"FAILED: " + std::to_wstring(wrong) + L" lookups returned the wrong object\n";
+    if (allocations != 0)
+        report += L"FAILED: lookups allocated\n";
+    return report;
+}
+
+// Per-frame PSO lookups by name, as LampPSO did before, against lookups by id.
+static std::wstring PsoLookups(std::uint32_t lookups)
+{
+    auto& names = FrameNames();
+    const std::uint32_t frames = std::max<std::uint32_t>(1u, lookups / (std::uint32_t)names.size());
+
+    // What LampPSO kept before: a map by name, looked up with a std::wstring passed by value.
+    std::unordered_map<std::wstring, const void*> byName;
+    for (std::uint32_t i = 0; i < (std::uint32_t)names.size(); ++i)
+        byName[names[i]] = FakePso(i);
+    auto lookup = [&](std::wstring name) { return byName.find(name)->second; };
+    PsoTable table;
+    std::vector<PsoId> ids = BuildTable(table);
+
+    std::uintptr_t sum = 0;
+    const std::uint64_t a0 = gAllocations;
+    auto t0 = Clock::now();
+    for (std::uint32_t f = 0; f < frames; ++f)
+    {
+        for (auto& name : names)
+            sum += (std::uintptr_t)lookup(name);
+    }
+    auto t1 = Clock::now();
+    const std::uint64_t a1 = gAllocations;
+    for (std::uint32_t f = 0; f < frames; ++f)
+    {
+        for (auto id : ids)
+            sum -= (std::uintptr_t)table[id];
+    }
+    auto t2 = Clock::now();
+    const std::uint64_t a2 = gAllocations;
+
+    auto perFrame = [&](std::uint64_t a, std::uint64_t b)
+    {
+        return std::to_wstring((double)(b - a) / frames) + L" allocations per frame";
+    };
+    const double count = (double)frames * names.size();
+    double nameNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / count;
+    double idNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / count;
+    return L"PSO lookup benchmark: " + std::to_wstring(frames) + L" frames of "
+        + std::to_wstring(names.size()) + L" lookups, ns per lookup\n"
+        + L"  by name: " + std::to_wstring(nameNs) + L", " + perFrame(a0, a1) + L"\n"
+        + L"  by id: " + std::to_wstring(idNs) + L", " + perFrame(a1, a2)
+        + (sum == 0 ? L"\n" : L" (MISMATCH)\n")
+        + (a2 != a1 ? L"FAILED: lookups by id allocated\n" : L"");
+}
+
+LAMP_BENCHMARK(NameTable, PsoLookups)
+{
+    return PsoLookups(1000000);
+}
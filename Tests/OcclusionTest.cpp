@@ -0,0 +1,127 @@
+#include "LampTest.h"
+#include "main/OcclusionCulling.h"
+#include <cstring>
+#include <memory>
+
+using namespace DirectX;
+
+namespace
+{
+    // A quad of two triangles over corners bottom left, bottom right, top left and top right,
+    // in a mesh of 16-bit indices with a stray index past the last triangle.
+    std::unique_ptr<Mesh> QuadMesh(const XMFLOAT3 (&corners)[4])
+    {
+        const std::uint16_t indices[7] = { 0, 2, 1, 1, 2, 3, 0 };
+        auto mesh = std::make_unique<Mesh>();
+        mesh->VertexByteStride = sizeof(XMFLOAT3);
+        mesh->IndexFormat = DXGI_FORMAT_R16_UINT;
+        ThrowIfFailed(D3DCreateBlob(sizeof(corners), &mesh->VertexBufferCPU));
+        memcpy(mesh->VertexBufferCPU->GetBufferPointer(), corners, sizeof(corners));
+        ThrowIfFailed(D3DCreateBlob(sizeof(indices), &mesh->IndexBufferCPU));
+        memcpy(mesh->IndexBufferCPU->GetBufferPointer(), indices, sizeof(indices));
+        return mesh;
+    }
+
+    // In the plane z = depth, half extents wide.
+    std::unique_ptr<Mesh> QuadMesh(float extent, float depth)
+    {
+        const XMFLOAT3 corners[4] = { XMFLOAT3(-extent, -extent, depth), XMFLOAT3(extent, -extent, depth),
+            XMFLOAT3(-extent, extent, depth), XMFLOAT3(extent, extent, depth) };
+        return QuadMesh(corners);
+    }
+
+    XMMATRIX ViewProj()
+    {
+        const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        const XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 2.0f, 1.0f, 100.0f);
+        return view * proj;
+    }
+}
+
+// A wall quad in front of the camera: its six indices give two occluder triangles, and
+// it hides a box behind it but not one in front of it.
+static std::wstring Wall()
+{
+    auto mesh = QuadMesh(50.0f, 0.0f);
+    RenderItem wall;
+    wall.Geo = mesh.get();
+    wall.IndexCount = 6;
+
+    LampOcclusion occlusion(64, 32, 2);
+    occlusion.AddOccluders({ &wall });
+    if (occlusion.Stats().OccluderTriangles != 2)
+        return L"Occlusion FAILED: a quad gives " + std::to_wstring(occlusion.Stats().OccluderTriangles) + L" occluder triangles\n";
+
+    // A partial triangle past the quad is dropped, not merged with the next item's.
+    wall.IndexCount = 7;
+    occlusion.ClearOccluders();
+    occlusion.AddOccluders({ &wall, &wall });
+    if (occlusion.Stats().OccluderTriangles != 4)
+        return L"Occlusion FAILED: a trailing index changes the occluder triangles\n";
+
+    occlusion.Render(ViewProj());
+    if (occlusion.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, 5.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))))
+        return L"Occlusion FAILED: a box behind the wall is visible\n";
+    if (!occlusion.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, -5.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))))
+        return L"Occlusion FAILED: a box in front of the wall is hidden\n";
+    return L"Occlusion: a quad wall of 2 triangles hides what is behind it, ok\n";
+}
+
+// A wall that runs from 0.5 in front of the camera, before the near plane at 1, to 5 away.
+// The part before the near plane is clipped, so it hides nothing, while the rest still
+// hides a box behind it. Culling over many items matches testing them one by one.
+static std::wstring NearPlane()
+{
+    const XMFLOAT3 corners[4] = { XMFLOAT3(-0.3f, -50.0f, -9.5f), XMFLOAT3(3.0f, -50.0f, -5.0f),
+        XMFLOAT3(-0.3f, 50.0f, -9.5f), XMFLOAT3(3.0f, 50.0f, -5.0f) };
+    auto mesh = QuadMesh(corners);
+    RenderItem wall;
+    wall.Geo = mesh.get();
+    wall.IndexCount = 6;
+
+    LampOcclusion occlusion(64, 32, 2);
+    occlusion.AddOccluders({ &wall });
+    occlusion.Render(ViewProj());
+    for (float depth : occlusion.Depth())
+    {
+        if (depth <= 0.0f)
+            return L"Occlusion FAILED: a wall crossing the near plane writes depth 0\n";
+    }
+    if (!occlusion.IsVisible(BoundingBox(XMFLOAT3(-3.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))))
+        return L"Occlusion FAILED: the part of a wall before the near plane hides a box\n";
+    if (occlusion.IsVisible(BoundingBox(XMFLOAT3(6.0f, 0.0f, 20.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))))
+        return L"Occlusion FAILED: a wall crossing the near plane no longer hides a box behind it\n";
+
+    // A row of boxes sweeping across the screen behind the wall.
+    std::vector<std::unique_ptr<RenderItem>> boxes;
+    std::vector<RenderItem*> items;
+    for (int i = 0; i < 500; ++i)
+    {
+        boxes.push_back(std::make_unique<RenderItem>());
+        boxes.back()->Bounds = BoundingBox(XMFLOAT3(-20.0f + 0.08f * i, 0.0f, 20.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+        items.push_back(boxes.back().get());
+    }
+    occlusion.Cull(items);
+    UINT culled = 0;
+    for (auto ri : items)
+    {
+        if (ri->Visible != occlusion.IsVisible(ri->Bounds))
+            return L"Occlusion FAILED: Cull() disagrees with IsVisible()\n";
+        culled += ri->Visible ? 0 : 1;
+    }
+    if (culled != occlusion.Stats().CulledItems || culled == 0 || culled == items.size())
+        return L"Occlusion FAILED: Cull() hid " + std::to_wstring(occlusion.Stats().CulledItems) + L" of "
+            + std::to_wstring(items.size()) + L" boxes, counted " + std::to_wstring(culled) + L"\n";
+    return L"Occlusion: a wall crossing the near plane is clipped, " + std::to_wstring(culled) + L" of "
+        + std::to_wstring(items.size()) + L" boxes culled, ok\n";
+}
+
+LAMP_TEST(Occlusion, Wall)
+{
+    return Wall();
+}
+
+LAMP_TEST(Occlusion, NearPlane)
+{
+    return NearPlane();
+}
@@ -0,0 +1,157 @@
+#include "LampTest.h"
+#include "main/Octree.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // The values of the first count queries against every box, as sets.
+    template<typename Shape>
+    bool MatchesBruteForce(const std::vector<Shape>& shapes, const std::vector<std::vector<UINT>>& results,
+        const std::vector<BoundingBox>& boxes, UINT count)
+    {
+        for (UINT q = 0; q < count; ++q)
+        {
+            std::vector<UINT> expected;
+            for (UINT i = 0; i < (UINT)boxes.size(); ++i)
+            {
+                if (shapes[q].Intersects(boxes[i]))
+                    expected.push_back(i);
+            }
+            std::vector<UINT> found = results[q];
+            std::sort(found.begin(), found.end());
+            if (found != expected)
+                return false;
+        }
+        return true;
+    }
+}
+
+// Moves numObjects random boxes for a few frames and times moves and batched queries,
+// checking a few sphere, box and frustum queries and the final removal against brute force.
+static std::wstring MoveAndQuery(UINT numObjects)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto ms = [](Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    const float worldHalf = 512.0f;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> posDist(-worldHalf, worldHalf);
+    std::uniform_real_distribution<float> sizeDist(0.25f, 4.0f);
+    std::uniform_real_distribution<float> velDist(-2.0f, 2.0f);
+
+    std::vector<BoundingBox> boxes(numObjects);
+    std::vector<XMFLOAT3> velocities(numObjects);
+    for (UINT i = 0; i < numObjects; ++i)
+    {
+        boxes[i].Center = XMFLOAT3(posDist(rng), posDist(rng), posDist(rng));
+        float s = sizeDist(rng);
+        boxes[i].Extents = XMFLOAT3(s, s, s);
+        velocities[i] = XMFLOAT3(velDist(rng), velDist(rng), velDist(rng));
+    }
+
+    LampOctree octree;
+    octree.Reset(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(worldHalf, worldHalf, worldHalf)));
+
+    std::vector<UINT> handles(numObjects);
+    auto t0 = Clock::now();
+    for (UINT i = 0; i < numObjects; ++i)
+        handles[i] = octree.Insert(boxes[i], i);
+    auto t1 = Clock::now();
+    double insertMs = ms(t0, t1);
+
+    const UINT frames = 8;
+    double moveMs = 0.0;
+    for (UINT f = 0; f < frames; ++f)
+    {
+        for (UINT i = 0; i < numObjects; ++i)
+        {
+            float* c = &boxes[i].Center.x;
+            float* v = &velocities[i].x;
+            for (UINT a = 0; a < 3; ++a)
+            {
+                c[a] += v[a];
+                if (c[a] < -worldHalf || c[a] > worldHalf)
+                    v[a] = -v[a];
+            }
+        }
+
+        t0 = Clock::now();
+        for (UINT i = 0; i < numObjects; ++i)
+            octree.Move(handles[i], boxes[i]);
+        t1 = Clock::now();
+        moveMs += ms(t0, t1);
+    }
+
+    std::vector<BoundingSphere> spheres(1024);
+    for (auto& s : spheres)
+        s = BoundingSphere(XMFLOAT3(posDist(rng), posDist(rng), posDist(rng)), 16.0f);
+
+    std::vector<std::vector<UINT>> results;
+    t0 = Clock::now();
+    octree.QueryBatch(spheres, results);
+    t1 = Clock::now();
+    double queryMs = ms(t0, t1);
+
+    size_t hits = 0;
+    for (auto& r : results)
+        hits += r.size();
+
+    // Brute force check of a few queries of each shape.
+    bool match = MatchesBruteForce(spheres, results, boxes, 8);
+
+    std::vector<BoundingBox> queryBoxes(8);
+    for (auto& b : queryBoxes)
+        b = BoundingBox(XMFLOAT3(posDist(rng), posDist(rng), posDist(rng)), XMFLOAT3(24.0f, 8.0f, 40.0f));
+    octree.QueryBatch(queryBoxes, results);
+    match = match && MatchesBruteForce(queryBoxes, results, boxes, (UINT)queryBoxes.size());
+
+    // Cameras at random places looking in random directions, 200 deep.
+    std::uniform_real_distribution<float> angleDist(-XM_PI, XM_PI);
+    std::vector<BoundingFrustum> frustums(8);
+    for (auto& f : frustums)
+    {
+        BoundingFrustum local(XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.5f, 1.0f, 200.0f));
+        XMMATRIX pose = XMMatrixRotationRollPitchYaw(angleDist(rng), angleDist(rng), 0.0f)
+            * XMMatrixTranslation(posDist(rng), posDist(rng), posDist(rng));
+        local.Transform(f, pose);
+    }
+    octree.QueryBatch(frustums, results);
+    match = match && MatchesBruteForce(frustums, results, boxes, (UINT)frustums.size());
+    size_t frustumHits = 0;
+    for (auto& r : results)
+        frustumHits += r.size();
+
+    UINT peakNodes = octree.NodeCount();
+    t0 = Clock::now();
+    for (UINT i = 0; i < numObjects; ++i)
+        octree.Remove(handles[i]);
+    t1 = Clock::now();
+    double removeMs = ms(t0, t1);
+    match = match && octree.NodeCount() == 1;
+
+    return L"Octree benchmark: " + std::to_wstring(numObjects) + L" objects, "
+        + std::to_wstring(peakNodes) + L" nodes\n"
+        + L"  insert " + std::to_wstring(insertMs) + L" ms, move " + std::to_wstring(moveMs / frames)
+        + L" ms per frame, remove " + std::to_wstring(removeMs) + L" ms\n"
+        + L"  " + std::to_wstring(spheres.size()) + L" sphere queries " + std::to_wstring(queryMs)
+        + L" ms, " + std::to_wstring(hits) + L" hits; " + std::to_wstring(frustumHits) + L" hits in "
+        + std::to_wstring(frustums.size()) + L" frustums"
+        + (match ? L"\n" : L", FAILED: queries or removal disagree with brute force\n");
+}
+
+LAMP_TEST(Octree, MoveAndQuery)
+{
+    return MoveAndQuery(4096);
+}
+
+LAMP_BENCHMARK(Octree, MoveAndQueryLarge)
+{
+    return MoveAndQuery(1000000);
+}
@@ -0,0 +1,74 @@
+#include "LampTest.h"
+#include "main/PipelineCache.h"
+#include <random>
+
+// Random caches serialized and read back, then the file cut short, padded, of
+// another version and with an entry running past its end.
+static std::wstring Files(std::uint32_t iterations, std::uint32_t seed)
+{
+    // Magic, Version, Count and Reserved, then per entry Key and Size.
+    const std::size_t headerSize = 16;
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t blobs = 0;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        LampPipelineCache cache;
+        std::vector<std::pair<std::uint64_t, std::vector<std::uint8_t>>> stored(rng() % 12);
+        for (auto& s : stored)
+        {
+            s.first = ((std::uint64_t)rng() << 32) | rng();
+            s.second.resize(rng() % 100);
+            for (auto& byte : s.second)
+                byte = (std::uint8_t)rng();
+            cache.Store(s.first, s.second.data(), s.second.size());
+        }
+        std::vector<std::uint8_t> file = cache.Serialize();
+        LampPipelineCache loaded;
+        if (!loaded.Deserialize(file.data(), file.size()) || loaded.Count() != cache.Count() || loaded.Dirty())
+        {
+            error = L"cache did not read back";
+            break;
+        }
+        for (auto& s : stored)
+        {
+            const std::vector<std::uint8_t>* blob = loaded.Find(s.first);
+            if (blob == nullptr || *blob != s.second)
+                error = L"cached blob lost or changed";
+        }
+        if (loaded.Serialize() != file)
+            error = L"cache file not stable across a round trip";
+        blobs += loaded.Count();
+
+        std::vector<std::uint8_t> broken(file.begin(), file.begin() + rng() % file.size());
+        if (loaded.Deserialize(broken.data(), broken.size()) || loaded.Count() != 0)
+            error = L"truncated cache file accepted";
+        broken = file;
+        broken.resize(file.size() + 8 * (1 + rng() % 4));
+        if (loaded.Deserialize(broken.data(), broken.size()))
+            error = L"cache file with trailing bytes accepted";
+        broken = file;
+        broken[4]++;
+        if (loaded.Deserialize(broken.data(), broken.size()))
+            error = L"cache file of another version accepted";
+        if (file.size() > headerSize)
+        {
+            broken = file;
+            // An entry size running past the end.
+            broken[headerSize + 8 + 7] = 0x7f;
+            if (loaded.Deserialize(broken.data(), broken.size()))
+                error = L"cache entry past the end accepted";
+        }
+    }
+
+    if (!error.empty())
+        return L"Pipeline cache FAILED: " + error + L"\n";
+    return L"Pipeline cache: " + std::to_wstring(iterations) + L" files, "
+        + std::to_wstring(blobs) + L" blobs round-tripped, ok\n";
+}
+
+LAMP_TEST(PipelineCache, Files)
+{
+    return Files(1000, 1);
+}
@@ -0,0 +1,269 @@
+#include "LampTest.h"
+#include "main/PipelineKey.h"
+#include <functional>
+#include <random>
+
+namespace
+{
+    // A random root signature or pipeline description and the memory it points into.
+    struct TestRootSignature
+    {
+        std::vector<std::vector<D3D12_DESCRIPTOR_RANGE>> Ranges;
+        std::vector<D3D12_ROOT_PARAMETER> Parameters;
+        std::vector<D3D12_STATIC_SAMPLER_DESC> Samplers;
+        D3D12_ROOT_SIGNATURE_DESC Desc;
+
+        // Every struct is filled with noise before its fields are set, so bytes the
+        // hash must skip (padding, the unused part of a union) differ between copies.
+        void CopyFrom(const TestRootSignature& other, std::mt19937& noise)
+        {
+            auto scramble = [&](void* p, size_t size)
+            {
+                for (size_t i = 0; i < size; ++i)
+                    static_cast<BYTE*>(p)[i] = (BYTE)noise();
+            };
+            Ranges.assign(other.Ranges.size(), {});
+            Parameters.resize(other.Parameters.size());
+            for (size_t i = 0; i < other.Parameters.size(); ++i)
+            {
+                const D3D12_ROOT_PARAMETER& src = other.Parameters[i];
+                D3D12_ROOT_PARAMETER& dst = Parameters[i];
+                scramble(&dst, sizeof(dst));
+                dst.ParameterType = src.ParameterType;
+                dst.ShaderVisibility = src.ShaderVisibility;
+                if (src.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+                {
+                    Ranges[i] = other.Ranges[i];
+                    dst.DescriptorTable.NumDescriptorRanges = (UINT)Ranges[i].size();
+                    dst.DescriptorTable.pDescriptorRanges = Ranges[i].data();
+                }
+                else if (src.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+                {
+                    dst.Constants.ShaderRegister = src.Constants.ShaderRegister;
+                    dst.Constants.RegisterSpace = src.Constants.RegisterSpace;
+                    dst.Constants.Num32BitValues = src.Constants.Num32BitValues;
+                }
+                else
+                {
+                    dst.Descriptor.ShaderRegister = src.Descriptor.ShaderRegister;
+                    dst.Descriptor.RegisterSpace = src.Descriptor.RegisterSpace;
+                }
+            }
+            Samplers = other.Samplers;
+            scramble(&Desc, sizeof(Desc));
+            Desc.NumParameters = (UINT)Parameters.size();
+            Desc.pParameters = Parameters.data();
+            Desc.NumStaticSamplers = (UINT)Samplers.size();
+            Desc.pStaticSamplers = Samplers.data();
+            Desc.Flags = other.Desc.Flags;
+        }
+
+        void Random(std::mt19937& rng)
+        {
+            const UINT count = rng() % 8;
+            Ranges.assign(count, {});
+            Parameters.assign(count, {});
+            for (UINT i = 0; i < count; ++i)
+            {
+                D3D12_ROOT_PARAMETER& p = Parameters[i];
+                p.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)(rng() % 5);
+                p.ShaderVisibility = (D3D12_SHADER_VISIBILITY)(rng() % 6);
+                if (p.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+                {
+                    Ranges[i].resize(1 + rng() % 3);
+                    for (auto& r : Ranges[i])
+                        r = { (D3D12_DESCRIPTOR_RANGE_TYPE)(rng() % 4), (UINT)(1 + rng() % 8), (UINT)(rng() % 8), (UINT)(rng() % 2),
+                            rng() % 2 ? 0u : D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND };
+                    p.DescriptorTable = { (UINT)Ranges[i].size(), Ranges[i].data() };
+                }
+                else if (p.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+                    p.Constants = { (UINT)(rng() % 8), (UINT)(rng() % 2), (UINT)(1 + rng() % 16) };
+                else
+                    p.Descriptor = { (UINT)(rng() % 8), (UINT)(rng() % 2) };
+            }
+            Samplers.resize(rng() % 4);
+            for (UINT i = 0; i < Samplers.size(); ++i)
+            {
+                D3D12_STATIC_SAMPLER_DESC& s = Samplers[i];
+                memset(&s, 0, sizeof(s));
+                s.Filter = rng() % 2 ? D3D12_FILTER_MIN_MAG_MIP_LINEAR : D3D12_FILTER_MIN_MAG_MIP_POINT;
+                s.AddressU = s.AddressV = s.AddressW = (D3D12_TEXTURE_ADDRESS_MODE)(1 + rng() % 4);
+                s.MaxAnisotropy = 1 + rng() % 16;
+                s.ComparisonFunc = (D3D12_COMPARISON_FUNC)(1 + rng() % 8);
+                s.MaxLOD = D3D12_FLOAT32_MAX;
+                s.ShaderRegister = i;
+            }
+            Desc = { count, Parameters.data(), (UINT)Samplers.size(), Samplers.data(),
+                (D3D12_ROOT_SIGNATURE_FLAGS)(rng() % 2) };
+        }
+    };
+
+    struct TestPipeline
+    {
+        std::vector<BYTE> VS;
+        std::vector<BYTE> PS;
+        std::vector<std::string> Semantics;
+        std::vector<D3D12_INPUT_ELEMENT_DESC> Layout;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+
+        void Random(std::mt19937& rng)
+        {
+            VS.resize(16 + rng() % 256);
+            PS.resize(rng() % 3 == 0 ? 0 : 16 + rng() % 256);
+            for (auto& b : VS)
+                b = (BYTE)rng();
+            for (auto& b : PS)
+                b = (BYTE)rng();
+            const char* names[] = { "POSITION", "NORMAL", "TEXCOORD", "TANGENT" };
+            Semantics.clear();
+            for (UINT i = 0, n = rng() % 5; i < n; ++i)
+                Semantics.push_back(names[rng() % 4]);
+
+            memset(&Desc, 0, sizeof(Desc));
+            Desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+            Desc.BlendState.IndependentBlendEnable = rng() % 2;
+            Desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+            Desc.RasterizerState.CullMode = (D3D12_CULL_MODE)(1 + rng() % 3);
+            Desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+            Desc.DepthStencilState.DepthFunc = (D3D12_COMPARISON_FUNC)(1 + rng() % 8);
+            Desc.SampleMask = UINT_MAX;
+            Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            Desc.NumRenderTargets = rng() % 9;
+            for (UINT i = 0; i < Desc.NumRenderTargets; ++i)
+                Desc.RTVFormats[i] = (DXGI_FORMAT)(1 + rng() % 60);
+            Desc.DSVFormat = rng() % 2 ? DXGI_FORMAT_D24_UNORM_S8_UINT : DXGI_FORMAT_UNKNOWN;
+            Desc.SampleDesc = { 1, 0 };
+            Point();
+        }
+
+        // Fresh copies of the bytecode and semantic strings, so only contents can match,
+        // and noise in the fields past a count.
+        void CopyFrom(const TestPipeline& other, std::mt19937& noise)
+        {
+            VS = other.VS;
+            PS = other.PS;
+            Semantics.clear();
+            for (auto& s : other.Semantics)
+                Semantics.push_back(std::string(s.begin(), s.end()));
+            Desc = other.Desc;
+            for (UINT i = other.Desc.NumRenderTargets; i < 8; ++i)
+                Desc.RTVFormats[i] = (DXGI_FORMAT)(noise() % 60);
+            if (!Desc.BlendState.IndependentBlendEnable)
+            {
+                for (UINT i = 1; i < 8; ++i)
+                    Desc.BlendState.RenderTarget[i].SrcBlend = (D3D12_BLEND)(1 + noise() % 10);
+            }
+            Desc.CachedPSO = { reinterpret_cast<void*>((UINT_PTR)noise()), noise() };
+            Point();
+        }
+
+        void Point()
+        {
+            Layout.clear();
+            for (UINT i = 0; i < Semantics.size(); ++i)
+                Layout.push_back({ Semantics[i].c_str(), 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, i * 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+            Desc.InputLayout = { Layout.data(), (UINT)Layout.size() };
+            Desc.VS = { VS.data(), VS.size() };
+            Desc.PS = { PS.empty() ? nullptr : PS.data(), PS.size() };
+        }
+    };
+}
+
+// Keys of random descriptions against copies, mutations and garbage in the unused fields.
+static std::wstring Descriptions(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT mutations = 0;
+
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        // Root signatures.
+        TestRootSignature a, b;
+        a.Random(rng);
+        b.CopyFrom(a, rng);
+        const UINT64 rootKey = LampPipelineKey::RootSignature(a.Desc);
+        if (LampPipelineKey::RootSignature(b.Desc) != rootKey)
+        {
+            error = L"equal root signatures hashed differently";
+            break;
+        }
+        std::vector<std::function<bool(TestRootSignature&)>> rootMutations =
+        {
+            [](TestRootSignature& r) { r.Desc.Flags = (D3D12_ROOT_SIGNATURE_FLAGS)(r.Desc.Flags ^ 1); return true; },
+            [](TestRootSignature& r) { if (r.Parameters.empty()) return false; r.Parameters.back().ShaderVisibility = (D3D12_SHADER_VISIBILITY)(r.Parameters.back().ShaderVisibility ^ 1); return true; },
+            [](TestRootSignature& r) { if (r.Parameters.empty()) return false; r.Desc.NumParameters--; return true; },
+            [](TestRootSignature& r) { if (r.Samplers.empty()) return false; r.Samplers[0].AddressU = (D3D12_TEXTURE_ADDRESS_MODE)(r.Samplers[0].AddressU % 4 + 1); return true; },
+            [](TestRootSignature& r)
+            {
+                for (auto& p : r.Parameters)
+                {
+                    if (p.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+                    {
+                        const_cast<D3D12_DESCRIPTOR_RANGE*>(p.DescriptorTable.pDescriptorRanges)[0].NumDescriptors++;
+                        return true;
+                    }
+                    if (p.ParameterType != D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+                    {
+                        p.Descriptor.ShaderRegister++;
+                        return true;
+                    }
+                }
+                return false;
+            },
+        };
+        auto& mutateRoot = rootMutations[rng() % rootMutations.size()];
+        if (mutateRoot(b))
+        {
+            mutations++;
+            if (LampPipelineKey::RootSignature(b.Desc) == rootKey)
+                error = L"changed root signature kept its key";
+        }
+
+        // Graphics pipelines.
+        TestPipeline p, q;
+        p.Random(rng);
+        q.CopyFrom(p, rng);
+        const UINT64 psoKey = LampPipelineKey::Graphics(p.Desc, rootKey);
+        if (LampPipelineKey::Graphics(q.Desc, rootKey) != psoKey)
+        {
+            error = L"equal pipelines hashed differently";
+            break;
+        }
+        std::vector<std::function<bool(TestPipeline&, UINT64&)>> psoMutations =
+        {
+            [](TestPipeline& t, UINT64& root) { root++; return true; },
+            [](TestPipeline& t, UINT64&) { t.VS[t.VS.size() / 2] ^= 1; return true; },
+            [](TestPipeline& t, UINT64&) { t.VS.push_back(0); t.Point(); return true; },
+            [](TestPipeline& t, UINT64&) { if (t.Semantics.empty()) return false; t.Semantics[0][0] ^= 0x20; return true; },
+            [](TestPipeline& t, UINT64&) { if (t.Desc.NumRenderTargets == 0) return false; t.Desc.RTVFormats[0] = (DXGI_FORMAT)(t.Desc.RTVFormats[0] + 1); return true; },
+            [](TestPipeline& t, UINT64&) { t.Desc.NumRenderTargets = (t.Desc.NumRenderTargets + 1) % 9; return true; },
+            [](TestPipeline& t, UINT64&) { t.Desc.DepthStencilState.DepthFunc = (D3D12_COMPARISON_FUNC)(t.Desc.DepthStencilState.DepthFunc % 8 + 1); return true; },
+            [](TestPipeline& t, UINT64&) { t.Desc.RasterizerState.CullMode = (D3D12_CULL_MODE)(t.Desc.RasterizerState.CullMode % 3 + 1); return true; },
+            [](TestPipeline& t, UINT64&) { t.Desc.BlendState.RenderTarget[0].BlendEnable ^= 1; return true; },
+            [](TestPipeline& t, UINT64&) { std::swap(t.Desc.VS, t.Desc.PS); return t.VS != t.PS; },
+        };
+        UINT64 mutatedRoot = rootKey;
+        if (psoMutations[rng() % psoMutations.size()](q, mutatedRoot))
+        {
+            mutations++;
+            if (LampPipelineKey::Graphics(q.Desc, mutatedRoot) == psoKey)
+                error = L"changed pipeline kept its key";
+        }
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC compute = {};
+        compute.CS = p.Desc.VS;
+        if (LampPipelineKey::Compute(compute, rootKey) == LampPipelineKey::Graphics(p.Desc, rootKey))
+            error = L"compute and graphics keys collide";
+    }
+
+    if (!error.empty())
+        return L"Pipeline keys FAILED: " + error + L"\n";
+    return L"Pipeline keys: " + std::to_wstring(iterations) + L" descriptions, "
+        + std::to_wstring(mutations) + L" changes detected, ok\n";
+}
+
+LAMP_TEST(PipelineKey, Descriptions)
+{
+    return Descriptions(1000, 1);
+}
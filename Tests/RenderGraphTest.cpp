@@ -0,0 +1,254 @@
+#include "LampTest.h"
+#include "main/RenderGraph.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// A small graph whose compiled schedule is known.
+static std::wstring FixedGraph()
+{
+    const std::uint32_t RT = LampStateRenderTarget;
+    const std::uint32_t UA = LampStateUnorderedAccess;
+
+    LampRenderGraph g;
+    std::uint32_t gbuffer = g.AddPass(L"GBuffer", 0, true, true);
+    g.Write(gbuffer, L"Albedo", RT);
+    std::uint32_t unused = g.AddPass(L"Unused", 0, true, true);
+    g.Read(unused, L"Albedo");
+    g.Write(unused, L"Scratch", RT);
+    std::uint32_t blurX = g.AddPass(L"BlurX", 1, true, true);
+    g.Read(blurX, L"Albedo");
+    g.Write(blurX, L"Blur", UA);
+    std::uint32_t blurY = g.AddPass(L"BlurY", 1, true, true);
+    g.Read(blurY, L"Blur", UA);
+    g.Write(blurY, L"Blur", UA);
+    std::uint32_t legacy = g.AddPass(L"Legacy", 1, false, false);
+    g.Read(legacy, L"Blur");
+    std::uint32_t lighting = g.AddPass(L"Lighting", 2, true, false);
+    g.Read(lighting, L"Albedo");
+    g.Read(lighting, L"Blur");
+    g.Write(lighting, L"Output", RT);
+    g.Compile();
+
+    const std::wstring expected =
+        L"Render graph: 6 passes (1 culled), 9 barriers in 5 batches\n"
+        L"  0 [stage 0] GBuffer\n"
+        L"      Albedo GENERIC_READ -> RENDER_TARGET\n"
+        L"  1 [stage 1] BlurX\n"
+        L"      Albedo RENDER_TARGET -> GENERIC_READ\n"
+        L"      Blur GENERIC_READ -> UNORDERED_ACCESS\n"
+        L"  2 [stage 1] BlurY\n"
+        L"      Blur UAV\n"
+        L"  3 [stage 1] Legacy (own barriers)\n"
+        L"  4 [stage 2] Lighting\n"
+        L"      Albedo UNKNOWN -> GENERIC_READ\n"
+        L"      Blur UNKNOWN -> GENERIC_READ\n"
+        L"      Output UNKNOWN -> RENDER_TARGET\n"
+        L"  culled: Unused\n"
+        L"  end of frame\n"
+        L"      Scratch UNKNOWN -> GENERIC_READ\n"
+        L"      Output RENDER_TARGET -> GENERIC_READ\n";
+    if (g.Dump() != expected)
+        return L"Render graph fixed graph: FAILED, dump differs:\n" + g.Dump();
+    return L"Render graph fixed graph: ok\n";
+}
+
+// What the test declared, kept beside the graph so the checks need only its public side.
+struct ModelAccess
+{
+    std::uint32_t Resource;
+    std::uint32_t State;
+    bool Write;
+};
+
+struct ModelPass
+{
+    bool Managed;
+    bool Cullable;
+    std::vector<ModelAccess> Accesses;
+};
+
+static bool Touches(const ModelPass& pass, std::uint32_t resource, bool& writes)
+{
+    bool touches = false;
+    writes = false;
+    for (auto& a : pass.Accesses)
+    {
+        if (a.Resource == resource)
+        {
+            touches = true;
+            writes |= a.Write;
+        }
+    }
+    return touches;
+}
+
+// Random graphs: culling, ordering and the barriers replayed against the declarations.
+static std::wstring RandomGraphs(std::uint32_t iterations, std::uint32_t seed)
+{
+    const std::uint32_t InvalidPass = ~0u;
+    const std::uint32_t RestingState = LampRenderGraph::RestingState;
+    const std::uint32_t states[] = { LampStateRenderTarget, LampStateUnorderedAccess };
+    std::mt19937 rng(seed);
+    std::wstring error;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        LampRenderGraph g;
+        std::vector<ModelPass> passes;
+        const std::uint32_t numPasses = 4 + rng() % 20;
+        const std::uint32_t numResources = 2 + rng() % 10;
+        std::uint32_t stage = 0;
+        for (std::uint32_t p = 0; p < numPasses; ++p)
+        {
+            stage += rng() % 4 == 0 ? 1 : 0;
+            bool managed = rng() % 4 != 0;
+            bool cullable = rng() % 2 == 0;
+            g.AddPass(L"P" + std::to_wstring(p), stage, managed, cullable);
+            passes.push_back({ managed, cullable, {} });
+            for (std::uint32_t a = rng() % 4; a > 0; --a)
+            {
+                std::uint32_t resource = rng() % numResources;
+                std::wstring name = L"R" + std::to_wstring(resource);
+                if (rng() % 2 == 0)
+                {
+                    std::uint32_t state = rng() % 3 == 0 ? LampStateUnorderedAccess : RestingState;
+                    g.Read(p, name, state);
+                    passes[p].Accesses.push_back({ resource, state, false });
+                }
+                else
+                {
+                    std::uint32_t state = states[rng() % 2];
+                    g.Write(p, name, state);
+                    passes[p].Accesses.push_back({ resource, state, true });
+                }
+            }
+        }
+        if (!g.Compile())
+        {
+            error = L"stage order rejected";
+            break;
+        }
+
+        // The graph numbers resources by first use; map them back to "R<n>".
+        std::vector<std::uint32_t> model(g.ResourceCount());
+        for (std::uint32_t r = 0; r < g.ResourceCount(); ++r)
+            model[r] = (std::uint32_t)std::stoul(g.ResourceName(r).substr(1));
+
+        std::vector<std::uint32_t> position(numPasses, InvalidPass);
+        for (std::uint32_t pos = 0; pos < (std::uint32_t)g.Schedule().size(); ++pos)
+            position[g.Schedule()[pos].Pass] = pos;
+
+        for (std::uint32_t p = 0; p < numPasses && error.empty(); ++p)
+        {
+            if (g.Culled(p) != (position[p] == InvalidPass))
+                error = L"culled pass scheduled";
+            if (g.Culled(p) && !passes[p].Cullable)
+                error = L"side-effect pass culled";
+        }
+
+        // Conflicting accesses keep their declaration order.
+        for (std::uint32_t p = 0; p < numPasses && error.empty(); ++p)
+        {
+            for (std::uint32_t q = p + 1; q < numPasses && position[p] != InvalidPass; ++q)
+            {
+                if (position[q] == InvalidPass)
+                    continue;
+                for (std::uint32_t r = 0; r < numResources; ++r)
+                {
+                    bool pw, qw;
+                    if (Touches(passes[p], r, pw) && Touches(passes[q], r, qw) && (pw || qw) && position[p] > position[q])
+                        error = L"dependency out of order";
+                }
+            }
+        }
+
+        // A culled pass's writes never reach a surviving reader.
+        for (std::uint32_t p = 0; p < numPasses && error.empty(); ++p)
+        {
+            if (!g.Culled(p))
+                continue;
+            for (auto& a : passes[p].Accesses)
+            {
+                if (!a.Write)
+                    continue;
+                for (std::uint32_t q = p + 1; q < numPasses; ++q)
+                {
+                    bool qw;
+                    if (g.Culled(q) || !Touches(passes[q], a.Resource, qw))
+                        continue;
+                    bool reads = false;
+                    for (auto& b : passes[q].Accesses)
+                        reads |= b.Resource == a.Resource && !b.Write;
+                    if (reads)
+                        error = L"culled pass feeds a live one";
+                    break;
+                }
+            }
+        }
+
+        // Replaying the barriers puts every managed access in its declared state.
+        // Nothing is issued around unmanaged passes, which leave every state unknown.
+        std::vector<std::uint32_t> state(numResources, RestingState);
+        auto apply = [&](const GraphBarrier& b)
+        {
+            std::uint32_t r = model[b.Resource];
+            if (state[r] != b.Before)
+                error = L"barrier from the wrong state";
+            state[r] = b.After;
+        };
+        for (auto& step : g.Schedule())
+        {
+            for (auto& b : step.Barriers)
+                apply(b);
+            const ModelPass& pass = passes[step.Pass];
+            if (!pass.Managed)
+            {
+                if (!step.Barriers.empty())
+                    error = L"barriers issued for an unmanaged pass";
+                for (std::uint32_t r : model)
+                    state[r] = LampRenderGraph::UnknownState;
+                continue;
+            }
+            for (std::uint32_t r = 0; r < numResources; ++r)
+            {
+                bool writes;
+                if (Touches(pass, r, writes))
+                {
+                    std::uint32_t want = RestingState;
+                    bool found = false;
+                    for (auto& a : pass.Accesses)
+                    {
+                        if (a.Resource == r && (!found || a.Write))
+                        {
+                            want = a.State;
+                            found = true;
+                        }
+                    }
+                    if (state[r] != want)
+                        error = L"managed access in the wrong state";
+                }
+            }
+        }
+        for (auto& b : g.FinalBarriers())
+            apply(b);
+        for (auto s : state)
+        {
+            if (s != RestingState)
+                error = L"resource left out of the resting state";
+        }
+    }
+
+    return L"Render graph: " + std::to_wstring(iterations) + L" random graphs, "
+        + (error.empty() ? std::wstring(L"ok\n") : L"FAILED: " + error + L"\n");
+}
+
+LAMP_TEST(RenderGraph, FixedGraph)
+{
+    return FixedGraph();
+}
+
+LAMP_TEST(RenderGraph, RandomGraphs)
+{
+    return RandomGraphs(1000, 1);
+}
@@ -0,0 +1,80 @@
+#include "LampTest.h"
+#include "main/ShaderArchive.h"
+#include <cstring>
+#include <random>
+
+// Random archives packed, opened and searched; truncated and corrupted ones refused.
+static std::wstring Archives(std::uint32_t iterations, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t blobs = 0;
+    std::uint32_t refused = 0;
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        std::vector<std::pair<std::string, std::vector<std::uint8_t>>> input;
+        const std::uint32_t count = rng() % 48;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            // Short names from a small alphabet, so some share prefixes.
+            std::string name = std::to_string(i) + "_";
+            for (std::uint32_t c = rng() % 12; c > 0; --c)
+                name += (char)('a' + rng() % 3);
+            std::vector<std::uint8_t> data(rng() % 300);
+            for (auto& b : data)
+                b = (std::uint8_t)rng();
+            input.push_back({ name, data });
+        }
+        blobs += count;
+
+        std::vector<std::uint8_t> packed = LampShaderArchive::Pack(input);
+        LampShaderArchive archive;
+        std::string reason;
+        if (!archive.Open(packed.data(), packed.size(), reason))
+        {
+            error = L"packed archive refused";
+            break;
+        }
+        if (archive.Count() != count)
+            error = L"entry count wrong";
+        for (auto& in : input)
+        {
+            LampShaderArchive::Blob blob = archive.Find(in.first);
+            if (blob.Data == nullptr || blob.Size != in.second.size()
+                || (blob.Size > 0 && std::memcmp(blob.Data, in.second.data(), blob.Size) != 0))
+                error = L"blob not found or different";
+            else if ((static_cast<const std::uint8_t*>(blob.Data) - packed.data()) % LampShaderArchive::BlobAlignment != 0)
+                error = L"blob not aligned";
+        }
+        if (archive.Find("missing").Data != nullptr || archive.Find(std::to_string(count) + "_").Data != nullptr)
+            error = L"found a name never packed";
+
+        // Cut short or with a corrupt index, the archive must be refused rather than read past its end.
+        std::vector<std::uint8_t> broken = packed;
+        broken.resize(rng() % packed.size());
+        LampShaderArchive truncated;
+        if (truncated.Open(broken.data(), broken.size(), reason))
+            error = L"truncated archive opened";
+        if (count > 0)
+        {
+            broken = packed;
+            auto entries = reinterpret_cast<LampShaderArchive::Entry*>(&broken[sizeof(LampShaderArchive::Header)]);
+            entries[rng() % count].BlobOffset = broken.size() + LampShaderArchive::BlobAlignment;
+            LampShaderArchive corrupt;
+            if (corrupt.Open(broken.data(), broken.size(), reason))
+                error = L"archive with an entry past the end opened";
+        }
+        refused += 2;
+    }
+
+    if (!error.empty())
+        return L"Shader archive FAILED: " + error + L"\n";
+    return L"Shader archive: " + std::to_wstring(iterations) + L" archives, "
+        + std::to_wstring(blobs) + L" blobs, " + std::to_wstring(refused) + L" broken ones refused, ok\n";
+}
+
+LAMP_TEST(ShaderArchive, Archives)
+{
+    return Archives(1000, 1);
+}
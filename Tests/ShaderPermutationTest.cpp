@@ -0,0 +1,304 @@
+#include "LampTest.h"
+#include "main/ShaderPermutation.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+
+// Keys, defines and the disk cache, then concurrent requests against a counting
+// compiler: every permutation compiled once, served from disk the second time.
+// Writes and removes its files in directory.
+static std::wstring Permutations(std::uint32_t iterations, std::uint32_t seed, const std::string& directory)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t requests = 0;
+    std::uint32_t compiled = 0;
+    std::uint32_t diskHits = 0;
+
+    LampShaderDesc desc;
+    desc.File = "Lighting.hlsl";
+    desc.Entry = "PS";
+    desc.Target = "ps_5_1";
+    desc.Features = { { "NUM_DIR_LIGHTS", 3, 4, false }, { "NUM_POINT_LIGHTS", 0, 2, false }, { "ALPHA_TEST", 0, 1, true } };
+
+    // Keys: every combination distinct, defaults implicit, order of the request irrelevant.
+    std::set<PermutationKey> keys;
+    for (std::uint32_t d = 0; d <= 4; ++d)
+        for (std::uint32_t p = 0; p <= 2; ++p)
+            for (std::uint32_t a = 0; a <= 1; ++a)
+                keys.insert(LampShaderPermutations::Key(desc, { d, p, a }));
+    if (keys.size() != 30)
+        error = L"permutation keys collide";
+    ShaderDefines defines = LampShaderPermutations::Defines(desc, { 2, 0, 0 });
+    if (defines.size() != 2 || defines[0].second != "2" || defines[1].first != "NUM_POINT_LIGHTS")
+        error = L"toggle left defined when off, or values wrong";
+    LampShaderDesc other = desc;
+    other.Entry = "VS";
+    if (LampShaderPermutations::Key(other, { 3, 0, 0 }) == LampShaderPermutations::Key(desc, { 3, 0, 0 }))
+        error = L"entry point not part of the key";
+
+    // The disk cache on its own.
+    LampPermutationCache cache(directory);
+    const PermutationKey probe = 0x5eed0000ull + seed;
+    std::vector<std::uint8_t> stored(1000), loaded;
+    for (auto& b : stored)
+        b = (std::uint8_t)rng();
+    if (!cache.Store(probe, 1, stored))
+        error = L"cache could not write to " + std::wstring(directory.begin(), directory.end());
+    else if (!cache.Load(probe, 1, loaded) || loaded != stored)
+        error = L"cache did not read back what it wrote";
+    else if (cache.Load(probe, 2, loaded))
+        error = L"cache served a blob compiled from other source";
+    else
+    {
+        // Cut short, the file must miss rather than return part of a shader.
+        std::ifstream in(cache.Path(probe), std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream(cache.Path(probe), std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size() - 1 - rng() % 100);
+        if (cache.Load(probe, 1, loaded))
+            error = L"cache read a truncated file";
+    }
+    cache.Remove(probe);
+
+    // A compiler that counts its calls and writes the defines as the blob.
+    std::mutex compileMutex;
+    std::unordered_map<std::string, std::uint32_t> compiles;
+    auto compiler = [&](const LampShaderDesc& d, const ShaderDefines& defs, std::vector<std::uint8_t>& blob, std::string& log)
+    {
+        std::string text = d.Entry;
+        for (auto& def : defs)
+            text += " " + def.first + "=" + def.second;
+        {
+            std::lock_guard<std::mutex> lock(compileMutex);
+            compiles[text]++;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(std::hash<std::string>()(text) % 200));
+        if (text.find("NUM_POINT_LIGHTS=2") != std::string::npos)
+        {
+            log = "error X3000: too many lights";
+            return false;
+        }
+        blob.assign(text.begin(), text.end());
+        return true;
+    };
+
+    std::set<PermutationKey> written;
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        const std::uint64_t sourceHash = seed * 1000ull + it;
+        std::vector<std::vector<std::pair<std::string, std::uint32_t>>> asked(20 + rng() % 40);
+        for (auto& values : asked)
+        {
+            if (rng() % 2)
+                values.push_back({ "ALPHA_TEST", rng() % 2 });
+            if (rng() % 2)
+                values.push_back({ "NUM_POINT_LIGHTS", rng() % 3 });
+            if (rng() % 2)
+                values.push_back({ "NUM_DIR_LIGHTS", rng() % 5 });
+            std::shuffle(values.begin(), values.end(), rng);
+        }
+
+        // Twice over the same directory: the second run must find everything on disk.
+        for (std::uint32_t run = 0; run < 2 && error.empty(); ++run)
+        {
+            compiles.clear();
+            LampShaderPermutations permutations(directory, compiler);
+            const std::uint32_t shader = permutations.Declare(desc, sourceHash);
+
+            // Requested from several threads at once.
+            std::vector<PermutationKey> got(asked.size());
+            std::atomic<std::uint32_t> next{ 0 };
+            std::vector<std::thread> callers;
+            for (std::uint32_t t = 0; t < 3; ++t)
+            {
+                callers.emplace_back([&]
+                {
+                    for (std::uint32_t i = next++; i < asked.size(); i = next++)
+                        got[i] = permutations.Request(shader, asked[i]);
+                });
+            }
+            for (auto& c : callers)
+                c.join();
+            requests += (std::uint32_t)asked.size();
+
+            for (std::size_t i = 0; i < asked.size(); ++i)
+            {
+                std::vector<std::uint32_t> values = { 3, 0, 0 };
+                for (auto& v : asked[i])
+                    values[v.first == "NUM_DIR_LIGHTS" ? 0 : v.first == "NUM_POINT_LIGHTS" ? 1 : 2] = v.second;
+                if (got[i] != LampShaderPermutations::Key(desc, values))
+                    error = L"request hashed differently from LampShaderPermutations::Key()";
+
+                std::string log;
+                const std::vector<std::uint8_t>* blob = permutations.Wait(got[i], &log);
+                if (values[1] == 2)
+                {
+                    if (blob != nullptr || log.empty() || permutations.Find(got[i]) != nullptr)
+                        error = L"failed compile served a blob or lost its log";
+                    continue;
+                }
+                std::string expected = desc.Entry;
+                for (auto& def : LampShaderPermutations::Defines(desc, values))
+                    expected += " " + def.first + "=" + def.second;
+                if (blob == nullptr || std::string(blob->begin(), blob->end()) != expected)
+                    error = L"wrong blob for a permutation";
+                written.insert(got[i]);
+            }
+
+            const PermutationStats stats = permutations.Stats();
+            std::set<PermutationKey> unique(got.begin(), got.end());
+            if (stats.MemoryHits != asked.size() - unique.size())
+                error = L"memory hits miscounted";
+            for (auto& c : compiles)
+            {
+                // Failed ones are not cached, so they are compiled again on the second run.
+                if (c.second != 1)
+                    error = L"permutation compiled more than once in a run";
+            }
+            if (run == 1 && stats.Compiled != 0)
+                error = L"disk cache missed on the second run";
+            compiled += stats.Compiled;
+            diskHits += stats.DiskHits;
+        }
+
+        // Other source: every cached permutation is stale.
+        if (error.empty())
+        {
+            compiles.clear();
+            LampShaderPermutations permutations(directory, compiler);
+            const std::uint32_t shader = permutations.Declare(desc, sourceHash + 1);
+            permutations.Wait(permutations.Request(shader, { { "NUM_DIR_LIGHTS", 1 } }));
+            if (permutations.Stats().DiskHits != 0 || permutations.Stats().Compiled != 1)
+                error = L"edited source served from the disk cache";
+        }
+
+        // Reloads: new blobs only through TakeReloaded(), the newest of two racing ones
+        // wins, and one that fails to compile keeps the blob in use.
+        if (error.empty())
+        {
+            std::mutex sourceMutex;
+            std::string source = "v0";
+            auto versioned = [&](const LampShaderDesc& d, const ShaderDefines& defs, std::vector<std::uint8_t>& blob, std::string& log)
+            {
+                std::string text;
+                {
+                    std::lock_guard<std::mutex> lock(sourceMutex);
+                    text = source;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(std::hash<std::string>()(text + d.Entry) % 200));
+                if (text == "broken")
+                {
+                    log = "error X3004: undeclared identifier";
+                    return false;
+                }
+                for (auto& def : defs)
+                    text += " " + def.first + "=" + def.second;
+                blob.assign(text.begin(), text.end());
+                return true;
+            };
+            auto edit = [&](const std::string& text)
+            {
+                std::lock_guard<std::mutex> lock(sourceMutex);
+                source = text;
+            };
+
+            // Apart from the hashes above, so neither run reads the other's cache files.
+            const std::uint64_t reloadHash = (1ull << 63) + sourceHash * 16;
+            LampShaderPermutations permutations(directory, versioned);
+            const std::uint32_t shader = permutations.Declare(desc, reloadHash);
+            std::vector<PermutationKey> reloadKeys;
+            for (std::uint32_t d = 0; d <= 4; ++d)
+            {
+                reloadKeys.push_back(permutations.Request(shader, { { "NUM_DIR_LIGHTS", d } }));
+                written.insert(reloadKeys.back());
+            }
+            auto blobIs = [&](std::uint32_t d, const std::string& version)
+            {
+                std::string expected = version;
+                for (auto& def : LampShaderPermutations::Defines(desc, { d, 0, 0 }))
+                    expected += " " + def.first + "=" + def.second;
+                const std::vector<std::uint8_t>* blob = permutations.Find(reloadKeys[d]);
+                return blob != nullptr && std::string(blob->begin(), blob->end()) == expected;
+            };
+            for (PermutationKey key : reloadKeys)
+                permutations.Wait(key);
+
+            std::string live = "v0";
+            std::uint32_t jobs = 0;
+            const std::uint32_t edits = 1 + rng() % 4;
+            for (std::uint32_t e = 1; e <= edits && error.empty(); ++e)
+            {
+                const bool broken = rng() % 3 == 0;
+                const bool racing = !broken && rng() % 2 == 0;
+                const std::string version = broken ? "broken" : "v" + std::to_string(e);
+                if (permutations.Reload(shader, reloadHash + 2 * e - 2) != 0)
+                    error = L"unchanged source reloaded";
+                if (racing)
+                {
+                    edit("stale");
+                    jobs += permutations.Reload(shader, reloadHash + 2 * e - 1);
+                }
+                edit(version);
+                jobs += permutations.Reload(shader, reloadHash + 2 * e);
+                if (permutations.Reload(shader, reloadHash + 2 * e) != 0)
+                    error = L"same source reloaded twice";
+
+                for (std::uint32_t wait = 0; wait < 10000 && permutations.Stats().Reloaded < jobs; ++wait)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                for (std::uint32_t d = 0; d <= 4; ++d)
+                {
+                    if (error.empty() && !blobIs(d, live))
+                        error = L"reload replaced a blob before TakeReloaded()";
+                }
+
+                std::vector<PermutationReload> reloaded = permutations.TakeReloaded();
+                if (error.empty() && reloaded.size() != reloadKeys.size())
+                    error = L"reloaded " + std::to_wstring(reloaded.size()) + L" permutations, expected 5";
+                for (auto& r : reloaded)
+                {
+                    if (error.empty() && (r.Compiled == broken || r.Log.empty() != !broken))
+                        error = L"reload result or log wrong";
+                }
+                if (!broken)
+                    live = version;
+                for (std::uint32_t d = 0; d <= 4; ++d)
+                {
+                    if (error.empty() && !blobIs(d, live))
+                        error = broken ? L"failed reload dropped the working blob" : L"wrong blob after reload";
+                }
+            }
+        }
+
+        bool threw = false;
+        try
+        {
+            LampShaderPermutations permutations(directory, compiler);
+            permutations.Request(permutations.Declare(desc, 0), { { "NUM_SPOT_LIGHTS", 1 } });
+        }
+        catch (std::out_of_range&)
+        {
+            threw = true;
+        }
+        if (!threw)
+            error = L"undeclared feature accepted";
+    }
+    for (PermutationKey key : written)
+        cache.Remove(key);
+
+    if (!error.empty())
+        return L"Shader permutations FAILED: " + error + L"\n";
+    return L"Shader permutations: " + std::to_wstring(iterations) + L" rounds, "
+        + std::to_wstring(requests) + L" requests, " + std::to_wstring(compiled) + L" compiled, "
+        + std::to_wstring(diskHits) + L" from disk, ok\n";
+}
+
+LAMP_TEST(ShaderPermutation, Permutations)
+{
+    return Permutations(20, 1, LAMP_TEST_DIRECTORY);
+}
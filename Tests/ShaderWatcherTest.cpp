@@ -0,0 +1,197 @@
+#include "LampTest.h"
+#include "main/ShaderWatcher.h"
+#include "main/ShaderPermutation.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+
+// Edits, half-written saves and include changes over files in directory, polled
+// by hand against a model of the include graph, then once on the thread.
+// Writes and removes its files in directory.
+static std::wstring Trees(std::uint32_t iterations, std::uint32_t seed, const std::string& directory)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t edits = 0;
+    std::uint32_t reported = 0;
+
+    std::string dir = directory;
+    if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+        dir += '/';
+    const std::string prefix = "watch" + std::to_string(seed) + "_";
+
+    // Three shaders over four headers; headers may include each other.
+    const std::vector<std::string> names = { "a.hlsl", "b.hlsl", "c.hlsl", "x.hlsli", "y.hlsli", "z.hlsli", "w.hlsli" };
+    const std::uint32_t roots = 3;
+    std::map<std::string, std::string> disk;
+    auto path = [&](std::uint32_t f) { return dir + prefix + names[f]; };
+    auto write = [&](std::uint32_t f, const std::string& text)
+    {
+        std::ofstream(path(f), std::ios::binary | std::ios::trunc) << text;
+        disk[path(f)] = text;
+    };
+    auto remove = [&](std::uint32_t f)
+    {
+        std::remove(path(f).c_str());
+        disk.erase(path(f));
+    };
+    auto makeText = [&](std::uint32_t f)
+    {
+        std::string text = "// " + names[f] + " " + std::to_string(rng() % 4) + "\n";
+        for (std::uint32_t h = roots; h < names.size(); ++h)
+        {
+            // Headers only include later ones, so there are no cycles to model.
+            if (h > f && rng() % 3 == 0)
+                text += "#include \"" + prefix + names[h] + "\"\n";
+        }
+        return text;
+    };
+
+    for (std::uint32_t it = 0; it < iterations && error.empty(); ++it)
+    {
+        disk.clear();
+        for (std::uint32_t f = 0; f < names.size(); ++f)
+        {
+            if (f < roots || rng() % 4 != 0)
+                write(f, makeText(f));
+            else
+                remove(f);
+        }
+
+        LampShaderWatcher watcher;
+        for (std::uint32_t r = 0; r < roots; ++r)
+            watcher.Watch(path(r), r);
+        // What the watcher last reported for each file.
+        std::map<std::string, std::string> model = disk;
+
+        auto closure = [&](std::uint32_t root)
+        {
+            std::set<std::string> files;
+            std::vector<std::string> open = { path(root) };
+            while (!open.empty())
+            {
+                std::string p = open.back();
+                open.pop_back();
+                if (!files.insert(p).second)
+                    continue;
+                auto text = model.find(p);
+                if (text != model.end())
+                {
+                    for (auto& include : LampShaderPermutations::Includes(p, text->second))
+                        open.push_back(include);
+                }
+            }
+            return files;
+        };
+
+        const std::uint32_t rounds = 1 + rng() % 10;
+        for (std::uint32_t round = 0; round < rounds && error.empty(); ++round)
+        {
+            std::set<std::string> touched;
+            const std::uint32_t count = rng() % 3;
+            for (std::uint32_t e = 0; e < count; ++e)
+            {
+                const std::uint32_t f = rng() % names.size();
+                const std::uint32_t op = rng() % 6;
+                if (op == 0 && f >= roots)
+                    remove(f);
+                else if (op == 1 && disk.count(path(f)) != 0)
+                    write(f, disk[path(f)]);
+                else
+                    write(f, makeText(f));
+                touched.insert(path(f));
+                edits++;
+            }
+
+            // Half a save on one poll: nothing may be reported until it reads the same twice.
+            if (rng() % 3 == 0)
+            {
+                const std::uint32_t f = rng() % names.size();
+                const std::string whole = disk.count(path(f)) != 0 ? disk[path(f)] : std::string();
+                std::ofstream(path(f), std::ios::binary | std::ios::trunc) << whole.substr(0, whole.size() / 2) << "~";
+                watcher.Poll();
+                if (!watcher.TakeChanged().empty())
+                    error = L"half-written file reported";
+                if (disk.count(path(f)) != 0)
+                    write(f, whole);
+                else
+                    std::remove(path(f).c_str());
+            }
+
+            watcher.Poll();
+            watcher.Poll();
+            std::vector<std::uint32_t> got = watcher.TakeChanged();
+            reported += (std::uint32_t)got.size();
+
+            std::set<std::string> changed;
+            for (auto& p : touched)
+            {
+                auto before = model.find(p);
+                auto now = disk.find(p);
+                bool same = (before == model.end()) == (now == disk.end())
+                    && (now == disk.end() || before->second == now->second);
+                if (!same)
+                    changed.insert(p);
+            }
+            // Files seen only through a new include were read when it was added; none were touched since.
+            model = disk;
+
+            std::vector<std::uint32_t> expected;
+            for (std::uint32_t r = 0; r < roots; ++r)
+            {
+                std::set<std::string> files = closure(r);
+                for (auto& p : changed)
+                {
+                    if (files.count(p) != 0)
+                    {
+                        expected.push_back(r);
+                        break;
+                    }
+                }
+            }
+            if (error.empty() && got != expected)
+                error = L"reported " + std::to_wstring(got.size()) + L" shaders, expected " + std::to_wstring(expected.size());
+            for (std::uint32_t r = 0; r < roots && error.empty(); ++r)
+            {
+                std::set<std::string> files = closure(r);
+                std::vector<std::string> deps = watcher.Dependencies(path(r));
+                if (std::set<std::string>(deps.begin(), deps.end()) != files)
+                    error = L"include graph differs from the files on disk";
+            }
+        }
+    }
+
+    // On its own thread, woken by the poll interval alone.
+    if (error.empty())
+    {
+        write(0, "// a\n");
+        LampShaderWatcher watcher(5);
+        watcher.Watch(path(0), 7);
+        watcher.Start();
+        write(0, "// a, edited\n");
+        std::vector<std::uint32_t> got;
+        for (std::uint32_t wait = 0; wait < 400 && got.empty(); ++wait)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            got = watcher.TakeChanged();
+        }
+        if (got != std::vector<std::uint32_t>{ 7 })
+            error = L"watcher thread did not report an edit";
+    }
+
+    for (std::uint32_t f = 0; f < names.size(); ++f)
+        std::remove(path(f).c_str());
+
+    if (!error.empty())
+        return L"Shader watcher FAILED: " + error + L"\n";
+    return L"Shader watcher: " + std::to_wstring(iterations) + L" trees, " + std::to_wstring(edits)
+        + L" edits, " + std::to_wstring(reported) + L" shaders reported, ok\n";
+}
+
+LAMP_TEST(ShaderWatcher, Trees)
+{
+    return Trees(200, 1, LAMP_TEST_DIRECTORY);
+}
@@ -0,0 +1,67 @@
+#include "LampTest.h"
+#include "main/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Background jobs run in order on one thread, run their loops inline and leave the
+// pool's loops to other callers while they run.
+LAMP_TEST(ThreadPool, Background)
+{
+    LampThreadPool pool(4);
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread::id> threads;
+    std::atomic<bool> release{ false };
+    std::atomic<bool> looped{ false };
+
+    pool.Submit([&]
+    {
+        // Held until the caller has run a loop of its own on the pool.
+        while (!release)
+            std::this_thread::yield();
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(0);
+        threads.push_back(std::this_thread::get_id());
+    });
+    pool.Submit([&]
+    {
+        std::thread::id self = std::this_thread::get_id();
+        bool inline_ = true;
+        pool.ParallelFor(1000, 1, [&](std::uint32_t, std::uint32_t) { inline_ = inline_ && std::this_thread::get_id() == self; });
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(inline_ ? 1 : -1);
+        threads.push_back(self);
+    });
+
+    std::atomic<std::uint32_t> sum{ 0 };
+    pool.ParallelFor(1000, 10, [&](std::uint32_t begin, std::uint32_t end) { sum += end - begin; });
+    looped = sum == 1000;
+    release = true;
+    pool.WaitBackground();
+
+    std::wstring error;
+    if (!looped)
+        error = L"a loop did not run while a background job was busy";
+    else if (order.size() != 2 || order[0] != 0 || order[1] != 1)
+        error = L"background jobs ran out of order or their loop was not inline";
+    else if (threads[0] != threads[1] || threads[0] == std::this_thread::get_id())
+        error = L"background jobs did not run on the background thread";
+
+    // Jobs queued behind a running one are dropped when the pool goes away.
+    std::atomic<int> ran{ 0 };
+    std::atomic<bool> started{ false };
+    {
+        LampThreadPool dropped(2);
+        dropped.Submit([&] { started = true; std::this_thread::sleep_for(std::chrono::milliseconds(20)); ran++; });
+        dropped.Submit([&] { ran += 10; });
+        while (!started)
+            std::this_thread::yield();
+    }
+    if (error.empty() && ran != 1)
+        error = L"destroying the pool ran " + std::to_wstring(ran.load()) + L" instead of finishing only the running job";
+
+    if (!error.empty())
+        return L"Thread pool FAILED: " + error + L"\n";
+    return L"Thread pool background jobs: ok\n";
+}
@@ -0,0 +1,90 @@
+#include "LampTest.h"
+#include "D3D/TlsfAllocator.h"
+#include <algorithm>
+#include <map>
+#include <random>
+
+// Random allocate/free/defragment against an interval map, validating as it goes.
+static std::wstring Fuzz(std::uint32_t iterations, std::uint32_t seed)
+{
+    const std::uint64_t heapSize = 64ull << 20;
+    const std::uint64_t alignments[] = { 0, 256, 4096, 65536 };
+
+    TlsfAllocator alloc(heapSize, 256);
+    std::map<std::uint64_t, std::uint64_t> ranges; // offset -> end of every live allocation
+    std::vector<std::uint32_t> live;
+    std::mt19937 rng(seed);
+
+    auto overlaps = [&](std::uint64_t begin, std::uint64_t end)
+    {
+        auto it = ranges.upper_bound(begin);
+        if (it != ranges.end() && it->first < end)
+            return true;
+        return it != ranges.begin() && std::prev(it)->second > begin;
+    };
+
+    std::wstring error;
+    std::uint32_t failedAllocs = 0;
+    std::uint32_t defragMoves = 0;
+    for (std::uint32_t i = 0; i < iterations && error.empty(); ++i)
+    {
+        std::uint32_t op = rng() % 100;
+        if (op < 55 || live.empty())
+        {
+            std::uint64_t size = 1 + rng() % (rng() % 4 == 0 ? (4u << 20) : (64u << 10));
+            std::uint64_t alignment = alignments[rng() % 4];
+            std::uint32_t block = alloc.Allocate(size, alignment);
+            if (block == TlsfAllocator::InvalidBlock)
+            {
+                failedAllocs++;
+                continue;
+            }
+            std::uint64_t offset = alloc.Offset(block);
+            if (alloc.Size(block) < size || (alignment != 0 && offset % alignment != 0))
+                error = L"bad placement";
+            else if (offset + alloc.Size(block) > heapSize || overlaps(offset, offset + alloc.Size(block)))
+                error = L"overlap";
+            ranges[offset] = offset + alloc.Size(block);
+            live.push_back(block);
+        }
+        else if (op < 97)
+        {
+            std::uint32_t index = rng() % (std::uint32_t)live.size();
+            ranges.erase(alloc.Offset(live[index]));
+            alloc.Free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        else
+        {
+            defragMoves += alloc.Defragment(8, [&](const TlsfMove& m)
+            {
+                if (m.NewOffset >= m.OldOffset || overlaps(m.NewOffset, m.NewOffset + m.Size))
+                    error = L"bad defragment move";
+                ranges.erase(m.OldOffset);
+                ranges[m.NewOffset] = m.NewOffset + m.Size;
+                std::replace(live.begin(), live.end(), m.OldBlock, m.NewBlock);
+                return true;
+            });
+        }
+
+        if (error.empty() && (i % 64 == 0) && !alloc.Validate())
+            error = L"corrupt block lists";
+    }
+
+    for (std::uint32_t block : live)
+        alloc.Free(block);
+    TlsfStats stats = alloc.Stats();
+    if (error.empty() && (!alloc.Validate() || stats.FreeBlocks != 1 || stats.LargestFreeBlock != heapSize))
+        error = L"free space did not coalesce";
+
+    return L"TLSF fuzz: " + std::to_wstring(iterations) + L" ops, "
+        + std::to_wstring(failedAllocs) + L" failed allocations, "
+        + std::to_wstring(defragMoves) + L" defragment moves, "
+        + (error.empty() ? std::wstring(L"ok\n") : L"FAILED: " + error + L"\n");
+}
+
+LAMP_TEST(TlsfAllocator, Fuzz)
+{
+    return Fuzz(200000, 1);
+}
@@ -0,0 +1,82 @@
+#include "LampTest.h"
+#include "main/TransformHierarchy.h"
+#include "main/ThreadPool.h"
+
+using namespace DirectX;
+
+// Nodes added out of level order, a mirrored local matrix and a moved root.
+static std::wstring Propagation()
+{
+    LampTransforms transforms;
+    XMFLOAT4X4 place, mirror, offset;
+    XMStoreFloat4x4(&place, XMMatrixTranslation(0.0f, 0.0f, 10.0f));
+    XMStoreFloat4x4(&mirror, XMMatrixScaling(-1.0f, 1.0f, 1.0f));
+    XMStoreFloat4x4(&offset, XMMatrixTranslation(2.0f, 0.0f, 0.0f));
+    UINT root = transforms.AddNode(LampTransforms::InvalidNode, place);
+    UINT other = transforms.AddNode(LampTransforms::InvalidNode, offset);
+    UINT flipped = transforms.AddNode(root, mirror);
+    UINT leaf = transforms.AddNode(flipped, offset);
+    transforms.Update();
+
+    std::wstring error;
+    const XMFLOAT4X4& world = transforms.World(leaf);
+    if (world._41 != -2.0f || world._43 != 10.0f || world._11 != -1.0f)
+        error = L"leaf world matrix is wrong";
+    if (error.empty() && (transforms.LevelCount() != 3 || transforms.UpdatedCount() != 4))
+        error = L"first update does not build every node";
+
+    // Only the moved root's subtree updates.
+    XMStoreFloat4x4(&place, XMMatrixTranslation(0.0f, 5.0f, 10.0f));
+    transforms.SetLocal(root, place);
+    transforms.Update();
+    if (error.empty() && (transforms.UpdatedCount() != 3 || transforms.World(leaf)._42 != 5.0f || transforms.World(other)._42 != 0.0f))
+        error = L"moving the root does not move exactly its subtree";
+
+    if (!error.empty())
+        return L"Transform hierarchy FAILED: " + error + L"\n";
+    return L"Transform hierarchy propagation: ok\n";
+}
+
+// Rotates the root of a complete tree every iteration and times Update().
+static std::wstring UpdateBenchmark(UINT numNodes, UINT maxChildren)
+{
+    LampTransforms transforms;
+
+    // A complete maxChildren-ary tree.
+    XMFLOAT3 one(1.0f, 1.0f, 1.0f);
+    XMFLOAT4 identity(0.0f, 0.0f, 0.0f, 1.0f);
+    for (UINT i = 0; i < numNodes; ++i)
+    {
+        UINT parent = i == 0 ? LampTransforms::InvalidNode : (i - 1) / maxChildren;
+        XMFLOAT3 offset((float)(i % 7), (float)(i % 3), (float)(i % 5));
+        transforms.AddNode(parent, offset, identity, one);
+    }
+    transforms.Update();
+
+    const UINT iterations = 16;
+    double totalMs = 0.0;
+    for (UINT f = 0; f < iterations; ++f)
+    {
+        // Rotating the root dirties the whole tree.
+        XMFLOAT4X4 rotation;
+        XMStoreFloat4x4(&rotation, XMMatrixRotationY(0.1f * f));
+        transforms.SetLocal(0, rotation);
+        transforms.Update();
+        totalMs += transforms.UpdateMs();
+    }
+
+    return L"Transform benchmark: " + std::to_wstring(numNodes) + L" nodes, "
+        + std::to_wstring(transforms.LevelCount()) + L" levels, "
+        + std::to_wstring(LampThreadPool::Default().NumThreads()) + L" threads, "
+        + std::to_wstring(totalMs / iterations) + L" ms per full update\n";
+}
+
+LAMP_TEST(TransformHierarchy, Propagation)
+{
+    return Propagation();
+}
+
+LAMP_BENCHMARK(TransformHierarchy, Update)
+{
+    return UpdateBenchmark(1000000, 4);
+}
@@ -0,0 +1,50 @@
+#include "LampTest.h"
+#include "main/TransientPlanner.h"
+#include <algorithm>
+#include <random>
+#include <string>
+
+// Random frames checked with Validate(), heap size against the peak.
+static std::wstring Frames(std::uint32_t iterations, std::uint32_t seed)
+{
+    const std::uint64_t alignment = 64 * 1024;
+    std::mt19937 rng(seed);
+
+    std::uint32_t failures = 0;
+    double requested = 0.0;
+    double planned = 0.0;
+    double peak = 0.0;
+    std::vector<TransientRequest> requests;
+    std::vector<std::uint64_t> offsets;
+    for (std::uint32_t it = 0; it < iterations; ++it)
+    {
+        // A frame of 16 passes with a few dozen targets from 64KB to 16MB.
+        const std::uint32_t numPasses = 16;
+        requests.resize(8 + rng() % 40);
+        for (auto& r : requests)
+        {
+            r.Size = alignment * (1 + rng() % 256);
+            r.Alignment = alignment;
+            r.FirstPass = rng() % numPasses;
+            r.LastPass = std::min<std::uint32_t>(numPasses - 1, r.FirstPass + rng() % 6);
+        }
+
+        std::uint64_t heapSize = LampTransientPlanner::Plan(requests, offsets);
+        if (!LampTransientPlanner::Validate(requests, offsets) || heapSize < LampTransientPlanner::PeakLiveBytes(requests))
+            failures++;
+
+        requested += (double)LampTransientPlanner::RequestedBytes(requests);
+        planned += (double)heapSize;
+        peak += (double)LampTransientPlanner::PeakLiveBytes(requests);
+    }
+
+    return L"Transient planner: " + std::to_wstring(iterations) + L" frames, heap "
+        + std::to_wstring(planned / requested * 100.0) + L"% of unaliased, "
+        + std::to_wstring(planned / peak * 100.0) + L"% of peak live, "
+        + (failures == 0 ? std::wstring(L"ok\n") : std::to_wstring(failures) + L" FAILED\n");
+}
+
+LAMP_TEST(TransientPlanner, Frames)
+{
+    return Frames(1000, 1);
+}
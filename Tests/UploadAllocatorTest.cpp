@@ -0,0 +1,168 @@
+#include "LampTest.h"
+#include "D3D/UploadAllocator.h"
+#include <map>
+#include <random>
+
+namespace
+{
+    // Pages in host memory with made-up GPU addresses, 4GB apart so an
+    // allocation can be traced back to its page.
+    class MockPageSource : public UploadPageSource
+    {
+    public:
+        UploadPage CreatePage(std::uint64_t size) override
+        {
+            auto memory = std::make_unique<std::vector<std::uint8_t>>(size);
+            UploadPage page;
+            page.CPU = memory->data();
+            page.GPU = (std::uint64_t)(++mCreated) << 32;
+            page.Size = size;
+            page.Handle = memory.get();
+            mLive[memory.get()] = std::move(memory);
+            mPages[mCreated] = page;
+            return page;
+        }
+
+        void DestroyPage(const UploadPage& page) override
+        {
+            mLive.erase(page.Handle);
+            mPages.erase((std::uint32_t)(page.GPU >> 32));
+        }
+
+        // True when the allocation lies inside a live page, at the same offset on both sides.
+        bool Inside(const UploadAllocation& a)const
+        {
+            auto page = mPages.find((std::uint32_t)(a.GPU >> 32));
+            if (page == mPages.end())
+                return false;
+            const std::uint64_t offset = a.GPU - page->second.GPU;
+            return a.CPU == page->second.CPU + offset && offset + a.Size <= page->second.Size;
+        }
+
+        std::uint32_t Created()const { return mCreated; }
+        std::size_t Live()const { return mLive.size(); }
+
+    private:
+        std::uint32_t mCreated = 0;
+        std::map<void*, std::unique_ptr<std::vector<std::uint8_t>>> mLive;
+        std::map<std::uint32_t, UploadPage> mPages;
+    };
+
+    struct Payload
+    {
+        std::uint32_t Frame;
+        std::uint32_t Index;
+        float Value[6];
+    };
+}
+
+// Random frames of allocations, each filled with a pattern and checked once the
+// frame is done: alignment, the CPU and GPU addresses agreeing, no overlaps, and
+// spilled frames folding into one page that holds the next frame as large.
+static std::wstring Frames(std::uint32_t iterations, std::uint32_t seed)
+{
+    auto source = std::make_shared<MockPageSource>();
+    std::mt19937 rng(seed);
+    std::wstring error;
+    std::uint32_t spills = 0;
+    {
+        LinearUploadAllocator upload(source, 4096);
+        for (std::uint32_t frame = 0; frame < iterations && error.empty(); ++frame)
+        {
+            // Mostly small constants, sometimes a large array.
+            struct Written
+            {
+                UploadAllocation Alloc;
+                std::uint8_t Fill;
+            };
+            std::vector<Written> written;
+            const std::uint32_t count = 1 + rng() % 64;
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                const std::uint64_t alignment = 1ull << (rng() % 9);
+                const std::uint64_t size = rng() % 8 == 0 ? 1 + rng() % 20000 : 1 + rng() % 300;
+                UploadAllocation a = upload.Allocate(size, alignment);
+                if (a.Size != size || a.GPU % alignment != 0)
+                    error = L"bad size or alignment";
+                else if (!source->Inside(a))
+                    error = L"allocation outside its page";
+
+                const std::uint8_t fill = (std::uint8_t)(rng() & 0xff);
+                std::memset(a.CPU, fill, (std::size_t)size);
+                written.push_back({ a, fill });
+            }
+
+            Payload p = { frame, count, { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f } };
+            UploadAllocation typed = upload.Upload(p);
+            if (std::memcmp(typed.CPU, &p, sizeof(p)) != 0 || typed.GPU % LinearUploadAllocator::DefaultAlignment != 0)
+                error = L"Upload() did not copy or align";
+
+            for (auto& w : written)
+            {
+                for (std::uint64_t b = 0; b < w.Alloc.Size && error.empty(); ++b)
+                {
+                    if (w.Alloc.CPU[b] != w.Fill)
+                        error = L"allocations overlap";
+                }
+            }
+
+            const std::uint64_t used = upload.UsedBytes();
+            const bool spilled = upload.PageCount() > 1;
+            spills += spilled ? 1 : 0;
+            upload.Reset();
+            if (upload.PageCount() != 1 || upload.UsedBytes() != 0)
+                error = L"Reset() left " + std::to_wstring(upload.PageCount()) + L" pages";
+            else if (spilled && upload.CapacityBytes() < used)
+                error = L"folded page smaller than the frame";
+            if (source->Live() != upload.PageCount())
+                error = L"pages leaked";
+        }
+    }
+    if (error.empty() && source->Live() != 0)
+        error = L"pages leaked on destruction";
+
+    return L"Upload allocator: " + std::to_wstring(iterations) + L" frames, "
+        + std::to_wstring(spills) + L" spilled, " + std::to_wstring(source->Created()) + L" pages created, "
+        + (error.empty() ? std::wstring(L"ok\n") : L"FAILED: " + error + L"\n");
+}
+
+// A frame that spills over three pages is folded into one, after which the same
+// frame neither grows nor creates pages.
+static std::wstring Fold()
+{
+    auto source = std::make_shared<MockPageSource>();
+    std::wstring error;
+    {
+        LinearUploadAllocator upload(source, 1024);
+        auto frame = [&]()
+        {
+            for (std::uint32_t i = 0; i < 10; ++i)
+                upload.Allocate(256);
+        };
+
+        frame();
+        if (upload.PageCount() != 3)
+            error = L"expected 3 pages, got " + std::to_wstring(upload.PageCount());
+        upload.Reset();
+        if (upload.PageCount() != 1 || upload.CapacityBytes() != 4096)
+            error = L"expected one 4096 byte page";
+
+        const std::uint32_t created = source->Created();
+        frame();
+        upload.Reset();
+        if (upload.PageCount() != 1 || source->Created() != created)
+            error = L"steady frame created pages";
+    }
+
+    return L"Upload allocator fold: " + (error.empty() ? std::wstring(L"ok\n") : L"FAILED: " + error + L"\n");
+}
+
+LAMP_TEST(UploadAllocator, Frames)
+{
+    return Frames(1000, 1);
+}
+
+LAMP_TEST(UploadAllocator, Fold)
+{
+    return Fold();
+}
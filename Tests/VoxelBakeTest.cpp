@@ -0,0 +1,308 @@
+#include "LampTest.h"
+#include "main/VoxelBake.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    int Mod(int a, int b)
+    {
+        const int m = a % b;
+        return m < 0 ? m + b : m;
+    }
+
+    // Row vector times the item's world matrix, as the shaders multiply.
+    XMFLOAT3 TransformPoint(const XMFLOAT3& p, const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(
+            p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+            p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+            p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]);
+    }
+
+    UINT ItemIndex(const RenderItem& ri, UINT i)
+    {
+        const BYTE* ib = (const BYTE*)ri.Geo->IndexBufferCPU->GetBufferPointer();
+        const UINT index = ri.StartIndexLocation + i;
+        const UINT v = ri.Geo->IndexFormat == DXGI_FORMAT_R16_UINT ? ((const std::uint16_t*)ib)[index] : ((const std::uint32_t*)ib)[index];
+        return ri.BaseVertexLocation + v;
+    }
+
+    const Vertex& ItemVertex(const RenderItem& ri, UINT v)
+    {
+        const BYTE* vb = (const BYTE*)ri.Geo->VertexBufferCPU->GetBufferPointer();
+        return *(const Vertex*)(vb + (size_t)v * ri.Geo->VertexByteStride);
+    }
+
+    // Meshes and items of a random test scene.
+    struct TestScene
+    {
+        std::vector<std::unique_ptr<Mesh>> Meshes;
+        std::vector<std::unique_ptr<Material>> Materials;
+        std::vector<std::unique_ptr<LampCpuTexture>> Textures;
+        std::vector<const LampCpuTexture*> Table;
+        std::vector<std::unique_ptr<RenderItem>> Items;
+        std::vector<RenderItem*> All;
+    };
+
+    void AddTestMesh(TestScene& scene, std::mt19937& rng, UINT triangles, bool index16)
+    {
+        std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+        std::vector<Vertex> vertices(triangles * 3);
+        for (auto& v : vertices)
+        {
+            v.position = XMFLOAT3(coord(rng), coord(rng), coord(rng));
+            v.normal = XMFLOAT3(coord(rng), coord(rng), coord(rng));
+            v.tangent = XMFLOAT4(coord(rng), coord(rng), coord(rng), 1.0f);
+            v.uv0 = XMFLOAT2(coord(rng), coord(rng));
+        }
+        auto mesh = std::make_unique<Mesh>();
+        mesh->Name = "test" + std::to_string(scene.Meshes.size());
+        mesh->VertexByteStride = sizeof(Vertex);
+        mesh->IndexFormat = index16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+        const UINT indexSize = index16 ? 2 : 4;
+        ThrowIfFailed(D3DCreateBlob(vertices.size() * sizeof(Vertex), &mesh->VertexBufferCPU));
+        memcpy(mesh->VertexBufferCPU->GetBufferPointer(), vertices.data(), vertices.size() * sizeof(Vertex));
+        ThrowIfFailed(D3DCreateBlob(vertices.size() * indexSize, &mesh->IndexBufferCPU));
+        BYTE* ib = (BYTE*)mesh->IndexBufferCPU->GetBufferPointer();
+        for (UINT i = 0; i < (UINT)vertices.size(); ++i)
+        {
+            if (index16)
+                ((std::uint16_t*)ib)[i] = (std::uint16_t)i;
+            else
+                ((std::uint32_t*)ib)[i] = i;
+        }
+        scene.Meshes.push_back(std::move(mesh));
+    }
+
+    RenderItem* AddTestItem(TestScene& scene, std::mt19937& rng, Mesh* mesh, Material* mat)
+    {
+        std::uniform_real_distribution<float> offset(-4.0f, 4.0f);
+        std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+        auto ri = std::make_unique<RenderItem>();
+        const float s = scale(rng);
+        ri->World = XMFLOAT4X4(
+            s, 0.0f, 0.0f, 0.0f,
+            0.0f, s, 0.0f, 0.0f,
+            0.0f, 0.0f, s, 0.0f,
+            offset(rng), offset(rng), offset(rng), 1.0f);
+        ri->Geo = mesh;
+        ri->Mat = mat;
+        const UINT triangles = (UINT)(mesh->VertexBufferCPU->GetBufferSize() / sizeof(Vertex)) / 3;
+        const UINT first = rng() % triangles;
+        ri->StartIndexLocation = first * 3;
+        ri->IndexCount = (1 + rng() % (triangles - first)) * 3;
+        ri->Static = rng() % 4 != 0;
+        scene.All.push_back(ri.get());
+        scene.Items.push_back(std::move(ri));
+        return scene.All.back();
+    }
+}
+
+// Bakes of random scenes against their keys and the file format, and gathers against
+// a scan of every baked voxel.
+static std::wstring Scenes(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT64 gathered = 0;
+    auto uniform = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        TestScene scene;
+        const UINT meshes = 1 + rng() % 3;
+        for (UINT m = 0; m < meshes; ++m)
+            AddTestMesh(scene, rng, 1 + rng() % 24, rng() % 2 == 0);
+        for (UINT m = 0; m < 3; ++m)
+        {
+            scene.Materials.push_back(std::make_unique<Material>());
+            scene.Materials.back()->DiffuseAlbedo = XMFLOAT4(uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), 1.0f);
+            scene.Materials.back()->FresnelR0 = XMFLOAT3(uniform(0.0f, 1.0f), 0.0f, 0.0f);
+            scene.Materials.back()->Roughness = uniform(0.0f, 1.0f);
+            // Some maps past the table, as missing ones are.
+            scene.Materials.back()->DiffuseSrvHeapIndex = (int)(rng() % 4) - 1;
+            scene.Materials.back()->NormalSrvHeapIndex = (int)(rng() % 4) - 1;
+        }
+        for (UINT t = 0; t < 2; ++t)
+        {
+            std::vector<UINT> texels(16);
+            for (auto& texel : texels)
+                texel = rng();
+            scene.Textures.push_back(std::make_unique<LampCpuTexture>(4, 4, std::move(texels)));
+            scene.Table.push_back(scene.Textures.back().get());
+        }
+        const UINT items = 1 + rng() % 6;
+        for (UINT i = 0; i < items; ++i)
+            AddTestItem(scene, rng, scene.Meshes[rng() % meshes].get(), scene.Materials[rng() % 3].get());
+
+        const UINT levels = 1 + rng() % 3;
+        const float voxelSize = 0.125f * (float)(1 + rng() % 4);
+        LampVoxelBake bake(levels, voxelSize);
+        bake.Bake(scene.All, scene.Table);
+        const UINT64 key = bake.SceneKey(scene.All, scene.Table);
+
+        // Every static vertex lies in a baked voxel of every level; a scene of one static
+        // item carries its material constants.
+        std::vector<RenderItem*> statics;
+        for (auto ri : scene.All)
+        {
+            if (ri->Static)
+                statics.push_back(ri);
+        }
+        for (UINT l = 0; l < levels && error.empty(); ++l)
+        {
+            const std::vector<BakedVoxel>& baked = bake.Voxels(l);
+            const float size = voxelSize * (float)(1u << l);
+            for (auto ri : statics)
+            {
+                for (UINT i = 0; i < ri->IndexCount && error.empty(); ++i)
+                {
+                    const XMFLOAT3 p = TransformPoint(ItemVertex(*ri, ItemIndex(*ri, i)).position, ri->World);
+                    const UINT64 k = LampVoxelizer::Key((int)std::floor(p.x / size), (int)std::floor(p.y / size), (int)std::floor(p.z / size));
+                    auto found = std::lower_bound(baked.begin(), baked.end(), k, [](const BakedVoxel& v, UINT64 key) { return v.Key < key; });
+                    if (found == baked.end() || found->Key != k)
+                        error = L"static vertex outside the bake";
+                    else if (statics.size() == 1 && (found->Mat & 0xffff) != (LampVoxelizer::PackUnorm(ri->Mat->FresnelR0.x, ri->Mat->Roughness, 0.0f, 1.0f) & 0xffff))
+                        error = L"baked voxel lost its material";
+                }
+            }
+            if (statics.empty() && !baked.empty())
+                error = L"dynamic items were baked";
+        }
+
+        // The key follows static items only.
+        if (error.empty())
+        {
+            RenderItem* ri = scene.All[rng() % scene.All.size()];
+            const float before = ri->World.m[3][0];
+            ri->World.m[3][0] += 0.5f;
+            const bool changed = bake.SceneKey(scene.All, scene.Table) != key;
+            ri->World.m[3][0] = before;
+            if (changed != ri->Static)
+                error = ri->Static ? L"moving a static item keeps the key" : L"moving a dynamic item changes the key";
+            if (error.empty() && ri->Static)
+            {
+                Vertex* vb = (Vertex*)ri->Geo->VertexBufferCPU->GetBufferPointer();
+                const float y = vb[0].position.y;
+                vb[0].position.y += 1.0f;
+                if (bake.SceneKey(scene.All, scene.Table) == key)
+                    error = L"editing a static mesh keeps the key";
+                vb[0].position.y = y;
+                const float albedo = ri->Mat->DiffuseAlbedo.x;
+                ri->Mat->DiffuseAlbedo.x = albedo + 0.5f;
+                if (bake.SceneKey(scene.All, scene.Table) == key)
+                    error = L"editing a static material keeps the key";
+                ri->Mat->DiffuseAlbedo.x = albedo;
+                const int map = ri->Mat->DiffuseSrvHeapIndex;
+                if (error.empty() && map >= 0 && map < (int)scene.Table.size())
+                {
+                    std::vector<UINT> texels = scene.Table[map]->Texels();
+                    texels[rng() % texels.size()] ^= 1;
+                    LampCpuTexture edited(4, 4, std::move(texels));
+                    scene.Table[map] = &edited;
+                    if (bake.SceneKey(scene.All, scene.Table) == key)
+                        error = L"editing a static item's map keeps the key";
+                    scene.Table[map] = scene.Textures[map].get();
+                }
+            }
+        }
+
+        // The file: round trip, another key, truncation and any damaged byte.
+        std::vector<BYTE> data = bake.Serialize();
+        LampVoxelBake copy(levels, voxelSize);
+        if (error.empty() && !copy.Deserialize(data.data(), data.size(), key))
+            error = L"bake file does not load";
+        for (UINT l = 0; l < levels && error.empty(); ++l)
+        {
+            const std::vector<BakedVoxel>& a = bake.Voxels(l);
+            const std::vector<BakedVoxel>& b = copy.Voxels(l);
+            if (a.size() != b.size() || !std::equal(a.begin(), a.end(), b.begin(), [](const BakedVoxel& x, const BakedVoxel& y)
+                { return x.Key == y.Key && x.Albedo == y.Albedo && x.Normal == y.Normal && x.Mat == y.Mat; }))
+                error = L"bake file loads other voxels";
+        }
+        if (error.empty() && copy.Deserialize(data.data(), data.size(), key + 1))
+            error = L"bake file loads under another key";
+        if (error.empty() && (copy.Ready() || copy.Voxels(0).size() != 0))
+            error = L"refused bake file leaves voxels behind";
+        if (error.empty() && copy.Deserialize(data.data(), data.size() - 1 - rng() % data.size(), key))
+            error = L"truncated bake file loads";
+        if (error.empty())
+        {
+            std::vector<BYTE> damaged = data;
+            damaged[rng() % damaged.size()] ^= (BYTE)(1 + rng() % 255);
+            if (copy.Deserialize(damaged.data(), damaged.size(), key))
+                error = L"damaged bake file loads";
+        }
+
+        // Gathers against every baked voxel in each slab.
+        UINT dims[3];
+        for (int a = 0; a < 3; ++a)
+            dims[a] = 4 * (2 + rng() % 4);
+        LampVoxelClipmap clipmap(levels, dims, voxelSize, 4, rng() % 4);
+        for (UINT step = 0; step < 4 && error.empty(); ++step)
+        {
+            std::vector<BoundingBox> dynamic;
+            for (auto ri : scene.All)
+            {
+                if (!ri->Static)
+                    dynamic.push_back(BoundingBox(XMFLOAT3(ri->World.m[3][0], ri->World.m[3][1], ri->World.m[3][2]), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+            }
+            clipmap.Update(XMFLOAT3(uniform(-4.0f, 4.0f), uniform(-4.0f, 4.0f), uniform(-4.0f, 4.0f)), dynamic);
+            bake.Gather(clipmap);
+            gathered += bake.Gathered().size();
+            if (bake.Ranges().size() != clipmap.Slabs().size())
+            {
+                error = L"one gather range per slab expected";
+                break;
+            }
+            for (size_t s = 0; s < clipmap.Slabs().size() && error.empty(); ++s)
+            {
+                const VoxelSlab& slab = clipmap.Slabs()[s];
+                const LampVoxelBake::Range& range = bake.Ranges()[s];
+                std::vector<StaticVoxel> expected;
+                for (auto& voxel : bake.Voxels(slab.Level))
+                {
+                    int v[3];
+                    LampVoxelizer::Unkey(voxel.Key, v);
+                    bool inside = true;
+                    for (int a = 0; a < 3; ++a)
+                        inside = inside && v[a] >= slab.Box.Min[a] && v[a] < slab.Box.Max[a];
+                    if (!inside)
+                        continue;
+                    StaticVoxel sv;
+                    sv.Texel = LampVoxelBake::PackTexel(Mod(v[0], (int)dims[0]), Mod(v[1], (int)dims[1]), Mod(v[2], (int)dims[2]));
+                    sv.Albedo = voxel.Albedo;
+                    sv.Normal = voxel.Normal;
+                    sv.Mat = voxel.Mat;
+                    expected.push_back(sv);
+                }
+                if (range.Count != expected.size() || (UINT64)range.First + range.Count > bake.Gathered().size())
+                {
+                    error = L"gather range holds " + std::to_wstring(range.Count) + L" voxels, expected " + std::to_wstring(expected.size());
+                    break;
+                }
+                for (UINT i = 0; i < range.Count; ++i)
+                {
+                    const StaticVoxel& a = bake.Gathered()[range.First + i];
+                    const StaticVoxel& b = expected[i];
+                    if (a.Texel != b.Texel || a.Albedo != b.Albedo || a.Normal != b.Normal || a.Mat != b.Mat)
+                        error = L"gathered voxel differs from the bake";
+                }
+            }
+        }
+    }
+
+    if (!error.empty())
+        return L"Voxel bake FAILED: " + error + L"\n";
+    return L"Voxel bake: " + std::to_wstring(iterations) + L" scenes, " + std::to_wstring(gathered) + L" voxels gathered, ok\n";
+}
+
+LAMP_TEST(VoxelBake, Scenes)
+{
+    return Scenes(50, 1);
+}
@@ -0,0 +1,329 @@
+#include "LampTest.h"
+#include "main/VoxelClipmap.h"
+#include <array>
+#include <climits>
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    int FloorDiv(int a, int b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    int Mod(int a, int b)
+    {
+        return a - FloorDiv(a, b) * b;
+    }
+}
+
+// Random camera paths against a model of every texel: each holds the voxel of its
+// window, slabs are disjoint and cover exactly what the windows moved onto, and
+// scissors and item selection keep to the slab.
+static std::wstring CameraPaths(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT64 frames = 0;
+    UINT64 revoxelized = 0;
+    UINT64 full = 0;
+    auto uniform = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        // Small windows, so wraps, jumps and refreshes all come up often.
+        const UINT snap = 1u << (rng() % 3);
+        UINT dims[3];
+        for (int a = 0; a < 3; ++a)
+            dims[a] = snap * (2 + rng() % 4);
+        const UINT levels = 1 + rng() % 3;
+        const float voxelSize = 0.25f * (float)(1 + rng() % 4);
+        const UINT refreshSlices = rng() % (dims[2] + 1);
+        LampVoxelClipmap clipmap(levels, dims, voxelSize, snap, refreshSlices);
+        const int texelCount = (int)(dims[0] * dims[1] * dims[2]);
+
+        // The world voxel each texel was last written with.
+        const std::array<int, 3> empty = { INT_MIN, INT_MIN, INT_MIN };
+        std::vector<std::vector<std::array<int, 3>>> texels(levels, std::vector<std::array<int, 3>>(texelCount, empty));
+        auto texelIndex = [&](int x, int y, int z) { return (x * (int)dims[1] + y) * (int)dims[2] + z; };
+
+        XMFLOAT3 eye(uniform(-50.0f, 50.0f), uniform(-50.0f, 50.0f), uniform(-50.0f, 50.0f));
+        std::vector<BoundingBox> lastDynamic;
+        const UINT steps = 1 + rng() % 40;
+        for (UINT step = 0; step < steps && error.empty(); ++step)
+        {
+            const UINT op = rng() % 10;
+            bool invalidated = false;
+            if (op == 0)
+            {
+                clipmap.Invalidate();
+                invalidated = true;
+            }
+            // Mostly moves of a few voxels, sometimes far past the window.
+            const float reach = op == 1 ? 200.0f : voxelSize * (float)(rng() % (2 * dims[0]));
+            eye.x += uniform(-reach, reach);
+            eye.y += uniform(-reach, reach);
+            eye.z += uniform(-reach, reach);
+
+            std::vector<VoxelClipLevel> before(levels);
+            for (UINT l = 0; l < levels; ++l)
+                before[l] = clipmap.Level(l);
+            // Dynamic items around the camera, some reaching out of the windows.
+            std::vector<BoundingBox> dynamic(rng() % 3);
+            for (auto& bounds : dynamic)
+            {
+                const float reach = voxelSize * dims[0];
+                bounds.Center = XMFLOAT3(eye.x + uniform(-reach, reach), eye.y + uniform(-reach, reach), eye.z + uniform(-reach, reach));
+                bounds.Extents = XMFLOAT3(uniform(0.0f, 3.0f * voxelSize), uniform(0.0f, 3.0f * voxelSize), uniform(0.0f, 3.0f * voxelSize));
+            }
+            clipmap.Update(eye, dynamic);
+            frames++;
+            full += clipmap.TotalVoxels();
+            revoxelized += clipmap.LastVoxels();
+
+            std::vector<std::vector<UINT>> writes(levels, std::vector<UINT>(texelCount, 0));
+            std::vector<UINT64> entered(levels, 0);
+            UINT refreshes = 0;
+            const std::vector<VoxelSlab>& slabs = clipmap.Slabs();
+            for (size_t s = 0; s < slabs.size() && error.empty(); ++s)
+            {
+                const VoxelSlab& slab = slabs[s];
+                if (slab.Level >= levels)
+                {
+                    error = L"slab of a level that does not exist";
+                    break;
+                }
+                const VoxelClipLevel& level = clipmap.Level(slab.Level);
+                for (int a = 0; a < 3; ++a)
+                {
+                    if (slab.Box.Min[a] < level.Origin[a] || slab.Box.Max[a] > level.Origin[a] + (int)dims[a]
+                        || slab.Box.Min[a] >= slab.Box.Max[a])
+                        error = L"slab outside its window";
+                }
+                if (slab.Refresh)
+                    refreshes++;
+                else if (!slab.Dynamic)
+                    entered[slab.Level] += LampVoxelClipmap::Voxels(slab.Box);
+
+                // The pieces cover the box's texels once each, and nothing else.
+                UINT64 pieceVoxels = 0;
+                for (auto& piece : slab.Texels)
+                {
+                    pieceVoxels += LampVoxelClipmap::Voxels(piece);
+                    for (int x = piece.Min[0]; x < piece.Max[0] && error.empty(); ++x)
+                    {
+                        for (int y = piece.Min[1]; y < piece.Max[1] && error.empty(); ++y)
+                        {
+                            for (int z = piece.Min[2]; z < piece.Max[2] && error.empty(); ++z)
+                            {
+                                if (x < 0 || y < 0 || z < 0 || x >= (int)dims[0] || y >= (int)dims[1] || z >= (int)dims[2])
+                                {
+                                    error = L"texel piece outside the volume";
+                                    break;
+                                }
+                                const int t[3] = { x, y, z };
+                                std::array<int, 3> voxel;
+                                for (int a = 0; a < 3; ++a)
+                                {
+                                    voxel[a] = level.Origin[a] + Mod(t[a] - level.Origin[a], (int)dims[a]);
+                                    if (voxel[a] < slab.Box.Min[a] || voxel[a] >= slab.Box.Max[a])
+                                        error = L"texel piece outside its slab";
+                                }
+                                const int index = texelIndex(x, y, z);
+                                if (!slab.Dynamic && ++writes[slab.Level][index] > 1)
+                                    error = L"slabs overlap";
+                                texels[slab.Level][index] = voxel;
+                            }
+                        }
+                    }
+                }
+                if (error.empty() && pieceVoxels != LampVoxelClipmap::Voxels(slab.Box))
+                    error = L"texel pieces do not cover their slab";
+
+                // Pixels whose centers fall in the slab are inside the scissor, and the scissor
+                // has no pixel that misses it.
+                const UINT raster = 1 + rng() % (3 * std::max<UINT>(dims[0], std::max<UINT>(dims[1], dims[2])));
+                for (UINT axis = 0; axis < 3 && error.empty(); ++axis)
+                {
+                    const D3D12_RECT rect = clipmap.Scissor(slab, axis, raster);
+                    const int ax[2] = { (int)(axis + 1) % 3, (int)(axis + 2) % 3 };
+                    for (int r = 0; r < 2 && error.empty(); ++r)
+                    {
+                        const int a = ax[r];
+                        const double scale = (double)dims[a] / raster;
+                        for (UINT p = 0; p < raster; ++p)
+                        {
+                            // Along target y, pixel rows count down from the window's max.
+                            const double lo = r == 0 ? p * scale : (raster - p - 1) * scale;
+                            const double center = lo + 0.5 * scale + level.Origin[a];
+                            const bool covered = center >= slab.Box.Min[a] && center < slab.Box.Max[a];
+                            const bool overlaps = lo + level.Origin[a] < slab.Box.Max[a] && lo + scale + level.Origin[a] > slab.Box.Min[a];
+                            const bool inside = r == 0 ? (LONG)p >= rect.left && (LONG)p < rect.right
+                                : (LONG)p >= rect.top && (LONG)p < rect.bottom;
+                            if (covered && !inside)
+                                error = L"scissor cuts off part of its slab";
+                            else if (inside && !overlaps)
+                                error = L"scissor reaches past its slab";
+                        }
+                    }
+                }
+
+                // Items against the voxels they can reach, one voxel past their bounds.
+                std::vector<std::unique_ptr<RenderItem>> items;
+                std::vector<RenderItem*> all;
+                std::vector<bool> expected;
+                const float size = level.VoxelSize;
+                for (UINT i = 0; i < 8; ++i)
+                {
+                    // Bounds clear of voxel boundaries, so rounding cannot decide the answer.
+                    float lo[3];
+                    float hi[3];
+                    bool touches = true;
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        const int first = slab.Box.Min[a] - 3 + (int)(rng() % (slab.Box.Max[a] - slab.Box.Min[a] + 6));
+                        const int last = first + (int)(rng() % 4);
+                        lo[a] = (first + uniform(0.1f, 0.9f)) * size;
+                        hi[a] = (last + uniform(0.1f, 0.9f)) * size;
+                        if (hi[a] < lo[a])
+                            std::swap(lo[a], hi[a]);
+                        bool axisTouches = false;
+                        for (int v = slab.Box.Min[a]; v < slab.Box.Max[a]; ++v)
+                            axisTouches = axisTouches || ((v - 1) * size <= hi[a] && (v + 2) * size > lo[a]);
+                        touches = touches && axisTouches;
+                    }
+                    items.push_back(std::make_unique<RenderItem>());
+                    items.back()->Bounds.Center = XMFLOAT3((lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2);
+                    items.back()->Bounds.Extents = XMFLOAT3((hi[0] - lo[0]) / 2, (hi[1] - lo[1]) / 2, (hi[2] - lo[2]) / 2);
+                    all.push_back(items.back().get());
+                    expected.push_back(touches);
+                }
+                std::vector<RenderItem*> selected;
+                clipmap.SelectItems(slab, all, selected);
+                size_t next = 0;
+                for (size_t i = 0; i < all.size() && error.empty(); ++i)
+                {
+                    const bool got = next < selected.size() && selected[next] == all[i];
+                    if (got)
+                        next++;
+                    if (got != expected[i])
+                        error = L"item selection differs from the voxels the item reaches";
+                }
+            }
+
+            if (error.empty() && refreshes > (refreshSlices > 0 ? 1u : 0u))
+                error = L"more than one refresh slab";
+
+            // Dynamic slabs cover the voxels each dynamic box reaches, this frame and the last,
+            // and reach no voxel none of them does.
+            std::vector<BoundingBox> boxes = lastDynamic;
+            boxes.insert(boxes.end(), dynamic.begin(), dynamic.end());
+            lastDynamic = dynamic;
+            for (UINT l = 0; l < levels && error.empty(); ++l)
+            {
+                const VoxelClipLevel& level = clipmap.Level(l);
+                const float size = level.VoxelSize;
+                auto reached = [&](const int v[3])
+                {
+                    for (auto& bounds : boxes)
+                    {
+                        bool inside = true;
+                        for (int a = 0; a < 3; ++a)
+                        {
+                            const float lo = (&bounds.Center.x)[a] - (&bounds.Extents.x)[a];
+                            const float hi = (&bounds.Center.x)[a] + (&bounds.Extents.x)[a];
+                            inside = inside && (v[a] - 1) * size <= hi && (v[a] + 2) * size > lo;
+                        }
+                        if (inside)
+                            return true;
+                    }
+                    return false;
+                };
+                auto dynamicSlab = [&](const int v[3])
+                {
+                    for (auto& slab : slabs)
+                    {
+                        bool inside = slab.Dynamic && slab.Level == l;
+                        for (int a = 0; a < 3; ++a)
+                            inside = inside && v[a] >= slab.Box.Min[a] && v[a] < slab.Box.Max[a];
+                        if (inside)
+                            return true;
+                    }
+                    return false;
+                };
+                for (int x = 0; x < (int)dims[0] && error.empty(); ++x)
+                {
+                    for (int y = 0; y < (int)dims[1] && error.empty(); ++y)
+                    {
+                        for (int z = 0; z < (int)dims[2]; ++z)
+                        {
+                            const int v[3] = { level.Origin[0] + x, level.Origin[1] + y, level.Origin[2] + z };
+                            const bool expect = reached(v);
+                            if (expect != dynamicSlab(v))
+                            {
+                                error = expect ? L"dynamic item outside the dynamic slabs" : L"dynamic slab past its items";
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            for (UINT l = 0; l < levels && error.empty(); ++l)
+            {
+                const VoxelClipLevel& level = clipmap.Level(l);
+                // Exactly the voxels the window moved onto.
+                UINT64 overlap = 1;
+                for (int a = 0; a < 3; ++a)
+                    overlap *= (UINT64)std::max<int>(0, (int)dims[a] - std::abs(level.Origin[a] - before[l].Origin[a]));
+                const UINT64 window = (UINT64)texelCount;
+                const UINT64 expect = before[l].Valid && !invalidated ? window - overlap : window;
+                if (entered[l] != expect)
+                    error = L"revoxelized " + std::to_wstring(entered[l]) + L" voxels of a level, expected " + std::to_wstring(expect);
+
+                const XMFLOAT4 w = clipmap.Window(l);
+                for (int a = 0; a < 3 && error.empty(); ++a)
+                {
+                    // Half the window on either side of the camera, give or take the snap.
+                    const int camera = (int)std::floor((&eye.x)[a] / level.VoxelSize) - level.Origin[a];
+                    if (Mod(level.Origin[a], (int)snap) != 0 || camera < (int)dims[a] / 2 || camera >= (int)(dims[a] / 2 + snap))
+                        error = L"window not centered on the camera";
+                    if ((&w.x)[a] != level.Origin[a] * level.VoxelSize || w.w != level.VoxelSize)
+                        error = L"window constants differ from the level";
+                }
+
+                // Every texel holds the one voxel of the window stored there.
+                for (int x = 0; x < (int)dims[0] && error.empty(); ++x)
+                {
+                    for (int y = 0; y < (int)dims[1] && error.empty(); ++y)
+                    {
+                        for (int z = 0; z < (int)dims[2]; ++z)
+                        {
+                            const int t[3] = { x, y, z };
+                            std::array<int, 3> voxel;
+                            for (int a = 0; a < 3; ++a)
+                                voxel[a] = level.Origin[a] + Mod(t[a] - level.Origin[a], (int)dims[a]);
+                            if (texels[l][texelIndex(x, y, z)] != voxel)
+                            {
+                                error = L"texel holds a voxel outside its window";
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!error.empty())
+        return L"Voxel clipmap FAILED: " + error + L"\n";
+    return L"Voxel clipmap: " + std::to_wstring(iterations) + L" camera paths, " + std::to_wstring(frames)
+        + L" frames, " + std::to_wstring(revoxelized) + L"/" + std::to_wstring(full) + L" voxels revoxelized, ok\n";
+}
+
+LAMP_TEST(VoxelClipmap, CameraPaths)
+{
+    return CameraPaths(50, 1);
+}
@@ -0,0 +1,385 @@
+#include "LampTest.h"
+#include "main/Voxelizer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // floor(lo / size) .. floor(hi / size) on each axis, as the voxelizer bounds a triangle.
+    void VoxelRange(const XMFLOAT3 v[3], float size, int first[3], int last[3])
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            const float lo = std::min<float>((&v[0].x)[a], std::min<float>((&v[1].x)[a], (&v[2].x)[a]));
+            const float hi = std::max<float>((&v[0].x)[a], std::max<float>((&v[1].x)[a], (&v[2].x)[a]));
+            first[a] = (int)std::floor(lo / size);
+            last[a] = (int)std::floor(hi / size);
+        }
+    }
+
+    std::unique_ptr<LampCpuTexture> RandomTexture(std::mt19937& rng, UINT width, UINT height)
+    {
+        std::vector<UINT> texels((size_t)width * height);
+        for (auto& t : texels)
+            t = rng() | 0xff000000u;
+        return std::make_unique<LampCpuTexture>(width, height, std::move(texels));
+    }
+
+    VoxelVertex RandomVertex(std::mt19937& rng, float extent)
+    {
+        std::uniform_real_distribution<float> coord(-extent, extent);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        VoxelVertex v;
+        v.Position = XMFLOAT3(coord(rng), coord(rng), coord(rng));
+        v.Normal = XMFLOAT3(unit(rng), unit(rng), unit(rng));
+        v.Tangent = XMFLOAT3(unit(rng), unit(rng), unit(rng));
+        v.TexC = XMFLOAT2(unit(rng) * 2.0f, unit(rng) * 2.0f);
+        return v;
+    }
+
+    // The triangle clipped to the box [lo, hi]; empty when they do not meet.
+    std::vector<std::array<double, 3>> ClipToBox(const XMFLOAT3 tri[3], const double lo[3], const double hi[3])
+    {
+        std::vector<std::array<double, 3>> polygon;
+        for (int i = 0; i < 3; ++i)
+            polygon.push_back({ { (double)tri[i].x, (double)tri[i].y, (double)tri[i].z } });
+        for (int a = 0; a < 3 && !polygon.empty(); ++a)
+        {
+            for (int side = 0; side < 2 && !polygon.empty(); ++side)
+            {
+                // Keep sign * (p[a] - plane) >= 0.
+                const double plane = side == 0 ? lo[a] : hi[a];
+                const double sign = side == 0 ? 1.0 : -1.0;
+                std::vector<std::array<double, 3>> kept;
+                for (size_t i = 0; i < polygon.size(); ++i)
+                {
+                    const auto& p = polygon[i];
+                    const auto& q = polygon[(i + 1) % polygon.size()];
+                    const double dp = sign * (p[a] - plane);
+                    const double dq = sign * (q[a] - plane);
+                    if (dp >= 0.0)
+                        kept.push_back(p);
+                    if ((dp >= 0.0) != (dq >= 0.0))
+                    {
+                        const double t = dp / (dp - dq);
+                        std::array<double, 3> x;
+                        for (int k = 0; k < 3; ++k)
+                            x[k] = p[k] + t * (q[k] - p[k]);
+                        kept.push_back(x);
+                    }
+                }
+                polygon.swap(kept);
+            }
+        }
+        return polygon;
+    }
+
+    bool SameVoxels(const std::vector<BakedVoxel>& a, const std::vector<BakedVoxel>& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const BakedVoxel& x, const BakedVoxel& y)
+            { return x.Key == y.Key && x.Albedo == y.Albedo && x.Normal == y.Normal && x.Mat == y.Mat; });
+    }
+
+}
+
+// Triangles per second of the reference, of Resolve() on one thread and on the pool.
+static std::wstring Throughput(UINT triangles)
+{
+    std::mt19937 rng(1);
+    // A rolling height field of triangles about two voxels wide, textured like the scene.
+    const float voxelSize = 0.05f;
+    const UINT side = std::max<UINT>(2u, (UINT)std::sqrt(triangles / 2.0f));
+    const float step = 2.0f * voxelSize;
+    auto diffuse = RandomTexture(rng, 256, 256);
+    std::vector<UINT> flat(64 * 64, LampVoxelizer::PackUnorm(0.5f, 0.5f, 1.0f, 1.0f));
+    LampCpuTexture normalMap(64, 64, flat);
+    VoxelMaterial material;
+    material.DiffuseMap = diffuse.get();
+    material.NormalMap = &normalMap;
+    material.Roughness = 0.5f;
+
+    auto vertex = [&](UINT i, UINT j)
+    {
+        VoxelVertex v;
+        const float x = i * step;
+        const float z = j * step;
+        v.Position = XMFLOAT3(x, 0.5f * std::sin(x * 0.7f) * std::cos(z * 0.5f), z);
+        v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+        v.TexC = XMFLOAT2(x * 0.25f, z * 0.25f);
+        return v;
+    };
+    LampVoxelizer voxelizer(voxelSize);
+    for (UINT j = 0; j < side; ++j)
+    {
+        for (UINT i = 0; i < side; ++i)
+        {
+            const VoxelVertex a[3] = { vertex(i, j), vertex(i + 1, j), vertex(i, j + 1) };
+            const VoxelVertex b[3] = { vertex(i + 1, j), vertex(i + 1, j + 1), vertex(i, j + 1) };
+            voxelizer.AddTriangle(a, material);
+            voxelizer.AddTriangle(b, material);
+        }
+    }
+
+    auto time = [](const std::function<std::vector<BakedVoxel>()>& resolve, size_t& voxels)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        voxels = resolve().size();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    };
+    LampThreadPool serial(1);
+    size_t reference = 0;
+    size_t single = 0;
+    size_t parallel = 0;
+    const double referenceSeconds = time([&] { return voxelizer.ResolveReference(); }, reference);
+    const double singleSeconds = time([&] { return voxelizer.Resolve(serial); }, single);
+    const double parallelSeconds = time([&] { return voxelizer.Resolve(); }, parallel);
+
+    const double count = (double)voxelizer.TriangleCount();
+    std::wstring report = L"Voxelizer benchmark: " + std::to_wstring(voxelizer.TriangleCount()) + L" triangles into "
+        + std::to_wstring(parallel) + L" voxels\n";
+    report += L"  reference:   " + std::to_wstring(count / referenceSeconds / 1e6) + L" M triangles/s\n";
+    report += L"  SIMD, 1 thread:   " + std::to_wstring(count / singleSeconds / 1e6) + L" M triangles/s\n";
+    report += L"  SIMD, " + std::to_wstring(LampThreadPool::Default().NumThreads()) + L" threads:   "
+        + std::to_wstring(count / parallelSeconds / 1e6) + L" M triangles/s\n";
+    if (reference != single || single != parallel)
+        report += L"  voxel counts differ!\n";
+    return report;
+}
+
+// Random triangles against polygon clipping, Resolve() against ResolveReference(),
+// material sampling and the voxel volumes.
+static std::wstring Triangles(UINT iterations, UINT seed)
+{
+    std::mt19937 rng(seed);
+    std::wstring error;
+    UINT64 triangles = 0;
+    UINT64 voxels = 0;
+    auto uniform = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+
+    // The voxels a triangle reaches against clipping it to each voxel nearby.
+    for (UINT it = 0; it < iterations * 20 && error.empty(); ++it)
+    {
+        const float size = 0.25f * (float)(1 + rng() % 4);
+        VoxelVertex v[3];
+        XMFLOAT3 tri[3];
+        const UINT shape = rng() % 4;
+        for (int k = 0; k < 3; ++k)
+        {
+            float* p = &v[k].Position.x;
+            for (int a = 0; a < 3; ++a)
+                p[a] = uniform(-3.0f, 3.0f) * size;
+            // On the voxel grid, and flat on a voxel face, where ties decide.
+            if (shape == 0)
+            {
+                for (int a = 0; a < 3; ++a)
+                    p[a] = std::floor(p[a] / size) * size;
+            }
+            if (shape == 1)
+                v[k].Position.y = size;
+        }
+        if (shape == 2)
+            v[2] = v[1];
+        for (int k = 0; k < 3; ++k)
+            tri[k] = v[k].Position;
+
+        LampVoxelizer voxelizer(size);
+        voxelizer.AddTriangle(v, VoxelMaterial());
+        std::vector<BakedVoxel> reached = voxelizer.Resolve();
+        triangles++;
+        voxels += reached.size();
+
+        int first[3];
+        int last[3];
+        VoxelRange(tri, size, first, last);
+        size_t next = 0;
+        int c[3];
+        for (c[2] = first[2] - 1; c[2] <= last[2] + 1 && error.empty(); ++c[2])
+        {
+            for (c[1] = first[1] - 1; c[1] <= last[1] + 1 && error.empty(); ++c[1])
+            {
+                for (c[0] = first[0] - 1; c[0] <= last[0] + 1 && error.empty(); ++c[0])
+                {
+                    const UINT64 key = LampVoxelizer::Key(c[0], c[1], c[2]);
+                    const bool got = next < reached.size() && reached[next].Key == key;
+                    if (got)
+                        next++;
+                    if (got != LampVoxelizer::Overlaps(tri, c, size))
+                        error = L"Resolve() and Overlaps() disagree";
+                    // Slightly larger and smaller voxels: the answer may go either way between.
+                    const double eps = 1e-4 * size;
+                    double lo[3];
+                    double hi[3];
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        lo[a] = c[a] * (double)size - eps;
+                        hi[a] = (c[a] + 1) * (double)size + eps;
+                    }
+                    const bool near = !ClipToBox(tri, lo, hi).empty();
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        lo[a] += 2 * eps;
+                        hi[a] -= 2 * eps;
+                    }
+                    const bool inside = !ClipToBox(tri, lo, hi).empty();
+                    if (got && !near)
+                        error = L"voxelizer reaches a voxel the triangle misses";
+                    else if (!got && inside)
+                        error = L"voxelizer misses a voxel the triangle crosses";
+                    // A face between two voxels belongs to the one above it.
+                    if (shape == 1 && got && c[1] != 1)
+                        error = L"triangle on a voxel face reaches the voxel below";
+                }
+            }
+        }
+        if (error.empty() && next != reached.size())
+            error = L"voxelizer reaches a voxel past the triangle's bounds";
+    }
+
+    // Random soups across bins, with textures: the parallel path against the reference.
+    LampThreadPool pool(3);
+    for (UINT it = 0; it < iterations && error.empty(); ++it)
+    {
+        std::vector<std::unique_ptr<LampCpuTexture>> textures;
+        for (int i = 0; i < 3; ++i)
+            textures.push_back(RandomTexture(rng, 1 + rng() % 16, 1 + rng() % 16));
+        const float size = 0.05f * (float)(1 + rng() % 4);
+        LampVoxelizer voxelizer(size);
+        const UINT count = 1 + rng() % 40;
+        const float extent = size * LampVoxelizer::BinSize * (0.5f + uniform(0.0f, 2.0f));
+        for (UINT t = 0; t < count; ++t)
+        {
+            VoxelVertex v[3];
+            v[0] = RandomVertex(rng, extent);
+            // Mostly small triangles near each other, some spanning several bins.
+            const float spread = rng() % 4 == 0 ? extent : size * 4.0f;
+            for (int k = 1; k < 3; ++k)
+            {
+                v[k] = RandomVertex(rng, spread);
+                v[k].Position.x += v[0].Position.x;
+                v[k].Position.y += v[0].Position.y;
+                v[k].Position.z += v[0].Position.z;
+            }
+            VoxelMaterial material;
+            material.DiffuseAlbedo = XMFLOAT4(uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), 1.0f);
+            material.Metallic = uniform(0.0f, 1.0f);
+            material.Roughness = uniform(0.0f, 1.0f);
+            material.DiffuseMap = rng() % 2 ? textures[rng() % 3].get() : nullptr;
+            material.NormalMap = rng() % 2 ? textures[rng() % 3].get() : nullptr;
+            voxelizer.AddTriangle(v, material);
+        }
+        const std::vector<BakedVoxel> reference = voxelizer.ResolveReference();
+        triangles += count;
+        voxels += reference.size();
+        if (!SameVoxels(voxelizer.Resolve(pool), reference))
+            error = L"parallel voxelizer differs from the reference";
+        else if (!SameVoxels(voxelizer.Resolve(LampThreadPool::Default()), reference))
+            error = L"voxelizer differs from the reference on the default pool";
+    }
+
+    // Sampling: a flat triangle maps the center of each texel to the center of a voxel.
+    if (error.empty())
+    {
+        const UINT albedo = LampVoxelizer::PackUnorm(0.8f, 0.4f, 0.2f, 1.0f);
+        std::vector<UINT> texels(4 * 4);
+        for (UINT i = 0; i < texels.size(); ++i)
+            texels[i] = i % 2 ? albedo : LampVoxelizer::PackUnorm(0.2f, 0.6f, 1.0f, 1.0f);
+        LampCpuTexture diffuse(4, 4, texels);
+        // Tilted toward +x in tangent space.
+        std::vector<UINT> tilted(4 * 4, LampVoxelizer::PackUnorm(1.0f, 0.5f, 0.5f, 1.0f));
+        LampCpuTexture normalMap(4, 4, tilted);
+        VoxelMaterial material;
+        material.DiffuseAlbedo = XMFLOAT4(0.5f, 1.0f, 1.0f, 1.0f);
+        material.DiffuseMap = &diffuse;
+        material.NormalMap = &normalMap;
+
+        // Voxels of size 1 in the plane y = 0.25, uv = (x, z) / 4. Voxels across the long
+        // edge sample the edge instead, so only those wholly inside are checked.
+        VoxelVertex v[3];
+        const float corners[3][2] = { { 0.0f, 0.0f }, { 16.0f, 0.0f }, { 0.0f, 16.0f } };
+        for (int i = 0; i < 3; ++i)
+        {
+            v[i].Position = XMFLOAT3(corners[i][0], 0.25f, corners[i][1]);
+            v[i].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+            v[i].Tangent = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            v[i].TexC = XMFLOAT2(corners[i][0] / 4.0f, corners[i][1] / 4.0f);
+        }
+        LampVoxelizer voxelizer(1.0f);
+        voxelizer.AddTriangle(v, material);
+        for (auto& voxel : voxelizer.Resolve())
+        {
+            int c[3];
+            LampVoxelizer::Unkey(voxel.Key, c);
+            if (c[1] != 0 || c[0] < 0 || c[2] < 0 || c[0] + c[2] > 16)
+            {
+                error = L"flat triangle reaches a voxel off it";
+                break;
+            }
+            if (c[0] + c[2] > 14)
+                continue;
+            const XMFLOAT4 texel = LampVoxelizer::UnpackUnorm(texels[(c[2] % 4) * 4 + c[0] % 4]);
+            const XMFLOAT4 got = LampVoxelizer::UnpackUnorm(voxel.Albedo);
+            const XMFLOAT4 n = LampVoxelizer::UnpackUnorm(voxel.Normal);
+            if (std::fabs(got.x - 0.5f * texel.x) > 0.01f || std::fabs(got.y - texel.y) > 0.01f || std::fabs(got.z - texel.z) > 0.01f)
+                error = L"voxel albedo is not the texel under its center";
+            // +x in tangent space is the tangent, +z in world space.
+            else if (std::fabs(n.z - 1.0f) > 0.01f || std::fabs(n.x - 0.5f) > 0.01f || std::fabs(n.y - 0.5f) > 0.01f)
+                error = L"voxel normal ignores the normal map";
+        }
+    }
+
+    // Volumes: texels wrap, voxels outside the window are dropped, identical volumes compare equal.
+    if (error.empty())
+    {
+        const UINT dims[3] = { 8, 4, 8 };
+        const int windowMin[3] = { -3, 2, 5 };
+        std::vector<BakedVoxel> baked(2);
+        baked[0].Key = LampVoxelizer::Key(-3, 5, 12);
+        baked[0].Albedo = LampVoxelizer::PackUnorm(1.0f, 0.5f, 0.25f, 1.0f);
+        baked[0].Normal = LampVoxelizer::PackUnorm(0.5f, 1.0f, 0.5f, 1.0f);
+        baked[0].Mat = LampVoxelizer::PackUnorm(0.0f, 0.5f, 0.0f, 1.0f);
+        baked[1] = baked[0];
+        baked[1].Key = LampVoxelizer::Key(5, 2, 5);
+        std::vector<UINT> color;
+        std::vector<UINT> normal;
+        std::vector<UINT> mat;
+        LampVoxelizer::WriteVolumes(baked, windowMin, dims, XMFLOAT3(0.0f, -1.0f, 0.0f), color, normal, mat);
+        // -3 mod 8 = 5, 5 mod 4 = 1, 12 mod 8 = 4.
+        const size_t index = (4 * 4 + 1) * 8 + 5;
+        UINT64 written = 0;
+        for (auto t : normal)
+            written += t != 0;
+        if (written != 1 || normal[index] != baked[0].Normal || mat[index] != baked[0].Mat)
+            error = L"voxel volumes put voxels in the wrong texels";
+        else if (color[index] != LampVoxelizer::PackUnorm(0.32f, 0.16f, 0.08f, 1.0f))
+            error = L"voxel color is not lit as the shader lights it";
+        std::vector<UINT> other = color;
+        UINT maxError = 0;
+        if (error.empty() && LampVoxelizer::CompareVolumes(color, other, 0) != 0)
+            error = L"equal volumes compare different";
+        other[3] ^= 0x0400;
+        if (error.empty() && (LampVoxelizer::CompareVolumes(color, other, 2, &maxError) != 1 || maxError != 4))
+            error = L"volume comparison misses a difference";
+    }
+
+    if (!error.empty())
+        return L"Voxelizer FAILED: " + error + L"\n";
+    return L"Voxelizer: " + std::to_wstring(triangles) + L" triangles reaching " + std::to_wstring(voxels) + L" voxels, ok\n";
+}
+
+LAMP_TEST(Voxelizer, Triangles)
+{
+    return Triangles(50, 1);
+}
+
+LAMP_BENCHMARK(Voxelizer, Throughput)
+{
+    return Throughput(200000);
+}
@@ -0,0 +1,81 @@
+// Packs compiled shaders into the archive LampShader maps at startup.
+//
+//   g++ -std=c++14 -O2 -I../../Source/main ShaderPacker.cpp ../../Source/main/ShaderArchive.cpp -o ShaderPacker
+//   ./ShaderPacker ../../Shaders/cso/Shaders.lsa ../../Shaders/cso/*.cso
+//
+// Each file is stored under its name without directory and extension, e.g. "Default_VS".
+// Rerun after the shaders are rebuilt; LampShader reads the loose .cso for anything missing.
+
+#include "ShaderArchive.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+namespace
+{
+    std::string Stem(const std::string& path)
+    {
+        std::size_t slash = path.find_last_of("/\\");
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        std::size_t dot = name.find_last_of('.');
+        return dot == std::string::npos ? name : name.substr(0, dot);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s <archive> <shader.cso>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::vector<std::uint8_t>>> blobs;
+    std::set<std::string> names;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file)
+        {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        std::string name = Stem(argv[i]);
+        if (!names.insert(name).second)
+        {
+            std::fprintf(stderr, "%s: a shader named %s is already packed\n", argv[i], name.c_str());
+            return 1;
+        }
+        blobs.push_back({ name, std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()) });
+    }
+
+    std::vector<std::uint8_t> archive = LampShaderArchive::Pack(blobs);
+
+    // Read back before writing, so a bad archive never replaces a good one.
+    LampShaderArchive check;
+    std::string error;
+    if (!check.Open(archive.data(), archive.size(), error))
+    {
+        std::fprintf(stderr, "packed archive is invalid: %s\n", error.c_str());
+        return 1;
+    }
+    for (auto& b : blobs)
+    {
+        if (check.Find(b.first).Size != b.second.size())
+        {
+            std::fprintf(stderr, "%s did not read back\n", b.first.c_str());
+            return 1;
+        }
+    }
+
+    std::ofstream out(argv[1], std::ios::binary);
+    out.write(reinterpret_cast<const char*>(archive.data()), (std::streamsize)archive.size());
+    if (!out)
+    {
+        std::fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+    std::printf("%s: %u shaders, %zu bytes\n", argv[1], check.Count(), archive.size());
+    return 0;
+}